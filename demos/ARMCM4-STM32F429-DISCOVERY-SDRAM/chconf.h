@@ -91,6 +91,21 @@
 #define CH_NO_IDLE_THREAD               FALSE
 #endif
 
+/**
+ * @brief   Symmetric multiprocessing.
+ * @details If enabled the scheduler manages one ready list and one idle
+ *          thread for each of the @p PORT_CORES_NUMBER cores exported by
+ *          the port, threads are placed on the cores allowed by their
+ *          affinity mask and idle cores steal ready threads from the
+ *          busy ones.
+ *
+ * @note    The default is @p FALSE.
+ * @note    Requires a port supporting multiple cores and an idle thread.
+ */
+#if !defined(CH_USE_SMP) || defined(__DOXYGEN__)
+#define CH_USE_SMP                      FALSE
+#endif
+
 /** @} */
 
 /*===========================================================================*/
@@ -186,6 +201,18 @@
 #define CH_USE_MUTEXES                  TRUE
 #endif
 
+/**
+ * @brief   Ceiling mutexes APIs.
+ * @details If enabled then the mutexes implementing the immediate priority
+ *          ceiling protocol are included in the kernel.
+ *
+ * @note    The default is @p FALSE.
+ * @note    Requires @p CH_USE_MUTEXES, not supported with @p CH_USE_SMP.
+ */
+#if !defined(CH_USE_CEILING_MUTEXES) || defined(__DOXYGEN__)
+#define CH_USE_CEILING_MUTEXES          FALSE
+#endif
+
 /**
  * @brief   Conditional Variables APIs.
  * @details If enabled then the conditional variables APIs are included
@@ -288,6 +315,20 @@
 #define CH_USE_MEMCORE                  TRUE
 #endif
 
+/**
+ * @brief   Memory core regions APIs.
+ * @details If enabled then the core memory manager can manage several
+ *          memory regions having different speed and DMA capability, the
+ *          heaps, the memory pools and the threads can be placed in a
+ *          specific region.
+ *
+ * @note    The default is @p FALSE.
+ * @note    Requires @p CH_USE_MEMCORE.
+ */
+#if !defined(CH_USE_MEMCORE_REGIONS) || defined(__DOXYGEN__)
+#define CH_USE_MEMCORE_REGIONS          TRUE
+#endif
+
 /**
  * @brief   Heap Allocator APIs.
  * @details If enabled then the memory heap allocator APIs are included
@@ -327,6 +368,19 @@
 #define CH_USE_MEMPOOLS                 TRUE
 #endif
 
+/**
+ * @brief   Arenas APIs.
+ * @details If enabled then the arena allocator APIs are included in the
+ *          kernel.
+ *
+ * @note    The default is @p FALSE.
+ * @note    Requires @p CH_USE_HEAP, @p CH_USE_MEMPOOLS or
+ *          @p CH_USE_MEMCORE.
+ */
+#if !defined(CH_USE_ARENAS) || defined(__DOXYGEN__)
+#define CH_USE_ARENAS                   FALSE
+#endif
+
 /**
  * @brief   Dynamic Threads APIs.
  * @details If enabled then the dynamic threads creation APIs are included
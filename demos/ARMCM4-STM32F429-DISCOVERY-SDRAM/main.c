@@ -25,6 +25,11 @@
 
 #define IS42S16400J_SIZE             0x400000
 
+#if CH_USE_MEMCORE_REGIONS
+static MemoryRegion ccm_region;
+static MemoryHeap ccm_heap;
+#endif
+
 /*
  * Red LED blinker thread, times are in milliseconds.
  */
@@ -66,6 +71,10 @@ static msg_t Thread2(void *arg) {
 
 static void cmd_mem(BaseSequentialStream *chp, int argc, char *argv[]) {
   size_t n, size;
+#if CH_USE_MEMCORE_REGIONS
+  MemoryRegion *mrp;
+  MemoryRegionStats mrs;
+#endif
 
   (void)argv;
   if (argc > 0) {
@@ -76,6 +85,19 @@ static void cmd_mem(BaseSequentialStream *chp, int argc, char *argv[]) {
   chprintf(chp, "core free memory : %u bytes\r\n", chCoreStatus());
   chprintf(chp, "heap fragments   : %u\r\n", n);
   chprintf(chp, "heap free total  : %u bytes\r\n", size);
+#if CH_USE_MEMCORE_REGIONS
+  chprintf(chp, "region    speed dma     size     used allocs fails\r\n");
+  mrp = chCoreFirstRegion();
+  while (mrp != NULL) {
+    chCoreGetStats(mrp, &mrs);
+    chprintf(chp, "%-9s %5u %3s %8u %8u %6lu %5lu\r\n",
+             chCoreGetRegionName(mrp),
+             chCoreGetRegionAttr(mrp) & MEM_SPEED_MASK,
+             chCoreGetRegionAttr(mrp) & MEM_DMA ? "yes" : "no",
+             mrs.size, mrs.used, mrs.allocs, mrs.fails);
+    mrp = chCoreNextRegion(mrp);
+  }
+#endif
 }
 
 static void cmd_threads(BaseSequentialStream *chp, int argc, char *argv[]) {
@@ -106,8 +128,13 @@ static void cmd_test(BaseSequentialStream *chp, int argc, char *argv[]) {
     chprintf(chp, "Usage: test\r\n");
     return;
   }
+#if CH_USE_MEMCORE_REGIONS
+  tp = chThdCreateFromHeap(&ccm_heap, TEST_WA_SIZE, chThdGetPriority(),
+                           TestThread, chp);
+#else
   tp = chThdCreateFromHeap(NULL, TEST_WA_SIZE, chThdGetPriority(),
                            TestThread, chp);
+#endif
   if (tp == NULL) {
     chprintf(chp, "out of memory\r\n");
     return;
@@ -427,6 +454,22 @@ int main(void) {
    */
   SDRAM_Init();
 
+#if CH_USE_MEMCORE_REGIONS
+  /*
+   * Memory regions, the CCM is fast but not reachable by DMA. The test
+   * thread stack is taken from a heap bound to the CCM. The SDRAM is not
+   * given to the memory core because the SDRAM commands overwrite all of
+   * it.
+   */
+  {
+    extern uint8_t __ccm_start__[], __ccm_end__[];
+
+    chCoreAddRegion(&ccm_region, "ccm", __ccm_start__,
+                    (size_t)(__ccm_end__ - __ccm_start__), MEM_SPEED_FAST);
+    chHeapInitRegion(&ccm_heap, &ccm_region);
+  }
+#endif
+
 
   /*
    * Normal main() thread activity, in this demo it just performs
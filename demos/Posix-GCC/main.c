@@ -32,8 +32,25 @@ static Thread *cdtp;
 static Thread *shelltp1;
 static Thread *shelltp2;
 
+#if CH_USE_MEMCORE_REGIONS
+/*
+ * Simulated memory regions, a small fast memory not reachable by DMA and
+ * a large slow external memory.
+ */
+#define CCM_SIZE            0x4000
+#define SDRAM_SIZE          0x40000
+
+static stkalign_t ccm_buf[CCM_SIZE / sizeof (stkalign_t)];
+static stkalign_t sdram_buf[SDRAM_SIZE / sizeof (stkalign_t)];
+static MemoryRegion ccm_region, sdram_region;
+#endif
+
 static void cmd_mem(BaseSequentialStream *chp, int argc, char *argv[]) {
   size_t n, size;
+#if CH_USE_MEMCORE_REGIONS
+  MemoryRegion *mrp;
+  MemoryRegionStats mrs;
+#endif
 
   (void)argv;
   if (argc > 0) {
@@ -44,6 +61,19 @@ static void cmd_mem(BaseSequentialStream *chp, int argc, char *argv[]) {
   chprintf(chp, "core free memory : %u bytes\r\n", chCoreStatus());
   chprintf(chp, "heap fragments   : %u\r\n", n);
   chprintf(chp, "heap free total  : %u bytes\r\n", size);
+#if CH_USE_MEMCORE_REGIONS
+  chprintf(chp, "region    speed dma     size     used allocs fails\r\n");
+  mrp = chCoreFirstRegion();
+  while (mrp != NULL) {
+    chCoreGetStats(mrp, &mrs);
+    chprintf(chp, "%-9s %5u %3s %8u %8u %6lu %5lu\r\n",
+             chCoreGetRegionName(mrp),
+             chCoreGetRegionAttr(mrp) & MEM_SPEED_MASK,
+             chCoreGetRegionAttr(mrp) & MEM_DMA ? "yes" : "no",
+             mrs.size, mrs.used, mrs.allocs, mrs.fails);
+    mrp = chCoreNextRegion(mrp);
+  }
+#endif
 }
 
 static void cmd_threads(BaseSequentialStream *chp, int argc, char *argv[]) {
@@ -213,6 +243,15 @@ int main(void) {
   halInit();
   chSysInit();
 
+#if CH_USE_MEMCORE_REGIONS
+  /*
+   * Simulated memory regions.
+   */
+  chCoreAddRegion(&ccm_region, "ccm", ccm_buf, CCM_SIZE, MEM_SPEED_FAST);
+  chCoreAddRegion(&sdram_region, "sdram", sdram_buf, SDRAM_SIZE,
+                  MEM_SPEED_SLOW | MEM_DMA);
+#endif
+
   /*
    * Serial ports (simulated) initialization.
    */
@@ -226,10 +265,15 @@ int main(void) {
   chEvtRegister(&shell_terminated, &tel, 0);
 
   /*
-   * Console thread started.
+   * Console thread started, in fast memory if available.
    */
+#if CH_USE_MEMCORE_REGIONS
+  cdtp = chThdCreateFast(CONSOLE_WA_SIZE, NORMALPRIO + 1,
+                         console_thread, NULL);
+#else
   cdtp = chThdCreateFromHeap(NULL, CONSOLE_WA_SIZE, NORMALPRIO + 1,
                              console_thread, NULL);
+#endif
 
   /*
    * Initializing connection/disconnection events.
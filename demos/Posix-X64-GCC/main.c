@@ -0,0 +1,53 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <stdlib.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "test.h"
+#include "console.h"
+
+/*
+ * Simulator main.
+ */
+int main(int argc, char *argv[]) {
+  msg_t result;
+
+  (void)argc;
+  (void)argv;
+
+  /*
+   * System initializations.
+   * - HAL initialization, this also initializes the configured device drivers
+   *   and performs the board-specific initializations.
+   * - Kernel initialization, the main() function becomes a thread and the
+   *   RTOS is active, from now on the threads are preempted by the
+   *   simulated interrupt.
+   */
+  halInit();
+  conInit();
+  chSysInit();
+
+  /*
+   * Runs the test suite and the benchmarks on the console.
+   */
+  result = TestThread(&CD1);
+  if (result)
+    exit(1);
+  else
+    exit(0);
+}
@@ -104,6 +104,64 @@ namespace chibios_fatfs {
     return 0;
   }
 
+#if FATFS_USE_STREAMING || defined(__DOXYGEN__)
+  /*------------------------------------------------------------------------*
+   * chibios_fatfs::FatFSStreamWrapper                                      *
+   *------------------------------------------------------------------------*/
+  FatFSStreamWrapper::FatFSStreamWrapper(void) : inuse(false), lasterr(0) {
+
+  }
+
+  size_t FatFSStreamWrapper::write(const uint8_t *bp, size_t n) {
+    size_t done;
+
+    done = fatfsStreamWrite(&stream, bp, n);
+    if (done < n)
+      lasterr = FR_DISK_ERR;
+    return done;
+  }
+
+  size_t FatFSStreamWrapper::read(uint8_t *bp, size_t n) {
+
+    (void)bp;
+    (void)n;
+    return 0;
+  }
+
+  msg_t FatFSStreamWrapper::put(uint8_t b) {
+
+    return write(&b, 1) == 1 ? RDY_OK : RDY_RESET;
+  }
+
+  msg_t FatFSStreamWrapper::get(void) {
+
+    return RDY_RESET;
+  }
+
+  uint32_t FatFSStreamWrapper::getAndClearLastError(void) {
+    uint32_t err = lasterr;
+
+    lasterr = 0;
+    return err;
+  }
+
+  fileoffset_t FatFSStreamWrapper::getSize(void) {
+
+    return fatfsStreamGetSize(&stream);
+  }
+
+  uint32_t FatFSStreamWrapper::checkpoint(void) {
+    FRESULT res;
+
+    res = fatfsStreamSync(&stream);
+    if (res != FR_OK) {
+      lasterr = res;
+      return FILE_ERROR;
+    }
+    return FILE_OK;
+  }
+#endif /* FATFS_USE_STREAMING */
+
   /*------------------------------------------------------------------------*
    * chibios_fatfs::FatFSFilesPool                                          *
    *------------------------------------------------------------------------*/
@@ -201,10 +259,44 @@ namespace chibios_fatfs {
     return NULL;
   }
 
+  BaseStreamingFileInterface *FatFSWrapper::createStreaming(const char *fname,
+                                                            fileoffset_t size,
+                                                            fileoffset_t interval) {
+
+#if FATFS_USE_STREAMING
+    for (unsigned i = 0; i < FATFS_MAX_STREAMS; i++) {
+      if (!streams[i].inuse) {
+        if (fatfsStreamOpen(&streams[i].stream, fname, size, interval) != FR_OK)
+          return NULL;
+        streams[i].inuse = true;
+        streams[i].lasterr = 0;
+        return &streams[i];
+      }
+    }
+#else
+    (void)fname;
+    (void)size;
+    (void)interval;
+#endif
+    return NULL;
+  }
+
   void FatFSWrapper::close(BaseFileStreamInterface *file) {
 
     (void)file;
   }
+
+  void FatFSWrapper::close(BaseStreamingFileInterface *file) {
+
+#if FATFS_USE_STREAMING
+    FatFSStreamWrapper *sfp = static_cast<FatFSStreamWrapper *>(file);
+
+    (void)fatfsStreamClose(&sfp->stream);
+    sfp->inuse = false;
+#else
+    (void)file;
+#endif
+  }
 }
 
 /** @} */
@@ -53,6 +53,26 @@
 #define FATFS_MAX_FILES                 16
 #endif
 
+/**
+ * @brief   Enables the streaming files support.
+ * @note    Streaming files require FatFs to be linked with the
+ *          @p _USE_FASTSEEK option enabled.
+ */
+#if !defined(FATFS_USE_STREAMING) || defined(__DOXYGEN__)
+#define FATFS_USE_STREAMING             FALSE
+#endif
+
+/**
+ * @brief   Maximum number of open streaming files.
+ */
+#if !defined(FATFS_MAX_STREAMS) || defined(__DOXYGEN__)
+#define FATFS_MAX_STREAMS               2
+#endif
+
+#if FATFS_USE_STREAMING || defined(__DOXYGEN__)
+#include "fatfs_stream.h"
+#endif
+
 using namespace chibios_rt;
 using namespace chibios_fs;
 
@@ -86,6 +106,34 @@ namespace chibios_fatfs {
     virtual uint32_t setPosition(fileoffset_t offset);
   };
 
+#if FATFS_USE_STREAMING || defined(__DOXYGEN__)
+  /*------------------------------------------------------------------------*
+   * chibios_fatfs::FatFSStreamWrapper                                      *
+   *------------------------------------------------------------------------*/
+  /**
+   * @brief   Class of a streaming file.
+   */
+  class FatFSStreamWrapper : public BaseStreamingFileInterface {
+    friend class FatFSWrapper;
+
+  protected:
+    FatFSStream stream;
+    bool inuse;
+    uint32_t lasterr;
+
+  public:
+    FatFSStreamWrapper(void);
+
+    virtual size_t write(const uint8_t *bp, size_t n);
+    virtual size_t read(uint8_t *bp, size_t n);
+    virtual msg_t put(uint8_t b);
+    virtual msg_t get(void);
+    virtual uint32_t getAndClearLastError(void);
+    virtual fileoffset_t getSize(void);
+    virtual uint32_t checkpoint(void);
+  };
+#endif /* FATFS_USE_STREAMING */
+
   /*------------------------------------------------------------------------*
    * chibios_fatfs::FatFSFilesPool                                          *
    *------------------------------------------------------------------------*/
@@ -125,6 +173,9 @@ namespace chibios_fatfs {
 
   protected:
     FatFSServerThread server;
+#if FATFS_USE_STREAMING || defined(__DOXYGEN__)
+    FatFSStreamWrapper streams[FATFS_MAX_STREAMS];
+#endif
 
   public:
     FatFSWrapper(void);
@@ -135,7 +186,11 @@ namespace chibios_fatfs {
     virtual BaseFileStreamInterface *openForRead(const char *fname);
     virtual BaseFileStreamInterface *openForWrite(const char *fname);
     virtual BaseFileStreamInterface *create(const char *fname);
+    virtual BaseStreamingFileInterface *createStreaming(const char *fname,
+                                                        fileoffset_t size,
+                                                        fileoffset_t interval);
     virtual void close(BaseFileStreamInterface *file);
+    virtual void close(BaseStreamingFileInterface *file);
 
     /**
      * @brief   Mounts the file system.
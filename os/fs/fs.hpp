@@ -106,6 +106,52 @@ namespace chibios_fs {
     virtual uint32_t setPosition(fileoffset_t offset) = 0;
   };
 
+  /*------------------------------------------------------------------------*
+   * chibios_fs::BaseStreamingFileInterface                                 *
+   *------------------------------------------------------------------------*/
+  /**
+   * @brief   Interface of an abstract streaming file object.
+   * @details A streaming file is a write only file with preallocated space,
+   *          data is appended directly to the media bypassing the file
+   *          system caches and the file system metadata is only updated
+   *          at checkpoints.
+   * @note    Writes of whole sectors from suitably aligned buffers are
+   *          transferred without copies.
+   */
+  class BaseStreamingFileInterface : public chibios_rt::BaseSequentialStreamInterface {
+  public:
+    /**
+     * @brief   Returns an implementation dependent error code.
+     *
+     * @return              An implementation-dependent error code.
+     *
+     * @api
+     */
+    virtual uint32_t getAndClearLastError(void) = 0;
+
+    /**
+     * @brief   Returns the number of bytes written so far.
+     *
+     * @return              The file size.
+     *
+     * @api
+     */
+    virtual fileoffset_t getSize(void) = 0;
+
+    /**
+     * @brief   Records the written data in the file system metadata.
+     * @details After a power loss the file contains all the data written
+     *          before the last checkpoint.
+     *
+     * @return              The operation status.
+     * @retval FILE_OK      if no error.
+     * @retval FILE_ERROR   if the operation failed.
+     *
+     * @api
+     */
+    virtual uint32_t checkpoint(void) = 0;
+  };
+
   /*------------------------------------------------------------------------*
    * chibios_fs::BaseFileSystemInterface                                    *
    *------------------------------------------------------------------------*/
@@ -185,12 +231,39 @@ namespace chibios_fs {
      */
     virtual BaseFileStreamInterface *create(const char *fname) = 0;
 
+    /**
+     * @brief   Creates a streaming file.
+     * @details If a file with the same name already exists then it is
+     *          overwritten. The space for @p size bytes is allocated
+     *          immediately.
+     *
+     * @param[in] fname     file name
+     * @param[in] size      maximum file size
+     * @param[in] interval  bytes between automatic checkpoints, zero
+     *                      disables automatic checkpoints
+     * @return              An interface of a streaming file object.
+     * @retval NULL         if the operation failed.
+     *
+     * @api
+     */
+    virtual BaseStreamingFileInterface *createStreaming(const char *fname,
+                                                        fileoffset_t size,
+                                                        fileoffset_t interval) = 0;
+
     /**
      * @brief   Closes a file.
      *
      * @api
      */
     virtual void close(BaseFileStreamInterface *file) = 0;
+
+    /**
+     * @brief   Closes a streaming file.
+     * @details The unused preallocated space is released.
+     *
+     * @api
+     */
+    virtual void close(BaseStreamingFileInterface *file) = 0;
   };
 }
 #endif /* _FS_HPP_ */
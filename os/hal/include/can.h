@@ -83,6 +83,35 @@
 #if !defined(CAN_USE_SLEEP_MODE) || defined(__DOXYGEN__)
 #define CAN_USE_SLEEP_MODE          TRUE
 #endif
+
+/**
+ * @brief   Software queues inclusion switch.
+ * @details If enabled the received frames are moved by the ISR into a
+ *          software queue and the frames to be transmitted are queued in
+ *          priority order, the hardware mailboxes are refilled by the
+ *          transmit ISR. The mailbox parameter of @p canTransmit() and
+ *          @p canReceive() must be @p CAN_ANY_MAILBOX.
+ * @note    This option can only be enabled if the CAN implementation
+ *          supports it, see the macro @p CAN_SUPPORTS_QUEUES exported by
+ *          the underlying implementation.
+ */
+#if !defined(CAN_USE_QUEUES) || defined(__DOXYGEN__)
+#define CAN_USE_QUEUES              FALSE
+#endif
+
+/**
+ * @brief   Receive queue size in frames.
+ */
+#if !defined(CAN_RX_QUEUE_SIZE) || defined(__DOXYGEN__)
+#define CAN_RX_QUEUE_SIZE           16
+#endif
+
+/**
+ * @brief   Transmit queue size in frames.
+ */
+#if !defined(CAN_TX_QUEUE_SIZE) || defined(__DOXYGEN__)
+#define CAN_TX_QUEUE_SIZE           8
+#endif
 /** @} */
 
 /*===========================================================================*/
@@ -93,6 +122,10 @@
 #error "CAN driver requires CH_USE_SEMAPHORES and CH_USE_EVENTS"
 #endif
 
+#if CAN_USE_QUEUES && ((CAN_RX_QUEUE_SIZE < 1) || (CAN_TX_QUEUE_SIZE < 1))
+#error "invalid CAN queues size"
+#endif
+
 /*===========================================================================*/
 /* Driver data structures and types.                                         */
 /*===========================================================================*/
@@ -108,6 +141,27 @@ typedef enum {
   CAN_SLEEP = 4                             /**< Sleep state.               */
 } canstate_t;
 
+/**
+ * @brief   Identifier filter.
+ * @details A received frame is accepted if its identifier, masked by
+ *          @p mask, is equal to @p id. The low level driver compiles a
+ *          table of these filters into the hardware filters.
+ */
+typedef struct {
+  /**
+   * @brief   Standard or extended identifier.
+   */
+  uint32_t                  id;
+  /**
+   * @brief   Identifier bits to be compared, all ones for an exact match.
+   */
+  uint32_t                  mask;
+  /**
+   * @brief   Identifier type, @p CAN_IDE_STD or @p CAN_IDE_EXT.
+   */
+  uint8_t                   ide;
+} CANIdFilter;
+
 #include "can_lld.h"
 
 /*===========================================================================*/
@@ -143,6 +197,21 @@ extern "C" {
                    canmbx_t mailbox,
                    CANRxFrame *crfp,
                    systime_t timeout);
+  bool_t canSetIdFilters(CANDriver *canp,
+                         const CANIdFilter *cifp,
+                         size_t n);
+#if CAN_USE_QUEUES
+  size_t canTransmitBatch(CANDriver *canp,
+                          const CANTxFrame *ctfp,
+                          size_t n,
+                          systime_t timeout);
+  size_t canReceiveBatch(CANDriver *canp,
+                         CANRxFrame *crfp,
+                         size_t n,
+                         systime_t timeout);
+  void canIncomingFrameI(CANDriver *canp, const CANRxFrame *crfp);
+  msg_t canRequestFrameI(CANDriver *canp, CANTxFrame *ctfp);
+#endif /* CAN_USE_QUEUES */
 #if CAN_USE_SLEEP_MODE
   void canSleep(CANDriver *canp);
   void canWakeup(CANDriver *canp);
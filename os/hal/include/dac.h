@@ -35,6 +35,15 @@
 /* Driver constants.                                                         */
 /*===========================================================================*/
 
+/**
+ * @name    Stream event flags
+ * @{
+ */
+#define DAC_STREAM_UNDERRUN         1   /**< Idle samples were output.      */
+#define DAC_STREAM_LOW_WATER        2   /**< Ring below the low watermark.  */
+#define DAC_STREAM_ERROR            4   /**< Conversion stopped by an error.*/
+/** @} */
+
 /*===========================================================================*/
 /* Driver pre-compile time settings.                                         */
 /*===========================================================================*/
@@ -58,6 +67,16 @@
 #if !defined(DAC_USE_MUTUAL_EXCLUSION) || defined(__DOXYGEN__)
 #define DAC_USE_MUTUAL_EXCLUSION    TRUE
 #endif
+
+/**
+ * @brief   Enables the streaming APIs.
+ * @details A producer thread writes samples into a ring buffer, the ring
+ *          refills the halves of the circular conversion buffer.
+ * @note    Disabling this option saves both code and data space.
+ */
+#if !defined(DAC_USE_STREAMING) || defined(__DOXYGEN__)
+#define DAC_USE_STREAMING           FALSE
+#endif
 /** @} */
 
 /*===========================================================================*/
@@ -68,6 +87,10 @@
 #error "DAC_USE_MUTUAL_EXCLUSION requires CH_USE_MUTEXES and/or CH_USE_SEMAPHORES"
 #endif
 
+#if DAC_USE_STREAMING && !CH_USE_EVENTS
+#error "DAC_USE_STREAMING requires CH_USE_EVENTS"
+#endif
+
 /*===========================================================================*/
 /* Driver data structures and types.                                         */
 /*===========================================================================*/
@@ -84,8 +107,98 @@ typedef enum {
   DAC_ERROR = 5 			        /**< Error.                             */
 } dacstate_t;
 
+/**
+ * @brief   Format of the samples written into a stream.
+ */
+typedef enum {
+  DAC_FMT_NATIVE = 0,               /**< Already in @p dacsample_t format.  */
+  DAC_FMT_U8 = 1,                   /**< Unsigned 8 bits.                   */
+  DAC_FMT_S16 = 2,                  /**< Signed 16 bits.                    */
+  DAC_FMT_U16 = 3,                  /**< Unsigned 16 bits.                  */
+  DAC_FMT_S32 = 4                   /**< Signed 32 bits.                    */
+} dacsformat_t;
+
+/**
+ * @brief   Type of a stream configuration structure.
+ */
+typedef struct DACStreamConfig DACStreamConfig;
+
+/**
+ * @brief   Stream statistics.
+ */
+typedef struct {
+  /**
+   * @brief   Rows written by the producer.
+   */
+  uint32_t                  written;
+  /**
+   * @brief   Half buffers refilled with idle rows.
+   */
+  uint32_t                  underruns;
+  /**
+   * @brief   Idle rows output because of underruns.
+   */
+  uint32_t                  idle;
+  /**
+   * @brief   Lowest ring level observed after a refill, in rows.
+   */
+  size_t                    min_level;
+} DACStreamStats;
+
 #include "dac_lld.h"
 
+#if DAC_USE_STREAMING || defined(__DOXYGEN__)
+/**
+ * @brief   Stream configuration structure.
+ */
+struct DACStreamConfig {
+  /**
+   * @brief   Conversion group, must be circular.
+   * @note    The group callback is not invoked while streaming.
+   */
+  const DACConversionGroup  *grpp;
+  /**
+   * @brief   Circular conversion buffer.
+   */
+  dacsample_t               *buffer;
+  /**
+   * @brief   Conversion buffer depth in rows, must be even.
+   */
+  size_t                    depth;
+  /**
+   * @brief   Ring buffer.
+   */
+  dacsample_t               *ring;
+  /**
+   * @brief   Ring buffer size in rows.
+   * @note    Must be at least @p depth, the conversion starts when the
+   *          ring contains enough rows for filling the whole conversion
+   *          buffer.
+   */
+  size_t                    size;
+  /**
+   * @brief   Format of the samples written by the producer.
+   */
+  dacsformat_t              format;
+  /**
+   * @brief   Converter resolution in bits, from 1 to 16.
+   * @details Samples are converted to unsigned values right aligned on
+   *          this number of bits.
+   */
+  unsigned                  bits;
+  /**
+   * @brief   Low watermark in rows.
+   * @details The @p DAC_STREAM_LOW_WATER flag is broadcast when the ring
+   *          level falls below this threshold.
+   */
+  size_t                    low_water;
+  /**
+   * @brief   Sample output on underruns.
+   */
+  dacsample_t               idle;
+};
+#endif /* DAC_USE_STREAMING */
+
 /*===========================================================================*/
 /* Driver macros.                                                            */
 /*===========================================================================*/
@@ -190,10 +303,25 @@ typedef enum {
 #define _dac_timeout_isr(dacp)
 #endif /* !DAC_USE_WAIT */
 
+#if DAC_USE_STREAMING || defined(__DOXYGEN__)
+/**
+ * @brief   Checks if the conversion is feeding a stream.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object
+ *
+ * @notapi
+ */
+#define _dac_is_streaming(dacp) ((dacp)->strcfg != NULL)
+#else /* !DAC_USE_STREAMING */
+#define _dac_is_streaming(dacp) FALSE
+#define _dac_stream_isr(dacp, offset, n)
+#define _dac_stream_error_isr(dacp)
+#endif /* !DAC_USE_STREAMING */
+
 /**
  * @brief   Common ISR code, half buffer event.
  * @details This code handles the portable part of the ISR code:
- *          - Callback invocation.
+ *          - Callback invocation or stream refill.
  *          .
  * @note    This macro is meant to be used in the low level drivers
  *          implementation only.
@@ -203,7 +331,10 @@ typedef enum {
  * @notapi
  */
 #define _dac_isr_half_code(dacp) {                                          \
-  if ((dacp)->grpp->end_cb != NULL) {                                       \
+  if (_dac_is_streaming(dacp)) {                                            \
+    _dac_stream_isr(dacp, 0, (dacp)->depth / 2);                            \
+  }                                                                         \
+  else if ((dacp)->grpp->end_cb != NULL) {                                  \
     (dacp)->grpp->end_cb(dacp, (dacp)->samples, (dacp)->depth / 2);         \
   }                                                                         \
 }
@@ -211,7 +342,7 @@ typedef enum {
 /**
  * @brief   Common ISR code, full buffer event.
  * @details This code handles the portable part of the ISR code:
- *          - Callback invocation.
+ *          - Callback invocation or stream refill.
  *          - Waiting thread wakeup, if any.
  *          - Driver state transitions.
  *          .
@@ -225,7 +356,10 @@ typedef enum {
 #define _dac_isr_full_code(dacp) {                                          \
   if ((dacp)->grpp->circular) {                                             \
     /* Callback handling.*/                                                 \
-    if ((dacp)->grpp->end_cb != NULL) {                                     \
+    if (_dac_is_streaming(dacp)) {                                          \
+      _dac_stream_isr(dacp, (dacp)->depth / 2, (dacp)->depth / 2);          \
+    }                                                                       \
+    else if ((dacp)->grpp->end_cb != NULL) {                                \
       if ((dacp)->depth > 1) {                                              \
         /* Invokes the callback passing the 2nd half of the buffer.*/       \
         size_t half = (dacp)->depth / 2;                                    \
@@ -290,6 +424,9 @@ typedef enum {
       (dacp)->state = DAC_READY;                                            \
   }                                                                         \
   (dacp)->grpp = NULL;                                                      \
+  if (_dac_is_streaming(dacp)) {                                            \
+    _dac_stream_error_isr(dacp);                                            \
+  }                                                                         \
   _dac_timeout_isr(dacp);                                                   \
 }
 /** @} */
@@ -319,6 +456,16 @@ extern "C" {
   void dacAcquireBus(DACDriver *dacp);
   void dacReleaseBus(DACDriver *dacp);
 #endif /* DAC_USE_MUTUAL_EXCLUSION */
+#if DAC_USE_STREAMING || defined(__DOXYGEN__)
+  void dacStartStream(DACDriver *dacp, const DACStreamConfig *config);
+  void dacStopStream(DACDriver *dacp);
+  size_t dacWriteStream(DACDriver *dacp, const void *buf, size_t n,
+                        systime_t timeout);
+  msg_t dacDrainStream(DACDriver *dacp, systime_t timeout);
+  void dacGetStreamStats(DACDriver *dacp, DACStreamStats *dssp);
+  void _dac_stream_isr(DACDriver *dacp, size_t offset, size_t n);
+  void _dac_stream_error_isr(DACDriver *dacp);
+#endif /* DAC_USE_STREAMING */
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,289 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006,2007,2008,2009,2010,
+                 2011,2012,2013 Giovanni Di Sirio.
+
+    This file is part of ChibiOS/RT.
+
+    ChibiOS/RT is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    ChibiOS/RT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file    ftl.h
+ * @brief   Log-structured flash translation layer header.
+ *
+ * @addtogroup FTL
+ * @{
+ */
+
+#ifndef _FTL_H_
+#define _FTL_H_
+
+#if HAL_USE_FTL || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Magic number marking a formatted sector.
+ */
+#define FTL_MAGIC                   0x4C544643
+
+/**
+ * @brief   Size of the sector header in the summary area.
+ */
+#define FTL_HEADER_SIZE             24
+
+/**
+ * @brief   Size of a page tag in the summary area.
+ */
+#define FTL_TAG_SIZE                8
+
+/**
+ * @brief   Unmapped entry marker in the translation map.
+ */
+#define FTL_UNMAPPED                0xFFFFFFFF
+
+/**
+ * @name    Sector states
+ * @{
+ */
+#define FTL_SECTOR_DIRTY            0   /**< Needs erase before use.        */
+#define FTL_SECTOR_FREE             1   /**< Erased and formatted.          */
+#define FTL_SECTOR_USED             2   /**< Contains data.                 */
+/** @} */
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @name    FTL configuration options
+ * @{
+ */
+/**
+ * @brief   Static wear leveling threshold.
+ * @details When the difference between the most erased sector and the
+ *          least erased in-use sector exceeds this value the garbage
+ *          collector relocates the cold sector content regardless of its
+ *          number of valid pages.
+ */
+#if !defined(FTL_WEAR_LEVELING_THRESHOLD) || defined(__DOXYGEN__)
+#define FTL_WEAR_LEVELING_THRESHOLD 32
+#endif
+/** @} */
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Per sector runtime information.
+ */
+typedef struct {
+  /**
+   * @brief Sequence number assigned when the sector was opened.
+   */
+  uint32_t              seq;
+  /**
+   * @brief Number of times the sector has been erased.
+   */
+  uint32_t              erase_count;
+  /**
+   * @brief Number of data pages still referenced by the map.
+   */
+  uint16_t              valid;
+  /**
+   * @brief Sector state.
+   */
+  uint8_t               state;
+} ftl_sector_t;
+
+/**
+ * @brief   FTL driver configuration structure.
+ * @note    The arrays must be sized using the @p FTL_MAP_SIZE() macro and
+ *          the number of sectors of the underlying device.
+ */
+typedef struct {
+  /**
+   * @brief Flash device associated to this FTL driver.
+   */
+  BaseFlash             *flashp;
+  /**
+   * @brief Number of sectors kept in reserve for garbage collection.
+   * @note  Must be at least two.
+   */
+  uint32_t              reserved;
+  /**
+   * @brief Logical to physical translation map.
+   */
+  uint32_t              *map;
+  /**
+   * @brief Sectors information array.
+   */
+  ftl_sector_t          *sectors;
+  /**
+   * @brief Work buffer, it must be one page large.
+   */
+  uint8_t               *buffer;
+} FTLConfig;
+
+/**
+ * @brief   @p FTLDriver specific methods.
+ */
+#define _ftl_driver_methods                                                 \
+  _base_block_device_methods
+
+/**
+ * @extends BaseBlockDeviceVMT
+ *
+ * @brief   @p FTLDriver virtual methods table.
+ */
+struct FTLDriverVMT {
+  _ftl_driver_methods
+};
+
+/**
+ * @extends BaseBlockDevice
+ *
+ * @brief   Structure representing a FTL driver.
+ */
+typedef struct {
+  /**
+   * @brief Virtual Methods Table.
+   */
+  const struct FTLDriverVMT *vmt;
+  _base_block_device_data
+  /**
+   * @brief Current configuration data.
+   */
+  const FTLConfig       *config;
+  /**
+   * @brief Geometry of the underlying device.
+   */
+  FlashDeviceInfo       info;
+  /**
+   * @brief Pages used by the summary area of each sector.
+   */
+  uint32_t              summary_pages;
+  /**
+   * @brief Data pages in each sector.
+   */
+  uint32_t              data_pages;
+  /**
+   * @brief Number of exported logical blocks.
+   */
+  uint32_t              blocks_num;
+  /**
+   * @brief Number of free sectors.
+   */
+  uint32_t              free_sectors;
+  /**
+   * @brief Sector currently receiving appends or @p FTL_UNMAPPED.
+   */
+  uint32_t              head;
+  /**
+   * @brief Next free data page in the head sector.
+   */
+  uint32_t              next;
+  /**
+   * @brief Last assigned sequence number.
+   */
+  uint32_t              seq;
+  /**
+   * @brief Logical blocks written by the user.
+   */
+  uint32_t              writes;
+  /**
+   * @brief Pages relocated by the garbage collector.
+   */
+  uint32_t              relocations;
+  /**
+   * @brief Sectors erased.
+   */
+  uint32_t              erases;
+} FTLDriver;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/**
+ * @name    Geometry helper macros
+ * @{
+ */
+/**
+ * @brief   Pages occupied by the summary area of a sector.
+ *
+ * @param[in] psize     page size in bytes
+ * @param[in] ssize     sector size in bytes
+ */
+#define FTL_SUMMARY_PAGES(psize, ssize)                                     \
+  ((FTL_HEADER_SIZE + FTL_TAG_SIZE * ((ssize) / (psize)) +                  \
+    (psize) + FTL_TAG_SIZE - 1) / ((psize) + FTL_TAG_SIZE))
+
+/**
+ * @brief   Data pages in a sector.
+ *
+ * @param[in] psize     page size in bytes
+ * @param[in] ssize     sector size in bytes
+ */
+#define FTL_DATA_PAGES(psize, ssize)                                        \
+  ((ssize) / (psize) - FTL_SUMMARY_PAGES(psize, ssize))
+
+/**
+ * @brief   Size of the translation map, also the number of logical blocks.
+ *
+ * @param[in] psize     page size in bytes
+ * @param[in] ssize     sector size in bytes
+ * @param[in] snum      number of sectors
+ * @param[in] reserved  number of reserved sectors
+ */
+#define FTL_MAP_SIZE(psize, ssize, snum, reserved)                          \
+  (FTL_DATA_PAGES(psize, ssize) * ((snum) - (reserved)))
+/** @} */
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void ftlInit(void);
+  void ftlObjectInit(FTLDriver *ftlp);
+  void ftlStart(FTLDriver *ftlp, const FTLConfig *config);
+  void ftlStop(FTLDriver *ftlp);
+  bool_t ftlConnect(FTLDriver *ftlp);
+  bool_t ftlDisconnect(FTLDriver *ftlp);
+  bool_t ftlRead(FTLDriver *ftlp, uint32_t startblk,
+                 uint8_t *buffer, uint32_t n);
+  bool_t ftlWrite(FTLDriver *ftlp, uint32_t startblk,
+                  const uint8_t *buffer, uint32_t n);
+  bool_t ftlSync(FTLDriver *ftlp);
+  bool_t ftlGetInfo(FTLDriver *ftlp, BlockDeviceInfo *bdip);
+  bool_t ftlCollect(FTLDriver *ftlp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_FTL */
+
+#endif /* _FTL_H_ */
+
+/** @} */
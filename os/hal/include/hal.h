@@ -38,6 +38,7 @@
 /* Abstract interfaces.*/
 #include "io_channel.h"
 #include "io_block.h"
+#include "io_flash.h"
 
 /* Shared headers.*/
 #include "mmcsd.h"
@@ -64,6 +65,7 @@
 /* Complex drivers.*/
 #include "mmc_spi.h"
 #include "serial_usb.h"
+#include "ftl.h"
 
 /*===========================================================================*/
 /* Driver constants.                                                         */
@@ -65,6 +65,19 @@
 #define I2C_USE_MUTUAL_EXCLUSION    TRUE
 #endif
 
+/**
+ * @brief   Enables the asynchronous transactions APIs.
+ * @details Transactions are queued by priority and executed back to back
+ *          from the driver ISR, completion is notified by callback or by
+ *          waking the waiting thread.
+ * @note    This option can only be enabled if the I2C implementation
+ *          supports it, see the macro @p I2C_SUPPORTS_TRANSACTIONS exported
+ *          by the underlying implementation.
+ */
+#if !defined(I2C_USE_TRANSACTIONS) || defined(__DOXYGEN__)
+#define I2C_USE_TRANSACTIONS        FALSE
+#endif
+
 /*===========================================================================*/
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
@@ -89,8 +102,88 @@ typedef enum {
   I2C_LOCKED = 5                            /**> Bus or driver locked.      */
 } i2cstate_t;
 
+/**
+ * @brief   Type of a structure representing a transaction.
+ */
+typedef struct I2CTransaction I2CTransaction;
+
 #include "i2c_lld.h"
 
+#if I2C_USE_TRANSACTIONS || defined(__DOXYGEN__)
+/**
+ * @brief   Transaction completion callback type.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] itp       pointer to the completed @p I2CTransaction object
+ */
+typedef void (*i2ctxncb_t)(I2CDriver *i2cp, I2CTransaction *itp);
+
+/**
+ * @brief   Structure representing a transaction.
+ * @details A transaction writes @p txbytes bytes then reads @p rxbytes
+ *          bytes after a repeated start, one of the two phases can be
+ *          empty.
+ */
+struct I2CTransaction {
+  /**
+   * @brief   Next transaction in the driver queue.
+   */
+  I2CTransaction            *next;
+  /**
+   * @brief   Slave device address (7 bits) without R/W bit.
+   */
+  i2caddr_t                 addr;
+  /**
+   * @brief   Transmit buffer.
+   */
+  const uint8_t             *txbuf;
+  /**
+   * @brief   Number of bytes to be transmitted.
+   */
+  size_t                    txbytes;
+  /**
+   * @brief   Receive buffer.
+   */
+  uint8_t                   *rxbuf;
+  /**
+   * @brief   Number of bytes to be received.
+   */
+  size_t                    rxbytes;
+  /**
+   * @brief   Transaction timeout or @p TIME_INFINITE.
+   * @details The time is measured from the transaction start on the bus,
+   *          not from its queuing.
+   */
+  systime_t                 timeout;
+  /**
+   * @brief   Completion callback or @p NULL.
+   * @note    The callback is invoked from ISR context.
+   */
+  i2ctxncb_t                end_cb;
+  /**
+   * @brief   Queuing priority.
+   */
+  tprio_t                   prio;
+  /**
+   * @brief   The transaction is queued or being executed.
+   */
+  bool_t                    pending;
+  /**
+   * @brief   Completion status, same values returned by
+   *          @p i2cMasterTransmitTimeout().
+   */
+  msg_t                     status;
+  /**
+   * @brief   Error flags at the transaction end.
+   */
+  i2cflags_t                errors;
+  /**
+   * @brief   Thread waiting for the transaction completion.
+   */
+  Thread                    *thread;
+};
+#endif /* I2C_USE_TRANSACTIONS */
+
 /*===========================================================================*/
 /* Driver macros.                                                            */
 /*===========================================================================*/
@@ -110,6 +203,24 @@ typedef enum {
 #define i2cMasterReceive(i2cp, addr, rxbuf, rxbytes)                        \
   (i2cMasterReceiveTimeout(i2cp, addr, rxbuf, rxbytes, TIME_INFINITE))
 
+#if I2C_USE_TRANSACTIONS || defined(__DOXYGEN__)
+/**
+ * @brief   Static transaction initializer.
+ *
+ * @param[in] addr      slave device address (7 bits) without R/W bit
+ * @param[in] txbuf     pointer to transmit buffer
+ * @param[in] txbytes   number of bytes to be transmitted
+ * @param[out] rxbuf    pointer to receive buffer
+ * @param[in] rxbytes   number of bytes to be received
+ * @param[in] end_cb    the completion callback or @p NULL
+ */
+#define _I2C_TRANSACTION_DATA(addr, txbuf, txbytes, rxbuf, rxbytes,         \
+                              end_cb) {                                     \
+  NULL, (addr), (txbuf), (txbytes), (rxbuf), (rxbytes), TIME_INFINITE,      \
+  (end_cb), 0, FALSE, RDY_OK, I2CD_NO_ERROR, NULL                           \
+}
+#endif /* I2C_USE_TRANSACTIONS */
+
 /*===========================================================================*/
 /* External declarations.                                                    */
 /*===========================================================================*/
@@ -135,6 +246,13 @@ extern "C" {
   void i2cAcquireBus(I2CDriver *i2cp);
   void i2cReleaseBus(I2CDriver *i2cp);
 #endif /* I2C_USE_MUTUAL_EXCLUSION */
+#if I2C_USE_TRANSACTIONS
+  void i2cStartTransactionI(I2CDriver *i2cp, I2CTransaction *itp);
+  void i2cStartTransaction(I2CDriver *i2cp, I2CTransaction *itp);
+  msg_t i2cTransaction(I2CDriver *i2cp, I2CTransaction *itp);
+  msg_t i2cTransactionBatch(I2CDriver *i2cp, I2CTransaction *itp, size_t n);
+  void _i2c_txn_isr(I2CDriver *i2cp, msg_t msg);
+#endif /* I2C_USE_TRANSACTIONS */
 
 #ifdef __cplusplus
 }
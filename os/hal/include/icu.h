@@ -39,6 +39,22 @@
 /* Driver pre-compile time settings.                                         */
 /*===========================================================================*/
 
+/**
+ * @name    ICU configuration options
+ * @{
+ */
+/**
+ * @brief   Enables the capture APIs.
+ * @details The edge timestamps are logged into a ring buffer by the low
+ *          level driver, usually using a circular DMA, and fetched by a
+ *          thread in batches instead of invoking a callback for each edge.
+ * @note    Disabling this option saves both code and data space.
+ */
+#if !defined(ICU_USE_CAPTURE) || defined(__DOXYGEN__)
+#define ICU_USE_CAPTURE             FALSE
+#endif
+/** @} */
+
 /*===========================================================================*/
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
@@ -57,6 +73,7 @@ typedef enum {
   ICU_WAITING = 3,                  /**< Waiting first edge.                */
   ICU_ACTIVE = 4,                   /**< Active cycle phase.                */
   ICU_IDLE = 5,                     /**< Idle cycle phase.                  */
+  ICU_CAPTURING = 6                 /**< Logging edges into a ring.         */
 } icustate_t;
 
 /**
@@ -71,8 +88,126 @@ typedef struct ICUDriver ICUDriver;
  */
 typedef void (*icucallback_t)(ICUDriver *icup);
 
+/**
+ * @brief   Type of a capture configuration structure.
+ */
+typedef struct ICUCaptureConfig ICUCaptureConfig;
+
+/**
+ * @brief   Capture statistics.
+ */
+typedef struct {
+  /**
+   * @brief   Edges logged by the low level driver.
+   */
+  uint32_t                  edges;
+  /**
+   * @brief   Edges overwritten before being fetched.
+   */
+  uint32_t                  lost;
+  /**
+   * @brief   Batches fetched.
+   */
+  uint32_t                  batches;
+  /**
+   * @brief   Highest number of edges waiting in the ring.
+   */
+  size_t                    high_water;
+} ICUCaptureStats;
+
 #include "icu_lld.h"
 
+#if ICU_USE_CAPTURE || defined(__DOXYGEN__)
+/**
+ * @brief   Capture configuration structure.
+ */
+struct ICUCaptureConfig {
+  /**
+   * @brief   Ring buffer.
+   * @details The low level driver writes the counter value of each edge,
+   *          active and idle edges alternate starting from an active edge.
+   *          The counter must be free running, periods and widths are
+   *          differences modulo the counter size.
+   */
+  icucnt_t                  *ring;
+  /**
+   * @brief   Ring buffer size in edges.
+   * @note    Must be a power of two, the ring is written in halves so at
+   *          most half ring can wait for the reader.
+   */
+  size_t                    size;
+};
+
+/**
+ * @brief   Batch of captured edges.
+ */
+typedef struct {
+  /**
+   * @brief   Edges buffer.
+   */
+  icucnt_t                  *edges;
+  /**
+   * @brief   Edges buffer size.
+   */
+  size_t                    max;
+  /**
+   * @brief   Edges in the batch.
+   */
+  size_t                    n;
+  /**
+   * @brief   Sequence number of the first edge.
+   * @details Even numbers are active edges, odd numbers are idle edges.
+   */
+  uint32_t                  first;
+  /**
+   * @brief   Edges lost just before this batch.
+   */
+  uint32_t                  lost;
+} ICUBatch;
+
+/**
+ * @brief   Measurements over a sequence of batches.
+ * @details Only the complete cycles, active edge to active edge with the
+ *          idle edge in between, contribute to the period and width
+ *          totals. Lost edges break the sequence but are still counted
+ *          as pulses.
+ */
+typedef struct {
+  /**
+   * @brief   Active edges, including the lost ones.
+   */
+  uint32_t                  pulses;
+  /**
+   * @brief   Complete cycles measured.
+   */
+  uint32_t                  cycles;
+  /**
+   * @brief   Total ticks of the complete cycles.
+   */
+  uint32_t                  period;
+  /**
+   * @brief   Total active ticks of the complete cycles.
+   */
+  uint32_t                  width;
+  /**
+   * @brief   Sequence number of the next expected edge.
+   */
+  uint32_t                  next;
+  /**
+   * @brief   Last active edge.
+   */
+  icucnt_t                  start;
+  /**
+   * @brief   Last idle edge.
+   */
+  icucnt_t                  stop;
+  /**
+   * @brief   Edges of the current cycle already seen.
+   */
+  uint8_t                   phase;
+} ICUMeasure;
+#endif /* ICU_USE_CAPTURE */
+
 /*===========================================================================*/
 /* Driver macros.                                                            */
 /*===========================================================================*/
@@ -170,6 +305,21 @@ typedef void (*icucallback_t)(ICUDriver *icup);
 }
 /** @} */
 
+#if ICU_USE_CAPTURE || defined(__DOXYGEN__)
+/**
+ * @name    Measurement helper macros
+ * @{
+ */
+/**
+ * @brief   Returns the active edges counted, including the lost ones.
+ *
+ * @param[in] mp        pointer to the @p ICUMeasure object
+ * @return              The number of pulses.
+ */
+#define icuMeasurePulses(mp) ((mp)->pulses)
+/** @} */
+#endif /* ICU_USE_CAPTURE */
+
 /*===========================================================================*/
 /* External declarations.                                                    */
 /*===========================================================================*/
@@ -183,6 +333,18 @@ extern "C" {
   void icuStop(ICUDriver *icup);
   void icuEnable(ICUDriver *icup);
   void icuDisable(ICUDriver *icup);
+#if ICU_USE_CAPTURE || defined(__DOXYGEN__)
+  void icuStartCapture(ICUDriver *icup, const ICUCaptureConfig *config);
+  void icuStopCapture(ICUDriver *icup);
+  msg_t icuFetchCapture(ICUDriver *icup, ICUBatch *bp, systime_t timeout);
+  void icuGetCaptureStats(ICUDriver *icup, ICUCaptureStats *icsp);
+  void icuMeasureReset(ICUMeasure *mp);
+  void icuMeasureBatch(ICUMeasure *mp, const ICUBatch *bp);
+  uint32_t icuMeasureFrequency(const ICUMeasure *mp, icufreq_t clock,
+                               uint32_t scale);
+  uint32_t icuMeasureDuty(const ICUMeasure *mp, uint32_t scale);
+  void _icu_capture_isr(ICUDriver *icup, size_t n);
+#endif /* ICU_USE_CAPTURE */
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,167 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006,2007,2008,2009,2010,
+                 2011,2012,2013 Giovanni Di Sirio.
+
+    This file is part of ChibiOS/RT.
+
+    ChibiOS/RT is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    ChibiOS/RT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file    io_flash.h
+ * @brief   I/O flash devices access.
+ * @details This header defines an abstract interface useful to access raw
+ *          flash memory devices in a standardized way.
+ *
+ * @addtogroup IO_FLASH
+ * @details This module defines an abstract interface for accessing raw
+ *          flash devices with erase-before-write semantics.<br>
+ *          The interface assumes NOR-like devices: the erased state is
+ *          all ones, programming can only clear bits, a programming page
+ *          can be programmed more than once as long as only erased bits
+ *          are touched and erasing operates on whole sectors.<br>
+ *          Note that no code is present, just abstract interfaces-like
+ *          structures, you should look at the system as to a set of
+ *          abstract C++ classes (even if written in C).
+ * @{
+ */
+
+#ifndef _IO_FLASH_H_
+#define _IO_FLASH_H_
+
+/**
+ * @brief   Value of an erased flash byte.
+ */
+#define FLASH_ERASED_VALUE          0xFF
+
+/**
+ * @brief   Flash device info.
+ */
+typedef struct {
+  uint32_t      page_size;          /**< @brief Programming page size.      */
+  uint32_t      sector_size;        /**< @brief Erase sector size.          */
+  uint32_t      sectors_num;        /**< @brief Total number of sectors.    */
+} FlashDeviceInfo;
+
+/**
+ * @brief   @p BaseFlash specific methods.
+ */
+#define _base_flash_methods                                                 \
+  /* Reads a range of bytes.*/                                              \
+  bool_t (*read)(void *instance, uint32_t offset,                           \
+                 uint8_t *buffer, size_t n);                                \
+  /* Programs a range of bytes, the range cannot cross a page boundary.*/   \
+  bool_t (*program)(void *instance, uint32_t offset,                        \
+                    const uint8_t *buffer, size_t n);                       \
+  /* Erases a sector.*/                                                     \
+  bool_t (*erase)(void *instance, uint32_t sector);                         \
+  /* Obtains info about the device geometry.*/                              \
+  bool_t (*get_info)(void *instance, FlashDeviceInfo *fdip);
+
+/**
+ * @brief   @p BaseFlash specific data.
+ * @note    It is empty because @p BaseFlash is only an interface without
+ *          implementation.
+ */
+#define _base_flash_data
+
+/**
+ * @brief   @p BaseFlash virtual methods table.
+ */
+struct BaseFlashVMT {
+  _base_flash_methods
+};
+
+/**
+ * @brief   Base flash device class.
+ * @details This class represents a generic, erase-before-write, flash
+ *          device.
+ */
+typedef struct {
+  /** @brief Virtual Methods Table.*/
+  const struct BaseFlashVMT *vmt;
+  _base_flash_data
+} BaseFlash;
+
+/**
+ * @name    Macro Functions (BaseFlash)
+ * @{
+ */
+/**
+ * @brief   Reads a range of bytes.
+ *
+ * @param[in] ip        pointer to a @p BaseFlash or derived class
+ * @param[in] offset    byte offset from the device start
+ * @param[out] buf      pointer to the read buffer
+ * @param[in] n         number of bytes to read
+ *
+ * @return              The operation status.
+ * @retval CH_SUCCESS   operation succeeded.
+ * @retval CH_FAILED    operation failed.
+ *
+ * @api
+ */
+#define flashRead(ip, offset, buf, n)                                       \
+  ((ip)->vmt->read(ip, offset, buf, n))
+
+/**
+ * @brief   Programs a range of bytes.
+ * @note    The range must not cross a programming page boundary.
+ *
+ * @param[in] ip        pointer to a @p BaseFlash or derived class
+ * @param[in] offset    byte offset from the device start
+ * @param[in] buf       pointer to the data to be programmed
+ * @param[in] n         number of bytes to program
+ *
+ * @return              The operation status.
+ * @retval CH_SUCCESS   operation succeeded.
+ * @retval CH_FAILED    operation failed.
+ *
+ * @api
+ */
+#define flashProgram(ip, offset, buf, n)                                    \
+  ((ip)->vmt->program(ip, offset, buf, n))
+
+/**
+ * @brief   Erases a sector.
+ *
+ * @param[in] ip        pointer to a @p BaseFlash or derived class
+ * @param[in] sector    sector number
+ *
+ * @return              The operation status.
+ * @retval CH_SUCCESS   operation succeeded.
+ * @retval CH_FAILED    operation failed.
+ *
+ * @api
+ */
+#define flashErase(ip, sector) ((ip)->vmt->erase(ip, sector))
+
+/**
+ * @brief   Returns the device geometry.
+ *
+ * @param[in] ip        pointer to a @p BaseFlash or derived class
+ * @param[out] fdip     pointer to a @p FlashDeviceInfo structure
+ *
+ * @return              The operation status.
+ * @retval CH_SUCCESS   operation succeeded.
+ * @retval CH_FAILED    operation failed.
+ *
+ * @api
+ */
+#define flashGetInfo(ip, fdip) ((ip)->vmt->get_info(ip, fdip))
+/** @} */
+
+#endif /* _IO_FLASH_H_ */
+
+/** @} */
@@ -73,6 +73,21 @@
 #if !defined(SERIAL_BUFFERS_SIZE) || defined(__DOXYGEN__)
 #define SERIAL_BUFFERS_SIZE         16
 #endif
+
+/**
+ * @brief   Block transfers enable switch.
+ * @details If set to @p TRUE the support for block transfers is included,
+ *          low level drivers able to move data in blocks, using DMA or
+ *          hardware FIFOs, exchange whole spans with the queues using
+ *          @p sdIncomingBlockI() and @p sdRequestBlockI() instead of
+ *          one byte per interrupt.
+ * @note    Low level drivers not supporting block transfers ignore this
+ *          setting.
+ * @note    The default is @p FALSE.
+ */
+#if !defined(SERIAL_USE_BLOCK_MODE) || defined(__DOXYGEN__)
+#define SERIAL_USE_BLOCK_MODE       FALSE
+#endif
 /** @} */
 
 /*===========================================================================*/
@@ -305,6 +320,10 @@ extern "C" {
   void sdStop(SerialDriver *sdp);
   void sdIncomingDataI(SerialDriver *sdp, uint8_t b);
   msg_t sdRequestDataI(SerialDriver *sdp);
+#if SERIAL_USE_BLOCK_MODE
+  size_t sdIncomingBlockI(SerialDriver *sdp, const uint8_t *bp, size_t n);
+  size_t sdRequestBlockI(SerialDriver *sdp, uint8_t *bp, size_t n);
+#endif
 #ifdef __cplusplus
 }
 #endif
@@ -93,6 +93,33 @@
 #if !defined(SERIAL_USB_BUFFERS_SIZE) || defined(__DOXYGEN__)
 #define SERIAL_USB_BUFFERS_SIZE     256
 #endif
+
+/**
+ * @brief   Enables the high throughput mode.
+ * @details If set to @p TRUE the data endpoints exchange multi-packet
+ *          transfers with linear buffers inside the driver instead of
+ *          feeding the endpoints from the queues. Each IN transfer takes
+ *          all the data in the output queue up to
+ *          @p SERIAL_USB_TRANSFER_SIZE bytes and the OUT endpoint is
+ *          double buffered, a new packet is armed as soon as the
+ *          previous one completes so that the host is not NAKed while
+ *          a thread is draining the input queue.
+ * @note    The default is @p FALSE.
+ */
+#if !defined(SERIAL_USB_USE_HIGH_THROUGHPUT) || defined(__DOXYGEN__)
+#define SERIAL_USB_USE_HIGH_THROUGHPUT  FALSE
+#endif
+
+/**
+ * @brief   Maximum size of a multi-packet IN transfer.
+ * @details Configuration parameter, the size must be a multiple of the
+ *          USB data endpoints maximum packet size. Three buffers of this
+ *          size are allocated in the driver structure.
+ * @note    The default is 512 bytes.
+ */
+#if !defined(SERIAL_USB_TRANSFER_SIZE) || defined(__DOXYGEN__)
+#define SERIAL_USB_TRANSFER_SIZE    512
+#endif
 /** @} */
 
 /*===========================================================================*/
@@ -104,6 +131,10 @@
        "CH_USE_EVENTS"
 #endif
 
+#if SERIAL_USB_USE_HIGH_THROUGHPUT && (SERIAL_USB_TRANSFER_SIZE < 8)
+#error "invalid SERIAL_USB_TRANSFER_SIZE value"
+#endif
+
 /*===========================================================================*/
 /* Driver data structures and types.                                         */
 /*===========================================================================*/
@@ -156,6 +187,27 @@ typedef struct {
   usbep_t                   int_in;
 } SerialUSBConfig;
 
+#if SERIAL_USB_USE_HIGH_THROUGHPUT || defined(__DOXYGEN__)
+/**
+ * @brief   High throughput mode specific data.
+ */
+#define _serial_usb_transfer_data                                           \
+  /* IN transfer buffer.*/                                                  \
+  uint8_t                   txbuf[SERIAL_USB_TRANSFER_SIZE];                \
+  /* OUT transfer buffers.*/                                                \
+  uint8_t                   rxbuf[2][SERIAL_USB_TRANSFER_SIZE];             \
+  /* Size of the received OUT transfers.*/                                  \
+  size_t                    rxsize[2];                                      \
+  /* OUT transfer buffer being moved into the input queue.*/                \
+  unsigned                  rxhead;                                         \
+  /* Number of received OUT transfer buffers.*/                             \
+  unsigned                  rxfull;                                         \
+  /* Bytes of the head buffer already moved into the input queue.*/         \
+  size_t                    rxoffset;
+#else
+#define _serial_usb_transfer_data
+#endif
+
 /**
  * @brief   @p SerialDriver specific data.
  */
@@ -173,7 +225,8 @@ typedef struct {
   uint8_t                   ob[SERIAL_USB_BUFFERS_SIZE];                    \
   /* End of the mandatory fields.*/                                         \
   /* Current configuration data.*/                                          \
-  const SerialUSBConfig     *config;
+  const SerialUSBConfig     *config;                                        \
+  _serial_usb_transfer_data
 
 /**
  * @brief   @p SerialUSBDriver specific methods.
@@ -58,6 +58,20 @@
 #if !defined(SPI_USE_MUTUAL_EXCLUSION) || defined(__DOXYGEN__)
 #define SPI_USE_MUTUAL_EXCLUSION    TRUE
 #endif
+
+/**
+ * @brief   Enables the transactions queue APIs.
+ * @details Transactions are lists of segments executed back to back from
+ *          the driver ISR, the invoking thread is awakened only when the
+ *          whole list has been executed.
+ * @note    This option can only be enabled if the SPI implementation
+ *          supports it, see the macro @p SPI_SUPPORTS_TRANSACTIONS exported
+ *          by the underlying implementation.
+ * @note    Disabling this option saves both code and data space.
+ */
+#if !defined(SPI_USE_TRANSACTIONS) || defined(__DOXYGEN__)
+#define SPI_USE_TRANSACTIONS        FALSE
+#endif
 /** @} */
 
 /*===========================================================================*/
@@ -83,8 +97,108 @@ typedef enum {
   SPI_COMPLETE = 4                  /**< Asynchronous operation complete.   */
 } spistate_t;
 
+/**
+ * @brief   Transaction segment operations.
+ */
+typedef enum {
+  SPI_SEG_SELECT = 0,               /**< Asserts the slave select.          */
+  SPI_SEG_UNSELECT = 1,             /**< Deasserts the slave select.        */
+  SPI_SEG_IGNORE = 2,               /**< Ignores @p n words.                */
+  SPI_SEG_EXCHANGE = 3,             /**< Exchanges @p n words.              */
+  SPI_SEG_SEND = 4,                 /**< Sends @p n words.                  */
+  SPI_SEG_RECEIVE = 5,              /**< Receives @p n words.               */
+  SPI_SEG_DELAY = 6                 /**< Waits for @p n system ticks.       */
+} spisegop_t;
+
+/**
+ * @brief   Type of a transaction segment.
+ * @details Segments are usually arranged in constant arrays built once,
+ *          the buffers are referenced and not copied.
+ */
+typedef struct {
+  /**
+   * @brief   Segment operation.
+   */
+  spisegop_t                op;
+  /**
+   * @brief   Number of words or number of ticks for delays.
+   */
+  size_t                    n;
+  /**
+   * @brief   Transmit buffer or @p NULL.
+   */
+  const void                *txbuf;
+  /**
+   * @brief   Receive buffer or @p NULL.
+   */
+  void                      *rxbuf;
+} SPISegment;
+
+/**
+ * @brief   Type of a structure representing a transaction.
+ */
+typedef struct SPITransaction SPITransaction;
+
 #include "spi_lld.h"
 
+#if SPI_USE_TRANSACTIONS || defined(__DOXYGEN__)
+/**
+ * @brief   Transaction completion callback type.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ * @param[in] stp       pointer to the completed @p SPITransaction object
+ */
+typedef void (*spitxncb_t)(SPIDriver *spip, SPITransaction *stp);
+
+/**
+ * @brief   Structure representing a transaction.
+ */
+struct SPITransaction {
+  /**
+   * @brief   Next transaction in the driver queue.
+   */
+  SPITransaction            *next;
+  /**
+   * @brief   Configuration used by the transaction, @p NULL for keeping
+   *          the current one.
+   * @details This allows devices with different select lines or clock
+   *          settings to share the queue.
+   * @note    The low level @p spi_lld_start() must be callable from ISR
+   *          context while the driver is active.
+   */
+  const SPIConfig           *config;
+  /**
+   * @brief   Segments array.
+   */
+  const SPISegment          *segments;
+  /**
+   * @brief   Number of segments.
+   */
+  size_t                    n;
+  /**
+   * @brief   Completion callback or @p NULL.
+   * @note    The callback is invoked from ISR context.
+   */
+  spitxncb_t                end_cb;
+  /**
+   * @brief   Queuing priority.
+   */
+  tprio_t                   prio;
+  /**
+   * @brief   Index of the next segment to be executed.
+   */
+  size_t                    index;
+  /**
+   * @brief   The transaction is queued or being executed.
+   */
+  bool_t                    pending;
+  /**
+   * @brief   Thread waiting for the transaction completion.
+   */
+  Thread                    *thread;
+};
+#endif /* SPI_USE_TRANSACTIONS */
+
 /*===========================================================================*/
 /* Driver macros.                                                            */
 /*===========================================================================*/
@@ -212,6 +326,88 @@ typedef enum {
 #define spiPolledExchange(spip, frame) spi_lld_polled_exchange(spip, frame)
 /** @} */
 
+/**
+ * @name    Transaction segments initializers
+ * @{
+ */
+/**
+ * @brief   Select segment.
+ */
+#define SPI_SEGMENT_SELECT()            {SPI_SEG_SELECT, 0, NULL, NULL}
+
+/**
+ * @brief   Unselect segment.
+ */
+#define SPI_SEGMENT_UNSELECT()          {SPI_SEG_UNSELECT, 0, NULL, NULL}
+
+/**
+ * @brief   Ignore segment.
+ *
+ * @param[in] n         number of words to be ignored
+ */
+#define SPI_SEGMENT_IGNORE(n)           {SPI_SEG_IGNORE, (n), NULL, NULL}
+
+/**
+ * @brief   Exchange segment.
+ *
+ * @param[in] n         number of words to be exchanged
+ * @param[in] txbuf     the pointer to the transmit buffer
+ * @param[out] rxbuf    the pointer to the receive buffer
+ */
+#define SPI_SEGMENT_EXCHANGE(n, txbuf, rxbuf)                               \
+  {SPI_SEG_EXCHANGE, (n), (txbuf), (rxbuf)}
+
+/**
+ * @brief   Send segment.
+ *
+ * @param[in] n         number of words to send
+ * @param[in] txbuf     the pointer to the transmit buffer
+ */
+#define SPI_SEGMENT_SEND(n, txbuf)      {SPI_SEG_SEND, (n), (txbuf), NULL}
+
+/**
+ * @brief   Receive segment.
+ *
+ * @param[in] n         number of words to receive
+ * @param[out] rxbuf    the pointer to the receive buffer
+ */
+#define SPI_SEGMENT_RECEIVE(n, rxbuf)   {SPI_SEG_RECEIVE, (n), NULL, (rxbuf)}
+
+/**
+ * @brief   Delay segment.
+ * @details The bus is left idle, the select state is not changed.
+ *
+ * @param[in] t         delay in system ticks
+ */
+#define SPI_SEGMENT_DELAY(t)            {SPI_SEG_DELAY, (t), NULL, NULL}
+/** @} */
+
+#if SPI_USE_TRANSACTIONS || defined(__DOXYGEN__)
+/**
+ * @brief   Static transaction initializer.
+ *
+ * @param[in] config    the transaction configuration or @p NULL
+ * @param[in] segments  the segments array
+ * @param[in] n         number of segments
+ * @param[in] end_cb    the completion callback or @p NULL
+ */
+#define _SPI_TRANSACTION_DATA(config, segments, n, end_cb) {                \
+  NULL, (config), (segments), (n), (end_cb), 0, 0, FALSE, NULL              \
+}
+
+/**
+ * @brief   Static transaction declaration.
+ *
+ * @param[in] name      the name of the transaction variable
+ * @param[in] config    the transaction configuration or @p NULL
+ * @param[in] segments  the segments array
+ * @param[in] n         number of segments
+ * @param[in] end_cb    the completion callback or @p NULL
+ */
+#define SPI_TRANSACTION_DECL(name, config, segments, n, end_cb)             \
+  SPITransaction name = _SPI_TRANSACTION_DATA(config, segments, n, end_cb)
+#endif /* SPI_USE_TRANSACTIONS */
+
 /**
  * @name    Low Level driver helper macros
  * @{
@@ -272,7 +468,30 @@ typedef enum {
  *
  * @notapi
  */
+#if SPI_USE_TRANSACTIONS || defined(__DOXYGEN__)
+#define _spi_isr_code(spip) {                                               \
+  if ((spip)->txncur != NULL)                                               \
+    _spi_txn_isr(spip);                                                     \
+  else {                                                                    \
+    _spi_end_code(spip);                                                    \
+  }                                                                         \
+}
+#else /* !SPI_USE_TRANSACTIONS */
 #define _spi_isr_code(spip) {                                               \
+  _spi_end_code(spip);                                                      \
+}
+#endif /* !SPI_USE_TRANSACTIONS */
+
+/**
+ * @brief   Operation end code.
+ * @details Callback invocation, waiting thread wakeup and state
+ *          transitions at the end of a single operation.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ *
+ * @notapi
+ */
+#define _spi_end_code(spip) {                                               \
   if ((spip)->config->end_cb) {                                             \
     (spip)->state = SPI_COMPLETE;                                           \
     (spip)->config->end_cb(spip);                                           \
@@ -313,6 +532,12 @@ extern "C" {
   void spiAcquireBus(SPIDriver *spip);
   void spiReleaseBus(SPIDriver *spip);
 #endif /* SPI_USE_MUTUAL_EXCLUSION */
+#if SPI_USE_TRANSACTIONS
+  void spiStartTransactionI(SPIDriver *spip, SPITransaction *stp);
+  void spiStartTransaction(SPIDriver *spip, SPITransaction *stp);
+  msg_t spiTransaction(SPIDriver *spip, SPITransaction *stp);
+  void _spi_txn_isr(SPIDriver *spip);
+#endif /* SPI_USE_TRANSACTIONS */
 #ifdef __cplusplus
 }
 #endif
@@ -39,10 +39,62 @@
 /* Driver pre-compile time settings.                                         */
 /*===========================================================================*/
 
+/**
+ * @name    TM configuration options
+ * @{
+ */
+/**
+ * @brief   Enables the profiling APIs.
+ * @details Named profiling points collect the distribution of the measured
+ *          intervals, the points can be listed and reset at runtime.
+ * @note    Disabling this option saves both code and data space.
+ */
+#if !defined(TM_USE_PROFILING) || defined(__DOXYGEN__)
+#define TM_USE_PROFILING            FALSE
+#endif
+
+/**
+ * @brief   Number of null measurements used for calibration.
+ * @details The smallest overhead observed is used as calibration value.
+ */
+#if !defined(TM_CALIBRATION_RUNS) || defined(__DOXYGEN__)
+#define TM_CALIBRATION_RUNS         16
+#endif
+
+/**
+ * @brief   Number of histogram buckets of a profiling point.
+ * @details Bucket zero counts the null intervals, bucket @p n counts the
+ *          intervals from 2^(n-1) to 2^n-1 ticks, the last bucket also
+ *          counts all the longer intervals.
+ */
+#if !defined(TM_PROFILE_BUCKETS) || defined(__DOXYGEN__)
+#define TM_PROFILE_BUCKETS          24
+#endif
+
+/**
+ * @brief   Number of threads attributed by each profiling point.
+ * @details The measurements of the first threads using a point are
+ *          accounted separately, the following threads are accounted
+ *          together.
+ */
+#if !defined(TM_PROFILE_THREADS) || defined(__DOXYGEN__)
+#define TM_PROFILE_THREADS          4
+#endif
+/** @} */
+
 /*===========================================================================*/
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
 
+#if TM_CALIBRATION_RUNS < 1
+#error "invalid TM_CALIBRATION_RUNS value"
+#endif
+
+#if TM_USE_PROFILING && ((TM_PROFILE_BUCKETS < 2) ||                        \
+                         (TM_PROFILE_BUCKETS > 33))
+#error "invalid TM_PROFILE_BUCKETS value"
+#endif
+
 /*===========================================================================*/
 /* Driver data structures and types.                                         */
 /*===========================================================================*/
@@ -72,6 +124,83 @@ struct TimeMeasurement {
   halrtcnt_t           best;            /**< @brief Best measurement.       */
 };
 
+#if TM_USE_PROFILING || defined(__DOXYGEN__)
+/**
+ * @brief   Measurements of a profiling point attributed to a thread.
+ */
+typedef struct {
+  /**
+   * @brief   Thread or @p NULL for the interrupt and locked contexts.
+   */
+  Thread                    *thread;
+  /**
+   * @brief   Number of measurements, zero if the slot is free.
+   */
+  uint32_t                  count;
+  /**
+   * @brief   Sum of the measured intervals.
+   */
+  uint64_t                  sum;
+} TimeProfileThread;
+
+/**
+ * @brief   Statistics of a profiling point.
+ */
+typedef struct {
+  /**
+   * @brief   Number of measurements.
+   */
+  uint32_t                  count;
+  /**
+   * @brief   Shortest interval.
+   */
+  halrtcnt_t                min;
+  /**
+   * @brief   Longest interval.
+   */
+  halrtcnt_t                max;
+  /**
+   * @brief   Sum of the measured intervals.
+   */
+  uint64_t                  sum;
+  /**
+   * @brief   Log2 histogram of the intervals.
+   */
+  uint32_t                  hist[TM_PROFILE_BUCKETS];
+  /**
+   * @brief   Measurements of the first threads.
+   */
+  TimeProfileThread         threads[TM_PROFILE_THREADS];
+  /**
+   * @brief   Measurements of the other threads.
+   */
+  TimeProfileThread         others;
+} TimeProfileStats;
+
+/**
+ * @brief   Type of a profiling point.
+ */
+typedef struct TimeProfile TimeProfile;
+
+/**
+ * @brief   Profiling point structure.
+ */
+struct TimeProfile {
+  /**
+   * @brief   Next registered point.
+   */
+  TimeProfile               *next;
+  /**
+   * @brief   Point name.
+   */
+  const char                *name;
+  /**
+   * @brief   Collected statistics.
+   */
+  TimeProfileStats          stats;
+};
+#endif /* TM_USE_PROFILING */
+
 /*===========================================================================*/
 /* Driver macros.                                                            */
 /*===========================================================================*/
@@ -98,6 +227,31 @@ struct TimeMeasurement {
  */
 #define tmStopMeasurement(tmp) (tmp)->stop(tmp)
 
+#if TM_USE_PROFILING || defined(__DOXYGEN__)
+/**
+ * @brief   Starts a profiled interval.
+ * @details The returned value is passed to @p tmProfileEnd() or
+ *          @p tmProfileEndI(), any number of intervals can be open at
+ *          the same time on the same point.
+ * @note    This function can be invoked in any context.
+ *
+ * @return              The interval start time.
+ *
+ * @special
+ */
+#define tmProfileBegin() halGetCounterValue()
+
+/**
+ * @brief   Returns the next registered profiling point.
+ *
+ * @param[in] pp        pointer to a @p TimeProfile structure
+ * @return              The next point or @p NULL.
+ *
+ * @api
+ */
+#define tmProfileNext(pp) ((pp)->next)
+#endif /* TM_USE_PROFILING */
+
 /*===========================================================================*/
 /* External declarations.                                                    */
 /*===========================================================================*/
@@ -107,6 +261,17 @@ extern "C" {
 #endif
   void tmInit(void);
   void tmObjectInit(TimeMeasurement *tmp);
+#if TM_USE_PROFILING || defined(__DOXYGEN__)
+  void tmProfileObjectInit(TimeProfile *pp, const char *name);
+  void tmProfileEnd(TimeProfile *pp, halrtcnt_t start);
+  void tmProfileEndI(TimeProfile *pp, halrtcnt_t start);
+  void tmProfileRecordI(TimeProfile *pp, halrtcnt_t ticks, Thread *tp);
+  void tmProfileGetStats(TimeProfile *pp, TimeProfileStats *sp);
+  void tmProfileReset(TimeProfile *pp);
+  void tmProfileResetAll(void);
+  TimeProfile *tmProfileFirst(void);
+  halrtcnt_t tmProfileGetOffset(void);
+#endif /* TM_USE_PROFILING */
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,301 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    Posix/adc_lld.c
+ * @brief   Posix low level simulated ADC driver code.
+ * @details The samples are synthesized from the waveforms of the
+ *          conversion group channels, the conversions due since the start
+ *          at the configured rate are written into the buffer each time
+ *          the interrupt sources are polled.
+ *
+ * @addtogroup POSIX_ADC
+ * @{
+ */
+
+
+#include "ch.h"
+#include "hal.h"
+
+#if HAL_USE_ADC || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/** @brief ADC1 driver identifier.*/
+#if USE_SIM_ADC1 || defined(__DOXYGEN__)
+ADCDriver ADCD1;
+#endif
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static uint64_t now_us(void) {
+
+  return hal_lld_get_time_us();
+}
+
+/**
+ * @brief   Computes a channel sample.
+ * @details The sine uses the Bhaskara I approximation, the error is below
+ *          0.2% of the amplitude.
+ *
+ * @param[in] adcp      pointer to the @p ADCDriver object
+ * @param[in] chp       pointer to the channel descriptor
+ * @param[in] t         conversion number
+ * @return              The sample value.
+ */
+static adcsample_t sample(ADCDriver *adcp, const ADCSimChannel *chp,
+                          uint64_t t) {
+  int64_t a = chp->amplitude, p = chp->period < 2 ? 2 : chp->period;
+  int64_t x = (int64_t)(t % (uint64_t)p), h = p / 2, q, v;
+
+  switch (chp->wave) {
+  case ADC_SIM_SINE:
+    q = x % h;
+    v = (a * 16 * q * (h - q)) / (5 * h * h - 4 * q * (h - q));
+    if (x >= h)
+      v = -v;
+    break;
+  case ADC_SIM_SQUARE:
+    v = x < h ? a : -a;
+    break;
+  case ADC_SIM_TRIANGLE:
+    v = x < h ? -a + (4 * a * x) / p : 3 * a - (4 * a * x) / p;
+    break;
+  case ADC_SIM_SAWTOOTH:
+    v = -a + (2 * a * x) / p;
+    break;
+  case ADC_SIM_NOISE:
+    adcp->seed = adcp->seed * 1103515245 + 12345;
+    v = (int64_t)((adcp->seed >> 8) % (uint32_t)(2 * a + 1)) - a;
+    break;
+  default:
+    v = 0;
+  }
+  v += chp->offset;
+  if (v < 0)
+    return 0;
+  if (v > ADC_SIM_MAX)
+    return ADC_SIM_MAX;
+  return (adcsample_t)v;
+}
+
+/**
+ * @brief   Performs conversions into the buffer.
+ *
+ * @param[in] adcp      pointer to the @p ADCDriver object
+ * @param[in] n         number of conversions
+ */
+static void convert(ADCDriver *adcp, size_t n) {
+  const ADCConversionGroup *grpp = adcp->grpp;
+  adcsample_t *p = adcp->samples + adcp->index * grpp->num_channels;
+  unsigned ch;
+
+  adcp->index += n;
+  while (n-- > 0) {
+    for (ch = 0; ch < grpp->num_channels; ch++) {
+      if (grpp->channels == NULL)
+        *p++ = (adcsample_t)(adcp->converted & ADC_SIM_MAX);
+      else
+        *p++ = sample(adcp, &grpp->channels[ch], adcp->converted);
+    }
+    adcp->converted++;
+  }
+}
+
+/**
+ * @brief   Conversion interrupt simulation.
+ * @details At most one whole buffer is converted for each invocation, a
+ *          slower consumer makes the effective rate drop below the
+ *          configured one.
+ *
+ * @param[in] adcp      pointer to the @p ADCDriver object
+ * @return              An interrupt has been served.
+ */
+static bool_t convint(ADCDriver *adcp) {
+  uint64_t due, limit;
+  size_t half, n;
+  bool_t b = FALSE;
+
+  if ((adcp->state != ADC_ACTIVE) || (adcp->grpp == NULL))
+    return FALSE;
+  if (adcp->errpending) {
+    adcp->errpending = FALSE;
+    _adc_isr_error_code(adcp, adcp->error);
+    return TRUE;
+  }
+  half = adcp->depth > 1 ? adcp->depth / 2 : 1;
+  limit = adcp->converted + adcp->depth;
+  if (adcp->config->frequency == 0)
+    due = adcp->converted + (half - adcp->index % half);
+  else {
+    due = ((now_us() - adcp->start) * adcp->config->frequency) / 1000000;
+    if (due > limit)
+      due = limit;
+  }
+  while (adcp->converted < due) {
+    n = half - adcp->index % half;
+    if (n > due - adcp->converted)
+      n = (size_t)(due - adcp->converted);
+    convert(adcp, n);
+    if (adcp->index == adcp->depth) {
+      adcp->index = 0;
+      _adc_isr_full_code(adcp);
+      b = TRUE;
+    }
+    else if (adcp->index == half) {
+      _adc_isr_half_code(adcp);
+      b = TRUE;
+    }
+    /* The callbacks can stop the conversion.*/
+    if ((adcp->state != ADC_ACTIVE) || (adcp->grpp == NULL))
+      return b;
+  }
+  /* Time of the next sample.*/
+  if (adcp->config->frequency != 0)
+    hal_lld_wakeup_at(adcp->start +
+                      ((adcp->converted + 1) * 1000000 +
+                       adcp->config->frequency - 1) / adcp->config->frequency);
+  return b;
+}
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level ADC driver initialization.
+ *
+ * @notapi
+ */
+void adc_lld_init(void) {
+
+#if USE_SIM_ADC1
+  adcObjectInit(&ADCD1);
+  ADCD1.seed = 1;
+  ADCD1.errpending = FALSE;
+#endif
+}
+
+/**
+ * @brief   Configures and activates the ADC peripheral.
+ *
+ * @param[in] adcp      pointer to the @p ADCDriver object
+ *
+ * @notapi
+ */
+void adc_lld_start(ADCDriver *adcp) {
+
+  (void)adcp;
+}
+
+/**
+ * @brief   Deactivates the ADC peripheral.
+ *
+ * @param[in] adcp      pointer to the @p ADCDriver object
+ *
+ * @notapi
+ */
+void adc_lld_stop(ADCDriver *adcp) {
+
+  adcp->errpending = FALSE;
+}
+
+/**
+ * @brief   Starts an ADC conversion.
+ *
+ * @param[in] adcp      pointer to the @p ADCDriver object
+ *
+ * @notapi
+ */
+void adc_lld_start_conversion(ADCDriver *adcp) {
+
+  adcp->start      = now_us();
+  adcp->converted  = 0;
+  adcp->index      = 0;
+  adcp->errpending = FALSE;
+}
+
+/**
+ * @brief   Stops an ongoing conversion.
+ *
+ * @param[in] adcp      pointer to the @p ADCDriver object
+ *
+ * @notapi
+ */
+void adc_lld_stop_conversion(ADCDriver *adcp) {
+
+  adcp->errpending = FALSE;
+}
+
+/**
+ * @brief   Injects a conversion error.
+ * @details The error is reported by the next interrupt and stops the
+ *          ongoing conversion.
+ *
+ * @param[in] adcp      pointer to the @p ADCDriver object
+ * @param[in] err       the error code
+ *
+ * @iclass
+ */
+void adcSimErrorI(ADCDriver *adcp, adcerror_t err) {
+
+  chDbgCheckClassI();
+  chDbgCheck(adcp != NULL, "adcSimErrorI");
+
+  adcp->error = err;
+  adcp->errpending = TRUE;
+}
+
+/**
+ * @brief   ADC interrupts simulation.
+ *
+ * @return              An interrupt has been served.
+ *
+ * @notapi
+ */
+bool_t adc_lld_interrupt_pending(void) {
+  bool_t b = FALSE;
+
+  CH_IRQ_PROLOGUE();
+
+#if USE_SIM_ADC1
+  b = convint(&ADCD1) || b;
+#endif
+
+  CH_IRQ_EPILOGUE();
+
+  return b;
+}
+
+#endif /* HAL_USE_ADC */
+
+/** @} */
@@ -0,0 +1,289 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    Posix/adc_lld.h
+ * @brief   Posix low level simulated ADC driver header.
+ *
+ * @addtogroup POSIX_ADC
+ * @{
+ */
+
+#ifndef _ADC_LLD_H_
+#define _ADC_LLD_H_
+
+#if HAL_USE_ADC || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Simulated converter resolution in bits.
+ */
+#define ADC_SIM_RESOLUTION          12
+
+/**
+ * @brief   Highest sample value.
+ */
+#define ADC_SIM_MAX                 ((1 << ADC_SIM_RESOLUTION) - 1)
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   ADC1 driver enable switch.
+ * @details If set to @p TRUE the support for ADC1 is included.
+ * @note    The default is @p TRUE.
+ */
+#if !defined(USE_SIM_ADC1) || defined(__DOXYGEN__)
+#define USE_SIM_ADC1                TRUE
+#endif
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   ADC sample data type.
+ */
+typedef uint16_t adcsample_t;
+
+/**
+ * @brief   Channels number in a conversion group.
+ */
+typedef uint16_t adc_channels_num_t;
+
+/**
+ * @brief   Possible ADC failure causes.
+ * @note    Error codes are architecture dependent and should not relied
+ *          upon.
+ */
+typedef enum {
+  ADC_ERR_DMAFAILURE = 0,                   /**< DMA operations failure.    */
+  ADC_ERR_OVERFLOW = 1                      /**< ADC overflow condition.    */
+} adcerror_t;
+
+/**
+ * @brief   Simulated waveforms.
+ */
+typedef enum {
+  ADC_SIM_DC = 0,                           /**< Constant offset.           */
+  ADC_SIM_SINE = 1,                         /**< Sine wave.                 */
+  ADC_SIM_SQUARE = 2,                       /**< Square wave.               */
+  ADC_SIM_TRIANGLE = 3,                     /**< Triangle wave.             */
+  ADC_SIM_SAWTOOTH = 4,                     /**< Rising ramp.               */
+  ADC_SIM_NOISE = 5                         /**< Uniform noise.             */
+} adcsimwave_t;
+
+/**
+ * @brief   Type of a simulated analog channel.
+ * @details The generated value is @p offset plus a waveform swinging
+ *          between @p -amplitude and @p +amplitude, clamped to the
+ *          converter range.
+ */
+typedef struct {
+  /**
+   * @brief   Waveform.
+   */
+  adcsimwave_t              wave;
+  /**
+   * @brief   Center value.
+   */
+  int32_t                   offset;
+  /**
+   * @brief   Peak amplitude.
+   */
+  int32_t                   amplitude;
+  /**
+   * @brief   Waveform period in conversions, at least two.
+   */
+  uint32_t                  period;
+} ADCSimChannel;
+
+/**
+ * @brief   Type of a structure representing an ADC driver.
+ */
+typedef struct ADCDriver ADCDriver;
+
+/**
+ * @brief   ADC notification callback type.
+ *
+ * @param[in] adcp      pointer to the @p ADCDriver object triggering the
+ *                      callback
+ * @param[in] buffer    pointer to the most recent samples data
+ * @param[in] n         number of buffer rows available starting from @p buffer
+ */
+typedef void (*adccallback_t)(ADCDriver *adcp, adcsample_t *buffer, size_t n);
+
+/**
+ * @brief   ADC error callback type.
+ *
+ * @param[in] adcp      pointer to the @p ADCDriver object triggering the
+ *                      callback
+ * @param[in] err       ADC error code
+ */
+typedef void (*adcerrorcallback_t)(ADCDriver *adcp, adcerror_t err);
+
+/**
+ * @brief   Conversion group configuration structure.
+ * @details This implementation-dependent structure describes a conversion
+ *          operation.
+ */
+typedef struct {
+  /**
+   * @brief   Enables the circular buffer mode for the group.
+   */
+  bool_t                    circular;
+  /**
+   * @brief   Number of the analog channels belonging to the conversion group.
+   */
+  adc_channels_num_t        num_channels;
+  /**
+   * @brief   Callback function associated to the group or @p NULL.
+   */
+  adccallback_t             end_cb;
+  /**
+   * @brief   Error callback or @p NULL.
+   */
+  adcerrorcallback_t        error_cb;
+  /* End of the mandatory fields.*/
+  /**
+   * @brief   Simulated channels, @p num_channels elements.
+   * @details If @p NULL all the channels return the conversions counter
+   *          modulo the converter range.
+   */
+  const ADCSimChannel       *channels;
+} ADCConversionGroup;
+
+/**
+ * @brief   Driver configuration structure.
+ */
+typedef struct {
+  /**
+   * @brief   Conversions per second, each conversion samples all the
+   *          channels of the group.
+   * @details Zero means that each interrupt completes half buffer.
+   */
+  uint32_t                  frequency;
+} ADCConfig;
+
+/**
+ * @brief   Structure representing an ADC driver.
+ */
+struct ADCDriver {
+  /**
+   * @brief   Driver state.
+   */
+  adcstate_t                state;
+  /**
+   * @brief   Current configuration data.
+   */
+  const ADCConfig           *config;
+  /**
+   * @brief   Current samples buffer pointer or @p NULL.
+   */
+  adcsample_t               *samples;
+  /**
+   * @brief   Current samples buffer depth or @p 0.
+   */
+  size_t                    depth;
+  /**
+   * @brief   Current conversion group pointer or @p NULL.
+   */
+  const ADCConversionGroup  *grpp;
+#if ADC_USE_WAIT || defined(__DOXYGEN__)
+  /**
+   * @brief   Waiting thread.
+   */
+  Thread                    *thread;
+#endif
+#if ADC_USE_MUTUAL_EXCLUSION || defined(__DOXYGEN__)
+#if CH_USE_MUTEXES || defined(__DOXYGEN__)
+  /**
+   * @brief   Mutex protecting the peripheral.
+   */
+  Mutex                     mutex;
+#elif CH_USE_SEMAPHORES
+  Semaphore                 semaphore;
+#endif
+#endif /* ADC_USE_MUTUAL_EXCLUSION */
+#if defined(ADC_DRIVER_EXT_FIELDS)
+  ADC_DRIVER_EXT_FIELDS
+#endif
+  /* End of the mandatory fields.*/
+  /**
+   * @brief   Conversion start time, microseconds.
+   */
+  uint64_t                  start;
+  /**
+   * @brief   Conversions performed since the start.
+   */
+  uint64_t                  converted;
+  /**
+   * @brief   Next row to be written in the buffer.
+   */
+  size_t                    index;
+  /**
+   * @brief   Noise generator state.
+   */
+  uint32_t                  seed;
+  /**
+   * @brief   An error has been injected.
+   */
+  bool_t                    errpending;
+  /**
+   * @brief   Injected error code.
+   */
+  adcerror_t                error;
+};
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#if USE_SIM_ADC1 && !defined(__DOXYGEN__)
+extern ADCDriver ADCD1;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void adc_lld_init(void);
+  void adc_lld_start(ADCDriver *adcp);
+  void adc_lld_stop(ADCDriver *adcp);
+  void adc_lld_start_conversion(ADCDriver *adcp);
+  void adc_lld_stop_conversion(ADCDriver *adcp);
+  bool_t adc_lld_interrupt_pending(void);
+  void adcSimErrorI(ADCDriver *adcp, adcerror_t err);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_ADC */
+
+#endif /* _ADC_LLD_H_ */
+
+/** @} */
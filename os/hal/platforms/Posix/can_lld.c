@@ -0,0 +1,459 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    Posix/can_lld.c
+ * @brief   Posix low level simulated CAN driver code.
+ * @details The CAN bus is simulated using UDP datagrams on the loopback
+ *          interface, each node sends its frames to all the other ports
+ *          of the bus ports range. Nodes can be in the same simulator
+ *          process or in different processes.
+ *
+ * @addtogroup POSIX_CAN
+ * @{
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#if HAL_USE_CAN || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/**
+ * @brief   Extended identifier flag in the wire format.
+ */
+#define WIRE_IDE                    0x80000000U
+
+/**
+ * @brief   Remote frame flag in the wire format.
+ */
+#define WIRE_RTR                    0x40000000U
+
+/**
+ * @brief   Maximum frames moved by a single receive interrupt.
+ */
+#define RX_BURST                    16
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/** @brief CAN1 driver identifier.*/
+#if USE_SIM_CAN1 || defined(__DOXYGEN__)
+CANDriver CAND1;
+#endif
+
+/** @brief CAN2 driver identifier.*/
+#if USE_SIM_CAN2 || defined(__DOXYGEN__)
+CANDriver CAND2;
+#endif
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Frame format on the virtual bus.
+ */
+typedef struct {
+  uint32_t                  id;
+  uint8_t                   dlc;
+  uint8_t                   pad[3];
+  uint8_t                   data[8];
+} wire_frame_t;
+
+static u_long nb = 1;
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static uint64_t now_us(void) {
+
+  return hal_lld_get_time_us();
+}
+
+static void init(CANDriver *canp) {
+  struct sockaddr_in sad;
+  unsigned i;
+
+  canp->sock = socket(PF_INET, SOCK_DGRAM, 0);
+  if (canp->sock == INVALID_SOCKET) {
+    printf("%s: Error creating simulator socket\n", canp->name);
+    goto abort;
+  }
+
+  if (ioctl(canp->sock, FIONBIO, &nb) != 0) {
+    printf("%s: Unable to setup non blocking mode on socket\n", canp->name);
+    goto abort;
+  }
+
+  /* The first free port of the bus range is taken.*/
+  memset(&sad, 0, sizeof(sad));
+  sad.sin_family = AF_INET;
+  sad.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  for (i = 0; i < SIM_CAN_BUS_NODES; i++) {
+    sad.sin_port = htons(SIM_CAN_BUS_PORT + i);
+    if (bind(canp->sock, (struct sockaddr *)&sad, sizeof(sad)) == 0)
+      break;
+  }
+  if (i >= SIM_CAN_BUS_NODES) {
+    printf("%s: No free node on the CAN bus\n", canp->name);
+    goto abort;
+  }
+  canp->port = (uint16_t)(SIM_CAN_BUS_PORT + i);
+  hal_lld_add_fd(canp->sock);
+  printf("CAN node %s on port %d\n", canp->name, canp->port);
+  return;
+
+abort:
+  if (canp->sock != INVALID_SOCKET)
+    close(canp->sock);
+  exit(1);
+}
+
+/**
+ * @brief   Frame duration on the bus in microseconds.
+ */
+static uint64_t frame_time(CANDriver *canp, const CANTxFrame *ctfp) {
+  uint32_t bits;
+
+  if (canp->config->bitrate == 0)
+    return 0;
+  bits = (ctfp->IDE ? 67 : 47) + (ctfp->RTR ? 0 : 8 * ctfp->DLC);
+  return ((uint64_t)bits * 1000000 + canp->config->bitrate - 1) /
+         canp->config->bitrate;
+}
+
+/**
+ * @brief   Sends a frame to all the other nodes.
+ */
+static void send_frame(CANDriver *canp, const CANTxFrame *ctfp) {
+  struct sockaddr_in sad;
+  wire_frame_t wf;
+  unsigned i;
+
+  memset(&wf, 0, sizeof(wf));
+  if (ctfp->IDE)
+    wf.id = ctfp->EID | WIRE_IDE;
+  else
+    wf.id = ctfp->SID;
+  if (ctfp->RTR)
+    wf.id |= WIRE_RTR;
+  wf.dlc = ctfp->DLC > 8 ? 8 : ctfp->DLC;
+  memcpy(wf.data, ctfp->data8, wf.dlc);
+
+  memset(&sad, 0, sizeof(sad));
+  sad.sin_family = AF_INET;
+  sad.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  for (i = 0; i < SIM_CAN_BUS_NODES; i++) {
+    if (SIM_CAN_BUS_PORT + i == canp->port)
+      continue;
+    sad.sin_port = htons(SIM_CAN_BUS_PORT + i);
+    (void)sendto(canp->sock, &wf, sizeof(wf), 0,
+                 (struct sockaddr *)&sad, sizeof(sad));
+  }
+  canp->txframes++;
+}
+
+/**
+ * @brief   Transmits the next queued frame if the bus is free.
+ * @note    Must be invoked from within a locked zone.
+ *
+ * @return              A frame has been transmitted.
+ */
+static bool_t tx_next(CANDriver *canp) {
+  CANTxFrame ctf;
+  uint64_t now;
+
+  if ((canp->sock == INVALID_SOCKET) || (canp->state != CAN_READY))
+    return FALSE;
+  now = now_us();
+  if (now < canp->busy_until) {
+    hal_lld_wakeup_at(canp->busy_until);
+    return FALSE;
+  }
+  if (canRequestFrameI(canp, &ctf) != Q_OK)
+    return FALSE;
+  send_frame(canp, &ctf);
+  canp->busy_until = now + frame_time(canp, &ctf);
+  return TRUE;
+}
+
+/**
+ * @brief   Returns the index of the first matching filter or -1.
+ */
+static int match(CANDriver *canp, const CANRxFrame *crfp) {
+  uint32_t id = crfp->IDE ? crfp->EID : crfp->SID;
+  size_t i;
+
+  if (canp->nfilters == 0)
+    return 0;
+  for (i = 0; i < canp->nfilters; i++) {
+    const CANIdFilter *cifp = &canp->filters[i];
+
+    if ((cifp->ide == crfp->IDE) && (((id ^ cifp->id) & cifp->mask) == 0))
+      return (int)i;
+  }
+  return -1;
+}
+
+/**
+ * @brief   Delivers a received frame through the identifier filters.
+ * @note    Must be invoked from within a locked zone.
+ */
+static void deliver(CANDriver *canp, CANRxFrame *crfp) {
+  int fmi;
+
+  canp->rxframes++;
+
+  /* Frames are lost while sleeping.*/
+  if (canp->state != CAN_READY)
+    return;
+  fmi = match(canp, crfp);
+  if (fmi < 0)
+    return;
+  crfp->FMI = (uint8_t)fmi;
+  crfp->TIME = (uint16_t)now_us();
+  canIncomingFrameI(canp, crfp);
+}
+
+static bool_t rxint(CANDriver *canp) {
+  wire_frame_t wf;
+  CANRxFrame crf;
+  unsigned i;
+  int n;
+
+  if (canp->sock == INVALID_SOCKET)
+    return FALSE;
+  for (i = 0; i < RX_BURST; i++) {
+    n = recv(canp->sock, &wf, sizeof(wf), 0);
+    if (n != (int)sizeof(wf))
+      break;
+    memset(&crf, 0, sizeof(crf));
+    crf.IDE = (wf.id & WIRE_IDE) != 0;
+    crf.RTR = (wf.id & WIRE_RTR) != 0;
+    if (crf.IDE)
+      crf.EID = wf.id & 0x1FFFFFFF;
+    else
+      crf.SID = wf.id & 0x7FF;
+    crf.DLC = wf.dlc;
+    memcpy(crf.data8, wf.data, sizeof(crf.data8));
+    chSysLockFromIsr();
+    deliver(canp, &crf);
+    chSysUnlockFromIsr();
+  }
+  return i > 0;
+}
+
+static bool_t txint(CANDriver *canp) {
+  bool_t b;
+
+  chSysLockFromIsr();
+  b = tx_next(canp);
+  chSysUnlockFromIsr();
+  return b;
+}
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level CAN driver initialization.
+ *
+ * @notapi
+ */
+void can_lld_init(void) {
+
+#if USE_SIM_CAN1
+  canObjectInit(&CAND1);
+  CAND1.sock = INVALID_SOCKET;
+  CAND1.nfilters = 0;
+  CAND1.name = "CAN1";
+#endif
+#if USE_SIM_CAN2
+  canObjectInit(&CAND2);
+  CAND2.sock = INVALID_SOCKET;
+  CAND2.nfilters = 0;
+  CAND2.name = "CAN2";
+#endif
+}
+
+/**
+ * @brief   Configures and activates the CAN peripheral.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ *
+ * @notapi
+ */
+void can_lld_start(CANDriver *canp) {
+
+  canp->busy_until = 0;
+  canp->txframes = 0;
+  canp->rxframes = 0;
+  init(canp);
+}
+
+/**
+ * @brief   Deactivates the CAN peripheral.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ *
+ * @notapi
+ */
+void can_lld_stop(CANDriver *canp) {
+
+  if (canp->sock != INVALID_SOCKET) {
+    hal_lld_remove_fd(canp->sock);
+    close(canp->sock);
+    canp->sock = INVALID_SOCKET;
+  }
+}
+
+/**
+ * @brief   Programs the identifier filters.
+ * @details The filters are applied by software in the receive path.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ * @param[in] cifp      pointer to the filters table
+ * @param[in] n         number of entries in the filters table
+ * @return              The operation status.
+ * @retval CH_SUCCESS   the filters have been programmed.
+ * @retval CH_FAILED    too many filters.
+ *
+ * @notapi
+ */
+bool_t can_lld_set_id_filters(CANDriver *canp,
+                              const CANIdFilter *cifp,
+                              size_t n) {
+  size_t i;
+
+  if (n > SIM_CAN_MAX_FILTERS)
+    return CH_FAILED;
+  for (i = 0; i < n; i++)
+    canp->filters[i] = cifp[i];
+  canp->nfilters = n;
+  return CH_SUCCESS;
+}
+
+/**
+ * @brief   Starts a transmission if the bus is free.
+ * @details Without bus timing all the queued frames are sent immediately.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ *
+ * @notapi
+ */
+void can_lld_start_transmit(CANDriver *canp) {
+
+  while (tx_next(canp) && (canp->config->bitrate == 0))
+    ;
+}
+
+#if CAN_USE_SLEEP_MODE || defined(__DOXYGEN__)
+/**
+ * @brief   Enters the sleep mode.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ *
+ * @notapi
+ */
+void can_lld_sleep(CANDriver *canp) {
+
+  (void)canp;
+}
+
+/**
+ * @brief   Enforces leaving the sleep mode.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ *
+ * @notapi
+ */
+void can_lld_wakeup(CANDriver *canp) {
+
+  (void)canp;
+}
+#endif /* CAN_USE_SLEEP_MODE */
+
+/**
+ * @brief   Injects a frame as received from the bus.
+ * @details The frame goes through the identifier filters, it is meant to
+ *          be invoked from a simulated event scheduled using
+ *          @p simEventSetI().
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ * @param[in] crfp      pointer to the frame, the @p FMI and @p TIME fields
+ *                      are ignored
+ *
+ * @iclass
+ */
+void canSimInjectI(CANDriver *canp, const CANRxFrame *crfp) {
+  CANRxFrame crf;
+
+  chDbgCheckClassI();
+  chDbgCheck((canp != NULL) && (crfp != NULL), "canSimInjectI");
+
+  crf = *crfp;
+  deliver(canp, &crf);
+}
+
+/**
+ * @brief   CAN interrupts simulation.
+ *
+ * @return              An interrupt has been served.
+ *
+ * @notapi
+ */
+bool_t can_lld_interrupt_pending(void) {
+  bool_t b = FALSE;
+
+  CH_IRQ_PROLOGUE();
+
+#if USE_SIM_CAN1
+  b = rxint(&CAND1) || b;
+  b = txint(&CAND1) || b;
+#endif
+#if USE_SIM_CAN2
+  b = rxint(&CAND2) || b;
+  b = txint(&CAND2) || b;
+#endif
+
+  CH_IRQ_EPILOGUE();
+
+  return b;
+}
+
+#endif /* HAL_USE_CAN */
+
+/** @} */
@@ -0,0 +1,343 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    Posix/can_lld.h
+ * @brief   Posix low level simulated CAN driver header.
+ *
+ * @addtogroup POSIX_CAN
+ * @{
+ */
+
+#ifndef _CAN_LLD_H_
+#define _CAN_LLD_H_
+
+#if HAL_USE_CAN || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   This switch defines whether the driver implementation supports
+ *          a low power switch mode with automatic an wakeup feature.
+ */
+#define CAN_SUPPORTS_SLEEP          TRUE
+
+/**
+ * @brief   This switch defines whether the driver implementation supports
+ *          the software queues.
+ */
+#define CAN_SUPPORTS_QUEUES         TRUE
+
+/**
+ * @brief   This implementation supports one transmit mailbox.
+ */
+#define CAN_TX_MAILBOXES            1
+
+/**
+ * @brief   This implementation supports one receive mailbox.
+ */
+#define CAN_RX_MAILBOXES            1
+
+/**
+ * @name    CAN frame helper macros
+ * @{
+ */
+#define CAN_IDE_STD                 0           /**< @brief Standard id.    */
+#define CAN_IDE_EXT                 1           /**< @brief Extended id.    */
+
+#define CAN_RTR_DATA                0           /**< @brief Data frame.     */
+#define CAN_RTR_REMOTE              1           /**< @brief Remote frame.   */
+/** @} */
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   CAN1 driver enable switch.
+ * @details If set to @p TRUE the support for CAN1 is included.
+ * @note    The default is @p TRUE.
+ */
+#if !defined(USE_SIM_CAN1) || defined(__DOXYGEN__)
+#define USE_SIM_CAN1                TRUE
+#endif
+
+/**
+ * @brief   CAN2 driver enable switch.
+ * @details If set to @p TRUE the support for CAN2 is included.
+ * @note    The default is @p TRUE.
+ */
+#if !defined(USE_SIM_CAN2) || defined(__DOXYGEN__)
+#define USE_SIM_CAN2                TRUE
+#endif
+
+/**
+ * @brief   First UDP port of the virtual bus.
+ * @details Each started driver, in any simulator process, binds the first
+ *          free port in the range and sends its frames to all the other
+ *          ports of the range on the loopback interface.
+ */
+#if !defined(SIM_CAN_BUS_PORT) || defined(__DOXYGEN__)
+#define SIM_CAN_BUS_PORT            29100
+#endif
+
+/**
+ * @brief   Maximum number of nodes on the virtual bus.
+ */
+#if !defined(SIM_CAN_BUS_NODES) || defined(__DOXYGEN__)
+#define SIM_CAN_BUS_NODES           8
+#endif
+
+/**
+ * @brief   Number of simulated identifier filters.
+ */
+#if !defined(SIM_CAN_MAX_FILTERS) || defined(__DOXYGEN__)
+#define SIM_CAN_MAX_FILTERS         28
+#endif
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if !CAN_USE_QUEUES
+#error "the simulated CAN driver requires CAN_USE_QUEUES"
+#endif
+
+#if !USE_SIM_CAN1 && !USE_SIM_CAN2
+#error "CAN driver activated but no CAN peripheral assigned"
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Type of a transmission mailbox index.
+ */
+typedef uint32_t canmbx_t;
+
+/**
+ * @brief   CAN transmission frame.
+ * @note    Accessing the frame data as word16 or word32 is not portable because
+ *          machine data endianness, it can be still useful for a quick filling.
+ */
+typedef struct {
+  struct {
+    uint8_t                 DLC:4;          /**< @brief Data length.        */
+    uint8_t                 RTR:1;          /**< @brief Frame type.         */
+    uint8_t                 IDE:1;          /**< @brief Identifier type.    */
+  };
+  union {
+    struct {
+      uint32_t              SID:11;         /**< @brief Standard identifier.*/
+    };
+    struct {
+      uint32_t              EID:29;         /**< @brief Extended identifier.*/
+    };
+  };
+  union {
+    uint8_t                 data8[8];       /**< @brief Frame data.         */
+    uint16_t                data16[4];      /**< @brief Frame data.         */
+    uint32_t                data32[2];      /**< @brief Frame data.         */
+  };
+} CANTxFrame;
+
+/**
+ * @brief   CAN received frame.
+ * @note    Accessing the frame data as word16 or word32 is not portable because
+ *          machine data endianness, it can be still useful for a quick filling.
+ */
+typedef struct {
+  struct {
+    uint8_t                 FMI;            /**< @brief Filter id.          */
+    uint16_t                TIME;           /**< @brief Time stamp.         */
+  };
+  struct {
+    uint8_t                 DLC:4;          /**< @brief Data length.        */
+    uint8_t                 RTR:1;          /**< @brief Frame type.         */
+    uint8_t                 IDE:1;          /**< @brief Identifier type.    */
+  };
+  union {
+    struct {
+      uint32_t              SID:11;         /**< @brief Standard identifier.*/
+    };
+    struct {
+      uint32_t              EID:29;         /**< @brief Extended identifier.*/
+    };
+  };
+  union {
+    uint8_t                 data8[8];       /**< @brief Frame data.         */
+    uint16_t                data16[4];      /**< @brief Frame data.         */
+    uint32_t                data32[2];      /**< @brief Frame data.         */
+  };
+} CANRxFrame;
+
+/**
+ * @brief   Driver configuration structure.
+ */
+typedef struct {
+  /**
+   * @brief   Simulated bit rate.
+   * @details The transmitter keeps the bus busy for the duration of each
+   *          frame, without stuff bits. Zero disables the bus timing.
+   */
+  uint32_t                  bitrate;
+} CANConfig;
+
+/**
+ * @brief   Structure representing an CAN driver.
+ */
+typedef struct {
+  /**
+   * @brief   Driver state.
+   */
+  canstate_t                state;
+  /**
+   * @brief   Current configuration data.
+   */
+  const CANConfig           *config;
+  /**
+   * @brief   Transmission queue semaphore.
+   */
+  Semaphore                 txsem;
+  /**
+   * @brief   Receive queue semaphore.
+   */
+  Semaphore                 rxsem;
+  /**
+   * @brief   One or more frames become available.
+   */
+  EventSource               rxfull_event;
+  /**
+   * @brief   Space available in the transmit queue.
+   */
+  EventSource               txempty_event;
+  /**
+   * @brief   A CAN bus error happened.
+   */
+  EventSource               error_event;
+#if CAN_USE_SLEEP_MODE || defined (__DOXYGEN__)
+  /**
+   * @brief   Entering sleep state event.
+   */
+  EventSource               sleep_event;
+  /**
+   * @brief   Exiting sleep state event.
+   */
+  EventSource               wakeup_event;
+#endif /* CAN_USE_SLEEP_MODE */
+  /**
+   * @brief   Receive queue buffer.
+   */
+  CANRxFrame                rxq[CAN_RX_QUEUE_SIZE];
+  /**
+   * @brief   Receive queue read index.
+   */
+  size_t                    rxrd;
+  /**
+   * @brief   Frames in the receive queue.
+   */
+  size_t                    rxcnt;
+  /**
+   * @brief   Transmit queue buffer, ordered by priority.
+   */
+  CANTxFrame                txq[CAN_TX_QUEUE_SIZE];
+  /**
+   * @brief   Arbitration keys of the queued frames.
+   */
+  uint32_t                  txkey[CAN_TX_QUEUE_SIZE];
+  /**
+   * @brief   Frames in the transmit queue.
+   */
+  size_t                    txcnt;
+  /* End of the mandatory fields.*/
+  /**
+   * @brief   Bus socket.
+   */
+  SOCKET                    sock;
+  /**
+   * @brief   Bus port bound by this node.
+   */
+  uint16_t                  port;
+  /**
+   * @brief   Time when the bus becomes free, in microseconds.
+   */
+  uint64_t                  busy_until;
+  /**
+   * @brief   Identifier filters.
+   */
+  CANIdFilter               filters[SIM_CAN_MAX_FILTERS];
+  /**
+   * @brief   Number of identifier filters, zero accepts all frames.
+   */
+  size_t                    nfilters;
+  /**
+   * @brief   Frames sent on the bus.
+   */
+  uint32_t                  txframes;
+  /**
+   * @brief   Frames received from the bus, before filtering.
+   */
+  uint32_t                  rxframes;
+  /**
+   * @brief   Driver readable name.
+   */
+  const char                *name;
+} CANDriver;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#if USE_SIM_CAN1 && !defined(__DOXYGEN__)
+extern CANDriver CAND1;
+#endif
+
+#if USE_SIM_CAN2 && !defined(__DOXYGEN__)
+extern CANDriver CAND2;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void can_lld_init(void);
+  void can_lld_start(CANDriver *canp);
+  void can_lld_stop(CANDriver *canp);
+  bool_t can_lld_set_id_filters(CANDriver *canp,
+                                const CANIdFilter *cifp,
+                                size_t n);
+  void can_lld_start_transmit(CANDriver *canp);
+#if CAN_USE_SLEEP_MODE
+  void can_lld_sleep(CANDriver *canp);
+  void can_lld_wakeup(CANDriver *canp);
+#endif /* CAN_USE_SLEEP_MODE */
+  void canSimInjectI(CANDriver *canp, const CANRxFrame *crfp);
+  bool_t can_lld_interrupt_pending(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_CAN */
+
+#endif /* _CAN_LLD_H_ */
+
+/** @} */
@@ -43,68 +43,76 @@ BaseChannel CD1;
 /* Driver local functions.                                                   */
 /*===========================================================================*/
 
+/*
+ * The host stdio is not reentrant, the system is locked during the calls
+ * because a preemptive simulator port can switch thread at any time.
+ */
+
 static size_t write(void *ip, const uint8_t *bp, size_t n) {
   size_t ret;
 
   (void)ip;
+  chSysLock();
   ret = fwrite(bp, 1, n, stdout);
   fflush(stdout);
+  chSysUnlock();
   return ret;
 }
 
 static size_t read(void *ip, uint8_t *bp, size_t n) {
+  size_t ret;
 
   (void)ip;
-  return fread(bp, 1, n, stdin);
+  chSysLock();
+  ret = fread(bp, 1, n, stdin);
+  chSysUnlock();
+  return ret;
 }
 
 static msg_t put(void *ip, uint8_t b) {
 
   (void)ip;
 
+  chSysLock();
   fputc(b, stdout);
   fflush(stdout);
+  chSysUnlock();
   return RDY_OK;
 }
 
 static msg_t get(void *ip) {
+  msg_t msg;
 
   (void)ip;
 
-  return fgetc(stdin);
+  chSysLock();
+  msg = fgetc(stdin);
+  chSysUnlock();
+  return msg;
 }
 
 static msg_t putt(void *ip, uint8_t b, systime_t time) {
 
-  (void)ip;
   (void)time;
-  fputc(b, stdout);
-  fflush(stdout);
-  return RDY_OK;
+  return put(ip, b);
 }
 
 static msg_t gett(void *ip, systime_t time) {
 
-  (void)ip;
   (void)time;
-  return fgetc(stdin);
+  return get(ip);
 }
 
 static size_t writet(void *ip, const uint8_t *bp, size_t n, systime_t time) {
-  size_t ret;
 
-  (void)ip;
   (void)time;
-  ret = fwrite(bp, 1, n, stdout);
-  fflush(stdout);
-  return ret;
+  return write(ip, bp, n);
 }
 
 static size_t readt(void *ip, uint8_t *bp, size_t n, systime_t time) {
 
-  (void)ip;
   (void)time;
-  return fread(bp, 1, n, stdin);
+  return read(ip, bp, n);
 }
 
 static const struct BaseChannelVMT vmt = {
@@ -0,0 +1,335 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    Posix/dac_lld.c
+ * @brief   Posix low level simulated DAC driver code.
+ * @details The rows due since the conversion start at the configured rate
+ *          are output each time the interrupt sources are polled, the
+ *          output can be recorded in a WAV file.
+ *
+ * @addtogroup POSIX_DAC
+ * @{
+ */
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#if HAL_USE_DAC || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/**
+ * @brief   Size of the WAV file header.
+ */
+#define WAV_HEADER_SIZE             44
+
+/**
+ * @brief   Samples converted for each file write.
+ */
+#define WAV_CHUNK                   256
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/** @brief DAC1 driver identifier.*/
+#if USE_SIM_DAC1 || defined(__DOXYGEN__)
+DACDriver DACD1;
+#endif
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static uint64_t now_us(void) {
+
+  return hal_lld_get_time_us();
+}
+
+static uint8_t *put32(uint8_t *p, uint32_t v) {
+
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+  return p + 4;
+}
+
+static uint8_t *put16(uint8_t *p, uint16_t v) {
+
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  return p + 2;
+}
+
+/**
+ * @brief   Writes the WAV file header.
+ * @details The header is rewritten with the updated sizes each time the
+ *          conversion is stopped.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object
+ */
+static void wav_header(DACDriver *dacp) {
+  uint8_t hdr[WAV_HEADER_SIZE], *p = hdr;
+  uint32_t rate = dacp->config->frequency != 0 ? dacp->config->frequency :
+                                                 DAC_SIM_NOMINAL_RATE;
+
+  memcpy(p, "RIFF", 4);
+  p = put32(p + 4, 36 + dacp->wavbytes);
+  memcpy(p, "WAVEfmt ", 8);
+  p = put32(p + 8, 16);
+  p = put16(p, 1);
+  p = put16(p, (uint16_t)dacp->wavchannels);
+  p = put32(p, rate);
+  p = put32(p, rate * dacp->wavchannels * 2);
+  p = put16(p, (uint16_t)(dacp->wavchannels * 2));
+  p = put16(p, 16);
+  memcpy(p, "data", 4);
+  put32(p + 4, dacp->wavbytes);
+  if (pwrite(dacp->fd, hdr, sizeof hdr, 0) != sizeof hdr) {
+    close(dacp->fd);
+    dacp->fd = -1;
+  }
+}
+
+/**
+ * @brief   Outputs rows from the buffer.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object
+ * @param[in] n         number of rows
+ */
+static void output(DACDriver *dacp, size_t n) {
+  const dacsample_t *sp = dacp->samples +
+                          dacp->index * dacp->grpp->num_channels;
+  size_t i, chunk, total = n * dacp->grpp->num_channels;
+  int16_t pcm[WAV_CHUNK];
+
+  dacp->index += n;
+  dacp->converted += n;
+  if ((dacp->fd < 0) || (dacp->wavchannels != dacp->grpp->num_channels))
+    return;
+  while (total > 0) {
+    chunk = total < WAV_CHUNK ? total : WAV_CHUNK;
+    for (i = 0; i < chunk; i++)
+      pcm[i] = (int16_t)((sp[i] << (16 - DAC_SIM_RESOLUTION)) ^ 0x8000);
+    if (pwrite(dacp->fd, pcm, chunk * 2,
+               WAV_HEADER_SIZE + dacp->wavbytes) != (ssize_t)(chunk * 2))
+      return;
+    dacp->wavbytes += (uint32_t)(chunk * 2);
+    sp += chunk;
+    total -= chunk;
+  }
+}
+
+/**
+ * @brief   Conversion interrupt simulation.
+ * @details At most one whole buffer is output for each invocation.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object
+ * @return              An interrupt has been served.
+ */
+static bool_t convint(DACDriver *dacp) {
+  uint64_t due, limit;
+  size_t half, n;
+  bool_t b = FALSE;
+
+  if ((dacp->state != DAC_ACTIVE) || (dacp->grpp == NULL))
+    return FALSE;
+  if (dacp->errpending) {
+    dacp->errpending = FALSE;
+    _dac_isr_error_code(dacp, dacp->error);
+    return TRUE;
+  }
+  half = dacp->depth > 1 ? dacp->depth / 2 : 1;
+  limit = dacp->converted + dacp->depth;
+  if (dacp->config->frequency == 0)
+    due = dacp->converted + (half - dacp->index % half);
+  else {
+    due = ((now_us() - dacp->start) * dacp->config->frequency) / 1000000;
+    if (due > limit)
+      due = limit;
+  }
+  while (dacp->converted < due) {
+    n = half - dacp->index % half;
+    if (n > due - dacp->converted)
+      n = (size_t)(due - dacp->converted);
+    output(dacp, n);
+    if (dacp->index == dacp->depth) {
+      dacp->index = 0;
+      _dac_isr_full_code(dacp);
+      b = TRUE;
+    }
+    else if (dacp->index == half) {
+      _dac_isr_half_code(dacp);
+      b = TRUE;
+    }
+    /* The callbacks can stop the conversion.*/
+    if ((dacp->state != DAC_ACTIVE) || (dacp->grpp == NULL))
+      return b;
+  }
+  /* Time of the next sample.*/
+  if (dacp->config->frequency != 0)
+    hal_lld_wakeup_at(dacp->start +
+                      ((dacp->converted + 1) * 1000000 +
+                       dacp->config->frequency - 1) / dacp->config->frequency);
+  return b;
+}
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level DAC driver initialization.
+ *
+ * @notapi
+ */
+void dac_lld_init(void) {
+
+#if USE_SIM_DAC1
+  dacObjectInit(&DACD1);
+  DACD1.fd = -1;
+  DACD1.errpending = FALSE;
+#endif
+}
+
+/**
+ * @brief   Configures and activates the DAC peripheral.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object
+ *
+ * @notapi
+ */
+void dac_lld_start(DACDriver *dacp) {
+
+  if (dacp->fd >= 0)
+    close(dacp->fd);
+  dacp->fd = -1;
+  dacp->wavchannels = 0;
+  dacp->wavbytes = 0;
+  if (dacp->config->wavfile != NULL)
+    dacp->fd = open(dacp->config->wavfile, O_RDWR | O_CREAT | O_TRUNC, 0644);
+}
+
+/**
+ * @brief   Deactivates the DAC peripheral.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object
+ *
+ * @notapi
+ */
+void dac_lld_stop(DACDriver *dacp) {
+
+  if (dacp->fd >= 0)
+    close(dacp->fd);
+  dacp->fd = -1;
+  dacp->errpending = FALSE;
+}
+
+/**
+ * @brief   Starts a DAC conversion.
+ * @details The WAV file records the channels of the first conversion
+ *          group, the output of groups with a different number of
+ *          channels is not recorded.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object
+ *
+ * @notapi
+ */
+void dac_lld_start_conversion(DACDriver *dacp) {
+
+  dacp->start      = now_us();
+  dacp->converted  = 0;
+  dacp->index      = 0;
+  dacp->errpending = FALSE;
+  if ((dacp->fd >= 0) && (dacp->wavchannels == 0)) {
+    dacp->wavchannels = dacp->grpp->num_channels;
+    wav_header(dacp);
+  }
+}
+
+/**
+ * @brief   Stops an ongoing conversion.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object
+ *
+ * @notapi
+ */
+void dac_lld_stop_conversion(DACDriver *dacp) {
+
+  dacp->errpending = FALSE;
+  if (dacp->fd >= 0)
+    wav_header(dacp);
+}
+
+/**
+ * @brief   Injects a conversion error.
+ * @details The error is reported by the next interrupt and stops the
+ *          ongoing conversion.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object
+ * @param[in] err       the error code
+ *
+ * @iclass
+ */
+void dacSimErrorI(DACDriver *dacp, dacerror_t err) {
+
+  chDbgCheckClassI();
+  chDbgCheck(dacp != NULL, "dacSimErrorI");
+
+  dacp->error = err;
+  dacp->errpending = TRUE;
+}
+
+/**
+ * @brief   DAC interrupts simulation.
+ *
+ * @return              An interrupt has been served.
+ *
+ * @notapi
+ */
+bool_t dac_lld_interrupt_pending(void) {
+  bool_t b = FALSE;
+
+  CH_IRQ_PROLOGUE();
+
+#if USE_SIM_DAC1
+  b = convint(&DACD1) || b;
+#endif
+
+  CH_IRQ_EPILOGUE();
+
+  return b;
+}
+
+#endif /* HAL_USE_DAC */
+
+/** @} */
@@ -0,0 +1,299 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    Posix/dac_lld.h
+ * @brief   Posix low level simulated DAC driver header.
+ *
+ * @addtogroup POSIX_DAC
+ * @{
+ */
+
+#ifndef _DAC_LLD_H_
+#define _DAC_LLD_H_
+
+#if HAL_USE_DAC || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Simulated converter resolution in bits.
+ */
+#define DAC_SIM_RESOLUTION          12
+
+/**
+ * @brief   Sample rate recorded in the WAV file when the rate is unlimited.
+ */
+#define DAC_SIM_NOMINAL_RATE        48000
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   DAC1 driver enable switch.
+ * @details If set to @p TRUE the support for DAC1 is included.
+ * @note    The default is @p TRUE.
+ */
+#if !defined(USE_SIM_DAC1) || defined(__DOXYGEN__)
+#define USE_SIM_DAC1                TRUE
+#endif
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   DAC sample data type.
+ */
+typedef uint16_t dacsample_t;
+
+/**
+ * @brief   Channels number in a conversion group.
+ */
+typedef uint16_t dac_channels_num_t;
+
+/**
+ * @brief   Possible DAC failure causes.
+ * @note    Error codes are architecture dependent and should not relied
+ *          upon.
+ */
+typedef enum {
+  DAC_ERR_DMAFAILURE = 0,                   /**< DMA operations failure.    */
+  DAC_ERR_UNDERRUN = 1                      /**< DAC underrun condition.    */
+} dacerror_t;
+
+/**
+ * @brief   Type of a structure representing an DAC driver.
+ */
+typedef struct DACDriver DACDriver;
+
+/**
+ * @brief   DAC notification callback type.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object triggering the
+ *                      callback
+ * @param[in] buffer    pointer to the most recent samples data
+ * @param[in] n         number of buffer rows available starting from @p buffer
+ */
+typedef void (*daccallback_t)(DACDriver *dacp, const dacsample_t *buffer,
+                              size_t n);
+
+/**
+ * @brief   DAC error callback type.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object triggering the
+ *                      callback
+ * @param[in] err       DAC error code
+ */
+typedef void (*dacerrorcallback_t)(DACDriver *dacp, dacerror_t err);
+
+/**
+ * @brief   Conversion group configuration structure.
+ * @details This implementation-dependent structure describes a conversion
+ *          operation.
+ */
+typedef struct {
+  /**
+   * @brief   Enables the circular buffer mode for the group.
+   */
+  bool_t                    circular;
+  /**
+   * @brief   Number of the analog channels belonging to the conversion group.
+   */
+  dac_channels_num_t        num_channels;
+  /**
+   * @brief   Callback function associated to the group or @p NULL.
+   */
+  daccallback_t             end_cb;
+  /**
+   * @brief   Error callback or @p NULL.
+   */
+  dacerrorcallback_t        error_cb;
+  /* End of the mandatory fields.*/
+} DACConversionGroup;
+
+/**
+ * @brief   Driver configuration structure.
+ */
+typedef struct {
+  /**
+   * @brief   Conversions per second, each conversion outputs a row.
+   * @details Zero means that each interrupt outputs half buffer.
+   */
+  uint32_t                  frequency;
+  /**
+   * @brief   WAV file receiving the output or @p NULL.
+   * @details The samples are recorded as 16 bits PCM, the file is
+   *          truncated when the driver is started.
+   */
+  const char                *wavfile;
+} DACConfig;
+
+/**
+ * @brief   Structure representing a DAC driver.
+ */
+struct DACDriver {
+  /**
+   * @brief Driver state.
+   */
+  dacstate_t                state;
+  /**
+   * @brief Current configuration data.
+   */
+  const DACConfig           *config;
+  /**
+   * @brief   Current samples buffer pointer or @p NULL.
+   */
+  const dacsample_t         *samples;
+  /**
+   * @brief   Current samples buffer depth or @p 0.
+   */
+  size_t                    depth;
+  /**
+   * @brief   Current conversion group pointer or @p NULL.
+   */
+  const DACConversionGroup  *grpp;
+#if DAC_USE_WAIT || defined(__DOXYGEN__)
+  /**
+   * @brief Waiting thread.
+   */
+  Thread                    *thread;
+#endif /* DAC_USE_WAIT */
+#if DAC_USE_MUTUAL_EXCLUSION || defined(__DOXYGEN__)
+#if CH_USE_MUTEXES || defined(__DOXYGEN__)
+  /**
+   * @brief Mutex protecting the bus.
+   */
+  Mutex                     mutex;
+#elif CH_USE_SEMAPHORES
+  Semaphore                 semaphore;
+#endif
+#endif /* DAC_USE_MUTUAL_EXCLUSION */
+#if DAC_USE_STREAMING || defined(__DOXYGEN__)
+  /**
+   * @brief   Current stream configuration or @p NULL.
+   */
+  const DACStreamConfig     *strcfg;
+  /**
+   * @brief   Ring read position in rows.
+   */
+  size_t                    strrd;
+  /**
+   * @brief   Rows in the ring.
+   */
+  size_t                    strcount;
+  /**
+   * @brief   The conversion has been started.
+   */
+  bool_t                    strstarted;
+  /**
+   * @brief   The stream is being drained, empty ring is not an underrun.
+   */
+  bool_t                    strdraining;
+  /**
+   * @brief   Refilled half buffers counter.
+   */
+  uint32_t                  strhalves;
+  /**
+   * @brief   Producer thread waiting for space.
+   */
+  Thread                    *strthread;
+  /**
+   * @brief   Stream events source.
+   */
+  EventSource               strevent;
+  /**
+   * @brief   Stream statistics.
+   */
+  DACStreamStats            strstats;
+#endif /* DAC_USE_STREAMING */
+#if defined(DAC_DRIVER_EXT_FIELDS)
+  DAC_DRIVER_EXT_FIELDS
+#endif
+  /* End of the mandatory fields.*/
+  /**
+   * @brief   Conversion start time, microseconds.
+   */
+  uint64_t                  start;
+  /**
+   * @brief   Rows output since the conversion start.
+   */
+  uint64_t                  converted;
+  /**
+   * @brief   Next row to be output from the buffer.
+   */
+  size_t                    index;
+  /**
+   * @brief   WAV file descriptor or -1.
+   */
+  int                       fd;
+  /**
+   * @brief   Channels recorded in the WAV file, zero if the header has not
+   *          been written yet.
+   */
+  unsigned                  wavchannels;
+  /**
+   * @brief   Bytes of samples recorded in the WAV file.
+   */
+  uint32_t                  wavbytes;
+  /**
+   * @brief   An error has been injected.
+   */
+  bool_t                    errpending;
+  /**
+   * @brief   Injected error code.
+   */
+  dacerror_t                error;
+};
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#if USE_SIM_DAC1 && !defined(__DOXYGEN__)
+extern DACDriver DACD1;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void dac_lld_init(void);
+  void dac_lld_start(DACDriver *dacp);
+  void dac_lld_stop(DACDriver *dacp);
+  void dac_lld_start_conversion(DACDriver *dacp);
+  void dac_lld_stop_conversion(DACDriver *dacp);
+  bool_t dac_lld_interrupt_pending(void);
+  void dacSimErrorI(DACDriver *dacp, dacerror_t err);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_DAC */
+
+#endif /* _DAC_LLD_H_ */
+
+/** @} */
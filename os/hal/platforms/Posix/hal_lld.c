@@ -24,7 +24,15 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <sys/time.h>
+#include <time.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#else
+#include <poll.h>
+#endif
 
 #include "ch.h"
 #include "hal.h"
@@ -37,13 +45,228 @@
 /* Driver local variables and types.                                         */
 /*===========================================================================*/
 
+#define NO_DEADLINE         ((uint64_t)-1)
+
+/**
+ * @brief   Earliest time requested by the simulated peripherals.
+ */
+static uint64_t deadline;
+
+/**
+ * @brief   Elapsed system ticks not yet served.
+ */
+static unsigned pending_ticks;
+
+/**
+ * @brief   Simulated events list, ordered by time.
+ */
+static SimEvent *events;
+
+/**
+ * @brief   Random generator state.
+ */
+static uint32_t rndstate = SIM_RANDOM_SEED;
+
+#if SIM_VIRTUAL_TIME
+/**
+ * @brief   Virtual time in nanoseconds.
+ */
+static uint64_t vtime;
+
+/**
+ * @brief   Virtual time of the next system tick.
+ */
+static uint64_t nexttick;
+
+#define TICK_NS             (1000000000 / CH_FREQUENCY)
+#endif
+
+#if defined(__linux__)
+/**
+ * @brief   Set of the simulated interrupt sources.
+ */
+static int epfd = -1;
+
+#if !SIM_VIRTUAL_TIME
+/**
+ * @brief   System tick timer.
+ */
+static int tickfd = -1;
+#endif
+#else
+#if !SIM_VIRTUAL_TIME
 static struct timeval nextcnt;
 static struct timeval tick = {0, 1000000 / CH_FREQUENCY};
+#endif
+static struct pollfd fds[SIM_MAX_FDS];
+static unsigned nfds;
+#endif
 
 /*===========================================================================*/
 /* Driver local functions.                                                   */
 /*===========================================================================*/
 
+/**
+ * @brief   Returns the number of system ticks elapsed since the last call.
+ */
+static unsigned ticks_elapsed(void) {
+#if SIM_VIRTUAL_TIME
+  unsigned n = 0;
+
+  while (vtime >= nexttick) {
+    nexttick += TICK_NS;
+    n++;
+  }
+  return n;
+#elif defined(__linux__)
+  uint64_t exp;
+
+  if (read(tickfd, &exp, sizeof(exp)) != sizeof(exp))
+    return 0;
+  return (unsigned)exp;
+#else
+  struct timeval tv;
+  unsigned n = 0;
+
+  gettimeofday(&tv, NULL);
+  while (timercmp(&tv, &nextcnt, >=)) {
+    timeradd(&nextcnt, &tick, &nextcnt);
+    n++;
+  }
+  return n;
+#endif
+}
+
+/**
+ * @brief   Invokes the callbacks of the expired simulated events.
+ *
+ * @return              An event has been served.
+ */
+static bool_t events_expired(void) {
+  uint64_t now;
+  SimEvent *sep;
+
+  if (events == NULL)
+    return FALSE;
+  now = hal_lld_get_time_us();
+  if (events->time > now) {
+    hal_lld_wakeup_at(events->time);
+    return FALSE;
+  }
+
+  CH_IRQ_PROLOGUE();
+
+  chSysLockFromIsr();
+  while (((sep = events) != NULL) && (sep->time <= now)) {
+    events = sep->next;
+    sep->func(sep->par);
+  }
+  chSysUnlockFromIsr();
+
+  CH_IRQ_EPILOGUE();
+
+  return TRUE;
+}
+
+/**
+ * @brief   Polling pass on the simulated interrupt sources.
+ *
+ * @return              An interrupt source has been served.
+ */
+static bool_t serve(void) {
+  bool_t b = FALSE;
+  unsigned n;
+
+  deadline = NO_DEADLINE;
+
+  /* The missed ticks are all served, the system time does not drift when
+     the host is late. The ticks after the one waking a thread are left
+     for the next pass, the thread runs at the exact system time.*/
+  n = pending_ticks + ticks_elapsed();
+  if (n > 0) {
+    CH_IRQ_PROLOGUE();
+
+    chSysLockFromIsr();
+    do {
+      chSysTimerHandlerI();
+      n--;
+    } while ((n > 0) && !chSchIsPreemptionRequired());
+    chSysUnlockFromIsr();
+
+    CH_IRQ_EPILOGUE();
+
+    pending_ticks = n;
+    b = TRUE;
+  }
+
+#if HAL_USE_SERIAL
+  b = sd_lld_interrupt_pending() || b;
+#endif
+#if HAL_USE_ADC
+  b = adc_lld_interrupt_pending() || b;
+#endif
+#if HAL_USE_CAN
+  b = can_lld_interrupt_pending() || b;
+#endif
+#if HAL_USE_DAC
+  b = dac_lld_interrupt_pending() || b;
+#endif
+#if HAL_USE_I2C
+  b = i2c_lld_interrupt_pending() || b;
+#endif
+#if HAL_USE_ICU
+  b = icu_lld_interrupt_pending() || b;
+#endif
+#if HAL_USE_SPI
+  b = spi_lld_interrupt_pending() || b;
+#endif
+  b = events_expired() || b;
+
+  /* All the sources are served before the reschedule, the woken threads
+     see the system time updated. In SMP mode the other cores are excluded
+     by the kernel spinlock.*/
+  if (b) {
+#if CH_USE_SMP
+    port_lock_from_isr();
+#endif
+    dbg_check_lock();
+    if (chSchIsPreemptionRequired())
+      chSchDoReschedule();
+    dbg_check_unlock();
+#if CH_USE_SMP
+    port_unlock_from_isr();
+#endif
+  }
+  return b;
+}
+
+#if SIM_VIRTUAL_TIME
+/**
+ * @brief   Advances the virtual time to the next deadline.
+ * @details The ticks without expiring virtual timers are skipped, the time
+ *          jumps to the first virtual timer or to the earliest time
+ *          requested by the simulated peripherals.
+ *
+ * @return              The virtual time has been advanced.
+ */
+static bool_t virtual_jump(void) {
+  uint64_t t = NO_DEADLINE;
+
+  if ((VirtualTimer *)&vtlist != vtlist.vt_next)
+    t = nexttick + (uint64_t)(vtlist.vt_next->vt_time - 1) * TICK_NS;
+  if ((deadline != NO_DEADLINE) && (deadline * 1000 < t))
+    t = deadline * 1000;
+  if (t == NO_DEADLINE)
+    return FALSE;
+
+  /* A deadline already reached makes time progress anyway.*/
+  if (t <= vtime)
+    t = vtime + SIM_VIRTUAL_QUANTUM;
+  vtime = t;
+  return TRUE;
+}
+#endif /* SIM_VIRTUAL_TIME */
+
 /*===========================================================================*/
 /* Driver interrupt handlers.                                                */
 /*===========================================================================*/
@@ -56,49 +279,320 @@ static struct timeval tick = {0, 1000000 / CH_FREQUENCY};
  * @brief Low level HAL driver initialization.
  */
 void hal_lld_init(void) {
+#if defined(__linux__) && !SIM_VIRTUAL_TIME
+  struct itimerspec its;
+#endif
 
 #if defined(__APPLE__)
   puts("ChibiOS/RT simulator (OS X)\n");
 #else
   puts("ChibiOS/RT simulator (Linux)\n");
 #endif
+  events = NULL;
+  pending_ticks = 0;
+#if SIM_VIRTUAL_TIME
+  vtime = 0;
+  nexttick = TICK_NS;
+#endif
+#if defined(__linux__)
+  epfd = epoll_create(SIM_MAX_FDS);
+  if (epfd < 0) {
+    printf("Error creating the interrupt sources set\n");
+    exit(1);
+  }
+#if !SIM_VIRTUAL_TIME
+  tickfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+  if (tickfd < 0) {
+    printf("Error creating the system tick timer\n");
+    exit(1);
+  }
+  its.it_interval.tv_sec  = 1 / CH_FREQUENCY;
+  its.it_interval.tv_nsec = (1000000000 / CH_FREQUENCY) % 1000000000;
+  its.it_value = its.it_interval;
+  timerfd_settime(tickfd, 0, &its, NULL);
+  hal_lld_add_fd(tickfd);
+#endif
+#else
+  nfds = 0;
+#if !SIM_VIRTUAL_TIME
   gettimeofday(&nextcnt, NULL);
   timeradd(&nextcnt, &tick, &nextcnt);
+#endif
+#endif
+}
+
+/**
+ * @brief   Returns the current value of the system free running counter.
+ * @note    This service is implemented by reading the host monotonic clock,
+ *          or the virtual time if @p SIM_VIRTUAL_TIME is enabled,
+ *          the value wraps every 4.29 seconds.
+ *
+ * @return              The value of the system free running counter of
+ *                      type halrtcnt_t.
+ *
+ * @notapi
+ */
+halrtcnt_t hal_lld_get_counter_value(void) {
+#if SIM_VIRTUAL_TIME
+
+  return (halrtcnt_t)vtime;
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (halrtcnt_t)((uint32_t)ts.tv_sec * 1000000000U +
+                      (uint32_t)ts.tv_nsec);
+#endif
+}
+
+/**
+ * @brief   Returns the simulated time.
+ * @details The simulated peripherals use this time base, it is the virtual
+ *          time if @p SIM_VIRTUAL_TIME is enabled else the host monotonic
+ *          clock.
+ *
+ * @return              The simulated time in microseconds.
+ *
+ * @notapi
+ */
+uint64_t hal_lld_get_time_us(void) {
+#if SIM_VIRTUAL_TIME
+
+  return vtime / 1000;
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+#endif
+}
+
+/**
+ * @brief   Adds a file descriptor to the simulated interrupt sources.
+ * @details The idle wait is ended when the descriptor becomes readable.
+ *
+ * @param[in] fd        the file descriptor
+ *
+ * @notapi
+ */
+void hal_lld_add_fd(int fd) {
+#if defined(__linux__)
+  struct epoll_event ev;
+
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+    printf("Error adding descriptor %d to the interrupt sources\n", fd);
+    exit(1);
+  }
+#else
+  if (nfds >= SIM_MAX_FDS) {
+    printf("Error adding descriptor %d to the interrupt sources\n", fd);
+    exit(1);
+  }
+  fds[nfds].fd = fd;
+  fds[nfds].events = POLLIN;
+  nfds++;
+#endif
+}
+
+/**
+ * @brief   Removes a file descriptor from the simulated interrupt sources.
+ * @note    Must be invoked before closing the descriptor.
+ *
+ * @param[in] fd        the file descriptor
+ *
+ * @notapi
+ */
+void hal_lld_remove_fd(int fd) {
+#if defined(__linux__)
+  struct epoll_event ev;
+
+  (void)epoll_ctl(epfd, EPOLL_CTL_DEL, fd, &ev);
+#else
+  unsigned i;
+
+  for (i = 0; i < nfds; i++) {
+    if (fds[i].fd == fd) {
+      fds[i] = fds[--nfds];
+      return;
+    }
+  }
+#endif
+}
+
+/**
+ * @brief   Requests a polling pass at the specified time.
+ * @details Invoked by the simulated peripherals having a time driven
+ *          operation in progress, the completion of the operation is not
+ *          signaled by a file descriptor. In virtual time mode the time
+ *          jumps to the earliest requested time, else the interrupt
+ *          sources are polled until then.
+ *
+ * @param[in] time      the simulated time in microseconds
+ *
+ * @notapi
+ */
+void hal_lld_wakeup_at(uint64_t time) {
+
+  if (time < deadline)
+    deadline = time;
+}
+
+/**
+ * @brief   Schedules a simulated event.
+ * @details The callback is invoked by the interrupt simulation when the
+ *          simulated time reaches the specified time. If the event is
+ *          already scheduled it is rescheduled.
+ * @note    Events with the same time are served in the scheduling order.
+ *
+ * @param[out] sep      pointer to the @p SimEvent object
+ * @param[in] time      the simulated time in microseconds, see
+ *                      @p hal_lld_get_time_us()
+ * @param[in] func      the callback function
+ * @param[in] par       parameter for the callback function
+ *
+ * @iclass
+ */
+void simEventSetI(SimEvent *sep, uint64_t time,
+                  simeventcb_t func, void *par) {
+  SimEvent **spp = &events;
+
+  chDbgCheckClassI();
+  chDbgCheck((sep != NULL) && (func != NULL), "simEventSetI");
+
+  simEventResetI(sep);
+  sep->time = time;
+  sep->func = func;
+  sep->par  = par;
+  while ((*spp != NULL) && ((*spp)->time <= time))
+    spp = &(*spp)->next;
+  sep->next = *spp;
+  *spp = sep;
+}
+
+/**
+ * @brief   Cancels a simulated event.
+ * @note    Nothing happens if the event is not scheduled.
+ *
+ * @param[in] sep       pointer to the @p SimEvent object
+ *
+ * @iclass
+ */
+void simEventResetI(SimEvent *sep) {
+  SimEvent **spp = &events;
+
+  chDbgCheckClassI();
+  chDbgCheck(sep != NULL, "simEventResetI");
+
+  while (*spp != NULL) {
+    if (*spp == sep) {
+      *spp = sep->next;
+      return;
+    }
+    spp = &(*spp)->next;
+  }
+}
+
+/**
+ * @brief   Simulator random generator.
+ * @details The sequence only depends on the seed, the simulated stimuli
+ *          generated using this function are reproducible.
+ *
+ * @return              A pseudo random 32 bits value.
+ */
+uint32_t simRandom(void) {
+  uint32_t x = rndstate;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  rndstate = x;
+  return x;
+}
+
+/**
+ * @brief   Sets the seed of the simulator random generator.
+ *
+ * @param[in] seed      the new seed, zero is replaced by one
+ */
+void simSetSeed(uint32_t seed) {
+
+  rndstate = seed != 0 ? seed : 1;
 }
 
 /**
  * @brief Interrupt simulation.
+ * @note    In virtual time mode each invocation advances the time by
+ *          @p SIM_VIRTUAL_QUANTUM.
  */
 void ChkIntSources(void) {
-  struct timeval tv;
 
-#if HAL_USE_SERIAL
-  if (sd_lld_interrupt_pending()) {
-    dbg_check_lock();
-    if (chSchIsPreemptionRequired())
-      chSchDoReschedule();
-    dbg_check_unlock();
-    return;
-  }
+#if SIM_VIRTUAL_TIME
+  vtime += SIM_VIRTUAL_QUANTUM;
 #endif
+  (void)serve();
+}
 
-  gettimeofday(&tv, NULL);
-  if (timercmp(&tv, &nextcnt, >=)) {
-    timeradd(&nextcnt, &tick, &nextcnt);
+/**
+ * @brief   Waits for the next simulated interrupt.
+ * @details A polling pass is performed, if no interrupt source has been
+ *          served the host thread is blocked until a registered file
+ *          descriptor becomes readable, the next system tick or the time
+ *          requested by a simulated peripheral, then the interrupt sources
+ *          are served.
+ * @note    In virtual time mode the host thread is only blocked if there
+ *          is nothing scheduled, the virtual time jumps to the next
+ *          deadline instead. Each invocation advances the time by
+ *          @p SIM_VIRTUAL_QUANTUM, peripherals always ready do not stop
+ *          the time.
+ */
+void WaitIntSources(void) {
+#if defined(__linux__)
+  struct epoll_event evs[SIM_MAX_FDS];
+#endif
+  int ms = -1;
 
-    CH_IRQ_PROLOGUE();
+#if SIM_VIRTUAL_TIME
+  vtime += SIM_VIRTUAL_QUANTUM;
+#endif
+  if (serve())
+    return;
 
-    chSysLockFromIsr();
-    chSysTimerHandlerI();
-    chSysUnlockFromIsr();
+#if SIM_VIRTUAL_TIME
+  if (virtual_jump()) {
+    (void)serve();
+    return;
+  }
+#else
+  if (deadline != NO_DEADLINE) {
+    uint64_t now = hal_lld_get_time_us();
 
-    CH_IRQ_EPILOGUE();
+    ms = deadline > now ? (int)((deadline - now) / 1000) : 0;
+  }
+#endif
 
-    dbg_check_lock();
-    if (chSchIsPreemptionRequired())
-      chSchDoReschedule();
-    dbg_check_unlock();
+#if defined(__linux__)
+  (void)epoll_wait(epfd, evs, SIM_MAX_FDS, ms);
+#else
+#if !SIM_VIRTUAL_TIME
+  {
+    struct timeval tv;
+    int tms = 0;
+
+    /* The system tick is not a descriptor on this host.*/
+    gettimeofday(&tv, NULL);
+    if (timercmp(&nextcnt, &tv, >)) {
+      timersub(&nextcnt, &tv, &tv);
+      tms = (int)(tv.tv_sec * 1000 + (tv.tv_usec + 999) / 1000);
+    }
+    if ((ms < 0) || (tms < ms))
+      ms = tms;
   }
+#endif
+  (void)poll(fds, nfds, ms);
+#endif
+  (void)serve();
 }
 
 /** @} */
@@ -36,7 +36,7 @@
 /**
  * @brief   Defines the support for realtime counters in the HAL.
  */
-#define HAL_IMPLEMENTS_COUNTERS FALSE
+#define HAL_IMPLEMENTS_COUNTERS TRUE
 
 /**
  * @brief   Platform name.
@@ -50,18 +50,119 @@
 /* Driver pre-compile time settings.                                         */
 /*===========================================================================*/
 
+/**
+ * @brief   Maximum number of file descriptors in the interrupt sources.
+ * @details On Linux the system tick timer takes one descriptor.
+ */
+#if !defined(SIM_MAX_FDS) || defined(__DOXYGEN__)
+#define SIM_MAX_FDS                 16
+#endif
+
+/**
+ * @brief   Virtual time mode.
+ * @details If set to @p TRUE the simulated time is not the host time, when
+ *          the system is idle the time jumps to the next virtual timer
+ *          expiration or device event. Long timeouts are simulated in a
+ *          fraction of the host time and the execution is reproducible.
+ * @note    The host sockets are still served, their traffic is not
+ *          reproducible, the simulated events should be used instead.
+ * @note    The execution is deterministic with the SIMIA32 port only, the
+ *          host signals of the SIMX64 port are not synchronous with the
+ *          virtual time.
+ */
+#if !defined(SIM_VIRTUAL_TIME) || defined(__DOXYGEN__)
+#define SIM_VIRTUAL_TIME            FALSE
+#endif
+
+/**
+ * @brief   Virtual time spent by a polling pass, in nanoseconds.
+ * @details Each polling pass on the interrupt sources advances the virtual
+ *          time by this amount, busy waits on the system time terminate.
+ * @note    Only used if @p SIM_VIRTUAL_TIME is enabled.
+ */
+#if !defined(SIM_VIRTUAL_QUANTUM) || defined(__DOXYGEN__)
+#define SIM_VIRTUAL_QUANTUM         1000
+#endif
+
+/**
+ * @brief   Initial seed of the simulator random generator.
+ */
+#if !defined(SIM_RANDOM_SEED) || defined(__DOXYGEN__)
+#define SIM_RANDOM_SEED             1
+#endif
+
 /*===========================================================================*/
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
 
+#if SIM_VIRTUAL_TIME && (SIM_VIRTUAL_QUANTUM <= 0)
+#error "invalid SIM_VIRTUAL_QUANTUM value"
+#endif
+
+#if SIM_VIRTUAL_TIME && CH_USE_SMP
+#error "SIM_VIRTUAL_TIME is not supported in SMP mode"
+#endif
+
 /*===========================================================================*/
 /* Driver data structures and types.                                         */
 /*===========================================================================*/
 
+/**
+ * @brief   Simulated event callback type.
+ * @note    The callback is invoked from ISR context with the system locked,
+ *          only I-class APIs can be used.
+ */
+typedef void (*simeventcb_t)(void *par);
+
+/**
+ * @brief   Simulated event.
+ * @details Events are device stimuli scheduled on the simulated time, the
+ *          virtual time or the host time.
+ */
+typedef struct SimEvent {
+  /**
+   * @brief   Next event in the list.
+   */
+  struct SimEvent           *next;
+  /**
+   * @brief   Event time in microseconds.
+   */
+  uint64_t                  time;
+  /**
+   * @brief   Event callback.
+   */
+  simeventcb_t              func;
+  /**
+   * @brief   Callback parameter.
+   */
+  void                      *par;
+} SimEvent;
+
+/**
+ * @brief   Type representing a system clock frequency.
+ */
+typedef uint32_t halclock_t;
+
+/**
+ * @brief   Type of the realtime free counter value.
+ */
+typedef uint32_t halrtcnt_t;
+
 /*===========================================================================*/
 /* Driver macros.                                                            */
 /*===========================================================================*/
 
+/**
+ * @brief   Realtime counter frequency.
+ * @note    The counter is the host monotonic clock in nanoseconds, or the
+ *          virtual time if @p SIM_VIRTUAL_TIME is enabled.
+ *
+ * @return              The realtime counter frequency of type halclock_t.
+ *
+ * @notapi
+ */
+#define hal_lld_get_counter_frequency()     1000000000U
+
 /*===========================================================================*/
 /* External declarations.                                                    */
 /*===========================================================================*/
@@ -70,7 +171,18 @@
 extern "C" {
 #endif
   void hal_lld_init(void);
+  halrtcnt_t hal_lld_get_counter_value(void);
+  void hal_lld_add_fd(int fd);
+  void hal_lld_remove_fd(int fd);
+  uint64_t hal_lld_get_time_us(void);
+  void hal_lld_wakeup_at(uint64_t time);
+  void simEventSetI(SimEvent *sep, uint64_t time,
+                    simeventcb_t func, void *par);
+  void simEventResetI(SimEvent *sep);
+  uint32_t simRandom(void);
+  void simSetSeed(uint32_t seed);
   void ChkIntSources(void);
+  void WaitIntSources(void);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,410 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    Posix/i2c_lld.c
+ * @brief   Posix low level simulated I2C driver code.
+ * @details The bus is simulated in memory, device models are attached to
+ *          the bus and invoked when their address is matched. The data
+ *          is moved when the operation is started and the completion
+ *          interrupt is raised when the time required by the configured
+ *          clock has elapsed.
+ *
+ * @addtogroup POSIX_I2C
+ * @{
+ */
+
+
+#include "ch.h"
+#include "hal.h"
+
+#if HAL_USE_I2C || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/**
+ * @brief   Maximum operations completed by a single interrupt.
+ */
+#define COMPLETE_BURST              64
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/** @brief I2C1 driver identifier.*/
+#if USE_SIM_I2C1 || defined(__DOXYGEN__)
+I2CDriver I2CD1;
+#endif
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static uint64_t now_us(void) {
+
+  return hal_lld_get_time_us();
+}
+
+static I2CSimDevice *find(I2CDriver *i2cp, i2caddr_t addr) {
+  I2CSimDevice *devp = i2cp->devices;
+
+  while ((devp != NULL) && (devp->addr != addr))
+    devp = devp->next;
+  return devp;
+}
+
+/**
+ * @brief   Executes an operation on the simulated bus.
+ * @details The data is moved immediately, the completion is delayed by
+ *          the time required for clocking the transferred bytes, each
+ *          byte takes nine clock cycles plus the start and stop
+ *          conditions.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] addr      slave device address
+ * @param[in] txbuf     pointer to the transmit buffer
+ * @param[in] txbytes   number of bytes to be transmitted
+ * @param[out] rxbuf    pointer to the receive buffer
+ * @param[in] rxbytes   number of bytes to be received
+ */
+static void start(I2CDriver *i2cp, i2caddr_t addr,
+                  const uint8_t *txbuf, size_t txbytes,
+                  uint8_t *rxbuf, size_t rxbytes) {
+  I2CSimDevice *devp = find(i2cp, addr);
+  size_t bytes = 0, n;
+
+  i2cp->errors = I2CD_NO_ERROR;
+  i2cp->msg = RDY_OK;
+  if (txbytes > 0) {
+    bytes++;
+    if (devp == NULL)
+      i2cp->errors = I2CD_ACK_FAILURE;
+    else {
+      n = devp->write(devp, txbuf, txbytes);
+      bytes += n < txbytes ? n + 1 : n;
+      if (n < txbytes)
+        i2cp->errors = I2CD_ACK_FAILURE;
+    }
+  }
+  if ((rxbytes > 0) && (i2cp->errors == I2CD_NO_ERROR)) {
+    bytes++;
+    if (devp == NULL)
+      i2cp->errors = I2CD_ACK_FAILURE;
+    else {
+      devp->read(devp, rxbuf, rxbytes);
+      bytes += rxbytes;
+    }
+  }
+  if (i2cp->errors != I2CD_NO_ERROR)
+    i2cp->msg = RDY_RESET;
+
+  i2cp->operations++;
+  i2cp->bytes += (uint32_t)bytes;
+  if (i2cp->config->clock_speed == 0)
+    i2cp->deadline = 0;
+  else
+    i2cp->deadline = now_us() + ((uint64_t)(bytes * 9 + 2) * 1000000) /
+                                i2cp->config->clock_speed;
+  i2cp->busy = TRUE;
+}
+
+/**
+ * @brief   Completion interrupt simulation.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @return              An interrupt has been served.
+ */
+static bool_t endint(I2CDriver *i2cp) {
+  unsigned i;
+  uint64_t now;
+
+  if (!i2cp->busy || i2cp->hold)
+    return FALSE;
+  hal_lld_wakeup_at(i2cp->deadline);
+  now = i2cp->deadline != 0 ? now_us() : 0;
+  for (i = 0; i2cp->busy && (i2cp->deadline <= now); i++) {
+    if (i >= COMPLETE_BURST)
+      break;
+    i2cp->busy = FALSE;
+#if I2C_USE_TRANSACTIONS
+    if (i2cp->txncur != NULL) {
+      _i2c_txn_isr(i2cp, i2cp->msg);
+      continue;
+    }
+#endif
+    chSysLockFromIsr();
+    if (i2cp->thread != NULL) {
+      Thread *tp = i2cp->thread;
+      i2cp->thread = NULL;
+      tp->p_u.rdymsg = i2cp->msg;
+      chSchReadyI(tp);
+    }
+    chSysUnlockFromIsr();
+  }
+  return i > 0;
+}
+
+/**
+ * @brief   Waits for the completion of a synchronous operation.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] timeout   the number of ticks before the operation timeouts
+ * @return              The operation status.
+ */
+static msg_t wait_s(I2CDriver *i2cp, systime_t timeout) {
+  msg_t msg;
+
+  i2cp->thread = chThdSelf();
+  msg = chSchGoSleepTimeoutS(THD_STATE_SUSPENDED, timeout);
+  if (msg == RDY_TIMEOUT) {
+    i2cp->thread = NULL;
+    i2cp->busy = FALSE;
+  }
+  return msg;
+}
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level I2C driver initialization.
+ *
+ * @notapi
+ */
+void i2c_lld_init(void) {
+
+#if USE_SIM_I2C1
+  i2cObjectInit(&I2CD1);
+  I2CD1.thread = NULL;
+  I2CD1.devices = NULL;
+  I2CD1.busy = FALSE;
+  I2CD1.hold = FALSE;
+  I2CD1.operations = 0;
+  I2CD1.bytes = 0;
+#endif
+}
+
+/**
+ * @brief   Configures and activates the I2C peripheral.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ *
+ * @notapi
+ */
+void i2c_lld_start(I2CDriver *i2cp) {
+
+  i2cp->busy = FALSE;
+}
+
+/**
+ * @brief   Deactivates the I2C peripheral.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ *
+ * @notapi
+ */
+void i2c_lld_stop(I2CDriver *i2cp) {
+
+  i2cp->busy = FALSE;
+}
+
+/**
+ * @brief   Receives data via the I2C bus as master.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] addr      slave device address
+ * @param[out] rxbuf    pointer to the receive buffer
+ * @param[in] rxbytes   number of bytes to be received
+ * @param[in] timeout   the number of ticks before the operation timeouts,
+ *                      the following special values are allowed:
+ *                      - @a TIME_INFINITE no timeout.
+ *                      .
+ * @return              The operation status.
+ * @retval RDY_OK       if the function succeeded.
+ * @retval RDY_RESET    if one or more I2C errors occurred, the errors can
+ *                      be retrieved using @p i2cGetErrors().
+ * @retval RDY_TIMEOUT  if a timeout occurred before operation end.
+ *
+ * @notapi
+ */
+msg_t i2c_lld_master_receive_timeout(I2CDriver *i2cp, i2caddr_t addr,
+                                     uint8_t *rxbuf, size_t rxbytes,
+                                     systime_t timeout) {
+
+  start(i2cp, addr, NULL, 0, rxbuf, rxbytes);
+  return wait_s(i2cp, timeout);
+}
+
+/**
+ * @brief   Transmits data via the I2C bus as master.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] addr      slave device address
+ * @param[in] txbuf     pointer to the transmit buffer
+ * @param[in] txbytes   number of bytes to be transmitted
+ * @param[out] rxbuf    pointer to the receive buffer
+ * @param[in] rxbytes   number of bytes to be received
+ * @param[in] timeout   the number of ticks before the operation timeouts,
+ *                      the following special values are allowed:
+ *                      - @a TIME_INFINITE no timeout.
+ *                      .
+ * @return              The operation status.
+ * @retval RDY_OK       if the function succeeded.
+ * @retval RDY_RESET    if one or more I2C errors occurred, the errors can
+ *                      be retrieved using @p i2cGetErrors().
+ * @retval RDY_TIMEOUT  if a timeout occurred before operation end.
+ *
+ * @notapi
+ */
+msg_t i2c_lld_master_transmit_timeout(I2CDriver *i2cp, i2caddr_t addr,
+                                      const uint8_t *txbuf, size_t txbytes,
+                                      uint8_t *rxbuf, size_t rxbytes,
+                                      systime_t timeout) {
+
+  start(i2cp, addr, txbuf, txbytes, rxbuf, rxbytes);
+  return wait_s(i2cp, timeout);
+}
+
+#if I2C_USE_TRANSACTIONS || defined(__DOXYGEN__)
+/**
+ * @brief   Starts an asynchronous transaction.
+ * @details The operation end is notified by calling @p _i2c_txn_isr() from
+ *          the simulated interrupt.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] addr      slave device address
+ * @param[in] txbuf     pointer to the transmit buffer
+ * @param[in] txbytes   number of bytes to be transmitted, zero for a read
+ *                      only transaction
+ * @param[out] rxbuf    pointer to the receive buffer
+ * @param[in] rxbytes   number of bytes to be received
+ *
+ * @notapi
+ */
+void i2c_lld_start_transaction(I2CDriver *i2cp, i2caddr_t addr,
+                               const uint8_t *txbuf, size_t txbytes,
+                               uint8_t *rxbuf, size_t rxbytes) {
+
+  start(i2cp, addr, txbuf, txbytes, rxbuf, rxbytes);
+}
+
+/**
+ * @brief   Aborts the transaction in progress.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ *
+ * @notapi
+ */
+void i2c_lld_abort_transaction(I2CDriver *i2cp) {
+
+  i2cp->busy = FALSE;
+}
+#endif /* I2C_USE_TRANSACTIONS */
+
+/**
+ * @brief   I2C interrupts simulation.
+ *
+ * @return              An interrupt has been served.
+ *
+ * @notapi
+ */
+bool_t i2c_lld_interrupt_pending(void) {
+  bool_t b = FALSE;
+
+  CH_IRQ_PROLOGUE();
+
+#if USE_SIM_I2C1
+  b = endint(&I2CD1) || b;
+#endif
+
+  CH_IRQ_EPILOGUE();
+
+  return b;
+}
+
+/**
+ * @brief   Attaches a simulated device to the bus.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] devp      pointer to the @p I2CSimDevice object
+ *
+ * @api
+ */
+void i2cSimAttach(I2CDriver *i2cp, I2CSimDevice *devp) {
+
+  chDbgCheck((i2cp != NULL) && (devp != NULL) &&
+             (devp->write != NULL) && (devp->read != NULL), "i2cSimAttach");
+
+  chSysLock();
+  devp->next = i2cp->devices;
+  i2cp->devices = devp;
+  chSysUnlock();
+}
+
+/**
+ * @brief   Detaches a simulated device from the bus.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] devp      pointer to the @p I2CSimDevice object
+ *
+ * @api
+ */
+void i2cSimDetach(I2CDriver *i2cp, I2CSimDevice *devp) {
+  I2CSimDevice **pp;
+
+  chDbgCheck((i2cp != NULL) && (devp != NULL), "i2cSimDetach");
+
+  chSysLock();
+  for (pp = &i2cp->devices; *pp != NULL; pp = &(*pp)->next) {
+    if (*pp == devp) {
+      *pp = devp->next;
+      break;
+    }
+  }
+  chSysUnlock();
+}
+
+/**
+ * @brief   Simulates a slave holding the clock line low.
+ * @details While the bus is held the operations in progress do not
+ *          complete, used for testing the timeouts.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] hold      @p TRUE for holding the bus
+ *
+ * @api
+ */
+void i2cSimHoldBus(I2CDriver *i2cp, bool_t hold) {
+
+  chDbgCheck(i2cp != NULL, "i2cSimHoldBus");
+
+  i2cp->hold = hold;
+}
+
+#endif /* HAL_USE_I2C */
+
+/** @} */
@@ -0,0 +1,254 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    Posix/i2c_lld.h
+ * @brief   Posix low level simulated I2C driver header.
+ *
+ * @addtogroup POSIX_I2C
+ * @{
+ */
+
+#ifndef _I2C_LLD_H_
+#define _I2C_LLD_H_
+
+#if HAL_USE_I2C || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   This implementation supports the transactions queue.
+ */
+#define I2C_SUPPORTS_TRANSACTIONS   TRUE
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   I2C1 driver enable switch.
+ * @details If set to @p TRUE the support for I2C1 is included.
+ * @note    The default is @p TRUE.
+ */
+#if !defined(USE_SIM_I2C1) || defined(__DOXYGEN__)
+#define USE_SIM_I2C1                TRUE
+#endif
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if I2C_USE_TRANSACTIONS && !I2C_SUPPORTS_TRANSACTIONS
+#error "I2C transactions not supported in this architecture"
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Type representing I2C address.
+ */
+typedef uint16_t i2caddr_t;
+
+/**
+ * @brief   Type of I2C Driver condition flags.
+ */
+typedef uint32_t i2cflags_t;
+
+/**
+ * @brief   Type of a simulated slave device.
+ */
+typedef struct I2CSimDevice I2CSimDevice;
+
+/**
+ * @brief   Simulated slave device.
+ * @details Device models embed this structure as first field, the bus
+ *          invokes the methods when the device address is matched.
+ */
+struct I2CSimDevice {
+  /**
+   * @brief   Next device on the bus.
+   */
+  I2CSimDevice              *next;
+  /**
+   * @brief   Device address (7 bits) without R/W bit.
+   */
+  i2caddr_t                 addr;
+  /**
+   * @brief   Write phase method.
+   * @return                The number of bytes acknowledged, the master
+   *                        stops at the first not acknowledged byte.
+   */
+  size_t                    (*write)(I2CSimDevice *devp,
+                                     const uint8_t *buf, size_t n);
+  /**
+   * @brief   Read phase method.
+   */
+  void                      (*read)(I2CSimDevice *devp,
+                                    uint8_t *buf, size_t n);
+};
+
+/**
+ * @brief Driver configuration structure.
+ */
+typedef struct {
+  /**
+   * @brief   Simulated bus clock in Hz.
+   * @details Operations complete after the time required for clocking
+   *          the bits at this rate, zero means no delay.
+   */
+  uint32_t                  clock_speed;
+} I2CConfig;
+
+/**
+ * @brief   Type of a structure representing an I2C driver.
+ */
+typedef struct I2CDriver I2CDriver;
+
+/**
+ * @brief Structure representing an I2C driver.
+ */
+struct I2CDriver {
+  /**
+   * @brief   Driver state.
+   */
+  i2cstate_t                state;
+  /**
+   * @brief   Current configuration data.
+   */
+  const I2CConfig           *config;
+  /**
+   * @brief   Error flags.
+   */
+  i2cflags_t                errors;
+#if I2C_USE_MUTUAL_EXCLUSION || defined(__DOXYGEN__)
+#if CH_USE_MUTEXES || defined(__DOXYGEN__)
+  /**
+   * @brief   Mutex protecting the bus.
+   */
+  Mutex                     mutex;
+#elif CH_USE_SEMAPHORES
+  Semaphore                 semaphore;
+#endif
+#endif /* I2C_USE_MUTUAL_EXCLUSION */
+#if I2C_USE_TRANSACTIONS || defined(__DOXYGEN__)
+  /**
+   * @brief   Transaction being executed.
+   */
+  I2CTransaction            *txncur;
+  /**
+   * @brief   Queued transactions in priority order.
+   */
+  I2CTransaction            *txnqueue;
+  /**
+   * @brief   Transactions timeout timer.
+   */
+  VirtualTimer              txnvt;
+#endif /* I2C_USE_TRANSACTIONS */
+#if defined(I2C_DRIVER_EXT_FIELDS)
+  I2C_DRIVER_EXT_FIELDS
+#endif
+  /* End of the mandatory fields.*/
+  /**
+   * @brief   Thread waiting for I/O completion.
+   */
+  Thread                    *thread;
+  /**
+   * @brief   Devices attached to the bus.
+   */
+  I2CSimDevice              *devices;
+  /**
+   * @brief   An operation is in progress.
+   */
+  bool_t                    busy;
+  /**
+   * @brief   A slave holds the clock low, operations never complete.
+   */
+  bool_t                    hold;
+  /**
+   * @brief   Completion message of the operation in progress.
+   */
+  msg_t                     msg;
+  /**
+   * @brief   Completion time of the operation in progress, microseconds.
+   */
+  uint64_t                  deadline;
+  /**
+   * @brief   Operations counter.
+   */
+  uint32_t                  operations;
+  /**
+   * @brief   Transferred bytes counter, addresses included.
+   */
+  uint32_t                  bytes;
+};
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/**
+ * @brief   Get errors from I2C driver.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ *
+ * @notapi
+ */
+#define i2c_lld_get_errors(i2cp) ((i2cp)->errors)
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#if USE_SIM_I2C1 && !defined(__DOXYGEN__)
+extern I2CDriver I2CD1;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void i2c_lld_init(void);
+  void i2c_lld_start(I2CDriver *i2cp);
+  void i2c_lld_stop(I2CDriver *i2cp);
+  msg_t i2c_lld_master_transmit_timeout(I2CDriver *i2cp, i2caddr_t addr,
+                                        const uint8_t *txbuf, size_t txbytes,
+                                        uint8_t *rxbuf, size_t rxbytes,
+                                        systime_t timeout);
+  msg_t i2c_lld_master_receive_timeout(I2CDriver *i2cp, i2caddr_t addr,
+                                       uint8_t *rxbuf, size_t rxbytes,
+                                       systime_t timeout);
+#if I2C_USE_TRANSACTIONS
+  void i2c_lld_start_transaction(I2CDriver *i2cp, i2caddr_t addr,
+                                 const uint8_t *txbuf, size_t txbytes,
+                                 uint8_t *rxbuf, size_t rxbytes);
+  void i2c_lld_abort_transaction(I2CDriver *i2cp);
+#endif /* I2C_USE_TRANSACTIONS */
+  bool_t i2c_lld_interrupt_pending(void);
+  void i2cSimAttach(I2CDriver *i2cp, I2CSimDevice *devp);
+  void i2cSimDetach(I2CDriver *i2cp, I2CSimDevice *devp);
+  void i2cSimHoldBus(I2CDriver *i2cp, bool_t hold);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_I2C */
+
+#endif /* _I2C_LLD_H_ */
+
+/** @} */
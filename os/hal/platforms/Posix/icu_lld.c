@@ -0,0 +1,310 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    Posix/icu_lld.c
+ * @brief   Posix low level simulated ICU driver code.
+ * @details A recorded pulse train is replayed on a free running 16 bits
+ *          counter, the edges due since the replay start are generated
+ *          each time the interrupt sources are polled. While capturing
+ *          the edges are written in the ring as a circular DMA would do.
+ *
+ * @addtogroup POSIX_ICU
+ * @{
+ */
+
+
+#include "ch.h"
+#include "hal.h"
+
+#if HAL_USE_ICU || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/**
+ * @brief   Counter range in ticks.
+ */
+#define COUNTER_RANGE               0x10000
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/** @brief ICU1 driver identifier.*/
+#if USE_SIM_ICU1 || defined(__DOXYGEN__)
+ICUDriver ICUD1;
+#endif
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static uint64_t now_us(void) {
+
+  return hal_lld_get_time_us();
+}
+
+/**
+ * @brief   Restarts the pulse train replay.
+ *
+ * @param[in] icup      pointer to the @p ICUDriver object
+ */
+static void replay_start(ICUDriver *icup) {
+
+  icup->start   = now_us();
+  icup->ticks   = 0;
+  icup->last    = 0;
+  icup->edges   = 0;
+  icup->pos     = 0;
+  icup->running = TRUE;
+}
+
+/**
+ * @brief   Generates the next edge of the pulse train.
+ *
+ * @param[in] icup      pointer to the @p ICUDriver object
+ */
+static void edge(ICUDriver *icup) {
+  bool_t active = (icup->edges & 1) == 0;
+
+#if ICU_USE_CAPTURE
+  if (icup->state == ICU_CAPTURING) {
+    const ICUCaptureConfig *config = icup->capcfg;
+
+    /* The counter value is logged as the DMA would do.*/
+    config->ring[icup->capidx] = (icucnt_t)icup->ticks;
+    icup->capidx = (icup->capidx + 1) & (config->size - 1);
+    if (++icup->capfill >= config->size / 2) {
+      icup->capfill = 0;
+      _icu_capture_isr(icup, config->size / 2);
+    }
+  }
+  else
+#endif /* ICU_USE_CAPTURE */
+  if (active) {
+    /* The first active edge only starts the measurement.*/
+    if ((icup->edges > 0) && (icup->ticks - icup->last >= COUNTER_RANGE) &&
+        (icup->config->overflow_cb != NULL))
+      _icu_isr_invoke_overflow_cb(icup);
+    icup->period = (icucnt_t)(icup->ticks - icup->last);
+    _icu_isr_invoke_period_cb(icup);
+  }
+  else {
+    icup->width = (icucnt_t)(icup->ticks - icup->last);
+    _icu_isr_invoke_width_cb(icup);
+  }
+  if (active)
+    icup->last = icup->ticks;
+  icup->edges++;
+  icup->ticks += icup->config->train[icup->pos];
+  if (++icup->pos >= icup->config->length)
+    icup->pos = 0;
+}
+
+/**
+ * @brief   Capture interrupt simulation.
+ *
+ * @param[in] icup      pointer to the @p ICUDriver object
+ * @return              An interrupt has been served.
+ */
+static bool_t capint(ICUDriver *icup) {
+  uint64_t due;
+  uint32_t n;
+
+  if (!icup->running)
+    return FALSE;
+  if (!icup->config->realtime) {
+#if ICU_USE_CAPTURE
+    if (icup->state == ICU_CAPTURING) {
+      /* One half ring each time, as the DMA interrupt would do. The replay
+         has no time reference, the next half ring is only written while
+         the reader is waiting for edges, the reader could otherwise be
+         still copying the reported edges. The edges are not lost if the
+         batch size divides the half ring.*/
+      if (icup->capthread == NULL)
+        return FALSE;
+      n = (uint32_t)(icup->capcfg->size / 2 - icup->capfill);
+      while (icup->running && (n-- > 0))
+        edge(icup);
+      return TRUE;
+    }
+#endif /* ICU_USE_CAPTURE */
+    edge(icup);
+    return TRUE;
+  }
+  due = ((now_us() - icup->start) * icup->config->frequency) / 1000000;
+  if (icup->ticks > due) {
+    hal_lld_wakeup_at(icup->start +
+                      (icup->ticks * 1000000 + icup->config->frequency - 1) /
+                      icup->config->frequency);
+    return FALSE;
+  }
+  n = 0;
+  while (icup->running && (icup->ticks <= due)) {
+    edge(icup);
+    n++;
+#if ICU_USE_CAPTURE
+    /* More than half ring due at once means that the host did not run the
+       simulator for a while, the missed time is skipped as if the train
+       had been paused.*/
+    if ((icup->state == ICU_CAPTURING) && (n >= icup->capcfg->size / 2)) {
+      icup->start = now_us() -
+                    (icup->ticks * 1000000) / icup->config->frequency;
+      break;
+    }
+#endif /* ICU_USE_CAPTURE */
+  }
+  return n > 0;
+}
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level ICU driver initialization.
+ *
+ * @notapi
+ */
+void icu_lld_init(void) {
+
+#if USE_SIM_ICU1
+  icuObjectInit(&ICUD1);
+  ICUD1.running = FALSE;
+#endif
+}
+
+/**
+ * @brief   Configures and activates the ICU peripheral.
+ *
+ * @param[in] icup      pointer to the @p ICUDriver object
+ *
+ * @notapi
+ */
+void icu_lld_start(ICUDriver *icup) {
+
+  chDbgAssert((icup->config->train != NULL) &&
+              (icup->config->length >= 2) &&
+              ((icup->config->length & 1) == 0) &&
+              (icup->config->frequency > 0),
+              "icu_lld_start(), #1", "invalid pulse train");
+
+  icup->running = FALSE;
+  icup->width   = 0;
+  icup->period  = 0;
+}
+
+/**
+ * @brief   Deactivates the ICU peripheral.
+ *
+ * @param[in] icup      pointer to the @p ICUDriver object
+ *
+ * @notapi
+ */
+void icu_lld_stop(ICUDriver *icup) {
+
+  icup->running = FALSE;
+}
+
+/**
+ * @brief   Enables the input capture.
+ * @details The pulse train replay restarts from the beginning.
+ *
+ * @param[in] icup      pointer to the @p ICUDriver object
+ *
+ * @notapi
+ */
+void icu_lld_enable(ICUDriver *icup) {
+
+  replay_start(icup);
+}
+
+/**
+ * @brief   Disables the input capture.
+ *
+ * @param[in] icup      pointer to the @p ICUDriver object
+ *
+ * @notapi
+ */
+void icu_lld_disable(ICUDriver *icup) {
+
+  icup->running = FALSE;
+}
+
+#if ICU_USE_CAPTURE || defined(__DOXYGEN__)
+/**
+ * @brief   Starts logging the edges into the capture ring.
+ * @details The pulse train replay restarts from the beginning.
+ *
+ * @param[in] icup      pointer to the @p ICUDriver object
+ *
+ * @notapi
+ */
+void icu_lld_start_capture(ICUDriver *icup) {
+
+  icup->capidx  = 0;
+  icup->capfill = 0;
+  replay_start(icup);
+}
+
+/**
+ * @brief   Stops logging the edges.
+ * @details The edges of the incomplete half ring are not reported.
+ *
+ * @param[in] icup      pointer to the @p ICUDriver object
+ *
+ * @notapi
+ */
+void icu_lld_stop_capture(ICUDriver *icup) {
+
+  icup->running = FALSE;
+}
+#endif /* ICU_USE_CAPTURE */
+
+/**
+ * @brief   ICU interrupts simulation.
+ *
+ * @return              An interrupt has been served.
+ *
+ * @notapi
+ */
+bool_t icu_lld_interrupt_pending(void) {
+  bool_t b = FALSE;
+
+  CH_IRQ_PROLOGUE();
+
+#if USE_SIM_ICU1
+  b = capint(&ICUD1) || b;
+#endif
+
+  CH_IRQ_EPILOGUE();
+
+  return b;
+}
+
+#endif /* HAL_USE_ICU */
+
+/** @} */
@@ -0,0 +1,266 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    Posix/icu_lld.h
+ * @brief   Posix low level simulated ICU driver header.
+ *
+ * @addtogroup POSIX_ICU
+ * @{
+ */
+
+#ifndef _ICU_LLD_H_
+#define _ICU_LLD_H_
+
+#if HAL_USE_ICU || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   ICU1 driver enable switch.
+ * @details If set to @p TRUE the support for ICU1 is included.
+ * @note    The default is @p TRUE.
+ */
+#if !defined(USE_SIM_ICU1) || defined(__DOXYGEN__)
+#define USE_SIM_ICU1                TRUE
+#endif
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief ICU driver mode.
+ */
+typedef enum {
+  ICU_INPUT_ACTIVE_HIGH = 0,        /**< Trigger on rising edge.            */
+  ICU_INPUT_ACTIVE_LOW = 1,         /**< Trigger on falling edge.           */
+} icumode_t;
+
+/**
+ * @brief   ICU frequency type.
+ */
+typedef uint32_t icufreq_t;
+
+/**
+ * @brief   ICU counter type.
+ */
+typedef uint16_t icucnt_t;
+
+/**
+ * @brief   Driver configuration structure.
+ */
+typedef struct {
+  /**
+   * @brief   Driver mode.
+   * @note    Not used by the simulator, the pulse train describes the
+   *          active and idle phases directly.
+   */
+  icumode_t                 mode;
+  /**
+   * @brief   Timer clock in Hz.
+   */
+  icufreq_t                 frequency;
+  /**
+   * @brief   Callback for pulse width measurement.
+   */
+  icucallback_t             width_cb;
+  /**
+   * @brief   Callback for cycle period measurement.
+   */
+  icucallback_t             period_cb;
+  /**
+   * @brief   Callback for timer overflow or @p NULL.
+   * @details Invoked when a cycle is longer than the counter range.
+   */
+  icucallback_t             overflow_cb;
+  /* End of the mandatory fields.*/
+  /**
+   * @brief   Recorded pulse train.
+   * @details Durations in timer ticks of the active and idle phases,
+   *          alternated starting from an active phase. The train is
+   *          replayed circularly, the first edge is active.
+   */
+  const uint32_t            *train;
+  /**
+   * @brief   Number of durations in the pulse train, must be even.
+   */
+  size_t                    length;
+  /**
+   * @brief   Replays the train in real time.
+   * @details If @p FALSE the train is replayed as fast as possible, one
+   *          edge for each interrupt or, while capturing, half ring for
+   *          each interrupt while the reader is waiting for edges.
+   *          If @p TRUE the time the host does not run the simulator is
+   *          skipped, the edges are lost only if the reader falls behind.
+   */
+  bool_t                    realtime;
+} ICUConfig;
+
+/**
+ * @brief   Structure representing an ICU driver.
+ */
+struct ICUDriver {
+  /**
+   * @brief Driver state.
+   */
+  icustate_t                state;
+  /**
+   * @brief Current configuration data.
+   */
+  const ICUConfig           *config;
+#if ICU_USE_CAPTURE || defined(__DOXYGEN__)
+  /**
+   * @brief   Current capture configuration or @p NULL.
+   */
+  const ICUCaptureConfig    *capcfg;
+  /**
+   * @brief   Edges reported by the low level driver, free running.
+   */
+  volatile uint32_t         capwr;
+  /**
+   * @brief   Edges fetched by the reader, free running.
+   */
+  uint32_t                  caprd;
+  /**
+   * @brief   Edges awaited by the reader.
+   */
+  size_t                    capwant;
+  /**
+   * @brief   Reader thread waiting for edges.
+   */
+  Thread                    *capthread;
+  /**
+   * @brief   Capture statistics.
+   */
+  ICUCaptureStats           capstats;
+#endif /* ICU_USE_CAPTURE */
+#if defined(ICU_DRIVER_EXT_FIELDS)
+  ICU_DRIVER_EXT_FIELDS
+#endif
+  /* End of the mandatory fields.*/
+  /**
+   * @brief   Replay start time, microseconds.
+   */
+  uint64_t                  start;
+  /**
+   * @brief   Time of the next edge in ticks since the replay start.
+   */
+  uint64_t                  ticks;
+  /**
+   * @brief   Time of the last active edge in ticks.
+   */
+  uint64_t                  last;
+  /**
+   * @brief   Edges generated since the replay start.
+   */
+  uint32_t                  edges;
+  /**
+   * @brief   Next duration in the pulse train.
+   */
+  size_t                    pos;
+  /**
+   * @brief   Width of the latest pulse.
+   */
+  icucnt_t                  width;
+  /**
+   * @brief   Period of the latest cycle.
+   */
+  icucnt_t                  period;
+  /**
+   * @brief   Edges are being generated.
+   */
+  bool_t                    running;
+#if ICU_USE_CAPTURE || defined(__DOXYGEN__)
+  /**
+   * @brief   Next ring position written, simulated DMA pointer.
+   */
+  size_t                    capidx;
+  /**
+   * @brief   Edges written in the current half ring.
+   */
+  size_t                    capfill;
+#endif /* ICU_USE_CAPTURE */
+};
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/**
+ * @brief   Returns the width of the latest pulse.
+ * @details The pulse width is defined as number of ticks between the start
+ *          edge and the stop edge.
+ *
+ * @param[in] icup      pointer to the @p ICUDriver object
+ * @return              The number of ticks.
+ *
+ * @notapi
+ */
+#define icu_lld_get_width(icup) ((icup)->width)
+
+/**
+ * @brief   Returns the width of the latest cycle.
+ * @details The cycle width is defined as number of ticks between a start
+ *          edge and the next start edge.
+ *
+ * @param[in] icup      pointer to the @p ICUDriver object
+ * @return              The number of ticks.
+ *
+ * @notapi
+ */
+#define icu_lld_get_period(icup) ((icup)->period)
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#if USE_SIM_ICU1 && !defined(__DOXYGEN__)
+extern ICUDriver ICUD1;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void icu_lld_init(void);
+  void icu_lld_start(ICUDriver *icup);
+  void icu_lld_stop(ICUDriver *icup);
+  void icu_lld_enable(ICUDriver *icup);
+  void icu_lld_disable(ICUDriver *icup);
+#if ICU_USE_CAPTURE
+  void icu_lld_start_capture(ICUDriver *icup);
+  void icu_lld_stop_capture(ICUDriver *icup);
+#endif
+  bool_t icu_lld_interrupt_pending(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_ICU */
+
+#endif /* _ICU_LLD_H_ */
+
+/** @} */
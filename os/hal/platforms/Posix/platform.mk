@@ -1,7 +1,17 @@
 # List of all the Posix platform files.
 PLATFORMSRC = ${CHIBIOS}/os/hal/platforms/Posix/hal_lld.c \
+              ${CHIBIOS}/os/hal/platforms/Posix/adc_lld.c \
+              ${CHIBIOS}/os/hal/platforms/Posix/can_lld.c \
+              ${CHIBIOS}/os/hal/platforms/Posix/dac_lld.c \
+              ${CHIBIOS}/os/hal/platforms/Posix/i2c_lld.c \
+              ${CHIBIOS}/os/hal/platforms/Posix/icu_lld.c \
               ${CHIBIOS}/os/hal/platforms/Posix/pal_lld.c \
-              ${CHIBIOS}/os/hal/platforms/Posix/serial_lld.c
+              ${CHIBIOS}/os/hal/platforms/Posix/serial_lld.c \
+              ${CHIBIOS}/os/hal/platforms/Posix/simflash.c \
+              ${CHIBIOS}/os/hal/platforms/Posix/simdisk.c \
+              ${CHIBIOS}/os/hal/platforms/Posix/simi2c.c \
+              ${CHIBIOS}/os/hal/platforms/Posix/spi_lld.c \
+              ${CHIBIOS}/os/hal/platforms/Posix/usb_lld.c
 
 # Required include directories
 PLATFORMINC = ${CHIBIOS}/os/hal/platforms/Posix
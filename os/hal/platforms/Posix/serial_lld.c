@@ -61,6 +61,16 @@ static u_long nb = 1;
 /* Driver local functions.                                                   */
 /*===========================================================================*/
 
+/*
+ * Closes the data socket, the disconnection is not signaled.
+ */
+static void data_close(SerialDriver *sdp) {
+
+  hal_lld_remove_fd(sdp->com_data);
+  close(sdp->com_data);
+  sdp->com_data = INVALID_SOCKET;
+}
+
 static void init(SerialDriver *sdp, uint16_t port) {
   struct sockaddr_in sad;
   struct protoent *prtp;
@@ -100,6 +110,7 @@ static void init(SerialDriver *sdp, uint16_t port) {
     printf("%s: Error listening socket\n", sdp->com_name);
     goto abort;
   }
+  hal_lld_add_fd(sdp->com_listen);
   printf("Full Duplex Channel %s listening on port %d\n", sdp->com_name, port);
   return;
 
@@ -122,6 +133,7 @@ static bool_t connint(SerialDriver *sdp) {
       printf("%s: Unable to setup non blocking mode on data socket\n", sdp->com_name);
       goto abort;
     }
+    hal_lld_add_fd(sdp->com_data);
     chSysLockFromIsr();
     chnAddFlagsI(sdp, CHN_CONNECTED);
     chSysUnlockFromIsr();
@@ -148,8 +160,7 @@ static bool_t inint(SerialDriver *sdp) {
     int n = recv(sdp->com_data, data, sizeof(data), 0);
     switch (n) {
     case 0:
-      close(sdp->com_data);
-      sdp->com_data = INVALID_SOCKET;
+      data_close(sdp);
       chSysLockFromIsr();
       chnAddFlagsI(sdp, CHN_DISCONNECTED);
       chSysUnlockFromIsr();
@@ -157,8 +168,7 @@ static bool_t inint(SerialDriver *sdp) {
     case INVALID_SOCKET:
       if (errno == EWOULDBLOCK)
         return FALSE;
-      close(sdp->com_data);
-      sdp->com_data = INVALID_SOCKET;
+      data_close(sdp);
       return FALSE;
     }
     for (i = 0; i < n; i++) {
@@ -166,6 +176,7 @@ static bool_t inint(SerialDriver *sdp) {
       sdIncomingDataI(sdp, data[i]);
       chSysUnlockFromIsr();
     }
+    sdp->rxirq += n;
     return TRUE;
   }
   return FALSE;
@@ -186,20 +197,21 @@ static bool_t outint(SerialDriver *sdp) {
     if (n < 0)
       return FALSE;
     data[0] = (uint8_t)n;
+    sdp->txirq++;
     n = send(sdp->com_data, data, sizeof(data), 0);
     switch (n) {
     case 0:
-      close(sdp->com_data);
-      sdp->com_data = INVALID_SOCKET;
+      data_close(sdp);
       chSysLockFromIsr();
       chnAddFlagsI(sdp, CHN_DISCONNECTED);
       chSysUnlockFromIsr();
       return FALSE;
     case INVALID_SOCKET:
-      if (errno == EWOULDBLOCK)
+      if (errno == EWOULDBLOCK) {
+        hal_lld_wakeup_at(0);
         return FALSE;
-      close(sdp->com_data);
-      sdp->com_data = INVALID_SOCKET;
+      }
+      data_close(sdp);
       return FALSE;
     }
     return TRUE;
@@ -207,6 +219,125 @@ static bool_t outint(SerialDriver *sdp) {
   return FALSE;
 }
 
+#if SERIAL_USE_BLOCK_MODE
+static uint64_t now_us(void) {
+
+  return hal_lld_get_time_us();
+}
+
+/*
+ * Simulated DMA transfer complete or idle line interrupt, the received
+ * block is moved in the input queue.
+ */
+static void inflush(SerialDriver *sdp) {
+
+  chSysLockFromIsr();
+  sdIncomingBlockI(sdp, sdp->rxblk, sdp->rxcnt);
+  chSysUnlockFromIsr();
+  sdp->rxcnt = 0;
+  sdp->rxirq++;
+}
+
+static bool_t inblk(SerialDriver *sdp) {
+  size_t bs = sdp->config->block_size;
+  int n;
+
+  if (sdp->com_data == INVALID_SOCKET)
+    return FALSE;
+
+  /*
+   * The simulated DMA fills the receive block.
+   */
+  n = recv(sdp->com_data, sdp->rxblk + sdp->rxcnt, bs - sdp->rxcnt, 0);
+  switch (n) {
+  case 0:
+    data_close(sdp);
+    sdp->rxcnt = 0;
+    chSysLockFromIsr();
+    chnAddFlagsI(sdp, CHN_DISCONNECTED);
+    chSysUnlockFromIsr();
+    return FALSE;
+  case INVALID_SOCKET:
+    if (errno == EWOULDBLOCK) {
+      /* Idle line, a partial block is flushed after the idle time.*/
+      if ((sdp->rxcnt > 0) &&
+          (now_us() - sdp->rxlast >= sdp->config->idle_time)) {
+        inflush(sdp);
+        return TRUE;
+      }
+      if (sdp->rxcnt > 0)
+        hal_lld_wakeup_at(sdp->rxlast + sdp->config->idle_time);
+      return FALSE;
+    }
+    data_close(sdp);
+    sdp->rxcnt = 0;
+    return FALSE;
+  }
+  sdp->rxcnt += n;
+  sdp->rxlast = now_us();
+  if (sdp->rxcnt >= bs)
+    inflush(sdp);
+  return TRUE;
+}
+
+static bool_t outblk(SerialDriver *sdp) {
+  int n;
+
+  if (sdp->com_data == INVALID_SOCKET)
+    return FALSE;
+
+  /*
+   * The transmit block is refilled when completely sent.
+   */
+  if (sdp->txoff >= sdp->txcnt) {
+    chSysLockFromIsr();
+    sdp->txcnt = sdRequestBlockI(sdp, sdp->txblk, sdp->config->block_size);
+    chSysUnlockFromIsr();
+    sdp->txoff = 0;
+    if (sdp->txcnt == 0)
+      return FALSE;
+    sdp->txirq++;
+  }
+  n = send(sdp->com_data, sdp->txblk + sdp->txoff,
+           sdp->txcnt - sdp->txoff, 0);
+  switch (n) {
+  case 0:
+    data_close(sdp);
+    chSysLockFromIsr();
+    chnAddFlagsI(sdp, CHN_DISCONNECTED);
+    chSysUnlockFromIsr();
+    return FALSE;
+  case INVALID_SOCKET:
+    if (errno == EWOULDBLOCK) {
+      hal_lld_wakeup_at(0);
+      return FALSE;
+    }
+    data_close(sdp);
+    return FALSE;
+  }
+  sdp->txoff += n;
+  return TRUE;
+}
+#endif /* SERIAL_USE_BLOCK_MODE */
+
+static bool_t rxint(SerialDriver *sdp) {
+
+#if SERIAL_USE_BLOCK_MODE
+  if (sdp->config->block_size > 0)
+    return inblk(sdp);
+#endif
+  return inint(sdp);
+}
+
+static bool_t txint(SerialDriver *sdp) {
+
+#if SERIAL_USE_BLOCK_MODE
+  if (sdp->config->block_size > 0)
+    return outblk(sdp);
+#endif
+  return outint(sdp);
+}
+
 /*===========================================================================*/
 /* Driver interrupt handlers.                                                */
 /*===========================================================================*/
@@ -225,6 +356,7 @@ void sd_lld_init(void) {
   SD1.com_listen = INVALID_SOCKET;
   SD1.com_data = INVALID_SOCKET;
   SD1.com_name = "SD1";
+  SD1.config = &default_config;
 #endif
 
 #if USE_SIM_SERIAL2
@@ -232,6 +364,7 @@ void sd_lld_init(void) {
   SD2.com_listen = INVALID_SOCKET;
   SD2.com_data = INVALID_SOCKET;
   SD2.com_name = "SD2";
+  SD2.config = &default_config;
 #endif
 }
 
@@ -244,6 +377,16 @@ void sd_lld_start(SerialDriver *sdp, const SerialConfig *config) {
 
   if (config == NULL)
     config = &default_config;
+#if SERIAL_USE_BLOCK_MODE
+  chDbgAssert(config->block_size <= SIM_SERIAL_BLOCK_SIZE,
+              "sd_lld_start(), #1", "block too large");
+  sdp->rxcnt = 0;
+  sdp->txcnt = 0;
+  sdp->txoff = 0;
+#endif
+  sdp->config = config;
+  sdp->rxirq = 0;
+  sdp->txirq = 0;
 
 #if USE_SIM_SERIAL1
   if (sdp == &SD1)
@@ -258,14 +401,44 @@ void sd_lld_start(SerialDriver *sdp, const SerialConfig *config) {
 
 /**
  * @brief   Low level serial driver stop.
- * @details De-initializes the USART, stops the associated clock, resets the
- *          interrupt vector.
+ * @details Closes the simulator sockets, the driver can be restarted.
  *
  * @param[in] sdp       pointer to a @p SerialDriver object
  */
 void sd_lld_stop(SerialDriver *sdp) {
 
-  (void)sdp;
+  /* The listen socket is closed first so that a peer reconnecting on
+     disconnection cannot be queued on it.*/
+  if (sdp->com_listen != INVALID_SOCKET) {
+    hal_lld_remove_fd(sdp->com_listen);
+    close(sdp->com_listen);
+    sdp->com_listen = INVALID_SOCKET;
+  }
+  if (sdp->com_data != INVALID_SOCKET) {
+    data_close(sdp);
+  }
+}
+
+/**
+ * @brief   Injects data as received from the port.
+ * @details It is meant to be invoked from a simulated event scheduled
+ *          using @p simEventSetI(), the data does not need a connected
+ *          socket.
+ *
+ * @param[in] sdp       pointer to a @p SerialDriver object
+ * @param[in] bp        pointer to the data
+ * @param[in] n         number of bytes
+ *
+ * @iclass
+ */
+void sdSimInjectI(SerialDriver *sdp, const uint8_t *bp, size_t n) {
+
+  chDbgCheckClassI();
+  chDbgCheck((sdp != NULL) && (bp != NULL), "sdSimInjectI");
+
+  while (n-- > 0)
+    sdIncomingDataI(sdp, *bp++);
+  sdp->rxirq++;
 }
 
 bool_t sd_lld_interrupt_pending(void) {
@@ -274,8 +447,8 @@ bool_t sd_lld_interrupt_pending(void) {
   CH_IRQ_PROLOGUE();
 
   b =  connint(&SD1) || connint(&SD2) ||
-       inint(&SD1)   || inint(&SD2)   ||
-       outint(&SD1)  || outint(&SD2);
+       rxint(&SD1)   || rxint(&SD2)   ||
+       txint(&SD1)   || txint(&SD2);
 
   CH_IRQ_EPILOGUE();
 
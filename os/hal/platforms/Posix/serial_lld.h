@@ -76,6 +76,14 @@
 #define SIM_SD2_PORT                29002
 #endif
 
+/**
+ * @brief   Maximum size of the simulated DMA blocks.
+ * @note    Only used if @p SERIAL_USE_BLOCK_MODE is enabled.
+ */
+#if !defined(SIM_SERIAL_BLOCK_SIZE) || defined(__DOXYGEN__)
+#define SIM_SERIAL_BLOCK_SIZE       256
+#endif
+
 /*===========================================================================*/
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
@@ -84,6 +92,27 @@
 /* Driver data structures and types.                                         */
 /*===========================================================================*/
 
+#if SERIAL_USE_BLOCK_MODE || defined(__DOXYGEN__)
+/**
+ * @brief   Simulated DMA buffers.
+ */
+#define _serial_sim_block_data                                              \
+  /* Receive block.*/                                                       \
+  uint8_t                   rxblk[SIM_SERIAL_BLOCK_SIZE];                   \
+  /* Bytes in the receive block.*/                                          \
+  size_t                    rxcnt;                                          \
+  /* Time of the last received data in microseconds.*/                      \
+  uint64_t                  rxlast;                                         \
+  /* Transmit block.*/                                                      \
+  uint8_t                   txblk[SIM_SERIAL_BLOCK_SIZE];                   \
+  /* Bytes in the transmit block.*/                                         \
+  size_t                    txcnt;                                          \
+  /* Bytes of the transmit block already sent.*/                            \
+  size_t                    txoff;
+#else
+#define _serial_sim_block_data
+#endif
+
 /**
  * @brief   Generic Serial Driver configuration structure.
  * @details An instance of this structure must be passed to @p sdStart()
@@ -93,6 +122,19 @@
  *          initializers.
  */
 typedef struct {
+#if SERIAL_USE_BLOCK_MODE || defined(__DOXYGEN__)
+  /**
+   * @brief   Size of the transferred blocks, zero for the per byte mode.
+   * @note    Must not be greater than @p SIM_SERIAL_BLOCK_SIZE.
+   */
+  size_t                    block_size;
+  /**
+   * @brief   Idle line time in microseconds.
+   * @details A partially filled receive block is flushed to the input
+   *          queue after the line has been idle for this time.
+   */
+  uint32_t                  idle_time;
+#endif
 } SerialConfig;
 
 /**
@@ -116,7 +158,14 @@ typedef struct {
   /* Data socket for simulated serial port.*/                               \
   SOCKET                    com_data;                                       \
   /* Port readable name.*/                                                  \
-  const char                *com_name;
+  const char                *com_name;                                      \
+  /* Current configuration data.*/                                          \
+  const SerialConfig        *config;                                        \
+  /* Simulated receive interrupts.*/                                        \
+  uint32_t                  rxirq;                                          \
+  /* Simulated transmit interrupts.*/                                       \
+  uint32_t                  txirq;                                          \
+  _serial_sim_block_data
 
 /*===========================================================================*/
 /* Driver macros.                                                            */
@@ -139,6 +188,7 @@ extern "C" {
   void sd_lld_init(void);
   void sd_lld_start(SerialDriver *sdp, const SerialConfig *config);
   void sd_lld_stop(SerialDriver *sdp);
+  void sdSimInjectI(SerialDriver *sdp, const uint8_t *bp, size_t n);
   bool_t sd_lld_interrupt_pending(void);
 #ifdef __cplusplus
 }
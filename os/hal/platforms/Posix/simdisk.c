@@ -0,0 +1,273 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    Posix/simdisk.c
+ * @brief   Posix simulated block device code.
+ * @details The device keeps its image in RAM, optionally mirrored into a
+ *          file. Each operation is accounted with a simple timing model
+ *          made of a fixed per command overhead and a per block transfer
+ *          time, this allows to evaluate how efficiently an upper layer
+ *          uses a real card.
+ *
+ * @addtogroup POSIX_SIMDISK
+ * @{
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "simdisk.h"
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+static bool_t sd_is_inserted(void *instance);
+static bool_t sd_is_protected(void *instance);
+static bool_t sd_connect(void *instance);
+static bool_t sd_disconnect(void *instance);
+static bool_t sd_read(void *instance, uint32_t startblk,
+                      uint8_t *buffer, uint32_t n);
+static bool_t sd_write(void *instance, uint32_t startblk,
+                       const uint8_t *buffer, uint32_t n);
+static bool_t sd_sync(void *instance);
+static bool_t sd_get_info(void *instance, BlockDeviceInfo *bdip);
+
+static const struct SimDiskDriverVMT vmt = {
+  sd_is_inserted, sd_is_protected, sd_connect, sd_disconnect,
+  sd_read, sd_write, sd_sync, sd_get_info
+};
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+/**
+ * @brief   Accounts the modeled time of an operation.
+ */
+static void sd_busy(SimDiskDriver *sdp, uint32_t n) {
+  uint32_t t = sdp->config->command_time + n * sdp->config->block_time;
+  systime_t ticks;
+
+  sdp->stats.busy_time += t;
+  if (!sdp->realtime)
+    return;
+  sdp->pending_time += t;
+  ticks = (systime_t)(((uint64_t)sdp->pending_time * CH_FREQUENCY) / 1000000);
+  if (ticks > 0) {
+    sdp->pending_time -= (uint32_t)(((uint64_t)ticks * 1000000) /
+                                    CH_FREQUENCY);
+    chThdSleep(ticks);
+  }
+}
+
+static bool_t sd_is_inserted(void *instance) {
+
+  return ((SimDiskDriver *)instance)->image != NULL;
+}
+
+static bool_t sd_is_protected(void *instance) {
+
+  return ((SimDiskDriver *)instance)->write_protected;
+}
+
+static bool_t sd_connect(void *instance) {
+  SimDiskDriver *sdp = instance;
+
+  if ((sdp->state != BLK_ACTIVE) && (sdp->state != BLK_READY))
+    return CH_FAILED;
+  sdp->state = BLK_READY;
+  return CH_SUCCESS;
+}
+
+static bool_t sd_disconnect(void *instance) {
+  SimDiskDriver *sdp = instance;
+
+  if ((sdp->state != BLK_ACTIVE) && (sdp->state != BLK_READY))
+    return CH_FAILED;
+  sdp->state = BLK_ACTIVE;
+  return CH_SUCCESS;
+}
+
+static bool_t sd_read(void *instance, uint32_t startblk,
+                      uint8_t *buffer, uint32_t n) {
+  SimDiskDriver *sdp = instance;
+
+  if ((sdp->state != BLK_READY) || (startblk > sdp->config->blocks_num) ||
+      (n > sdp->config->blocks_num - startblk))
+    return CH_FAILED;
+  memcpy(buffer, sdp->image + startblk * SIMDISK_BLOCK_SIZE,
+         n * SIMDISK_BLOCK_SIZE);
+  sdp->stats.reads++;
+  sdp->stats.read_blocks += n;
+  sd_busy(sdp, n);
+  return CH_SUCCESS;
+}
+
+static bool_t sd_write(void *instance, uint32_t startblk,
+                       const uint8_t *buffer, uint32_t n) {
+  SimDiskDriver *sdp = instance;
+  size_t offset = (size_t)startblk * SIMDISK_BLOCK_SIZE;
+  size_t size = (size_t)n * SIMDISK_BLOCK_SIZE;
+
+  if ((sdp->state != BLK_READY) || sdp->write_protected ||
+      (startblk > sdp->config->blocks_num) ||
+      (n > sdp->config->blocks_num - startblk))
+    return CH_FAILED;
+  memcpy(sdp->image + offset, buffer, size);
+  if ((sdp->fd >= 0) &&
+      (pwrite(sdp->fd, sdp->image + offset, size, offset) != (ssize_t)size)) {
+    printf("simdisk: write error on %s\n", sdp->config->filename);
+    return CH_FAILED;
+  }
+  sdp->stats.writes++;
+  sdp->stats.write_blocks += n;
+  sd_busy(sdp, n);
+  return CH_SUCCESS;
+}
+
+static bool_t sd_sync(void *instance) {
+  SimDiskDriver *sdp = instance;
+
+  if (sdp->state != BLK_READY)
+    return CH_FAILED;
+  if (sdp->fd >= 0)
+    (void)fsync(sdp->fd);
+  return CH_SUCCESS;
+}
+
+static bool_t sd_get_info(void *instance, BlockDeviceInfo *bdip) {
+  SimDiskDriver *sdp = instance;
+
+  if (sdp->state != BLK_READY)
+    return CH_FAILED;
+  bdip->blk_size = SIMDISK_BLOCK_SIZE;
+  bdip->blk_num  = sdp->config->blocks_num;
+  return CH_SUCCESS;
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Initializes a simulated block device instance.
+ *
+ * @param[out] sdp      pointer to the @p SimDiskDriver object
+ */
+void simdiskObjectInit(SimDiskDriver *sdp) {
+
+  sdp->vmt = &vmt;
+  sdp->state = BLK_STOP;
+  sdp->config = NULL;
+  sdp->image = NULL;
+  sdp->fd = -1;
+  sdp->write_protected = FALSE;
+  sdp->realtime = FALSE;
+  sdp->pending_time = 0;
+  memset(&sdp->stats, 0, sizeof(sdp->stats));
+}
+
+/**
+ * @brief   Creates the device image.
+ *
+ * @param[in] sdp       pointer to the @p SimDiskDriver object
+ * @param[in] config    pointer to the @p SimDiskConfig object
+ */
+void simdiskStart(SimDiskDriver *sdp, const SimDiskConfig *config) {
+  size_t size = (size_t)config->blocks_num * SIMDISK_BLOCK_SIZE;
+  struct stat st;
+
+  chDbgCheck((sdp != NULL) && (config != NULL), "simdiskStart");
+  chDbgAssert(sdp->state == BLK_STOP, "simdiskStart(), #1",
+              "invalid state");
+
+  sdp->config = config;
+  sdp->image = calloc(1, size);
+  if (sdp->image == NULL) {
+    printf("simdisk: out of memory\n");
+    exit(1);
+  }
+
+  if (config->filename != NULL) {
+    sdp->fd = open(config->filename, O_RDWR | O_CREAT, 0644);
+    if (sdp->fd < 0) {
+      printf("simdisk: unable to open %s\n", config->filename);
+      exit(1);
+    }
+    if ((fstat(sdp->fd, &st) != 0) || (st.st_size != (off_t)size) ||
+        (pread(sdp->fd, sdp->image, size, 0) != (ssize_t)size)) {
+      memset(sdp->image, 0, size);
+      if ((ftruncate(sdp->fd, 0) != 0) ||
+          (ftruncate(sdp->fd, (off_t)size) != 0))
+        printf("simdisk: unable to resize %s\n", config->filename);
+    }
+  }
+  sdp->state = BLK_ACTIVE;
+}
+
+/**
+ * @brief   Releases the device image.
+ * @note    A file backed image is kept in its file.
+ *
+ * @param[in] sdp       pointer to the @p SimDiskDriver object
+ */
+void simdiskStop(SimDiskDriver *sdp) {
+
+  chDbgCheck(sdp != NULL, "simdiskStop");
+
+  if (sdp->fd >= 0) {
+    close(sdp->fd);
+    sdp->fd = -1;
+  }
+  free(sdp->image);
+  sdp->image = NULL;
+  sdp->state = BLK_STOP;
+}
+
+/**
+ * @brief   Returns the usage statistics.
+ *
+ * @param[in] sdp       pointer to the @p SimDiskDriver object
+ * @param[out] stp      pointer to a @p SimDiskStats structure
+ */
+void simdiskGetStats(SimDiskDriver *sdp, SimDiskStats *stp) {
+
+  *stp = sdp->stats;
+}
+
+/**
+ * @brief   Clears the usage statistics.
+ *
+ * @param[in] sdp       pointer to the @p SimDiskDriver object
+ */
+void simdiskResetStats(SimDiskDriver *sdp) {
+
+  memset(&sdp->stats, 0, sizeof(sdp->stats));
+}
+
+/** @} */
@@ -0,0 +1,186 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    Posix/simdisk.h
+ * @brief   Posix simulated block device header.
+ *
+ * @addtogroup POSIX_SIMDISK
+ * @{
+ */
+
+#ifndef _SIMDISK_H_
+#define _SIMDISK_H_
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Block size of the simulated device.
+ */
+#define SIMDISK_BLOCK_SIZE          512
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Simulated block device configuration structure.
+ */
+typedef struct {
+  /**
+   * @brief Number of blocks.
+   */
+  uint32_t                  blocks_num;
+  /**
+   * @brief Backing file name or @p NULL for a RAM only device.
+   * @note  An existing file of the right size is loaded, otherwise the
+   *        device starts zero filled.
+   */
+  const char                *filename;
+  /**
+   * @brief Modeled per command overhead in microseconds.
+   * @details This is the time spent by a card for command processing and
+   *          programming busy, it is paid once for each read or write
+   *          operation regardless of its size.
+   */
+  uint32_t                  command_time;
+  /**
+   * @brief Modeled transfer time of a single block in microseconds.
+   */
+  uint32_t                  block_time;
+} SimDiskConfig;
+
+/**
+ * @brief   Simulated block device statistics.
+ */
+typedef struct {
+  uint32_t                  reads;          /**< @brief Read commands.      */
+  uint32_t                  writes;         /**< @brief Write commands.     */
+  uint64_t                  read_blocks;    /**< @brief Blocks read.        */
+  uint64_t                  write_blocks;   /**< @brief Blocks written.     */
+  uint64_t                  busy_time;      /**< @brief Modeled device busy
+                                                 time in microseconds.      */
+} SimDiskStats;
+
+/**
+ * @brief   @p SimDiskDriver specific methods.
+ */
+#define _simdisk_driver_methods                                             \
+  _base_block_device_methods
+
+/**
+ * @extends BaseBlockDeviceVMT
+ *
+ * @brief   @p SimDiskDriver virtual methods table.
+ */
+struct SimDiskDriverVMT {
+  _simdisk_driver_methods
+};
+
+/**
+ * @extends BaseBlockDevice
+ *
+ * @brief   Simulated block device.
+ */
+typedef struct {
+  /**
+   * @brief Virtual Methods Table.
+   */
+  const struct SimDiskDriverVMT *vmt;
+  _base_block_device_data
+  /**
+   * @brief Current configuration data.
+   */
+  const SimDiskConfig       *config;
+  /**
+   * @brief Device image.
+   */
+  uint8_t                   *image;
+  /**
+   * @brief Backing file descriptor or -1.
+   */
+  int                       fd;
+  /**
+   * @brief Write protection switch.
+   */
+  bool_t                    write_protected;
+  /**
+   * @brief The modeled time is spent sleeping.
+   */
+  bool_t                    realtime;
+  /**
+   * @brief Modeled time not yet slept, in microseconds.
+   */
+  uint32_t                  pending_time;
+  /**
+   * @brief Usage statistics.
+   */
+  SimDiskStats              stats;
+} SimDiskDriver;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/**
+ * @brief   Sets the write protection switch.
+ *
+ * @param[in] sdp       pointer to the @p SimDiskDriver object
+ * @param[in] b         @p TRUE if the media must be write protected
+ */
+#define simdiskSetProtection(sdp, b) ((sdp)->write_protected = (b))
+
+/**
+ * @brief   Sets the real time switch.
+ * @details When enabled the calling thread sleeps for the modeled time of
+ *          each operation, other threads can run meanwhile as they would
+ *          while a real card is busy. The fractions of system tick are
+ *          carried over to the next operation.
+ *
+ * @param[in] sdp       pointer to the @p SimDiskDriver object
+ * @param[in] b         @p TRUE if the modeled time must be slept
+ */
+#define simdiskSetRealtime(sdp, b) ((sdp)->realtime = (b))
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void simdiskObjectInit(SimDiskDriver *sdp);
+  void simdiskStart(SimDiskDriver *sdp, const SimDiskConfig *config);
+  void simdiskStop(SimDiskDriver *sdp);
+  void simdiskGetStats(SimDiskDriver *sdp, SimDiskStats *stp);
+  void simdiskResetStats(SimDiskDriver *sdp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SIMDISK_H_ */
+
+/** @} */
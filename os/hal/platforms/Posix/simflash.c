@@ -0,0 +1,314 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    Posix/simflash.c
+ * @brief   Posix simulated NOR flash device code.
+ * @details The device enforces NOR semantics: programming can only clear
+ *          bits and erasing works on whole sectors. Power failures can be
+ *          injected, the interrupted operation is left torn and the device
+ *          refuses any further operation until it is power cycled.
+ *
+ * @addtogroup POSIX_SIMFLASH
+ * @{
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "simflash.h"
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+static bool_t sf_read(void *instance, uint32_t offset,
+                      uint8_t *buffer, size_t n);
+static bool_t sf_program(void *instance, uint32_t offset,
+                         const uint8_t *buffer, size_t n);
+static bool_t sf_erase(void *instance, uint32_t sector);
+static bool_t sf_get_info(void *instance, FlashDeviceInfo *fdip);
+
+static const struct BaseFlashVMT vmt = {
+  sf_read, sf_program, sf_erase, sf_get_info
+};
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static uint32_t size(SimFlashDriver *sfp) {
+
+  return sfp->config->sector_size * sfp->config->sectors_num;
+}
+
+/*
+ * Writes back a modified range of the image into the backing file.
+ */
+static void sync_range(SimFlashDriver *sfp, uint32_t offset, size_t n) {
+
+  if (sfp->fd >= 0) {
+    if (pwrite(sfp->fd, sfp->image + offset, n, offset) != (ssize_t)n)
+      printf("simflash: write error on %s\n", sfp->config->filename);
+  }
+}
+
+/*
+ * Counts an operation against the injected failure, returns TRUE if the
+ * operation is the one interrupted by the power loss.
+ */
+static bool_t power_lost(SimFlashDriver *sfp) {
+
+  if (sfp->fail_countdown == 0)
+    return FALSE;
+  if (--sfp->fail_countdown > 0)
+    return FALSE;
+  sfp->failed = TRUE;
+  return TRUE;
+}
+
+static bool_t sf_read(void *instance, uint32_t offset,
+                      uint8_t *buffer, size_t n) {
+  SimFlashDriver *sfp = instance;
+
+  if (sfp->failed || (offset > size(sfp)) || (n > size(sfp) - offset))
+    return CH_FAILED;
+  memcpy(buffer, sfp->image + offset, n);
+  sfp->stats.reads++;
+  sfp->stats.read_bytes += n;
+  return CH_SUCCESS;
+}
+
+static bool_t sf_program(void *instance, uint32_t offset,
+                         const uint8_t *buffer, size_t n) {
+  SimFlashDriver *sfp = instance;
+  uint8_t *p;
+  size_t i;
+
+  if (n == 0)
+    return sfp->failed;
+  if (sfp->failed || (offset > size(sfp)) || (n > size(sfp) - offset) ||
+      (offset / sfp->config->page_size !=
+       (offset + n - 1) / sfp->config->page_size))
+    return CH_FAILED;
+
+  p = sfp->image + offset;
+  if (power_lost(sfp)) {
+    /* Torn program, a random prefix is programmed and the next byte only
+       partially.*/
+    size_t k = (size_t)rand_r(&sfp->seed) % n;
+    for (i = 0; i < k; i++)
+      p[i] &= buffer[i];
+    p[k] &= buffer[k] | (uint8_t)rand_r(&sfp->seed);
+    sync_range(sfp, offset, n);
+    return CH_FAILED;
+  }
+
+  for (i = 0; i < n; i++) {
+    if ((~p[i] & buffer[i]) != 0)
+      sfp->stats.violations++;
+    p[i] &= buffer[i];
+  }
+  sync_range(sfp, offset, n);
+  sfp->stats.programs++;
+  sfp->stats.program_bytes += n;
+  sfp->stats.busy_time += sfp->config->program_time;
+  return CH_SUCCESS;
+}
+
+static bool_t sf_erase(void *instance, uint32_t sector) {
+  SimFlashDriver *sfp = instance;
+  uint32_t ssize = sfp->config->sector_size;
+  uint8_t *p;
+  uint32_t i;
+
+  if (sfp->failed || (sector >= sfp->config->sectors_num))
+    return CH_FAILED;
+
+  p = sfp->image + sector * ssize;
+  if (power_lost(sfp)) {
+    /* Torn erase, random bytes are erased.*/
+    for (i = 0; i < ssize; i++)
+      if (rand_r(&sfp->seed) & 1)
+        p[i] = FLASH_ERASED_VALUE;
+    sync_range(sfp, sector * ssize, ssize);
+    return CH_FAILED;
+  }
+
+  memset(p, FLASH_ERASED_VALUE, ssize);
+  sync_range(sfp, sector * ssize, ssize);
+  sfp->wear[sector]++;
+  sfp->stats.erases++;
+  sfp->stats.busy_time += sfp->config->erase_time;
+  return CH_SUCCESS;
+}
+
+static bool_t sf_get_info(void *instance, FlashDeviceInfo *fdip) {
+  SimFlashDriver *sfp = instance;
+
+  fdip->page_size   = sfp->config->page_size;
+  fdip->sector_size = sfp->config->sector_size;
+  fdip->sectors_num = sfp->config->sectors_num;
+  return CH_SUCCESS;
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Initializes a simulated flash instance.
+ *
+ * @param[out] sfp      pointer to the @p SimFlashDriver object
+ */
+void simflashObjectInit(SimFlashDriver *sfp) {
+
+  sfp->vmt = &vmt;
+  sfp->config = NULL;
+  sfp->image = NULL;
+  sfp->wear = NULL;
+  sfp->fd = -1;
+  sfp->fail_countdown = 0;
+  sfp->failed = FALSE;
+  sfp->seed = 1;
+  memset(&sfp->stats, 0, sizeof(sfp->stats));
+}
+
+/**
+ * @brief   Creates the device image.
+ *
+ * @param[in] sfp       pointer to the @p SimFlashDriver object
+ * @param[in] config    pointer to the @p SimFlashConfig object
+ */
+void simflashStart(SimFlashDriver *sfp, const SimFlashConfig *config) {
+  struct stat st;
+
+  chDbgCheck((sfp != NULL) && (config != NULL) &&
+             (config->sector_size % config->page_size == 0),
+             "simflashStart");
+
+  sfp->config = config;
+  sfp->image = malloc(size(sfp));
+  sfp->wear = calloc(config->sectors_num, sizeof(uint32_t));
+  if ((sfp->image == NULL) || (sfp->wear == NULL)) {
+    printf("simflash: out of memory\n");
+    exit(1);
+  }
+  memset(sfp->image, FLASH_ERASED_VALUE, size(sfp));
+
+  if (config->filename != NULL) {
+    sfp->fd = open(config->filename, O_RDWR | O_CREAT, 0644);
+    if (sfp->fd < 0) {
+      printf("simflash: unable to open %s\n", config->filename);
+      exit(1);
+    }
+    if ((fstat(sfp->fd, &st) == 0) && (st.st_size == (off_t)size(sfp)) &&
+        (pread(sfp->fd, sfp->image, size(sfp), 0) == (ssize_t)size(sfp)))
+      return;
+    if (ftruncate(sfp->fd, 0) != 0)
+      printf("simflash: unable to truncate %s\n", config->filename);
+    sync_range(sfp, 0, size(sfp));
+  }
+}
+
+/**
+ * @brief   Releases the device image.
+ * @note    A file backed image is kept in its file.
+ *
+ * @param[in] sfp       pointer to the @p SimFlashDriver object
+ */
+void simflashStop(SimFlashDriver *sfp) {
+
+  chDbgCheck(sfp != NULL, "simflashStop");
+
+  if (sfp->fd >= 0) {
+    close(sfp->fd);
+    sfp->fd = -1;
+  }
+  free(sfp->image);
+  free(sfp->wear);
+  sfp->image = NULL;
+  sfp->wear = NULL;
+}
+
+/**
+ * @brief   Schedules a power failure.
+ * @details The @p n-th program or erase operation starting from now is
+ *          interrupted, its effect is partial and random.
+ *
+ * @param[in] sfp       pointer to the @p SimFlashDriver object
+ * @param[in] n         operations before the failure, zero disables
+ * @param[in] seed      seed for the torn operation generator
+ */
+void simflashInjectFailure(SimFlashDriver *sfp, uint32_t n, unsigned seed) {
+
+  sfp->fail_countdown = n;
+  sfp->seed = seed;
+}
+
+/**
+ * @brief   Restores power after a failure.
+ *
+ * @param[in] sfp       pointer to the @p SimFlashDriver object
+ */
+void simflashPowerCycle(SimFlashDriver *sfp) {
+
+  sfp->fail_countdown = 0;
+  sfp->failed = FALSE;
+}
+
+/**
+ * @brief   Returns the usage statistics.
+ *
+ * @param[in] sfp       pointer to the @p SimFlashDriver object
+ * @param[out] stp      pointer to a @p SimFlashStats structure
+ */
+void simflashGetStats(SimFlashDriver *sfp, SimFlashStats *stp) {
+  uint32_t i;
+
+  sfp->stats.max_erases = 0;
+  sfp->stats.min_erases = 0xFFFFFFFF;
+  for (i = 0; i < sfp->config->sectors_num; i++) {
+    if (sfp->wear[i] > sfp->stats.max_erases)
+      sfp->stats.max_erases = sfp->wear[i];
+    if (sfp->wear[i] < sfp->stats.min_erases)
+      sfp->stats.min_erases = sfp->wear[i];
+  }
+  *stp = sfp->stats;
+}
+
+/**
+ * @brief   Clears the operation counters.
+ * @note    The sectors wear is not cleared.
+ *
+ * @param[in] sfp       pointer to the @p SimFlashDriver object
+ */
+void simflashResetStats(SimFlashDriver *sfp) {
+
+  memset(&sfp->stats, 0, sizeof(sfp->stats));
+}
+
+/** @} */
@@ -0,0 +1,164 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    Posix/simflash.h
+ * @brief   Posix simulated NOR flash device header.
+ *
+ * @addtogroup POSIX_SIMFLASH
+ * @{
+ */
+
+#ifndef _SIMFLASH_H_
+#define _SIMFLASH_H_
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Simulated flash configuration structure.
+ */
+typedef struct {
+  /**
+   * @brief Programming page size.
+   */
+  uint32_t                  page_size;
+  /**
+   * @brief Erase sector size, a multiple of the page size.
+   */
+  uint32_t                  sector_size;
+  /**
+   * @brief Number of sectors.
+   */
+  uint32_t                  sectors_num;
+  /**
+   * @brief Backing file name or @p NULL for a RAM only device.
+   * @note  An existing file of the right size is loaded, otherwise the
+   *        device starts fully erased.
+   */
+  const char                *filename;
+  /**
+   * @brief Modeled page programming time in microseconds.
+   */
+  uint32_t                  program_time;
+  /**
+   * @brief Modeled sector erase time in microseconds.
+   */
+  uint32_t                  erase_time;
+} SimFlashConfig;
+
+/**
+ * @brief   Simulated flash statistics.
+ */
+typedef struct {
+  uint32_t                  reads;          /**< @brief Read operations.    */
+  uint32_t                  programs;       /**< @brief Program operations. */
+  uint32_t                  erases;         /**< @brief Erase operations.   */
+  uint64_t                  read_bytes;     /**< @brief Bytes read.         */
+  uint64_t                  program_bytes;  /**< @brief Bytes programmed.   */
+  uint32_t                  violations;     /**< @brief Attempts to program
+                                                 erased bits from zero.     */
+  uint32_t                  max_erases;     /**< @brief Highest sector erase
+                                                 counter.                   */
+  uint32_t                  min_erases;     /**< @brief Lowest sector erase
+                                                 counter.                   */
+  uint64_t                  busy_time;      /**< @brief Modeled device busy
+                                                 time in microseconds.      */
+} SimFlashStats;
+
+/**
+ * @extends BaseFlash
+ *
+ * @brief   Simulated flash device.
+ */
+typedef struct {
+  /**
+   * @brief Virtual Methods Table.
+   */
+  const struct BaseFlashVMT *vmt;
+  _base_flash_data
+  /**
+   * @brief Current configuration data.
+   */
+  const SimFlashConfig      *config;
+  /**
+   * @brief Device image.
+   */
+  uint8_t                   *image;
+  /**
+   * @brief Per sector erase counters.
+   */
+  uint32_t                  *wear;
+  /**
+   * @brief Backing file descriptor or -1.
+   */
+  int                       fd;
+  /**
+   * @brief Operations before an injected power failure, zero if disabled.
+   */
+  uint32_t                  fail_countdown;
+  /**
+   * @brief The device lost power, all operations fail.
+   */
+  bool_t                    failed;
+  /**
+   * @brief Random generator state used for torn operations.
+   */
+  unsigned                  seed;
+  /**
+   * @brief Usage statistics.
+   */
+  SimFlashStats             stats;
+} SimFlashDriver;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void simflashObjectInit(SimFlashDriver *sfp);
+  void simflashStart(SimFlashDriver *sfp, const SimFlashConfig *config);
+  void simflashStop(SimFlashDriver *sfp);
+  void simflashInjectFailure(SimFlashDriver *sfp, uint32_t n, unsigned seed);
+  void simflashPowerCycle(SimFlashDriver *sfp);
+  void simflashGetStats(SimFlashDriver *sfp, SimFlashStats *stp);
+  void simflashResetStats(SimFlashDriver *sfp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SIMFLASH_H_ */
+
+/** @} */
@@ -0,0 +1,135 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    Posix/simi2c.c
+ * @brief   Posix simulated I2C devices code.
+ *
+ * @addtogroup POSIX_SIMI2C
+ * @{
+ */
+
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "simi2c.h"
+
+#if HAL_USE_I2C || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static size_t regs_write(I2CSimDevice *devp, const uint8_t *buf, size_t n) {
+  SimI2CRegsDevice *rdp = (SimI2CRegsDevice *)devp;
+  size_t i;
+
+  rdp->writes++;
+  rdp->pointer = (uint8_t)(buf[0] % rdp->config->size);
+  for (i = 1; i < n; i++) {
+    if (rdp->pointer >= rdp->config->writable)
+      return i;
+    rdp->regs[rdp->pointer] = buf[i];
+    rdp->pointer = (uint8_t)((rdp->pointer + 1) % rdp->config->size);
+  }
+  return n;
+}
+
+static void regs_read(I2CSimDevice *devp, uint8_t *buf, size_t n) {
+  SimI2CRegsDevice *rdp = (SimI2CRegsDevice *)devp;
+
+  rdp->reads++;
+  if (rdp->config->sample_cb != NULL)
+    rdp->config->sample_cb(rdp, rdp->pointer);
+  while (n--) {
+    *buf++ = rdp->regs[rdp->pointer];
+    rdp->pointer = (uint8_t)((rdp->pointer + 1) % rdp->config->size);
+  }
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Initializes a simulated registers device.
+ *
+ * @param[out] rdp      pointer to the @p SimI2CRegsDevice object
+ *
+ * @init
+ */
+void simi2cObjectInit(SimI2CRegsDevice *rdp) {
+
+  rdp->dev.next = NULL;
+  rdp->dev.addr = 0;
+  rdp->dev.write = regs_write;
+  rdp->dev.read = regs_read;
+  rdp->config = NULL;
+  rdp->pointer = 0;
+  memset(rdp->regs, 0, sizeof(rdp->regs));
+  rdp->writes = 0;
+  rdp->reads = 0;
+}
+
+/**
+ * @brief   Configures a simulated device and attaches it to a bus.
+ *
+ * @param[in] rdp       pointer to the @p SimI2CRegsDevice object
+ * @param[in] config    pointer to the @p SimI2CRegsConfig object
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ *
+ * @api
+ */
+void simi2cStart(SimI2CRegsDevice *rdp, const SimI2CRegsConfig *config,
+                 I2CDriver *i2cp) {
+
+  chDbgCheck((rdp != NULL) && (config != NULL) && (i2cp != NULL) &&
+             (config->size > 0) && (config->size <= SIM_I2C_MAX_REGISTERS) &&
+             (config->writable <= config->size), "simi2cStart");
+
+  rdp->config = config;
+  rdp->dev.addr = config->addr;
+  rdp->pointer = 0;
+  i2cSimAttach(i2cp, &rdp->dev);
+}
+
+/**
+ * @brief   Detaches a simulated device from the bus.
+ *
+ * @param[in] rdp       pointer to the @p SimI2CRegsDevice object
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ *
+ * @api
+ */
+void simi2cStop(SimI2CRegsDevice *rdp, I2CDriver *i2cp) {
+
+  chDbgCheck((rdp != NULL) && (i2cp != NULL), "simi2cStop");
+
+  i2cSimDetach(i2cp, &rdp->dev);
+}
+
+#endif /* HAL_USE_I2C */
+
+/** @} */
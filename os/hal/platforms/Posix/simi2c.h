@@ -0,0 +1,153 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    Posix/simi2c.h
+ * @brief   Posix simulated I2C devices header.
+ *
+ * @addtogroup POSIX_SIMI2C
+ * @{
+ */
+
+#ifndef _SIMI2C_H_
+#define _SIMI2C_H_
+
+#if HAL_USE_I2C || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Maximum number of registers of a simulated device.
+ */
+#if !defined(SIM_I2C_MAX_REGISTERS) || defined(__DOXYGEN__)
+#define SIM_I2C_MAX_REGISTERS       256
+#endif
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if (SIM_I2C_MAX_REGISTERS < 1) || (SIM_I2C_MAX_REGISTERS > 256)
+#error "invalid SIM_I2C_MAX_REGISTERS value"
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Type of a simulated registers device.
+ */
+typedef struct SimI2CRegsDevice SimI2CRegsDevice;
+
+/**
+ * @brief   Sample callback type.
+ * @details Invoked at the beginning of each read phase, sensor models use
+ *          it for updating the registers being read.
+ *
+ * @param[in] rdp       pointer to the @p SimI2CRegsDevice object
+ * @param[in] reg       the register pointer
+ */
+typedef void (*simi2csamplecb_t)(SimI2CRegsDevice *rdp, uint8_t reg);
+
+/**
+ * @brief   Simulated registers device configuration structure.
+ */
+typedef struct {
+  /**
+   * @brief   Device address (7 bits) without R/W bit.
+   */
+  i2caddr_t                 addr;
+  /**
+   * @brief   Number of registers, the register pointer wraps at this
+   *          value.
+   */
+  size_t                    size;
+  /**
+   * @brief   Writable registers, writing above this limit is not
+   *          acknowledged.
+   */
+  size_t                    writable;
+  /**
+   * @brief   Sample callback or @p NULL.
+   */
+  simi2csamplecb_t          sample_cb;
+} SimI2CRegsConfig;
+
+/**
+ * @brief   Simulated registers device.
+ * @details The model covers sensors and small EEPROMs: the first byte of
+ *          a write phase sets the register pointer, the following bytes
+ *          are written to the registers and reads start from the register
+ *          pointer, the pointer is incremented after each byte.
+ */
+struct SimI2CRegsDevice {
+  /**
+   * @brief   Bus device, must be the first field.
+   */
+  I2CSimDevice              dev;
+  /**
+   * @brief   Current configuration data.
+   */
+  const SimI2CRegsConfig    *config;
+  /**
+   * @brief   Register pointer.
+   */
+  uint8_t                   pointer;
+  /**
+   * @brief   Registers.
+   */
+  uint8_t                   regs[SIM_I2C_MAX_REGISTERS];
+  /**
+   * @brief   Write phases counter.
+   */
+  uint32_t                  writes;
+  /**
+   * @brief   Read phases counter.
+   */
+  uint32_t                  reads;
+};
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void simi2cObjectInit(SimI2CRegsDevice *rdp);
+  void simi2cStart(SimI2CRegsDevice *rdp, const SimI2CRegsConfig *config,
+                   I2CDriver *i2cp);
+  void simi2cStop(SimI2CRegsDevice *rdp, I2CDriver *i2cp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_I2C */
+
+#endif /* _SIMI2C_H_ */
+
+/** @} */
@@ -0,0 +1,294 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    Posix/spi_lld.c
+ * @brief   Posix low level simulated SPI driver code.
+ * @details The simulated bus is a loopback, the data is moved when the
+ *          operation is started and the completion interrupt is raised
+ *          when the time required by the configured bit rate has elapsed.
+ *
+ * @addtogroup POSIX_SPI
+ * @{
+ */
+
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#if HAL_USE_SPI || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/**
+ * @brief   Maximum operations completed by a single interrupt.
+ */
+#define COMPLETE_BURST              64
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/** @brief SPI1 driver identifier.*/
+#if USE_SIM_SPI1 || defined(__DOXYGEN__)
+SPIDriver SPID1;
+#endif
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static uint64_t now_us(void) {
+
+  return hal_lld_get_time_us();
+}
+
+/**
+ * @brief   Starts the simulated transfer of @p n frames.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ * @param[in] n         number of frames
+ */
+static void start(SPIDriver *spip, size_t n) {
+
+  spip->frames += (uint32_t)n;
+  if (spip->config->bitrate == 0)
+    spip->deadline = 0;
+  else
+    spip->deadline = now_us() +
+                     ((uint64_t)n * 8 * 1000000) / spip->config->bitrate;
+  spip->busy = TRUE;
+}
+
+/**
+ * @brief   Completion interrupt simulation.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ * @return              An interrupt has been served.
+ */
+static bool_t endint(SPIDriver *spip) {
+  unsigned i;
+  uint64_t now;
+
+  if (!spip->busy)
+    return FALSE;
+  hal_lld_wakeup_at(spip->deadline);
+  now = spip->deadline != 0 ? now_us() : 0;
+  for (i = 0; spip->busy && (spip->deadline <= now); i++) {
+    if (i >= COMPLETE_BURST)
+      break;
+    spip->busy = FALSE;
+    _spi_isr_code(spip);
+  }
+  return i > 0;
+}
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level SPI driver initialization.
+ *
+ * @notapi
+ */
+void spi_lld_init(void) {
+
+#if USE_SIM_SPI1
+  spiObjectInit(&SPID1);
+  SPID1.busy = FALSE;
+  SPID1.selected = 0;
+  SPID1.selects = 0;
+  SPID1.frames = 0;
+#endif
+}
+
+/**
+ * @brief   Configures and activates the SPI peripheral.
+ * @note    The function can be invoked from ISR context in order to switch
+ *          configuration between transactions.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ *
+ * @notapi
+ */
+void spi_lld_start(SPIDriver *spip) {
+
+  (void)spip;
+}
+
+/**
+ * @brief   Deactivates the SPI peripheral.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ *
+ * @notapi
+ */
+void spi_lld_stop(SPIDriver *spip) {
+
+  spip->busy = FALSE;
+  spip->selected = 0;
+}
+
+/**
+ * @brief   Asserts the slave select signal and prepares for transfers.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ *
+ * @notapi
+ */
+void spi_lld_select(SPIDriver *spip) {
+
+  spip->selected = spip->config->ssline;
+  spip->selects++;
+}
+
+/**
+ * @brief   Deasserts the slave select signal.
+ * @details The previously selected peripheral is unselected.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ *
+ * @notapi
+ */
+void spi_lld_unselect(SPIDriver *spip) {
+
+  spip->selected = 0;
+}
+
+/**
+ * @brief   Ignores data on the SPI bus.
+ * @details This asynchronous function starts the transmission of a series of
+ *          idle words on the SPI bus and ignores the received data.
+ * @post    At the end of the operation the configured callback is invoked.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ * @param[in] n         number of words to be ignored
+ *
+ * @notapi
+ */
+void spi_lld_ignore(SPIDriver *spip, size_t n) {
+
+  start(spip, n);
+}
+
+/**
+ * @brief   Exchanges data on the SPI bus.
+ * @details This asynchronous function starts a simultaneous transmit/receive
+ *          operation.
+ * @post    At the end of the operation the configured callback is invoked.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ * @param[in] n         number of words to be exchanged
+ * @param[in] txbuf     the pointer to the transmit buffer
+ * @param[out] rxbuf    the pointer to the receive buffer
+ *
+ * @notapi
+ */
+void spi_lld_exchange(SPIDriver *spip, size_t n,
+                      const void *txbuf, void *rxbuf) {
+
+  memmove(rxbuf, txbuf, n);
+  start(spip, n);
+}
+
+/**
+ * @brief   Sends data over the SPI bus.
+ * @details This asynchronous function starts a transmit operation.
+ * @post    At the end of the operation the configured callback is invoked.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ * @param[in] n         number of words to send
+ * @param[in] txbuf     the pointer to the transmit buffer
+ *
+ * @notapi
+ */
+void spi_lld_send(SPIDriver *spip, size_t n, const void *txbuf) {
+
+  (void)txbuf;
+  start(spip, n);
+}
+
+/**
+ * @brief   Receives data from the SPI bus.
+ * @details This asynchronous function starts a receive operation.
+ * @post    At the end of the operation the configured callback is invoked.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ * @param[in] n         number of words to receive
+ * @param[out] rxbuf    the pointer to the receive buffer
+ *
+ * @notapi
+ */
+void spi_lld_receive(SPIDriver *spip, size_t n, void *rxbuf) {
+
+  memset(rxbuf, 0xFF, n);
+  start(spip, n);
+}
+
+/**
+ * @brief   Exchanges one frame using a polled wait.
+ * @details This synchronous function exchanges one frame using a polled
+ *          synchronization method. This function is useful when exchanging
+ *          small amount of data on high speed channels, usually in this
+ *          situation is much more efficient just wait for completion using
+ *          polling than suspending the thread waiting for an interrupt.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ * @param[in] frame     the data frame to send over the SPI bus
+ * @return              The received data frame from the SPI bus.
+ */
+uint16_t spi_lld_polled_exchange(SPIDriver *spip, uint16_t frame) {
+
+  spip->frames++;
+  return frame & 0xFF;
+}
+
+/**
+ * @brief   SPI interrupts simulation.
+ *
+ * @return              An interrupt has been served.
+ *
+ * @notapi
+ */
+bool_t spi_lld_interrupt_pending(void) {
+  bool_t b = FALSE;
+
+  CH_IRQ_PROLOGUE();
+
+#if USE_SIM_SPI1
+  b = endint(&SPID1) || b;
+#endif
+
+  CH_IRQ_EPILOGUE();
+
+  return b;
+}
+
+#endif /* HAL_USE_SPI */
+
+/** @} */
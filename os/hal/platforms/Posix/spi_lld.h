@@ -0,0 +1,204 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    Posix/spi_lld.h
+ * @brief   Posix low level simulated SPI driver header.
+ *
+ * @addtogroup POSIX_SPI
+ * @{
+ */
+
+#ifndef _SPI_LLD_H_
+#define _SPI_LLD_H_
+
+#if HAL_USE_SPI || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   This implementation supports the transactions queue.
+ */
+#define SPI_SUPPORTS_TRANSACTIONS   TRUE
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   SPI1 driver enable switch.
+ * @details If set to @p TRUE the support for SPI1 is included.
+ * @note    The default is @p TRUE.
+ */
+#if !defined(USE_SIM_SPI1) || defined(__DOXYGEN__)
+#define USE_SIM_SPI1                TRUE
+#endif
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if SPI_USE_TRANSACTIONS && !SPI_SUPPORTS_TRANSACTIONS
+#error "SPI transactions not supported in this architecture"
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Type of a structure representing an SPI driver.
+ */
+typedef struct SPIDriver SPIDriver;
+
+/**
+ * @brief   SPI notification callback type.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object triggering the
+ *                      callback
+ */
+typedef void (*spicallback_t)(SPIDriver *spip);
+
+/**
+ * @brief   Driver configuration structure.
+ */
+typedef struct {
+  /**
+   * @brief   Operation complete callback or @p NULL.
+   */
+  spicallback_t             end_cb;
+  /* End of the mandatory fields.*/
+  /**
+   * @brief   Simulated bit rate in bits per second.
+   * @details Operations complete after the time required for shifting the
+   *          data at this rate, zero means no delay.
+   */
+  uint32_t                  bitrate;
+  /**
+   * @brief   Simulated slave select line.
+   */
+  unsigned                  ssline;
+} SPIConfig;
+
+/**
+ * @brief   Structure representing an SPI driver.
+ * @details The simulated bus is a loopback, the transmitted frames are
+ *          received back, receive only operations return 0xFF frames.
+ *          Frames are 8 bits wide.
+ */
+struct SPIDriver {
+  /**
+   * @brief Driver state.
+   */
+  spistate_t                state;
+  /**
+   * @brief Current configuration data.
+   */
+  const SPIConfig           *config;
+#if SPI_USE_WAIT || defined(__DOXYGEN__)
+  /**
+   * @brief Waiting thread.
+   */
+  Thread                    *thread;
+#endif /* SPI_USE_WAIT */
+#if SPI_USE_MUTUAL_EXCLUSION || defined(__DOXYGEN__)
+#if CH_USE_MUTEXES || defined(__DOXYGEN__)
+  /**
+   * @brief Mutex protecting the bus.
+   */
+  Mutex                     mutex;
+#elif CH_USE_SEMAPHORES
+  Semaphore                 semaphore;
+#endif
+#endif /* SPI_USE_MUTUAL_EXCLUSION */
+#if SPI_USE_TRANSACTIONS || defined(__DOXYGEN__)
+  /**
+   * @brief Transaction being executed.
+   */
+  SPITransaction            *txncur;
+  /**
+   * @brief Queued transactions in priority order.
+   */
+  SPITransaction            *txnqueue;
+  /**
+   * @brief Timer used by the delay segments.
+   */
+  VirtualTimer              txnvt;
+#endif /* SPI_USE_TRANSACTIONS */
+#if defined(SPI_DRIVER_EXT_FIELDS)
+  SPI_DRIVER_EXT_FIELDS
+#endif
+  /* End of the mandatory fields.*/
+  /**
+   * @brief   An operation is in progress.
+   */
+  bool_t                    busy;
+  /**
+   * @brief   Completion time of the operation in progress, microseconds.
+   */
+  uint64_t                  deadline;
+  /**
+   * @brief   Currently selected slave line, zero if none.
+   */
+  unsigned                  selected;
+  /**
+   * @brief   Slave select assertions counter.
+   */
+  uint32_t                  selects;
+  /**
+   * @brief   Transferred frames counter.
+   */
+  uint32_t                  frames;
+};
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#if USE_SIM_SPI1 && !defined(__DOXYGEN__)
+extern SPIDriver SPID1;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void spi_lld_init(void);
+  void spi_lld_start(SPIDriver *spip);
+  void spi_lld_stop(SPIDriver *spip);
+  void spi_lld_select(SPIDriver *spip);
+  void spi_lld_unselect(SPIDriver *spip);
+  void spi_lld_ignore(SPIDriver *spip, size_t n);
+  void spi_lld_exchange(SPIDriver *spip, size_t n,
+                        const void *txbuf, void *rxbuf);
+  void spi_lld_send(SPIDriver *spip, size_t n, const void *txbuf);
+  void spi_lld_receive(SPIDriver *spip, size_t n, void *rxbuf);
+  uint16_t spi_lld_polled_exchange(SPIDriver *spip, uint16_t frame);
+  bool_t spi_lld_interrupt_pending(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_SPI */
+
+#endif /* _SPI_LLD_H_ */
+
+/** @} */
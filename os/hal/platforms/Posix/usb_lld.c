@@ -0,0 +1,920 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    Posix/usb_lld.c
+ * @brief   Posix low level simulated USB driver code.
+ * @details The simulated device controller has no bus, the host side is
+ *          emulated by the @p usbSim functions which exchange single
+ *          packets with the endpoints. The host functions must be called
+ *          from a thread, the device side callbacks are invoked in a
+ *          simulated interrupt context and a preemption is performed on
+ *          exit if a callback readied a thread with higher priority.
+ *          On top of the packet level functions a minimal host side
+ *          driver performs whole transfers, control requests and the
+ *          enumeration, the transfers can be paced to a modeled bus
+ *          bandwidth for benchmarking.
+ *
+ * @addtogroup POSIX_USB
+ * @{
+ */
+
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#if HAL_USE_USB || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   USB1 driver identifier.
+ */
+#if USE_SIM_USB1 || defined(__DOXYGEN__)
+USBDriver USBD1;
+#endif
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   EP0 state.
+ * @note    It is an union because IN and OUT endpoints are never used at the
+ *          same time for EP0.
+ */
+static union {
+  /**
+   * @brief   IN EP0 state.
+   */
+  USBInEndpointState in;
+  /**
+   * @brief   OUT EP0 state.
+   */
+  USBOutEndpointState out;
+} ep0_state;
+
+/**
+ * @brief   EP0 initialization structure.
+ */
+static const USBEndpointConfig ep0config = {
+  USB_EP_MODE_TYPE_CTRL,
+  _usb_ep0setup,
+  _usb_ep0in,
+  _usb_ep0out,
+  0x40,
+  0x40,
+  &ep0_state.in,
+  &ep0_state.out
+};
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+/**
+ * @brief   Simulated interrupt exit.
+ * @details Performs a preemption if the callbacks readied a thread with
+ *          higher priority, same as the other simulated sources.
+ */
+static void sim_irq_exit(void) {
+
+  dbg_check_lock();
+  if (chSchIsPreemptionRequired())
+    chSchDoReschedule();
+  dbg_check_unlock();
+}
+
+/**
+ * @brief   Accounts the wire time of a packet.
+ * @details The host sleeps for the time the packet would take on the
+ *          modeled bus, the fractions of system tick are carried over to
+ *          the next packet.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] n         packet size
+ */
+static void sim_bus_time(USBDriver *usbp, size_t n) {
+  systime_t ticks;
+
+  if (usbp->bus_rate == 0)
+    return;
+  usbp->bus_pending += (uint32_t)(((uint64_t)n * 1000000) / usbp->bus_rate);
+  ticks = (systime_t)(((uint64_t)usbp->bus_pending * CH_FREQUENCY) / 1000000);
+  if (ticks > 0) {
+    usbp->bus_pending -= (uint32_t)(((uint64_t)ticks * 1000000) /
+                                    CH_FREQUENCY);
+    chThdSleep(ticks);
+  }
+}
+
+/**
+ * @brief   Waits before retrying a NAKed token.
+ *
+ * @param[in] start     system time of the first attempt
+ * @param[in] timeout   retry timeout
+ * @return              The operation status.
+ * @retval FALSE        the token can be retried.
+ * @retval TRUE         the timeout expired.
+ */
+static bool_t sim_nak_wait(systime_t start, systime_t timeout) {
+
+  if ((timeout != TIME_INFINITE) &&
+      ((timeout == TIME_IMMEDIATE) ||
+       !chTimeIsWithin(start, start + timeout)))
+    return TRUE;
+  chThdSleep(USB_SIM_NAK_INTERVAL);
+  return FALSE;
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level USB driver initialization.
+ *
+ * @notapi
+ */
+void usb_lld_init(void) {
+
+#if USE_SIM_USB1
+  /* Driver initialization.*/
+  usbObjectInit(&USBD1);
+  USBD1.connected = FALSE;
+  USBD1.frame = 0;
+  USBD1.bus_rate = 0;
+  USBD1.bus_pending = 0;
+  memset(&USBD1.stats, 0, sizeof(USBSimStats));
+#endif /* USE_SIM_USB1 */
+}
+
+/**
+ * @brief   Configures and activates the USB peripheral.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ *
+ * @notapi
+ */
+void usb_lld_start(USBDriver *usbp) {
+
+  if (usbp->state == USB_STOP) {
+    /* Reset procedure enforced on driver start.*/
+    _usb_reset(usbp);
+  }
+}
+
+/**
+ * @brief   Deactivates the USB peripheral.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ *
+ * @notapi
+ */
+void usb_lld_stop(USBDriver *usbp) {
+
+  usbp->connected = FALSE;
+}
+
+/**
+ * @brief   USB low level reset routine.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ *
+ * @notapi
+ */
+void usb_lld_reset(USBDriver *usbp) {
+
+  /* Post reset initialization.*/
+  usbp->stalled_in  = 0;
+  usbp->stalled_out = 0;
+  usbp->frame       = 0;
+
+  /* EP0 initialization.*/
+  usbp->epc[0] = &ep0config;
+  usb_lld_init_endpoint(usbp, 0);
+}
+
+/**
+ * @brief   Sets the USB address.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ *
+ * @notapi
+ */
+void usb_lld_set_address(USBDriver *usbp) {
+
+  (void)usbp;
+}
+
+/**
+ * @brief   Enables an endpoint.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] ep        endpoint number
+ *
+ * @notapi
+ */
+void usb_lld_init_endpoint(USBDriver *usbp, usbep_t ep) {
+
+  usbp->stalled_in  &= ~(1 << ep);
+  usbp->stalled_out &= ~(1 << ep);
+}
+
+/**
+ * @brief   Disables all the active endpoints except the endpoint zero.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ *
+ * @notapi
+ */
+void usb_lld_disable_endpoints(USBDriver *usbp) {
+
+  usbp->stalled_in   &= 1;
+  usbp->stalled_out  &= 1;
+  usbp->transmitting &= 1;
+  usbp->receiving    &= 1;
+}
+
+/**
+ * @brief   Returns the status of an OUT endpoint.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] ep        endpoint number
+ * @return              The endpoint status.
+ * @retval EP_STATUS_DISABLED The endpoint is not active.
+ * @retval EP_STATUS_STALLED  The endpoint is stalled.
+ * @retval EP_STATUS_ACTIVE   The endpoint is active.
+ *
+ * @notapi
+ */
+usbepstatus_t usb_lld_get_status_out(USBDriver *usbp, usbep_t ep) {
+
+  if ((ep > USB_MAX_ENDPOINTS) || (usbp->epc[ep] == NULL) ||
+      (usbp->epc[ep]->out_cb == NULL))
+    return EP_STATUS_DISABLED;
+  if (usbp->stalled_out & (1 << ep))
+    return EP_STATUS_STALLED;
+  return EP_STATUS_ACTIVE;
+}
+
+/**
+ * @brief   Returns the status of an IN endpoint.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] ep        endpoint number
+ * @return              The endpoint status.
+ * @retval EP_STATUS_DISABLED The endpoint is not active.
+ * @retval EP_STATUS_STALLED  The endpoint is stalled.
+ * @retval EP_STATUS_ACTIVE   The endpoint is active.
+ *
+ * @notapi
+ */
+usbepstatus_t usb_lld_get_status_in(USBDriver *usbp, usbep_t ep) {
+
+  if ((ep > USB_MAX_ENDPOINTS) || (usbp->epc[ep] == NULL) ||
+      (usbp->epc[ep]->in_cb == NULL))
+    return EP_STATUS_DISABLED;
+  if (usbp->stalled_in & (1 << ep))
+    return EP_STATUS_STALLED;
+  return EP_STATUS_ACTIVE;
+}
+
+/**
+ * @brief   Reads a setup packet from the dedicated packet buffer.
+ * @details This function must be invoked in the context of the @p setup_cb
+ *          callback in order to read the received setup packet.
+ * @pre     In order to use this function the endpoint must have been
+ *          initialized as a control endpoint.
+ * @post    The endpoint is ready to accept another packet.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] ep        endpoint number
+ * @param[out] buf      buffer where to copy the packet data
+ *
+ * @notapi
+ */
+void usb_lld_read_setup(USBDriver *usbp, usbep_t ep, uint8_t *buf) {
+
+  (void)ep;
+  memcpy(buf, usbp->setup_packet, 8);
+}
+
+/**
+ * @brief   Prepares for a receive operation.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] ep        endpoint number
+ *
+ * @notapi
+ */
+void usb_lld_prepare_receive(USBDriver *usbp, usbep_t ep) {
+
+  (void)usbp;
+  (void)ep;
+}
+
+/**
+ * @brief   Prepares for a transmit operation.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] ep        endpoint number
+ *
+ * @notapi
+ */
+void usb_lld_prepare_transmit(USBDriver *usbp, usbep_t ep) {
+
+  (void)usbp;
+  (void)ep;
+}
+
+/**
+ * @brief   Starts a receive operation on an OUT endpoint.
+ * @note    The endpoint is armed by the @p receiving bit, the packets are
+ *          accepted when the host sends them.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] ep        endpoint number
+ *
+ * @notapi
+ */
+void usb_lld_start_out(USBDriver *usbp, usbep_t ep) {
+
+  (void)usbp;
+  (void)ep;
+}
+
+/**
+ * @brief   Starts a transmit operation on an IN endpoint.
+ * @note    The endpoint is armed by the @p transmitting bit, the packets
+ *          are sent when the host asks for them.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] ep        endpoint number
+ *
+ * @notapi
+ */
+void usb_lld_start_in(USBDriver *usbp, usbep_t ep) {
+
+  (void)usbp;
+  (void)ep;
+}
+
+/**
+ * @brief   Brings an OUT endpoint in the stalled state.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] ep        endpoint number
+ *
+ * @notapi
+ */
+void usb_lld_stall_out(USBDriver *usbp, usbep_t ep) {
+
+  usbp->stalled_out |= 1 << ep;
+}
+
+/**
+ * @brief   Brings an IN endpoint in the stalled state.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] ep        endpoint number
+ *
+ * @notapi
+ */
+void usb_lld_stall_in(USBDriver *usbp, usbep_t ep) {
+
+  usbp->stalled_in |= 1 << ep;
+}
+
+/**
+ * @brief   Brings an OUT endpoint in the active state.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] ep        endpoint number
+ *
+ * @notapi
+ */
+void usb_lld_clear_out(USBDriver *usbp, usbep_t ep) {
+
+  usbp->stalled_out &= ~(1 << ep);
+}
+
+/**
+ * @brief   Brings an IN endpoint in the active state.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] ep        endpoint number
+ *
+ * @notapi
+ */
+void usb_lld_clear_in(USBDriver *usbp, usbep_t ep) {
+
+  usbp->stalled_in &= ~(1 << ep);
+}
+
+/**
+ * @brief   Host side, signals a bus reset.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ *
+ * @api
+ */
+void usbSimBusReset(USBDriver *usbp) {
+
+  chDbgCheck(usbp != NULL, "usbSimBusReset");
+
+  if (usbp->state == USB_STOP)
+    return;
+
+  CH_IRQ_PROLOGUE();
+  _usb_reset(usbp);
+  _usb_isr_invoke_event_cb(usbp, USB_EVENT_RESET);
+  CH_IRQ_EPILOGUE();
+  sim_irq_exit();
+}
+
+/**
+ * @brief   Host side, signals the start of a new frame.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ *
+ * @api
+ */
+void usbSimStartOfFrame(USBDriver *usbp) {
+
+  chDbgCheck(usbp != NULL, "usbSimStartOfFrame");
+
+  if (usbp->state == USB_STOP)
+    return;
+
+  CH_IRQ_PROLOGUE();
+  usbp->frame = (usbp->frame + 1) & 0x7FF;
+  _usb_isr_invoke_sof_cb(usbp);
+  CH_IRQ_EPILOGUE();
+  sim_irq_exit();
+}
+
+/**
+ * @brief   Host side, sends a SETUP packet to a control endpoint.
+ * @details A SETUP packet is always accepted, it clears the stall condition
+ *          and aborts any pending transfer on the endpoint.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] ep        endpoint number
+ * @param[in] setup     the 8 bytes setup packet
+ *
+ * @api
+ */
+void usbSimSetup(USBDriver *usbp, usbep_t ep, const uint8_t *setup) {
+
+  chDbgCheck((usbp != NULL) && (ep <= USB_MAX_ENDPOINTS) && (setup != NULL),
+             "usbSimSetup");
+
+  if (!usbp->connected || (usbp->epc[ep] == NULL) ||
+      (usbp->epc[ep]->setup_cb == NULL))
+    return;
+
+  usbp->stats.setups++;
+  CH_IRQ_PROLOGUE();
+  memcpy(usbp->setup_packet, setup, 8);
+  usbp->stalled_in   &= ~(1 << ep);
+  usbp->stalled_out  &= ~(1 << ep);
+  usbp->transmitting &= ~(1 << ep);
+  usbp->receiving    &= ~(1 << ep);
+  _usb_isr_invoke_setup_cb(usbp, ep);
+  CH_IRQ_EPILOGUE();
+  sim_irq_exit();
+}
+
+/**
+ * @brief   Host side, sends an IN token.
+ * @details The transfer callback is invoked after the last packet of the
+ *          transfer has been fetched.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] ep        endpoint number
+ * @param[out] buf      buffer for the packet, it must be large as the
+ *                      endpoint maximum packet size
+ * @return              The size of the received packet or a handshake.
+ * @retval USB_SIM_NAK  No transfer is pending on the endpoint.
+ * @retval USB_SIM_STALL The endpoint is stalled.
+ * @retval USB_SIM_TIMEOUT The endpoint does not exist.
+ *
+ * @api
+ */
+msg_t usbSimIn(USBDriver *usbp, usbep_t ep, uint8_t *buf) {
+  const USBEndpointConfig *epcp;
+  USBInEndpointState *isp;
+  size_t i, n;
+
+  chDbgCheck((usbp != NULL) && (ep <= USB_MAX_ENDPOINTS) && (buf != NULL),
+             "usbSimIn");
+
+  epcp = usbp->epc[ep];
+  if (!usbp->connected || (epcp == NULL) || (epcp->in_cb == NULL))
+    return USB_SIM_TIMEOUT;
+  if (usbp->stalled_in & (1 << ep)) {
+    usbp->stats.stalls++;
+    return USB_SIM_STALL;
+  }
+  if (!(usbp->transmitting & (1 << ep))) {
+    usbp->stats.naks_in++;
+    return USB_SIM_NAK;
+  }
+
+  CH_IRQ_PROLOGUE();
+  isp = epcp->in_state;
+  n = isp->txsize - isp->txcnt;
+  if (n > epcp->in_maxsize)
+    n = epcp->in_maxsize;
+  if (isp->txqueued) {
+    chSysLockFromIsr();
+    for (i = 0; i < n; i++)
+      buf[i] = (uint8_t)chOQGetI(isp->mode.queue.txqueue);
+    chSysUnlockFromIsr();
+  }
+  else
+    memcpy(buf, isp->mode.linear.txbuf + isp->txcnt, n);
+  isp->txcnt += n;
+  usbp->stats.packets_in++;
+  usbp->stats.bytes_in += n;
+  if (isp->txcnt >= isp->txsize) {
+    /* Transfer completed, invokes the callback.*/
+    _usb_isr_invoke_in_cb(usbp, ep);
+  }
+  CH_IRQ_EPILOGUE();
+  sim_irq_exit();
+  return (msg_t)n;
+}
+
+/**
+ * @brief   Host side, sends an OUT packet.
+ * @details The transfer callback is invoked when the requested size has
+ *          been received or on a short packet.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] ep        endpoint number
+ * @param[in] buf       packet data
+ * @param[in] n         packet size, up to the endpoint maximum packet size
+ * @return              The handshake.
+ * @retval USB_SIM_ACK  Packet accepted.
+ * @retval USB_SIM_NAK  No transfer is pending on the endpoint.
+ * @retval USB_SIM_STALL The endpoint is stalled.
+ * @retval USB_SIM_TIMEOUT The endpoint does not exist.
+ *
+ * @api
+ */
+msg_t usbSimOut(USBDriver *usbp, usbep_t ep, const uint8_t *buf, size_t n) {
+  const USBEndpointConfig *epcp;
+  USBOutEndpointState *osp;
+  size_t i, m;
+
+  chDbgCheck((usbp != NULL) && (ep <= USB_MAX_ENDPOINTS) &&
+             ((buf != NULL) || (n == 0)), "usbSimOut");
+
+  epcp = usbp->epc[ep];
+  if (!usbp->connected || (epcp == NULL) || (epcp->out_cb == NULL))
+    return USB_SIM_TIMEOUT;
+  chDbgAssert(n <= epcp->out_maxsize, "usbSimOut(), #1", "babble");
+  if (usbp->stalled_out & (1 << ep)) {
+    usbp->stats.stalls++;
+    return USB_SIM_STALL;
+  }
+  if (!(usbp->receiving & (1 << ep))) {
+    usbp->stats.naks_out++;
+    return USB_SIM_NAK;
+  }
+
+  CH_IRQ_PROLOGUE();
+  osp = epcp->out_state;
+  m = osp->rxsize - osp->rxcnt;
+  if (m > n)
+    m = n;
+  if (osp->rxqueued) {
+    chSysLockFromIsr();
+    for (i = 0; i < m; i++)
+      chIQPutI(osp->mode.queue.rxqueue, buf[i]);
+    chSysUnlockFromIsr();
+  }
+  else if (m > 0)
+    memcpy(osp->mode.linear.rxbuf + osp->rxcnt, buf, m);
+  osp->rxcnt += m;
+  usbp->stats.packets_out++;
+  usbp->stats.bytes_out += n;
+
+  /* The transaction is completed if the specified size has been received
+     or the current packet is a short packet.*/
+  if ((n < epcp->out_maxsize) || (osp->rxcnt >= osp->rxsize)) {
+    /* Transfer complete, invokes the callback.*/
+    _usb_isr_invoke_out_cb(usbp, ep);
+  }
+  CH_IRQ_EPILOGUE();
+  sim_irq_exit();
+  return USB_SIM_ACK;
+}
+
+/**
+ * @brief   Host side, receives a transfer from an IN endpoint.
+ * @details The transfer ends when the specified amount of data has been
+ *          received or on a short packet, NAKed tokens are retried every
+ *          @p USB_SIM_NAK_INTERVAL ticks until the timeout expires.
+ * @note    Data sent by the device beyond the specified size is
+ *          discarded.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] ep        endpoint number
+ * @param[out] buf      buffer for the received data
+ * @param[in] n         maximum transfer size
+ * @param[in] timeout   the number of ticks before the operation timeouts,
+ *                      the following special values are allowed:
+ *                      - @a TIME_IMMEDIATE immediate timeout.
+ *                      - @a TIME_INFINITE no timeout.
+ *                      .
+ * @return              The received size or a handshake.
+ * @retval USB_SIM_NAK  The timeout expired before the first packet.
+ * @retval USB_SIM_STALL The endpoint is stalled.
+ * @retval USB_SIM_TIMEOUT The endpoint does not exist.
+ *
+ * @api
+ */
+msg_t usbSimTransferIn(USBDriver *usbp, usbep_t ep, uint8_t *buf,
+                       size_t n, systime_t timeout) {
+  uint8_t pkt[USB_SIM_MAX_PACKET_SIZE];
+  systime_t start = chTimeNow();
+  size_t cnt = 0, maxsize;
+  msg_t msg;
+
+  chDbgCheck((usbp != NULL) && (ep <= USB_MAX_ENDPOINTS) &&
+             ((buf != NULL) || (n == 0)), "usbSimTransferIn");
+
+  if (usbp->epc[ep] == NULL)
+    return USB_SIM_TIMEOUT;
+  maxsize = usbp->epc[ep]->in_maxsize;
+  chDbgAssert(maxsize <= USB_SIM_MAX_PACKET_SIZE,
+              "usbSimTransferIn(), #1", "packet too large");
+
+  while (TRUE) {
+    /* Full packets are received in place.*/
+    msg = usbSimIn(usbp, ep, n - cnt >= maxsize ? buf + cnt : pkt);
+    if (msg == USB_SIM_NAK) {
+      if (sim_nak_wait(start, timeout))
+        return cnt > 0 ? (msg_t)cnt : USB_SIM_NAK;
+      continue;
+    }
+    if (msg < 0)
+      return msg;
+    sim_bus_time(usbp, (size_t)msg);
+    if (n - cnt < maxsize) {
+      if ((size_t)msg > n - cnt)
+        msg = (msg_t)(n - cnt);
+      if (msg > 0)
+        memcpy(buf + cnt, pkt, msg);
+      return (msg_t)(cnt + msg);
+    }
+    cnt += msg;
+
+    /* A short packet terminates the transfer.*/
+    if ((cnt >= n) || ((size_t)msg < maxsize))
+      return (msg_t)cnt;
+  }
+}
+
+/**
+ * @brief   Host side, sends a transfer to an OUT endpoint.
+ * @details The data is split in maximum size packets, a zero sized
+ *          transfer sends a single zero sized packet. NAKed packets are
+ *          retried every @p USB_SIM_NAK_INTERVAL ticks until the timeout
+ *          expires.
+ * @note    A zero sized packet is not appended when the size is a multiple
+ *          of the packet size, the caller has to send it if required by
+ *          the class protocol.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] ep        endpoint number
+ * @param[in] buf       data to be sent
+ * @param[in] n         transfer size
+ * @param[in] timeout   the number of ticks before the operation timeouts,
+ *                      the following special values are allowed:
+ *                      - @a TIME_IMMEDIATE immediate timeout.
+ *                      - @a TIME_INFINITE no timeout.
+ *                      .
+ * @return              The sent size or a handshake.
+ * @retval USB_SIM_NAK  The timeout expired before the first packet.
+ * @retval USB_SIM_STALL The endpoint is stalled.
+ * @retval USB_SIM_TIMEOUT The endpoint does not exist.
+ *
+ * @api
+ */
+msg_t usbSimTransferOut(USBDriver *usbp, usbep_t ep, const uint8_t *buf,
+                        size_t n, systime_t timeout) {
+  systime_t start = chTimeNow();
+  size_t cnt = 0, k, maxsize;
+  msg_t msg;
+
+  chDbgCheck((usbp != NULL) && (ep <= USB_MAX_ENDPOINTS) &&
+             ((buf != NULL) || (n == 0)), "usbSimTransferOut");
+
+  if (usbp->epc[ep] == NULL)
+    return USB_SIM_TIMEOUT;
+  maxsize = usbp->epc[ep]->out_maxsize;
+
+  while (TRUE) {
+    k = n - cnt < maxsize ? n - cnt : maxsize;
+    msg = usbSimOut(usbp, ep, buf + cnt, k);
+    if (msg == USB_SIM_NAK) {
+      if (sim_nak_wait(start, timeout))
+        return cnt > 0 ? (msg_t)cnt : USB_SIM_NAK;
+      continue;
+    }
+    if (msg < 0)
+      return msg;
+    sim_bus_time(usbp, k);
+    cnt += k;
+    if (cnt >= n)
+      return (msg_t)cnt;
+  }
+}
+
+/**
+ * @brief   Host side, performs a control transfer on the endpoint zero.
+ * @details The setup, data and status stages are executed in sequence.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] type      the @p bmRequestType field
+ * @param[in] req       the @p bRequest field
+ * @param[in] value     the @p wValue field
+ * @param[in] index     the @p wIndex field
+ * @param[in,out] buf   data stage buffer
+ * @param[in] n         the @p wLength field
+ * @return              The data stage size or a handshake.
+ * @retval USB_SIM_NAK  The device did not answer in time.
+ * @retval USB_SIM_STALL The request has been refused.
+ * @retval USB_SIM_TIMEOUT The device is not connected.
+ *
+ * @api
+ */
+msg_t usbSimControl(USBDriver *usbp, uint8_t type, uint8_t req,
+                    uint16_t value, uint16_t index,
+                    uint8_t *buf, uint16_t n) {
+  uint8_t setup[8] = {type, req, value & 0xFF, value >> 8,
+                      index & 0xFF, index >> 8, n & 0xFF, n >> 8};
+  msg_t msg = 0, sts;
+
+  chDbgCheck((usbp != NULL) && ((buf != NULL) || (n == 0)),
+             "usbSimControl");
+
+  if (!usbp->connected)
+    return USB_SIM_TIMEOUT;
+  usbSimSetup(usbp, 0, setup);
+  if (type & USB_RTYPE_DIR_DEV2HOST) {
+    msg = usbSimTransferIn(usbp, 0, buf, n, USB_SIM_CONTROL_TIMEOUT);
+    if (msg < 0)
+      return msg;
+    sts = usbSimTransferOut(usbp, 0, NULL, 0, USB_SIM_CONTROL_TIMEOUT);
+  }
+  else {
+    if (n > 0) {
+      msg = usbSimTransferOut(usbp, 0, buf, n, USB_SIM_CONTROL_TIMEOUT);
+      if (msg < 0)
+        return msg;
+    }
+    sts = usbSimTransferIn(usbp, 0, NULL, 0, USB_SIM_CONTROL_TIMEOUT);
+  }
+  return sts < 0 ? sts : msg;
+}
+
+/**
+ * @brief   Host side, enumerates the device.
+ * @details The bus is reset, then the device descriptor is read, the
+ *          address is assigned, the whole configuration descriptor is read
+ *          and the configuration is selected.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] address   the address to be assigned
+ * @param[in] configuration the configuration to be selected
+ * @param[out] buf      buffer for the configuration descriptor
+ * @param[in] n         buffer size, at least 9 bytes
+ * @return              The configuration descriptor size or a handshake.
+ * @retval USB_SIM_NAK  The device did not answer in time.
+ * @retval USB_SIM_STALL A request has been refused or a descriptor is
+ *                      malformed.
+ * @retval USB_SIM_TIMEOUT The device is not connected.
+ *
+ * @api
+ */
+msg_t usbSimEnumerate(USBDriver *usbp, uint8_t address,
+                      uint8_t configuration, uint8_t *buf, size_t n) {
+  uint8_t desc[18];
+  msg_t msg;
+  size_t total;
+
+  chDbgCheck((usbp != NULL) && (buf != NULL) && (n >= 9),
+             "usbSimEnumerate");
+
+  usbSimBusReset(usbp);
+  msg = usbSimControl(usbp, USB_RTYPE_DIR_DEV2HOST, USB_REQ_GET_DESCRIPTOR,
+                      USB_DESCRIPTOR_DEVICE << 8, 0, desc, sizeof desc);
+  if (msg < 0)
+    return msg;
+  if ((msg != sizeof desc) || (desc[1] != USB_DESCRIPTOR_DEVICE))
+    return USB_SIM_STALL;
+  msg = usbSimControl(usbp, USB_RTYPE_RECIPIENT_DEVICE, USB_REQ_SET_ADDRESS,
+                      address, 0, NULL, 0);
+  if (msg < 0)
+    return msg;
+
+  /* The configuration descriptor header first then the whole tree.*/
+  msg = usbSimControl(usbp, USB_RTYPE_DIR_DEV2HOST, USB_REQ_GET_DESCRIPTOR,
+                      USB_DESCRIPTOR_CONFIGURATION << 8, 0, buf, 9);
+  if (msg < 0)
+    return msg;
+  total = usbFetchWord(&buf[2]);
+  if ((msg != 9) || (buf[1] != USB_DESCRIPTOR_CONFIGURATION) ||
+      (total < 9) || (total > n))
+    return USB_SIM_STALL;
+  msg = usbSimControl(usbp, USB_RTYPE_DIR_DEV2HOST, USB_REQ_GET_DESCRIPTOR,
+                      USB_DESCRIPTOR_CONFIGURATION << 8, 0, buf,
+                      (uint16_t)total);
+  if (msg < 0)
+    return msg;
+  if ((size_t)msg != total)
+    return USB_SIM_STALL;
+  msg = usbSimControl(usbp, USB_RTYPE_RECIPIENT_DEVICE,
+                      USB_REQ_SET_CONFIGURATION, configuration, 0, NULL, 0);
+  if (msg < 0)
+    return msg;
+  return (msg_t)total;
+}
+
+/**
+ * @brief   Host side, sets the modeled bus bandwidth.
+ * @details The host side transfer functions sleep for the time their
+ *          packets would take on the wire, the packet level functions are
+ *          not affected.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] rate      bandwidth in bytes per second, zero disables the
+ *                      pacing
+ *
+ * @api
+ */
+void usbSimSetBusRate(USBDriver *usbp, uint32_t rate) {
+
+  chDbgCheck(usbp != NULL, "usbSimSetBusRate");
+
+  usbp->bus_rate = rate;
+  usbp->bus_pending = 0;
+}
+
+/**
+ * @brief   Host side, returns the statistics.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[out] ssp      pointer to the @p USBSimStats structure
+ *
+ * @api
+ */
+void usbSimGetStats(USBDriver *usbp, USBSimStats *ssp) {
+
+  chDbgCheck((usbp != NULL) && (ssp != NULL), "usbSimGetStats");
+
+  chSysLock();
+  *ssp = usbp->stats;
+  chSysUnlock();
+}
+
+/**
+ * @brief   Host side, clears the statistics.
+ *
+ * @param[in] usbp      pointer to the @p USBDriver object
+ *
+ * @api
+ */
+void usbSimResetStats(USBDriver *usbp) {
+
+  chDbgCheck(usbp != NULL, "usbSimResetStats");
+
+  chSysLock();
+  memset(&usbp->stats, 0, sizeof(USBSimStats));
+  chSysUnlock();
+}
+
+#endif /* HAL_USE_USB */
+
+/** @} */
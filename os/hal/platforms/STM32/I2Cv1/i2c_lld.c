@@ -112,13 +112,35 @@ I2CDriver I2CD3;
 
 /**
  * @brief   Wakes up the waiting thread.
+ * @details If a transaction is in progress its end is notified to the
+ *          high level driver instead.
  *
  * @param[in] i2cp      pointer to the @p I2CDriver object
  * @param[in] msg       wakeup message
  *
  * @notapi
  */
+#if I2C_USE_TRANSACTIONS
 #define wakeup_isr(i2cp, msg) {                                             \
+  if ((i2cp)->txncur != NULL)                                               \
+    _i2c_txn_isr(i2cp, msg);                                                \
+  else {                                                                    \
+    wakeup_thread_isr(i2cp, msg);                                           \
+  }                                                                         \
+}
+#else
+#define wakeup_isr(i2cp, msg) wakeup_thread_isr(i2cp, msg)
+#endif
+
+/**
+ * @brief   Wakes up the thread waiting a synchronous operation.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] msg       wakeup message
+ *
+ * @notapi
+ */
+#define wakeup_thread_isr(i2cp, msg) {                                      \
   chSysLockFromIsr();                                                       \
   if ((i2cp)->thread != NULL) {                                             \
     Thread *tp = (i2cp)->thread;                                            \
@@ -897,6 +919,78 @@ msg_t i2c_lld_master_transmit_timeout(I2CDriver *i2cp, i2caddr_t addr,
   return chThdSelf()->p_u.rdymsg;
 }
 
+#if I2C_USE_TRANSACTIONS || defined(__DOXYGEN__)
+/**
+ * @brief   Starts an asynchronous transaction.
+ * @details The operation end is notified by calling @p _i2c_txn_isr() from
+ *          the driver ISR.
+ * @note    This function is invoked from a critical zone and can be
+ *          invoked from ISR context, the bus is not checked for busy state
+ *          except for the completion of the previous STOP condition.
+ * @note    Number of receiving bytes must be 0 or more than 1 on STM32F1x.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] addr      slave device address
+ * @param[in] txbuf     pointer to the transmit buffer
+ * @param[in] txbytes   number of bytes to be transmitted, zero for a read
+ *                      only transaction
+ * @param[out] rxbuf    pointer to the receive buffer
+ * @param[in] rxbytes   number of bytes to be received
+ *
+ * @notapi
+ */
+void i2c_lld_start_transaction(I2CDriver *i2cp, i2caddr_t addr,
+                               const uint8_t *txbuf, size_t txbytes,
+                               uint8_t *rxbuf, size_t rxbytes) {
+  I2C_TypeDef *dp = i2cp->i2c;
+
+#if defined(STM32F1XX_I2C)
+  chDbgCheck((rxbytes != 1), "i2c_lld_start_transaction");
+#endif
+
+  /* Initializes driver fields, LSB = 1 -> receive.*/
+  if (txbytes > 0)
+    i2cp->addr = addr << 1;
+  else
+    i2cp->addr = (addr << 1) | 0x01;
+
+  /* TX DMA setup.*/
+  dmaStreamSetMode(i2cp->dmatx, i2cp->txdmamode);
+  dmaStreamSetMemory0(i2cp->dmatx, txbuf);
+  dmaStreamSetTransactionSize(i2cp->dmatx, txbytes);
+
+  /* RX DMA setup.*/
+  dmaStreamSetMode(i2cp->dmarx, i2cp->rxdmamode);
+  dmaStreamSetMemory0(i2cp->dmarx, rxbuf);
+  dmaStreamSetTransactionSize(i2cp->dmarx, rxbytes);
+
+  /* The STOP condition of the previous transaction takes a single bit
+     time.*/
+  while (dp->CR1 & I2C_CR1_STOP)
+    ;
+
+  /* Starts the operation.*/
+  dp->CR2 |= I2C_CR2_ITEVTEN;
+  if (txbytes > 0)
+    dp->CR1 |= I2C_CR1_START;
+  else
+    dp->CR1 |= I2C_CR1_START | I2C_CR1_ACK;
+}
+
+/**
+ * @brief   Aborts the transaction in progress.
+ * @details The peripheral is reset, the driver must be restarted.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ *
+ * @notapi
+ */
+void i2c_lld_abort_transaction(I2CDriver *i2cp) {
+
+  i2c_lld_abort_operation(i2cp);
+}
+#endif /* I2C_USE_TRANSACTIONS */
+
 #endif /* HAL_USE_I2C */
 
 /** @} */
@@ -40,6 +40,11 @@
  */
 #define I2C_CLK_FREQ  ((STM32_PCLK1) / 1000000)
 
+/**
+ * @brief   This implementation supports the transactions queue.
+ */
+#define I2C_SUPPORTS_TRANSACTIONS   TRUE
+
 /*===========================================================================*/
 /* Driver pre-compile time settings.                                         */
 /*===========================================================================*/
@@ -209,6 +214,10 @@
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
 
+#if I2C_USE_TRANSACTIONS && !I2C_SUPPORTS_TRANSACTIONS
+#error "I2C transactions not supported in this architecture"
+#endif
+
 /** @brief  error checks */
 #if STM32_I2C_USE_I2C1 && !STM32_HAS_I2C1
 #error "I2C1 not present in the selected device"
@@ -374,6 +383,20 @@ struct I2CDriver {
   Semaphore                 semaphore;
 #endif
 #endif /* I2C_USE_MUTUAL_EXCLUSION */
+#if I2C_USE_TRANSACTIONS || defined(__DOXYGEN__)
+  /**
+   * @brief   Transaction being executed.
+   */
+  I2CTransaction            *txncur;
+  /**
+   * @brief   Queued transactions in priority order.
+   */
+  I2CTransaction            *txnqueue;
+  /**
+   * @brief   Transactions timeout timer.
+   */
+  VirtualTimer              txnvt;
+#endif /* I2C_USE_TRANSACTIONS */
 #if defined(I2C_DRIVER_EXT_FIELDS)
   I2C_DRIVER_EXT_FIELDS
 #endif
@@ -452,6 +475,12 @@ extern "C" {
   msg_t i2c_lld_master_receive_timeout(I2CDriver *i2cp, i2caddr_t addr,
                                        uint8_t *rxbuf, size_t rxbytes,
                                        systime_t timeout);
+#if I2C_USE_TRANSACTIONS
+  void i2c_lld_start_transaction(I2CDriver *i2cp, i2caddr_t addr,
+                                 const uint8_t *txbuf, size_t txbytes,
+                                 uint8_t *rxbuf, size_t rxbytes);
+  void i2c_lld_abort_transaction(I2CDriver *i2cp);
+#endif /* I2C_USE_TRANSACTIONS */
 #ifdef __cplusplus
 }
 #endif
@@ -31,6 +31,11 @@
 /* Driver constants.                                                         */
 /*===========================================================================*/
 
+/**
+ * @brief   This implementation supports the transactions queue.
+ */
+#define SPI_SUPPORTS_TRANSACTIONS   TRUE
+
 /*===========================================================================*/
 /* Driver pre-compile time settings.                                         */
 /*===========================================================================*/
@@ -192,6 +197,10 @@
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
 
+#if SPI_USE_TRANSACTIONS && !SPI_SUPPORTS_TRANSACTIONS
+#error "SPI transactions not supported in this architecture"
+#endif
+
 #if STM32_SPI_USE_SPI1 && !STM32_HAS_SPI1
 #error "SPI1 not present in the selected device"
 #endif
@@ -340,6 +349,20 @@ struct SPIDriver{
   Semaphore                 semaphore;
 #endif
 #endif /* SPI_USE_MUTUAL_EXCLUSION */
+#if SPI_USE_TRANSACTIONS || defined(__DOXYGEN__)
+  /**
+   * @brief Transaction being executed.
+   */
+  SPITransaction            *txncur;
+  /**
+   * @brief Queued transactions in priority order.
+   */
+  SPITransaction            *txnqueue;
+  /**
+   * @brief Timer used by the delay segments.
+   */
+  VirtualTimer              txnvt;
+#endif /* SPI_USE_TRANSACTIONS */
 #if defined(SPI_DRIVER_EXT_FIELDS)
   SPI_DRIVER_EXT_FIELDS
 #endif
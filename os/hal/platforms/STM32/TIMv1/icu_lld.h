@@ -158,6 +158,10 @@
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
 
+#if ICU_USE_CAPTURE
+#error "ICU_USE_CAPTURE not supported by this driver"
+#endif
+
 #if STM32_ICU_USE_TIM1 && !STM32_HAS_TIM1
 #error "TIM1 not present in the selected device"
 #endif
@@ -119,6 +119,72 @@ static void can_lld_set_filters(uint32_t can2sb,
   rccDisableCAN1(FALSE);
 }
 
+/**
+ * @brief   Programs a filter bank.
+ *
+ * @param[in] bank      filter bank number
+ * @param[in] scale     filter scale, 0=16 bits, 1=32 bits
+ * @param[in] fifo      receive FIFO assigned to the bank
+ * @param[in] fr1       filter register 1 value
+ * @param[in] fr2       filter register 2 value
+ *
+ * @notapi
+ */
+static void can_lld_set_bank(uint32_t bank, uint32_t scale, uint32_t fifo,
+                             uint32_t fr1, uint32_t fr2) {
+  uint32_t fmask = 1 << bank;
+
+  /* Mask mode only, the remote frames are accepted as well.*/
+  CAN1->FM1R &= ~fmask;
+  if (scale)
+    CAN1->FS1R |= fmask;
+  else
+    CAN1->FS1R &= ~fmask;
+  if (fifo)
+    CAN1->FFA1R |= fmask;
+  else
+    CAN1->FFA1R &= ~fmask;
+  CAN1->sFilterRegister[bank].FR1 = fr1;
+  CAN1->sFilterRegister[bank].FR2 = fr2;
+  CAN1->FA1R |= fmask;
+}
+
+/**
+ * @brief   Fetches a frame from a receive FIFO and releases it.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ * @param[in] fifo      receive FIFO, 0 or 1
+ * @param[out] crfp     pointer to the buffer where the CAN frame is copied
+ *
+ * @notapi
+ */
+static void can_lld_fetch(CANDriver *canp, uint32_t fifo, CANRxFrame *crfp) {
+  uint32_t rir, rdtr;
+
+  /* Fetches the message.*/
+  rir  = canp->can->sFIFOMailBox[fifo].RIR;
+  rdtr = canp->can->sFIFOMailBox[fifo].RDTR;
+  crfp->data32[0] = canp->can->sFIFOMailBox[fifo].RDLR;
+  crfp->data32[1] = canp->can->sFIFOMailBox[fifo].RDHR;
+
+  /* Releases the mailbox.*/
+  if (fifo == 0)
+    canp->can->RF0R = CAN_RF0R_RFOM0;
+  else
+    canp->can->RF1R = CAN_RF1R_RFOM1;
+
+  /* Decodes the various fields in the RX frame.*/
+  crfp->RTR = (rir & CAN_RI0R_RTR) >> 1;
+  crfp->IDE = (rir & CAN_RI0R_IDE) >> 2;
+  if (crfp->IDE)
+    crfp->EID = rir >> 3;
+  else
+    crfp->SID = rir >> 21;
+  crfp->DLC = rdtr & CAN_RDT0R_DLC;
+  crfp->FMI = (uint8_t)(rdtr >> 8);
+  crfp->TIME = (uint16_t)(rdtr >> 16);
+}
+
 /**
  * @brief   Common TX ISR handler.
  *
@@ -131,9 +197,14 @@ static void can_lld_tx_handler(CANDriver *canp) {
   /* No more events until a message is transmitted.*/
   canp->can->TSR = CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2;
   chSysLockFromIsr();
+#if CAN_USE_QUEUES
+  /* Refilling the free mailboxes from the transmit queue.*/
+  can_lld_start_transmit(canp);
+#else
   while (chSemGetCounterI(&canp->txsem) < 0)
     chSemSignalI(&canp->txsem);
   chEvtBroadcastFlagsI(&canp->txempty_event, CAN_MAILBOX_TO_MASK(1));
+#endif
   chSysUnlockFromIsr();
 }
 
@@ -149,6 +220,17 @@ static void can_lld_rx0_handler(CANDriver *canp) {
 
   rf0r = canp->can->RF0R;
   if ((rf0r & CAN_RF0R_FMP0) > 0) {
+#if CAN_USE_QUEUES
+    CANRxFrame crf;
+
+    /* All the pending frames are moved in the receive queue.*/
+    do {
+      can_lld_fetch(canp, 0, &crf);
+      chSysLockFromIsr();
+      canIncomingFrameI(canp, &crf);
+      chSysUnlockFromIsr();
+    } while ((canp->can->RF0R & CAN_RF0R_FMP0) > 0);
+#else
     /* No more receive events until the queue 0 has been emptied.*/
     canp->can->IER &= ~CAN_IER_FMPIE0;
     chSysLockFromIsr();
@@ -156,6 +238,7 @@ static void can_lld_rx0_handler(CANDriver *canp) {
       chSemSignalI(&canp->rxsem);
     chEvtBroadcastFlagsI(&canp->rxfull_event, CAN_MAILBOX_TO_MASK(1));
     chSysUnlockFromIsr();
+#endif
   }
   if ((rf0r & CAN_RF0R_FOVR0) > 0) {
     /* Overflow events handling.*/
@@ -178,6 +261,17 @@ static void can_lld_rx1_handler(CANDriver *canp) {
 
   rf1r = canp->can->RF1R;
   if ((rf1r & CAN_RF1R_FMP1) > 0) {
+#if CAN_USE_QUEUES
+    CANRxFrame crf;
+
+    /* All the pending frames are moved in the receive queue.*/
+    do {
+      can_lld_fetch(canp, 1, &crf);
+      chSysLockFromIsr();
+      canIncomingFrameI(canp, &crf);
+      chSysUnlockFromIsr();
+    } while ((canp->can->RF1R & CAN_RF1R_FMP1) > 0);
+#else
     /* No more receive events until the queue 0 has been emptied.*/
     canp->can->IER &= ~CAN_IER_FMPIE1;
     chSysLockFromIsr();
@@ -185,6 +279,7 @@ static void can_lld_rx1_handler(CANDriver *canp) {
       chSemSignalI(&canp->rxsem);
     chEvtBroadcastFlagsI(&canp->rxfull_event, CAN_MAILBOX_TO_MASK(2));
     chSysUnlockFromIsr();
+#endif
   }
   if ((rf1r & CAN_RF1R_FOVR1) > 0) {
     /* Overflow events handling.*/
@@ -598,7 +693,6 @@ bool_t can_lld_is_rx_nonempty(CANDriver *canp, canmbx_t mailbox) {
 void can_lld_receive(CANDriver *canp,
                      canmbx_t mailbox,
                      CANRxFrame *crfp) {
-  uint32_t rir, rdtr;
 
   if (mailbox == CAN_ANY_MAILBOX) {
     if ((canp->can->RF0R & CAN_RF0R_FMP0) != 0)
@@ -612,14 +706,7 @@ void can_lld_receive(CANDriver *canp,
   }
   switch (mailbox) {
   case 1:
-    /* Fetches the message.*/
-    rir  = canp->can->sFIFOMailBox[0].RIR;
-    rdtr = canp->can->sFIFOMailBox[0].RDTR;
-    crfp->data32[0] = canp->can->sFIFOMailBox[0].RDLR;
-    crfp->data32[1] = canp->can->sFIFOMailBox[0].RDHR;
-
-    /* Releases the mailbox.*/
-    canp->can->RF0R = CAN_RF0R_RFOM0;
+    can_lld_fetch(canp, 0, crfp);
 
     /* If the queue is empty re-enables the interrupt in order to generate
        events again.*/
@@ -627,14 +714,7 @@ void can_lld_receive(CANDriver *canp,
       canp->can->IER |= CAN_IER_FMPIE0;
     break;
   case 2:
-    /* Fetches the message.*/
-    rir  = canp->can->sFIFOMailBox[1].RIR;
-    rdtr = canp->can->sFIFOMailBox[1].RDTR;
-    crfp->data32[0] = canp->can->sFIFOMailBox[1].RDLR;
-    crfp->data32[1] = canp->can->sFIFOMailBox[1].RDHR;
-
-    /* Releases the mailbox.*/
-    canp->can->RF1R = CAN_RF1R_RFOM1;
+    can_lld_fetch(canp, 1, crfp);
 
     /* If the queue is empty re-enables the interrupt in order to generate
        events again.*/
@@ -645,18 +725,127 @@ void can_lld_receive(CANDriver *canp,
     /* Should not happen, do nothing.*/
     return;
   }
+}
+
+/**
+ * @brief   Programs the identifier filters.
+ * @details Standard identifier filters are packed two per bank in 16 bits
+ *          mask mode, extended identifier filters take a bank each in
+ *          32 bits mask mode. The banks are alternatively assigned to the
+ *          two receive FIFOs. CAN1 uses the banks below the CAN2 start
+ *          bank, CAN2 the remaining ones.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ * @param[in] cifp      pointer to the filters table
+ * @param[in] n         number of entries in the filters table
+ * @return              The operation status.
+ * @retval CH_SUCCESS   the filters have been programmed.
+ * @retval CH_FAILED    not enough filter banks.
+ *
+ * @notapi
+ */
+bool_t can_lld_set_id_filters(CANDriver *canp,
+                              const CANIdFilter *cifp,
+                              size_t n) {
+  uint32_t first, last, bank, need, nstd, fr1 = 0;
+  bool_t pending;
+  size_t i;
+
+  nstd = 0;
+  for (i = 0; i < n; i++)
+    if (cifp[i].ide == CAN_IDE_STD)
+      nstd++;
+  need = (n == 0) ? 1 : (nstd + 1) / 2 + ((uint32_t)n - nstd);
+
+  /* Temporarily enabling CAN1 clock if required, the filters belong
+     to CAN1.*/
+  if (CAND1.state == CAN_STOP)
+    rccEnableCAN1(FALSE);
+  first = 0;
+#if STM32_HAS_CAN2
+  last = (CAN1->FMR >> 8) & 0x3F;
+#else
+  last = STM32_CAN_MAX_FILTERS;
+#endif
+#if STM32_CAN_USE_CAN2
+  if (&CAND2 == canp) {
+    first = last;
+    last = STM32_CAN_MAX_FILTERS;
+  }
+#else
+  (void)canp;
+#endif
+  if (need > last - first) {
+    if (CAND1.state == CAN_STOP)
+      rccDisableCAN1(FALSE);
+    return CH_FAILED;
+  }
 
-  /* Decodes the various fields in the RX frame.*/
-  crfp->RTR = (rir & CAN_RI0R_RTR) >> 1;
-  crfp->IDE = (rir & CAN_RI0R_IDE) >> 2;
-  if (crfp->IDE)
-    crfp->EID = rir >> 3;
-  else
-    crfp->SID = rir >> 21;
-  crfp->DLC = rdtr & CAN_RDT0R_DLC;
-  crfp->FMI = (uint8_t)(rdtr >> 8);
-  crfp->TIME = (uint16_t)(rdtr >> 16);
+  /* Banks of this driver deactivated.*/
+  CAN1->FMR |= CAN_FMR_FINIT;
+  CAN1->FA1R &= ~(((1 << last) - 1) & ~((1 << first) - 1));
+
+  bank = first;
+  if (n == 0) {
+    /* Default filter that enables everything.*/
+    can_lld_set_bank(bank, 1, 0, 0, 0);
+  }
+  else {
+    /* Standard identifiers, two per bank, the IDE bit is compared.*/
+    pending = FALSE;
+    for (i = 0; i < n; i++) {
+      uint32_t fr;
+
+      if (cifp[i].ide != CAN_IDE_STD)
+        continue;
+      fr = ((((cifp[i].mask & 0x7FF) << 5) | 8) << 16) |
+           ((cifp[i].id & 0x7FF) << 5);
+      if (!pending)
+        fr1 = fr;
+      else {
+        can_lld_set_bank(bank, 0, (bank - first) & 1, fr1, fr);
+        bank++;
+      }
+      pending = !pending;
+    }
+    if (pending) {
+      can_lld_set_bank(bank, 0, (bank - first) & 1, fr1, fr1);
+      bank++;
+    }
+
+    /* Extended identifiers, one per bank.*/
+    for (i = 0; i < n; i++) {
+      if (cifp[i].ide == CAN_IDE_STD)
+        continue;
+      can_lld_set_bank(bank, 1, (bank - first) & 1,
+                       (cifp[i].id << 3) | CAN_RI0R_IDE,
+                       (cifp[i].mask << 3) | CAN_RI0R_IDE);
+      bank++;
+    }
+  }
+  CAN1->FMR &= ~CAN_FMR_FINIT;
+
+  if (CAND1.state == CAN_STOP)
+    rccDisableCAN1(FALSE);
+  return CH_SUCCESS;
+}
+
+#if CAN_USE_QUEUES || defined(__DOXYGEN__)
+/**
+ * @brief   Moves frames from the transmit queue to the free mailboxes.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ *
+ * @notapi
+ */
+void can_lld_start_transmit(CANDriver *canp) {
+  CANTxFrame ctf;
+
+  while (((canp->can->TSR & CAN_TSR_TME) != 0) &&
+         (canRequestFrameI(canp, &ctf) == Q_OK))
+    can_lld_transmit(canp, CAN_ANY_MAILBOX, &ctf);
 }
+#endif /* CAN_USE_QUEUES */
 
 #if CAN_USE_SLEEP_MODE || defined(__DOXYGEN__)
 /**
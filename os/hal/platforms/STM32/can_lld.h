@@ -46,6 +46,12 @@
  */
 #define CAN_SUPPORTS_SLEEP          TRUE
 
+/**
+ * @brief   This switch defines whether the driver implementation supports
+ *          the software queues.
+ */
+#define CAN_SUPPORTS_QUEUES         TRUE
+
 /**
  * @brief   This implementation supports three transmit mailboxes.
  */
@@ -136,6 +142,10 @@
 #error "CAN sleep mode not supported in this architecture"
 #endif
 
+#if CAN_USE_QUEUES && !CAN_SUPPORTS_QUEUES
+#error "CAN queues not supported in this architecture"
+#endif
+
 /*===========================================================================*/
 /* Driver data structures and types.                                         */
 /*===========================================================================*/
@@ -312,6 +322,32 @@ typedef struct {
    */
   EventSource               wakeup_event;
 #endif /* CAN_USE_SLEEP_MODE */
+#if CAN_USE_QUEUES || defined (__DOXYGEN__)
+  /**
+   * @brief   Receive queue buffer.
+   */
+  CANRxFrame                rxq[CAN_RX_QUEUE_SIZE];
+  /**
+   * @brief   Receive queue read index.
+   */
+  size_t                    rxrd;
+  /**
+   * @brief   Frames in the receive queue.
+   */
+  size_t                    rxcnt;
+  /**
+   * @brief   Transmit queue buffer, ordered by priority.
+   */
+  CANTxFrame                txq[CAN_TX_QUEUE_SIZE];
+  /**
+   * @brief   Arbitration keys of the queued frames.
+   */
+  uint32_t                  txkey[CAN_TX_QUEUE_SIZE];
+  /**
+   * @brief   Frames in the transmit queue.
+   */
+  size_t                    txcnt;
+#endif /* CAN_USE_QUEUES */
   /* End of the mandatory fields.*/
   /**
    * @brief   Pointer to the CAN registers.
@@ -351,6 +387,12 @@ extern "C" {
   void can_lld_receive(CANDriver *canp,
                        canmbx_t mailbox,
                        CANRxFrame *ctfp);
+  bool_t can_lld_set_id_filters(CANDriver *canp,
+                                const CANIdFilter *cifp,
+                                size_t n);
+#if CAN_USE_QUEUES
+  void can_lld_start_transmit(CANDriver *canp);
+#endif /* CAN_USE_QUEUES */
 #if CAN_USE_SLEEP_MODE
   void can_lld_sleep(CANDriver *canp);
   void can_lld_wakeup(CANDriver *canp);
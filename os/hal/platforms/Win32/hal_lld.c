@@ -107,4 +107,14 @@ void ChkIntSources(void) {
   }
 }
 
+/**
+ * @brief   Waits for the next simulated interrupt.
+ * @note    In this implementation it is a polling pass on the simulated
+ *          interrupt sources.
+ */
+void WaitIntSources(void) {
+
+  ChkIntSources();
+}
+
 /** @} */
@@ -63,6 +63,7 @@ extern "C" {
 #endif
   void hal_lld_init(void);
   void ChkIntSources(void);
+  void WaitIntSources(void);
 #ifdef __cplusplus
 }
 #endif
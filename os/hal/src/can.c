@@ -47,6 +47,84 @@
 /* Driver local functions.                                                   */
 /*===========================================================================*/
 
+#if CAN_USE_QUEUES || defined(__DOXYGEN__)
+/**
+ * @brief   Computes the arbitration key of a frame.
+ * @details Lower keys win the bus arbitration: the base identifier is
+ *          compared first, a standard data frame wins against a remote
+ *          frame or an extended frame with the same base identifier.
+ *
+ * @param[in] ctfp      pointer to the CAN frame
+ * @return              The arbitration key.
+ *
+ * @notapi
+ */
+static uint32_t tx_key(const CANTxFrame *ctfp) {
+
+  if (ctfp->IDE)
+    return ((uint32_t)(ctfp->EID >> 18) << 21) | (3U << 19) |
+           ((uint32_t)(ctfp->EID & 0x3FFFF) << 1) | ctfp->RTR;
+  return ((uint32_t)ctfp->SID << 21) | ((uint32_t)ctfp->RTR << 20);
+}
+
+/**
+ * @brief   Inserts a frame in the transmit queue.
+ * @details The queue is ordered by decreasing arbitration key, the next
+ *          frame to be transmitted is the last one. Frames with the same
+ *          key are kept in FIFO order.
+ * @pre     The queue must not be full.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ * @param[in] ctfp      pointer to the CAN frame
+ *
+ * @notapi
+ */
+static void txq_insert(CANDriver *canp, const CANTxFrame *ctfp) {
+  uint32_t key = tx_key(ctfp);
+  size_t i = canp->txcnt;
+
+  while ((i > 0) && (canp->txkey[i - 1] <= key)) {
+    canp->txq[i] = canp->txq[i - 1];
+    canp->txkey[i] = canp->txkey[i - 1];
+    i--;
+  }
+  canp->txq[i] = *ctfp;
+  canp->txkey[i] = key;
+  canp->txcnt++;
+}
+
+/**
+ * @brief   Removes the oldest frame from the receive queue.
+ * @pre     The queue must not be empty.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ * @param[out] crfp     pointer to the buffer where the CAN frame is copied
+ *
+ * @notapi
+ */
+static void rxq_get(CANDriver *canp, CANRxFrame *crfp) {
+
+  *crfp = canp->rxq[canp->rxrd];
+  if (++canp->rxrd >= CAN_RX_QUEUE_SIZE)
+    canp->rxrd = 0;
+  canp->rxcnt--;
+}
+
+/**
+ * @brief   Empties the queues.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ *
+ * @notapi
+ */
+static void queues_reset(CANDriver *canp) {
+
+  canp->rxrd = 0;
+  canp->rxcnt = 0;
+  canp->txcnt = 0;
+}
+#endif /* CAN_USE_QUEUES */
+
 /*===========================================================================*/
 /* Driver exported functions.                                                */
 /*===========================================================================*/
@@ -83,6 +161,9 @@ void canObjectInit(CANDriver *canp) {
   chEvtInit(&canp->sleep_event);
   chEvtInit(&canp->wakeup_event);
 #endif /* CAN_USE_SLEEP_MODE */
+#if CAN_USE_QUEUES
+  queues_reset(canp);
+#endif /* CAN_USE_QUEUES */
 }
 
 /**
@@ -132,6 +213,9 @@ void canStop(CANDriver *canp) {
               "canStop(), #1", "invalid state");
   can_lld_stop(canp);
   canp->state  = CAN_STOP;
+#if CAN_USE_QUEUES
+  queues_reset(canp);
+#endif /* CAN_USE_QUEUES */
   chSemResetI(&canp->rxsem, 0);
   chSemResetI(&canp->txsem, 0);
   chSchRescheduleS();
@@ -143,6 +227,9 @@ void canStop(CANDriver *canp) {
  * @details The specified frame is queued for transmission, if the hardware
  *          queue is full then the invoking thread is queued.
  * @note    Trying to transmit while in sleep mode simply enqueues the thread.
+ * @note    If @p CAN_USE_QUEUES is enabled the frame is inserted in the
+ *          software transmit queue, the invoking thread is queued only if
+ *          the software queue is full.
  *
  * @param[in] canp      pointer to the @p CANDriver object
  * @param[in] mailbox   mailbox number, @p CAN_ANY_MAILBOX for any mailbox
@@ -170,14 +257,25 @@ msg_t canTransmit(CANDriver *canp,
   chSysLock();
   chDbgAssert((canp->state == CAN_READY) || (canp->state == CAN_SLEEP),
               "canTransmit(), #1", "invalid state");
+#if CAN_USE_QUEUES
+  chDbgAssert(mailbox == CAN_ANY_MAILBOX,
+              "canTransmit(), #2", "mailboxes not accessible");
+  while ((canp->state == CAN_SLEEP) || (canp->txcnt >= CAN_TX_QUEUE_SIZE)) {
+#else
   while ((canp->state == CAN_SLEEP) || !can_lld_is_tx_empty(canp, mailbox)) {
+#endif
     msg_t msg = chSemWaitTimeoutS(&canp->txsem, timeout);
     if (msg != RDY_OK) {
       chSysUnlock();
       return msg;
     }
   }
+#if CAN_USE_QUEUES
+  txq_insert(canp, ctfp);
+  can_lld_start_transmit(canp);
+#else
   can_lld_transmit(canp, mailbox, ctfp);
+#endif
   chSysUnlock();
   return RDY_OK;
 }
@@ -186,6 +284,8 @@ msg_t canTransmit(CANDriver *canp,
  * @brief   Can frame receive.
  * @details The function waits until a frame is received.
  * @note    Trying to receive while in sleep mode simply enqueues the thread.
+ * @note    If @p CAN_USE_QUEUES is enabled the frame is taken from the
+ *          software receive queue.
  *
  * @param[in] canp      pointer to the @p CANDriver object
  * @param[in] mailbox   mailbox number, @p CAN_ANY_MAILBOX for any mailbox
@@ -215,18 +315,212 @@ msg_t canReceive(CANDriver *canp,
   chSysLock();
   chDbgAssert((canp->state == CAN_READY) || (canp->state == CAN_SLEEP),
               "canReceive(), #1", "invalid state");
+#if CAN_USE_QUEUES
+  chDbgAssert(mailbox == CAN_ANY_MAILBOX,
+              "canReceive(), #2", "mailboxes not accessible");
+  while ((canp->state == CAN_SLEEP) || (canp->rxcnt == 0)) {
+#else
   while ((canp->state == CAN_SLEEP) || !can_lld_is_rx_nonempty(canp, mailbox)) {
+#endif
     msg_t msg = chSemWaitTimeoutS(&canp->rxsem, timeout);
     if (msg != RDY_OK) {
       chSysUnlock();
       return msg;
     }
   }
+#if CAN_USE_QUEUES
+  rxq_get(canp, crfp);
+#else
   can_lld_receive(canp, mailbox, crfp);
+#endif
   chSysUnlock();
   return RDY_OK;
 }
 
+/**
+ * @brief   Programs the identifier filters.
+ * @details The filters table is compiled by the low level driver into the
+ *          hardware filters, frames not matching any filter are discarded
+ *          by the hardware. An empty table accepts all the frames.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ * @param[in] cifp      pointer to the filters table, can be @p NULL if
+ *                      @p n is zero
+ * @param[in] n         number of entries in the filters table
+ * @return              The operation status.
+ * @retval CH_SUCCESS   the filters have been programmed.
+ * @retval CH_FAILED    the table does not fit in the hardware filters,
+ *                      the previous filters are retained.
+ *
+ * @api
+ */
+bool_t canSetIdFilters(CANDriver *canp, const CANIdFilter *cifp, size_t n) {
+  bool_t result;
+
+  chDbgCheck((canp != NULL) && ((cifp != NULL) || (n == 0)),
+             "canSetIdFilters");
+
+  chSysLock();
+  chDbgAssert((canp->state == CAN_STOP) || (canp->state == CAN_READY),
+              "canSetIdFilters(), #1", "invalid state");
+  result = can_lld_set_id_filters(canp, cifp, n);
+  chSysUnlock();
+  return result;
+}
+
+#if CAN_USE_QUEUES || defined(__DOXYGEN__)
+/**
+ * @brief   Can frames batch transmission.
+ * @details The frames are inserted in the transmit queue, the invoking
+ *          thread is queued when the queue is full and resumed when space
+ *          becomes available.
+ * @pre     In order to use this function the option @p CAN_USE_QUEUES must
+ *          be enabled.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ * @param[in] ctfp      pointer to the array of CAN frames
+ * @param[in] n         number of frames to be transmitted
+ * @param[in] timeout   the number of ticks before each wait timeouts,
+ *                      the following special values are allowed:
+ *                      - @a TIME_IMMEDIATE immediate timeout.
+ *                      - @a TIME_INFINITE no timeout.
+ *                      .
+ * @return              The number of frames queued for transmission, it
+ *                      is less than @p n on timeout or driver stop.
+ *
+ * @api
+ */
+size_t canTransmitBatch(CANDriver *canp,
+                        const CANTxFrame *ctfp,
+                        size_t n,
+                        systime_t timeout) {
+  size_t i = 0;
+
+  chDbgCheck((canp != NULL) && (ctfp != NULL), "canTransmitBatch");
+
+  chSysLock();
+  chDbgAssert((canp->state == CAN_READY) || (canp->state == CAN_SLEEP),
+              "canTransmitBatch(), #1", "invalid state");
+  while (i < n) {
+    while ((canp->state == CAN_SLEEP) ||
+           (canp->txcnt >= CAN_TX_QUEUE_SIZE)) {
+      if (chSemWaitTimeoutS(&canp->txsem, timeout) != RDY_OK) {
+        chSysUnlock();
+        return i;
+      }
+    }
+    while ((i < n) && (canp->txcnt < CAN_TX_QUEUE_SIZE))
+      txq_insert(canp, &ctfp[i++]);
+    can_lld_start_transmit(canp);
+  }
+  chSysUnlock();
+  return i;
+}
+
+/**
+ * @brief   Can frames batch receive.
+ * @details The function waits until at least a frame is received then
+ *          returns all the frames available in the receive queue, up to
+ *          @p n.
+ * @pre     In order to use this function the option @p CAN_USE_QUEUES must
+ *          be enabled.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ * @param[out] crfp     pointer to the array receiving the CAN frames
+ * @param[in] n         maximum number of frames to be received
+ * @param[in] timeout   the number of ticks before the operation timeouts,
+ *                      the following special values are allowed:
+ *                      - @a TIME_IMMEDIATE immediate timeout.
+ *                      - @a TIME_INFINITE no timeout.
+ *                      .
+ * @return              The number of frames received, zero on timeout or
+ *                      driver stop.
+ *
+ * @api
+ */
+size_t canReceiveBatch(CANDriver *canp,
+                       CANRxFrame *crfp,
+                       size_t n,
+                       systime_t timeout) {
+  size_t i;
+
+  chDbgCheck((canp != NULL) && (crfp != NULL), "canReceiveBatch");
+
+  chSysLock();
+  chDbgAssert((canp->state == CAN_READY) || (canp->state == CAN_SLEEP),
+              "canReceiveBatch(), #1", "invalid state");
+  while ((canp->state == CAN_SLEEP) || (canp->rxcnt == 0)) {
+    if (chSemWaitTimeoutS(&canp->rxsem, timeout) != RDY_OK) {
+      chSysUnlock();
+      return 0;
+    }
+  }
+  for (i = 0; (i < n) && (canp->rxcnt > 0); i++)
+    rxq_get(canp, &crfp[i]);
+  chSysUnlock();
+  return i;
+}
+
+/**
+ * @brief   Handles an incoming frame.
+ * @details This function must be called from the receive ISR of the low
+ *          level driver for each frame moved out of the hardware.
+ * @note    If the receive queue is full the frame is discarded and an
+ *          overflow error is reported on @p error_event.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ * @param[in] crfp      pointer to the received frame
+ *
+ * @iclass
+ */
+void canIncomingFrameI(CANDriver *canp, const CANRxFrame *crfp) {
+  size_t wr;
+
+  chDbgCheckClassI();
+
+  if (canp->rxcnt >= CAN_RX_QUEUE_SIZE) {
+    chEvtBroadcastFlagsI(&canp->error_event, CAN_OVERFLOW_ERROR);
+    return;
+  }
+  wr = canp->rxrd + canp->rxcnt;
+  if (wr >= CAN_RX_QUEUE_SIZE)
+    wr -= CAN_RX_QUEUE_SIZE;
+  canp->rxq[wr] = *crfp;
+  if (canp->rxcnt++ == 0)
+    chEvtBroadcastFlagsI(&canp->rxfull_event, CAN_MAILBOX_TO_MASK(1));
+  while (chSemGetCounterI(&canp->rxsem) < 0)
+    chSemSignalI(&canp->rxsem);
+}
+
+/**
+ * @brief   Handles a transmit request.
+ * @details This function must be called from the transmit ISR of the low
+ *          level driver, and from @p can_lld_start_transmit(), for each
+ *          free hardware mailbox. The frame with the highest priority is
+ *          removed from the transmit queue.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ * @param[out] ctfp     pointer to the buffer where the CAN frame is copied
+ * @return              The operation status.
+ * @retval Q_OK         a frame has been copied.
+ * @retval Q_EMPTY      the transmit queue is empty.
+ *
+ * @iclass
+ */
+msg_t canRequestFrameI(CANDriver *canp, CANTxFrame *ctfp) {
+
+  chDbgCheckClassI();
+
+  if (canp->txcnt == 0)
+    return Q_EMPTY;
+  *ctfp = canp->txq[--canp->txcnt];
+  chEvtBroadcastFlagsI(&canp->txempty_event, CAN_MAILBOX_TO_MASK(1));
+  while (chSemGetCounterI(&canp->txsem) < 0)
+    chSemSignalI(&canp->txsem);
+  return Q_OK;
+}
+#endif /* CAN_USE_QUEUES */
+
 #if CAN_USE_SLEEP_MODE || defined(__DOXYGEN__)
 /**
  * @brief   Enters the sleep mode.
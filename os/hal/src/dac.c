@@ -26,6 +26,8 @@
  * @{
  */
 
+#include <string.h>
+
 #include "ch.h"
 #include "hal.h"
 
@@ -35,6 +37,11 @@
 /* Driver local definitions.                                                 */
 /*===========================================================================*/
 
+/**
+ * @brief   Checks if the conversion has been stopped by an error.
+ */
+#define stream_broken(dacp) ((dacp)->strstarted && ((dacp)->grpp == NULL))
+
 /*===========================================================================*/
 /* Driver exported variables.                                                */
 /*===========================================================================*/
@@ -47,6 +54,143 @@
 /* Driver local functions.                                                   */
 /*===========================================================================*/
 
+#if DAC_USE_STREAMING || defined(__DOXYGEN__)
+/**
+ * @brief   Converts samples in the stream format.
+ * @details The samples are first converted to unsigned left aligned 32 bits
+ *          values then shifted to the converter resolution.
+ *
+ * @param[in] config    the stream configuration
+ * @param[out] dp       destination samples
+ * @param[in] sp        source samples
+ * @param[in] n         number of samples
+ */
+static void stream_convert(const DACStreamConfig *config, dacsample_t *dp,
+                           const void *sp, size_t n) {
+  unsigned shift = 32 - config->bits;
+  uint32_t v;
+
+  while (n-- > 0) {
+    switch (config->format) {
+    case DAC_FMT_U8:
+      v = (uint32_t)*(const uint8_t *)sp << 24;
+      sp = (const uint8_t *)sp + 1;
+      break;
+    case DAC_FMT_S16:
+      v = (uint32_t)(uint16_t)(*(const int16_t *)sp ^ 0x8000) << 16;
+      sp = (const int16_t *)sp + 1;
+      break;
+    case DAC_FMT_U16:
+      v = (uint32_t)*(const uint16_t *)sp << 16;
+      sp = (const uint16_t *)sp + 1;
+      break;
+    case DAC_FMT_S32:
+      v = (uint32_t)*(const int32_t *)sp ^ 0x80000000U;
+      sp = (const int32_t *)sp + 1;
+      break;
+    default:
+      *dp++ = *(const dacsample_t *)sp;
+      sp = (const dacsample_t *)sp + 1;
+      continue;
+    }
+    *dp++ = (dacsample_t)(v >> shift);
+  }
+}
+
+/**
+ * @brief   Copies rows from the ring into the conversion buffer.
+ * @note    The ring pointers are not updated.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object
+ * @param[out] dp       destination in the conversion buffer
+ * @param[in] n         number of rows to be copied
+ */
+static void stream_copy(DACDriver *dacp, dacsample_t *dp, size_t n) {
+  const DACStreamConfig *config = dacp->strcfg;
+  size_t nch = config->grpp->num_channels;
+  size_t rd = dacp->strrd, chunk;
+
+  while (n > 0) {
+    chunk = config->size - rd < n ? config->size - rd : n;
+    memcpy(dp, config->ring + rd * nch, chunk * nch * sizeof (dacsample_t));
+    dp += chunk * nch;
+    n -= chunk;
+    rd = 0;
+  }
+}
+
+/**
+ * @brief   Fills rows with the idle sample.
+ *
+ * @param[in] config    the stream configuration
+ * @param[out] dp       destination in the conversion buffer
+ * @param[in] n         number of rows
+ */
+static void stream_idle(const DACStreamConfig *config, dacsample_t *dp,
+                        size_t n) {
+
+  n *= config->grpp->num_channels;
+  while (n-- > 0)
+    *dp++ = config->idle;
+}
+
+/**
+ * @brief   Fills the conversion buffer and starts the conversion.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object
+ *
+ * @notapi
+ */
+static void stream_begin_s(DACDriver *dacp) {
+  const DACStreamConfig *config = dacp->strcfg;
+  size_t n = dacp->strcount < config->depth ? dacp->strcount : config->depth;
+
+  stream_copy(dacp, config->buffer, n);
+  stream_idle(config, config->buffer + n * config->grpp->num_channels,
+              config->depth - n);
+  dacp->strrd = (dacp->strrd + n) % config->size;
+  dacp->strcount -= n;
+  dacp->strstarted = TRUE;
+  dacStartConversionI(dacp, config->grpp, config->buffer, config->depth);
+}
+
+/**
+ * @brief   Waits for a refill of the conversion buffer.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object
+ * @param[in] timeout   the number of ticks before the operation timeouts
+ * @return              The wakeup message.
+ *
+ * @notapi
+ */
+static msg_t stream_wait_s(DACDriver *dacp, systime_t timeout) {
+  msg_t msg;
+
+  dacp->strthread = chThdSelf();
+  msg = chSchGoSleepTimeoutS(THD_STATE_SUSPENDED, timeout);
+  dacp->strthread = NULL;
+  return msg;
+}
+
+/**
+ * @brief   Wakes up the producer thread, if any.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object
+ * @param[in] msg       the wakeup message
+ *
+ * @notapi
+ */
+static void stream_wakeup_i(DACDriver *dacp, msg_t msg) {
+
+  if (dacp->strthread != NULL) {
+    Thread *tp = dacp->strthread;
+    dacp->strthread = NULL;
+    tp->p_u.rdymsg = msg;
+    chSchReadyI(tp);
+  }
+}
+#endif /* DAC_USE_STREAMING */
+
 /*===========================================================================*/
 /* Driver exported functions.                                                */
 /*===========================================================================*/
@@ -84,6 +228,11 @@ void dacObjectInit(DACDriver *dacp) {
   chSemInit(&dacp->semaphore, 1);
 #endif
 #endif /* DAC_USE_MUTUAL_EXCLUSION */
+#if DAC_USE_STREAMING
+  dacp->strcfg = NULL;
+  dacp->strthread = NULL;
+  chEvtInit(&dacp->strevent);
+#endif /* DAC_USE_STREAMING */
 #if defined(DAC_DRIVER_EXT_INIT_HOOK)
   DAC_DRIVER_EXT_INIT_HOOK(dacp);
 #endif
@@ -335,6 +484,295 @@ void dacReleaseBus(DACDriver *dacp) {
 }
 #endif /* DAC_USE_MUTUAL_EXCLUSION */
 
+#if DAC_USE_STREAMING || defined(__DOXYGEN__)
+/**
+ * @brief   Opens a stream.
+ * @details The conversion is started by @p dacWriteStream() when the ring
+ *          contains enough rows for filling the whole conversion buffer,
+ *          or by @p dacDrainStream().
+ * @note    Listeners can be registered on the @p strevent event source of
+ *          the driver in order to receive the @p DAC_STREAM_UNDERRUN,
+ *          @p DAC_STREAM_LOW_WATER and @p DAC_STREAM_ERROR flags.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object
+ * @param[in] config    pointer to the @p DACStreamConfig object
+ *
+ * @api
+ */
+void dacStartStream(DACDriver *dacp, const DACStreamConfig *config) {
+
+  chDbgCheck((dacp != NULL) && (config != NULL) &&
+             (config->grpp != NULL) && config->grpp->circular &&
+             (config->buffer != NULL) && (config->depth >= 2) &&
+             ((config->depth & 1) == 0) && (config->ring != NULL) &&
+             (config->size >= config->depth) &&
+             (config->bits >= 1) && (config->bits <= 16),
+             "dacStartStream");
+
+  chSysLock();
+  chDbgAssert((dacp->state == DAC_READY) && (dacp->strcfg == NULL),
+              "dacStartStream(), #1", "invalid state");
+  dacp->strcfg      = config;
+  dacp->strrd       = 0;
+  dacp->strcount    = 0;
+  dacp->strstarted  = FALSE;
+  dacp->strdraining = FALSE;
+  dacp->strhalves   = 0;
+  dacp->strstats.written   = 0;
+  dacp->strstats.underruns = 0;
+  dacp->strstats.idle      = 0;
+  dacp->strstats.min_level = config->size;
+  chSysUnlock();
+}
+
+/**
+ * @brief   Closes a stream.
+ * @details The conversion is stopped immediately, a producer thread
+ *          waiting for space is released.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object
+ *
+ * @api
+ */
+void dacStopStream(DACDriver *dacp) {
+  Thread *tp;
+
+  chDbgCheck(dacp != NULL, "dacStopStream");
+
+  chSysLock();
+  chDbgAssert(dacp->strcfg != NULL, "dacStopStream(), #1", "not streaming");
+  if (dacp->strstarted && (dacp->state != DAC_READY)) {
+    dac_lld_stop_conversion(dacp);
+    dacp->grpp  = NULL;
+    dacp->state = DAC_READY;
+  }
+  dacp->strcfg = NULL;
+  tp = dacp->strthread;
+  if (tp != NULL) {
+    dacp->strthread = NULL;
+    chSchWakeupS(tp, RDY_RESET);
+  }
+  chSysUnlock();
+}
+
+/**
+ * @brief   Writes samples into a stream.
+ * @details The samples are converted from the configured format and copied
+ *          into the ring, the function waits for space when the ring is
+ *          full.
+ * @note    Only one thread at time can write into a stream.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object
+ * @param[in] buf       samples in the configured format, @p n rows of
+ *                      @p num_channels samples
+ * @param[in] n         number of rows
+ * @param[in] timeout   the number of ticks before the operation timeouts,
+ *                      the timeout is applied to each wait for space, the
+ *                      following special values are allowed:
+ *                      - @a TIME_IMMEDIATE immediate timeout.
+ *                      - @a TIME_INFINITE no timeout.
+ *                      .
+ * @return              The number of rows effectively written, less than
+ *                      @p n on timeout, stream stop or conversion error.
+ *
+ * @api
+ */
+size_t dacWriteStream(DACDriver *dacp, const void *buf, size_t n,
+                      systime_t timeout) {
+  const DACStreamConfig *config = dacp->strcfg;
+  size_t nch, ssize, wr, chunk, done = 0;
+
+  chDbgCheck((dacp != NULL) && (config != NULL) && (buf != NULL),
+             "dacWriteStream");
+
+  nch = config->grpp->num_channels;
+  switch (config->format) {
+  case DAC_FMT_U8:
+    ssize = 1;
+    break;
+  case DAC_FMT_S16:
+  case DAC_FMT_U16:
+    ssize = 2;
+    break;
+  case DAC_FMT_S32:
+    ssize = 4;
+    break;
+  default:
+    ssize = sizeof (dacsample_t);
+  }
+
+  chSysLock();
+  dacp->strdraining = FALSE;
+  while (n > 0) {
+    if ((dacp->strcfg != config) || stream_broken(dacp))
+      break;
+    if (dacp->strcount >= config->size) {
+      if (stream_wait_s(dacp, timeout) != RDY_OK)
+        break;
+      continue;
+    }
+    wr = (dacp->strrd + dacp->strcount) % config->size;
+    chunk = config->size - dacp->strcount;
+    if (chunk > config->size - wr)
+      chunk = config->size - wr;
+    if (chunk > n)
+      chunk = n;
+    chSysUnlock();
+
+    /* The space after the ring content is not touched by the ISR, the
+       conversion happens outside the critical zone.*/
+    stream_convert(config, config->ring + wr * nch, buf, chunk * nch);
+    buf = (const uint8_t *)buf + chunk * nch * ssize;
+
+    chSysLock();
+    if (dacp->strcfg != config)
+      break;
+    dacp->strcount += chunk;
+    dacp->strstats.written += chunk;
+    done += chunk;
+    n -= chunk;
+    if (!dacp->strstarted && (dacp->strcount >= config->depth))
+      stream_begin_s(dacp);
+  }
+  chSysUnlock();
+  return done;
+}
+
+/**
+ * @brief   Waits for the stream content to be output.
+ * @details The conversion is started if not yet running, the function
+ *          returns after the last written row has been output. The
+ *          conversion goes on outputting idle rows, not counted as
+ *          underruns until the next write.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object
+ * @param[in] timeout   the number of ticks before the operation timeouts,
+ *                      the timeout is applied to each wait for a refill,
+ *                      the following special values are allowed:
+ *                      - @a TIME_IMMEDIATE immediate timeout.
+ *                      - @a TIME_INFINITE no timeout.
+ *                      .
+ * @return              The operation result.
+ * @retval RDY_OK       the stream has been drained.
+ * @retval RDY_TIMEOUT  timeout.
+ * @retval RDY_RESET    the stream has been stopped or the conversion
+ *                      stopped by an error.
+ *
+ * @api
+ */
+msg_t dacDrainStream(DACDriver *dacp, systime_t timeout) {
+  msg_t msg = RDY_OK;
+  uint32_t last;
+
+  chDbgCheck((dacp != NULL) && (dacp->strcfg != NULL), "dacDrainStream");
+
+  chSysLock();
+  dacp->strdraining = TRUE;
+  if (!dacp->strstarted) {
+    if (dacp->strcount == 0) {
+      chSysUnlock();
+      return RDY_OK;
+    }
+    stream_begin_s(dacp);
+  }
+  /* The rows moved into the conversion buffer by the last refill are
+     output within the two following half buffer events.*/
+  while ((msg == RDY_OK) && (dacp->strcount > 0))
+    msg = stream_broken(dacp) ? RDY_RESET : stream_wait_s(dacp, timeout);
+  last = dacp->strhalves + 2;
+  while ((msg == RDY_OK) && ((int32_t)(dacp->strhalves - last) < 0))
+    msg = stream_broken(dacp) ? RDY_RESET : stream_wait_s(dacp, timeout);
+  if (dacp->strcfg == NULL)
+    msg = RDY_RESET;
+  chSysUnlock();
+  return msg;
+}
+
+/**
+ * @brief   Returns the stream statistics.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object
+ * @param[out] dssp     pointer to a @p DACStreamStats structure
+ *
+ * @api
+ */
+void dacGetStreamStats(DACDriver *dacp, DACStreamStats *dssp) {
+
+  chDbgCheck((dacp != NULL) && (dssp != NULL), "dacGetStreamStats");
+
+  chSysLock();
+  *dssp = dacp->strstats;
+  chSysUnlock();
+}
+
+/**
+ * @brief   Stream refill code.
+ * @details Refills the half of the conversion buffer just output with the
+ *          ring content, the missing rows are replaced by idle rows.
+ * @note    This function is meant to be invoked by the common ISR code
+ *          only.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object
+ * @param[in] offset    first row of the half buffer
+ * @param[in] n         number of rows of the half buffer
+ *
+ * @notapi
+ */
+void _dac_stream_isr(DACDriver *dacp, size_t offset, size_t n) {
+  const DACStreamConfig *config = dacp->strcfg;
+  dacsample_t *dp = config->buffer + offset * config->grpp->num_channels;
+  size_t avail;
+  flagsmask_t flags = 0;
+
+  /* The ring content is only appended by the producer, it can be copied
+     outside the critical zone.*/
+  chSysLockFromIsr();
+  avail = dacp->strcount < n ? dacp->strcount : n;
+  chSysUnlockFromIsr();
+  stream_copy(dacp, dp, avail);
+  if (avail < n)
+    stream_idle(config, dp + avail * config->grpp->num_channels, n - avail);
+
+  chSysLockFromIsr();
+  dacp->strrd = (dacp->strrd + avail) % config->size;
+  dacp->strcount -= avail;
+  dacp->strhalves++;
+  if (!dacp->strdraining) {
+    if (avail < n) {
+      dacp->strstats.underruns++;
+      dacp->strstats.idle += (uint32_t)(n - avail);
+      flags |= DAC_STREAM_UNDERRUN;
+    }
+    if ((dacp->strcount < config->low_water) &&
+        (dacp->strcount + avail >= config->low_water))
+      flags |= DAC_STREAM_LOW_WATER;
+    if (dacp->strcount < dacp->strstats.min_level)
+      dacp->strstats.min_level = dacp->strcount;
+  }
+  if (flags != 0)
+    chEvtBroadcastFlagsI(&dacp->strevent, flags);
+  stream_wakeup_i(dacp, RDY_OK);
+  chSysUnlockFromIsr();
+}
+
+/**
+ * @brief   Stream error code.
+ * @note    This function is meant to be invoked by the common ISR code
+ *          only.
+ *
+ * @param[in] dacp      pointer to the @p DACDriver object
+ *
+ * @notapi
+ */
+void _dac_stream_error_isr(DACDriver *dacp) {
+
+  chSysLockFromIsr();
+  chEvtBroadcastFlagsI(&dacp->strevent, DAC_STREAM_ERROR);
+  stream_wakeup_i(dacp, RDY_RESET);
+  chSysUnlockFromIsr();
+}
+#endif /* DAC_USE_STREAMING */
+
 #endif /* HAL_USE_DAC */
 
 /** @} */
@@ -0,0 +1,810 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006,2007,2008,2009,2010,
+                 2011,2012,2013 Giovanni Di Sirio.
+
+    This file is part of ChibiOS/RT.
+
+    ChibiOS/RT is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    ChibiOS/RT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file    ftl.c
+ * @brief   Log-structured flash translation layer code.
+ *
+ * @addtogroup FTL
+ * @{
+ */
+
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#if HAL_USE_FTL || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/**
+ * @name    Header words offsets
+ * @{
+ */
+#define HDR_MAGIC                   0
+#define HDR_ERASE                   1
+#define HDR_ERASE_CHECK             2
+#define HDR_SEQ                     3
+#define HDR_SEQ_CHECK               4
+/** @} */
+
+/**
+ * @name    Tag decoding results
+ * @{
+ */
+#define TAG_BLANK                   0
+#define TAG_VALID                   1
+#define TAG_CORRUPT                 2
+/** @} */
+
+/**
+ * @brief   Erased 32 bits word.
+ */
+#define ERASED_WORD                 0xFFFFFFFF
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/* Forward declarations required by ftl_vmt.*/
+static bool_t ftl_is_inserted(void *instance);
+static bool_t ftl_is_protected(void *instance);
+
+/**
+ * @brief   Virtual methods table.
+ */
+static const struct FTLDriverVMT ftl_vmt = {
+  ftl_is_inserted,
+  ftl_is_protected,
+  (bool_t (*)(void *))ftlConnect,
+  (bool_t (*)(void *))ftlDisconnect,
+  (bool_t (*)(void *, uint32_t, uint8_t *, uint32_t))ftlRead,
+  (bool_t (*)(void *, uint32_t, const uint8_t *, uint32_t))ftlWrite,
+  (bool_t (*)(void *))ftlSync,
+  (bool_t (*)(void *, BlockDeviceInfo *))ftlGetInfo
+};
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static bool_t ftl_is_inserted(void *instance) {
+
+  (void)instance;
+  return TRUE;
+}
+
+static bool_t ftl_is_protected(void *instance) {
+
+  (void)instance;
+  return FALSE;
+}
+
+/**
+ * @brief   Returns the flash offset of a sector.
+ */
+static uint32_t sector_offset(FTLDriver *ftlp, uint32_t sector) {
+
+  return sector * ftlp->info.sector_size;
+}
+
+/**
+ * @brief   Returns the flash offset of a physical data page.
+ */
+static uint32_t page_offset(FTLDriver *ftlp, uint32_t phys) {
+
+  return sector_offset(ftlp, phys / ftlp->data_pages) +
+         (ftlp->summary_pages + phys % ftlp->data_pages) *
+         ftlp->info.page_size;
+}
+
+/**
+ * @brief   Returns the flash offset of a data page tag.
+ */
+static uint32_t tag_offset(FTLDriver *ftlp, uint32_t sector, uint32_t page) {
+
+  return sector_offset(ftlp, sector) + FTL_HEADER_SIZE + page * FTL_TAG_SIZE;
+}
+
+/**
+ * @brief   Programs a range of bytes splitting it on page boundaries.
+ */
+static bool_t program(FTLDriver *ftlp, uint32_t offset,
+                      const uint8_t *buffer, size_t n) {
+  BaseFlash *flashp = ftlp->config->flashp;
+
+  while (n > 0) {
+    size_t chunk = ftlp->info.page_size - offset % ftlp->info.page_size;
+    if (chunk > n)
+      chunk = n;
+    if (flashProgram(flashp, offset, buffer, chunk))
+      return CH_FAILED;
+    offset += chunk;
+    buffer += chunk;
+    n -= chunk;
+  }
+  return CH_SUCCESS;
+}
+
+/**
+ * @brief   Reads and decodes a data page tag.
+ */
+static unsigned read_tag(FTLDriver *ftlp, uint32_t sector, uint32_t page,
+                         uint32_t *lbap) {
+  uint32_t tag[2];
+
+  if (flashRead(ftlp->config->flashp, tag_offset(ftlp, sector, page),
+                (uint8_t *)tag, sizeof(tag)))
+    return TAG_CORRUPT;
+  if ((tag[0] == ERASED_WORD) && (tag[1] == ERASED_WORD))
+    return TAG_BLANK;
+  if ((tag[1] != ~tag[0]) || (tag[0] >= ftlp->blocks_num))
+    return TAG_CORRUPT;
+  *lbap = tag[0];
+  return TAG_VALID;
+}
+
+/**
+ * @brief   Verifies that a data page is still in the erased state.
+ */
+static bool_t page_is_blank(FTLDriver *ftlp, uint32_t phys) {
+  uint8_t *p = ftlp->config->buffer;
+  uint32_t i;
+
+  if (flashRead(ftlp->config->flashp, page_offset(ftlp, phys),
+                p, ftlp->info.page_size))
+    return FALSE;
+  for (i = 0; i < ftlp->info.page_size; i++)
+    if (p[i] != FLASH_ERASED_VALUE)
+      return FALSE;
+  return TRUE;
+}
+
+/**
+ * @brief   Erases a sector and writes its formatted header.
+ * @details The header is invalidated before erasing so that an interrupted
+ *          erase can never expose stale tags on the next mount.
+ */
+static bool_t format_sector(FTLDriver *ftlp, uint32_t sector) {
+  ftl_sector_t *sp = &ftlp->config->sectors[sector];
+  uint32_t hdr[3];
+
+  if (sp->state == FTL_SECTOR_USED) {
+    hdr[0] = 0;
+    (void)program(ftlp, sector_offset(ftlp, sector), (uint8_t *)hdr,
+                  sizeof(uint32_t));
+  }
+  sp->state = FTL_SECTOR_DIRTY;
+  sp->seq = 0;
+  sp->valid = 0;
+  if (flashErase(ftlp->config->flashp, sector))
+    return CH_FAILED;
+  ftlp->erases++;
+  sp->erase_count++;
+  hdr[HDR_MAGIC] = FTL_MAGIC;
+  hdr[HDR_ERASE] = sp->erase_count;
+  hdr[HDR_ERASE_CHECK] = ~sp->erase_count;
+  if (program(ftlp, sector_offset(ftlp, sector), (uint8_t *)hdr,
+              sizeof(hdr)))
+    return CH_FAILED;
+  sp->state = FTL_SECTOR_FREE;
+  ftlp->free_sectors++;
+  return CH_SUCCESS;
+}
+
+/**
+ * @brief   Opens the least worn free sector as the new head.
+ */
+static bool_t open_sector(FTLDriver *ftlp) {
+  ftl_sector_t *sectors = ftlp->config->sectors;
+  uint32_t s, sector = FTL_UNMAPPED, seq[2];
+
+  for (s = 0; s < ftlp->info.sectors_num; s++) {
+    if ((sectors[s].state == FTL_SECTOR_FREE) &&
+        ((sector == FTL_UNMAPPED) ||
+         (sectors[s].erase_count < sectors[sector].erase_count)))
+      sector = s;
+  }
+  if (sector == FTL_UNMAPPED)
+    return CH_FAILED;
+
+  seq[0] = ++ftlp->seq;
+  seq[1] = ~seq[0];
+  ftlp->free_sectors--;
+  sectors[sector].state = FTL_SECTOR_USED;
+  sectors[sector].seq = seq[0];
+  ftlp->head = sector;
+  ftlp->next = 0;
+  return program(ftlp, sector_offset(ftlp, sector) +
+                       HDR_SEQ * sizeof(uint32_t),
+                 (uint8_t *)seq, sizeof(seq));
+}
+
+/**
+ * @brief   Updates the map after @p n pages have been committed.
+ */
+static void commit(FTLDriver *ftlp, uint32_t lba, uint32_t phys, uint32_t n) {
+  ftl_sector_t *sectors = ftlp->config->sectors;
+  uint32_t *map = ftlp->config->map;
+
+  while (n > 0) {
+    if (map[lba] != FTL_UNMAPPED)
+      sectors[map[lba] / ftlp->data_pages].valid--;
+    map[lba] = phys;
+    sectors[phys / ftlp->data_pages].valid++;
+    lba++;
+    phys++;
+    n--;
+  }
+}
+
+/**
+ * @brief   Appends a run of pages at the head position.
+ * @details Data is programmed first and tags last, a tag is the commit
+ *          record of its page. The run must fit the head sector.
+ */
+static bool_t append(FTLDriver *ftlp, uint32_t lba,
+                     const uint8_t *buffer, uint32_t n) {
+  uint32_t *tags = (uint32_t *)ftlp->config->buffer;
+  uint32_t i, phys = ftlp->head * ftlp->data_pages + ftlp->next;
+
+  if (program(ftlp, page_offset(ftlp, phys), buffer,
+              n * ftlp->info.page_size))
+    return CH_FAILED;
+  for (i = 0; i < n; i++) {
+    tags[i * 2] = lba + i;
+    tags[i * 2 + 1] = ~(lba + i);
+  }
+  ftlp->next += n;
+  if (program(ftlp, tag_offset(ftlp, ftlp->head, phys % ftlp->data_pages),
+              (uint8_t *)tags, n * FTL_TAG_SIZE))
+    return CH_FAILED;
+  commit(ftlp, lba, phys, n);
+  return CH_SUCCESS;
+}
+
+/**
+ * @brief   Returns the pages that can still be appended without reclaiming.
+ */
+static uint32_t available_pages(FTLDriver *ftlp) {
+  uint32_t n = ftlp->free_sectors * ftlp->data_pages;
+
+  if (ftlp->head != FTL_UNMAPPED)
+    n += ftlp->data_pages - ftlp->next;
+  return n;
+}
+
+/**
+ * @brief   Moves the valid pages out of a sector and recycles it.
+ */
+static bool_t relocate(FTLDriver *ftlp, uint32_t sector) {
+  uint32_t i, lba, phys = sector * ftlp->data_pages;
+  uint8_t *buf = ftlp->config->buffer;
+
+  for (i = 0; i < ftlp->data_pages; i++, phys++) {
+    if ((read_tag(ftlp, sector, i, &lba) != TAG_VALID) ||
+        (ftlp->config->map[lba] != phys))
+      continue;
+    if ((ftlp->head == FTL_UNMAPPED) || (ftlp->next >= ftlp->data_pages))
+      if (open_sector(ftlp))
+        return CH_FAILED;
+    if (flashRead(ftlp->config->flashp, page_offset(ftlp, phys), buf,
+                  ftlp->info.page_size))
+      return CH_FAILED;
+    /* The tags are built in the same work buffer, the page is programmed
+       before they are written so this is safe.*/
+    if (append(ftlp, lba, buf, 1))
+      return CH_FAILED;
+    ftlp->relocations++;
+  }
+  return format_sector(ftlp, sector);
+}
+
+/**
+ * @brief   Reclaims one sector.
+ * @details The sector with the fewest valid pages is recycled, then, if the
+ *          wear spread exceeds @p FTL_WEAR_LEVELING_THRESHOLD, the least
+ *          erased sector is also recycled in order to move cold data.
+ *
+ * @return              The operation status.
+ * @retval CH_SUCCESS   a sector has been reclaimed.
+ * @retval CH_FAILED    nothing to reclaim or flash error.
+ */
+static bool_t reclaim(FTLDriver *ftlp) {
+  ftl_sector_t *sectors = ftlp->config->sectors;
+  uint32_t s, best = FTL_UNMAPPED, cold = FTL_UNMAPPED, maxec = 0;
+
+  /* A full head is closed, it becomes a candidate like any other sector.*/
+  if ((ftlp->head != FTL_UNMAPPED) && (ftlp->next >= ftlp->data_pages))
+    ftlp->head = FTL_UNMAPPED;
+
+  for (s = 0; s < ftlp->info.sectors_num; s++) {
+    if (sectors[s].erase_count > maxec)
+      maxec = sectors[s].erase_count;
+    if ((sectors[s].state != FTL_SECTOR_USED) || (s == ftlp->head))
+      continue;
+    if ((best == FTL_UNMAPPED) || (sectors[s].valid < sectors[best].valid) ||
+        ((sectors[s].valid == sectors[best].valid) &&
+         (sectors[s].erase_count < sectors[best].erase_count)))
+      best = s;
+    if ((cold == FTL_UNMAPPED) ||
+        (sectors[s].erase_count < sectors[cold].erase_count))
+      cold = s;
+  }
+
+  if ((best == FTL_UNMAPPED) ||
+      (sectors[best].valid >= ftlp->data_pages) ||
+      (sectors[best].valid > available_pages(ftlp)))
+    return CH_FAILED;
+  if (relocate(ftlp, best))
+    return CH_FAILED;
+
+  /* Static wear leveling, it is space neutral so it is only performed when
+     a whole sector worth of pages is available.*/
+  if ((cold != best) && (cold != ftlp->head) &&
+      (maxec - sectors[cold].erase_count > FTL_WEAR_LEVELING_THRESHOLD) &&
+      (available_pages(ftlp) >= ftlp->data_pages))
+    return relocate(ftlp, cold);
+  return CH_SUCCESS;
+}
+
+/**
+ * @brief   Makes sure that the head sector has at least a free page.
+ */
+static bool_t prepare_head(FTLDriver *ftlp) {
+
+  while ((ftlp->head == FTL_UNMAPPED) || (ftlp->next >= ftlp->data_pages)) {
+    if (ftlp->free_sectors >= 2) {
+      if (open_sector(ftlp))
+        return CH_FAILED;
+    }
+    else if (reclaim(ftlp))
+      return CH_FAILED;
+  }
+  return CH_SUCCESS;
+}
+
+/**
+ * @brief   Returns @p TRUE if physical page @p a is newer than @p b.
+ */
+static bool_t is_newer(FTLDriver *ftlp, uint32_t a, uint32_t b) {
+  uint32_t sa = a / ftlp->data_pages, sb = b / ftlp->data_pages;
+
+  if (sa == sb)
+    return a > b;
+  return ftlp->config->sectors[sa].seq > ftlp->config->sectors[sb].seq;
+}
+
+/**
+ * @brief   Scans the sector headers and summaries rebuilding the map.
+ */
+static bool_t mount(FTLDriver *ftlp) {
+  ftl_sector_t *sectors = ftlp->config->sectors;
+  uint32_t *map = ftlp->config->map;
+  uint32_t s, i, lba, hdr[5], maxec = 0;
+  unsigned last;
+
+  ftlp->seq = 0;
+  ftlp->head = FTL_UNMAPPED;
+  ftlp->next = 0;
+  ftlp->free_sectors = 0;
+  for (lba = 0; lba < ftlp->blocks_num; lba++)
+    map[lba] = FTL_UNMAPPED;
+
+  /* Sector headers.*/
+  for (s = 0; s < ftlp->info.sectors_num; s++) {
+    ftl_sector_t *sp = &sectors[s];
+
+    sp->seq = 0;
+    sp->valid = 0;
+    sp->erase_count = ERASED_WORD;
+    sp->state = FTL_SECTOR_DIRTY;
+    if (flashRead(ftlp->config->flashp, sector_offset(ftlp, s),
+                  (uint8_t *)hdr, sizeof(hdr)))
+      return CH_FAILED;
+    if (hdr[HDR_ERASE_CHECK] == ~hdr[HDR_ERASE]) {
+      sp->erase_count = hdr[HDR_ERASE];
+      if (sp->erase_count > maxec)
+        maxec = sp->erase_count;
+    }
+    if ((hdr[HDR_MAGIC] != FTL_MAGIC) || (sp->erase_count == ERASED_WORD))
+      continue;
+    if ((hdr[HDR_SEQ] == ERASED_WORD) && (hdr[HDR_SEQ_CHECK] == ERASED_WORD)) {
+      sp->state = FTL_SECTOR_FREE;
+      ftlp->free_sectors++;
+    }
+    else if (hdr[HDR_SEQ_CHECK] == ~hdr[HDR_SEQ]) {
+      sp->state = FTL_SECTOR_USED;
+      sp->seq = hdr[HDR_SEQ];
+      if (sp->seq > ftlp->seq) {
+        ftlp->seq = sp->seq;
+        ftlp->head = s;
+      }
+    }
+  }
+
+  /* Sector summaries, the newest copy of each logical block wins.*/
+  for (s = 0; s < ftlp->info.sectors_num; s++) {
+    if (sectors[s].state != FTL_SECTOR_USED)
+      continue;
+    for (i = 0; i < ftlp->data_pages; i++) {
+      uint32_t phys = s * ftlp->data_pages + i;
+      if (read_tag(ftlp, s, i, &lba) != TAG_VALID)
+        continue;
+      if ((map[lba] == FTL_UNMAPPED) || is_newer(ftlp, phys, map[lba]))
+        map[lba] = phys;
+    }
+  }
+  for (lba = 0; lba < ftlp->blocks_num; lba++)
+    if (map[lba] != FTL_UNMAPPED)
+      sectors[map[lba] / ftlp->data_pages].valid++;
+
+  /* The head is resumed after its last used tag, pages programmed without
+     a tag because of a power loss are skipped.*/
+  if (ftlp->head != FTL_UNMAPPED) {
+    last = 0;
+    for (i = 0; i < ftlp->data_pages; i++)
+      if (read_tag(ftlp, ftlp->head, i, &lba) != TAG_BLANK)
+        last = i + 1;
+    while ((last < ftlp->data_pages) &&
+           !page_is_blank(ftlp, ftlp->head * ftlp->data_pages + last))
+      last++;
+    ftlp->next = last;
+  }
+
+  /* Sectors in an unknown state are formatted, the lost erase counters are
+     assumed to be the worst seen so far.*/
+  for (s = 0; s < ftlp->info.sectors_num; s++) {
+    if (sectors[s].state != FTL_SECTOR_DIRTY)
+      continue;
+    if (sectors[s].erase_count == ERASED_WORD)
+      sectors[s].erase_count = maxec;
+    if (format_sector(ftlp, s))
+      return CH_FAILED;
+  }
+  return CH_SUCCESS;
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   FTL driver initialization.
+ * @note    This function is implicitly invoked by @p halInit(), there is
+ *          no need to explicitly initialize the driver.
+ *
+ * @init
+ */
+void ftlInit(void) {
+
+}
+
+/**
+ * @brief   Initializes an instance.
+ *
+ * @param[out] ftlp     pointer to the @p FTLDriver object
+ *
+ * @init
+ */
+void ftlObjectInit(FTLDriver *ftlp) {
+
+  ftlp->vmt = &ftl_vmt;
+  ftlp->state = BLK_STOP;
+  ftlp->config = NULL;
+  ftlp->head = FTL_UNMAPPED;
+  ftlp->writes = 0;
+  ftlp->relocations = 0;
+  ftlp->erases = 0;
+}
+
+/**
+ * @brief   Configures and activates the FTL driver.
+ * @details The geometry of the underlying flash device is read and the
+ *          layout of the sectors is computed.
+ *
+ * @param[in] ftlp      pointer to the @p FTLDriver object
+ * @param[in] config    pointer to the @p FTLConfig object.
+ *
+ * @api
+ */
+void ftlStart(FTLDriver *ftlp, const FTLConfig *config) {
+
+  chDbgCheck((ftlp != NULL) && (config != NULL), "ftlStart");
+  chDbgAssert((ftlp->state == BLK_STOP) || (ftlp->state == BLK_ACTIVE),
+              "ftlStart(), #1", "invalid state");
+
+  ftlp->config = config;
+  (void)flashGetInfo(config->flashp, &ftlp->info);
+  ftlp->summary_pages = FTL_SUMMARY_PAGES(ftlp->info.page_size,
+                                          ftlp->info.sector_size);
+  ftlp->data_pages = FTL_DATA_PAGES(ftlp->info.page_size,
+                                    ftlp->info.sector_size);
+  ftlp->blocks_num = FTL_MAP_SIZE(ftlp->info.page_size,
+                                  ftlp->info.sector_size,
+                                  ftlp->info.sectors_num,
+                                  config->reserved);
+
+  chDbgAssert((config->reserved >= 2) &&
+              (config->reserved < ftlp->info.sectors_num) &&
+              (ftlp->data_pages > 0) &&
+              (ftlp->info.page_size % FTL_TAG_SIZE == 0),
+              "ftlStart(), #2", "invalid geometry");
+
+  ftlp->state = BLK_ACTIVE;
+}
+
+/**
+ * @brief   Deactivates the FTL driver.
+ *
+ * @param[in] ftlp      pointer to the @p FTLDriver object
+ *
+ * @api
+ */
+void ftlStop(FTLDriver *ftlp) {
+
+  chDbgCheck(ftlp != NULL, "ftlStop");
+  chDbgAssert((ftlp->state == BLK_STOP) || (ftlp->state == BLK_ACTIVE),
+              "ftlStop(), #1", "invalid state");
+
+  ftlp->state = BLK_STOP;
+}
+
+/**
+ * @brief   Mounts the flash device.
+ * @details The sector summaries are scanned and the translation map is
+ *          rebuilt, the state left by an interrupted operation is
+ *          recovered. Sectors not formatted are formatted.
+ *
+ * @param[in] ftlp      pointer to the @p FTLDriver object
+ *
+ * @return              The operation status.
+ * @retval CH_SUCCESS   the operation succeeded and the driver is now
+ *                      in the @p BLK_READY state.
+ * @retval CH_FAILED    the operation failed.
+ *
+ * @api
+ */
+bool_t ftlConnect(FTLDriver *ftlp) {
+
+  chDbgCheck(ftlp != NULL, "ftlConnect");
+  chDbgAssert((ftlp->state == BLK_ACTIVE) || (ftlp->state == BLK_READY),
+              "ftlConnect(), #1", "invalid state");
+
+  /* Connection procedure in progress.*/
+  ftlp->state = BLK_CONNECTING;
+  if (mount(ftlp)) {
+    ftlp->state = BLK_ACTIVE;
+    return CH_FAILED;
+  }
+  ftlp->state = BLK_READY;
+  return CH_SUCCESS;
+}
+
+/**
+ * @brief   Unmounts the flash device.
+ * @note    No action is required on the flash, all the operations are
+ *          committed when they return.
+ *
+ * @param[in] ftlp      pointer to the @p FTLDriver object
+ *
+ * @return              The operation status.
+ * @retval CH_SUCCESS   the operation succeeded.
+ * @retval CH_FAILED    the operation failed.
+ *
+ * @api
+ */
+bool_t ftlDisconnect(FTLDriver *ftlp) {
+
+  chDbgCheck(ftlp != NULL, "ftlDisconnect");
+  chDbgAssert((ftlp->state == BLK_ACTIVE) || (ftlp->state == BLK_READY),
+              "ftlDisconnect(), #1", "invalid state");
+
+  ftlp->state = BLK_ACTIVE;
+  return CH_SUCCESS;
+}
+
+/**
+ * @brief   Reads one or more blocks.
+ * @note    Blocks never written read as erased flash.
+ *
+ * @param[in] ftlp      pointer to the @p FTLDriver object
+ * @param[in] startblk  first block to read
+ * @param[out] buffer   pointer to the read buffer
+ * @param[in] n         number of blocks to read
+ *
+ * @return              The operation status.
+ * @retval CH_SUCCESS   the operation succeeded.
+ * @retval CH_FAILED    the operation failed.
+ *
+ * @api
+ */
+bool_t ftlRead(FTLDriver *ftlp, uint32_t startblk,
+               uint8_t *buffer, uint32_t n) {
+  uint32_t *map;
+
+  chDbgCheck((ftlp != NULL) && (buffer != NULL), "ftlRead");
+  chDbgAssert(ftlp->state == BLK_READY, "ftlRead(), #1", "invalid state");
+
+  if ((startblk >= ftlp->blocks_num) || (n > ftlp->blocks_num - startblk))
+    return CH_FAILED;
+
+  ftlp->state = BLK_READING;
+  map = ftlp->config->map;
+  while (n > 0) {
+    uint32_t phys = map[startblk], k = 1;
+
+    if (phys == FTL_UNMAPPED)
+      memset(buffer, FLASH_ERASED_VALUE, ftlp->info.page_size);
+    else {
+      /* Physically contiguous runs are read in a single operation.*/
+      while ((k < n) && (map[startblk + k] == phys + k) &&
+             ((phys + k) % ftlp->data_pages != 0))
+        k++;
+      if (flashRead(ftlp->config->flashp, page_offset(ftlp, phys),
+                    buffer, k * ftlp->info.page_size)) {
+        ftlp->state = BLK_READY;
+        return CH_FAILED;
+      }
+    }
+    startblk += k;
+    buffer += k * ftlp->info.page_size;
+    n -= k;
+  }
+  ftlp->state = BLK_READY;
+  return CH_SUCCESS;
+}
+
+/**
+ * @brief   Writes one or more blocks.
+ * @details Blocks are appended at the log head, garbage collection is
+ *          performed inline when the free sectors fall below the reserve.
+ *          Each block is committed when the function returns.
+ *
+ * @param[in] ftlp      pointer to the @p FTLDriver object
+ * @param[in] startblk  first block to write
+ * @param[in] buffer    pointer to the write buffer
+ * @param[in] n         number of blocks to write
+ *
+ * @return              The operation status.
+ * @retval CH_SUCCESS   the operation succeeded.
+ * @retval CH_FAILED    the operation failed.
+ *
+ * @api
+ */
+bool_t ftlWrite(FTLDriver *ftlp, uint32_t startblk,
+                const uint8_t *buffer, uint32_t n) {
+
+  chDbgCheck((ftlp != NULL) && (buffer != NULL), "ftlWrite");
+  chDbgAssert(ftlp->state == BLK_READY, "ftlWrite(), #1", "invalid state");
+
+  if ((startblk >= ftlp->blocks_num) || (n > ftlp->blocks_num - startblk))
+    return CH_FAILED;
+
+  ftlp->state = BLK_WRITING;
+  while (n > 0) {
+    uint32_t k;
+
+    if (prepare_head(ftlp))
+      goto failed;
+
+    /* Run limited by the space in the head and by the tags that fit the
+       work buffer.*/
+    k = ftlp->data_pages - ftlp->next;
+    if (k > ftlp->info.page_size / FTL_TAG_SIZE)
+      k = ftlp->info.page_size / FTL_TAG_SIZE;
+    if (k > n)
+      k = n;
+    if (append(ftlp, startblk, buffer, k))
+      goto failed;
+    ftlp->writes += k;
+    startblk += k;
+    buffer += k * ftlp->info.page_size;
+    n -= k;
+  }
+  ftlp->state = BLK_READY;
+  return CH_SUCCESS;
+
+failed:
+  ftlp->state = BLK_READY;
+  return CH_FAILED;
+}
+
+/**
+ * @brief   Waits for write operations completion.
+ * @note    Writes are synchronous so there is nothing to wait for.
+ *
+ * @param[in] ftlp      pointer to the @p FTLDriver object
+ *
+ * @return              The operation status.
+ * @retval CH_SUCCESS   the operation succeeded.
+ * @retval CH_FAILED    the operation failed.
+ *
+ * @api
+ */
+bool_t ftlSync(FTLDriver *ftlp) {
+
+  chDbgCheck(ftlp != NULL, "ftlSync");
+
+  if (ftlp->state != BLK_READY)
+    return CH_FAILED;
+  return CH_SUCCESS;
+}
+
+/**
+ * @brief   Returns the media info.
+ *
+ * @param[in] ftlp      pointer to the @p FTLDriver object
+ * @param[out] bdip     pointer to a @p BlockDeviceInfo structure
+ *
+ * @return              The operation status.
+ * @retval CH_SUCCESS   the operation succeeded.
+ * @retval CH_FAILED    the operation failed.
+ *
+ * @api
+ */
+bool_t ftlGetInfo(FTLDriver *ftlp, BlockDeviceInfo *bdip) {
+
+  chDbgCheck((ftlp != NULL) && (bdip != NULL), "ftlGetInfo");
+
+  if (ftlp->state != BLK_READY)
+    return CH_FAILED;
+
+  bdip->blk_num  = ftlp->blocks_num;
+  bdip->blk_size = ftlp->info.page_size;
+  return CH_SUCCESS;
+}
+
+/**
+ * @brief   Performs a garbage collection step.
+ * @details This function can be invoked from a low priority thread when
+ *          the system is idle in order to move the garbage collection
+ *          cost out of the write path.
+ *
+ * @param[in] ftlp      pointer to the @p FTLDriver object
+ *
+ * @return              The operation status.
+ * @retval CH_SUCCESS   a sector has been reclaimed.
+ * @retval CH_FAILED    there was nothing to reclaim or an error occurred.
+ *
+ * @api
+ */
+bool_t ftlCollect(FTLDriver *ftlp) {
+  bool_t result;
+
+  chDbgCheck(ftlp != NULL, "ftlCollect");
+  chDbgAssert(ftlp->state == BLK_READY, "ftlCollect(), #1", "invalid state");
+
+  ftlp->state = BLK_WRITING;
+  result = reclaim(ftlp);
+  ftlp->state = BLK_READY;
+  return result;
+}
+
+#endif /* HAL_USE_FTL */
+
+/** @} */
@@ -74,6 +74,9 @@ void halInit(void) {
 #if HAL_USE_CAN || defined(__DOXYGEN__)
   canInit();
 #endif
+#if HAL_USE_DAC || defined(__DOXYGEN__)
+  dacInit();
+#endif
 #if HAL_USE_EXT || defined(__DOXYGEN__)
   extInit();
 #endif
@@ -113,6 +116,9 @@ void halInit(void) {
 #if HAL_USE_SERIAL_USB || defined(__DOXYGEN__)
   sduInit();
 #endif
+#if HAL_USE_FTL || defined(__DOXYGEN__)
+  ftlInit();
+#endif
 #if HAL_USE_RTC || defined(__DOXYGEN__)
   rtcInit();
 #endif
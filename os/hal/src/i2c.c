@@ -50,6 +50,81 @@
 /* Driver local functions.                                                   */
 /*===========================================================================*/
 
+#if I2C_USE_TRANSACTIONS || defined(__DOXYGEN__)
+static void txn_timeout_cb(void *p);
+
+/**
+ * @brief   Starts a transaction on the bus.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] itp       pointer to the @p I2CTransaction object
+ *
+ * @notapi
+ */
+static void txn_start_i(I2CDriver *i2cp, I2CTransaction *itp) {
+
+  i2cp->txncur = itp;
+  i2cp->errors = I2CD_NO_ERROR;
+  i2cp->state = itp->txbytes > 0 ? I2C_ACTIVE_TX : I2C_ACTIVE_RX;
+  if (itp->timeout != TIME_INFINITE)
+    chVTSetI(&i2cp->txnvt, itp->timeout, txn_timeout_cb, (void *)i2cp);
+  i2c_lld_start_transaction(i2cp, itp->addr, itp->txbuf, itp->txbytes,
+                            itp->rxbuf, itp->rxbytes);
+}
+
+/**
+ * @brief   Notifies the end of a transaction.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] itp       pointer to the @p I2CTransaction object
+ * @param[in] msg       the transaction status
+ *
+ * @notapi
+ */
+static void txn_end_i(I2CDriver *i2cp, I2CTransaction *itp, msg_t msg) {
+
+  itp->status = msg;
+  itp->errors = i2cp->errors;
+  itp->pending = FALSE;
+  if (itp->end_cb != NULL)
+    itp->end_cb(i2cp, itp);
+  if (itp->thread != NULL) {
+    Thread *tp = itp->thread;
+    itp->thread = NULL;
+    tp->p_u.rdymsg = msg;
+    chSchReadyI(tp);
+  }
+}
+
+/**
+ * @brief   Transaction timeout.
+ * @details The operation is aborted and all the queued transactions are
+ *          terminated with @p RDY_TIMEOUT, the driver goes in the
+ *          @p I2C_LOCKED state and must be restarted.
+ *
+ * @param[in] p         pointer to the @p I2CDriver object
+ *
+ * @notapi
+ */
+static void txn_timeout_cb(void *p) {
+  I2CDriver *i2cp = (I2CDriver *)p;
+  I2CTransaction *itp;
+
+  chSysLockFromIsr();
+  if ((itp = i2cp->txncur) != NULL) {
+    i2c_lld_abort_transaction(i2cp);
+    i2cp->txncur = NULL;
+    i2cp->state = I2C_LOCKED;
+    txn_end_i(i2cp, itp, RDY_TIMEOUT);
+    while ((itp = i2cp->txnqueue) != NULL) {
+      i2cp->txnqueue = itp->next;
+      txn_end_i(i2cp, itp, RDY_TIMEOUT);
+    }
+  }
+  chSysUnlockFromIsr();
+}
+#endif /* I2C_USE_TRANSACTIONS */
+
 /*===========================================================================*/
 /* Driver exported functions.                                                */
 /*===========================================================================*/
@@ -77,6 +152,11 @@ void i2cObjectInit(I2CDriver *i2cp) {
   i2cp->state  = I2C_STOP;
   i2cp->config = NULL;
 
+#if I2C_USE_TRANSACTIONS
+  i2cp->txncur   = NULL;
+  i2cp->txnqueue = NULL;
+#endif /* I2C_USE_TRANSACTIONS */
+
 #if I2C_USE_MUTUAL_EXCLUSION
 #if CH_USE_MUTEXES
   chMtxInit(&i2cp->mutex);
@@ -298,6 +378,175 @@ void i2cReleaseBus(I2CDriver *i2cp) {
 }
 #endif /* I2C_USE_MUTUAL_EXCLUSION */
 
+#if I2C_USE_TRANSACTIONS || defined(__DOXYGEN__)
+/**
+ * @brief   Queues a transaction.
+ * @details The transaction is started immediately if the driver is idle
+ *          else it is queued, queued transactions are executed in order
+ *          of priority then in FIFO order.
+ * @pre     In order to use this function the option
+ *          @p I2C_USE_TRANSACTIONS must be enabled.
+ * @pre     The @p prio field of the transaction must have been set.
+ * @note    The synchronous APIs can be used only when no transactions
+ *          are pending.
+ * @note    The transaction object must not be modified until completion.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] itp       pointer to the @p I2CTransaction object
+ *
+ * @iclass
+ */
+void i2cStartTransactionI(I2CDriver *i2cp, I2CTransaction *itp) {
+
+  chDbgCheckClassI();
+  chDbgCheck((i2cp != NULL) && (itp != NULL) && (itp->addr != 0) &&
+             ((itp->txbytes > 0) || (itp->rxbytes > 0)) &&
+             ((itp->txbytes == 0) || (itp->txbuf != NULL)) &&
+             ((itp->rxbytes == 0) || (itp->rxbuf != NULL)) &&
+             (itp->timeout != TIME_IMMEDIATE),
+             "i2cStartTransactionI");
+  chDbgAssert((i2cp->state == I2C_READY) || (i2cp->txncur != NULL),
+              "i2cStartTransactionI(), #1", "not ready");
+  chDbgAssert(!itp->pending,
+              "i2cStartTransactionI(), #2", "already pending");
+
+  itp->pending = TRUE;
+  if (i2cp->txncur == NULL)
+    txn_start_i(i2cp, itp);
+  else {
+    I2CTransaction **pp = &i2cp->txnqueue;
+
+    while ((*pp != NULL) && ((*pp)->prio >= itp->prio))
+      pp = &(*pp)->next;
+    itp->next = *pp;
+    *pp = itp;
+  }
+}
+
+/**
+ * @brief   Queues a transaction.
+ * @details The transaction is queued with the priority of the invoking
+ *          thread, the function does not wait for completion, the
+ *          transaction callback is invoked at the end.
+ * @pre     In order to use this function the option
+ *          @p I2C_USE_TRANSACTIONS must be enabled.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] itp       pointer to the @p I2CTransaction object
+ *
+ * @api
+ */
+void i2cStartTransaction(I2CDriver *i2cp, I2CTransaction *itp) {
+
+  chDbgCheck((i2cp != NULL) && (itp != NULL), "i2cStartTransaction");
+
+  chSysLock();
+  itp->prio = chThdGetPriority();
+  itp->thread = NULL;
+  i2cStartTransactionI(i2cp, itp);
+  chSysUnlock();
+}
+
+/**
+ * @brief   Executes a transaction.
+ * @details The transaction is queued with the priority of the invoking
+ *          thread and the thread is suspended until the transaction has
+ *          been executed.
+ * @pre     In order to use this function the option
+ *          @p I2C_USE_TRANSACTIONS must be enabled.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] itp       pointer to the @p I2CTransaction object
+ * @return              The operation status.
+ * @retval RDY_OK       if the transaction succeeded.
+ * @retval RDY_RESET    if one or more I2C errors occurred, the errors are
+ *                      stored in the transaction object.
+ * @retval RDY_TIMEOUT  if a timeout occurred, the driver must be stopped
+ *                      and restarted.
+ *
+ * @api
+ */
+msg_t i2cTransaction(I2CDriver *i2cp, I2CTransaction *itp) {
+
+  return i2cTransactionBatch(i2cp, itp, 1);
+}
+
+/**
+ * @brief   Executes an array of transactions.
+ * @details The transactions are queued together with the priority of the
+ *          invoking thread and the thread is suspended until the last one
+ *          has been executed, the whole batch costs a single wakeup.
+ * @pre     In order to use this function the option
+ *          @p I2C_USE_TRANSACTIONS must be enabled.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] itp       pointer to an array of @p I2CTransaction objects
+ * @param[in] n         number of transactions in the array
+ * @return              The status of the first failed transaction or
+ *                      @p RDY_OK if all the transactions succeeded.
+ *
+ * @api
+ */
+msg_t i2cTransactionBatch(I2CDriver *i2cp, I2CTransaction *itp, size_t n) {
+  size_t i;
+
+  chDbgCheck((i2cp != NULL) && (itp != NULL) && (n > 0),
+             "i2cTransactionBatch");
+
+  chSysLock();
+  for (i = 0; i < n; i++) {
+    itp[i].prio = chThdGetPriority();
+    itp[i].thread = NULL;
+    i2cStartTransactionI(i2cp, &itp[i]);
+  }
+  if (itp[n - 1].pending) {
+    itp[n - 1].thread = chThdSelf();
+    chSchGoSleepS(THD_STATE_SUSPENDED);
+  }
+  chSysUnlock();
+
+  for (i = 0; i < n; i++) {
+    if (itp[i].status != RDY_OK)
+      return itp[i].status;
+  }
+  return RDY_OK;
+}
+
+/**
+ * @brief   Transactions ISR code.
+ * @details Notifies the end of the current transaction and starts the
+ *          next queued one, invoked by the low level driver ISR.
+ * @note    The low level driver must not invoke this function from
+ *          within @p i2c_lld_start_transaction().
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] msg       the transaction status, @p RDY_OK or @p RDY_RESET
+ *
+ * @notapi
+ */
+void _i2c_txn_isr(I2CDriver *i2cp, msg_t msg) {
+  I2CTransaction *itp;
+
+  chSysLockFromIsr();
+  if ((itp = i2cp->txncur) != NULL) {
+    if (chVTIsArmedI(&i2cp->txnvt))
+      chVTResetI(&i2cp->txnvt);
+
+    /* The callback can queue further transactions because the driver is
+       still busy.*/
+    txn_end_i(i2cp, itp, msg);
+    i2cp->txncur = NULL;
+    if ((itp = i2cp->txnqueue) != NULL) {
+      i2cp->txnqueue = itp->next;
+      txn_start_i(i2cp, itp);
+    }
+    else
+      i2cp->state = I2C_READY;
+  }
+  chSysUnlockFromIsr();
+}
+#endif /* I2C_USE_TRANSACTIONS */
+
 #endif /* HAL_USE_I2C */
 
 /** @} */
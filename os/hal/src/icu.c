@@ -26,6 +26,8 @@
  * @{
  */
 
+#include <string.h>
+
 #include "ch.h"
 #include "hal.h"
 
@@ -47,6 +49,42 @@
 /* Driver local functions.                                                   */
 /*===========================================================================*/
 
+#if ICU_USE_CAPTURE || defined(__DOXYGEN__)
+/**
+ * @brief   Waits for more edges in the ring.
+ *
+ * @param[in] icup      pointer to the @p ICUDriver object
+ * @param[in] timeout   the number of ticks before the operation timeouts
+ * @return              The wakeup message.
+ *
+ * @notapi
+ */
+static msg_t capture_wait_s(ICUDriver *icup, systime_t timeout) {
+  msg_t msg;
+
+  if (timeout == TIME_IMMEDIATE)
+    return RDY_TIMEOUT;
+  icup->capthread = chThdSelf();
+  msg = chSchGoSleepTimeoutS(THD_STATE_SUSPENDED, timeout);
+  icup->capthread = NULL;
+  return msg;
+}
+
+/**
+ * @brief   Number of even sequence numbers in a range.
+ *
+ * @param[in] first     first sequence number of the range
+ * @param[in] n         size of the range
+ * @return              The number of active edges in the range.
+ *
+ * @notapi
+ */
+static uint32_t active_edges(uint32_t first, uint32_t n) {
+
+  return (n + 1 - (first & 1)) / 2;
+}
+#endif /* ICU_USE_CAPTURE */
+
 /*===========================================================================*/
 /* Driver exported functions.                                                */
 /*===========================================================================*/
@@ -74,6 +112,10 @@ void icuObjectInit(ICUDriver *icup) {
 
   icup->state  = ICU_STOP;
   icup->config = NULL;
+#if ICU_USE_CAPTURE
+  icup->capcfg    = NULL;
+  icup->capthread = NULL;
+#endif
 }
 
 /**
@@ -154,6 +196,362 @@ void icuDisable(ICUDriver *icup) {
   chSysUnlock();
 }
 
+#if ICU_USE_CAPTURE || defined(__DOXYGEN__)
+/**
+ * @brief   Starts logging the edges into a ring.
+ * @details The width and period callbacks are not invoked while capturing,
+ *          the edges are fetched in batches using @p icuFetchCapture().
+ *
+ * @param[in] icup      pointer to the @p ICUDriver object
+ * @param[in] config    pointer to the @p ICUCaptureConfig object
+ *
+ * @api
+ */
+void icuStartCapture(ICUDriver *icup, const ICUCaptureConfig *config) {
+
+  chDbgCheck((icup != NULL) && (config != NULL) && (config->ring != NULL) &&
+             (config->size >= 2) &&
+             ((config->size & (config->size - 1)) == 0), "icuStartCapture");
+
+  chSysLock();
+  chDbgAssert(icup->state == ICU_READY, "icuStartCapture(), #1",
+              "invalid state");
+  icup->capcfg  = config;
+  icup->capwr   = 0;
+  icup->caprd   = 0;
+  icup->capwant = 0;
+  icup->capstats.edges      = 0;
+  icup->capstats.lost       = 0;
+  icup->capstats.batches    = 0;
+  icup->capstats.high_water = 0;
+  icu_lld_start_capture(icup);
+  icup->state = ICU_CAPTURING;
+  chSysUnlock();
+}
+
+/**
+ * @brief   Stops logging the edges.
+ * @details A thread waiting in @p icuFetchCapture() is released.
+ *
+ * @param[in] icup      pointer to the @p ICUDriver object
+ *
+ * @api
+ */
+void icuStopCapture(ICUDriver *icup) {
+  Thread *tp;
+
+  chDbgCheck(icup != NULL, "icuStopCapture");
+
+  chSysLock();
+  chDbgAssert(icup->state == ICU_CAPTURING, "icuStopCapture(), #1",
+              "invalid state");
+  icu_lld_stop_capture(icup);
+  icup->capcfg = NULL;
+  icup->state  = ICU_READY;
+  tp = icup->capthread;
+  if (tp != NULL) {
+    icup->capthread = NULL;
+    chSchWakeupS(tp, RDY_RESET);
+  }
+  chSysUnlock();
+}
+
+/**
+ * @brief   Fetches a batch of edges.
+ * @details The function waits until @p max edges are available and copies
+ *          them in the batch buffer. If the reader falls behind by more
+ *          than half ring the oldest edges are dropped, the count is
+ *          reported in the @p lost field of the batch. The edges
+ *          overwritten while being copied are dropped too, the fetch is
+ *          repeated if the whole batch is lost.
+ * @note    Only one thread at time can fetch from the ring.
+ *
+ * @param[in] icup      pointer to the @p ICUDriver object
+ * @param[in,out] bp    pointer to the @p ICUBatch object, the @p edges and
+ *                      @p max fields must be initialized, @p max cannot
+ *                      exceed half ring
+ * @param[in] timeout   the number of ticks before the operation timeouts,
+ *                      the following special values are allowed:
+ *                      - @a TIME_IMMEDIATE immediate timeout.
+ *                      - @a TIME_INFINITE no timeout.
+ *                      .
+ * @return              The operation result.
+ * @retval RDY_OK       the batch is full.
+ * @retval RDY_TIMEOUT  timeout, the batch contains the edges available
+ *                      so far, possibly none.
+ * @retval RDY_RESET    the capture has been stopped, the batch is empty.
+ *
+ * @api
+ */
+msg_t icuFetchCapture(ICUDriver *icup, ICUBatch *bp, systime_t timeout) {
+  const ICUCaptureConfig *config;
+  size_t half, avail, n, i, chunk;
+  uint32_t first, bad, skip;
+  msg_t msg = RDY_OK;
+
+  chDbgCheck((icup != NULL) && (bp != NULL) && (bp->edges != NULL) &&
+             (bp->max > 0), "icuFetchCapture");
+
+  bp->n    = 0;
+  bp->lost = 0;
+  chSysLock();
+  config = icup->capcfg;
+  if (config == NULL) {
+    chSysUnlock();
+    return RDY_RESET;
+  }
+  half = config->size / 2;
+  chDbgAssert(bp->max <= half, "icuFetchCapture(), #1", "batch too large");
+  while (TRUE) {
+    while ((size_t)(icup->capwr - icup->caprd) < bp->max) {
+      icup->capwant = bp->max;
+      msg = capture_wait_s(icup, timeout);
+      if (msg != RDY_OK)
+        break;
+    }
+    if ((msg == RDY_RESET) || (icup->capcfg != config)) {
+      chSysUnlock();
+      bp->lost = 0;
+      return RDY_RESET;
+    }
+
+    /* The half ring following the last reported edge is being written,
+       the edges older than half ring are gone.*/
+    avail = (size_t)(icup->capwr - icup->caprd);
+    if (avail > icup->capstats.high_water)
+      icup->capstats.high_water = avail;
+    if (avail > half) {
+      bad = (uint32_t)(avail - half);
+      icup->caprd += bad;
+      icup->capstats.lost += bad;
+      bp->lost += bad;
+      avail = half;
+    }
+    n = avail < bp->max ? avail : bp->max;
+    first = icup->caprd;
+    icup->caprd += n;
+    icup->capstats.batches++;
+    chSysUnlock();
+
+    /* Copy outside the critical zone, the writer does not touch the
+       reported part of the ring unless the reader falls behind again.*/
+    i = first & (config->size - 1);
+    chunk = config->size - i < n ? config->size - i : n;
+    memcpy(bp->edges, config->ring + i, chunk * sizeof (icucnt_t));
+    memcpy(bp->edges + chunk, config->ring, (n - chunk) * sizeof (icucnt_t));
+
+    /* Edges overwritten during the copy are discarded, if the whole batch
+       is gone the fetch is repeated.*/
+    chSysLock();
+    skip = icup->capwr - (uint32_t)half - first;
+    if ((int32_t)skip <= 0) {
+      skip = 0;
+      break;
+    }
+    if (skip > n)
+      skip = (uint32_t)n;
+    icup->capstats.lost += skip;
+    bp->lost += skip;
+    if ((skip < n) || (msg != RDY_OK))
+      break;
+  }
+  chSysUnlock();
+
+  if (skip > 0) {
+    memmove(bp->edges, bp->edges + skip, (n - skip) * sizeof (icucnt_t));
+    n -= skip;
+    first += skip;
+  }
+
+  bp->n     = n;
+  bp->first = first;
+  return n == bp->max ? RDY_OK : RDY_TIMEOUT;
+}
+
+/**
+ * @brief   Returns the capture statistics.
+ *
+ * @param[in] icup      pointer to the @p ICUDriver object
+ * @param[out] icsp     pointer to a @p ICUCaptureStats structure
+ *
+ * @api
+ */
+void icuGetCaptureStats(ICUDriver *icup, ICUCaptureStats *icsp) {
+
+  chDbgCheck((icup != NULL) && (icsp != NULL), "icuGetCaptureStats");
+
+  chSysLock();
+  *icsp = icup->capstats;
+  chSysUnlock();
+}
+
+/**
+ * @brief   Clears a measurement.
+ *
+ * @param[out] mp       pointer to the @p ICUMeasure object
+ *
+ * @api
+ */
+void icuMeasureReset(ICUMeasure *mp) {
+
+  chDbgCheck(mp != NULL, "icuMeasureReset");
+
+  mp->pulses = 0;
+  mp->cycles = 0;
+  mp->period = 0;
+  mp->width  = 0;
+  mp->next   = 0;
+  mp->start  = 0;
+  mp->stop   = 0;
+  mp->phase  = 0;
+}
+
+/**
+ * @brief   Accumulates a batch of edges into a measurement.
+ * @details Cycles spanning consecutive batches are measured, a gap in the
+ *          sequence numbers restarts the cycles tracking.
+ * @note    The totals are 32 bits wide, the measurement should be reset
+ *          periodically.
+ *
+ * @param[in,out] mp    pointer to the @p ICUMeasure object
+ * @param[in] bp        pointer to the @p ICUBatch object
+ *
+ * @api
+ */
+void icuMeasureBatch(ICUMeasure *mp, const ICUBatch *bp) {
+  const icucnt_t *p, *end;
+  uint32_t period, width;
+  icucnt_t start, stop;
+
+  chDbgCheck((mp != NULL) && (bp != NULL), "icuMeasureBatch");
+
+  mp->pulses += active_edges(bp->first - bp->lost, bp->lost) +
+                active_edges(bp->first, (uint32_t)bp->n);
+  if ((bp->lost != 0) || (bp->first != mp->next))
+    mp->phase = 0;
+  mp->next = bp->first + (uint32_t)bp->n;
+  p   = bp->edges;
+  end = p + bp->n;
+  if (p == end)
+    return;
+
+  /* A leading idle edge closes the active phase of the last cycle.*/
+  if ((bp->first & 1) != 0) {
+    if (mp->phase == 1) {
+      mp->stop  = *p;
+      mp->phase = 2;
+    }
+    else
+      mp->phase = 0;
+    p++;
+  }
+
+  /* Whole cycles, active and idle edge pairs.*/
+  start  = mp->start;
+  stop   = mp->stop;
+  period = 0;
+  width  = 0;
+  if ((mp->phase != 2) && (end - p >= 2)) {
+    start = p[0];
+    stop  = p[1];
+    mp->phase = 2;
+    p += 2;
+  }
+  while (end - p >= 2) {
+    period += (icucnt_t)(p[0] - start);
+    width  += (icucnt_t)(stop - start);
+    mp->cycles++;
+    start = p[0];
+    stop  = p[1];
+    p += 2;
+  }
+
+  /* A trailing active edge closes the previous cycle and opens a new one.*/
+  if (p < end) {
+    if (mp->phase == 2) {
+      period += (icucnt_t)(*p - start);
+      width  += (icucnt_t)(stop - start);
+      mp->cycles++;
+    }
+    start = *p;
+    mp->phase = 1;
+  }
+  mp->start   = start;
+  mp->stop    = stop;
+  mp->period += period;
+  mp->width  += width;
+}
+
+/**
+ * @brief   Returns the average frequency of the measured cycles.
+ *
+ * @param[in] mp        pointer to the @p ICUMeasure object
+ * @param[in] clock     counter clock in Hz
+ * @param[in] scale     result multiplier, for example 1000 for mHz
+ * @return              The frequency multiplied by @p scale, zero if no
+ *                      cycles have been measured.
+ *
+ * @api
+ */
+uint32_t icuMeasureFrequency(const ICUMeasure *mp, icufreq_t clock,
+                             uint32_t scale) {
+
+  chDbgCheck(mp != NULL, "icuMeasureFrequency");
+
+  if (mp->period == 0)
+    return 0;
+  return (uint32_t)(((uint64_t)clock * scale * mp->cycles + mp->period / 2) /
+                    mp->period);
+}
+
+/**
+ * @brief   Returns the average duty cycle of the measured cycles.
+ *
+ * @param[in] mp        pointer to the @p ICUMeasure object
+ * @param[in] scale     result multiplier, for example 100 for percents
+ * @return              The duty cycle multiplied by @p scale, zero if no
+ *                      cycles have been measured.
+ *
+ * @api
+ */
+uint32_t icuMeasureDuty(const ICUMeasure *mp, uint32_t scale) {
+
+  chDbgCheck(mp != NULL, "icuMeasureDuty");
+
+  if (mp->period == 0)
+    return 0;
+  return (uint32_t)(((uint64_t)mp->width * scale + mp->period / 2) /
+                    mp->period);
+}
+
+/**
+ * @brief   Capture ISR code.
+ * @details Accounts the edges written in the ring by the low level driver
+ *          and wakes up the reader when enough edges are available.
+ * @note    This function is meant to be invoked by the low level drivers
+ *          only, usually on the DMA half and full transfer events.
+ *
+ * @param[in] icup      pointer to the @p ICUDriver object
+ * @param[in] n         number of edges appended to the ring
+ *
+ * @notapi
+ */
+void _icu_capture_isr(ICUDriver *icup, size_t n) {
+
+  chSysLockFromIsr();
+  icup->capwr += (uint32_t)n;
+  icup->capstats.edges += (uint32_t)n;
+  if ((icup->capthread != NULL) &&
+      ((size_t)(icup->capwr - icup->caprd) >= icup->capwant)) {
+    Thread *tp = icup->capthread;
+    icup->capthread = NULL;
+    tp->p_u.rdymsg = RDY_OK;
+    chSchReadyI(tp);
+  }
+  chSysUnlockFromIsr();
+}
+#endif /* ICU_USE_CAPTURE */
+
 #endif /* HAL_USE_ICU */
 
 /** @} */
@@ -241,6 +241,69 @@ msg_t sdRequestDataI(SerialDriver *sdp) {
   return b;
 }
 
+#if SERIAL_USE_BLOCK_MODE || defined(__DOXYGEN__)
+/**
+ * @brief   Handles a block of incoming data.
+ * @details Must be called from the input interrupt service routine of low
+ *          level drivers moving data in blocks, for example on DMA half
+ *          and full transfer or on idle line detection. The whole block is
+ *          enqueued and the related events are generated once.
+ * @note    The incoming data event is only generated when the input queue
+ *          becomes non-empty.
+ * @note    If the input queue has not enough space the excess data is
+ *          discarded and an overrun error is signaled.
+ *
+ * @param[in] sdp       pointer to a @p SerialDriver structure
+ * @param[in] bp        pointer to the received data
+ * @param[in] n         number of received bytes
+ * @return              The number of bytes written in the input queue.
+ *
+ * @iclass
+ */
+size_t sdIncomingBlockI(SerialDriver *sdp, const uint8_t *bp, size_t n) {
+  size_t w;
+
+  chDbgCheckClassI();
+  chDbgCheck((sdp != NULL) && (bp != NULL), "sdIncomingBlockI");
+
+  if (n == 0)
+    return 0;
+  if (chIQIsEmptyI(&sdp->iqueue))
+    chnAddFlagsI(sdp, CHN_INPUT_AVAILABLE);
+  w = chIQPutBlockI(&sdp->iqueue, bp, n);
+  if (w < n)
+    chnAddFlagsI(sdp, SD_OVERRUN_ERROR);
+  return w;
+}
+
+/**
+ * @brief   Handles a block of outgoing data.
+ * @details Must be called from the output interrupt service routine of
+ *          low level drivers moving data in blocks in order to get the
+ *          next span of data to be transmitted.
+ *
+ * @param[in] sdp       pointer to a @p SerialDriver structure
+ * @param[out] bp       pointer to the transmit buffer
+ * @param[in] n         size of the transmit buffer
+ * @return              The number of bytes copied in the transmit buffer.
+ * @retval 0            if the queue is empty (the lower driver usually
+ *                      disables the interrupt source when this happens).
+ *
+ * @iclass
+ */
+size_t sdRequestBlockI(SerialDriver *sdp, uint8_t *bp, size_t n) {
+  size_t r;
+
+  chDbgCheckClassI();
+  chDbgCheck((sdp != NULL) && (bp != NULL), "sdRequestBlockI");
+
+  r = chOQGetBlockI(&sdp->oqueue, bp, n);
+  if (r == 0)
+    chnAddFlagsI(sdp, CHN_OUTPUT_EMPTY);
+  return r;
+}
+#endif /* SERIAL_USE_BLOCK_MODE */
+
 #endif /* HAL_USE_SERIAL */
 
 /** @} */
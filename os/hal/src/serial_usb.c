@@ -106,11 +106,96 @@ static const struct SerialUSBDriverVMT vmt = {
   putt, gett, writet, readt
 };
 
+#if SERIAL_USB_USE_HIGH_THROUGHPUT || defined(__DOXYGEN__)
+/**
+ * @brief   Starts an IN transfer.
+ * @details The transfer takes all the data in the output queue up to
+ *          @p SERIAL_USB_TRANSFER_SIZE bytes. If the queue is empty and
+ *          the previous transfer ended with a full packet then a zero
+ *          sized packet is sent in order to terminate it.
+ * @note    The endpoint must be idle, the buffer is prepared without
+ *          leaving the critical zone so that a concurrent notification
+ *          cannot start another transfer on the same buffer.
+ *
+ * @param[in] sdup      pointer to a @p SerialUSBDriver object
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] ep        endpoint number
+ */
+static void start_transmit(SerialUSBDriver *sdup, USBDriver *usbp,
+                           usbep_t ep) {
+  size_t n, last;
+
+  last = usbp->epc[ep]->in_state->txsize;
+  n = chOQGetBlockI(&sdup->oqueue, sdup->txbuf, SERIAL_USB_TRANSFER_SIZE);
+  if ((n == 0) &&
+      ((last == 0) || ((last % usbp->epc[ep]->in_maxsize) != 0)))
+    return;
+
+  /* Note, the zero sized packet case is handled here too, an empty
+     transfer is a single zero sized packet. See section 5.8.3 Bulk
+     Transfer Packet Size Constraints of the USB Specification document.*/
+  usbPrepareTransmit(usbp, ep, sdup->txbuf, n);
+  usbStartTransmitI(usbp, ep);
+}
+
+/**
+ * @brief   Moves the received OUT transfers into the input queue.
+ * @details A buffer is released when it has been completely moved, the
+ *          transfers are partially moved if the queue has not enough
+ *          space.
+ *
+ * @param[in] sdup      pointer to a @p SerialUSBDriver object
+ * @return              The number of bytes moved into the queue.
+ */
+static size_t drain_receive(SerialUSBDriver *sdup) {
+  size_t n, total = 0;
+
+  while (sdup->rxfull > 0) {
+    n = chIQPutBlockI(&sdup->iqueue,
+                      sdup->rxbuf[sdup->rxhead] + sdup->rxoffset,
+                      sdup->rxsize[sdup->rxhead] - sdup->rxoffset);
+    total += n;
+    sdup->rxoffset += n;
+    if (sdup->rxoffset < sdup->rxsize[sdup->rxhead])
+      break;
+    sdup->rxoffset = 0;
+    sdup->rxhead ^= 1;
+    sdup->rxfull--;
+  }
+  return total;
+}
+
+/**
+ * @brief   Starts an OUT transfer into the next free buffer.
+ * @details Nothing is done if the endpoint is already receiving or if
+ *          both buffers are waiting to be moved into the input queue.
+ * @note    The transfers are one packet long, CDC hosts do not terminate
+ *          the OUT transfers with a zero length packet so a longer
+ *          transfer would hold the data until the buffer is filled.
+ *
+ * @param[in] sdup      pointer to a @p SerialUSBDriver object
+ * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] ep        endpoint number
+ */
+static void start_receive(SerialUSBDriver *sdup, USBDriver *usbp,
+                          usbep_t ep) {
+
+  if ((sdup->rxfull >= 2) || usbGetReceiveStatusI(usbp, ep))
+    return;
+
+  usbPrepareReceive(usbp, ep, sdup->rxbuf[(sdup->rxhead + sdup->rxfull) & 1],
+                    usbp->epc[ep]->out_maxsize);
+  usbStartReceiveI(usbp, ep);
+}
+#endif /* SERIAL_USB_USE_HIGH_THROUGHPUT */
+
 /**
  * @brief   Notification of data removed from the input queue.
  */
 static void inotify(GenericQueue *qp) {
+#if !SERIAL_USB_USE_HIGH_THROUGHPUT
   size_t n, maxsize;
+#endif
   SerialUSBDriver *sdup = chQGetLink(qp);
 
   /* If the USB driver is not in the appropriate state then transactions
@@ -119,6 +204,12 @@ static void inotify(GenericQueue *qp) {
       (sdup->state != SDU_READY))
     return;
 
+#if SERIAL_USB_USE_HIGH_THROUGHPUT
+  /* The space freed in the queue is used for the received transfers, a
+     buffer released this way is immediately armed again.*/
+  drain_receive(sdup);
+  start_receive(sdup, sdup->config->usbp, sdup->config->bulk_out);
+#else /* !SERIAL_USB_USE_HIGH_THROUGHPUT */
   /* If there is in the queue enough space to hold at least one packet and
      a transaction is not yet started then a new transaction is started for
      the available space.*/
@@ -135,13 +226,16 @@ static void inotify(GenericQueue *qp) {
     chSysLock();
     usbStartReceiveI(sdup->config->usbp, sdup->config->bulk_out);
   }
+#endif /* !SERIAL_USB_USE_HIGH_THROUGHPUT */
 }
 
 /**
  * @brief   Notification of data inserted into the output queue.
  */
 static void onotify(GenericQueue *qp) {
+#if !SERIAL_USB_USE_HIGH_THROUGHPUT
   size_t n;
+#endif
   SerialUSBDriver *sdup = chQGetLink(qp);
 
   /* If the USB driver is not in the appropriate state then transactions
@@ -150,6 +244,12 @@ static void onotify(GenericQueue *qp) {
       (sdup->state != SDU_READY))
     return;
 
+#if SERIAL_USB_USE_HIGH_THROUGHPUT
+  /* If there is not an ongoing transfer then a new one is started, the
+     data written while it is in progress is sent by the next transfer.*/
+  if (!usbGetTransmitStatusI(sdup->config->usbp, sdup->config->bulk_in))
+    start_transmit(sdup, sdup->config->usbp, sdup->config->bulk_in);
+#else /* !SERIAL_USB_USE_HIGH_THROUGHPUT */
   /* If there is not an ongoing transaction and the output queue contains
      data then a new transaction is started.*/
   if (!usbGetTransmitStatusI(sdup->config->usbp, sdup->config->bulk_in) &&
@@ -163,6 +263,7 @@ static void onotify(GenericQueue *qp) {
     chSysLock();
     usbStartTransmitI(sdup->config->usbp, sdup->config->bulk_in);
   }
+#endif /* !SERIAL_USB_USE_HIGH_THROUGHPUT */
 }
 
 /*===========================================================================*/
@@ -271,10 +372,23 @@ void sduConfigureHookI(SerialUSBDriver *sdup) {
   chOQResetI(&sdup->oqueue);
   chnAddFlagsI(sdup, CHN_CONNECTED);
 
+#if SERIAL_USB_USE_HIGH_THROUGHPUT
+  chDbgAssert((SERIAL_USB_TRANSFER_SIZE %
+               usbp->epc[sdup->config->bulk_out]->out_maxsize) == 0,
+              "sduConfigureHookI(), #1",
+              "transfer size not multiple of the packet size");
+
+  /* Starts the first OUT transfer immediately.*/
+  sdup->rxhead   = 0;
+  sdup->rxfull   = 0;
+  sdup->rxoffset = 0;
+  start_receive(sdup, usbp, sdup->config->bulk_out);
+#else /* !SERIAL_USB_USE_HIGH_THROUGHPUT */
   /* Starts the first OUT transaction immediately.*/
   usbPrepareQueuedReceive(usbp, sdup->config->bulk_out, &sdup->iqueue,
                           usbp->epc[sdup->config->bulk_out]->out_maxsize);
   usbStartReceiveI(usbp, sdup->config->bulk_out);
+#endif /* !SERIAL_USB_USE_HIGH_THROUGHPUT */
 }
 
 /**
@@ -322,7 +436,9 @@ bool_t sduRequestsHook(USBDriver *usbp) {
  * @param[in] ep        endpoint number
  */
 void sduDataTransmitted(USBDriver *usbp, usbep_t ep) {
+#if !SERIAL_USB_USE_HIGH_THROUGHPUT
   size_t n;
+#endif
   SerialUSBDriver *sdup = usbp->in_params[ep - 1];
 
   if (sdup == NULL)
@@ -331,6 +447,10 @@ void sduDataTransmitted(USBDriver *usbp, usbep_t ep) {
   chSysLockFromIsr();
   chnAddFlagsI(sdup, CHN_OUTPUT_EMPTY);
 
+#if SERIAL_USB_USE_HIGH_THROUGHPUT
+  /* The endpoint cannot be busy, we are in the context of the callback.*/
+  start_transmit(sdup, usbp, ep);
+#else /* !SERIAL_USB_USE_HIGH_THROUGHPUT */
   if ((n = chOQGetFullI(&sdup->oqueue)) > 0) {
     /* The endpoint cannot be busy, we are in the context of the callback,
        so it is safe to transmit without a check.*/
@@ -355,6 +475,7 @@ void sduDataTransmitted(USBDriver *usbp, usbep_t ep) {
     chSysLockFromIsr();
     usbStartTransmitI(usbp, ep);
   }
+#endif /* !SERIAL_USB_USE_HIGH_THROUGHPUT */
 
   chSysUnlockFromIsr();
 }
@@ -368,13 +489,27 @@ void sduDataTransmitted(USBDriver *usbp, usbep_t ep) {
  * @param[in] ep        endpoint number
  */
 void sduDataReceived(USBDriver *usbp, usbep_t ep) {
+#if !SERIAL_USB_USE_HIGH_THROUGHPUT
   size_t n, maxsize;
+#endif
   SerialUSBDriver *sdup = usbp->out_params[ep - 1];
 
   if (sdup == NULL)
     return;
 
   chSysLockFromIsr();
+
+#if SERIAL_USB_USE_HIGH_THROUGHPUT
+  /* The completed buffer is moved into the input queue as far as there
+     is space, then the next free buffer is armed so that the host can
+     continue sending while a thread is draining the queue.*/
+  sdup->rxsize[(sdup->rxhead + sdup->rxfull) & 1] =
+      usbGetReceiveTransactionSizeI(usbp, ep);
+  sdup->rxfull++;
+  if (drain_receive(sdup) > 0)
+    chnAddFlagsI(sdup, CHN_INPUT_AVAILABLE);
+  start_receive(sdup, usbp, ep);
+#else /* !SERIAL_USB_USE_HIGH_THROUGHPUT */
   chnAddFlagsI(sdup, CHN_INPUT_AVAILABLE);
 
   /* Writes to the input queue can only happen when there is enough space
@@ -391,6 +526,7 @@ void sduDataReceived(USBDriver *usbp, usbep_t ep) {
     chSysLockFromIsr();
     usbStartReceiveI(usbp, ep);
   }
+#endif /* !SERIAL_USB_USE_HIGH_THROUGHPUT */
 
   chSysUnlockFromIsr();
 }
@@ -47,6 +47,112 @@
 /* Driver local functions.                                                   */
 /*===========================================================================*/
 
+#if SPI_USE_TRANSACTIONS || defined(__DOXYGEN__)
+static void txn_delay_cb(void *p);
+
+/**
+ * @brief   Makes a transaction the current one.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ * @param[in] stp       pointer to the @p SPITransaction object
+ *
+ * @notapi
+ */
+static void txn_activate_i(SPIDriver *spip, SPITransaction *stp) {
+
+  spip->txncur = stp;
+  stp->index = 0;
+  if ((stp->config != NULL) && (stp->config != spip->config)) {
+    spip->config = stp->config;
+    spi_lld_start(spip);
+  }
+}
+
+/**
+ * @brief   Transactions engine.
+ * @details Executes the segments of the current transaction until an
+ *          asynchronous operation is started, completed transactions are
+ *          notified and the next one is taken from the queue.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ *
+ * @notapi
+ */
+static void txn_run_i(SPIDriver *spip) {
+  SPITransaction *stp;
+
+  while ((stp = spip->txncur) != NULL) {
+    while (stp->index < stp->n) {
+      const SPISegment *ssp = &stp->segments[stp->index++];
+
+      switch (ssp->op) {
+      case SPI_SEG_SELECT:
+        spi_lld_select(spip);
+        break;
+      case SPI_SEG_UNSELECT:
+        spi_lld_unselect(spip);
+        break;
+      case SPI_SEG_IGNORE:
+        spi_lld_ignore(spip, ssp->n);
+        return;
+      case SPI_SEG_EXCHANGE:
+        spi_lld_exchange(spip, ssp->n, ssp->txbuf, ssp->rxbuf);
+        return;
+      case SPI_SEG_SEND:
+        spi_lld_send(spip, ssp->n, ssp->txbuf);
+        return;
+      case SPI_SEG_RECEIVE:
+        spi_lld_receive(spip, ssp->n, ssp->rxbuf);
+        return;
+      case SPI_SEG_DELAY:
+        if (ssp->n != 0) {
+          chVTSetI(&spip->txnvt, (systime_t)ssp->n, txn_delay_cb, spip);
+          return;
+        }
+        break;
+      default:
+        chDbgAssert(FALSE, "txn_run_i(), #1", "invalid segment");
+      }
+    }
+
+    /* Transaction completed, the callback can queue further transactions
+       because the driver is still busy.*/
+    stp->pending = FALSE;
+    if (stp->end_cb != NULL)
+      stp->end_cb(spip, stp);
+    if (stp->thread != NULL) {
+      Thread *tp = stp->thread;
+      stp->thread = NULL;
+      tp->p_u.rdymsg = RDY_OK;
+      chSchReadyI(tp);
+    }
+
+    /* Next transaction in priority order.*/
+    spip->txncur = NULL;
+    if (spip->txnqueue != NULL) {
+      stp = spip->txnqueue;
+      spip->txnqueue = stp->next;
+      txn_activate_i(spip, stp);
+    }
+  }
+  spip->state = SPI_READY;
+}
+
+/**
+ * @brief   Delay segment end.
+ *
+ * @param[in] p         pointer to the @p SPIDriver object
+ *
+ * @notapi
+ */
+static void txn_delay_cb(void *p) {
+
+  chSysLockFromIsr();
+  txn_run_i((SPIDriver *)p);
+  chSysUnlockFromIsr();
+}
+#endif /* SPI_USE_TRANSACTIONS */
+
 /*===========================================================================*/
 /* Driver exported functions.                                                */
 /*===========================================================================*/
@@ -77,6 +183,10 @@ void spiObjectInit(SPIDriver *spip) {
 #if SPI_USE_WAIT
   spip->thread = NULL;
 #endif /* SPI_USE_WAIT */
+#if SPI_USE_TRANSACTIONS
+  spip->txncur = NULL;
+  spip->txnqueue = NULL;
+#endif /* SPI_USE_TRANSACTIONS */
 #if SPI_USE_MUTUAL_EXCLUSION
 #if CH_USE_MUTEXES
   chMtxInit(&spip->mutex);
@@ -434,6 +544,128 @@ void spiReleaseBus(SPIDriver *spip) {
 }
 #endif /* SPI_USE_MUTUAL_EXCLUSION */
 
+#if SPI_USE_TRANSACTIONS || defined(__DOXYGEN__)
+/**
+ * @brief   Queues a transaction.
+ * @details The transaction is started immediately if the driver is idle
+ *          else it is queued, queued transactions are executed in order
+ *          of priority then in FIFO order. The segments are executed back
+ *          to back from the driver ISR.
+ * @pre     In order to use this function the option
+ *          @p SPI_USE_TRANSACTIONS must be enabled.
+ * @pre     The @p prio field of the transaction must have been set.
+ * @note    Transactions and single operations must not overlap, single
+ *          operations can be started only when no transactions are
+ *          pending.
+ * @note    The transaction object must not be modified until completion.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ * @param[in] stp       pointer to the @p SPITransaction object
+ *
+ * @iclass
+ */
+void spiStartTransactionI(SPIDriver *spip, SPITransaction *stp) {
+
+  chDbgCheckClassI();
+  chDbgCheck((spip != NULL) && (stp != NULL) &&
+             ((stp->segments != NULL) || (stp->n == 0)),
+             "spiStartTransactionI");
+  chDbgAssert((spip->state == SPI_READY) || (spip->txncur != NULL),
+              "spiStartTransactionI(), #1", "not ready");
+  chDbgAssert(!stp->pending,
+              "spiStartTransactionI(), #2", "already pending");
+
+  stp->pending = TRUE;
+  if (spip->txncur == NULL) {
+    spip->state = SPI_ACTIVE;
+    txn_activate_i(spip, stp);
+    txn_run_i(spip);
+  }
+  else {
+    SPITransaction **pp = &spip->txnqueue;
+
+    while ((*pp != NULL) && ((*pp)->prio >= stp->prio))
+      pp = &(*pp)->next;
+    stp->next = *pp;
+    *pp = stp;
+  }
+}
+
+/**
+ * @brief   Queues a transaction.
+ * @details The transaction is queued with the priority of the invoking
+ *          thread, the function does not wait for completion, the
+ *          transaction callback is invoked at the end.
+ * @pre     In order to use this function the option
+ *          @p SPI_USE_TRANSACTIONS must be enabled.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ * @param[in] stp       pointer to the @p SPITransaction object
+ *
+ * @api
+ */
+void spiStartTransaction(SPIDriver *spip, SPITransaction *stp) {
+
+  chDbgCheck((spip != NULL) && (stp != NULL), "spiStartTransaction");
+
+  chSysLock();
+  stp->prio = chThdGetPriority();
+  stp->thread = NULL;
+  spiStartTransactionI(spip, stp);
+  chSchRescheduleS();
+  chSysUnlock();
+}
+
+/**
+ * @brief   Executes a transaction.
+ * @details The transaction is queued with the priority of the invoking
+ *          thread and the thread is suspended until the transaction has
+ *          been executed.
+ * @pre     In order to use this function the option
+ *          @p SPI_USE_TRANSACTIONS must be enabled.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ * @param[in] stp       pointer to the @p SPITransaction object
+ * @return              The operation status.
+ * @retval RDY_OK       the transaction has been executed.
+ *
+ * @api
+ */
+msg_t spiTransaction(SPIDriver *spip, SPITransaction *stp) {
+
+  chDbgCheck((spip != NULL) && (stp != NULL), "spiTransaction");
+
+  chSysLock();
+  stp->prio = chThdGetPriority();
+  stp->thread = NULL;
+  spiStartTransactionI(spip, stp);
+  if (stp->pending) {
+    stp->thread = chThdSelf();
+    chSchGoSleepS(THD_STATE_SUSPENDED);
+  }
+  else
+    chSchRescheduleS();
+  chSysUnlock();
+  return RDY_OK;
+}
+
+/**
+ * @brief   Transactions ISR code.
+ * @details Continues the current transaction, invoked by the common ISR
+ *          code when an operation belonging to a transaction ends.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ *
+ * @notapi
+ */
+void _spi_txn_isr(SPIDriver *spip) {
+
+  chSysLockFromIsr();
+  txn_run_i(spip);
+  chSysUnlockFromIsr();
+}
+#endif /* SPI_USE_TRANSACTIONS */
+
 #endif /* HAL_USE_SPI */
 
 /** @} */
@@ -48,6 +48,18 @@
  */
 static halrtcnt_t measurement_offset;
 
+#if TM_USE_PROFILING || defined(__DOXYGEN__)
+/**
+ * @brief   Profiling calibration value.
+ */
+static halrtcnt_t profile_offset;
+
+/**
+ * @brief   Registered profiling points.
+ */
+static TimeProfile *profiles;
+#endif
+
 /*===========================================================================*/
 /* Driver local functions.                                                   */
 /*===========================================================================*/
@@ -81,6 +93,50 @@ static void tm_stop(TimeMeasurement *tmp) {
       tmp->best = tmp->last;
 }
 
+#if TM_USE_PROFILING || defined(__DOXYGEN__)
+/**
+ * @brief   Time elapsed since a profiled interval start.
+ * @details The calibration value is subtracted, the result is clamped to
+ *          zero.
+ *
+ * @param[in] start     the interval start time
+ * @return              The interval in ticks.
+ *
+ * @notapi
+ */
+static halrtcnt_t profile_elapsed(halrtcnt_t start) {
+  halrtcnt_t ticks = halGetCounterValue() - start;
+
+  return ticks > profile_offset ? ticks - profile_offset : 0;
+}
+
+/**
+ * @brief   Clears the statistics of a profiling point.
+ *
+ * @param[out] pp       pointer to a @p TimeProfile structure
+ *
+ * @notapi
+ */
+static void profile_clear(TimeProfile *pp) {
+  unsigned i;
+
+  pp->stats.count = 0;
+  pp->stats.min   = (halrtcnt_t)-1;
+  pp->stats.max   = 0;
+  pp->stats.sum   = 0;
+  for (i = 0; i < TM_PROFILE_BUCKETS; i++)
+    pp->stats.hist[i] = 0;
+  for (i = 0; i < TM_PROFILE_THREADS; i++) {
+    pp->stats.threads[i].thread = NULL;
+    pp->stats.threads[i].count  = 0;
+    pp->stats.threads[i].sum    = 0;
+  }
+  pp->stats.others.thread = NULL;
+  pp->stats.others.count  = 0;
+  pp->stats.others.sum    = 0;
+}
+#endif /* TM_USE_PROFILING */
+
 /*===========================================================================*/
 /* Driver interrupt handlers.                                                */
 /*===========================================================================*/
@@ -96,15 +152,34 @@ static void tm_stop(TimeMeasurement *tmp) {
  */
 void tmInit(void) {
   TimeMeasurement tm;
+  halrtcnt_t best;
+  unsigned i;
 
-  /* Time Measurement subsystem calibration, it does a null measurement
-     and calculates the call overhead which is subtracted to real
-     measurements.*/
+  /* Time Measurement subsystem calibration, it does null measurements
+     and takes the smallest call overhead which is subtracted to real
+     measurements, the first runs are affected by the cold caches.*/
   measurement_offset = 0;
   tmObjectInit(&tm);
-  tmStartMeasurement(&tm);
-  tmStopMeasurement(&tm);
-  measurement_offset = tm.last;
+  best = (halrtcnt_t)-1;
+  for (i = 0; i < TM_CALIBRATION_RUNS; i++) {
+    tmStartMeasurement(&tm);
+    tmStopMeasurement(&tm);
+    if (tm.last < best)
+      best = tm.last;
+  }
+  measurement_offset = best;
+
+#if TM_USE_PROFILING
+  profile_offset = 0;
+  best = (halrtcnt_t)-1;
+  for (i = 0; i < TM_CALIBRATION_RUNS; i++) {
+    halrtcnt_t ticks = profile_elapsed(tmProfileBegin());
+    if (ticks < best)
+      best = ticks;
+  }
+  profile_offset = best;
+  profiles = NULL;
+#endif
 }
 
 /**
@@ -123,6 +198,182 @@ void tmObjectInit(TimeMeasurement *tmp) {
   tmp->best  = (halrtcnt_t)-1;
 }
 
+#if TM_USE_PROFILING || defined(__DOXYGEN__)
+/**
+ * @brief   Initializes and registers a profiling point.
+ * @note    The point cannot be unregistered, it must be a static object.
+ *
+ * @param[out] pp       pointer to a @p TimeProfile structure
+ * @param[in] name      point name
+ *
+ * @init
+ */
+void tmProfileObjectInit(TimeProfile *pp, const char *name) {
+
+  chDbgCheck((pp != NULL) && (name != NULL), "tmProfileObjectInit");
+
+  pp->name = name;
+  profile_clear(pp);
+  chSysLock();
+  pp->next = profiles;
+  profiles = pp;
+  chSysUnlock();
+}
+
+/**
+ * @brief   Ends a profiled interval.
+ * @details The interval is attributed to the current thread.
+ *
+ * @param[in] pp        pointer to a @p TimeProfile structure
+ * @param[in] start     the interval start time returned by
+ *                      @p tmProfileBegin()
+ *
+ * @api
+ */
+void tmProfileEnd(TimeProfile *pp, halrtcnt_t start) {
+  halrtcnt_t ticks = profile_elapsed(start);
+
+  chSysLock();
+  tmProfileRecordI(pp, ticks, chThdSelf());
+  chSysUnlock();
+}
+
+/**
+ * @brief   Ends a profiled interval.
+ * @details The interval is attributed to the interrupt and locked
+ *          contexts.
+ *
+ * @param[in] pp        pointer to a @p TimeProfile structure
+ * @param[in] start     the interval start time returned by
+ *                      @p tmProfileBegin()
+ *
+ * @iclass
+ */
+void tmProfileEndI(TimeProfile *pp, halrtcnt_t start) {
+
+  tmProfileRecordI(pp, profile_elapsed(start), NULL);
+}
+
+/**
+ * @brief   Records an interval.
+ * @details This function can be used for intervals measured by other
+ *          means, the calibration value is not subtracted.
+ *
+ * @param[in] pp        pointer to a @p TimeProfile structure
+ * @param[in] ticks     the interval in ticks
+ * @param[in] tp        thread the interval is attributed to or @p NULL
+ *
+ * @iclass
+ */
+void tmProfileRecordI(TimeProfile *pp, halrtcnt_t ticks, Thread *tp) {
+  TimeProfileThread *ptp;
+  halrtcnt_t v;
+  unsigned i;
+
+  chDbgCheckClassI();
+  chDbgCheck(pp != NULL, "tmProfileRecordI");
+
+  pp->stats.count++;
+  pp->stats.sum += ticks;
+  if (ticks < pp->stats.min)
+    pp->stats.min = ticks;
+  if (ticks > pp->stats.max)
+    pp->stats.max = ticks;
+
+  /* The bucket is the number of significant bits.*/
+  for (i = 0, v = ticks; (v != 0) && (i < TM_PROFILE_BUCKETS - 1); i++)
+    v >>= 1;
+  pp->stats.hist[i]++;
+
+  /* Slots are assigned to the threads in order of appearance.*/
+  ptp = &pp->stats.others;
+  for (i = 0; i < TM_PROFILE_THREADS; i++) {
+    if (pp->stats.threads[i].count == 0) {
+      pp->stats.threads[i].thread = tp;
+      ptp = &pp->stats.threads[i];
+      break;
+    }
+    if (pp->stats.threads[i].thread == tp) {
+      ptp = &pp->stats.threads[i];
+      break;
+    }
+  }
+  ptp->count++;
+  ptp->sum += ticks;
+}
+
+/**
+ * @brief   Returns a consistent copy of the statistics of a point.
+ *
+ * @param[in] pp        pointer to a @p TimeProfile structure
+ * @param[out] sp       pointer to a @p TimeProfileStats structure
+ *
+ * @api
+ */
+void tmProfileGetStats(TimeProfile *pp, TimeProfileStats *sp) {
+
+  chDbgCheck((pp != NULL) && (sp != NULL), "tmProfileGetStats");
+
+  chSysLock();
+  *sp = pp->stats;
+  chSysUnlock();
+}
+
+/**
+ * @brief   Resets the statistics of a point.
+ *
+ * @param[in] pp        pointer to a @p TimeProfile structure
+ *
+ * @api
+ */
+void tmProfileReset(TimeProfile *pp) {
+
+  chDbgCheck(pp != NULL, "tmProfileReset");
+
+  chSysLock();
+  profile_clear(pp);
+  chSysUnlock();
+}
+
+/**
+ * @brief   Resets the statistics of all the registered points.
+ *
+ * @api
+ */
+void tmProfileResetAll(void) {
+  TimeProfile *pp;
+
+  for (pp = tmProfileFirst(); pp != NULL; pp = tmProfileNext(pp))
+    tmProfileReset(pp);
+}
+
+/**
+ * @brief   Returns the last registered profiling point.
+ * @details The other points are reached using @p tmProfileNext().
+ *
+ * @return              The first point in the list or @p NULL.
+ *
+ * @api
+ */
+TimeProfile *tmProfileFirst(void) {
+
+  return profiles;
+}
+
+/**
+ * @brief   Returns the profiling calibration value.
+ *
+ * @return              The overhead subtracted from each interval, in
+ *                      ticks.
+ *
+ * @api
+ */
+halrtcnt_t tmProfileGetOffset(void) {
+
+  return profile_offset;
+}
+#endif /* TM_USE_PROFILING */
+
 #endif /* HAL_USE_TM */
 
 /** @} */
@@ -179,6 +179,44 @@ struct DACDriver {
   Semaphore                 semaphore;
 #endif
 #endif /* DAC_USE_MUTUAL_EXCLUSION */
+#if DAC_USE_STREAMING || defined(__DOXYGEN__)
+  /**
+   * @brief   Current stream configuration or @p NULL.
+   */
+  const DACStreamConfig     *strcfg;
+  /**
+   * @brief   Ring read position in rows.
+   */
+  size_t                    strrd;
+  /**
+   * @brief   Rows in the ring.
+   */
+  size_t                    strcount;
+  /**
+   * @brief   The conversion has been started.
+   */
+  bool_t                    strstarted;
+  /**
+   * @brief   The stream is being drained, empty ring is not an underrun.
+   */
+  bool_t                    strdraining;
+  /**
+   * @brief   Refilled half buffers counter.
+   */
+  uint32_t                  strhalves;
+  /**
+   * @brief   Producer thread waiting for space.
+   */
+  Thread                    *strthread;
+  /**
+   * @brief   Stream events source.
+   */
+  EventSource               strevent;
+  /**
+   * @brief   Stream statistics.
+   */
+  DACStreamStats            strstats;
+#endif /* DAC_USE_STREAMING */
 #if defined(DAC_DRIVER_EXT_FIELDS)
   DAC_DRIVER_EXT_FIELDS
 #endif
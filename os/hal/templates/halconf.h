@@ -75,6 +75,13 @@
 #define HAL_USE_EXT                 TRUE
 #endif
 
+/**
+ * @brief   Enables the FTL subsystem.
+ */
+#if !defined(HAL_USE_FTL) || defined(__DOXYGEN__)
+#define HAL_USE_FTL                 TRUE
+#endif
+
 /**
  * @brief   Enables the GPT subsystem.
  */
@@ -191,6 +198,22 @@
 #endif
 /** @} */
 
+/*===========================================================================*/
+/**
+ * @name DAC driver related setting
+ * @{
+ */
+/*===========================================================================*/
+
+/**
+ * @brief   Enables the streaming APIs.
+ * @note    Disabling this option saves both code and data space.
+ */
+#if !defined(DAC_USE_STREAMING) || defined(__DOXYGEN__)
+#define DAC_USE_STREAMING           FALSE
+#endif
+/** @} */
+
 /*===========================================================================*/
 /**
  * @name CAN driver related setting
@@ -204,6 +227,30 @@
 #if !defined(CAN_USE_SLEEP_MODE) || defined(__DOXYGEN__)
 #define CAN_USE_SLEEP_MODE          TRUE
 #endif
+
+/**
+ * @brief   Software queues inclusion switch.
+ */
+#if !defined(CAN_USE_QUEUES) || defined(__DOXYGEN__)
+#define CAN_USE_QUEUES              FALSE
+#endif
+/** @} */
+
+/*===========================================================================*/
+/**
+ * @name FTL driver related setting
+ * @{
+ */
+/*===========================================================================*/
+
+/**
+ * @brief   Static wear leveling threshold.
+ * @details Maximum allowed difference between the erase counters of the
+ *          most and least worn sectors before cold data is moved.
+ */
+#if !defined(FTL_WEAR_LEVELING_THRESHOLD) || defined(__DOXYGEN__)
+#define FTL_WEAR_LEVELING_THRESHOLD 32
+#endif
 /** @} */
 
 /*===========================================================================*/
@@ -219,6 +266,29 @@
 #if !defined(I2C_USE_MUTUAL_EXCLUSION) || defined(__DOXYGEN__)
 #define I2C_USE_MUTUAL_EXCLUSION    TRUE
 #endif
+
+/**
+ * @brief   Enables the asynchronous transactions APIs.
+ */
+#if !defined(I2C_USE_TRANSACTIONS) || defined(__DOXYGEN__)
+#define I2C_USE_TRANSACTIONS        FALSE
+#endif
+/** @} */
+
+/*===========================================================================*/
+/**
+ * @name ICU driver related setting
+ * @{
+ */
+/*===========================================================================*/
+
+/**
+ * @brief   Enables the capture APIs.
+ * @note    Disabling this option saves both code and data space.
+ */
+#if !defined(ICU_USE_CAPTURE) || defined(__DOXYGEN__)
+#define ICU_USE_CAPTURE             FALSE
+#endif
 /** @} */
 
 /*===========================================================================*/
@@ -324,6 +394,16 @@
 #if !defined(SERIAL_BUFFERS_SIZE) || defined(__DOXYGEN__)
 #define SERIAL_BUFFERS_SIZE         16
 #endif
+
+/**
+ * @brief   Block transfers enable switch.
+ * @details If set to @p TRUE the low level drivers supporting it move data
+ *          in blocks instead of one byte per interrupt.
+ * @note    The default is @p FALSE.
+ */
+#if !defined(SERIAL_USE_BLOCK_MODE) || defined(__DOXYGEN__)
+#define SERIAL_USE_BLOCK_MODE       FALSE
+#endif
 /** @} */
 
 /*===========================================================================*/
@@ -343,6 +423,23 @@
 #if !defined(SERIAL_USB_BUFFERS_SIZE) || defined(__DOXYGEN__)
 #define SERIAL_USB_BUFFERS_SIZE     64
 #endif
+
+/**
+ * @brief   Enables the multi-packet transfers and double buffered OUT
+ *          endpoint.
+ */
+#if !defined(SERIAL_USB_USE_HIGH_THROUGHPUT) || defined(__DOXYGEN__)
+#define SERIAL_USB_USE_HIGH_THROUGHPUT  FALSE
+#endif
+
+/**
+ * @brief   Maximum size of a multi-packet transfer.
+ * @details Configuration parameter, the size must be a multiple of the
+ *          USB data endpoint maximum packet size.
+ */
+#if !defined(SERIAL_USB_TRANSFER_SIZE) || defined(__DOXYGEN__)
+#define SERIAL_USB_TRANSFER_SIZE    512
+#endif
 /** @} */
 
 /*===========================================================================*/
@@ -367,6 +464,30 @@
 #if !defined(SPI_USE_MUTUAL_EXCLUSION) || defined(__DOXYGEN__)
 #define SPI_USE_MUTUAL_EXCLUSION    TRUE
 #endif
+
+/**
+ * @brief   Enables the transactions queue APIs.
+ * @note    Disabling this option saves both code and data space.
+ */
+#if !defined(SPI_USE_TRANSACTIONS) || defined(__DOXYGEN__)
+#define SPI_USE_TRANSACTIONS        FALSE
+#endif
+/** @} */
+
+/*===========================================================================*/
+/**
+ * @name TM driver related setting
+ * @{
+ */
+/*===========================================================================*/
+
+/**
+ * @brief   Enables the profiling APIs.
+ * @note    Disabling this option saves both code and data space.
+ */
+#if !defined(TM_USE_PROFILING) || defined(__DOXYGEN__)
+#define TM_USE_PROFILING            FALSE
+#endif
 /** @} */
 
 #endif /* _HALCONF_H_ */
@@ -189,6 +189,49 @@ msg_t i2c_lld_master_transmit_timeout(I2CDriver *i2cp, i2caddr_t addr,
   return RDY_OK;
 }
 
+#if I2C_USE_TRANSACTIONS || defined(__DOXYGEN__)
+/**
+ * @brief   Starts an asynchronous transaction.
+ * @details The operation end is notified by calling @p _i2c_txn_isr() from
+ *          the driver ISR.
+ * @note    This function is invoked from a critical zone and can be
+ *          invoked from ISR context.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] addr      slave device address
+ * @param[in] txbuf     pointer to the transmit buffer
+ * @param[in] txbytes   number of bytes to be transmitted, zero for a read
+ *                      only transaction
+ * @param[out] rxbuf    pointer to the receive buffer
+ * @param[in] rxbytes   number of bytes to be received
+ *
+ * @notapi
+ */
+void i2c_lld_start_transaction(I2CDriver *i2cp, i2caddr_t addr,
+                               const uint8_t *txbuf, size_t txbytes,
+                               uint8_t *rxbuf, size_t rxbytes) {
+
+  (void)i2cp;
+  (void)addr;
+  (void)txbuf;
+  (void)txbytes;
+  (void)rxbuf;
+  (void)rxbytes;
+}
+
+/**
+ * @brief   Aborts the transaction in progress.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ *
+ * @notapi
+ */
+void i2c_lld_abort_transaction(I2CDriver *i2cp) {
+
+  (void)i2cp;
+}
+#endif /* I2C_USE_TRANSACTIONS */
+
 #endif /* HAL_USE_I2C */
 
 /** @} */
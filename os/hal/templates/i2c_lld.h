@@ -31,6 +31,11 @@
 /* Driver constants.                                                         */
 /*===========================================================================*/
 
+/**
+ * @brief   This implementation supports the transactions queue.
+ */
+#define I2C_SUPPORTS_TRANSACTIONS   TRUE
+
 /*===========================================================================*/
 /* Driver pre-compile time settings.                                         */
 /*===========================================================================*/
@@ -53,6 +58,10 @@
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
 
+#if I2C_USE_TRANSACTIONS && !I2C_SUPPORTS_TRANSACTIONS
+#error "I2C transactions not supported in this architecture"
+#endif
+
 /*===========================================================================*/
 /* Driver data structures and types.                                         */
 /*===========================================================================*/
@@ -111,6 +120,20 @@ struct I2CDriver {
   Semaphore                 semaphore;
 #endif
 #endif /* I2C_USE_MUTUAL_EXCLUSION */
+#if I2C_USE_TRANSACTIONS || defined(__DOXYGEN__)
+  /**
+   * @brief   Transaction being executed.
+   */
+  I2CTransaction            *txncur;
+  /**
+   * @brief   Queued transactions in priority order.
+   */
+  I2CTransaction            *txnqueue;
+  /**
+   * @brief   Transactions timeout timer.
+   */
+  VirtualTimer              txnvt;
+#endif /* I2C_USE_TRANSACTIONS */
 #if defined(I2C_DRIVER_EXT_FIELDS)
   I2C_DRIVER_EXT_FIELDS
 #endif
@@ -153,6 +176,12 @@ extern "C" {
   msg_t i2c_lld_master_receive_timeout(I2CDriver *i2cp, i2caddr_t addr,
                                        uint8_t *rxbuf, size_t rxbytes,
                                        systime_t timeout);
+#if I2C_USE_TRANSACTIONS
+  void i2c_lld_start_transaction(I2CDriver *i2cp, i2caddr_t addr,
+                                 const uint8_t *txbuf, size_t txbytes,
+                                 uint8_t *rxbuf, size_t rxbytes);
+  void i2c_lld_abort_transaction(I2CDriver *i2cp);
+#endif /* I2C_USE_TRANSACTIONS */
 #ifdef __cplusplus
 }
 #endif
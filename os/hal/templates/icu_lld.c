@@ -173,6 +173,37 @@ icucnt_t icu_lld_get_period(ICUDriver *icup) {
   return 0;
 }
 
+#if ICU_USE_CAPTURE || defined(__DOXYGEN__)
+/**
+ * @brief   Starts logging the edges into the capture ring.
+ * @details The ring is written circularly starting from the first active
+ *          edge, @p _icu_capture_isr() is invoked each time half ring has
+ *          been written.
+ *
+ * @param[in] icup      pointer to the @p ICUDriver object
+ *
+ * @notapi
+ */
+void icu_lld_start_capture(ICUDriver *icup) {
+
+  (void)icup;
+
+}
+
+/**
+ * @brief   Stops logging the edges.
+ *
+ * @param[in] icup      pointer to the @p ICUDriver object
+ *
+ * @notapi
+ */
+void icu_lld_stop_capture(ICUDriver *icup) {
+
+  (void)icup;
+
+}
+#endif /* ICU_USE_CAPTURE */
+
 #endif /* HAL_USE_ICU */
 
 /** @} */
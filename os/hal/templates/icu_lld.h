@@ -120,6 +120,32 @@ struct ICUDriver {
    * @brief Current configuration data.
    */
   const ICUConfig           *config;
+#if ICU_USE_CAPTURE || defined(__DOXYGEN__)
+  /**
+   * @brief   Current capture configuration or @p NULL.
+   */
+  const ICUCaptureConfig    *capcfg;
+  /**
+   * @brief   Edges reported by the low level driver, free running.
+   */
+  volatile uint32_t         capwr;
+  /**
+   * @brief   Edges fetched by the reader, free running.
+   */
+  uint32_t                  caprd;
+  /**
+   * @brief   Edges awaited by the reader.
+   */
+  size_t                    capwant;
+  /**
+   * @brief   Reader thread waiting for edges.
+   */
+  Thread                    *capthread;
+  /**
+   * @brief   Capture statistics.
+   */
+  ICUCaptureStats           capstats;
+#endif /* ICU_USE_CAPTURE */
 #if defined(ICU_DRIVER_EXT_FIELDS)
   ICU_DRIVER_EXT_FIELDS
 #endif
@@ -148,6 +174,10 @@ extern "C" {
   void icu_lld_disable(ICUDriver *icup);
   icucnt_t icu_lld_get_width(ICUDriver *icup);
   icucnt_t icu_lld_get_period(ICUDriver *icup);
+#if ICU_USE_CAPTURE
+  void icu_lld_start_capture(ICUDriver *icup);
+  void icu_lld_stop_capture(ICUDriver *icup);
+#endif
 #ifdef __cplusplus
 }
 #endif
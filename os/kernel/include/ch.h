@@ -110,6 +110,7 @@
 #include "chsem.h"
 #include "chbsem.h"
 #include "chmtx.h"
+#include "chcmtx.h"
 #include "chcond.h"
 #include "chevents.h"
 #include "chmsg.h"
@@ -117,6 +118,7 @@
 #include "chmemcore.h"
 #include "chheap.h"
 #include "chmempools.h"
+#include "charena.h"
 #include "chthreads.h"
 #include "chdynamic.h"
 #include "chregistry.h"
@@ -127,8 +129,14 @@
 #include "chdebug.h"
 
 #if !defined(__DOXYGEN__)
+#if CH_USE_SMP
+extern stkalign_t _idle_thread_wa[PORT_CORES_NUMBER]
+                                 [THD_WA_SIZE(PORT_IDLE_THREAD_STACK_SIZE) /
+                                  sizeof(stkalign_t)];
+#else
 extern WORKING_AREA(_idle_thread_wa, PORT_IDLE_THREAD_STACK_SIZE);
 #endif
+#endif
 
 #ifdef __cplusplus
 extern "C" {
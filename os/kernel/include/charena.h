@@ -0,0 +1,158 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006,2007,2008,2009,2010,
+                 2011,2012,2013 Giovanni Di Sirio.
+
+    This file is part of ChibiOS/RT.
+
+    ChibiOS/RT is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    ChibiOS/RT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file    charena.h
+ * @brief   Arenas macros and structures.
+ *
+ * @addtogroup arenas
+ * @{
+ */
+
+#ifndef _CHARENA_H_
+#define _CHARENA_H_
+
+#if CH_USE_ARENAS || defined(__DOXYGEN__)
+
+/*
+ * Module dependencies check.
+ */
+#if !CH_USE_HEAP && !CH_USE_MEMPOOLS && !CH_USE_MEMCORE
+#error "CH_USE_ARENAS requires CH_USE_HEAP, CH_USE_MEMPOOLS or CH_USE_MEMCORE"
+#endif
+
+/**
+ * @name    Arena chunks sources
+ * @{
+ */
+#define ARENA_MODE_HEAP     0       /**< @brief Chunks from a heap.         */
+#define ARENA_MODE_MEMPOOL  1       /**< @brief Chunks from a memory pool.  */
+#define ARENA_MODE_CORE     2       /**< @brief Chunks from the memory core.*/
+/** @} */
+
+/**
+ * @brief   Arena chunk header.
+ */
+union arena_chunk {
+  stkalign_t align;
+  struct {
+    union arena_chunk   *next;      /**< @brief Next chunk in the chain.    */
+    uint8_t             *end;       /**< @brief End of the chunk.           */
+  } c;                              /**< @brief Chunk fields.               */
+};
+
+/**
+ * @brief   Structure describing an arena.
+ */
+typedef struct arena {
+  union arena_chunk     *a_first;   /**< @brief First chunk of the chain.   */
+  union arena_chunk     *a_chunk;   /**< @brief Chunk being allocated or
+                                                @p NULL.                    */
+  uint8_t               *a_free;    /**< @brief First free byte in the
+                                                current chunk.              */
+  size_t                a_size;     /**< @brief Size of the chunks.         */
+  void                  *a_source;  /**< @brief Heap, memory pool or memory
+                                                region providing the
+                                                chunks.                     */
+  uint8_t               a_mode;     /**< @brief Chunks source.              */
+} Arena;
+
+/**
+ * @brief   Arena position saved by @p chArenaGetMark().
+ */
+typedef struct {
+  union arena_chunk     *m_chunk;   /**< @brief Current chunk.              */
+  uint8_t               *m_free;    /**< @brief First free byte.            */
+} ArenaMark;
+
+/**
+ * @name    Macro Functions
+ * @{
+ */
+/**
+ * @brief   Saves the current position of an arena.
+ *
+ * @param[in] ap        pointer to the @p Arena structure
+ * @param[out] mkp      pointer to the @p ArenaMark structure
+ *
+ * @api
+ */
+#define chArenaGetMark(ap, mkp) {                                           \
+  (mkp)->m_chunk = (ap)->a_chunk;                                           \
+  (mkp)->m_free = (ap)->a_free;                                             \
+}
+
+/**
+ * @brief   Rewinds an arena to a saved position.
+ * @details All the blocks allocated after the position has been saved are
+ *          freed at once, the chunks are retained for the next
+ *          allocations.
+ * @pre     The position must have been saved after the last reset of the
+ *          arena and not be older than the position of a previous rewind.
+ *
+ * @param[in] ap        pointer to the @p Arena structure
+ * @param[in] mkp       pointer to the @p ArenaMark structure
+ *
+ * @api
+ */
+#define chArenaRewind(ap, mkp) {                                            \
+  (ap)->a_chunk = (mkp)->m_chunk;                                           \
+  (ap)->a_free = (mkp)->m_free;                                             \
+}
+
+/**
+ * @brief   Returns the current arena of the invoking thread.
+ *
+ * @return              The current arena.
+ * @retval NULL         if the thread has no current arena.
+ *
+ * @api
+ */
+#define chArenaGetCurrent() (currp->p_arena)
+/** @} */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if CH_USE_HEAP
+  void chArenaInitHeap(Arena *ap, MemoryHeap *heapp, size_t size);
+#endif
+#if CH_USE_MEMPOOLS
+  void chArenaInitPool(Arena *ap, MemoryPool *mp);
+#endif
+#if CH_USE_MEMCORE
+  void chArenaInitCore(Arena *ap, size_t size);
+#if CH_USE_MEMCORE_REGIONS
+  void chArenaInitRegion(Arena *ap, MemoryRegion *mrp, size_t size);
+#endif
+#endif
+  void *chArenaAlloc(Arena *ap, size_t size);
+  void chArenaReset(Arena *ap);
+  void chArenaRelease(Arena *ap);
+  Arena *chArenaSetCurrent(Arena *ap);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CH_USE_ARENAS */
+
+#endif /* _CHARENA_H_ */
+
+/** @} */
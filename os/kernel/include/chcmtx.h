@@ -0,0 +1,122 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006,2007,2008,2009,2010,
+                 2011,2012,2013 Giovanni Di Sirio.
+
+    This file is part of ChibiOS/RT.
+
+    ChibiOS/RT is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    ChibiOS/RT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file    chcmtx.h
+ * @brief   Ceiling mutexes macros and structures.
+ *
+ * @addtogroup ceiling_mutexes
+ * @{
+ */
+
+#ifndef _CHCMTX_H_
+#define _CHCMTX_H_
+
+#if CH_USE_CEILING_MUTEXES || defined(__DOXYGEN__)
+
+#if !CH_USE_MUTEXES
+#error "CH_USE_CEILING_MUTEXES requires CH_USE_MUTEXES"
+#endif
+
+#if CH_USE_SMP
+#error "CH_USE_CEILING_MUTEXES not supported with CH_USE_SMP"
+#endif
+
+/**
+ * @brief   Ceiling mutex structure.
+ */
+typedef struct CeilingMutex {
+  Thread                *cm_owner;  /**< @brief Owner @p Thread pointer or
+                                                @p NULL.                    */
+  struct CeilingMutex   *cm_next;   /**< @brief Next @p CeilingMutex into an
+                                                owner-list or @p NULL.      */
+  tprio_t               cm_ceiling; /**< @brief Ceiling priority.           */
+  tprio_t               cm_level;   /**< @brief Highest ceiling among this
+                                                mutex and the ones below it
+                                                in the owner-list.          */
+} CeilingMutex;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void chCMtxInit(CeilingMutex *cmp, tprio_t ceiling);
+  void chCMtxLock(CeilingMutex *cmp);
+  void chCMtxLockS(CeilingMutex *cmp);
+  CeilingMutex *chCMtxUnlock(void);
+  CeilingMutex *chCMtxUnlockS(void);
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @brief   Data part of a static ceiling mutex initializer.
+ * @details This macro should be used when statically initializing a
+ *          ceiling mutex that is part of a bigger structure.
+ *
+ * @param[in] name      the name of the mutex variable
+ * @param[in] ceiling   the ceiling priority
+ */
+#define _CEILINGMUTEX_DATA(name, ceiling) {NULL, NULL, (ceiling), 0}
+
+/**
+ * @brief   Static ceiling mutex initializer.
+ * @details Statically initialized ceiling mutexes require no explicit
+ *          initialization using @p chCMtxInit().
+ *
+ * @param[in] name      the name of the mutex variable
+ * @param[in] ceiling   the ceiling priority
+ */
+#define CEILINGMUTEX_DECL(name, ceiling)                                    \
+  CeilingMutex name = _CEILINGMUTEX_DATA(name, ceiling)
+
+/**
+ * @name    Macro Functions
+ * @{
+ */
+/**
+ * @brief   Returns the ceiling priority of a ceiling mutex.
+ *
+ * @param[in] cmp       pointer to the @p CeilingMutex structure
+ * @return              The ceiling priority.
+ *
+ * @iclass
+ */
+#define chCMtxGetCeilingI(cmp) ((cmp)->cm_ceiling)
+/** @} */
+
+/**
+ * @brief   Returns the priority a thread cannot fall below.
+ * @details It is the thread own priority raised to the ceiling of the
+ *          owned ceiling mutexes, if any.
+ *
+ * @notapi
+ */
+#define cmtx_base_prio(tp)                                                  \
+  ((((tp)->p_cmtxlist != NULL) &&                                           \
+    ((tp)->p_cmtxlist->cm_level > (tp)->p_realprio)) ?                      \
+   (tp)->p_cmtxlist->cm_level : (tp)->p_realprio)
+
+#else /* !CH_USE_CEILING_MUTEXES */
+#define cmtx_base_prio(tp) ((tp)->p_realprio)
+#endif /* !CH_USE_CEILING_MUTEXES */
+
+#endif /* _CHCMTX_H_ */
+
+/** @} */
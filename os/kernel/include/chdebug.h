@@ -118,6 +118,8 @@ typedef struct {
   ch_swc_event_t        *tb_ptr;    /**< @brief Pointer to the buffer front.*/
   /** @brief Ring buffer.*/
   ch_swc_event_t        tb_buffer[CH_TRACE_BUFFER_SIZE];
+  /** @brief Number of recorded events, it can overflow.*/
+  uint32_t              tb_count;
 } ch_trace_buffer_t;
 
 #if !defined(__DOXYGEN__)
@@ -64,6 +64,11 @@ union heap_header {
 struct memory_heap {
   memgetfunc_t          h_provider; /**< @brief Memory blocks provider for
                                                 this heap.                  */
+#if CH_USE_MEMCORE_REGIONS || defined(__DOXYGEN__)
+  MemoryRegion          *h_region;  /**< @brief Memory region providing
+                                                blocks to this heap or
+                                                @p NULL.                    */
+#endif
   union heap_header     h_free;     /**< @brief Free blocks list header.    */
 #if CH_USE_MUTEXES
   Mutex                 h_mtx;      /**< @brief Heap access mutex.          */
@@ -78,6 +83,9 @@ extern "C" {
   void _heap_init(void);
 #if !CH_USE_MALLOC_HEAP
   void chHeapInit(MemoryHeap *heapp, void *buf, size_t size);
+#if CH_USE_MEMCORE_REGIONS
+  void chHeapInitRegion(MemoryHeap *heapp, MemoryRegion *mrp);
+#endif
 #endif
   void *chHeapAlloc(MemoryHeap *heapp, size_t size);
   void chHeapFree(void *p);
@@ -66,8 +66,117 @@ typedef void *(*memgetfunc_t)(size_t size);
 #define MEM_IS_ALIGNED(p)   (((size_t)(p) & MEM_ALIGN_MASK) == 0)
 /** @} */
 
+/*
+ * Module dependencies check.
+ */
+#if CH_USE_MEMCORE_REGIONS && !CH_USE_MEMCORE
+#error "CH_USE_MEMCORE_REGIONS requires CH_USE_MEMCORE"
+#endif
+
 #if CH_USE_MEMCORE || defined(__DOXYGEN__)
 
+#if CH_USE_MEMCORE_REGIONS || defined(__DOXYGEN__)
+/**
+ * @name    Memory region attributes
+ * @{
+ */
+/**
+ * @brief   Speed field mask.
+ * @details Higher values are faster memories, values between the
+ *          predefined ones can be used for finer grained placement.
+ */
+#define MEM_SPEED_MASK      0x0F
+
+/**
+ * @brief   External or wait-stated memory.
+ */
+#define MEM_SPEED_SLOW      0x04
+
+/**
+ * @brief   Main system RAM.
+ */
+#define MEM_SPEED_NORMAL    0x08
+
+/**
+ * @brief   Zero wait states memory tightly coupled to the CPU.
+ */
+#define MEM_SPEED_FAST      0x0C
+
+/**
+ * @brief   Memory reachable by the DMA controllers.
+ */
+#define MEM_DMA             0x10
+/** @} */
+
+/**
+ * @brief   Type of a memory region attributes mask.
+ */
+typedef uint8_t memattr_t;
+
+/**
+ * @brief   Structure describing a memory region.
+ */
+typedef struct memory_region {
+  struct memory_region  *mr_next;   /**< @brief Next region in the regions
+                                                list, by decreasing speed.  */
+  const char            *mr_name;   /**< @brief Region name.                */
+  uint8_t               *mr_base;   /**< @brief Region base address.        */
+  uint8_t               *mr_free;   /**< @brief First free byte.            */
+  uint8_t               *mr_end;    /**< @brief Region end address.         */
+  uint32_t              mr_allocs;  /**< @brief Successful allocations.     */
+  uint32_t              mr_fails;   /**< @brief Failed allocations.         */
+  memattr_t             mr_attr;    /**< @brief Region attributes.          */
+} MemoryRegion;
+
+/**
+ * @brief   Memory region statistics.
+ */
+typedef struct {
+  size_t                size;       /**< @brief Region size in bytes.       */
+  size_t                used;       /**< @brief Allocated bytes.            */
+  uint32_t              allocs;     /**< @brief Successful allocations.     */
+  uint32_t              fails;      /**< @brief Failed allocations.         */
+} MemoryRegionStats;
+
+/**
+ * @name    Macro Functions
+ * @{
+ */
+/**
+ * @brief   Returns the next region in the regions list.
+ * @details The regions are listed by decreasing speed, the first one is
+ *          returned by @p chCoreFirstRegion().
+ *
+ * @param[in] mrp       pointer to a @p MemoryRegion structure
+ * @return              The next region.
+ * @retval NULL         if there are no more regions.
+ *
+ * @api
+ */
+#define chCoreNextRegion(mrp) ((mrp)->mr_next)
+
+/**
+ * @brief   Returns the name of a memory region.
+ *
+ * @param[in] mrp       pointer to a @p MemoryRegion structure
+ * @return              The region name.
+ *
+ * @api
+ */
+#define chCoreGetRegionName(mrp) ((mrp)->mr_name)
+
+/**
+ * @brief   Returns the attributes of a memory region.
+ *
+ * @param[in] mrp       pointer to a @p MemoryRegion structure
+ * @return              The region attributes mask.
+ *
+ * @api
+ */
+#define chCoreGetRegionAttr(mrp) ((mrp)->mr_attr)
+/** @} */
+#endif /* CH_USE_MEMCORE_REGIONS */
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -75,6 +184,18 @@ extern "C" {
   void *chCoreAlloc(size_t size);
   void *chCoreAllocI(size_t size);
   size_t chCoreStatus(void);
+#if CH_USE_MEMCORE_REGIONS
+  void chCoreAddRegion(MemoryRegion *mrp, const char *name,
+                       void *base, size_t size, memattr_t attr);
+  void chCoreRemoveRegion(MemoryRegion *mrp);
+  MemoryRegion *chCoreFirstRegion(void);
+  MemoryRegion *chCoreFindRegion(const char *name);
+  void *chCoreAllocFrom(MemoryRegion *mrp, size_t size);
+  void *chCoreAllocFromI(MemoryRegion *mrp, size_t size);
+  void *chCoreAllocPlaced(size_t size, memattr_t attr);
+  void *chCoreAllocPlacedI(size_t size, memattr_t attr);
+  void chCoreGetStats(MemoryRegion *mrp, MemoryRegionStats *msp);
+#endif
 #ifdef __cplusplus
 }
 #endif
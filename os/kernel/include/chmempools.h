@@ -48,6 +48,11 @@ typedef struct {
                                                     size.                   */
   memgetfunc_t          mp_provider;    /**< @brief Memory blocks provider for
                                                     this pool.              */
+#if CH_USE_MEMCORE_REGIONS || defined(__DOXYGEN__)
+  MemoryRegion          *mp_region;     /**< @brief Memory region providing
+                                                    objects to this pool or
+                                                    @p NULL.                */
+#endif
 } MemoryPool;
 
 /**
@@ -59,8 +64,13 @@ typedef struct {
  * @param[in] size      size of the memory pool contained objects
  * @param[in] provider  memory provider function for the memory pool
  */
+#if CH_USE_MEMCORE_REGIONS || defined(__DOXYGEN__)
+#define _MEMORYPOOL_DATA(name, size, provider)                              \
+  {NULL, size, provider, NULL}
+#else
 #define _MEMORYPOOL_DATA(name, size, provider)                              \
   {NULL, size, provider}
+#endif
 
 /**
  * @brief Static memory pool initializer in hungry mode.
@@ -118,6 +128,9 @@ typedef struct {
 extern "C" {
 #endif
   void chPoolInit(MemoryPool *mp, size_t size, memgetfunc_t provider);
+#if CH_USE_MEMCORE_REGIONS
+  void chPoolInitRegion(MemoryPool *mp, size_t size, MemoryRegion *mrp);
+#endif
   void chPoolLoadArray(MemoryPool *mp, void *p, size_t n);
   void *chPoolAllocI(MemoryPool *mp);
   void *chPoolAlloc(MemoryPool *mp);
@@ -348,6 +348,7 @@ extern "C" {
                 void *link);
   void chIQResetI(InputQueue *iqp);
   msg_t chIQPutI(InputQueue *iqp, uint8_t b);
+  size_t chIQPutBlockI(InputQueue *iqp, const uint8_t *bp, size_t n);
   msg_t chIQGetTimeout(InputQueue *iqp, systime_t time);
   size_t chIQReadTimeout(InputQueue *iqp, uint8_t *bp,
                          size_t n, systime_t time);
@@ -357,6 +358,7 @@ extern "C" {
   void chOQResetI(OutputQueue *oqp);
   msg_t chOQPutTimeout(OutputQueue *oqp, uint8_t b, systime_t time);
   msg_t chOQGetI(OutputQueue *oqp);
+  size_t chOQGetBlockI(OutputQueue *oqp, uint8_t *bp, size_t n);
   size_t chOQWriteTimeout(OutputQueue *oqp, const uint8_t *bp,
                           size_t n, systime_t time);
 #ifdef __cplusplus
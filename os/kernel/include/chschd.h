@@ -71,6 +71,44 @@
 #define TIME_INFINITE   ((systime_t)-1)
 /** @} */
 
+#if CH_USE_SMP || defined(__DOXYGEN__)
+/**
+ * @name    Cores masks
+ * @{
+ */
+/**
+ * @brief   Mask of the core @p n.
+ */
+#define CH_CORE_MASK(n) ((coremask_t)1 << (n))
+
+/**
+ * @brief   Mask of all the cores.
+ */
+#define CH_ALL_CORES    ((coremask_t)(((uint64_t)1 << PORT_CORES_NUMBER) - 1))
+/** @} */
+
+#if !defined(PORT_CORES_NUMBER)
+#error "CH_USE_SMP requires a port defining PORT_CORES_NUMBER"
+#endif
+
+#if (PORT_CORES_NUMBER < 1) || (PORT_CORES_NUMBER > 32)
+#error "invalid PORT_CORES_NUMBER value"
+#endif
+
+#if CH_NO_IDLE_THREAD
+#error "CH_USE_SMP requires the idle threads"
+#endif
+
+#if CH_DBG_SYSTEM_STATE_CHECK
+#error "CH_DBG_SYSTEM_STATE_CHECK not supported with CH_USE_SMP"
+#endif
+
+/**
+ * @brief   Cores mask, bit @p n allows the core @p n.
+ */
+typedef uint32_t coremask_t;
+#endif /* CH_USE_SMP */
+
 /**
  * @brief   Returns the priority of the first thread on the given ready list.
  *
@@ -101,9 +139,41 @@ typedef struct {
 #endif /* !defined(PORT_OPTIMIZED_READYLIST_STRUCT) */
 
 #if !defined(PORT_OPTIMIZED_RLIST_EXT) && !defined(__DOXYGEN__)
+#if CH_USE_SMP
+extern ReadyList _rlist[PORT_CORES_NUMBER];
+#define rlist (_rlist[0])
+#else
 extern ReadyList rlist;
+#endif
 #endif /* !defined(PORT_OPTIMIZED_RLIST_EXT) */
 
+#if CH_USE_SMP || defined(__DOXYGEN__)
+/**
+ * @brief   Ready list of the specified core.
+ * @note    The ready list of the core zero, also accessible as @p rlist,
+ *          is the head of the threads registry.
+ *
+ * @notapi
+ */
+#define corelist(n) (&_rlist[n])
+
+/**
+ * @brief   Ready list of the invoking core.
+ * @note    Must be used with the kernel locked, the invoking thread can be
+ *          moved to another core while the kernel is unlocked. This is
+ *          checked when @p CH_DBG_ENABLE_ASSERTS is enabled.
+ *
+ * @notapi
+ */
+#if CH_DBG_ENABLE_ASSERTS && !defined(__DOXYGEN__)
+#define currlist() _scheduler_currlist()
+#else
+#define currlist() corelist(port_get_core_id())
+#endif
+#else /* !CH_USE_SMP */
+#define currlist() (&rlist)
+#endif /* !CH_USE_SMP */
+
 /**
  * @brief   Current thread pointer access macro.
  * @note    This macro is not meant to be used in the application code but
@@ -112,7 +182,7 @@ extern ReadyList rlist;
  *          (currp = something), use @p setcurrp() instead.
  */
 #if !defined(PORT_OPTIMIZED_CURRP) || defined(__DOXYGEN__)
-#define currp rlist.r_current
+#define currp currlist()->r_current
 #endif /* !defined(PORT_OPTIMIZED_CURRP) */
 
 /**
@@ -133,6 +203,9 @@ extern ReadyList rlist;
 extern "C" {
 #endif
   void _scheduler_init(void);
+#if CH_USE_SMP && CH_DBG_ENABLE_ASSERTS
+  ReadyList *_scheduler_currlist(void);
+#endif
 #if !defined(PORT_OPTIMIZED_READYI)
   Thread *chSchReadyI(Thread *tp);
 #endif
@@ -176,7 +249,7 @@ extern "C" {
  * @iclass
  */
 #if !defined(PORT_OPTIMIZED_ISRESCHREQUIREDI) || defined(__DOXYGEN__)
-#define chSchIsRescRequiredI() (firstprio(&rlist.r_queue) > currp->p_prio)
+#define chSchIsRescRequiredI() (firstprio(&currlist()->r_queue) > currp->p_prio)
 #endif /* !defined(PORT_OPTIMIZED_ISRESCHREQUIREDI) */
 
 /**
@@ -187,7 +260,7 @@ extern "C" {
  * @sclass
  */
 #if !defined(PORT_OPTIMIZED_CANYIELDS) || defined(__DOXYGEN__)
-#define chSchCanYieldS() (firstprio(&rlist.r_queue) >= currp->p_prio)
+#define chSchCanYieldS() (firstprio(&currlist()->r_queue) >= currp->p_prio)
 #endif /* !defined(PORT_OPTIMIZED_CANYIELDS) */
 
 /**
@@ -213,7 +286,7 @@ extern "C" {
  */
 #if (CH_TIME_QUANTUM > 0) || defined(__DOXYGEN__)
 #define chSchPreemption() {                                                 \
-  tprio_t p1 = firstprio(&rlist.r_queue);                                   \
+  tprio_t p1 = firstprio(&currlist()->r_queue);                             \
   tprio_t p2 = currp->p_prio;                                               \
   if (currp->p_preempt) {                                                   \
     if (p1 > p2)                                                            \
@@ -41,13 +41,33 @@
  * @note    The reference counter of the idle thread is not incremented but
  *          it is not strictly required being the idle thread a static
  *          object.
+ * @note    In SMP mode the idle thread of the invoking core is returned.
  *
  * @return              Pointer to the idle thread.
  *
  * @api
  */
+#if CH_USE_SMP || defined(__DOXYGEN__)
+#define chSysGetIdleThread()                                                \
+  ((Thread *)_idle_thread_wa[port_get_core_id()])
+#else
 #define chSysGetIdleThread() (rlist.r_queue.p_prev)
 #endif
+#endif
+
+#if CH_USE_SMP || defined(__DOXYGEN__)
+/**
+ * @brief   Returns the identifier of the invoking core.
+ * @note    This function is only available when the @p CH_USE_SMP
+ *          configuration option is enabled.
+ *
+ * @return              The core number, from zero to
+ *                      @p PORT_CORES_NUMBER - 1.
+ *
+ * @special
+ */
+#define chSysGetCoreId() port_get_core_id()
+#endif
 
 /**
  * @brief   Halts the system.
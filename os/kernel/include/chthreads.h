@@ -128,6 +128,17 @@ struct Thread {
 #if (CH_TIME_QUANTUM > 0) || defined(__DOXYGEN__)
   tslices_t             p_preempt;
 #endif
+#if CH_USE_SMP || defined(__DOXYGEN__)
+  /**
+   * @brief Core running the thread or whose ready list contains it, the
+   *        last core it ran on when sleeping.
+   */
+  uint8_t               p_core;
+  /**
+   * @brief Cores allowed to run the thread.
+   */
+  coremask_t            p_affinity;
+#endif
 #if CH_DBG_THREADS_PROFILING || defined(__DOXYGEN__)
   /**
    * @brief Thread consumed time in ticks.
@@ -204,12 +215,45 @@ struct Thread {
    */
   tprio_t               p_realprio;
 #endif
+#if CH_USE_CEILING_MUTEXES || defined(__DOXYGEN__)
+  /**
+   * @brief List of the ceiling mutexes owned by this thread.
+   * @note  The list is terminated by a @p NULL in this field.
+   */
+  struct CeilingMutex   *p_cmtxlist;
+#endif
+#if CH_USE_CONDVARS || defined(__DOXYGEN__)
+  /**
+   * @brief Condition variable wait fields.
+   * @note  A signaled thread is moved from the condition variable queue
+   *        to the mutex queue, the @p p_u union is then used for the
+   *        mutex wait.
+   */
+  union {
+    /**
+     * @brief Mutex to be reacquired, valid while the thread is in the
+     *        @p THD_STATE_WTCOND state.
+     */
+    Mutex               *mp;
+    /**
+     * @brief Condition variable wakeup message, valid after the thread
+     *        has been signaled.
+     */
+    msg_t               msg;
+  }                     p_cv;
+#endif
 #if (CH_USE_DYNAMIC && CH_USE_MEMPOOLS) || defined(__DOXYGEN__)
   /**
    * @brief Memory Pool where the thread workspace is returned.
    */
   void                  *p_mpool;
 #endif
+#if CH_USE_ARENAS || defined(__DOXYGEN__)
+  /**
+   * @brief Current arena of the thread or @p NULL.
+   */
+  struct arena          *p_arena;
+#endif
 #if defined(THREAD_EXT_FIELDS)
   /* Extra fields defined in chconf.h.*/
   THREAD_EXT_FIELDS
@@ -241,6 +285,16 @@ typedef msg_t (*tfunc_t)(void *);
  */
 #define chThdGetPriority() (currp->p_prio)
 
+/**
+ * @brief   Returns the current thread affinity mask.
+ * @note    This function is only available when the @p CH_USE_SMP
+ *          configuration option is enabled.
+ * @note    Can be invoked in any context.
+ *
+ * @special
+ */
+#define chThdGetAffinity() (currp->p_affinity)
+
 /**
  * @brief   Returns the number of ticks consumed by the specified thread.
  * @note    This function is only available when the
@@ -360,7 +414,15 @@ extern "C" {
                        tprio_t prio, tfunc_t pf, void *arg);
   Thread *chThdCreateStatic(void *wsp, size_t size,
                             tprio_t prio, tfunc_t pf, void *arg);
+#if CH_USE_MEMCORE_REGIONS
+  Thread *chThdCreateFromRegion(MemoryRegion *mrp, size_t size,
+                                tprio_t prio, tfunc_t pf, void *arg);
+  Thread *chThdCreateFast(size_t size, tprio_t prio, tfunc_t pf, void *arg);
+#endif
   tprio_t chThdSetPriority(tprio_t newprio);
+#if CH_USE_SMP
+  coremask_t chThdSetAffinity(coremask_t mask);
+#endif
   Thread *chThdResume(Thread *tp);
   void chThdTerminate(Thread *tp);
   void chThdSleep(systime_t time);
@@ -10,6 +10,7 @@ KERNSRC = ${CHIBIOS}/os/kernel/src/chsys.c \
           ${CHIBIOS}/os/kernel/src/chregistry.c \
           ${CHIBIOS}/os/kernel/src/chsem.c \
           ${CHIBIOS}/os/kernel/src/chmtx.c \
+          ${CHIBIOS}/os/kernel/src/chcmtx.c \
           ${CHIBIOS}/os/kernel/src/chcond.c \
           ${CHIBIOS}/os/kernel/src/chevents.c \
           ${CHIBIOS}/os/kernel/src/chmsg.c \
@@ -17,7 +18,8 @@ KERNSRC = ${CHIBIOS}/os/kernel/src/chsys.c \
           ${CHIBIOS}/os/kernel/src/chqueues.c \
           ${CHIBIOS}/os/kernel/src/chmemcore.c \
           ${CHIBIOS}/os/kernel/src/chheap.c \
-          ${CHIBIOS}/os/kernel/src/chmempools.c
+          ${CHIBIOS}/os/kernel/src/chmempools.c \
+          ${CHIBIOS}/os/kernel/src/charena.c
 
 # Required include directories
 KERNINC = ${CHIBIOS}/os/kernel/include
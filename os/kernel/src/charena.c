@@ -0,0 +1,330 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006,2007,2008,2009,2010,
+                 2011,2012,2013 Giovanni Di Sirio.
+
+    This file is part of ChibiOS/RT.
+
+    ChibiOS/RT is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    ChibiOS/RT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file    charena.c
+ * @brief   Arenas code.
+ *
+ * @addtogroup arenas
+ * @details Arena allocator related APIs.
+ *          <h2>Operation mode</h2>
+ *          An arena allocates memory blocks by incrementing a pointer
+ *          inside a chain of memory chunks, the single blocks cannot be
+ *          freed, all the blocks are freed at once by resetting the arena
+ *          or by rewinding it to a previously saved position.<br>
+ *          Arenas are meant for the temporary allocations of a limited
+ *          job, for example the handling of a request, replacing a series
+ *          of heap allocations and frees with a single reset. The
+ *          allocation is a pointer increment and the reset is performed
+ *          in constant time, the memory is never fragmented.<br>
+ *          The chunks are taken from a heap, a memory pool or the memory
+ *          core when required and are retained by the arena on reset so
+ *          an arena in steady state does not access its source anymore.
+ *          The chunks taken from a heap or a memory pool can be returned
+ *          to the source by releasing the arena.<br>
+ *          Arenas are not protected by a lock, an arena must be used by a
+ *          single thread or the accesses must be serialized by the
+ *          application. Each thread can have a current arena used when no
+ *          arena is specified in the allocation.
+ * @pre     In order to use the arena APIs the @p CH_USE_ARENAS option
+ *          must be enabled in @p chconf.h.
+ * @{
+ */
+
+#include "ch.h"
+
+#if CH_USE_ARENAS || defined(__DOXYGEN__)
+
+/**
+ * @brief   First usable byte of a chunk.
+ */
+#define chunk_base(cp) ((uint8_t *)((cp) + 1))
+
+/**
+ * @brief   Usable size of a chunk.
+ */
+#define chunk_size(cp) ((size_t)((cp)->c.end - chunk_base(cp)))
+
+/**
+ * @brief   Initializes the common arena fields.
+ */
+static void arena_init(Arena *ap, void *source, size_t size, uint8_t mode) {
+
+  ap->a_first  = NULL;
+  ap->a_chunk  = NULL;
+  ap->a_free   = NULL;
+  ap->a_size   = size;
+  ap->a_source = source;
+  ap->a_mode   = mode;
+}
+
+/**
+ * @brief   Gets a new chunk from the arena source.
+ *
+ * @param[in] ap        pointer to the @p Arena structure
+ * @param[in] size      minimum usable size of the chunk
+ * @return              The new chunk.
+ * @retval NULL         if the source is exhausted.
+ */
+static union arena_chunk *arena_get_chunk(Arena *ap, size_t size) {
+  union arena_chunk *cp;
+
+  size += sizeof(union arena_chunk);
+  if (size < ap->a_size)
+    size = ap->a_size;
+  switch (ap->a_mode) {
+#if CH_USE_HEAP
+  case ARENA_MODE_HEAP:
+    cp = chHeapAlloc((MemoryHeap *)ap->a_source, size);
+    break;
+#endif
+#if CH_USE_MEMPOOLS
+  case ARENA_MODE_MEMPOOL:
+    if (size > ap->a_size)
+      return NULL;
+    cp = chPoolAlloc((MemoryPool *)ap->a_source);
+    break;
+#endif
+#if CH_USE_MEMCORE
+  case ARENA_MODE_CORE:
+#if CH_USE_MEMCORE_REGIONS
+    cp = chCoreAllocFrom((MemoryRegion *)ap->a_source, size);
+#else
+    cp = chCoreAlloc(size);
+#endif
+    break;
+#endif
+  default:
+    cp = NULL;
+  }
+  if (cp != NULL)
+    cp->c.end = (uint8_t *)cp + size;
+  return cp;
+}
+
+#if CH_USE_HEAP || defined(__DOXYGEN__)
+/**
+ * @brief   Initializes an arena taking the chunks from a heap.
+ * @details Blocks larger than a chunk are served by a dedicated chunk.
+ *
+ * @param[out] ap       pointer to the @p Arena structure
+ * @param[in] heapp     heap providing the chunks or @p NULL for the default
+ *                      heap
+ * @param[in] size      size of the chunks including their header
+ *
+ * @init
+ */
+void chArenaInitHeap(Arena *ap, MemoryHeap *heapp, size_t size) {
+
+  chDbgCheck((ap != NULL) && (size > sizeof(union arena_chunk)),
+             "chArenaInitHeap");
+
+  arena_init(ap, heapp, size, ARENA_MODE_HEAP);
+}
+#endif /* CH_USE_HEAP */
+
+#if CH_USE_MEMPOOLS || defined(__DOXYGEN__)
+/**
+ * @brief   Initializes an arena taking the chunks from a memory pool.
+ * @details The chunk size is the size of the pool objects, blocks larger
+ *          than a chunk cannot be allocated.
+ *
+ * @param[out] ap       pointer to the @p Arena structure
+ * @param[in] mp        pointer to the @p MemoryPool structure
+ *
+ * @init
+ */
+void chArenaInitPool(Arena *ap, MemoryPool *mp) {
+
+  chDbgCheck((ap != NULL) && (mp != NULL) &&
+             (mp->mp_object_size > sizeof(union arena_chunk)),
+             "chArenaInitPool");
+
+  arena_init(ap, mp, mp->mp_object_size, ARENA_MODE_MEMPOOL);
+}
+#endif /* CH_USE_MEMPOOLS */
+
+#if CH_USE_MEMCORE || defined(__DOXYGEN__)
+/**
+ * @brief   Initializes an arena taking the chunks from the memory core.
+ * @details Blocks larger than a chunk are served by a dedicated chunk.
+ * @note    The chunks cannot be returned to the memory core.
+ *
+ * @param[out] ap       pointer to the @p Arena structure
+ * @param[in] size      size of the chunks including their header
+ *
+ * @init
+ */
+void chArenaInitCore(Arena *ap, size_t size) {
+
+  chDbgCheck((ap != NULL) && (size > sizeof(union arena_chunk)),
+             "chArenaInitCore");
+
+  arena_init(ap, NULL, size, ARENA_MODE_CORE);
+}
+
+#if CH_USE_MEMCORE_REGIONS || defined(__DOXYGEN__)
+/**
+ * @brief   Initializes an arena taking the chunks from a memory region.
+ * @details Blocks larger than a chunk are served by a dedicated chunk.
+ * @note    The chunks cannot be returned to the memory region.
+ *
+ * @param[out] ap       pointer to the @p Arena structure
+ * @param[in] mrp       pointer to the @p MemoryRegion structure
+ * @param[in] size      size of the chunks including their header
+ *
+ * @init
+ */
+void chArenaInitRegion(Arena *ap, MemoryRegion *mrp, size_t size) {
+
+  chDbgCheck((ap != NULL) && (mrp != NULL) &&
+             (size > sizeof(union arena_chunk)), "chArenaInitRegion");
+
+  arena_init(ap, mrp, size, ARENA_MODE_CORE);
+}
+#endif /* CH_USE_MEMCORE_REGIONS */
+#endif /* CH_USE_MEMCORE */
+
+/**
+ * @brief   Allocates a block from an arena.
+ * @details The allocated block is guaranteed to be properly aligned for a
+ *          pointer data type (@p stkalign_t). When the current chunk is
+ *          full the next chunk of the chain is used, a new chunk is taken
+ *          from the source if there are no more chunks or the next one is
+ *          too small.
+ *
+ * @param[in] ap        pointer to the @p Arena structure or @p NULL in order
+ *                      to use the current arena of the invoking thread
+ * @param[in] size      the size of the block to be allocated
+ * @return              A pointer to the allocated block.
+ * @retval NULL         if the block cannot be allocated.
+ *
+ * @api
+ */
+void *chArenaAlloc(Arena *ap, size_t size) {
+  union arena_chunk *cp, **cpp;
+  uint8_t *p;
+
+  if (ap == NULL)
+    ap = currp->p_arena;
+  chDbgCheck(ap != NULL, "chArenaAlloc");
+
+  /* Sizes that would wrap around once aligned and added to the chunk
+     header cannot be allocated.*/
+  if (size > (size_t)-1 / 2)
+    return NULL;
+  size = MEM_ALIGN_NEXT(size);
+  p = ap->a_free;
+  if ((ap->a_chunk != NULL) && ((size_t)(ap->a_chunk->c.end - p) >= size)) {
+    ap->a_free = p + size;
+    return p;
+  }
+
+  /* Moving to the next chunk, it is reused if large enough else a new
+     chunk is inserted in the chain.*/
+  cpp = ap->a_chunk == NULL ? &ap->a_first : &ap->a_chunk->c.next;
+  cp = *cpp;
+  if ((cp == NULL) || (chunk_size(cp) < size)) {
+    cp = arena_get_chunk(ap, size);
+    if (cp == NULL)
+      return NULL;
+    cp->c.next = *cpp;
+    *cpp = cp;
+  }
+  ap->a_chunk = cp;
+  ap->a_free = chunk_base(cp) + size;
+  return chunk_base(cp);
+}
+
+/**
+ * @brief   Frees all the blocks allocated from an arena.
+ * @details The arena restarts allocating from its first chunk, the chunks
+ *          are retained and reused. The operation is performed in
+ *          constant time.
+ *
+ * @param[in] ap        pointer to the @p Arena structure
+ *
+ * @api
+ */
+void chArenaReset(Arena *ap) {
+
+  chDbgCheck(ap != NULL, "chArenaReset");
+
+  ap->a_chunk = ap->a_first;
+  ap->a_free = ap->a_first != NULL ? chunk_base(ap->a_first) : NULL;
+}
+
+/**
+ * @brief   Frees all the blocks and returns the chunks to the source.
+ * @details The chunks taken from a heap or a memory pool are returned, the
+ *          arena is left empty. The chunks taken from the memory core
+ *          cannot be returned and are retained as in @p chArenaReset().
+ *
+ * @param[in] ap        pointer to the @p Arena structure
+ *
+ * @api
+ */
+void chArenaRelease(Arena *ap) {
+  union arena_chunk *cp;
+
+  chDbgCheck(ap != NULL, "chArenaRelease");
+
+  if (ap->a_mode == ARENA_MODE_CORE) {
+    chArenaReset(ap);
+    return;
+  }
+  while ((cp = ap->a_first) != NULL) {
+    ap->a_first = cp->c.next;
+#if CH_USE_HEAP
+    if (ap->a_mode == ARENA_MODE_HEAP)
+      chHeapFree(cp);
+#endif
+#if CH_USE_MEMPOOLS
+    if (ap->a_mode == ARENA_MODE_MEMPOOL)
+      chPoolFree((MemoryPool *)ap->a_source, cp);
+#endif
+  }
+  ap->a_chunk = NULL;
+  ap->a_free = NULL;
+}
+
+/**
+ * @brief   Sets the current arena of the invoking thread.
+ * @details The current arena is used by @p chArenaAlloc() when no arena
+ *          is specified, this allows functions deep in a call chain to
+ *          allocate temporaries in the arena of the job being handled.
+ *          Threads are created without a current arena.
+ *
+ * @param[in] ap        pointer to the @p Arena structure or @p NULL
+ * @return              The previous current arena.
+ *
+ * @api
+ */
+Arena *chArenaSetCurrent(Arena *ap) {
+  Arena *oap;
+
+  oap = currp->p_arena;
+  currp->p_arena = ap;
+  return oap;
+}
+
+#endif /* CH_USE_ARENAS */
+
+/** @} */
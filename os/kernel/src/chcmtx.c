@@ -0,0 +1,218 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006,2007,2008,2009,2010,
+                 2011,2012,2013 Giovanni Di Sirio.
+
+    This file is part of ChibiOS/RT.
+
+    ChibiOS/RT is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    ChibiOS/RT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file    chcmtx.c
+ * @brief   Ceiling mutexes code.
+ *
+ * @addtogroup ceiling_mutexes
+ * @details Ceiling mutexes related APIs and services.
+ *
+ *          <h2>Operation mode</h2>
+ *          Ceiling mutexes implement the immediate priority ceiling
+ *          protocol. Each mutex has a ceiling priority that must be higher
+ *          than the priority of any thread locking it, the lock operation
+ *          immediately raises the owner priority to the ceiling.
+ *          Operations defined for ceiling mutexes:
+ *          - <b>Lock</b>: The mutex is associated to the locking thread and
+ *            the thread priority is raised to the ceiling priority. The
+ *            operation never blocks.
+ *          - <b>Unlock</b>: The mutex is released and the owner priority
+ *            returns to the value it would have without the mutex. The
+ *            operation has a fixed cost if the owner does not also own
+ *            priority inheritance mutexes, else its cost is proportional
+ *            to the number of the owned priority inheritance mutexes.
+ *          .
+ *          <h2>Constraints</h2>
+ *          While a thread owns a ceiling mutex no other thread using the
+ *          same mutex can run, so the mutex is always found free, there are
+ *          no waiting queues and no blocking chains and deadlocks are not
+ *          possible. This is only true if the owner does not enter a sleep
+ *          state while owning the mutex and if all the threads locking the
+ *          mutex have a priority lower than its ceiling, both conditions
+ *          are checked when @p CH_DBG_ENABLE_ASSERTS is enabled. A ceiling
+ *          equal to the priority of a user thread is not allowed because a
+ *          preempted owner is placed behind the threads having its same
+ *          priority.
+ *          The ceiling mutexes are unlocked in lock-reverse order using a
+ *          per-thread stack of owned ceiling mutexes, separate from the one
+ *          of the priority inheritance mutexes. The two kinds of mutexes
+ *          can be nested in any order.
+ * @pre     In order to use the ceiling mutex APIs the
+ *          @p CH_USE_CEILING_MUTEXES option must be enabled in @p chconf.h.
+ * @post    Enabling ceiling mutexes requires one extra pointer in the
+ *          @p Thread structure.
+ * @{
+ */
+
+#include "ch.h"
+
+#if CH_USE_CEILING_MUTEXES || defined(__DOXYGEN__)
+
+/**
+ * @brief   Initializes s @p CeilingMutex structure.
+ *
+ * @param[out] cmp      pointer to a @p CeilingMutex structure
+ * @param[in] ceiling   the ceiling priority, it must be higher than the
+ *                      priority of all the threads locking the mutex
+ *
+ * @init
+ */
+void chCMtxInit(CeilingMutex *cmp, tprio_t ceiling) {
+
+  chDbgCheck((cmp != NULL) && (ceiling <= HIGHPRIO), "chCMtxInit");
+
+  cmp->cm_owner = NULL;
+  cmp->cm_next = NULL;
+  cmp->cm_ceiling = ceiling;
+  cmp->cm_level = 0;
+}
+
+/**
+ * @brief   Locks the specified ceiling mutex.
+ * @post    The mutex is locked and inserted in the per-thread stack of owned
+ *          ceiling mutexes, the thread priority is raised to the ceiling.
+ *
+ * @param[in] cmp       pointer to the @p CeilingMutex structure
+ *
+ * @api
+ */
+void chCMtxLock(CeilingMutex *cmp) {
+
+  chSysLock();
+
+  chCMtxLockS(cmp);
+
+  chSysUnlock();
+}
+
+/**
+ * @brief   Locks the specified ceiling mutex.
+ * @post    The mutex is locked and inserted in the per-thread stack of owned
+ *          ceiling mutexes, the thread priority is raised to the ceiling.
+ *
+ * @param[in] cmp       pointer to the @p CeilingMutex structure
+ *
+ * @sclass
+ */
+void chCMtxLockS(CeilingMutex *cmp) {
+  Thread *ctp = currp;
+  tprio_t level;
+
+  chDbgCheckClassS();
+  chDbgCheck(cmp != NULL, "chCMtxLockS");
+  chDbgAssert(cmp->cm_owner == NULL,
+              "chCMtxLockS(), #1",
+              "already owned");
+  chDbgAssert(ctp->p_realprio < cmp->cm_ceiling,
+              "chCMtxLockS(), #2",
+              "priority not below ceiling");
+
+  /* The level is the highest ceiling in the owned mutexes stack, it is
+     recorded in the mutex so that the unlock does not need to scan the
+     stack.*/
+  level = cmp->cm_ceiling;
+  if ((ctp->p_cmtxlist != NULL) && (ctp->p_cmtxlist->cm_level > level))
+    level = ctp->p_cmtxlist->cm_level;
+  cmp->cm_level = level;
+  cmp->cm_owner = ctp;
+  cmp->cm_next = ctp->p_cmtxlist;
+  ctp->p_cmtxlist = cmp;
+  /* Raising the priority of the running thread does not require a
+     reschedule.*/
+  if (level > ctp->p_prio)
+    ctp->p_prio = level;
+}
+
+/**
+ * @brief   Unlocks the next owned ceiling mutex in reverse lock order.
+ * @pre     The invoking thread <b>must</b> have at least one owned ceiling
+ *          mutex.
+ * @post    The mutex is unlocked and removed from the per-thread stack of
+ *          owned ceiling mutexes.
+ *
+ * @return              A pointer to the unlocked mutex.
+ *
+ * @api
+ */
+CeilingMutex *chCMtxUnlock(void) {
+  CeilingMutex *cmp;
+
+  chSysLock();
+  cmp = chCMtxUnlockS();
+  chSchRescheduleS();
+  chSysUnlock();
+  return cmp;
+}
+
+/**
+ * @brief   Unlocks the next owned ceiling mutex in reverse lock order.
+ * @pre     The invoking thread <b>must</b> have at least one owned ceiling
+ *          mutex.
+ * @post    The mutex is unlocked and removed from the per-thread stack of
+ *          owned ceiling mutexes.
+ * @post    This function does not reschedule so a call to a rescheduling
+ *          function must be performed before unlocking the kernel.
+ * @note    The execution time does not depend on the number of owned
+ *          ceiling mutexes but it is proportional to the number of owned
+ *          priority inheritance mutexes, they are scanned for inherited
+ *          priorities. The execution time is constant only if the thread
+ *          owns no priority inheritance mutexes.
+ *
+ * @return              A pointer to the unlocked mutex.
+ *
+ * @sclass
+ */
+CeilingMutex *chCMtxUnlockS(void) {
+  Thread *ctp = currp;
+  CeilingMutex *cmp;
+  Mutex *mp;
+  tprio_t newprio;
+
+  chDbgCheckClassS();
+  chDbgAssert(ctp->p_cmtxlist != NULL,
+              "chCMtxUnlockS(), #1",
+              "owned mutexes list empty");
+  chDbgAssert(ctp->p_cmtxlist->cm_owner == ctp,
+              "chCMtxUnlockS(), #2",
+              "ownership failure");
+
+  /* Removes the top mutex from the owned mutexes stack and marks it as not
+     owned.*/
+  cmp = ctp->p_cmtxlist;
+  ctp->p_cmtxlist = cmp->cm_next;
+  cmp->cm_owner = NULL;
+  /* The new priority is the thread priority raised to the ceiling of the
+     remaining owned ceiling mutexes and to the priority inherited from
+     the owned priority inheritance mutexes.*/
+  newprio = cmtx_base_prio(ctp);
+  mp = ctp->p_mtxlist;
+  while (mp != NULL) {
+    if (chMtxQueueNotEmptyS(mp) && (mp->m_queue.p_next->p_prio > newprio))
+      newprio = mp->m_queue.p_next->p_prio;
+    mp = mp->m_next;
+  }
+  ctp->p_prio = newprio;
+  return cmp;
+}
+
+#endif /* CH_USE_CEILING_MUTEXES */
+
+/** @} */
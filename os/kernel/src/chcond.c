@@ -32,16 +32,43 @@
  *          <h2>Operation mode</h2>
  *          The condition variable is a synchronization object meant to be
  *          used inside a zone protected by a @p Mutex. Mutexes and CondVars
- *          together can implement a Monitor construct.
+ *          together can implement a Monitor construct.<br>
+ *          Signaled threads are moved directly on the queue of the mutex
+ *          they have to reacquire (wait morphing), a thread is made ready
+ *          only when the mutex is assigned to it. A broadcast does not
+ *          make all the waiting threads ready just to have them sleeping
+ *          again on the mutex.
  * @pre     In order to use the condition variable APIs the @p CH_USE_CONDVARS
  *          option must be enabled in @p chconf.h.
  * @{
  */
 
 #include "ch.h"
+#include "chprivate.h"
 
 #if (CH_USE_CONDVARS && CH_USE_MUTEXES) || defined(__DOXYGEN__)
 
+/*
+ * Moves a thread removed from a condition variable queue on the queue of
+ * the mutex it has to reacquire, the thread is made ready only if the mutex
+ * is free.
+ */
+static void cond_morph(Thread *tp, msg_t msg) {
+  Mutex *mp = tp->p_cv.mp;
+
+  tp->p_cv.msg = msg;
+  if (mp->m_owner != NULL) {
+    _mtx_enqueue(mp, tp);
+    tp->p_state = THD_STATE_WTMTX;
+  }
+  else {
+    mp->m_owner = tp;
+    mp->m_next = tp->p_mtxlist;
+    tp->p_mtxlist = mp;
+    chSchReadyI(tp);
+  }
+}
+
 /**
  * @brief   Initializes s @p CondVar structure.
  *
@@ -68,8 +95,10 @@ void chCondSignal(CondVar *cp) {
   chDbgCheck(cp != NULL, "chCondSignal");
 
   chSysLock();
-  if (notempty(&cp->c_queue))
-    chSchWakeupS(fifo_remove(&cp->c_queue), RDY_OK);
+  if (notempty(&cp->c_queue)) {
+    cond_morph(fifo_remove(&cp->c_queue), RDY_OK);
+    chSchRescheduleS();
+  }
   chSysUnlock();
 }
 
@@ -90,7 +119,7 @@ void chCondSignalI(CondVar *cp) {
   chDbgCheck(cp != NULL, "chCondSignalI");
 
   if (notempty(&cp->c_queue))
-    chSchReadyI(fifo_remove(&cp->c_queue))->p_u.rdymsg = RDY_OK;
+    cond_morph(fifo_remove(&cp->c_queue), RDY_OK);
 }
 
 /**
@@ -124,11 +153,12 @@ void chCondBroadcastI(CondVar *cp) {
   chDbgCheckClassI();
   chDbgCheck(cp != NULL, "chCondBroadcastI");
 
-  /* Empties the condition variable queue and inserts all the Threads into the
-     ready list in FIFO order. The wakeup message is set to @p RDY_RESET in
-     order to make a chCondBroadcast() detectable from a chCondSignal().*/
+  /* Empties the condition variable queue and moves all the Threads on the
+     mutexes queues in FIFO order, at most one thread for each mutex is made
+     ready. The wakeup message is set to @p RDY_RESET in order to make a
+     chCondBroadcast() detectable from a chCondSignal().*/
   while (cp->c_queue.p_next != (void *)&cp->c_queue)
-    chSchReadyI(fifo_remove(&cp->c_queue))->p_u.rdymsg = RDY_RESET;
+    cond_morph(fifo_remove(&cp->c_queue), RDY_RESET);
 }
 
 /**
@@ -177,7 +207,6 @@ msg_t chCondWait(CondVar *cp) {
 msg_t chCondWaitS(CondVar *cp) {
   Thread *ctp = currp;
   Mutex *mp;
-  msg_t msg;
 
   chDbgCheckClassS();
   chDbgCheck(cp != NULL, "chCondWaitS");
@@ -186,12 +215,13 @@ msg_t chCondWaitS(CondVar *cp) {
               "not owning a mutex");
 
   mp = chMtxUnlockS();
+  ctp->p_cv.mp = mp;
   ctp->p_u.wtobjp = cp;
   prio_insert(ctp, &cp->c_queue);
   chSchGoSleepS(THD_STATE_WTCOND);
-  msg = ctp->p_u.rdymsg;
-  chMtxLockS(mp);
-  return msg;
+  /* The mutex has been assigned to this thread before making it ready.*/
+  chDbgAssert(mp->m_owner == ctp, "chCondWaitS(), #2", "not owner");
+  return ctp->p_cv.msg;
 }
 
 #if CH_USE_CONDVARS_TIMEOUT || defined(__DOXYGEN__)
@@ -271,12 +301,15 @@ msg_t chCondWaitTimeoutS(CondVar *cp, systime_t time) {
               "not owning a mutex");
 
   mp = chMtxUnlockS();
+  currp->p_cv.mp = mp;
   currp->p_u.wtobjp = cp;
   prio_insert(currp, &cp->c_queue);
   msg = chSchGoSleepTimeoutS(THD_STATE_WTCOND, time);
-  if (msg != RDY_TIMEOUT)
-    chMtxLockS(mp);
-  return msg;
+  if (msg == RDY_TIMEOUT)
+    return msg;
+  /* The mutex has been assigned to this thread before making it ready.*/
+  chDbgAssert(mp->m_owner == currp, "chCondWaitTimeoutS(), #2", "not owner");
+  return currp->p_cv.msg;
 }
 #endif /* CH_USE_CONDVARS_TIMEOUT */
 
@@ -223,6 +223,7 @@ void _trace_init(void) {
 
   dbg_trace_buffer.tb_size = CH_TRACE_BUFFER_SIZE;
   dbg_trace_buffer.tb_ptr = &dbg_trace_buffer.tb_buffer[0];
+  dbg_trace_buffer.tb_count = 0;
 }
 
 /**
@@ -241,6 +242,7 @@ void dbg_trace(Thread *otp) {
   if (++dbg_trace_buffer.tb_ptr >=
       &dbg_trace_buffer.tb_buffer[CH_TRACE_BUFFER_SIZE])
     dbg_trace_buffer.tb_ptr = &dbg_trace_buffer.tb_buffer[0];
+  dbg_trace_buffer.tb_count++;
 }
 #endif /* CH_DBG_ENABLE_TRACE */
 
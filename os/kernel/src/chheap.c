@@ -67,6 +67,9 @@ static MemoryHeap default_heap;
  */
 void _heap_init(void) {
   default_heap.h_provider = chCoreAlloc;
+#if CH_USE_MEMCORE_REGIONS
+  default_heap.h_region = NULL;
+#endif
   default_heap.h_free.h.u.next = (union heap_header *)NULL;
   default_heap.h_free.h.size = 0;
 #if CH_USE_MUTEXES || defined(__DOXYGEN__)
@@ -95,6 +98,9 @@ void chHeapInit(MemoryHeap *heapp, void *buf, size_t size) {
   chDbgCheck(MEM_IS_ALIGNED(buf) && MEM_IS_ALIGNED(size), "chHeapInit");
 
   heapp->h_provider = (memgetfunc_t)NULL;
+#if CH_USE_MEMCORE_REGIONS
+  heapp->h_region = NULL;
+#endif
   heapp->h_free.h.u.next = hp = buf;
   heapp->h_free.h.size = 0;
   hp->h.u.next = NULL;
@@ -106,6 +112,36 @@ void chHeapInit(MemoryHeap *heapp, void *buf, size_t size) {
 #endif
 }
 
+#if CH_USE_MEMCORE_REGIONS || defined(__DOXYGEN__)
+/**
+ * @brief   Initializes a memory heap bound to a memory region.
+ * @details The heap is initially empty, blocks are taken from the region
+ *          when the heap has no free block large enough. Freed blocks are
+ *          kept in the heap and are never returned to the region.
+ * @pre     In order to use this function the option @p CH_USE_MALLOC_HEAP
+ *          must be disabled.
+ *
+ * @param[out] heapp    pointer to the memory heap descriptor to be initialized
+ * @param[in] mrp       pointer to the @p MemoryRegion structure
+ *
+ * @init
+ */
+void chHeapInitRegion(MemoryHeap *heapp, MemoryRegion *mrp) {
+
+  chDbgCheck(mrp != NULL, "chHeapInitRegion");
+
+  heapp->h_provider = (memgetfunc_t)NULL;
+  heapp->h_region = mrp;
+  heapp->h_free.h.u.next = NULL;
+  heapp->h_free.h.size = 0;
+#if CH_USE_MUTEXES || defined(__DOXYGEN__)
+  chMtxInit(&heapp->h_mtx);
+#else
+  chSemInit(&heapp->h_sem, 1);
+#endif
+}
+#endif /* CH_USE_MEMCORE_REGIONS */
+
 /**
  * @brief   Allocates a block of memory from the heap by using the first-fit
  *          algorithm.
@@ -159,16 +195,20 @@ void *chHeapAlloc(MemoryHeap *heapp, size_t size) {
 
   H_UNLOCK(heapp);
 
-  /* More memory is required, tries to get it from the associated provider
-     else fails.*/
-  if (heapp->h_provider) {
+  /* More memory is required, tries to get it from the associated region
+     or provider else fails.*/
+  hp = NULL;
+#if CH_USE_MEMCORE_REGIONS
+  if (heapp->h_region != NULL)
+    hp = chCoreAllocFrom(heapp->h_region, size + sizeof(union heap_header));
+#endif
+  if (heapp->h_provider)
     hp = heapp->h_provider(size + sizeof(union heap_header));
-    if (hp != NULL) {
-      hp->h.u.heap = heapp;
-      hp->h.size = size;
-      hp++;
-      return (void *)hp;
-    }
+  if (hp != NULL) {
+    hp->h.u.heap = heapp;
+    hp->h.size = size;
+    hp++;
+    return (void *)hp;
   }
   return NULL;
 }
@@ -39,17 +39,73 @@
  *          This allocator, alone, is also useful for very simple
  *          applications that just require a simple way to get memory
  *          blocks.
+ *          <h2>Memory regions</h2>
+ *          When the @p CH_USE_MEMCORE_REGIONS option is enabled the
+ *          allocator can manage several memory regions, for example a
+ *          core coupled RAM, the main RAM and an external SDRAM. Each
+ *          region has a name, a speed and a DMA capability attribute, the
+ *          memory normally managed by the allocator becomes the default
+ *          region named "core".<br>
+ *          Memory can be allocated from a specific region or by attributes
+ *          letting the allocator select the region, heaps and memory pools
+ *          can be bound to a region in order to get their memory from it.
  * @pre     In order to use the core memory manager APIs the @p CH_USE_MEMCORE
  *          option must be enabled in @p chconf.h.
  * @{
  */
 
+#include <string.h>
+
 #include "ch.h"
 
 #if CH_USE_MEMCORE || defined(__DOXYGEN__)
 
+#if CH_USE_MEMCORE_REGIONS || defined(__DOXYGEN__)
+/**
+ * @brief   Default memory region.
+ */
+static MemoryRegion core_region;
+
+/**
+ * @brief   Regions list, by decreasing speed.
+ */
+static MemoryRegion *regions;
+
+/**
+ * @brief   Speed field of an attributes mask.
+ */
+#define speed_of(attr) ((attr) & MEM_SPEED_MASK)
+
+/**
+ * @brief   Initializes a region descriptor.
+ */
+static void region_init(MemoryRegion *mrp, const char *name,
+                        uint8_t *base, uint8_t *end, memattr_t attr) {
+
+  mrp->mr_name   = name;
+  mrp->mr_base   = (uint8_t *)MEM_ALIGN_NEXT(base);
+  mrp->mr_free   = mrp->mr_base;
+  mrp->mr_end    = (uint8_t *)MEM_ALIGN_PREV(end);
+  if (mrp->mr_end < mrp->mr_base)
+    mrp->mr_end = mrp->mr_base;
+  mrp->mr_allocs = 0;
+  mrp->mr_fails  = 0;
+  mrp->mr_attr   = attr;
+}
+
+/**
+ * @brief   Verifies if a region can serve an allocation.
+ */
+static bool_t region_fits(MemoryRegion *mrp, size_t size, memattr_t attr) {
+
+  if ((attr & MEM_DMA) && !(mrp->mr_attr & MEM_DMA))
+    return FALSE;
+  return (size_t)(mrp->mr_end - mrp->mr_free) >= size;
+}
+#else /* !CH_USE_MEMCORE_REGIONS */
 static uint8_t *nextmem;
 static uint8_t *endmem;
+#endif /* !CH_USE_MEMCORE_REGIONS */
 
 /**
  * @brief   Low level memory manager initialization.
@@ -60,12 +116,21 @@ void _core_init(void) {
 #if CH_MEMCORE_SIZE == 0
   extern uint8_t __heap_base__[];
   extern uint8_t __heap_end__[];
-  nextmem = (uint8_t *)MEM_ALIGN_NEXT(__heap_base__);
-  endmem = (uint8_t *)MEM_ALIGN_PREV(__heap_end__);
+  uint8_t *base = __heap_base__;
+  uint8_t *end = __heap_end__;
 #else
   static stkalign_t buffer[MEM_ALIGN_NEXT(CH_MEMCORE_SIZE)/MEM_ALIGN_SIZE];
-  nextmem = (uint8_t *)&buffer[0];
-  endmem = (uint8_t *)&buffer[MEM_ALIGN_NEXT(CH_MEMCORE_SIZE)/MEM_ALIGN_SIZE];
+  uint8_t *base = (uint8_t *)&buffer[0];
+  uint8_t *end = (uint8_t *)&buffer[MEM_ALIGN_NEXT(CH_MEMCORE_SIZE)/MEM_ALIGN_SIZE];
+#endif
+
+#if CH_USE_MEMCORE_REGIONS
+  region_init(&core_region, "core", base, end, MEM_SPEED_NORMAL | MEM_DMA);
+  core_region.mr_next = NULL;
+  regions = &core_region;
+#else
+  nextmem = (uint8_t *)MEM_ALIGN_NEXT(base);
+  endmem = (uint8_t *)MEM_ALIGN_PREV(end);
 #endif
 }
 
@@ -103,6 +168,9 @@ void *chCoreAlloc(size_t size) {
  * @iclass
  */
 void *chCoreAllocI(size_t size) {
+#if CH_USE_MEMCORE_REGIONS
+  return chCoreAllocFromI(&core_region, size);
+#else
   void *p;
 
   chDbgCheckClassI();
@@ -113,10 +181,13 @@ void *chCoreAllocI(size_t size) {
   p = nextmem;
   nextmem += size;
   return p;
+#endif
 }
 
 /**
  * @brief   Core memory status.
+ * @note    When @p CH_USE_MEMCORE_REGIONS is enabled this function reports
+ *          the default region only.
  *
  * @return              The size, in bytes, of the free core memory.
  *
@@ -124,8 +195,268 @@ void *chCoreAllocI(size_t size) {
  */
 size_t chCoreStatus(void) {
 
+#if CH_USE_MEMCORE_REGIONS
+  return (size_t)(core_region.mr_end - core_region.mr_free);
+#else
   return (size_t)(endmem - nextmem);
+#endif
+}
+
+#if CH_USE_MEMCORE_REGIONS || defined(__DOXYGEN__)
+/**
+ * @brief   Adds a memory region to the allocator.
+ * @details The region is inserted in the regions list after the regions
+ *          having equal or higher speed.
+ * @pre     The region must not be already in the list, a region can be
+ *          added again only after removing it using
+ *          @p chCoreRemoveRegion().
+ * @note    The region base and size are aligned to the alignment type
+ *          internally, part of the memory area can remain unused.
+ * @note    The default region cannot be added again.
+ *
+ * @param[out] mrp      pointer to the @p MemoryRegion structure
+ * @param[in] name      region name
+ * @param[in] base      base of the memory area
+ * @param[in] size      size of the memory area in bytes
+ * @param[in] attr      region speed and attributes, for example
+ *                      <code>MEM_SPEED_FAST</code> or
+ *                      <code>MEM_SPEED_SLOW | MEM_DMA</code>
+ *
+ * @api
+ */
+void chCoreAddRegion(MemoryRegion *mrp, const char *name,
+                     void *base, size_t size, memattr_t attr) {
+  MemoryRegion **mrpp;
+
+  chDbgCheck((mrp != NULL) && (mrp != &core_region) && (name != NULL),
+             "chCoreAddRegion");
+
+  chSysLock();
+#if CH_DBG_ENABLE_ASSERTS
+  for (mrpp = &regions; *mrpp != NULL; mrpp = &(*mrpp)->mr_next)
+    chDbgAssert(*mrpp != mrp, "chCoreAddRegion(), #1", "already added");
+#endif
+
+  region_init(mrp, name, (uint8_t *)base, (uint8_t *)base + size, attr);
+
+  /* Inserted after the regions with the same or higher speed.*/
+  mrpp = &regions;
+  while ((*mrpp != NULL) &&
+         (speed_of((*mrpp)->mr_attr) >= speed_of(attr)))
+    mrpp = &(*mrpp)->mr_next;
+  mrp->mr_next = *mrpp;
+  *mrpp = mrp;
+  chSysUnlock();
+}
+
+/**
+ * @brief   Removes a memory region from the allocator.
+ * @details The region memory is no more available for allocation, the
+ *          blocks previously allocated from it are not affected.
+ * @pre     The region must be in the list and cannot be the default
+ *          region.
+ * @note    The heaps and pools bound to the region must not be used
+ *          after the removal.
+ *
+ * @param[in] mrp       pointer to the @p MemoryRegion structure
+ *
+ * @api
+ */
+void chCoreRemoveRegion(MemoryRegion *mrp) {
+  MemoryRegion **mrpp;
+
+  chDbgCheck((mrp != NULL) && (mrp != &core_region), "chCoreRemoveRegion");
+
+  chSysLock();
+  mrpp = &regions;
+  while ((*mrpp != NULL) && (*mrpp != mrp))
+    mrpp = &(*mrpp)->mr_next;
+  chDbgAssert(*mrpp != NULL, "chCoreRemoveRegion(), #1", "not found");
+  if (*mrpp != NULL)
+    *mrpp = mrp->mr_next;
+  chSysUnlock();
+}
+
+/**
+ * @brief   Returns the first region in the regions list.
+ * @details The regions are listed by decreasing speed, regions with the
+ *          same speed are listed in the order they have been added.
+ *
+ * @return              The fastest region.
+ *
+ * @api
+ */
+MemoryRegion *chCoreFirstRegion(void) {
+
+  return regions;
+}
+
+/**
+ * @brief   Finds a memory region by name.
+ * @note    The list is walked in a critical zone, the search time is
+ *          proportional to the number of regions.
+ *
+ * @param[in] name      the region name
+ * @return              The region.
+ * @retval NULL         if a region with the specified name does not exist.
+ *
+ * @api
+ */
+MemoryRegion *chCoreFindRegion(const char *name) {
+  MemoryRegion *mrp;
+
+  chDbgCheck(name != NULL, "chCoreFindRegion");
+
+  chSysLock();
+  mrp = regions;
+  while ((mrp != NULL) && (strcmp(mrp->mr_name, name) != 0))
+    mrp = mrp->mr_next;
+  chSysUnlock();
+  return mrp;
+}
+
+/**
+ * @brief   Allocates a memory block from a region.
+ * @details The size of the returned block is aligned to the alignment
+ *          type so it is not possible to allocate less than
+ *          <code>MEM_ALIGN_SIZE</code>.
+ *
+ * @param[in] mrp       pointer to the @p MemoryRegion structure or @p NULL
+ *                      for the default region
+ * @param[in] size      the size of the block to be allocated
+ * @return              A pointer to the allocated memory block.
+ * @retval NULL         allocation failed, region memory exhausted.
+ *
+ * @api
+ */
+void *chCoreAllocFrom(MemoryRegion *mrp, size_t size) {
+  void *p;
+
+  chSysLock();
+  p = chCoreAllocFromI(mrp, size);
+  chSysUnlock();
+  return p;
+}
+
+/**
+ * @brief   Allocates a memory block from a region.
+ * @details The size of the returned block is aligned to the alignment
+ *          type so it is not possible to allocate less than
+ *          <code>MEM_ALIGN_SIZE</code>.
+ *
+ * @param[in] mrp       pointer to the @p MemoryRegion structure or @p NULL
+ *                      for the default region
+ * @param[in] size      the size of the block to be allocated
+ * @return              A pointer to the allocated memory block.
+ * @retval NULL         allocation failed, region memory exhausted.
+ *
+ * @iclass
+ */
+void *chCoreAllocFromI(MemoryRegion *mrp, size_t size) {
+  void *p;
+
+  chDbgCheckClassI();
+
+  if (mrp == NULL)
+    mrp = &core_region;
+  size = MEM_ALIGN_NEXT(size);
+  if ((size_t)(mrp->mr_end - mrp->mr_free) < size) {
+    mrp->mr_fails++;
+    return NULL;
+  }
+  p = mrp->mr_free;
+  mrp->mr_free += size;
+  mrp->mr_allocs++;
+  return p;
+}
+
+/**
+ * @brief   Allocates a memory block selecting the region by attributes.
+ * @details The speed in @p attr is a preference, the block is allocated
+ *          from the slowest region having the requested speed or higher
+ *          and enough free space, else from the fastest slower region.
+ *          The @p MEM_DMA attribute is a requirement, regions not
+ *          reachable by DMA are not considered when it is specified.
+ *
+ * @param[in] size      the size of the block to be allocated
+ * @param[in] attr      preferred speed and required attributes
+ * @return              A pointer to the allocated memory block.
+ * @retval NULL         allocation failed, no suitable region has enough
+ *                      free memory.
+ *
+ * @api
+ */
+void *chCoreAllocPlaced(size_t size, memattr_t attr) {
+  void *p;
+
+  chSysLock();
+  p = chCoreAllocPlacedI(size, attr);
+  chSysUnlock();
+  return p;
+}
+
+/**
+ * @brief   Allocates a memory block selecting the region by attributes.
+ * @details The speed in @p attr is a preference, the block is allocated
+ *          from the slowest region having the requested speed or higher
+ *          and enough free space, else from the fastest slower region.
+ *          The @p MEM_DMA attribute is a requirement, regions not
+ *          reachable by DMA are not considered when it is specified.
+ *
+ * @param[in] size      the size of the block to be allocated
+ * @param[in] attr      preferred speed and required attributes
+ * @return              A pointer to the allocated memory block.
+ * @retval NULL         allocation failed, no suitable region has enough
+ *                      free memory.
+ *
+ * @iclass
+ */
+void *chCoreAllocPlacedI(size_t size, memattr_t attr) {
+  MemoryRegion *mrp, *found;
+
+  chDbgCheckClassI();
+
+  size = MEM_ALIGN_NEXT(size);
+  found = NULL;
+  mrp = regions;
+  while ((mrp != NULL) && (speed_of(mrp->mr_attr) >= speed_of(attr))) {
+    if (region_fits(mrp, size, attr))
+      found = mrp;
+    mrp = mrp->mr_next;
+  }
+  while ((found == NULL) && (mrp != NULL)) {
+    if (region_fits(mrp, size, attr))
+      found = mrp;
+    mrp = mrp->mr_next;
+  }
+  if (found == NULL)
+    return NULL;
+  return chCoreAllocFromI(found, size);
+}
+
+/**
+ * @brief   Returns the statistics of a memory region.
+ *
+ * @param[in] mrp       pointer to the @p MemoryRegion structure or @p NULL
+ *                      for the default region
+ * @param[out] msp      pointer to the @p MemoryRegionStats structure
+ *
+ * @api
+ */
+void chCoreGetStats(MemoryRegion *mrp, MemoryRegionStats *msp) {
+
+  chDbgCheck(msp != NULL, "chCoreGetStats");
+
+  if (mrp == NULL)
+    mrp = &core_region;
+  chSysLock();
+  msp->size   = (size_t)(mrp->mr_end - mrp->mr_base);
+  msp->used   = (size_t)(mrp->mr_free - mrp->mr_base);
+  msp->allocs = mrp->mr_allocs;
+  msp->fails  = mrp->mr_fails;
+  chSysUnlock();
 }
+#endif /* CH_USE_MEMCORE_REGIONS */
 #endif /* CH_USE_MEMCORE */
 
 /** @} */
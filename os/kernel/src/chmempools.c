@@ -59,8 +59,37 @@ void chPoolInit(MemoryPool *mp, size_t size, memgetfunc_t provider) {
   mp->mp_next = NULL;
   mp->mp_object_size = size;
   mp->mp_provider = provider;
+#if CH_USE_MEMCORE_REGIONS
+  mp->mp_region = NULL;
+#endif
 }
 
+#if CH_USE_MEMCORE_REGIONS || defined(__DOXYGEN__)
+/**
+ * @brief   Initializes an empty memory pool bound to a memory region.
+ * @details The pool grows by allocating objects from the region when it
+ *          is empty, freed objects are kept in the pool.
+ *
+ * @param[out] mp       pointer to a @p MemoryPool structure
+ * @param[in] size      the size of the objects contained in this memory pool,
+ *                      the minimum accepted size is the size of a pointer to
+ *                      void.
+ * @param[in] mrp       pointer to the @p MemoryRegion structure
+ *
+ * @init
+ */
+void chPoolInitRegion(MemoryPool *mp, size_t size, MemoryRegion *mrp) {
+
+  chDbgCheck((mp != NULL) && (size >= sizeof(void *)) && (mrp != NULL),
+             "chPoolInitRegion");
+
+  mp->mp_next = NULL;
+  mp->mp_object_size = size;
+  mp->mp_provider = NULL;
+  mp->mp_region = mrp;
+}
+#endif /* CH_USE_MEMCORE_REGIONS */
+
 /**
  * @brief   Loads a memory pool with an array of static objects.
  * @pre     The memory pool must be already been initialized.
@@ -103,6 +132,10 @@ void *chPoolAllocI(MemoryPool *mp) {
 
   if ((objp = mp->mp_next) != NULL)
     mp->mp_next = mp->mp_next->ph_next;
+#if CH_USE_MEMCORE_REGIONS
+  else if (mp->mp_region != NULL)
+    objp = chCoreAllocFromI(mp->mp_region, mp->mp_object_size);
+#endif
   else if (mp->mp_provider != NULL)
     objp = mp->mp_provider(mp->mp_object_size);
   return objp;
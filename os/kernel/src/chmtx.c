@@ -66,6 +66,7 @@
  */
 
 #include "ch.h"
+#include "chprivate.h"
 
 #if CH_USE_MUTEXES || defined(__DOXYGEN__)
 
@@ -84,6 +85,65 @@ void chMtxInit(Mutex *mp) {
   mp->m_owner = NULL;
 }
 
+/**
+ * @brief   Enqueues a thread on a locked mutex.
+ * @details The priority inheritance protocol is applied to the chain of
+ *          the mutex owners, the thread state is not changed.
+ *
+ * @param[in] mp        pointer to the @p Mutex structure
+ * @param[in] tp        pointer to the thread, it must not be in any queue
+ *
+ * @notapi
+ */
+void _mtx_enqueue(Mutex *mp, Thread *tp) {
+  /* Priority inheritance protocol; explores the thread-mutex dependencies
+     boosting the priority of all the affected threads to equal the priority
+     of the thread requesting the mutex.*/
+  Thread *otp = mp->m_owner;
+
+  /* Does the requesting thread have higher priority than the mutex owning
+     thread? */
+  while (otp->p_prio < tp->p_prio) {
+    /* Make priority of thread otp match the requesting thread's priority.*/
+    otp->p_prio = tp->p_prio;
+    /* The following states need priority queues reordering.*/
+    switch (otp->p_state) {
+    case THD_STATE_WTMTX:
+      /* Re-enqueues the mutex owner with its new priority.*/
+      prio_insert(dequeue(otp), (ThreadsQueue *)otp->p_u.wtobjp);
+      otp = ((Mutex *)otp->p_u.wtobjp)->m_owner;
+      continue;
+#if CH_USE_CONDVARS |                                                       \
+    (CH_USE_SEMAPHORES && CH_USE_SEMAPHORES_PRIORITY) |                     \
+    (CH_USE_MESSAGES && CH_USE_MESSAGES_PRIORITY)
+#if CH_USE_CONDVARS
+    case THD_STATE_WTCOND:
+#endif
+#if CH_USE_SEMAPHORES && CH_USE_SEMAPHORES_PRIORITY
+    case THD_STATE_WTSEM:
+#endif
+#if CH_USE_MESSAGES && CH_USE_MESSAGES_PRIORITY
+    case THD_STATE_SNDMSGQ:
+#endif
+      /* Re-enqueues otp with its new priority on the queue.*/
+      prio_insert(dequeue(otp), (ThreadsQueue *)otp->p_u.wtobjp);
+      break;
+#endif
+    case THD_STATE_READY:
+#if CH_DBG_ENABLE_ASSERTS
+      /* Prevents an assertion in chSchReadyI().*/
+      otp->p_state = THD_STATE_CURRENT;
+#endif
+      /* Re-enqueues otp with its new priority on the ready list.*/
+      chSchReadyI(dequeue(otp));
+      break;
+    }
+    break;
+  }
+  prio_insert(tp, &mp->m_queue);
+  tp->p_u.wtobjp = mp;
+}
+
 /**
  * @brief   Locks the specified mutex.
  * @post    The mutex is locked and inserted in the per-thread stack of owned
@@ -119,52 +179,8 @@ void chMtxLockS(Mutex *mp) {
 
   /* Is the mutex already locked? */
   if (mp->m_owner != NULL) {
-    /* Priority inheritance protocol; explores the thread-mutex dependencies
-       boosting the priority of all the affected threads to equal the priority
-       of the running thread requesting the mutex.*/
-    Thread *tp = mp->m_owner;
-    /* Does the running thread have higher priority than the mutex
-       owning thread? */
-    while (tp->p_prio < ctp->p_prio) {
-      /* Make priority of thread tp match the running thread's priority.*/
-      tp->p_prio = ctp->p_prio;
-      /* The following states need priority queues reordering.*/
-      switch (tp->p_state) {
-      case THD_STATE_WTMTX:
-        /* Re-enqueues the mutex owner with its new priority.*/
-        prio_insert(dequeue(tp), (ThreadsQueue *)tp->p_u.wtobjp);
-        tp = ((Mutex *)tp->p_u.wtobjp)->m_owner;
-        continue;
-#if CH_USE_CONDVARS |                                                       \
-    (CH_USE_SEMAPHORES && CH_USE_SEMAPHORES_PRIORITY) |                     \
-    (CH_USE_MESSAGES && CH_USE_MESSAGES_PRIORITY)
-#if CH_USE_CONDVARS
-      case THD_STATE_WTCOND:
-#endif
-#if CH_USE_SEMAPHORES && CH_USE_SEMAPHORES_PRIORITY
-      case THD_STATE_WTSEM:
-#endif
-#if CH_USE_MESSAGES && CH_USE_MESSAGES_PRIORITY
-      case THD_STATE_SNDMSGQ:
-#endif
-        /* Re-enqueues tp with its new priority on the queue.*/
-        prio_insert(dequeue(tp), (ThreadsQueue *)tp->p_u.wtobjp);
-        break;
-#endif
-      case THD_STATE_READY:
-#if CH_DBG_ENABLE_ASSERTS
-        /* Prevents an assertion in chSchReadyI().*/
-        tp->p_state = THD_STATE_CURRENT;
-#endif
-        /* Re-enqueues tp with its new priority on the ready list.*/
-        chSchReadyI(dequeue(tp));
-        break;
-      }
-      break;
-    }
     /* Sleep on the mutex.*/
-    prio_insert(ctp, &mp->m_queue);
-    ctp->p_u.wtobjp = mp;
+    _mtx_enqueue(mp, ctp);
     chSchGoSleepS(THD_STATE_WTMTX);
     /* It is assumed that the thread performing the unlock operation assigns
        the mutex to this thread.*/
@@ -268,7 +284,7 @@ Mutex *chMtxUnlock(void) {
 
     /* Recalculates the optimal thread priority by scanning the owned
        mutexes list.*/
-    tprio_t newprio = ctp->p_realprio;
+    tprio_t newprio = cmtx_base_prio(ctp);
     mp = ctp->p_mtxlist;
     while (mp != NULL) {
       /* If the highest priority thread waiting in the mutexes list has a
@@ -329,7 +345,7 @@ Mutex *chMtxUnlockS(void) {
 
     /* Recalculates the optimal thread priority by scanning the owned
        mutexes list.*/
-    tprio_t newprio = ctp->p_realprio;
+    tprio_t newprio = cmtx_base_prio(ctp);
     mp = ctp->p_mtxlist;
     while (mp != NULL) {
       /* If the highest priority thread waiting in the mutexes list has a
@@ -382,7 +398,7 @@ void chMtxUnlockAll(void) {
       else
         ump->m_owner = NULL;
     } while (ctp->p_mtxlist != NULL);
-    ctp->p_prio = ctp->p_realprio;
+    ctp->p_prio = cmtx_base_prio(ctp);
     chSchRescheduleS();
   }
   chSysUnlock();
@@ -0,0 +1,46 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006,2007,2008,2009,2010,
+                 2011,2012,2013 Giovanni Di Sirio.
+
+    This file is part of ChibiOS/RT.
+
+    ChibiOS/RT is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    ChibiOS/RT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file    chprivate.h
+ * @brief   Kernel private declarations.
+ * @details This header is only included by the kernel source files, the
+ *          declared functions are not part of the API.
+ *
+ * @addtogroup internals
+ * @{
+ */
+
+#ifndef _CHPRIVATE_H_
+#define _CHPRIVATE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if CH_USE_MUTEXES
+  void _mtx_enqueue(Mutex *mp, Thread *tp);
+#endif
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CHPRIVATE_H_ */
+
+/** @} */
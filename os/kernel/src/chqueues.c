@@ -41,6 +41,8 @@
  * @{
  */
 
+#include <string.h>
+
 #include "ch.h"
 
 #if CH_USE_QUEUES || defined(__DOXYGEN__)
@@ -148,6 +150,54 @@ msg_t chIQPutI(InputQueue *iqp, uint8_t b) {
   return Q_OK;
 }
 
+/**
+ * @brief   Input queue block write.
+ * @details A block of bytes is written into the low end of an input queue,
+ *          the copy is performed with at most two @p memcpy() operations.
+ *          This function is meant for drivers moving data in blocks, for
+ *          example from a DMA buffer.
+ * @note    If the queue has not enough space only the first bytes are
+ *          written.
+ *
+ * @param[in] iqp       pointer to an @p InputQueue structure
+ * @param[in] bp        pointer to the data buffer
+ * @param[in] n         the number of bytes to be written
+ * @return              The number of bytes effectively written.
+ *
+ * @iclass
+ */
+size_t chIQPutBlockI(InputQueue *iqp, const uint8_t *bp, size_t n) {
+  size_t s1, s2;
+
+  chDbgCheckClassI();
+
+  s1 = chIQGetEmptyI(iqp);
+  if (n > s1)
+    n = s1;
+  s1 = iqp->q_top - iqp->q_wrptr;
+  if (n < s1)
+    s1 = n;
+  s2 = n - s1;
+  memcpy(iqp->q_wrptr, bp, s1);
+  if (s2 > 0) {
+    memcpy(iqp->q_buffer, bp + s1, s2);
+    iqp->q_wrptr = iqp->q_buffer + s2;
+  }
+  else {
+    iqp->q_wrptr += s1;
+    if (iqp->q_wrptr >= iqp->q_top)
+      iqp->q_wrptr = iqp->q_buffer;
+  }
+  iqp->q_counter += n;
+
+  /* A waiting thread is resumed for each byte, as if the bytes were
+     written one at time.*/
+  for (s1 = 0; (s1 < n) && notempty(&iqp->q_waiting); s1++)
+    chSchReadyI(fifo_remove(&iqp->q_waiting))->p_u.rdymsg = Q_OK;
+
+  return n;
+}
+
 /**
  * @brief   Input queue read with timeout.
  * @details This function reads a byte value from an input queue. If the queue
@@ -372,6 +422,53 @@ msg_t chOQGetI(OutputQueue *oqp) {
   return b;
 }
 
+/**
+ * @brief   Output queue block read.
+ * @details A block of bytes is read from the bottom of an output queue,
+ *          the copy is performed with at most two @p memcpy() operations.
+ *          This function is meant for drivers moving data in blocks, for
+ *          example to a DMA buffer.
+ *
+ * @param[in] oqp       pointer to an @p OutputQueue structure
+ * @param[out] bp       pointer to the data buffer
+ * @param[in] n         the maximum number of bytes to be read
+ * @return              The number of bytes effectively read, zero if the
+ *                      queue is empty.
+ *
+ * @iclass
+ */
+size_t chOQGetBlockI(OutputQueue *oqp, uint8_t *bp, size_t n) {
+  size_t s1, s2;
+
+  chDbgCheckClassI();
+
+  s1 = chOQGetFullI(oqp);
+  if (n > s1)
+    n = s1;
+  s1 = oqp->q_top - oqp->q_rdptr;
+  if (n < s1)
+    s1 = n;
+  s2 = n - s1;
+  memcpy(bp, oqp->q_rdptr, s1);
+  if (s2 > 0) {
+    memcpy(bp + s1, oqp->q_buffer, s2);
+    oqp->q_rdptr = oqp->q_buffer + s2;
+  }
+  else {
+    oqp->q_rdptr += s1;
+    if (oqp->q_rdptr >= oqp->q_top)
+      oqp->q_rdptr = oqp->q_buffer;
+  }
+  oqp->q_counter += n;
+
+  /* A waiting thread is resumed for each byte, as if the bytes were
+     read one at time.*/
+  for (s1 = 0; (s1 < n) && notempty(&oqp->q_waiting); s1++)
+    chSchReadyI(fifo_remove(&oqp->q_waiting))->p_u.rdymsg = Q_OK;
+
+  return n;
+}
+
 /**
  * @brief   Output queue write with timeout.
  * @details The function writes data from a buffer to an output queue. The
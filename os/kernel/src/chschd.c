@@ -37,23 +37,135 @@
  * @brief   Ready list header.
  */
 #if !defined(PORT_OPTIMIZED_RLIST_VAR) || defined(__DOXYGEN__)
+#if CH_USE_SMP
+ReadyList _rlist[PORT_CORES_NUMBER];
+#else
 ReadyList rlist;
+#endif
 #endif /* !defined(PORT_OPTIMIZED_RLIST_VAR) */
 
+#if CH_USE_SMP || defined(__DOXYGEN__)
+/*
+ * Priority a thread has to exceed in order to run immediately on a core.
+ */
+static tprio_t core_prio(ReadyList *rlp) {
+  tprio_t prio = firstprio(&rlp->r_queue);
+
+  return prio > rlp->r_current->p_prio ? prio : rlp->r_current->p_prio;
+}
+
+/*
+ * Selects the core for a thread becoming ready. The last core the thread
+ * ran on is preferred if the thread would run there immediately, else the
+ * allowed core running the lowest priority work is selected, ties are
+ * resolved in favor of the last core.
+ */
+static unsigned select_core(Thread *tp) {
+  unsigned n, core = tp->p_core;
+  bool_t found = FALSE;
+  tprio_t prio, min = 0;
+
+  chDbgAssert((tp->p_affinity & CH_ALL_CORES) != 0,
+              "select_core(), #1",
+              "empty affinity mask");
+
+  if (tp->p_affinity & CH_CORE_MASK(core)) {
+    min = core_prio(corelist(core));
+    if (min < tp->p_prio)
+      return core;
+    found = TRUE;
+  }
+  for (n = 0; n < PORT_CORES_NUMBER; n++) {
+    if (tp->p_affinity & CH_CORE_MASK(n)) {
+      prio = core_prio(corelist(n));
+      if (!found || (prio < min)) {
+        found = TRUE;
+        core = n;
+        min = prio;
+      }
+    }
+  }
+  return core;
+}
+
+/*
+ * Moves the highest priority ready thread allowed on the specified core
+ * from the ready lists of the other cores to the core ready list. The idle
+ * threads are never moved because they are bound to their own core.
+ */
+static void steal(unsigned core) {
+  ReadyList *rlp;
+  Thread *tp, *cp = NULL;
+  unsigned n;
+
+  for (n = 0; n < PORT_CORES_NUMBER; n++) {
+    if (n == core)
+      continue;
+    rlp = corelist(n);
+    for (tp = rlp->r_queue.p_next;
+         tp != (Thread *)&rlp->r_queue;
+         tp = tp->p_next) {
+      if (tp->p_affinity & CH_CORE_MASK(core)) {
+        if ((cp == NULL) || (tp->p_prio > cp->p_prio))
+          cp = tp;
+        break;
+      }
+    }
+  }
+  if (cp != NULL) {
+    dequeue(cp)->p_core = core;
+    tp = (Thread *)&corelist(core)->r_queue;
+    do {
+      tp = tp->p_next;
+    } while (tp->p_prio >= cp->p_prio);
+    cp->p_next = tp;
+    cp->p_prev = tp->p_prev;
+    cp->p_prev->p_next = tp->p_prev = cp;
+  }
+}
+#endif /* CH_USE_SMP */
+
 /**
  * @brief   Scheduler initialization.
  *
  * @notapi
  */
 void _scheduler_init(void) {
+#if CH_USE_SMP
+  unsigned n;
 
+  for (n = 0; n < PORT_CORES_NUMBER; n++) {
+    queue_init(&corelist(n)->r_queue);
+    corelist(n)->r_prio = NOPRIO;
+  }
+#else
   queue_init(&rlist.r_queue);
   rlist.r_prio = NOPRIO;
+#endif
 #if CH_USE_REGISTRY
   rlist.r_newer = rlist.r_older = (Thread *)&rlist;
 #endif
 }
 
+#if (CH_USE_SMP && CH_DBG_ENABLE_ASSERTS) || defined(__DOXYGEN__)
+/**
+ * @brief   Ready list of the invoking core, checked version.
+ * @details Debug version of @p currlist(), the core identifier is only
+ *          stable while the kernel is locked.
+ *
+ * @return              The ready list of the invoking core.
+ *
+ * @notapi
+ */
+ReadyList *_scheduler_currlist(void) {
+
+  chDbgAssert(port_is_locked(),
+              "_scheduler_currlist(), #1",
+              "kernel not locked");
+  return corelist(port_get_core_id());
+}
+#endif /* CH_USE_SMP && CH_DBG_ENABLE_ASSERTS */
+
 /**
  * @brief   Inserts a thread in the Ready List.
  * @details The thread is positioned behind all threads with higher or equal
@@ -64,6 +176,10 @@ void _scheduler_init(void) {
  *          function must be performed before unlocking the kernel. Note that
  *          interrupt handlers always reschedule on exit so an explicit
  *          reschedule must not be performed in ISRs.
+ * @note    In SMP mode the thread is inserted in the ready list of one of
+ *          the cores allowed by its affinity mask, if it is not the invoking
+ *          core and the thread preempts the thread running there then the
+ *          core is notified using @p port_notify_core().
  *
  * @param[in] tp        the thread to be made ready
  * @return              The thread pointer.
@@ -73,6 +189,9 @@ void _scheduler_init(void) {
 #if !defined(PORT_OPTIMIZED_READYI) || defined(__DOXYGEN__)
 Thread *chSchReadyI(Thread *tp) {
   Thread *cp;
+#if CH_USE_SMP
+  unsigned core;
+#endif
 
   chDbgCheckClassI();
 
@@ -83,7 +202,12 @@ Thread *chSchReadyI(Thread *tp) {
               "invalid state");
 
   tp->p_state = THD_STATE_READY;
+#if CH_USE_SMP
+  tp->p_core = core = select_core(tp);
+  cp = (Thread *)&corelist(core)->r_queue;
+#else
   cp = (Thread *)&rlist.r_queue;
+#endif
   do {
     cp = cp->p_next;
   } while (cp->p_prio >= tp->p_prio);
@@ -91,6 +215,11 @@ Thread *chSchReadyI(Thread *tp) {
   tp->p_next = cp;
   tp->p_prev = cp->p_prev;
   tp->p_prev->p_next = cp->p_prev = tp;
+#if CH_USE_SMP
+  if ((core != port_get_core_id()) &&
+      (tp->p_prio > corelist(core)->r_current->p_prio))
+    port_notify_core(core);
+#endif
   return tp;
 }
 #endif /* !defined(PORT_OPTIMIZED_READYI) */
@@ -99,6 +228,8 @@ Thread *chSchReadyI(Thread *tp) {
  * @brief   Puts the current thread to sleep into the specified state.
  * @details The thread goes into a sleeping state. The possible
  *          @ref thread_states are defined into @p threads.h.
+ * @note    In SMP mode a core left with only its idle thread takes a ready
+ *          thread from the other cores, if any is allowed to run on it.
  *
  * @param[in] newstate  the new thread state
  *
@@ -109,6 +240,11 @@ void chSchGoSleepS(tstate_t newstate) {
   Thread *otp;
 
   chDbgCheckClassS();
+#if CH_USE_CEILING_MUTEXES
+  chDbgAssert(currp->p_cmtxlist == NULL,
+              "chSchGoSleepS(), #1",
+              "sleeping with ceiling mutex");
+#endif
 
   (otp = currp)->p_state = newstate;
 #if CH_TIME_QUANTUM > 0
@@ -116,7 +252,12 @@ void chSchGoSleepS(tstate_t newstate) {
      time quantum when it will wakeup.*/
   otp->p_preempt = CH_TIME_QUANTUM;
 #endif
-  setcurrp(fifo_remove(&rlist.r_queue));
+#if CH_USE_SMP
+  /* Only the idle thread is left, looking for work on the other cores.*/
+  if (firstprio(&currlist()->r_queue) == IDLEPRIO)
+    steal(port_get_core_id());
+#endif
+  setcurrp(fifo_remove(&currlist()->r_queue));
   currp->p_state = THD_STATE_CURRENT;
   chSysSwitch(currp, otp);
 }
@@ -136,6 +277,13 @@ static void wakeup(void *p) {
        another thread with higher priority.*/
     chSysUnlockFromIsr();
     return;
+#if CH_USE_CONDVARS && CH_USE_CONDVARS_TIMEOUT
+  case THD_STATE_WTMTX:
+    /* A thread waiting on a condition variable has been signaled and moved
+       on the mutex queue, the timeout no longer applies.*/
+    chSysUnlockFromIsr();
+    return;
+#endif
 #if CH_USE_SEMAPHORES || CH_USE_QUEUES ||                                   \
     (CH_USE_CONDVARS && CH_USE_CONDVARS_TIMEOUT)
 #if CH_USE_SEMAPHORES
@@ -208,6 +356,8 @@ msg_t chSchGoSleepTimeoutS(tstate_t newstate, systime_t time) {
  *          @p chSchRescheduleS() but much more efficient.
  * @note    The function assumes that the current thread has the highest
  *          priority.
+ * @note    In SMP mode a thread not allowed on the invoking core is made
+ *          ready on one of its allowed cores.
  *
  * @param[in] ntp       the Thread to be made ready
  * @param[in] msg       message to the awakened thread
@@ -224,11 +374,24 @@ void chSchWakeupS(Thread *ntp, msg_t msg) {
      one then it is just inserted in the ready list else it made
      running immediately and the invoking thread goes in the ready
      list instead.*/
+#if CH_USE_SMP
+  if ((ntp->p_prio <= currp->p_prio) ||
+      !(ntp->p_affinity & CH_CORE_MASK(port_get_core_id())))
+    chSchReadyI(ntp);
+  else {
+    Thread *otp = currp;
+    /* The current thread is made ready after the switch of the current
+       pointer, it could be placed on another core.*/
+    ntp->p_core = port_get_core_id();
+    setcurrp(ntp);
+    chSchReadyI(otp);
+#else
   if (ntp->p_prio <= currp->p_prio)
     chSchReadyI(ntp);
   else {
     Thread *otp = chSchReadyI(currp);
     setcurrp(ntp);
+#endif
     ntp->p_state = THD_STATE_CURRENT;
     chSysSwitch(ntp, otp);
   }
@@ -267,7 +430,7 @@ void chSchRescheduleS(void) {
  */
 #if !defined(PORT_OPTIMIZED_ISPREEMPTIONREQUIRED) || defined(__DOXYGEN__)
 bool_t chSchIsPreemptionRequired(void) {
-  tprio_t p1 = firstprio(&rlist.r_queue);
+  tprio_t p1 = firstprio(&currlist()->r_queue);
   tprio_t p2 = currp->p_prio;
 #if CH_TIME_QUANTUM > 0
   /* If the running thread has not reached its time quantum, reschedule only
@@ -290,6 +453,7 @@ bool_t chSchIsPreemptionRequired(void) {
  *          quantum.
  * @note    Not a user function, it is meant to be invoked by the scheduler
  *          itself or from within the port layer.
+ * @note    In SMP mode the current thread can be moved to another core.
  *
  * @special
  */
@@ -298,8 +462,14 @@ void chSchDoRescheduleBehind(void) {
   Thread *otp;
 
   otp = currp;
+#if CH_USE_SMP
+  /* Only the idle thread is left if the current thread is being moved to
+     another core.*/
+  if (firstprio(&currlist()->r_queue) == IDLEPRIO)
+    steal(port_get_core_id());
+#endif
   /* Picks the first thread from the ready queue and makes it current.*/
-  setcurrp(fifo_remove(&rlist.r_queue));
+  setcurrp(fifo_remove(&currlist()->r_queue));
   currp->p_state = THD_STATE_CURRENT;
 #if CH_TIME_QUANTUM > 0
   otp->p_preempt = CH_TIME_QUANTUM;
@@ -315,6 +485,9 @@ void chSchDoRescheduleBehind(void) {
  *          threads having the same priority.
  * @note    Not a user function, it is meant to be invoked by the scheduler
  *          itself or from within the port layer.
+ * @note    In SMP mode the current thread is moved behind the threads
+ *          having the same priority of another core if it would run there
+ *          earlier.
  *
  * @special
  */
@@ -324,11 +497,18 @@ void chSchDoRescheduleAhead(void) {
 
   otp = currp;
   /* Picks the first thread from the ready queue and makes it current.*/
-  setcurrp(fifo_remove(&rlist.r_queue));
+  setcurrp(fifo_remove(&currlist()->r_queue));
   currp->p_state = THD_STATE_CURRENT;
 
+#if CH_USE_SMP
+  if (select_core(otp) != port_get_core_id()) {
+    chSchReadyI(otp);
+    chSysSwitch(currp, otp);
+    return;
+  }
+#endif
   otp->p_state = THD_STATE_READY;
-  cp = (Thread *)&rlist.r_queue;
+  cp = (Thread *)&currlist()->r_queue;
   do {
     cp = cp->p_next;
   } while (cp->p_prio > otp->p_prio);
@@ -36,10 +36,19 @@
 #include "ch.h"
 
 #if !CH_NO_IDLE_THREAD || defined(__DOXYGEN__)
+#if CH_USE_SMP || defined(__DOXYGEN__)
+/**
+ * @brief   Idle threads working areas, one for each core.
+ */
+stkalign_t _idle_thread_wa[PORT_CORES_NUMBER]
+                          [THD_WA_SIZE(PORT_IDLE_THREAD_STACK_SIZE) /
+                           sizeof(stkalign_t)];
+#else
 /**
  * @brief   Idle thread working area.
  */
 WORKING_AREA(_idle_thread_wa, PORT_IDLE_THREAD_STACK_SIZE);
+#endif
 
 /**
  * @brief   This function implements the idle thread infinite loop.
@@ -69,6 +78,8 @@ void _idle_thread(void *p) {
  * @pre     Interrupts must be still disabled when @p chSysInit() is invoked
  *          and are internally enabled.
  * @post    The main thread is created with priority @p NORMALPRIO.
+ * @post    In SMP mode the main thread is bound to the core zero and the
+ *          other cores are started running their idle threads.
  * @note    This function has special, architecture-dependent, requirements,
  *          see the notes into the various port reference manuals.
  *
@@ -79,6 +90,10 @@ void chSysInit(void) {
 #if CH_DBG_ENABLE_STACK_CHECK
   extern stkalign_t __main_thread_stack_base__;
 #endif
+#if CH_USE_SMP
+  Thread *tp;
+  unsigned n;
+#endif
 
   port_init();
   _scheduler_init();
@@ -100,6 +115,26 @@ void chSysInit(void) {
   /* This is a special case because the main thread Thread structure is not
      adjacent to its stack area.*/
   currp->p_stklimit = &__main_thread_stack_base__;
+#endif
+#if CH_USE_SMP
+  /* The main thread, and the threads it creates, stay on the core zero
+     unless the affinity is changed, each core has its own idle thread.
+     The other cores are started while the kernel is still disabled, they
+     enter their idle threads after the kernel is enabled.*/
+  currp->p_affinity = CH_CORE_MASK(0);
+  for (n = 0; n < PORT_CORES_NUMBER; n++) {
+    tp = chThdCreateI(_idle_thread_wa[n], sizeof(_idle_thread_wa[n]),
+                      IDLEPRIO, (tfunc_t)_idle_thread, NULL);
+    tp->p_affinity = CH_CORE_MASK(n);
+    tp->p_core = n;
+    if (n == 0)
+      chSchReadyI(tp);
+    else {
+      tp->p_state = THD_STATE_CURRENT;
+      corelist(n)->r_current = tp;
+      port_start_core(n, tp);
+    }
+  }
 #endif
   chSysEnable();
 
@@ -107,7 +142,7 @@ void chSysInit(void) {
      active, else the parameter is ignored.*/
   chRegSetThreadName((const char *)&ch_debug);
 
-#if !CH_NO_IDLE_THREAD
+#if !CH_NO_IDLE_THREAD && !CH_USE_SMP
   /* This thread has the lowest priority in the system, its role is just to
      serve interrupts in its context while keeping the lowest energy saving
      mode compatible with the system status.*/
@@ -124,6 +159,10 @@ void chSysInit(void) {
  * @note    The frequency of the timer determines the system tick granularity
  *          and, together with the @p CH_TIME_QUANTUM macro, the round robin
  *          interval.
+ * @note    In SMP mode the system tick is served by a single core, the
+ *          quantum of the threads running on the other cores is decremented
+ *          here and the cores are notified when a round robin preemption is
+ *          required.
  *
  * @iclass
  */
@@ -131,7 +170,22 @@ void chSysTimerHandlerI(void) {
 
   chDbgCheckClassI();
 
-#if CH_TIME_QUANTUM > 0
+#if (CH_TIME_QUANTUM > 0) && CH_USE_SMP
+  {
+    unsigned n;
+
+    for (n = 0; n < PORT_CORES_NUMBER; n++) {
+      ReadyList *rlp = corelist(n);
+      Thread *tp = rlp->r_current;
+
+      if (tp->p_preempt > 0)
+        tp->p_preempt--;
+      if ((n != port_get_core_id()) && (tp->p_preempt == 0) &&
+          (firstprio(&rlp->r_queue) >= tp->p_prio))
+        port_notify_core(n);
+    }
+  }
+#elif CH_TIME_QUANTUM > 0
   /* Running thread has not used up quantum yet? */
   if (currp->p_preempt > 0)
     /* Decrement remaining quantum.*/
@@ -74,13 +74,23 @@ Thread *_thread_init(Thread *tp, tprio_t prio) {
 #if CH_TIME_QUANTUM > 0
   tp->p_preempt = CH_TIME_QUANTUM;
 #endif
+#if CH_USE_SMP
+  tp->p_core = port_get_core_id();
+  tp->p_affinity = CH_ALL_CORES;
+#endif
 #if CH_USE_MUTEXES
   tp->p_realprio = prio;
   tp->p_mtxlist = NULL;
 #endif
+#if CH_USE_CEILING_MUTEXES
+  tp->p_cmtxlist = NULL;
+#endif
 #if CH_USE_EVENTS
   tp->p_epending = 0;
 #endif
+#if CH_USE_ARENAS
+  tp->p_arena = NULL;
+#endif
 #if CH_DBG_THREADS_PROFILING
   tp->p_time = 0;
 #endif
@@ -135,6 +145,8 @@ void _thread_memfill(uint8_t *startp, uint8_t *endp, uint8_t v) {
  * @note    Threads created using this function do not obey to the
  *          @p CH_DBG_FILL_THREADS debug option because it would keep
  *          the kernel locked for too much time.
+ * @note    In SMP mode the new thread inherits the affinity mask of the
+ *          current thread.
  *
  * @param[out] wsp      pointer to a working area dedicated to the thread stack
  * @param[in] size      size of the working area
@@ -158,7 +170,12 @@ Thread *chThdCreateI(void *wsp, size_t size,
              (prio <= HIGHPRIO) && (pf != NULL),
              "chThdCreateI");
   SETUP_CONTEXT(wsp, size, pf, arg);
+#if CH_USE_SMP
+  _thread_init(tp, prio)->p_affinity = currp->p_affinity;
+  return tp;
+#else
   return _thread_init(tp, prio);
+#endif
 }
 
 /**
@@ -195,6 +212,72 @@ Thread *chThdCreateStatic(void *wsp, size_t size,
   return tp;
 }
 
+#if CH_USE_MEMCORE_REGIONS || defined(__DOXYGEN__)
+/**
+ * @brief   Creates a new thread allocating the working area from a memory
+ *          region.
+ * @pre     The configuration option @p CH_USE_MEMCORE_REGIONS must be
+ *          enabled in order to use this function.
+ * @note    The working area is never returned to the region, this function
+ *          is meant for threads created once and living for the whole
+ *          system lifetime. Threads to be terminated and created again
+ *          should use @p chThdCreateFromHeap() with a heap bound to the
+ *          region.
+ *
+ * @param[in] mrp       pointer to the @p MemoryRegion structure or @p NULL
+ *                      for the default region
+ * @param[in] size      size of the working area to be allocated
+ * @param[in] prio      the priority level for the new thread
+ * @param[in] pf        the thread function
+ * @param[in] arg       an argument passed to the thread function. It can be
+ *                      @p NULL.
+ * @return              The pointer to the @p Thread structure allocated for
+ *                      the thread into the working space area.
+ * @retval NULL         if the memory cannot be allocated.
+ *
+ * @api
+ */
+Thread *chThdCreateFromRegion(MemoryRegion *mrp, size_t size,
+                              tprio_t prio, tfunc_t pf, void *arg) {
+  void *wsp;
+
+  wsp = chCoreAllocFrom(mrp, size);
+  if (wsp == NULL)
+    return NULL;
+  return chThdCreateStatic(wsp, size, prio, pf, arg);
+}
+
+/**
+ * @brief   Creates a new thread placing the working area in the fastest
+ *          memory available.
+ * @details The working area is allocated using @p chCoreAllocPlaced()
+ *          with the @p MEM_SPEED_FAST preference, slower regions are used
+ *          when the fast ones are exhausted.
+ * @pre     The configuration option @p CH_USE_MEMCORE_REGIONS must be
+ *          enabled in order to use this function.
+ * @note    The working area is never returned to the memory core.
+ *
+ * @param[in] size      size of the working area to be allocated
+ * @param[in] prio      the priority level for the new thread
+ * @param[in] pf        the thread function
+ * @param[in] arg       an argument passed to the thread function. It can be
+ *                      @p NULL.
+ * @return              The pointer to the @p Thread structure allocated for
+ *                      the thread into the working space area.
+ * @retval NULL         if the memory cannot be allocated.
+ *
+ * @api
+ */
+Thread *chThdCreateFast(size_t size, tprio_t prio, tfunc_t pf, void *arg) {
+  void *wsp;
+
+  wsp = chCoreAllocPlaced(size, MEM_SPEED_FAST);
+  if (wsp == NULL)
+    return NULL;
+  return chThdCreateStatic(wsp, size, prio, pf, arg);
+}
+#endif /* CH_USE_MEMCORE_REGIONS */
+
 /**
  * @brief   Changes the running thread priority level then reschedules if
  *          necessary.
@@ -218,6 +301,12 @@ tprio_t chThdSetPriority(tprio_t newprio) {
   if ((currp->p_prio == currp->p_realprio) || (newprio > currp->p_prio))
     currp->p_prio = newprio;
   currp->p_realprio = newprio;
+#if CH_USE_CEILING_MUTEXES
+  /* The priority cannot fall below the ceiling of the owned ceiling
+     mutexes.*/
+  if (cmtx_base_prio(currp) > currp->p_prio)
+    currp->p_prio = cmtx_base_prio(currp);
+#endif
 #else
   oldprio = currp->p_prio;
   currp->p_prio = newprio;
@@ -227,6 +316,35 @@ tprio_t chThdSetPriority(tprio_t newprio) {
   return oldprio;
 }
 
+#if CH_USE_SMP || defined(__DOXYGEN__)
+/**
+ * @brief   Changes the running thread affinity mask.
+ * @details The thread is moved to one of the allowed cores if the invoking
+ *          core is no more allowed by the new mask.
+ * @note    The threads created afterward by this thread inherit the new
+ *          mask.
+ *
+ * @param[in] mask      the new affinity mask, it must allow at least one
+ *                      of the @p PORT_CORES_NUMBER cores
+ * @return              The old affinity mask.
+ *
+ * @api
+ */
+coremask_t chThdSetAffinity(coremask_t mask) {
+  coremask_t oldmask;
+
+  chDbgCheck((mask & CH_ALL_CORES) != 0, "chThdSetAffinity");
+
+  chSysLock();
+  oldmask = currp->p_affinity;
+  currp->p_affinity = mask;
+  if (!(mask & CH_CORE_MASK(port_get_core_id())))
+    chSchDoRescheduleBehind();
+  chSysUnlock();
+  return oldmask;
+}
+#endif /* CH_USE_SMP */
+
 /**
  * @brief   Resumes a suspended thread.
  * @pre     The specified thread pointer must refer to an initialized thread
@@ -221,10 +221,10 @@ struct context {
 #define port_enable()
 
 /**
- * In the simulator this does a polling pass on the simulated interrupt
- * sources.
+ * In the simulator this waits for the simulated interrupt sources, the
+ * host thread is blocked until an interrupt source becomes ready.
  */
-#define port_wait_for_interrupt() ChkIntSources()
+#define port_wait_for_interrupt() WaitIntSources()
 
 #ifdef __cplusplus
 extern "C" {
@@ -234,6 +234,7 @@ extern "C" {
   __attribute__((cdecl, noreturn)) void _port_thread_start(msg_t (*pf)(void *),
                                                            void *p);
   void ChkIntSources(void);
+  void WaitIntSources(void);
 #ifdef __cplusplus
 }
 #endif
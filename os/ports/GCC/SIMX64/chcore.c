@@ -0,0 +1,462 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006,2007,2008,2009,2010,
+                 2011,2012,2013 Giovanni Di Sirio.
+
+    This file is part of ChibiOS/RT.
+
+    ChibiOS/RT is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    ChibiOS/RT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @addtogroup SIMX64_CORE
+ * @{
+ */
+
+#include <stdlib.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#if CH_USE_SMP
+#include <pthread.h>
+#include <sched.h>
+
+#if !defined(__ELF__) || !defined(__SEG_FS)
+#error "CH_USE_SMP requires an ELF host and a compiler supporting __seg_fs"
+#endif
+
+/**
+ * @brief   Host signal used for the reschedule requests between cores.
+ */
+#define IPI_SIGNAL      SIGUSR1
+
+/**
+ * @brief   Failed spinlock attempts before releasing the host processor.
+ */
+#define SPIN_YIELD_COUNT 100
+
+/**
+ * @brief   Host thread variable access.
+ * @details The variable is accessed using a single @p FS relative
+ *          instruction. A thread switched out by a core can be resumed by
+ *          another core, an address computed before the switch would point
+ *          to the variable of the previous host thread.
+ */
+#define TLS_VAR(v) (*({                                                 \
+  uintptr_t _off;                                                       \
+  asm ("mov     $" #v "@tpoff, %0" : "=r" (_off));                      \
+  (volatile __typeof__(v) __seg_fs *)_off;                              \
+}))
+
+/**
+ * @brief   Simulated interrupt masked, one flag for each core.
+ */
+static __thread bool_t irq_masked __attribute__((used));
+
+/**
+ * @brief   Simulated interrupt pending, one flag for each core.
+ */
+static __thread bool_t irq_pending __attribute__((used));
+
+/**
+ * @brief   Current thread of the core.
+ * @note    Copy of the @p r_current field of the core ready list.
+ */
+static __thread Thread *current __attribute__((used));
+
+/**
+ * @brief   Kernel spinlock.
+ */
+static volatile bool kernel_lock;
+
+/**
+ * @brief   Host threads of the cores.
+ */
+static pthread_t core_threads[PORT_CORES_NUMBER];
+
+/**
+ * @brief   Identifier of the core of the host thread.
+ */
+static __thread unsigned core_id __attribute__((used));
+
+#define IRQ_MASKED      TLS_VAR(irq_masked)
+#define IRQ_PENDING     TLS_VAR(irq_pending)
+#else /* !CH_USE_SMP */
+/**
+ * @brief   Simulated interrupt masked.
+ */
+volatile bool_t _port_irq_masked;
+
+/**
+ * @brief   Simulated interrupt pending.
+ */
+volatile bool_t _port_irq_pending;
+
+#define IRQ_MASKED      _port_irq_masked
+#define IRQ_PENDING     _port_irq_pending
+#endif /* !CH_USE_SMP */
+
+/**
+ * Performs a context switch between two threads.
+ * @param otp the thread to be switched out
+ * @param ntp the thread to be switched in
+ */
+__attribute__((used))
+static void __dummy(Thread *ntp, Thread *otp) {
+  (void)ntp; (void)otp;
+
+  asm volatile (
+#if defined(__APPLE__)
+                ".globl _port_switch                            \n\t"
+                "_port_switch:"
+#else
+                ".globl port_switch                             \n\t"
+                "port_switch:"
+#endif
+                "push    %rbp                                   \n\t"
+                "push    %rbx                                   \n\t"
+                "push    %r12                                   \n\t"
+                "push    %r13                                   \n\t"
+                "push    %r14                                   \n\t"
+                "push    %r15                                   \n\t"
+                "movq    %rsp, 24(%rsi)                         \n\t"
+                "movq    24(%rdi), %rsp                         \n\t"
+                "pop     %r15                                   \n\t"
+                "pop     %r14                                   \n\t"
+                "pop     %r13                                   \n\t"
+                "pop     %r12                                   \n\t"
+                "pop     %rbx                                   \n\t"
+                "pop     %rbp                                   \n\t"
+                "ret                                            \n\t"
+#if defined(__APPLE__)
+                ".globl __port_thread_start                     \n\t"
+                "__port_thread_start:"
+#else
+                ".globl _port_thread_start                      \n\t"
+                "_port_thread_start:"
+#endif
+                "movq    %r12, %rdi                             \n\t"
+                "movq    %r13, %rsi                             \n\t"
+#if defined(__APPLE__)
+                "call    __port_thread_exec"
+#else
+                "call    _port_thread_exec"
+#endif
+                );
+}
+
+/**
+ * @brief   Start a thread by invoking its work function.
+ * @details If the work function returns @p chThdExit() is automatically
+ *          invoked.
+ */
+__attribute__((used, noreturn))
+static void _port_thread_exec(msg_t (*pf)(void *), void *p) {
+
+  chSysUnlock();
+  chThdExit(pf(p));
+  while(1);
+}
+
+/**
+ * @brief   Simulated interrupt signal handler.
+ * @details The signal is only recorded if the simulated interrupt is
+ *          masked.
+ */
+static void port_signal_handler(int sig) {
+
+  (void)sig;
+  IRQ_PENDING = TRUE;
+  if (!IRQ_MASKED)
+    _port_irq_serve();
+}
+
+/**
+ * @brief   Port initialization.
+ * @details The simulated interrupt is masked until @p port_enable() and
+ *          the host timer is started.
+ * @note    The signal is not deferred by the host while the handler runs,
+ *          the handler can switch to another thread before returning.
+ */
+void _port_init(void) {
+  struct sigaction sa;
+  struct itimerval it;
+
+#if CH_USE_SMP
+  /* The kernel starts locked on the core zero.*/
+  core_threads[0] = pthread_self();
+  IRQ_MASKED = TRUE;
+  _port_spin_lock();
+#else
+  _port_irq_masked  = TRUE;
+  _port_irq_pending = FALSE;
+#endif
+
+  sa.sa_handler = port_signal_handler;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_NODEFER | SA_RESTART;
+  sigaction(SIGALRM, &sa, NULL);
+#if CH_USE_SMP
+  sigaction(IPI_SIGNAL, &sa, NULL);
+#endif
+
+  it.it_interval.tv_sec  = 0;
+  it.it_interval.tv_usec = 1000000 / PORT_SIGNAL_FREQUENCY;
+  it.it_value = it.it_interval;
+  setitimer(ITIMER_REAL, &it, NULL);
+}
+
+/**
+ * @brief   Serves the pending simulated interrupt.
+ * @details The interrupt sources are polled with the simulated interrupt
+ *          masked, the signals arriving meanwhile cause another pass.
+ *          The thread switches performed by @p ChkIntSources() leave the
+ *          interrupt masked, the next thread unmasks it.
+ */
+void _port_irq_serve(void) {
+
+  do {
+    IRQ_MASKED = TRUE;
+    while (IRQ_PENDING) {
+      IRQ_PENDING = FALSE;
+#if CH_USE_SMP
+      /* The interrupt sources are served by the core zero, the other cores
+         only serve the reschedule requests.*/
+      if (_port_get_core_id() == 0)
+        ChkIntSources();
+      chSysLockFromIsr();
+      if (chSchIsPreemptionRequired())
+        chSchDoReschedule();
+      chSysUnlockFromIsr();
+#else
+      ChkIntSources();
+#endif
+    }
+    IRQ_MASKED = FALSE;
+  } while (IRQ_PENDING);
+}
+
+/**
+ * @brief   Waits for the next simulated interrupt.
+ * @details The interrupt sources are waited with the simulated interrupt
+ *          masked, a signal arriving meanwhile ends the wait and it is
+ *          served on unmasking.
+ * @note    In SMP mode the kernel is not locked while waiting, the core
+ *          zero waits on the interrupt sources and the other cores wait
+ *          for a reschedule request.
+ */
+void _port_wait_for_interrupt(void) {
+#if CH_USE_SMP
+  sigset_t set, old;
+
+  IRQ_MASKED = TRUE;
+  if (_port_get_core_id() == 0) {
+    if (!IRQ_PENDING)
+      WaitIntSources();
+  }
+  else {
+    /* The signal is blocked while checking the pending flag, the wait
+       atomically unblocks it.*/
+    sigemptyset(&set);
+    sigaddset(&set, IPI_SIGNAL);
+    pthread_sigmask(SIG_BLOCK, &set, &old);
+    if (!IRQ_PENDING)
+      sigsuspend(&old);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+  }
+  IRQ_MASKED = FALSE;
+  if (IRQ_PENDING)
+    _port_irq_serve();
+#else
+  port_lock();
+  _port_irq_pending = FALSE;
+  WaitIntSources();
+  port_unlock();
+#endif
+}
+
+#if CH_USE_SMP || defined(__DOXYGEN__)
+/**
+ * @brief   Returns the identifier of the invoking core.
+ * @note    The result is only stable while the simulated interrupt is
+ *          masked, the invoking thread can be moved to another core
+ *          otherwise.
+ */
+unsigned _port_get_core_id(void) {
+
+  return TLS_VAR(core_id);
+}
+
+/**
+ * @brief   Returns the current thread of the invoking core.
+ * @details The pointer is read with a single instruction so a thread
+ *          always reads its own pointer, even if it is moved to another
+ *          core while the kernel is unlocked.
+ */
+Thread *_port_get_current(void) {
+
+  return TLS_VAR(current);
+}
+
+/**
+ * @brief   Changes the current thread of the invoking core.
+ * @note    Must be invoked with the kernel locked.
+ *
+ * @param[in] tp        the new current thread
+ */
+void _port_set_current(Thread *tp) {
+
+  corelist(TLS_VAR(core_id))->r_current = tp;
+  TLS_VAR(current) = tp;
+}
+
+/**
+ * @brief   Returns the simulated interrupt state of the invoking core.
+ *
+ * @return              The simulated interrupt state.
+ * @retval TRUE         if masked, the invoking thread cannot be moved to
+ *                      another core.
+ * @retval FALSE        if not masked.
+ */
+bool_t _port_is_locked(void) {
+
+  return IRQ_MASKED;
+}
+
+/**
+ * @brief   Acquires the kernel spinlock.
+ */
+void _port_spin_lock(void) {
+  unsigned n = 0;
+
+  while (__atomic_test_and_set(&kernel_lock, __ATOMIC_ACQUIRE)) {
+    /* The owner could be a host thread not currently running, the host
+       processor is released after a while.*/
+    if (++n >= SPIN_YIELD_COUNT) {
+      n = 0;
+      sched_yield();
+    }
+    else
+      asm volatile ("pause" : : : "memory");
+  }
+}
+
+/**
+ * @brief   Releases the kernel spinlock.
+ */
+void _port_spin_unlock(void) {
+
+  __atomic_clear(&kernel_lock, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief   Kernel-lock action.
+ * @details The simulated interrupt of the core is masked then the kernel
+ *          spinlock is acquired.
+ * @note    The flag is written with a single instruction, the core is
+ *          only known after masking.
+ */
+void _port_lock(void) {
+
+  IRQ_MASKED = TRUE;
+  asm volatile ("" : : : "memory");
+  _port_spin_lock();
+}
+
+/**
+ * @brief   Kernel-unlock action.
+ * @details The kernel spinlock is released then the simulated interrupt
+ *          of the core is unmasked, a pending signal is served
+ *          immediately.
+ * @note    The core can differ from the one that locked the kernel, the
+ *          lock is owned by the core and not by the thread.
+ */
+void _port_unlock(void) {
+
+  _port_spin_unlock();
+  IRQ_MASKED = FALSE;
+  asm volatile ("" : : : "memory");
+  if (IRQ_PENDING)
+    _port_irq_serve();
+}
+
+/**
+ * @brief   Sends a reschedule request to a core.
+ *
+ * @param[in] n         the core number
+ */
+void _port_notify_core(unsigned n) {
+
+  pthread_kill(core_threads[n], IPI_SIGNAL);
+}
+
+/**
+ * @brief   Host thread of a core.
+ * @details The host thread takes the kernel lock and switches to the
+ *          thread set as current for the core, the initial context is
+ *          never resumed. The host thread starts with all the signals
+ *          blocked, the reschedule request signal is unblocked after the
+ *          simulated interrupt is masked.
+ */
+static void *core_thread(void *arg) {
+  Thread boot;
+  sigset_t set;
+
+  core_id = (unsigned)(uintptr_t)arg;
+  _port_lock();
+  current = corelist(core_id)->r_current;
+  sigemptyset(&set);
+  sigaddset(&set, IPI_SIGNAL);
+  pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+  port_switch(current, &boot);
+  return NULL;
+}
+
+/**
+ * @brief   Starts a core.
+ *
+ * @param[in] n         the core number
+ * @param[in] tp        the thread to be run by the core, it must be already
+ *                      the current thread of the core
+ */
+void _port_start_core(unsigned n, Thread *tp) {
+  sigset_t set, old;
+  int err;
+
+  (void)tp;
+  /* The new host thread inherits a mask blocking all the signals, a signal
+     served before the core is set up would run the kernel on an unknown
+     core. The timer signal stays blocked so it is always delivered to the
+     core zero.*/
+  sigfillset(&set);
+  pthread_sigmask(SIG_BLOCK, &set, &old);
+  err = pthread_create(&core_threads[n], NULL, core_thread,
+                       (void *)(uintptr_t)n);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (err != 0)
+    port_halt();
+}
+#endif /* CH_USE_SMP */
+
+/**
+ * Halts the system. In this implementation it just exits the simulation.
+ */
+void port_halt(void) {
+
+  exit(2);
+}
+
+/** @} */
@@ -0,0 +1,363 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006,2007,2008,2009,2010,
+                 2011,2012,2013 Giovanni Di Sirio.
+
+    This file is part of ChibiOS/RT.
+
+    ChibiOS/RT is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    ChibiOS/RT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @addtogroup SIMX64_CORE
+ * @{
+ */
+
+#ifndef _CHCORE_H_
+#define _CHCORE_H_
+
+#if CH_DBG_ENABLE_STACK_CHECK
+#error "option CH_DBG_ENABLE_STACK_CHECK not supported by this port"
+#endif
+
+/**
+ * Macro defining a simulated architecture into x86-64.
+ */
+#define CH_ARCHITECTURE_SIMX64
+
+/**
+ * Name of the implemented architecture.
+ */
+#define CH_ARCHITECTURE_NAME            "Simulator"
+
+/**
+ * @brief   Name of the architecture variant (optional).
+ */
+#define CH_CORE_VARIANT_NAME            "x86-64 (integer only)"
+
+/**
+ * @brief   Name of the compiler supported by this port.
+ */
+#define CH_COMPILER_NAME                "GCC " __VERSION__
+
+/**
+ * @brief   Port-specific information string.
+ */
+#define CH_PORT_INFO                    "Preemption by host signals"
+
+/**
+ * @brief   Frequency of the simulated interrupt.
+ * @details A host timer signal is raised at this frequency, each signal
+ *          is a simulated interrupt polling all the interrupt sources
+ *          using @p ChkIntSources(), the system tick included. The
+ *          interrupt preempts the running thread.
+ * @note    It should be a multiple of @p CH_FREQUENCY.
+ */
+#ifndef PORT_SIGNAL_FREQUENCY
+#define PORT_SIGNAL_FREQUENCY           (CH_FREQUENCY * 2)
+#endif
+
+/**
+ * @brief   Number of simulated cores.
+ * @details Each core is a host thread, the core zero is the host thread
+ *          invoking @p chSysInit() and it is the only one polling the
+ *          simulated interrupt sources. The other cores only receive the
+ *          reschedule requests as host signals.
+ * @note    Only used when the @p CH_USE_SMP option is enabled.
+ */
+#if CH_USE_SMP || defined(__DOXYGEN__)
+#if !defined(PORT_CORES_NUMBER) || defined(__DOXYGEN__)
+#define PORT_CORES_NUMBER               4
+#endif
+#endif
+
+/**
+ * 16 bytes stack alignment.
+ */
+typedef struct {
+  uint8_t a[16];
+} stkalign_t __attribute__((aligned(16)));
+
+/**
+ * Generic x86-64 register.
+ */
+typedef void *regx64;
+
+/**
+ * Interrupt saved context.
+ * This structure represents the stack frame saved during a preemption-capable
+ * interrupt handler.
+ * @note    The interrupted context is saved by the host in the signal frame.
+ */
+struct extctx {
+};
+
+/**
+ * System saved context.
+ * @note In this port the floating point registers are not saved.
+ */
+struct intctx {
+  regx64  r15;
+  regx64  r14;
+  regx64  r13;
+  regx64  r12;
+  regx64  rbx;
+  regx64  rbp;
+  regx64  rip;
+};
+
+/**
+ * Platform dependent part of the @p Thread structure.
+ * This structure usually contains just the saved stack pointer defined as a
+ * pointer to a @p intctx structure.
+ */
+struct context {
+  struct intctx volatile *esp;
+};
+
+/**
+ * Platform dependent part of the @p chThdCreateI() API.
+ * This code usually setup the context switching frame represented by a
+ * @p intctx structure.
+ * @note    The thread function and its argument are passed in @p r12 and
+ *          @p r13 to @p _port_thread_start(), the stack is left aligned
+ *          for its call to the C code.
+ */
+#define SETUP_CONTEXT(workspace, wsize, pf, arg) {                      \
+  uint8_t *esp = (uint8_t *)workspace + wsize;                          \
+  esp = (uint8_t *)((uintptr_t)esp & ~(uintptr_t)15);                   \
+  esp -= sizeof(struct intctx);                                         \
+  ((struct intctx *)esp)->rip = (void *)_port_thread_start;             \
+  ((struct intctx *)esp)->rbp = NULL;                                   \
+  ((struct intctx *)esp)->rbx = NULL;                                   \
+  ((struct intctx *)esp)->r12 = (void *)(pf);                           \
+  ((struct intctx *)esp)->r13 = (void *)(arg);                          \
+  ((struct intctx *)esp)->r14 = NULL;                                   \
+  ((struct intctx *)esp)->r15 = NULL;                                   \
+  tp->p_ctx.esp = (struct intctx *)esp;                                 \
+}
+
+/**
+ * Stack size for the system idle thread.
+ */
+#ifndef PORT_IDLE_THREAD_STACK_SIZE
+#define PORT_IDLE_THREAD_STACK_SIZE     256
+#endif
+
+/**
+ * Per-thread stack overhead for interrupts servicing, it is used in the
+ * calculation of the correct working area size.
+ * It requires stack space because the signal frame is pushed on the stack
+ * of the preempted thread and the simulated "interrupt handlers" can invoke
+ * host library functions inside so it better have a lot of space.
+ */
+#ifndef PORT_INT_REQUIRED_STACK
+#define PORT_INT_REQUIRED_STACK         32768
+#endif
+
+/**
+ * Enforces a correct alignment for a stack area size value.
+ */
+#define STACK_ALIGN(n) ((((n) - 1) | (sizeof(stkalign_t) - 1)) + 1)
+
+ /**
+  * Computes the thread working area global size.
+  */
+#define THD_WA_SIZE(n) STACK_ALIGN(sizeof(Thread) +                     \
+                                   sizeof(void *) * 4 +                 \
+                                   sizeof(struct intctx) +              \
+                                   sizeof(struct extctx) +              \
+                                   (n) + (PORT_INT_REQUIRED_STACK))
+
+/**
+ * Macro used to allocate a thread working area aligned as both position and
+ * size.
+ */
+#define WORKING_AREA(s, n) stkalign_t s[THD_WA_SIZE(n) / sizeof(stkalign_t)]
+
+/**
+ * IRQ prologue code, inserted at the start of all IRQ handlers enabled to
+ * invoke system APIs.
+ */
+#define PORT_IRQ_PROLOGUE()
+
+/**
+ * IRQ epilogue code, inserted at the end of all IRQ handlers enabled to
+ * invoke system APIs.
+ */
+#define PORT_IRQ_EPILOGUE()
+
+/**
+ * IRQ handler function declaration.
+ */
+#define PORT_IRQ_HANDLER(id) void id(void)
+
+/**
+ * Simulator initialization, the simulated interrupt is started disabled.
+ */
+#define port_init() _port_init()
+
+#if CH_USE_SMP || defined(__DOXYGEN__)
+/**
+ * @brief   Identifier of the invoking core.
+ * @note    Only available when the @p CH_USE_SMP option is enabled.
+ */
+#define port_get_core_id() _port_get_core_id()
+
+/**
+ * @brief   Simulated interrupt state of the invoking core.
+ * @details Returns @p TRUE if the simulated interrupt of the invoking core
+ *          is masked, the invoking thread cannot be moved to another core
+ *          until it is unmasked.
+ * @note    Only available when the @p CH_USE_SMP option is enabled.
+ */
+#define port_is_locked() _port_is_locked()
+
+/**
+ * @brief   Requests a reschedule to another core.
+ * @details A host signal is sent to the host thread of the core, the
+ *          request is served as a simulated interrupt.
+ * @note    Only available when the @p CH_USE_SMP option is enabled.
+ */
+#define port_notify_core(n) _port_notify_core(n)
+
+/**
+ * @brief   Starts a core running the specified thread.
+ * @details The host thread of the core is created, it enters the thread
+ *          after the kernel is unlocked by the core zero.
+ * @note    Only available when the @p CH_USE_SMP option is enabled.
+ */
+#define port_start_core(n, tp) _port_start_core(n, tp)
+
+/**
+ * @brief   Current thread pointer access macro.
+ * @details Each core also keeps its current thread in a host thread
+ *          variable, a thread reads its own pointer even if it is moved to
+ *          another core while the kernel is unlocked.
+ * @note    Only used when the @p CH_USE_SMP option is enabled.
+ */
+#define PORT_OPTIMIZED_CURRP
+#define currp _port_get_current()
+
+/**
+ * @brief   Current thread pointer change macro.
+ * @note    Only used when the @p CH_USE_SMP option is enabled.
+ */
+#define PORT_OPTIMIZED_SETCURRP
+#define setcurrp(tp) _port_set_current(tp)
+#endif /* CH_USE_SMP */
+
+#if CH_USE_SMP
+/* In SMP mode the kernel lock also serializes the cores using a global
+   spinlock, the lock is taken with the simulated interrupt of the core
+   already masked.*/
+#define port_lock() _port_lock()
+#define port_unlock() _port_unlock()
+#define port_lock_from_isr() _port_spin_lock()
+#define port_unlock_from_isr() _port_spin_unlock()
+#else /* !CH_USE_SMP */
+/**
+ * @brief   Kernel-lock action.
+ * @details The simulated interrupt is masked, a signal arriving while
+ *          masked is left pending and served on unmask.
+ */
+#define port_lock() {                                                   \
+  _port_irq_masked = TRUE;                                              \
+  asm volatile ("" : : : "memory");                                     \
+}
+
+/**
+ * @brief   Kernel-unlock action.
+ * @details The simulated interrupt is unmasked, a pending signal is
+ *          served immediately.
+ */
+#define port_unlock() {                                                 \
+  asm volatile ("" : : : "memory");                                     \
+  _port_irq_masked = FALSE;                                             \
+  if (_port_irq_pending)                                                \
+    _port_irq_serve();                                                  \
+}
+
+/**
+ * @brief   Kernel-lock action from an interrupt handler.
+ * @note    Does nothing in this port, the simulated interrupt does not
+ *          nest.
+ */
+#define port_lock_from_isr()
+
+/**
+ * @brief   Kernel-unlock action from an interrupt handler.
+ * @note    Does nothing in this port, the simulated interrupt does not
+ *          nest.
+ */
+#define port_unlock_from_isr()
+#endif /* !CH_USE_SMP */
+
+/**
+ * @brief   Disables all the interrupt sources.
+ */
+#define port_disable() port_lock()
+
+/**
+ * @brief   Disables the interrupt sources below kernel-level priority.
+ */
+#define port_suspend() port_lock()
+
+/**
+ * @brief   Enables all the interrupt sources.
+ */
+#define port_enable() port_unlock()
+
+/**
+ * @brief   Enters an architecture-dependent IRQ-waiting mode.
+ * @details In the simulator this waits for the simulated interrupt
+ *          sources, the host thread is blocked until an interrupt source
+ *          becomes ready.
+ */
+#define port_wait_for_interrupt() _port_wait_for_interrupt()
+
+#if !defined(__DOXYGEN__) && !CH_USE_SMP
+extern volatile bool_t _port_irq_masked;
+extern volatile bool_t _port_irq_pending;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void _port_init(void);
+  void _port_irq_serve(void);
+  void _port_wait_for_interrupt(void);
+#if CH_USE_SMP
+  unsigned _port_get_core_id(void);
+  bool_t _port_is_locked(void);
+  Thread *_port_get_current(void);
+  void _port_set_current(Thread *tp);
+  void _port_notify_core(unsigned n);
+  void _port_start_core(unsigned n, Thread *tp);
+  void _port_lock(void);
+  void _port_unlock(void);
+  void _port_spin_lock(void);
+  void _port_spin_unlock(void);
+#endif
+  void port_switch(Thread *ntp, Thread *otp);
+  void port_halt(void);
+  void _port_thread_start(void);
+  void ChkIntSources(void);
+  void WaitIntSources(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CHCORE_H_ */
+
+/** @} */
@@ -0,0 +1,6 @@
+# List of the ChibiOS/RT SIMX64 port files.
+PORTSRC = ${CHIBIOS}/os/ports/GCC/SIMX64/chcore.c
+
+PORTASM = 
+
+PORTINC = ${CHIBIOS}/os/ports/GCC/SIMX64
@@ -0,0 +1,327 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    adc_stream.c
+ * @brief   ADC streaming code.
+ * @details The ADC driver runs in circular mode on a buffer divided in two
+ *          halves, each half buffer event takes a block from the free
+ *          mailbox, fills it with the reduced samples and posts it into
+ *          the filled mailbox. The consumer thread receives pointers to
+ *          the blocks and returns them when done, no samples are copied
+ *          after the reduction.<br>
+ *          When no free block is available the half buffer is dropped and
+ *          an overrun is counted, the sequence numbers let the consumer
+ *          detect the gap.
+ *
+ * @addtogroup adc_stream
+ * @{
+ */
+
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "adc_stream.h"
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/**
+ * @brief   Marker posted in the filled mailbox on ADC errors.
+ */
+#define ERROR_MARKER                    ((msg_t)0)
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+/**
+ * @brief   Reduces a half buffer into a block.
+ *
+ * @param[in] config    the stream configuration
+ * @param[in] nch       number of channels
+ * @param[out] dp       destination block samples
+ * @param[in] sp        source samples
+ * @param[in] n         number of source rows
+ * @return              The number of rows written.
+ */
+static size_t reduce(const ADCStreamConfig *config, size_t nch,
+                     adcsample_t *dp, const adcsample_t *sp, size_t n) {
+  unsigned dec = config->decimation;
+  size_t rows = n / dec;
+  size_t i, ch;
+
+  if (dec == 1) {
+    memcpy(dp, sp, n * nch * sizeof (adcsample_t));
+    return n;
+  }
+  if (config->kernel == ADCS_KERNEL_DECIMATE) {
+    for (i = 0; i < rows; i++) {
+      for (ch = 0; ch < nch; ch++)
+        *dp++ = sp[ch];
+      sp += dec * nch;
+    }
+  }
+  else {
+    for (i = 0; i < rows; i++) {
+      for (ch = 0; ch < nch; ch++) {
+        const adcsample_t *p = sp + ch;
+        uint32_t acc = 0;
+        unsigned k;
+
+        for (k = 0; k < dec; k++) {
+          acc += *p;
+          p += nch;
+        }
+        *dp++ = (adcsample_t)((acc + dec / 2) / dec);
+      }
+      sp += dec * nch;
+    }
+  }
+  return rows;
+}
+
+/**
+ * @brief   Half and full buffer callback.
+ *
+ * @param[in] adcp      pointer to the @p ADCDriver object
+ * @param[in] buffer    pointer to the most recent samples data
+ * @param[in] n         number of buffer rows available starting from @p buffer
+ */
+static void stream_end_cb(ADCDriver *adcp, adcsample_t *buffer, size_t n) {
+  ADCStream *asp = (ADCStream *)adcp->grpp;
+  ADCStreamBlock *blkp;
+  msg_t msg;
+
+  chSysLockFromIsr();
+  if (chMBFetchI(&asp->free, &msg) != RDY_OK) {
+    asp->stats.overruns++;
+    asp->seq++;
+    chSysUnlockFromIsr();
+    return;
+  }
+  blkp = (ADCStreamBlock *)msg;
+  blkp->seq = asp->seq++;
+  if (++asp->used > asp->stats.max_used)
+    asp->stats.max_used = asp->used;
+  chSysUnlockFromIsr();
+
+  /* The block is owned by this handler until posted, the reduction is
+     performed outside the critical zone.*/
+  blkp->n = reduce(asp->config, asp->grp.num_channels,
+                   blkp->samples, buffer, n);
+  blkp->timestamp = ADC_STREAM_TIMESTAMP();
+
+  chSysLockFromIsr();
+  chMBPostI(&asp->filled, msg);
+  asp->stats.blocks++;
+  chSysUnlockFromIsr();
+}
+
+/**
+ * @brief   Error callback.
+ *
+ * @param[in] adcp      pointer to the @p ADCDriver object
+ * @param[in] err       ADC error code
+ */
+static void stream_error_cb(ADCDriver *adcp, adcerror_t err) {
+  ADCStream *asp = (ADCStream *)adcp->grpp;
+
+  chSysLockFromIsr();
+  asp->state = ADCS_ERROR;
+  asp->error = err;
+  /* There is always room for the marker, the filled mailbox is one slot
+     larger than the number of blocks.*/
+  chMBPostI(&asp->filled, ERROR_MARKER);
+  chSysUnlockFromIsr();
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Initializes an ADC stream object.
+ *
+ * @param[out] asp      pointer to the @p ADCStream object
+ *
+ * @init
+ */
+void adcsObjectInit(ADCStream *asp) {
+
+  asp->state  = ADCS_STOP;
+  asp->adcp   = NULL;
+  asp->config = NULL;
+}
+
+/**
+ * @brief   Starts streaming.
+ * @details The conversion group is copied, forced in circular mode and
+ *          started on the ADC driver.
+ * @pre     The ADC driver must have been started.
+ *
+ * @param[in] asp       pointer to the @p ADCStream object
+ * @param[in] adcp      pointer to the @p ADCDriver object
+ * @param[in] config    pointer to the @p ADCStreamConfig object
+ *
+ * @api
+ */
+void adcsStart(ADCStream *asp, ADCDriver *adcp,
+               const ADCStreamConfig *config) {
+  size_t i, rows;
+
+  chDbgCheck((asp != NULL) && (adcp != NULL) && (config != NULL) &&
+             (config->grpp != NULL) && (config->buffer != NULL) &&
+             (config->depth >= 2) && ((config->depth & 1) == 0) &&
+             (config->decimation >= 1) &&
+             ((config->depth / 2) % config->decimation == 0) &&
+             (config->samples != NULL) && (config->nblocks >= 2) &&
+             (config->nblocks <= ADC_STREAM_MAX_BLOCKS),
+             "adcsStart");
+  chDbgAssert(asp->state != ADCS_ACTIVE, "adcsStart(), #1", "invalid state");
+
+  asp->grp          = *config->grpp;
+  asp->grp.circular = TRUE;
+  asp->grp.end_cb   = stream_end_cb;
+  asp->grp.error_cb = stream_error_cb;
+  asp->adcp         = adcp;
+  asp->config       = config;
+  asp->seq          = 0;
+  asp->used         = 0;
+  asp->stats.blocks   = 0;
+  asp->stats.overruns = 0;
+  asp->stats.max_used = 0;
+  chMBInit(&asp->free, asp->free_buf, (cnt_t)config->nblocks);
+  chMBInit(&asp->filled, asp->filled_buf, (cnt_t)config->nblocks + 1);
+  rows = config->depth / 2 / config->decimation;
+  for (i = 0; i < config->nblocks; i++) {
+    asp->blocks[i].samples = config->samples +
+                             i * rows * asp->grp.num_channels;
+    asp->blocks[i].n       = 0;
+    (void)chMBPost(&asp->free, (msg_t)&asp->blocks[i], TIME_IMMEDIATE);
+  }
+
+  chSysLock();
+  asp->state = ADCS_ACTIVE;
+  adcStartConversionI(adcp, &asp->grp, config->buffer, config->depth);
+  chSysUnlock();
+}
+
+/**
+ * @brief   Stops streaming.
+ * @details Threads waiting for a block are released and receive @p NULL.
+ *
+ * @param[in] asp       pointer to the @p ADCStream object
+ *
+ * @api
+ */
+void adcsStop(ADCStream *asp) {
+
+  chDbgCheck(asp != NULL, "adcsStop");
+
+  chSysLock();
+  chDbgAssert((asp->state == ADCS_ACTIVE) || (asp->state == ADCS_ERROR),
+              "adcsStop(), #1", "invalid state");
+  if (asp->state == ADCS_ACTIVE)
+    adcStopConversionI(asp->adcp);
+  asp->state = ADCS_STOP;
+  chSysUnlock();
+  chMBReset(&asp->filled);
+}
+
+/**
+ * @brief   Waits for the next block of samples.
+ * @details The returned block belongs to the caller until it is returned
+ *          using @p adcsReleaseBlock(), the producer skips the half
+ *          buffers arriving while all the blocks are taken.
+ *
+ * @param[in] asp       pointer to the @p ADCStream object
+ * @param[in] timeout   the number of ticks before the operation timeouts,
+ *                      the following special values are allowed:
+ *                      - @a TIME_IMMEDIATE immediate timeout.
+ *                      - @a TIME_INFINITE no timeout.
+ *                      .
+ * @return              Pointer to the block.
+ * @retval NULL         if the timeout expired, if the stream has been
+ *                      stopped or if the ADC reported an error.
+ *
+ * @api
+ */
+ADCStreamBlock *adcsGetBlock(ADCStream *asp, systime_t timeout) {
+  msg_t msg;
+
+  chDbgCheck(asp != NULL, "adcsGetBlock");
+
+  chSysLock();
+  if ((asp->state != ADCS_ACTIVE) && (chMBGetUsedCountI(&asp->filled) <= 0)) {
+    chSysUnlock();
+    return NULL;
+  }
+  if (chMBFetchS(&asp->filled, &msg, timeout) != RDY_OK) {
+    chSysUnlock();
+    return NULL;
+  }
+  chSysUnlock();
+  return (ADCStreamBlock *)msg;
+}
+
+/**
+ * @brief   Returns a block to the stream.
+ *
+ * @param[in] asp       pointer to the @p ADCStream object
+ * @param[in] blkp      pointer to a block obtained from @p adcsGetBlock()
+ *
+ * @api
+ */
+void adcsReleaseBlock(ADCStream *asp, ADCStreamBlock *blkp) {
+
+  chDbgCheck((asp != NULL) && (blkp >= &asp->blocks[0]) &&
+             (blkp < &asp->blocks[ADC_STREAM_MAX_BLOCKS]), "adcsReleaseBlock");
+
+  chSysLock();
+  chMBPostI(&asp->free, (msg_t)blkp);
+  asp->used--;
+  chSysUnlock();
+}
+
+/**
+ * @brief   Returns the stream statistics.
+ *
+ * @param[in] asp       pointer to the @p ADCStream object
+ * @param[out] stp      pointer to a @p ADCStreamStats structure
+ *
+ * @api
+ */
+void adcsGetStats(ADCStream *asp, ADCStreamStats *stp) {
+
+  chDbgCheck((asp != NULL) && (stp != NULL), "adcsGetStats");
+
+  chSysLock();
+  *stp = asp->stats;
+  chSysUnlock();
+}
+
+/** @} */
@@ -0,0 +1,256 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    adc_stream.h
+ * @brief   ADC streaming header.
+ *
+ * @addtogroup adc_stream
+ * @{
+ */
+
+#ifndef _ADC_STREAM_H_
+#define _ADC_STREAM_H_
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Maximum number of rotating blocks of a stream.
+ */
+#if !defined(ADC_STREAM_MAX_BLOCKS) || defined(__DOXYGEN__)
+#define ADC_STREAM_MAX_BLOCKS           8
+#endif
+
+/**
+ * @brief   Blocks timestamp source.
+ * @details The default is the system time, a free running counter with
+ *          better resolution can be used instead.
+ */
+#if !defined(ADC_STREAM_TIMESTAMP) || defined(__DOXYGEN__)
+#define ADC_STREAM_TIMESTAMP()          ((uint32_t)chTimeNow())
+#endif
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if !HAL_USE_ADC
+#error "ADC streaming requires HAL_USE_ADC"
+#endif
+
+#if !CH_USE_MAILBOXES
+#error "ADC streaming requires CH_USE_MAILBOXES"
+#endif
+
+#if ADC_STREAM_MAX_BLOCKS < 2
+#error "ADC_STREAM_MAX_BLOCKS must be at least 2"
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Stream state.
+ */
+typedef enum {
+  ADCS_UNINIT = 0,                  /**< Not initialized.                   */
+  ADCS_STOP = 1,                    /**< Stopped.                           */
+  ADCS_ACTIVE = 2,                  /**< Streaming.                         */
+  ADCS_ERROR = 3                    /**< Stopped by an ADC error.           */
+} adcsstate_t;
+
+/**
+ * @brief   Reduction kernels applied when decimating.
+ */
+typedef enum {
+  ADCS_KERNEL_DECIMATE = 0,         /**< Keeps the first sample of each
+                                         group.                             */
+  ADCS_KERNEL_AVERAGE = 1           /**< Averages each group.               */
+} adcskernel_t;
+
+/**
+ * @brief   Samples block.
+ */
+typedef struct {
+  /**
+   * @brief   Samples, @p n rows of @p num_channels samples.
+   */
+  adcsample_t                   *samples;
+  /**
+   * @brief   Number of rows in the block.
+   */
+  size_t                        n;
+  /**
+   * @brief   Block sequence number.
+   * @details Sequence numbers of the blocks dropped because of overruns
+   *          are skipped.
+   */
+  uint32_t                      seq;
+  /**
+   * @brief   Timestamp taken when the driver delivered the samples.
+   */
+  uint32_t                      timestamp;
+} ADCStreamBlock;
+
+/**
+ * @brief   Stream configuration structure.
+ */
+typedef struct {
+  /**
+   * @brief   Conversion group.
+   * @details The group is copied in the stream object, the circular mode
+   *          is enforced and the callbacks are replaced.
+   */
+  const ADCConversionGroup      *grpp;
+  /**
+   * @brief   Conversion buffer used by the driver.
+   * @details The buffer is divided in two halves, each half becomes a
+   *          block after decimation.
+   */
+  adcsample_t                   *buffer;
+  /**
+   * @brief   Conversion buffer depth in rows, must be even.
+   */
+  size_t                        depth;
+  /**
+   * @brief   Decimation factor, one for no decimation.
+   * @note    Half depth must be a multiple of the decimation factor.
+   */
+  unsigned                      decimation;
+  /**
+   * @brief   Reduction kernel.
+   */
+  adcskernel_t                  kernel;
+  /**
+   * @brief   Blocks storage.
+   * @details Room for @p nblocks blocks of
+   *          <tt>depth / 2 / decimation</tt> rows.
+   */
+  adcsample_t                   *samples;
+  /**
+   * @brief   Number of rotating blocks.
+   */
+  size_t                        nblocks;
+} ADCStreamConfig;
+
+/**
+ * @brief   Stream statistics.
+ */
+typedef struct {
+  /**
+   * @brief   Blocks delivered to the consumer.
+   */
+  uint32_t                      blocks;
+  /**
+   * @brief   Blocks dropped because no free block was available.
+   */
+  uint32_t                      overruns;
+  /**
+   * @brief   Highest number of blocks owned by the consumer or waiting.
+   */
+  uint32_t                      max_used;
+} ADCStreamStats;
+
+/**
+ * @brief   Stream object.
+ */
+typedef struct {
+  /**
+   * @brief   Conversion group used by the stream, must be the first field.
+   */
+  ADCConversionGroup            grp;
+  /**
+   * @brief   Stream state.
+   */
+  adcsstate_t                   state;
+  /**
+   * @brief   Associated ADC driver.
+   */
+  ADCDriver                     *adcp;
+  /**
+   * @brief   Current configuration data.
+   */
+  const ADCStreamConfig         *config;
+  /**
+   * @brief   Error reported by the driver.
+   */
+  adcerror_t                    error;
+  /**
+   * @brief   Next block sequence number.
+   */
+  uint32_t                      seq;
+  /**
+   * @brief   Blocks not in the free mailbox.
+   */
+  uint32_t                      used;
+  /**
+   * @brief   Statistics.
+   */
+  ADCStreamStats                stats;
+  /**
+   * @brief   Blocks descriptors.
+   */
+  ADCStreamBlock                blocks[ADC_STREAM_MAX_BLOCKS];
+  /**
+   * @brief   Mailbox of the free blocks.
+   */
+  Mailbox                       free;
+  /**
+   * @brief   Mailbox of the filled blocks.
+   */
+  Mailbox                       filled;
+  /**
+   * @brief   Free mailbox buffer.
+   */
+  msg_t                         free_buf[ADC_STREAM_MAX_BLOCKS];
+  /**
+   * @brief   Filled mailbox buffer, one more slot for the error marker.
+   */
+  msg_t                         filled_buf[ADC_STREAM_MAX_BLOCKS + 1];
+} ADCStream;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void adcsObjectInit(ADCStream *asp);
+  void adcsStart(ADCStream *asp, ADCDriver *adcp,
+                 const ADCStreamConfig *config);
+  void adcsStop(ADCStream *asp);
+  ADCStreamBlock *adcsGetBlock(ADCStream *asp, systime_t timeout);
+  void adcsReleaseBlock(ADCStream *asp, ADCStreamBlock *blkp);
+  void adcsGetStats(ADCStream *asp, ADCStreamStats *stp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ADC_STREAM_H_ */
+
+/** @} */
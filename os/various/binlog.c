@@ -0,0 +1,469 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    binlog.c
+ * @brief   Binary log code.
+ * @details Records are stored in the ring as a sequence of 32 bits words:
+ *          - a header containing the record identifier in the upper half
+ *            and the record size in bytes in the lower half, a zero
+ *            header marks a record still being written.
+ *          - the timestamp.
+ *          - the arguments.
+ *          .
+ *          Producers reserve the space and take the timestamp inside a
+ *          short critical zone, the arguments are copied outside of it
+ *          and the header is written last. The drain thread stops at the
+ *          first record not yet committed.<br>
+ *          On the stream each record is a COBS encoded frame terminated
+ *          by a zero byte, the frame contains the identifier, the
+ *          timestamp difference from the previous record and the
+ *          arguments, all encoded as LEB128 variable length integers.
+ *
+ * @addtogroup binlog
+ * @{
+ */
+
+#include "ch.h"
+#include "binlog.h"
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/**
+ * @brief   Identifier of the padding records at the end of the ring.
+ */
+#define ID_PAD                          0xFFFFU
+
+/**
+ * @brief   Compiler barrier.
+ * @details Makes sure the record body is written before its header and
+ *          read after it.
+ */
+#define barrier() __asm__ volatile ("" : : : "memory")
+
+/**
+ * @brief   Start of the log points section.
+ * @note    The symbol is generated by the linker, it is weak so that
+ *          applications without log points still link.
+ */
+extern const uint8_t __start_blstrings[] __attribute__((weak));
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+/**
+ * @brief   Reserves space for a record.
+ * @details The header is cleared and the timestamp written, the record
+ *          space is returned.
+ *
+ * @param[in] blp       pointer to the @p BinLog object
+ * @param[in] level     level of the record
+ * @param[in] n         number of arguments
+ * @return              Pointer to the record space or @p NULL if the
+ *                      record has been dropped.
+ *
+ * @notapi
+ */
+static uint32_t *reserve_s(BinLog *blp, unsigned level, unsigned n) {
+  const BinLogConfig *cfg = blp->config;
+  uint32_t *rp;
+  size_t need, total, free, idx;
+
+  if (blp->state != BINLOG_READY)
+    return NULL;
+
+  need = (n + 2) * sizeof (uint32_t);
+  idx = (size_t)(blp->head & (cfg->size - 1));
+  total = need;
+  if (idx + need > cfg->size)
+    total += cfg->size - idx;
+  free = cfg->size - (size_t)(blp->head - blp->tail);
+  if ((total > free) ||
+      ((level < BINLOG_LEVEL_WARNING) && (total + cfg->reserve > free))) {
+    blp->stats.dropped[level]++;
+    return NULL;
+  }
+
+  if (total != need) {
+    /* Not enough contiguous space at the end of the ring, a padding
+       record makes the drain thread skip to the start.*/
+    cfg->buffer[idx / sizeof (uint32_t)] = ID_PAD << 16;
+    idx = 0;
+  }
+  blp->head += (uint32_t)total;
+  rp = &cfg->buffer[idx / sizeof (uint32_t)];
+  rp[0] = 0;
+  rp[1] = BINLOG_TIMESTAMP();
+  blp->stats.records++;
+  if (cfg->size - free + total > blp->stats.high_water)
+    blp->stats.high_water = cfg->size - free + total;
+  return rp;
+}
+
+/**
+ * @brief   Copies the arguments and commits a record.
+ *
+ * @param[in] blp       pointer to the @p BinLog object
+ * @param[in] rp        pointer to the reserved record space
+ * @param[in] point     pointer to the log point
+ * @param[in] args      pointer to the arguments
+ * @param[in] n         number of arguments
+ * @return              The drain thread must be woken up.
+ *
+ * @notapi
+ */
+static bool_t commit(BinLog *blp, uint32_t *rp, const void *point,
+                     const uint32_t *args, unsigned n) {
+  uint32_t id;
+  unsigned i;
+
+  for (i = 0; i < n; i++)
+    rp[i + 2] = args[i];
+  id = (uint32_t)(((const uint8_t *)point - __start_blstrings) >> 2) +
+       BINLOG_ID_FIRST;
+  barrier();
+  *(volatile uint32_t *)rp = (id << 16) | ((n + 2) * sizeof (uint32_t));
+
+  /* The drain thread is woken up early when the ring is half full.*/
+  if (!blp->wakeup &&
+      ((size_t)(blp->head - blp->tail) >= blp->config->size / 2)) {
+    blp->wakeup = TRUE;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+/**
+ * @brief   Encodes an unsigned integer as LEB128.
+ */
+static uint8_t *put_varint(uint8_t *p, uint32_t v) {
+
+  while (v >= 0x80U) {
+    *p++ = (uint8_t)(v | 0x80U);
+    v >>= 7;
+  }
+  *p++ = (uint8_t)v;
+  return p;
+}
+
+/**
+ * @brief   Encodes a record as a frame in the transmit buffer.
+ * @details The transmit buffer is flushed to the stream if there is not
+ *          enough space for the largest frame.
+ *
+ * @param[in] blp       pointer to the @p BinLog object
+ * @param[in] np        pointer to the transmit buffer fill level
+ * @param[in] id        record identifier
+ * @param[in] time      record timestamp
+ * @param[in] args      pointer to the arguments
+ * @param[in] n         number of arguments
+ *
+ * @notapi
+ */
+static void encode(BinLog *blp, size_t *np, uint32_t id, uint32_t time,
+                   const uint32_t *args, unsigned n) {
+  uint8_t raw[BINLOG_FRAME_MAX - 2];
+  uint8_t *p, *q, *code;
+  uint8_t *end;
+
+  if (*np + BINLOG_FRAME_MAX > BINLOG_OUT_SIZE) {
+    blp->stats.bytes += chSequentialStreamWrite(blp->config->stream,
+                                                blp->out, *np);
+    *np = 0;
+  }
+
+  p = put_varint(raw, id);
+  p = put_varint(p, time - blp->last_time);
+  blp->last_time = time;
+  while (n--)
+    p = put_varint(p, *args++);
+  end = p;
+
+  /* COBS, the frames are shorter than 254 bytes so a single code byte
+     can cover any run.*/
+  code = &blp->out[*np];
+  q = code + 1;
+  *code = 1;
+  for (p = raw; p < end; p++) {
+    if (*p == 0) {
+      code = q++;
+      *code = 1;
+    }
+    else {
+      *q++ = *p;
+      (*code)++;
+    }
+  }
+  *q++ = 0;
+  *np = (size_t)(q - blp->out);
+}
+
+/**
+ * @brief   Moves the committed records from the ring to the stream.
+ *
+ * @param[in] blp       pointer to the @p BinLog object
+ *
+ * @notapi
+ */
+static void drain(BinLog *blp) {
+  const BinLogConfig *cfg = blp->config;
+  uint32_t dropped[BINLOG_LEVELS];
+  uint32_t tail, header;
+  size_t n = 0;
+  bool_t report = FALSE;
+  unsigned i;
+
+  tail = blp->tail;
+  while (tail != blp->head) {
+    uint32_t *rp = &cfg->buffer[(tail & (cfg->size - 1)) /
+                                sizeof (uint32_t)];
+    header = *(volatile uint32_t *)rp;
+    if (header == 0)
+      break;
+    barrier();
+    if ((header >> 16) == ID_PAD)
+      tail += (uint32_t)(cfg->size - (tail & (cfg->size - 1)));
+    else {
+      encode(blp, &n, header >> 16, rp[1], &rp[2],
+             (unsigned)((header & 0xFFFFU) / sizeof (uint32_t)) - 2);
+      tail += header & 0xFFFFU;
+    }
+    /* The record has been copied, the space is released immediately.*/
+    barrier();
+    blp->tail = tail;
+  }
+
+  /* Drops notice.*/
+  chSysLock();
+  for (i = 0; i < BINLOG_LEVELS; i++) {
+    dropped[i] = blp->stats.dropped[i] - blp->reported[i];
+    blp->reported[i] = blp->stats.dropped[i];
+    if (dropped[i] != 0)
+      report = TRUE;
+  }
+  chSysUnlock();
+  if (report)
+    encode(blp, &n, BINLOG_ID_DROPPED, BINLOG_TIMESTAMP(),
+           dropped, BINLOG_LEVELS);
+
+  if (n > 0)
+    blp->stats.bytes += chSequentialStreamWrite(cfg->stream, blp->out, n);
+}
+
+/**
+ * @brief   Drain thread.
+ */
+static msg_t drain_thread(void *arg) {
+  BinLog *blp = (BinLog *)arg;
+  uint32_t start[2];
+  size_t n = 0;
+
+  chRegSetThreadName("binlog");
+
+  /* The start record carries the absolute timestamp.*/
+  start[0] = BINLOG_VERSION;
+  start[1] = BINLOG_TIMESTAMP_FREQUENCY;
+  blp->last_time = 0;
+  encode(blp, &n, BINLOG_ID_START, BINLOG_TIMESTAMP(), start, 2);
+  blp->stats.bytes += chSequentialStreamWrite(blp->config->stream,
+                                              blp->out, n);
+
+  while (!chThdShouldTerminate()) {
+    chBSemWaitTimeout(&blp->sem, blp->config->period);
+    chSysLock();
+    blp->wakeup = FALSE;
+    chSysUnlock();
+    drain(blp);
+  }
+  drain(blp);
+  return 0;
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Initializes a @p BinLog object.
+ *
+ * @param[out] blp      pointer to the @p BinLog object
+ *
+ * @init
+ */
+void blObjectInit(BinLog *blp) {
+
+  blp->state = BINLOG_STOP;
+  blp->config = NULL;
+  blp->level = BINLOG_LEVEL_MIN;
+  blp->thread = NULL;
+  chBSemInit(&blp->sem, TRUE);
+}
+
+/**
+ * @brief   Starts recording.
+ * @details The ring is emptied, the statistics cleared and the drain
+ *          thread is created.
+ *
+ * @param[in] blp       pointer to the @p BinLog object
+ * @param[in] config    pointer to the @p BinLogConfig object
+ *
+ * @api
+ */
+void blStart(BinLog *blp, const BinLogConfig *config) {
+  unsigned i;
+
+  chDbgCheck((blp != NULL) && (config != NULL) &&
+             (config->stream != NULL) && (config->buffer != NULL) &&
+             (config->size >= 2 * BINLOG_FRAME_MAX) &&
+             ((config->size & (config->size - 1)) == 0) &&
+             (config->reserve < config->size), "blStart");
+  chDbgAssert(blp->state == BINLOG_STOP,
+              "blStart(), #1", "invalid state");
+
+  blp->config = config;
+  blp->head = 0;
+  blp->tail = 0;
+  blp->wakeup = FALSE;
+  blp->stats.records = 0;
+  blp->stats.bytes = 0;
+  blp->stats.high_water = 0;
+  for (i = 0; i < BINLOG_LEVELS; i++) {
+    blp->stats.dropped[i] = 0;
+    blp->reported[i] = 0;
+  }
+  chBSemReset(&blp->sem, TRUE);
+  blp->state = BINLOG_READY;
+  blp->thread = chThdCreateStatic(blp->wa, sizeof blp->wa, config->prio,
+                                  drain_thread, blp);
+}
+
+/**
+ * @brief   Stops recording.
+ * @details The records already in the ring are written to the stream
+ *          before returning.
+ *
+ * @param[in] blp       pointer to the @p BinLog object
+ *
+ * @api
+ */
+void blStop(BinLog *blp) {
+
+  chDbgCheck(blp != NULL, "blStop");
+  chDbgAssert(blp->state == BINLOG_READY,
+              "blStop(), #1", "invalid state");
+
+  chSysLock();
+  blp->state = BINLOG_STOP;
+  chSysUnlock();
+  chThdTerminate(blp->thread);
+  chBSemSignal(&blp->sem);
+  chThdWait(blp->thread);
+  blp->thread = NULL;
+}
+
+/**
+ * @brief   Records a log point.
+ * @note    Use @p blLog() instead of calling this function directly.
+ *
+ * @param[in] blp       pointer to the @p BinLog object
+ * @param[in] point     pointer to the log point
+ * @param[in] args      pointer to the arguments
+ * @param[in] n         number of arguments
+ *
+ * @api
+ */
+void blWrite(BinLog *blp, const void *point,
+             const uint32_t *args, unsigned n) {
+  unsigned level = *(const uint8_t *)point;
+  uint32_t *rp;
+
+  chDbgCheck((blp != NULL) && (n <= BINLOG_MAX_ARGS), "blWrite");
+
+  if (level < blp->level)
+    return;
+
+  chSysLock();
+  rp = reserve_s(blp, level, n);
+  chSysUnlock();
+  if ((rp != NULL) && commit(blp, rp, point, args, n)) {
+    chSysLock();
+    chBSemSignalI(&blp->sem);
+    chSchRescheduleS();
+    chSysUnlock();
+  }
+}
+
+/**
+ * @brief   Records a log point from an interrupt handler.
+ * @note    Use @p blLogFromIsr() instead of calling this function
+ *          directly.
+ *
+ * @param[in] blp       pointer to the @p BinLog object
+ * @param[in] point     pointer to the log point
+ * @param[in] args      pointer to the arguments
+ * @param[in] n         number of arguments
+ *
+ * @iclass
+ */
+void blWriteFromIsr(BinLog *blp, const void *point,
+                    const uint32_t *args, unsigned n) {
+  unsigned level = *(const uint8_t *)point;
+  uint32_t *rp;
+
+  chDbgCheck((blp != NULL) && (n <= BINLOG_MAX_ARGS), "blWriteFromIsr");
+
+  if (level < blp->level)
+    return;
+
+  chSysLockFromIsr();
+  rp = reserve_s(blp, level, n);
+  chSysUnlockFromIsr();
+  if ((rp != NULL) && commit(blp, rp, point, args, n)) {
+    chSysLockFromIsr();
+    chBSemSignalI(&blp->sem);
+    chSysUnlockFromIsr();
+  }
+}
+
+/**
+ * @brief   Returns a snapshot of the statistics.
+ *
+ * @param[in] blp       pointer to the @p BinLog object
+ * @param[out] bsp      pointer to the @p BinLogStats structure
+ *
+ * @api
+ */
+void blGetStats(BinLog *blp, BinLogStats *bsp) {
+
+  chDbgCheck((blp != NULL) && (bsp != NULL), "blGetStats");
+
+  chSysLock();
+  *bsp = blp->stats;
+  chSysUnlock();
+}
+
+/** @} */
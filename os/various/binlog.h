@@ -0,0 +1,376 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    binlog.h
+ * @brief   Binary log header.
+ *
+ * @addtogroup binlog
+ * @{
+ */
+
+#ifndef _BINLOG_H_
+#define _BINLOG_H_
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Version of the wire format.
+ */
+#define BINLOG_VERSION                  1
+
+/**
+ * @name    Log levels
+ * @{
+ */
+#define BINLOG_LEVEL_DEBUG              0
+#define BINLOG_LEVEL_INFO               1
+#define BINLOG_LEVEL_WARNING            2
+#define BINLOG_LEVEL_ERROR              3
+#define BINLOG_LEVELS                   4
+/** @} */
+
+/**
+ * @name    Reserved record identifiers
+ * @{
+ */
+/**
+ * @brief   Stream start record, arguments are the format version and the
+ *          timestamp frequency.
+ */
+#define BINLOG_ID_START                 0
+/**
+ * @brief   Dropped records notice, arguments are the records dropped
+ *          for each level since the previous notice.
+ */
+#define BINLOG_ID_DROPPED               1
+/**
+ * @brief   First identifier assigned to the log points.
+ */
+#define BINLOG_ID_FIRST                 16
+/** @} */
+
+/**
+ * @brief   Name of the section containing the log points.
+ * @details The section is extracted from the executable at build time,
+ *          for example using
+ *          <tt>objcopy -O binary --only-section=blstrings</tt>, and it is
+ *          the string table used by the host tool for expanding the
+ *          records. On devices it can be placed in a non loaded region.
+ */
+#define BINLOG_SECTION                  "blstrings"
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Lowest level compiled in.
+ * @details Log points below this level generate no code.
+ */
+#if !defined(BINLOG_LEVEL_MIN) || defined(__DOXYGEN__)
+#define BINLOG_LEVEL_MIN                BINLOG_LEVEL_DEBUG
+#endif
+
+/**
+ * @brief   Maximum number of arguments of a log point.
+ */
+#if !defined(BINLOG_MAX_ARGS) || defined(__DOXYGEN__)
+#define BINLOG_MAX_ARGS                 8
+#endif
+
+/**
+ * @brief   Size of the transmit buffer of the drain thread.
+ * @details Encoded records are accumulated in this buffer and written
+ *          to the stream with a single call.
+ */
+#if !defined(BINLOG_OUT_SIZE) || defined(__DOXYGEN__)
+#define BINLOG_OUT_SIZE                 128
+#endif
+
+/**
+ * @brief   Stack size of the drain thread.
+ */
+#if !defined(BINLOG_THREAD_STACK_SIZE) || defined(__DOXYGEN__)
+#define BINLOG_THREAD_STACK_SIZE        256
+#endif
+
+/**
+ * @brief   Timestamp source.
+ * @details The default is the system time, a free running counter with
+ *          better resolution can be used instead.
+ */
+#if !defined(BINLOG_TIMESTAMP) || defined(__DOXYGEN__)
+#define BINLOG_TIMESTAMP()              ((uint32_t)chTimeNow())
+#endif
+
+/**
+ * @brief   Frequency of the timestamp source.
+ */
+#if !defined(BINLOG_TIMESTAMP_FREQUENCY) || defined(__DOXYGEN__)
+#define BINLOG_TIMESTAMP_FREQUENCY      CH_FREQUENCY
+#endif
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+#if !CH_USE_SEMAPHORES || !CH_USE_WAITEXIT
+#error "BINLOG requires CH_USE_SEMAPHORES and CH_USE_WAITEXIT"
+#endif
+
+#if (BINLOG_MAX_ARGS < 1) || (BINLOG_MAX_ARGS > 16)
+#error "invalid BINLOG_MAX_ARGS value"
+#endif
+
+/**
+ * @brief   Largest encoded frame, including the delimiter.
+ */
+#define BINLOG_FRAME_MAX                (3 + 5 + (5 * BINLOG_MAX_ARGS) + 2)
+
+#if BINLOG_OUT_SIZE < BINLOG_FRAME_MAX
+#error "BINLOG_OUT_SIZE too small for BINLOG_MAX_ARGS"
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Binary log state.
+ */
+typedef enum {
+  BINLOG_UNINIT = 0,                /**< Not initialized.                   */
+  BINLOG_STOP = 1,                  /**< Stopped.                           */
+  BINLOG_READY = 2                  /**< Recording and draining.            */
+} binlogstate_t;
+
+/**
+ * @brief   Binary log configuration structure.
+ */
+typedef struct {
+  /**
+   * @brief   Stream receiving the encoded records.
+   * @details Any stream can be used, a serial port, a USB CDC port using
+   *          @p serial_usb.c or a file.
+   */
+  BaseSequentialStream          *stream;
+  /**
+   * @brief   Pointer to the ring buffer.
+   * @note    Must be aligned to a 32 bits boundary.
+   */
+  uint32_t                      *buffer;
+  /**
+   * @brief   Size of the ring buffer in bytes.
+   * @note    Must be a power of two.
+   */
+  size_t                        size;
+  /**
+   * @brief   Space reserved to @p BINLOG_LEVEL_WARNING and above.
+   * @details Lower level records are dropped when the free space would
+   *          fall below this amount.
+   */
+  size_t                        reserve;
+  /**
+   * @brief   Drain period.
+   * @details The drain thread is also woken when the ring gets half full.
+   */
+  systime_t                     period;
+  /**
+   * @brief   Priority of the drain thread.
+   */
+  tprio_t                       prio;
+} BinLogConfig;
+
+/**
+ * @brief   Binary log statistics.
+ */
+typedef struct {
+  /**
+   * @brief   Records accepted in the ring.
+   */
+  uint32_t                      records;
+  /**
+   * @brief   Records dropped because the ring was full, for each level.
+   */
+  uint32_t                      dropped[BINLOG_LEVELS];
+  /**
+   * @brief   Bytes written to the stream.
+   */
+  uint32_t                      bytes;
+  /**
+   * @brief   Highest ring usage in bytes.
+   */
+  size_t                        high_water;
+} BinLogStats;
+
+/**
+ * @brief   Binary log object.
+ */
+typedef struct {
+  /**
+   * @brief   Log state.
+   */
+  binlogstate_t                 state;
+  /**
+   * @brief   Current configuration data.
+   */
+  const BinLogConfig            *config;
+  /**
+   * @brief   Lowest level recorded at runtime.
+   */
+  uint8_t                       level;
+  /**
+   * @brief   Drain thread wakeup already requested.
+   */
+  bool_t                        wakeup;
+  /**
+   * @brief   Reservation counter in bytes, free running.
+   */
+  volatile uint32_t             head;
+  /**
+   * @brief   Release counter in bytes, free running.
+   */
+  volatile uint32_t             tail;
+  /**
+   * @brief   Statistics.
+   */
+  BinLogStats                   stats;
+  /**
+   * @brief   Drops already reported to the stream.
+   */
+  uint32_t                      reported[BINLOG_LEVELS];
+  /**
+   * @brief   Timestamp of the last encoded record.
+   */
+  uint32_t                      last_time;
+  /**
+   * @brief   Drain thread wakeup semaphore.
+   */
+  BinarySemaphore               sem;
+  /**
+   * @brief   Drain thread.
+   */
+  Thread                        *thread;
+  /**
+   * @brief   Transmit buffer.
+   */
+  uint8_t                       out[BINLOG_OUT_SIZE];
+  /**
+   * @brief   Drain thread working area.
+   */
+  WORKING_AREA(wa, BINLOG_THREAD_STACK_SIZE);
+} BinLog;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/**
+ * @brief   Log point declaration.
+ * @details The level and the format string are placed in the
+ *          @p BINLOG_SECTION section, only the position of the log point
+ *          in the section is recorded at runtime.
+ *
+ * @notapi
+ */
+#define _binlog_point(level, fmt)                                           \
+  static const struct {                                                     \
+    uint8_t l;                                                              \
+    char f[sizeof (fmt)];                                                   \
+  } _blp __attribute__((section(BINLOG_SECTION), aligned(4))) = {(level), fmt}
+
+/**
+ * @brief   Records a log point.
+ * @details The arguments are not formatted, they are converted to 32 bits
+ *          words and copied in the ring together with the log point
+ *          identifier and a timestamp. The formatting happens on the host
+ *          using the string table extracted from the executable.
+ * @note    Only integer arguments are supported, the format string uses
+ *          the @p chprintf() syntax.
+ * @note    The record is dropped if the ring is full, the drop is
+ *          counted and reported in the stream later.
+ *
+ * @param[in] blp       pointer to the @p BinLog object
+ * @param[in] level     log level, must be a constant
+ * @param[in] fmt       format string, must be a string literal
+ * @param[in] ...       up to @p BINLOG_MAX_ARGS integer arguments
+ *
+ * @api
+ */
+#define blLog(blp, level, fmt, ...) do {                                    \
+  if ((level) >= BINLOG_LEVEL_MIN) {                                        \
+    _binlog_point(level, fmt);                                              \
+    const uint32_t _bla[] = {0, ##__VA_ARGS__};                             \
+    blWrite(blp, &_blp, &_bla[1],                                           \
+            sizeof (_bla) / sizeof (uint32_t) - 1);                         \
+  }                                                                         \
+} while (0)
+
+/**
+ * @brief   Records a log point from an interrupt handler.
+ * @details Same as @p blLog() but usable from ISR context.
+ *
+ * @param[in] blp       pointer to the @p BinLog object
+ * @param[in] level     log level, must be a constant
+ * @param[in] fmt       format string, must be a string literal
+ * @param[in] ...       up to @p BINLOG_MAX_ARGS integer arguments
+ *
+ * @iclass
+ */
+#define blLogFromIsr(blp, level, fmt, ...) do {                             \
+  if ((level) >= BINLOG_LEVEL_MIN) {                                        \
+    _binlog_point(level, fmt);                                              \
+    const uint32_t _bla[] = {0, ##__VA_ARGS__};                             \
+    blWriteFromIsr(blp, &_blp, &_bla[1],                                    \
+                   sizeof (_bla) / sizeof (uint32_t) - 1);                  \
+  }                                                                         \
+} while (0)
+
+/**
+ * @brief   Sets the lowest level recorded at runtime.
+ *
+ * @param[in] blp       pointer to the @p BinLog object
+ * @param[in] lvl       the new level
+ *
+ * @api
+ */
+#define blSetLevel(blp, lvl) ((blp)->level = (uint8_t)(lvl))
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void blObjectInit(BinLog *blp);
+  void blStart(BinLog *blp, const BinLogConfig *config);
+  void blStop(BinLog *blp);
+  void blWrite(BinLog *blp, const void *point,
+               const uint32_t *args, unsigned n);
+  void blWriteFromIsr(BinLog *blp, const void *point,
+                      const uint32_t *args, unsigned n);
+  void blGetStats(BinLog *blp, BinLogStats *bsp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _BINLOG_H_ */
+
+/** @} */
@@ -20,117 +20,295 @@
 /**
  * @file    chprintf.c
  * @brief   Mini printf-like functionality.
+ * @details The output is formatted into a chunk on the stack and written
+ *          to the stream in blocks, numbers are converted two decimal
+ *          digits at time using a lookup table.
  *
  * @addtogroup chprintf
  * @{
  */
 
+#include <float.h>
 #include <stdarg.h>
+#include <string.h>
 
 #include "ch.h"
 #include "chprintf.h"
 
-#define MAX_FILLER 11
-#define FLOAT_PRECISION 100000
-
-static char *long_to_string_with_divisor(char *p,
-                                         long num,
-                                         unsigned radix,
-                                         long divisor) {
-  int i;
-  char *q;
-  long l, ll;
-
-  l = num;
-  if (divisor == 0) {
-    ll = num;
-  } else {
-    ll = divisor;
+#define MAX_DIGITS 32
+#define FLOAT_PRECISION 5
+#define FIXED_PRECISION 4
+
+#if CHPRINTF_USE_LONG_LONG
+typedef unsigned long long fmtval_t;
+#else
+typedef unsigned long fmtval_t;
+#endif
+
+/**
+ * @brief   Formatted output state.
+ */
+typedef struct {
+  BaseSequentialStream  *chp;       /**< Target stream or @p NULL.      */
+  char                  *start;     /**< Start of the pending output.   */
+  char                  *p;         /**< Current output position.       */
+  char                  *end;       /**< End of the output chunk.       */
+  char                  *term;      /**< Memory output terminator.      */
+  int                   n;          /**< Characters already flushed.    */
+  char                  discard[8]; /**< Sink for the truncated output. */
+} fmtout_t;
+
+static const char dec_pairs[200] = {
+  "0001020304050607080910111213141516171819"
+  "2021222324252627282930313233343536373839"
+  "4041424344454647484950515253545556575859"
+  "6061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899"
+};
+
+static const char hex_digits[16] = {
+  '0', '1', '2', '3', '4', '5', '6', '7',
+  '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'
+};
+
+/*
+ * Powers of ten for the fractional digits.
+ */
+static const uint32_t powers10[10] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+/*
+ * Sends the pending output to the stream, in memory mode this is only
+ * invoked when the buffer is full and the rest of the output is counted
+ * but discarded.
+ */
+static void out_flush(fmtout_t *op) {
+  size_t n = (size_t)(op->p - op->start);
+
+  op->n += (int)n;
+  if (op->chp != NULL) {
+    if (n > 0)
+      chSequentialStreamWrite(op->chp, (const uint8_t *)op->start, n);
+  }
+  else {
+    op->start = op->discard;
+    op->end = op->discard + sizeof op->discard;
+  }
+  op->p = op->start;
+}
+
+static void out_put(fmtout_t *op, char c) {
+
+  if (op->p >= op->end)
+    out_flush(op);
+  *op->p++ = c;
+}
+
+static void out_write(fmtout_t *op, const char *s, size_t n) {
+  size_t k;
+
+  while (n > 0) {
+    if (op->p >= op->end)
+      out_flush(op);
+    k = (size_t)(op->end - op->p);
+    if (k > n)
+      k = n;
+    n -= k;
+    while (k-- > 0)
+      *op->p++ = *s++;
+  }
+}
+
+static void out_fill(fmtout_t *op, char c, int n) {
+
+  while (n-- > 0)
+    out_put(op, c);
+}
+
+/*
+ * Converts the number backward from q, two digits per division.
+ */
+static char *dec32(char *q, uint32_t v) {
+  const char *d;
+
+  while (v >= 100) {
+    d = &dec_pairs[(v % 100) * 2];
+    v /= 100;
+    *--q = d[1];
+    *--q = d[0];
+  }
+  if (v >= 10) {
+    d = &dec_pairs[v * 2];
+    *--q = d[1];
+    *--q = d[0];
+  }
+  else
+    *--q = (char)('0' + v);
+  return q;
+}
+
+/*
+ * Fixed width variant, the number is padded with zeros.
+ */
+static char *dec32_width(char *q, uint32_t v, int width) {
+  char *s = dec32(q, v);
+
+  while (s > q - width)
+    *--s = '0';
+  return s;
+}
+
+static char *ulltoa(char *q, fmtval_t v, unsigned radix) {
+
+  switch (radix) {
+  case 16:
+    do {
+      *--q = hex_digits[v & 15];
+      v >>= 4;
+    } while (v != 0);
+    return q;
+  case 8:
+    do {
+      *--q = (char)('0' + (v & 7));
+      v >>= 3;
+    } while (v != 0);
+    return q;
+  default:
+#if CHPRINTF_USE_LONG_LONG
+    /* Slices of nine digits, a single 64 bits division each.*/
+    while (v > 0xFFFFFFFFUL) {
+      q = dec32_width(q, (uint32_t)(v % 1000000000UL), 9);
+      v /= 1000000000UL;
+    }
+#endif
+    return dec32(q, (uint32_t)v);
   }
+}
 
-  q = p + MAX_FILLER;
-  do {
-    i = (int)(l % radix);
-    i += '0';
-    if (i > '9')
-      i += 'A' - '0' - 10;
-    *--q = i;
-    l /= radix;
-  } while ((ll /= radix) != 0);
-
-  i = (int)(p + MAX_FILLER - q);
-  do
-    *p++ = *q++;
-  while (--i);
-
-  return p;
+/*
+ * Appends the fractional digits, frac must be lower than 10^digits.
+ */
+static char *frac_digits(char *q, uint32_t frac, int digits) {
+
+  q = dec32_width(q, frac, digits);
+  *--q = '.';
+  return q;
 }
 
-static char *ltoa(char *p, long num, unsigned radix) {
+/*
+ * Fixed point conversion, the fraction is rounded to the nearest.
+ */
+static char *fixtoa(char *q, uint32_t v, int digits) {
+  uint32_t ip = v >> CHPRINTF_FIXED_BITS;
+  uint64_t frac = v & ((1UL << CHPRINTF_FIXED_BITS) - 1);
 
-  return long_to_string_with_divisor(p, num, radix, 0);
+  frac = (frac * powers10[digits] + (1UL << (CHPRINTF_FIXED_BITS - 1))) >>
+         CHPRINTF_FIXED_BITS;
+  if (frac >= powers10[digits]) {
+    frac -= powers10[digits];
+    ip++;
+  }
+  if (digits > 0)
+    q = frac_digits(q, (uint32_t)frac, digits);
+  return dec32(q, ip);
 }
 
 #if CHPRINTF_USE_FLOAT
-static char *ftoa(char *p, double num) {
-  long l;
-  unsigned long precision = FLOAT_PRECISION;
-
-  l = num;
-  p = long_to_string_with_divisor(p, l, 10, 0);
-  *p++ = '.';
-  l = (num - l) * precision;
-  return long_to_string_with_divisor(p, l, 10, precision / 10);
+/*
+ * Scaled conversion for the numbers not fitting a fmtval_t, the mantissa
+ * is normalized in the [1, 10) range and followed by the exponent.
+ */
+static char *etoa(char *q, double num, int digits) {
+  uint32_t ip, frac;
+  int e = 0;
+
+  while (num >= 1e8) {
+    num /= 1e8;
+    e += 8;
+  }
+  while (num >= 10.0) {
+    num /= 10.0;
+    e++;
+  }
+  ip = (uint32_t)num;
+  frac = (uint32_t)((num - (double)ip) * powers10[digits] + 0.5);
+  if (frac >= powers10[digits]) {
+    frac -= powers10[digits];
+    if (++ip >= 10) {
+      ip = 1;
+      e++;
+    }
+  }
+  q = dec32_width(q, (uint32_t)e, 2);
+  *--q = '+';
+  *--q = 'e';
+  if (digits > 0)
+    q = frac_digits(q, frac, digits);
+  return dec32(q, ip);
+}
+
+/*
+ * Float conversion, the fraction is rounded to the nearest.
+ */
+static char *ftoa(char *q, double num, int digits) {
+  fmtval_t ip;
+  uint32_t frac;
+
+  if (num != num) {
+    q -= 3;
+    memcpy(q, "nan", 3);
+    return q;
+  }
+  if (num > DBL_MAX) {
+    q -= 3;
+    memcpy(q, "inf", 3);
+    return q;
+  }
+  if (num >= (double)(fmtval_t)-1)
+    return etoa(q, num, digits);
+  ip = (fmtval_t)num;
+  frac = (uint32_t)((num - (double)ip) * powers10[digits] + 0.5);
+  if (frac >= powers10[digits]) {
+    frac -= powers10[digits];
+    ip++;
+  }
+  if (digits > 0)
+    q = frac_digits(q, frac, digits);
+  return ulltoa(q, ip, 10);
 }
 #endif
 
-/**
- * @brief   System formatted output function.
- * @details This function implements a minimal @p printf() like functionality
- *          with output on a @p BaseSequentialStream.
- *          The general parameters format is: %[-][width|*][.precision|*][l|L]p.
- *          The following parameter types (p) are supported:
- *          - <b>x</b> hexadecimal integer.
- *          - <b>X</b> hexadecimal long.
- *          - <b>o</b> octal integer.
- *          - <b>O</b> octal long.
- *          - <b>d</b> decimal signed integer.
- *          - <b>D</b> decimal signed long.
- *          - <b>u</b> decimal unsigned integer.
- *          - <b>U</b> decimal unsigned long.
- *          - <b>c</b> character.
- *          - <b>s</b> string.
- *          .
- *
- * @param[in] chp       pointer to a @p BaseSequentialStream implementing object
- * @param[in] fmt       formatting string
+/*
+ * Formatting engine.
  */
-void chprintf(BaseSequentialStream *chp, const char *fmt, ...) {
-  va_list ap;
-  char *p, *s, c, filler;
+static void format(fmtout_t *op, const char *fmt, va_list ap) {
+  const char *f;
+  char *s, *q, c, filler;
   int i, precision, width;
-  bool_t is_long, left_align;
-  long l;
+  bool_t is_long, left_align, negative;
+#if CHPRINTF_USE_LONG_LONG
+  bool_t is_long_long;
+#endif
+  fmtval_t v;
 #if CHPRINTF_USE_FLOAT
-  float f;
-  char tmpbuf[2*MAX_FILLER + 1];
-#else
-  char tmpbuf[MAX_FILLER + 1];
+  double d;
 #endif
+  char tmpbuf[MAX_DIGITS];
 
-  va_start(ap, fmt);
   while (TRUE) {
-    c = *fmt++;
-    if (c == 0) {
-      va_end(ap);
+    /* Literal text is copied in runs.*/
+    for (f = fmt; (*f != 0) && (*f != '%'); f++)
+      ;
+    if (f != fmt)
+      out_write(op, fmt, (size_t)(f - fmt));
+    if (*f == 0)
       return;
-    }
-    if (c != '%') {
-      chSequentialStreamPut(chp, (uint8_t)c);
-      continue;
-    }
-    p = tmpbuf;
-    s = tmpbuf;
+    fmt = f + 1;
+
+    q = tmpbuf + MAX_DIGITS;
+    s = q;
+    negative = FALSE;
     left_align = FALSE;
     if (*fmt == '-') {
       fmt++;
@@ -166,11 +344,20 @@ void chprintf(BaseSequentialStream *chp, const char *fmt, ...) {
         precision += c;
       }
     }
-    /* Long modifier.*/
+    /* Long and long long modifiers.*/
+#if CHPRINTF_USE_LONG_LONG
+    is_long_long = FALSE;
+#endif
     if (c == 'l' || c == 'L') {
       is_long = TRUE;
       if (*fmt)
         c = *fmt++;
+      if ((c == 'l') && *fmt) {
+#if CHPRINTF_USE_LONG_LONG
+        is_long_long = TRUE;
+#endif
+        c = *fmt++;
+      }
     }
     else
       is_long = (c >= 'A') && (c <= 'Z');
@@ -179,7 +366,7 @@ void chprintf(BaseSequentialStream *chp, const char *fmt, ...) {
     switch (c) {
     case 'c':
       filler = ' ';
-      *p++ = va_arg(ap, int);
+      *(s = --q) = (char)va_arg(ap, int);
       break;
     case 's':
       filler = ' ';
@@ -187,31 +374,47 @@ void chprintf(BaseSequentialStream *chp, const char *fmt, ...) {
         s = "(null)";
       if (precision == 0)
         precision = 32767;
-      for (p = s; *p && (--precision >= 0); p++)
+      for (q = s; *q && (--precision >= 0); q++)
         ;
-      break;
+      /* The string is output from s to q.*/
+      i = (int)(q - s);
+      goto output;
     case 'D':
     case 'd':
     case 'I':
     case 'i':
-      if (is_long)
-        l = va_arg(ap, long);
+#if CHPRINTF_USE_LONG_LONG
+      if (is_long_long) {
+        long long ll = va_arg(ap, long long);
+        negative = ll < 0;
+        v = negative ? (fmtval_t)-(ll + 1) + 1 : (fmtval_t)ll;
+      }
       else
-        l = va_arg(ap, int);
-      if (l < 0) {
-        *p++ = '-';
-        l = -l;
+#endif
+      {
+        long l = is_long ? va_arg(ap, long) : va_arg(ap, int);
+        negative = l < 0;
+        v = negative ? (unsigned long)-(l + 1) + 1 : (unsigned long)l;
+      }
+      q = ulltoa(q, v, 10);
+      break;
+    case 'K':
+    case 'k':
+      {
+        int32_t k = va_arg(ap, int32_t);
+        negative = k < 0;
+        q = fixtoa(q, negative ? (uint32_t)-(k + 1) + 1 : (uint32_t)k,
+                   (precision == 0) ? FIXED_PRECISION :
+                   (precision > 9) ? 9 : precision);
       }
-      p = ltoa(p, l, 10);
       break;
 #if CHPRINTF_USE_FLOAT
     case 'f':
-      f = (float) va_arg(ap, double);
-      if (f < 0) {
-        *p++ = '-';
-        f = -f;
-      }
-      p = ftoa(p, f);
+      d = va_arg(ap, double);
+      negative = d < 0;
+      q = ftoa(q, negative ? -d : d,
+               (precision == 0) ? FLOAT_PRECISION :
+               (precision > 9) ? 9 : precision);
       break;
 #endif
     case 'X':
@@ -226,38 +429,173 @@ void chprintf(BaseSequentialStream *chp, const char *fmt, ...) {
     case 'o':
       c = 8;
 unsigned_common:
+#if CHPRINTF_USE_LONG_LONG
+      if (is_long_long)
+        v = va_arg(ap, unsigned long long);
+      else
+#endif
       if (is_long)
-        l = va_arg(ap, unsigned long);
+        v = va_arg(ap, unsigned long);
       else
-        l = va_arg(ap, unsigned int);
-      p = ltoa(p, l, c);
+        v = va_arg(ap, unsigned int);
+      q = ulltoa(q, v, c);
       break;
     default:
-      *p++ = c;
+      *(s = --q) = c;
       break;
     }
-    i = (int)(p - s);
+    /* Numbers are built backward, from q to the end of the buffer.*/
+    if (negative)
+      *--q = '-';
+    i = (int)(tmpbuf + MAX_DIGITS - q);
+    s = q;
+
+output:
     if ((width -= i) < 0)
       width = 0;
-    if (left_align == FALSE)
-      width = -width;
-    if (width < 0) {
-      if (*s == '-' && filler == '0') {
-        chSequentialStreamPut(chp, (uint8_t)*s++);
+    if (left_align == FALSE) {
+      if (*s == '-' && filler == '0' && width > 0) {
+        out_put(op, *s++);
         i--;
       }
-      do
-        chSequentialStreamPut(chp, (uint8_t)filler);
-      while (++width != 0);
+      out_fill(op, filler, width);
+      width = 0;
     }
-    while (--i >= 0)
-      chSequentialStreamPut(chp, (uint8_t)*s++);
+    out_write(op, s, (size_t)i);
+    out_fill(op, filler, width);
+  }
+}
 
-    while (width) {
-      chSequentialStreamPut(chp, (uint8_t)filler);
-      width--;
-    }
+/**
+ * @brief   System formatted output function.
+ * @details This function implements a minimal @p vprintf() like
+ *          functionality with output on a @p BaseSequentialStream.
+ *          The general parameters format is:
+ *          %[-][width|*][.precision|*][l|L|ll]p.
+ *          The following parameter types (p) are supported:
+ *          - <b>x</b> hexadecimal integer.
+ *          - <b>X</b> hexadecimal long.
+ *          - <b>o</b> octal integer.
+ *          - <b>O</b> octal long.
+ *          - <b>d</b> decimal signed integer.
+ *          - <b>D</b> decimal signed long.
+ *          - <b>u</b> decimal unsigned integer.
+ *          - <b>U</b> decimal unsigned long.
+ *          - <b>k</b> fixed point @p int32_t with @p CHPRINTF_FIXED_BITS
+ *            fractional bits, the precision is the number of decimals.
+ *          - <b>f</b> floating point number, only if
+ *            @p CHPRINTF_USE_FLOAT is enabled, numbers too large for the
+ *            integer conversion are printed with an exponent.
+ *          - <b>c</b> character.
+ *          - <b>s</b> string.
+ *          .
+ *          The @p ll modifier selects 64 bits integers.
+ *
+ * @param[in] chp       pointer to a @p BaseSequentialStream implementing object
+ * @param[in] fmt       formatting string
+ * @param[in] ap        list of parameters
+ * @return              The number of characters sent to the stream.
+ *
+ * @api
+ */
+int chvprintf(BaseSequentialStream *chp, const char *fmt, va_list ap) {
+  char chunk[CHPRINTF_BUFFER_SIZE];
+  fmtout_t out;
+
+  out.chp = chp;
+  out.start = chunk;
+  out.p = chunk;
+  out.end = chunk + sizeof chunk;
+  out.n = 0;
+  format(&out, fmt, ap);
+  out_flush(&out);
+  return out.n;
+}
+
+/**
+ * @brief   System formatted output function.
+ * @details This function implements a minimal @p printf() like functionality
+ *          with output on a @p BaseSequentialStream.
+ * @see     chvprintf()
+ *
+ * @param[in] chp       pointer to a @p BaseSequentialStream implementing object
+ * @param[in] fmt       formatting string
+ * @return              The number of characters sent to the stream.
+ *
+ * @api
+ */
+int chprintf(BaseSequentialStream *chp, const char *fmt, ...) {
+  va_list ap;
+  int n;
+
+  va_start(ap, fmt);
+  n = chvprintf(chp, fmt, ap);
+  va_end(ap);
+  return n;
+}
+
+/**
+ * @brief   System formatted output to memory.
+ * @details The output is written directly into the buffer and it is always
+ *          terminated if @p size is greater than zero, the characters that
+ *          do not fit are discarded.
+ * @see     chvprintf()
+ *
+ * @param[out] str      pointer to the output buffer
+ * @param[in] size      size of the output buffer
+ * @param[in] fmt       formatting string
+ * @param[in] ap        list of parameters
+ * @return              The number of characters that would have been
+ *                      written with an unlimited buffer, the terminator
+ *                      excluded.
+ *
+ * @api
+ */
+int chvsnprintf(char *str, size_t size, const char *fmt, va_list ap) {
+  fmtout_t out;
+
+  out.chp = NULL;
+  out.n = 0;
+  if (size > 0) {
+    out.start = str;
+    out.end = str + size - 1;
+    out.term = out.end;
+  }
+  else {
+    out.start = out.discard;
+    out.end = out.discard + sizeof out.discard;
+    out.term = NULL;
   }
+  out.p = out.start;
+  format(&out, fmt, ap);
+  if (out.start != out.discard)
+    *out.p = 0;
+  else if (out.term != NULL)
+    *out.term = 0;
+  return out.n + (int)(out.p - out.start);
+}
+
+/**
+ * @brief   System formatted output to memory.
+ * @see     chvsnprintf()
+ *
+ * @param[out] str      pointer to the output buffer
+ * @param[in] size      size of the output buffer
+ * @param[in] fmt       formatting string
+ * @return              The number of characters that would have been
+ *                      written with an unlimited buffer, the terminator
+ *                      excluded.
+ *
+ * @api
+ */
+int chsnprintf(char *str, size_t size, const char *fmt, ...) {
+  va_list ap;
+  int n;
+
+  va_start(ap, fmt);
+  n = chvsnprintf(str, size, fmt, ap);
+  va_end(ap);
+  return n;
 }
 
 /** @} */
@@ -17,6 +17,10 @@
 /**
  * @file    chprintf.h
  * @brief   Mini printf-like functionality.
+ * @note    @p chprintf() returns the number of characters sent to the
+ *          stream, it was declared as returning @p void in previous
+ *          releases. Code declaring its own prototype or using a pointer
+ *          to the function must be updated.
  *
  * @addtogroup chprintf
  * @{
@@ -25,6 +29,8 @@
 #ifndef _CHPRINTF_H_
 #define _CHPRINTF_H_
 
+#include <stdarg.h>
+
 /**
  * @brief   Float type support.
  */
@@ -32,10 +38,50 @@
 #define CHPRINTF_USE_FLOAT          FALSE
 #endif
 
+/**
+ * @brief   Long long type support.
+ * @details Enables the @p ll modifier for 64 bits integers.
+ * @note    Enabling this option pulls the compiler 64 bits division helpers
+ *          on 32 bits targets.
+ */
+#if !defined(CHPRINTF_USE_LONG_LONG) || defined(__DOXYGEN__)
+#define CHPRINTF_USE_LONG_LONG      FALSE
+#endif
+
+/**
+ * @brief   Number of fractional bits of the fixed point type.
+ * @details The @p k specifier prints an @p int32_t holding a fixed point
+ *          number with this number of fractional bits.
+ */
+#if !defined(CHPRINTF_FIXED_BITS) || defined(__DOXYGEN__)
+#define CHPRINTF_FIXED_BITS         16
+#endif
+
+/**
+ * @brief   Size of the output chunk.
+ * @details The output is formatted into a chunk allocated on the stack and
+ *          sent to the stream with a single write operation when the chunk
+ *          is full and at the end of the string.
+ */
+#if !defined(CHPRINTF_BUFFER_SIZE) || defined(__DOXYGEN__)
+#define CHPRINTF_BUFFER_SIZE        32
+#endif
+
+#if (CHPRINTF_FIXED_BITS < 1) || (CHPRINTF_FIXED_BITS > 31)
+#error "invalid CHPRINTF_FIXED_BITS value"
+#endif
+
+#if CHPRINTF_BUFFER_SIZE < 1
+#error "invalid CHPRINTF_BUFFER_SIZE value"
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
-  void chprintf(BaseSequentialStream *chp, const char *fmt, ...);
+  int chvprintf(BaseSequentialStream *chp, const char *fmt, va_list ap);
+  int chprintf(BaseSequentialStream *chp, const char *fmt, ...);
+  int chvsnprintf(char *str, size_t size, const char *fmt, va_list ap);
+  int chsnprintf(char *str, size_t size, const char *fmt, ...);
 #ifdef __cplusplus
 }
 #endif
@@ -861,6 +861,67 @@ namespace chibios_rt {
     chPoolFreeI(&pool, objp);
   }
 #endif /* CH_USE_MEMPOOLS */
+
+#if CH_USE_ARENAS
+  /*------------------------------------------------------------------------*
+   * chibios_rt::Arena                                                      *
+   *------------------------------------------------------------------------*/
+#if CH_USE_HEAP
+  Arena::Arena(MemoryHeap *heapp, size_t size) {
+
+    chArenaInitHeap(&arena, heapp, size);
+  }
+#endif /* CH_USE_HEAP */
+
+#if CH_USE_MEMPOOLS
+  Arena::Arena(::MemoryPool *mp) {
+
+    chArenaInitPool(&arena, mp);
+  }
+#endif /* CH_USE_MEMPOOLS */
+
+#if CH_USE_MEMCORE
+  Arena::Arena(size_t size) {
+
+    chArenaInitCore(&arena, size);
+  }
+#endif /* CH_USE_MEMCORE */
+
+  Arena::~Arena(void) {
+
+    chArenaRelease(&arena);
+  }
+
+  void *Arena::alloc(size_t size) {
+
+    return chArenaAlloc(&arena, size);
+  }
+
+  void Arena::getMark(ArenaMark *mkp) {
+
+    chArenaGetMark(&arena, mkp);
+  }
+
+  void Arena::rewind(const ArenaMark *mkp) {
+
+    chArenaRewind(&arena, mkp);
+  }
+
+  void Arena::reset(void) {
+
+    chArenaReset(&arena);
+  }
+
+  void Arena::release(void) {
+
+    chArenaRelease(&arena);
+  }
+
+  ::Arena *Arena::setCurrent(void) {
+
+    return chArenaSetCurrent(&arena);
+  }
+#endif /* CH_USE_ARENAS */
 }
 
 /** @} */
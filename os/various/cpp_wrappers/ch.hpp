@@ -27,6 +27,10 @@
 #ifndef _CH_HPP_
 #define _CH_HPP_
 
+#if CH_USE_ARENAS || defined(__DOXYGEN__)
+#include <new>
+#endif
+
 /**
  * @brief   ChibiOS kernel-related classes and interfaces.
  */
@@ -2209,6 +2213,250 @@ namespace chibios_rt {
   };
 #endif /* CH_USE_MEMPOOLS */
 
+#if CH_USE_ARENAS || defined(__DOXYGEN__)
+  /*------------------------------------------------------------------------*
+   * chibios_rt::Arena                                                      *
+   *------------------------------------------------------------------------*/
+  /**
+   * @brief   Class encapsulating an arena.
+   * @details The chunks taken from a heap or a memory pool are returned to
+   *          the source when the object is destroyed.
+   */
+  class Arena {
+  public:
+    /**
+     * @brief   Embedded @p ::Arena structure.
+     */
+    ::Arena arena;
+
+#if CH_USE_HEAP || defined(__DOXYGEN__)
+    /**
+     * @brief   Arena constructor, the chunks are taken from a heap.
+     *
+     * @param[in] heapp     heap providing the chunks or @p NULL for the
+     *                      default heap
+     * @param[in] size      size of the chunks including their header
+     *
+     * @init
+     */
+    Arena(MemoryHeap *heapp, size_t size);
+#endif /* CH_USE_HEAP */
+
+#if CH_USE_MEMPOOLS || defined(__DOXYGEN__)
+    /**
+     * @brief   Arena constructor, the chunks are taken from a memory pool.
+     *
+     * @param[in] mp        pointer to the @p ::MemoryPool structure
+     *
+     * @init
+     */
+    Arena(::MemoryPool *mp);
+#endif /* CH_USE_MEMPOOLS */
+
+#if CH_USE_MEMCORE || defined(__DOXYGEN__)
+    /**
+     * @brief   Arena constructor, the chunks are taken from the memory core.
+     *
+     * @param[in] size      size of the chunks including their header
+     *
+     * @init
+     */
+    Arena(size_t size);
+#endif /* CH_USE_MEMCORE */
+
+    /**
+     * @brief   Arena destructor.
+     * @details The chunks are returned to the source if possible.
+     */
+    ~Arena(void);
+
+    /**
+     * @brief   Allocates a block from the arena.
+     * @details The allocated block is guaranteed to be properly aligned for a
+     *          pointer data type (@p stkalign_t).
+     *
+     * @param[in] size      the size of the block to be allocated
+     * @return              A pointer to the allocated block.
+     * @retval NULL         if the block cannot be allocated.
+     *
+     * @api
+     */
+    void *alloc(size_t size);
+
+    /**
+     * @brief   Saves the current position of the arena.
+     *
+     * @param[out] mkp      pointer to the @p ::ArenaMark structure
+     *
+     * @api
+     */
+    void getMark(ArenaMark *mkp);
+
+    /**
+     * @brief   Rewinds the arena to a saved position.
+     *
+     * @param[in] mkp       pointer to the @p ::ArenaMark structure
+     *
+     * @api
+     */
+    void rewind(const ArenaMark *mkp);
+
+    /**
+     * @brief   Frees all the blocks allocated from the arena.
+     * @details The chunks are retained and reused, the operation is
+     *          performed in constant time.
+     *
+     * @api
+     */
+    void reset(void);
+
+    /**
+     * @brief   Frees all the blocks and returns the chunks to the source.
+     *
+     * @api
+     */
+    void release(void);
+
+    /**
+     * @brief   Makes the arena the current arena of the invoking thread.
+     *
+     * @return              The previous current arena.
+     *
+     * @api
+     */
+    ::Arena *setCurrent(void);
+  };
+
+  /*------------------------------------------------------------------------*
+   * chibios_rt::ArenaAllocator                                             *
+   *------------------------------------------------------------------------*/
+  /**
+   * @brief   Standard allocator allocating from an arena.
+   * @details Allows the standard containers to place their elements in an
+   *          arena, the deallocation does nothing and the memory is freed
+   *          by resetting or rewinding the arena. A default constructed
+   *          allocator uses the current arena of the thread performing the
+   *          allocation.
+   * @note    The allocation failure throws @p std::bad_alloc when the
+   *          exceptions are enabled, else the system is halted using
+   *          @p chSysHalt(). A @p NULL pointer is never returned.
+   */
+  template<class T>
+  class ArenaAllocator {
+  public:
+    typedef T value_type;
+    typedef T *pointer;
+    typedef const T *const_pointer;
+    typedef T &reference;
+    typedef const T &const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    /**
+     * @brief   Allocator of another type on the same arena.
+     */
+    template<class U>
+    struct rebind {
+      typedef ArenaAllocator<U> other;
+    };
+
+    /**
+     * @brief   Pointer to the arena or @p NULL for the current arena.
+     */
+    ::Arena *arenap;
+
+    /**
+     * @brief   ArenaAllocator constructor using the current arena.
+     */
+    ArenaAllocator(void) : arenap(NULL) {
+    }
+
+    /**
+     * @brief   ArenaAllocator constructor.
+     *
+     * @param[in] ap        pointer to the @p ::Arena structure or @p NULL
+     *                      for the current arena
+     */
+    ArenaAllocator(::Arena *ap) : arenap(ap) {
+    }
+
+    /**
+     * @brief   ArenaAllocator constructor.
+     *
+     * @param[in] a         reference to the @p Arena object
+     */
+    ArenaAllocator(Arena &a) : arenap(&a.arena) {
+    }
+
+    /**
+     * @brief   Conversion from an allocator of another type.
+     */
+    template<class U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arenap(other.arenap) {
+    }
+
+    pointer address(reference x) const {
+
+      return &x;
+    }
+
+    const_pointer address(const_reference x) const {
+
+      return &x;
+    }
+
+    pointer allocate(size_type n, const void *hint = 0) {
+      void *p = NULL;
+
+      (void)hint;
+      /* The size is checked against overflow before the multiplication.*/
+      if (n <= max_size())
+        p = chArenaAlloc(arenap, n * sizeof (T));
+      if (p == NULL) {
+#if defined(__EXCEPTIONS) || defined(__cpp_exceptions)
+        throw std::bad_alloc();
+#else
+        chSysHalt();
+#endif
+      }
+      return static_cast<pointer>(p);
+    }
+
+    void deallocate(pointer p, size_type n) {
+
+      (void)p;
+      (void)n;
+    }
+
+    size_type max_size(void) const {
+
+      return (size_type)-1 / sizeof (T);
+    }
+
+    void construct(pointer p, const T &val) {
+
+      new((void *)p) T(val);
+    }
+
+    void destroy(pointer p) {
+
+      p->~T();
+    }
+  };
+
+  template<class T, class U>
+  bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+
+    return a.arenap == b.arenap;
+  }
+
+  template<class T, class U>
+  bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+
+    return a.arenap != b.arenap;
+  }
+#endif /* CH_USE_ARENAS */
+
   /*------------------------------------------------------------------------*
    * chibios_rt::BaseSequentialStreamInterface                              *
    *------------------------------------------------------------------------*/
@@ -0,0 +1,288 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    fatfs_stream.c
+ * @brief   FatFs streaming files code.
+ * @details Streaming files are meant for high rate data logging. The
+ *          whole cluster chain is allocated when the file is opened and
+ *          its layout is captured in a cluster link map, after that the
+ *          data sectors are written directly to the disk with large
+ *          multi-sector writes without going through the FatFs sector
+ *          cache and without touching the FAT. The directory entry is only
+ *          updated at checkpoints and when the file is closed, unused
+ *          clusters are released on close.
+ *
+ * @addtogroup fatfs_stream
+ * @{
+ */
+
+#include <string.h>
+
+#include "ch.h"
+#include "ff.h"
+#include "diskio.h"
+#include "fatfs_stream.h"
+
+#if _MAX_SS == 512
+#define SECTOR_SIZE(fs)     512U
+#else
+#define SECTOR_SIZE(fs)     ((fs)->ssize)
+#endif
+
+/*===========================================================================*/
+/* Local functions.                                                          */
+/*===========================================================================*/
+
+/*
+ * Translates a sector index inside the file into a disk sector, returns
+ * also the number of contiguous sectors available from there.
+ */
+static DWORD get_lba(FatFSStream *fsp, DWORD sector, DWORD *run) {
+  FATFS *fs = fsp->file.fs;
+  DWORD *tbl = &fsp->clmt[1];
+  DWORD cl = sector / fs->csize;
+
+  while (tbl[0] != 0) {
+    if (cl < tbl[0]) {
+      *run = (tbl[0] - cl) * fs->csize - sector % fs->csize;
+      return fs->database + (tbl[1] + cl - 2) * fs->csize +
+             sector % fs->csize;
+    }
+    cl -= tbl[0];
+    tbl += 2;
+  }
+  *run = 0;
+  return 0;
+}
+
+/*
+ * Writes a series of sectors, the transfer is split only at fragment
+ * boundaries or if it exceeds FATFS_STREAM_MAX_SECTORS.
+ */
+static bool_t write_sectors(FatFSStream *fsp, const BYTE *buf,
+                            DWORD sector, DWORD count) {
+  FATFS *fs = fsp->file.fs;
+  DWORD lba, run;
+  DRESULT res;
+
+  while (count > 0) {
+    lba = get_lba(fsp, sector, &run);
+    if (run == 0)
+      return TRUE;
+    if (run > count)
+      run = count;
+    if (run > FATFS_STREAM_MAX_SECTORS)
+      run = FATFS_STREAM_MAX_SECTORS;
+#if _FS_REENTRANT
+    if (!ff_req_grant(fs->sobj))
+      return TRUE;
+#endif
+    res = disk_write(fs->drv, buf, lba, (BYTE)run);
+#if _FS_REENTRANT
+    ff_rel_grant(fs->sobj);
+#endif
+    if (res != RES_OK)
+      return TRUE;
+    buf += run * SECTOR_SIZE(fs);
+    sector += run;
+    count -= run;
+  }
+  return FALSE;
+}
+
+/*===========================================================================*/
+/* Exported functions.                                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   Creates a streaming file.
+ * @details The file is created, or truncated if already existing, and
+ *          its cluster chain is allocated for the specified size rounded
+ *          up to the cluster size.
+ *
+ * @param[out] fsp      pointer to the @p FatFSStream object
+ * @param[in] path      file name
+ * @param[in] size      maximum file size in bytes
+ * @param[in] interval  number of bytes between automatic checkpoints or
+ *                      zero if checkpoints are performed only using
+ *                      @p fatfsStreamSync()
+ * @return              The FatFs result code.
+ * @retval FR_DENIED    if there is not enough free space.
+ * @retval FR_NOT_ENOUGH_CORE if the free space is fragmented in more than
+ *                      @p FATFS_STREAM_FRAGMENTS runs.
+ */
+FRESULT fatfsStreamOpen(FatFSStream *fsp, const TCHAR *path,
+                        DWORD size, DWORD interval) {
+  FIL *fp = &fsp->file;
+  DWORD bcs;
+  FRESULT res;
+
+  chDbgCheck((fsp != NULL) && (path != NULL) && (size > 0),
+             "fatfsStreamOpen");
+
+  res = f_open(fp, path, FA_CREATE_ALWAYS | FA_WRITE);
+  if (res != FR_OK)
+    return res;
+
+  /* Cluster chain allocation, seeking past the end of a file opened for
+     write stretches the chain.*/
+  bcs = (DWORD)fp->fs->csize * SECTOR_SIZE(fp->fs);
+  size = ((size + bcs - 1) / bcs) * bcs;
+  res = f_lseek(fp, size);
+  if ((res == FR_OK) && (f_tell(fp) != size))
+    res = FR_DENIED;
+
+  /* Capturing the chain layout.*/
+  if (res == FR_OK) {
+    fsp->clmt[0] = sizeof(fsp->clmt) / sizeof(fsp->clmt[0]);
+    fp->cltbl = fsp->clmt;
+    res = f_lseek(fp, CREATE_LINKMAP);
+    fp->cltbl = NULL;
+  }
+
+  /* The allocation is committed, the file is still empty.*/
+  if (res == FR_OK) {
+    fp->fsize = 0;
+    fp->flag |= FA__WRITTEN;
+    res = f_sync(fp);
+  }
+
+  if (res != FR_OK) {
+    (void)f_close(fp);
+    (void)f_unlink(path);
+    return res;
+  }
+
+  fsp->size            = size;
+  fsp->written         = 0;
+  fsp->interval        = interval;
+  fsp->next_checkpoint = interval;
+  return FR_OK;
+}
+
+/**
+ * @brief   Appends data to a streaming file.
+ * @details Whole sectors are written directly from the user buffer, a
+ *          partial sector is kept in the stream object until completed.
+ * @note    Buffers aligned and sized to whole sectors give the best
+ *          performance, the buffer must also satisfy the alignment
+ *          constraints of the disk driver DMA.
+ *
+ * @param[in] fsp       pointer to the @p FatFSStream object
+ * @param[in] buf       pointer to the data
+ * @param[in] n         number of bytes to write
+ * @return              The number of bytes actually written, less than
+ *                      @p n if the preallocated space is exhausted or in
+ *                      case of error.
+ */
+UINT fatfsStreamWrite(FatFSStream *fsp, const void *buf, UINT n) {
+  const BYTE *p = buf;
+  DWORD ss = SECTOR_SIZE(fsp->file.fs);
+  DWORD ofs, k;
+  UINT done = 0;
+
+  chDbgCheck((fsp != NULL) && (buf != NULL), "fatfsStreamWrite");
+
+  if (n > fsp->size - fsp->written)
+    n = fsp->size - fsp->written;
+
+  while (n > 0) {
+    ofs = fsp->written % ss;
+    if ((ofs > 0) || (n < ss)) {
+      /* Partial sector, going through the tail buffer.*/
+      k = ss - ofs < n ? ss - ofs : n;
+      memcpy(&fsp->tail[ofs], p, k);
+      if ((ofs + k == ss) &&
+          write_sectors(fsp, fsp->tail, fsp->written / ss, 1))
+        break;
+    }
+    else {
+      /* Whole sectors, straight from the user buffer.*/
+      k = n / ss;
+      if (write_sectors(fsp, p, fsp->written / ss, k))
+        break;
+      k *= ss;
+    }
+    p             += k;
+    n             -= k;
+    done          += k;
+    fsp->written  += k;
+
+    if ((fsp->interval > 0) && (fsp->written >= fsp->next_checkpoint)) {
+      if (fatfsStreamSync(fsp) != FR_OK)
+        break;
+    }
+  }
+  return done;
+}
+
+/**
+ * @brief   Performs a checkpoint.
+ * @details The pending partial sector is written and the directory entry
+ *          is updated with the current size, after a power loss the file
+ *          contains all the data written before the last checkpoint.
+ *
+ * @param[in] fsp       pointer to the @p FatFSStream object
+ * @return              The FatFs result code.
+ */
+FRESULT fatfsStreamSync(FatFSStream *fsp) {
+  DWORD ss = SECTOR_SIZE(fsp->file.fs);
+  DWORD ofs = fsp->written % ss;
+
+  chDbgCheck(fsp != NULL, "fatfsStreamSync");
+
+  if (ofs > 0) {
+    memset(&fsp->tail[ofs], 0, ss - ofs);
+    if (write_sectors(fsp, fsp->tail, fsp->written / ss, 1))
+      return FR_DISK_ERR;
+  }
+  if (fsp->interval > 0)
+    fsp->next_checkpoint = fsp->written + fsp->interval;
+  fsp->file.fsize = fsp->written;
+  fsp->file.flag |= FA__WRITTEN;
+  return f_sync(&fsp->file);
+}
+
+/**
+ * @brief   Closes a streaming file.
+ * @details A final checkpoint is performed then the clusters beyond the
+ *          written data are released.
+ *
+ * @param[in] fsp       pointer to the @p FatFSStream object
+ * @return              The FatFs result code.
+ */
+FRESULT fatfsStreamClose(FatFSStream *fsp) {
+  FIL *fp = &fsp->file;
+  FRESULT res;
+
+  chDbgCheck(fsp != NULL, "fatfsStreamClose");
+
+  res = fatfsStreamSync(fsp);
+  if (res == FR_OK) {
+    /* The whole chain is still allocated, truncating at the written size.*/
+    fp->fsize = fsp->size;
+    res = f_lseek(fp, fsp->written);
+  }
+  if (res == FR_OK)
+    res = f_truncate(fp);
+  if (res == FR_OK)
+    return f_close(fp);
+  (void)f_close(fp);
+  return res;
+}
+
+/** @} */
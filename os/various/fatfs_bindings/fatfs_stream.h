@@ -0,0 +1,118 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    fatfs_stream.h
+ * @brief   FatFs streaming files header.
+ *
+ * @addtogroup fatfs_stream
+ * @{
+ */
+
+#ifndef _FATFS_STREAM_H_
+#define _FATFS_STREAM_H_
+
+#include "ff.h"
+
+/*
+ * Module dependencies check.
+ */
+#if !_USE_FASTSEEK
+#error "FatFs streaming requires _USE_FASTSEEK"
+#endif
+
+#if _FS_READONLY
+#error "FatFs streaming requires a writable file system"
+#endif
+
+/**
+ * @brief   Maximum number of contiguous fragments in a streaming file.
+ * @details The preallocated cluster chain is split in this number of
+ *          contiguous runs at most, on a fresh volume one is enough.
+ */
+#if !defined(FATFS_STREAM_FRAGMENTS) || defined(__DOXYGEN__)
+#define FATFS_STREAM_FRAGMENTS          4
+#endif
+
+/**
+ * @brief   Maximum number of sectors in a single disk write.
+ * @note    FatFs limits the sectors count of @p disk_write() to 255.
+ */
+#if !defined(FATFS_STREAM_MAX_SECTORS) || defined(__DOXYGEN__)
+#define FATFS_STREAM_MAX_SECTORS        128
+#endif
+
+#if (FATFS_STREAM_MAX_SECTORS < 1) || (FATFS_STREAM_MAX_SECTORS > 255)
+#error "invalid FATFS_STREAM_MAX_SECTORS value"
+#endif
+
+/**
+ * @brief   Streaming file object.
+ */
+typedef struct {
+  /**
+   * @brief FatFs file object.
+   */
+  FIL           file;
+  /**
+   * @brief Cluster link map of the preallocated chain.
+   */
+  DWORD         clmt[2 * FATFS_STREAM_FRAGMENTS + 2];
+  /**
+   * @brief Preallocated size in bytes.
+   */
+  DWORD         size;
+  /**
+   * @brief Bytes written so far.
+   */
+  DWORD         written;
+  /**
+   * @brief Bytes between automatic checkpoints, zero if disabled.
+   */
+  DWORD         interval;
+  /**
+   * @brief Position of the next automatic checkpoint.
+   */
+  DWORD         next_checkpoint;
+  /**
+   * @brief Partially filled last sector.
+   */
+  BYTE          tail[_MAX_SS];
+} FatFSStream;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  FRESULT fatfsStreamOpen(FatFSStream *fsp, const TCHAR *path,
+                          DWORD size, DWORD interval);
+  UINT fatfsStreamWrite(FatFSStream *fsp, const void *buf, UINT n);
+  FRESULT fatfsStreamSync(FatFSStream *fsp);
+  FRESULT fatfsStreamClose(FatFSStream *fsp);
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * @brief   Returns the number of bytes written into the stream.
+ *
+ * @param[in] fsp       pointer to the @p FatFSStream object
+ * @return              The current stream size.
+ */
+#define fatfsStreamGetSize(fsp) ((fsp)->written)
+
+#endif /* _FATFS_STREAM_H_ */
+
+/** @} */
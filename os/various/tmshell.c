@@ -0,0 +1,147 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    tmshell.c
+ * @brief   Time Measurement profiling shell command code.
+ * @details The command prints the registered profiling points:
+ *          - <tt>tm</tt> lists the points having recorded intervals with
+ *            count, min, mean and max.
+ *          - <tt>tm reset</tt> resets all the points.
+ *          - <tt>tm name</tt> prints the histogram and the per-thread
+ *            attribution of the named point.
+ *          .
+ *          All the values are expressed in realtime counter ticks.
+ *
+ * @addtogroup tmshell
+ * @{
+ */
+
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "tmshell.h"
+
+/**
+ * @brief   Mean of a set of intervals.
+ */
+static uint32_t mean(uint64_t sum, uint32_t count) {
+
+  return count == 0 ? 0 : (uint32_t)(sum / count);
+}
+
+/**
+ * @brief   Prints the per-thread line of a point.
+ */
+static void print_thread(BaseSequentialStream *chp,
+                         const TimeProfileThread *ptp, const char *name) {
+
+  if (ptp->count == 0)
+    return;
+  if (name == NULL) {
+    if (ptp->thread == NULL)
+      name = "(isr)";
+#if CH_USE_REGISTRY
+    else
+      name = chRegGetThreadName(ptp->thread);
+#endif
+  }
+  if (name != NULL)
+    chprintf(chp, "%-16s ", name);
+  else
+    chprintf(chp, "%.8lx         ", (unsigned long)(uintptr_t)ptp->thread);
+  chprintf(chp, "%10lu %10lu\r\n",
+           (uint32_t)ptp->count, mean(ptp->sum, ptp->count));
+}
+
+/**
+ * @brief   Prints the details of a point.
+ */
+static void print_point(BaseSequentialStream *chp, TimeProfile *pp) {
+  TimeProfileStats stats;
+  unsigned i;
+
+  tmProfileGetStats(pp, &stats);
+  chprintf(chp, "%s\r\n", pp->name);
+  chprintf(chp, "           from         to      count\r\n");
+  for (i = 0; i < TM_PROFILE_BUCKETS; i++) {
+    if (stats.hist[i] == 0)
+      continue;
+    if (i == 0)
+      chprintf(chp, "%15lu %10lu", 0UL, 0UL);
+    else if (i < TM_PROFILE_BUCKETS - 1)
+      chprintf(chp, "%15lu %10lu", 1UL << (i - 1), (2UL << (i - 1)) - 1);
+    else
+      chprintf(chp, "%15lu        ...", 1UL << (i - 1));
+    chprintf(chp, " %10lu\r\n", stats.hist[i]);
+  }
+  chprintf(chp, "thread                count       mean\r\n");
+  for (i = 0; i < TM_PROFILE_THREADS; i++)
+    print_thread(chp, &stats.threads[i], NULL);
+  print_thread(chp, &stats.others, "(others)");
+}
+
+/**
+ * @brief   Time Measurement profiling shell command.
+ * @details The function has the @p shellcmd_t signature, it can be added
+ *          to a shell commands table.
+ *
+ * @param[in] chp       pointer to a @p BaseSequentialStream object
+ * @param[in] argc      number of arguments
+ * @param[in] argv      pointer to the arguments array
+ *
+ * @api
+ */
+void tmShellCmd(BaseSequentialStream *chp, int argc, char *argv[]) {
+  TimeProfileStats stats;
+  TimeProfile *pp;
+
+  if (argc > 1) {
+    chprintf(chp, "Usage: tm [reset|name]\r\n");
+    return;
+  }
+  if (argc == 1) {
+    if (strcmp(argv[0], "reset") == 0) {
+      tmProfileResetAll();
+      return;
+    }
+    for (pp = tmProfileFirst(); pp != NULL; pp = tmProfileNext(pp)) {
+      if (strcmp(argv[0], pp->name) == 0) {
+        print_point(chp, pp);
+        return;
+      }
+    }
+    chprintf(chp, "%s?\r\n", argv[0]);
+    return;
+  }
+  chprintf(chp, "frequency %lu Hz, calibration %lu ticks\r\n",
+           (uint32_t)halGetCounterFrequency(),
+           (uint32_t)tmProfileGetOffset());
+  chprintf(chp, "name                  count        min       mean"
+                "        max\r\n");
+  for (pp = tmProfileFirst(); pp != NULL; pp = tmProfileNext(pp)) {
+    tmProfileGetStats(pp, &stats);
+    if (stats.count == 0)
+      continue;
+    chprintf(chp, "%-16s %10lu %10lu %10lu %10lu\r\n", pp->name,
+             stats.count, (uint32_t)stats.min,
+             mean(stats.sum, stats.count), (uint32_t)stats.max);
+  }
+}
+
+/** @} */
@@ -0,0 +1,45 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    tmshell.h
+ * @brief   Time Measurement profiling shell command header.
+ *
+ * @addtogroup tmshell
+ * @{
+ */
+
+#ifndef _TMSHELL_H_
+#define _TMSHELL_H_
+
+/*
+ * Module dependencies check.
+ */
+#if !HAL_USE_TM || !TM_USE_PROFILING
+#error "tmshell requires HAL_USE_TM and TM_USE_PROFILING"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void tmShellCmd(BaseSequentialStream *chp, int argc, char *argv[]);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TMSHELL_H_ */
+
+/** @} */
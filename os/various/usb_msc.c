@@ -14,14 +14,23 @@
     limitations under the License.
 */
 
-/*-*
+/**
  * @file    usb_msc.c
  * @brief   USB Mass Storage Class code.
+ * @details Bulk Only Transport with a SCSI transparent command set. The
+ *          commands are executed by a worker thread, the endpoint callbacks
+ *          only move the buffers between the USB and the thread.
+ *          During READ(10) the thread reads the next buffer from the block
+ *          device while the USB sends the previous ones, during WRITE(10)
+ *          the USB receives the next buffers while the thread writes the
+ *          previous one.
  *
  * @addtogroup USB_MSC
  * @{
  */
 
+#include <string.h>
+
 #include "ch.h"
 #include "hal.h"
 
@@ -47,9 +56,9 @@ static const uint8_t scsi_inquiry_data[] = {
   0x00,             /* Direct Access Device.      */
   0x80,             /* RMB = 1: Removable Medium. */
   0x02,             /* ISO, ECMA, ANSI = 2.       */
-  0x00,             /* UFI response format.       */
+  0x02,             /* SPC-2 response format.     */
 
-  36 - 4,           /* Additional Length.         */
+  36 - 5,           /* Additional Length.         */
   0x00,
   0x00,
   0x00,
@@ -63,111 +72,689 @@ static const uint8_t scsi_inquiry_data[] = {
 };
 
 /**
- * @brief   Generic buffer.
+ * @brief   List of the started drivers.
  */
-uint8_t buf[16];
+static MSCDriver *msc_drivers;
 
 /*===========================================================================*/
-/* MMC interface code.                                                       */
+/* Driver local functions.                                                   */
 /*===========================================================================*/
 
-/*===========================================================================*/
-/* SCSI emulation code.                                                      */
-/*===========================================================================*/
+#define msc_buffer(mscp, i)                                                 \
+  ((mscp)->config->buffer + (i) * (mscp)->config->buffer_size)
+
+#define msc_chunk(mscp)                                                     \
+  ((mscp)->xfer < (mscp)->config->buffer_size ?                             \
+   (mscp)->xfer : (mscp)->config->buffer_size)
 
-static uint8_t scsi_read_format_capacities(uint32_t *nblocks,
-                                           uint32_t *secsize) {
+static uint32_t fetch32(const uint8_t *p) {
 
-  *nblocks = 1024;
-  *secsize = 512;
-  return 3; /* No Media.*/
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | (uint32_t)p[3];
 }
 
-/*===========================================================================*/
-/* Mass Storage Class related code.                                          */
-/*===========================================================================*/
+static void store32(uint8_t *p, uint32_t w) {
+
+  p[0] = (uint8_t)(w >> 24);
+  p[1] = (uint8_t)(w >> 16);
+  p[2] = (uint8_t)(w >> 8);
+  p[3] = (uint8_t)w;
+}
 
 /**
- * @brief   MSC state machine current state.
+ * @brief   Starts sending the next buffer owned by the USB side.
+ *
+ * @iclass
  */
-static mscstate_t msc_state;
+static void msc_start_in(MSCDriver *mscp) {
+  USBDriver *usbp = mscp->config->usbp;
+
+  usbPrepareTransmit(usbp, mscp->config->bulk_in,
+                     msc_buffer(mscp, mscp->usbidx), msc_chunk(mscp));
+  usbStartTransmitI(usbp, mscp->config->bulk_in);
+}
 
 /**
- * @brief   Received CBW.
+ * @brief   Starts receiving into the next buffer owned by the USB side.
+ *
+ * @iclass
  */
-static msccbw_t CBW;
+static void msc_start_out(MSCDriver *mscp) {
+  USBDriver *usbp = mscp->config->usbp;
+
+  usbPrepareReceive(usbp, mscp->config->bulk_out,
+                    msc_buffer(mscp, mscp->usbidx), msc_chunk(mscp));
+  usbStartReceiveI(usbp, mscp->config->bulk_out);
+}
+
+/**
+ * @brief   Prepares the driver for a new data phase.
+ * @return              The operation status.
+ * @retval FALSE        The transfers can be started.
+ * @retval TRUE         The driver has been reset or the USB is inactive.
+ *
+ * @sclass
+ */
+static bool_t msc_phase_s(MSCDriver *mscp, cnt_t n, size_t size) {
+
+  if (mscp->reset ||
+      (usbGetDriverStateI(mscp->config->usbp) != USB_ACTIVE))
+    return TRUE;
+  chSemResetI(&mscp->sem, n);
+  mscp->usbcnt = 0;
+  mscp->usbidx = 0;
+  mscp->xfer = size;
+  mscp->short_packet = FALSE;
+  return FALSE;
+}
+
+/**
+ * @brief   Transmits a linear buffer and waits for completion.
+ */
+static msg_t msc_transmit(MSCDriver *mscp, const uint8_t *p, size_t n) {
+  USBDriver *usbp = mscp->config->usbp;
+  msg_t msg;
+
+  chSysLock();
+  if (msc_phase_s(mscp, 0, n)) {
+    chSysUnlock();
+    return RDY_RESET;
+  }
+  usbPrepareTransmit(usbp, mscp->config->bulk_in, p, n);
+  usbStartTransmitI(usbp, mscp->config->bulk_in);
+  msg = chSemWaitS(&mscp->sem);
+  chSysUnlock();
+  return msg;
+}
+
+/**
+ * @brief   Receives into a linear buffer and waits for completion.
+ */
+static msg_t msc_receive(MSCDriver *mscp, uint8_t *p, size_t n) {
+  USBDriver *usbp = mscp->config->usbp;
+  msg_t msg;
+
+  chSysLock();
+  if (msc_phase_s(mscp, 0, n)) {
+    chSysUnlock();
+    return RDY_RESET;
+  }
+  usbPrepareReceive(usbp, mscp->config->bulk_out, p, n);
+  usbStartReceiveI(usbp, mscp->config->bulk_out);
+  msg = chSemWaitS(&mscp->sem);
+  chSysUnlock();
+  return msg;
+}
+
+static void msc_stall_in(MSCDriver *mscp) {
+
+  chSysLock();
+  usbStallTransmitI(mscp->config->usbp, mscp->config->bulk_in);
+  chSysUnlock();
+}
+
+static void msc_stall_out(MSCDriver *mscp) {
+
+  chSysLock();
+  usbStallReceiveI(mscp->config->usbp, mscp->config->bulk_out);
+  chSysUnlock();
+}
+
+/**
+ * @brief   Stalls the pipe the host expects data from, if any.
+ */
+static void msc_stall_host(MSCDriver *mscp) {
+
+  if (mscp->cbw.dCBWDataTransferLength > 0) {
+    if (mscp->cbw.bmCBWFlags & 0x80)
+      msc_stall_in(mscp);
+    else
+      msc_stall_out(mscp);
+  }
+}
+
+static void msc_sense(MSCDriver *mscp, uint8_t key, uint8_t asc) {
+
+  mscp->sense_key = key;
+  mscp->asc = asc;
+}
 
 /**
- * @brief   CSW to be transmitted.
+ * @brief   Terminates the command with an error and no data phase.
  */
-static msccsw_t CSW;
+static void msc_fail(MSCDriver *mscp, uint8_t key, uint8_t asc) {
+
+  msc_sense(mscp, key, asc);
+  mscp->csw.bCSWStatus = MSC_CSW_STATUS_FAILED;
+  msc_stall_host(mscp);
+}
 
 /**
- * @brief   MSC state machine initialization.
+ * @brief   Verifies the host expectations against the device intent.
+ * @details Cases 2, 3, 7, 8, 10 and 13 of the Bulk Only Transport
+ *          specification are phase errors, the host has to perform a
+ *          reset recovery.
  *
- * @param[in] usbp      pointer to the @p USBDriver object
+ * @param[in] mscp      pointer to the @p MSCDriver object
+ * @param[in] in        the device intends to send data
+ * @param[in] n         size of the data the device intends to transfer
+ * @return              The check result.
+ * @retval FALSE        The data phase can proceed.
+ * @retval TRUE         Phase error, the CSW has been prepared.
  */
-static void msc_reset(USBDriver *usbp) {
+static bool_t msc_phase_error(MSCDriver *mscp, bool_t in, size_t n) {
+  uint32_t h = mscp->cbw.dCBWDataTransferLength;
+
+  if ((n == 0) ||
+      ((h > 0) && (in == ((mscp->cbw.bmCBWFlags & 0x80) != 0)) && (h >= n)))
+    return FALSE;
+  mscp->csw.bCSWStatus = MSC_CSW_STATUS_PHASE_ERROR;
+  msc_stall_host(mscp);
+  return TRUE;
+}
 
-  msc_state = MSC_IDLE;
-  chSysLockFromIsr();
-  usbStartReceiveI(usbp, MSC_DATA_OUT_EP, (uint8_t *)&CBW, sizeof CBW);
-  chSysUnlockFromIsr();
+/**
+ * @brief   Terminates a data phase shorter than the host expectation.
+ * @details The pipe is stalled unless a short packet already ended the
+ *          transfer.
+ */
+static void msc_data_end(MSCDriver *mscp, size_t n) {
+  USBDriver *usbp = mscp->config->usbp;
+  size_t maxsize;
+
+  mscp->csw.dCSWDataResidue = mscp->cbw.dCBWDataTransferLength - n;
+  if (mscp->csw.dCSWDataResidue == 0)
+    return;
+  if (mscp->cbw.bmCBWFlags & 0x80) {
+    maxsize = usbp->epc[mscp->config->bulk_in]->in_maxsize;
+    if ((n == 0) || (n % maxsize == 0))
+      msc_stall_in(mscp);
+  }
+  else
+    msc_stall_out(mscp);
 }
 
-static void msc_transmit(USBDriver *usbp, const uint8_t *p, size_t n) {
+/**
+ * @brief   Sends a short response.
+ */
+static void msc_respond(MSCDriver *mscp, const uint8_t *p, size_t n) {
 
-  if (n > CBW.dCBWDataTransferLength)
-    n = CBW.dCBWDataTransferLength;
-  CSW.dCSWDataResidue = CBW.dCBWDataTransferLength - (uint32_t)n;
-  chSysLockFromIsr();
-  usbStartTransmitI(usbp, MSC_DATA_IN_EP, p, n);
-  chSysUnlockFromIsr();
+  if (msc_phase_error(mscp, TRUE, n))
+    return;
+  if (n > 0)
+    (void)msc_transmit(mscp, p, n);
+  msc_data_end(mscp, n);
 }
 
-static void msc_sendstatus(USBDriver *usbp) {
+/**
+ * @brief   Refreshes the medium information.
+ * @return              The medium status.
+ * @retval FALSE        Medium present and ready.
+ * @retval TRUE         Medium not available, the sense data has been set.
+ */
+static bool_t msc_medium_check(MSCDriver *mscp) {
+  BaseBlockDevice *bbdp = mscp->config->bbdp;
+  BlockDeviceInfo bdi;
 
-  msc_state = MSC_SENDING_CSW;
-  chSysLockFromIsr();
-  usbStartTransmitI(usbp, MSC_DATA_IN_EP, (uint8_t *)&CSW, sizeof CSW);
-  chSysUnlockFromIsr();
+  if (!blkIsInserted(bbdp) || (blkGetDriverState(bbdp) != BLK_READY) ||
+      blkGetInfo(bbdp, &bdi)) {
+    msc_sense(mscp, SCSI_SENSE_NOT_READY, SCSI_ASC_MEDIUM_NOT_PRESENT);
+    return TRUE;
+  }
+  chDbgAssert((mscp->config->buffer_size % bdi.blk_size) == 0,
+              "msc_medium_check(), #1", "invalid buffer size");
+  mscp->blk_size = bdi.blk_size;
+  mscp->blk_num  = bdi.blk_num;
+  return FALSE;
+}
+
+/**
+ * @brief   Decodes the range of a READ(10), WRITE(10) or VERIFY(10).
+ * @return              The check result.
+ * @retval FALSE        Range valid.
+ * @retval TRUE         Range invalid, the command has been failed.
+ */
+static bool_t msc_range(MSCDriver *mscp, uint32_t *lbap, uint32_t *np) {
+  const uint8_t *cb = mscp->cbw.CBWCB;
+
+  if (msc_medium_check(mscp)) {
+    msc_fail(mscp, mscp->sense_key, mscp->asc);
+    return TRUE;
+  }
+  *lbap = fetch32(&cb[2]);
+  *np   = ((uint32_t)cb[7] << 8) | (uint32_t)cb[8];
+  if ((*lbap > mscp->blk_num) || (*np > mscp->blk_num - *lbap)) {
+    msc_fail(mscp, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_LBA_OUT_OF_RANGE);
+    return TRUE;
+  }
+  return FALSE;
+}
+
+/**
+ * @brief   READ(10) with the block device reads overlapped to the USB.
+ */
+static void msc_read(MSCDriver *mscp) {
+  const MSCConfig *cfg = mscp->config;
+  uint32_t lba, n, k, per;
+  unsigned i, idx = 0;
+  bool_t failed = FALSE;
+  size_t size;
+
+  if (msc_range(mscp, &lba, &n))
+    return;
+  size = (size_t)n * mscp->blk_size;
+  if (msc_phase_error(mscp, TRUE, size))
+    return;
+
+  chSysLock();
+  if (msc_phase_s(mscp, (cnt_t)cfg->buffers_num, size)) {
+    chSysUnlock();
+    return;
+  }
+  chSysUnlock();
+
+  per = cfg->buffer_size / mscp->blk_size;
+  while (n > 0) {
+    k = n < per ? n : per;
+    /* Waits for a buffer to be released by the USB.*/
+    if (chSemWait(&mscp->sem) != RDY_OK)
+      return;
+    if (usbGetTransmitStatusI(cfg->usbp, cfg->bulk_in))
+      mscp->stats.overlaps++;
+    if (blkRead(cfg->bbdp, lba, msc_buffer(mscp, idx), k)) {
+      chSemSignal(&mscp->sem);
+      failed = TRUE;
+      break;
+    }
+    mscp->stats.read_blocks += k;
+    lba += k;
+    n -= k;
+
+    /* Queuing the buffer, the transmission is started immediately if the
+       endpoint is idle, otherwise the callback will chain it.*/
+    chSysLock();
+    if (mscp->reset) {
+      chSysUnlock();
+      return;
+    }
+    mscp->usbcnt++;
+    if (!usbGetTransmitStatusI(cfg->usbp, cfg->bulk_in))
+      msc_start_in(mscp);
+    chSysUnlock();
+    idx = (idx + 1) % cfg->buffers_num;
+  }
+
+  /* Waits for all the buffers to be sent.*/
+  for (i = 0; i < cfg->buffers_num; i++)
+    if (chSemWait(&mscp->sem) != RDY_OK)
+      return;
+
+  if (failed) {
+    msc_sense(mscp, SCSI_SENSE_MEDIUM_ERROR, SCSI_ASC_READ_ERROR);
+    mscp->csw.bCSWStatus = MSC_CSW_STATUS_FAILED;
+  }
+  msc_data_end(mscp, size - mscp->xfer);
 }
 
-static bool_t msc_decode(USBDriver *usbp) {
-  uint32_t nblocks, secsize;
+/**
+ * @brief   WRITE(10) with the USB receptions overlapped to the block
+ *          device writes.
+ * @note    After a write error the remaining data is received and
+ *          discarded, the error is reported in the CSW.
+ */
+static void msc_write(MSCDriver *mscp) {
+  const MSCConfig *cfg = mscp->config;
+  uint32_t lba, n, k, per, chunks;
+  unsigned idx = 0;
+  bool_t failed = FALSE;
+  size_t size;
+
+  if (msc_range(mscp, &lba, &n))
+    return;
+  if (blkIsWriteProtected(cfg->bbdp)) {
+    msc_fail(mscp, SCSI_SENSE_DATA_PROTECT, SCSI_ASC_WRITE_PROTECTED);
+    return;
+  }
+  size = (size_t)n * mscp->blk_size;
+  if (msc_phase_error(mscp, FALSE, size))
+    return;
+
+  /* All the buffers are given to the USB side.*/
+  per = cfg->buffer_size / mscp->blk_size;
+  chunks = (n + per - 1) / per;
+  chSysLock();
+  if (msc_phase_s(mscp, 0, size)) {
+    chSysUnlock();
+    return;
+  }
+  mscp->usbcnt = chunks < cfg->buffers_num ? chunks : cfg->buffers_num;
+  chunks -= mscp->usbcnt;
+  if (mscp->usbcnt > 0)
+    msc_start_out(mscp);
+  chSysUnlock();
+
+  while (n > 0) {
+    k = n < per ? n : per;
+    /* Waits for a buffer to be filled by the USB.*/
+    if ((chSemWait(&mscp->sem) != RDY_OK) || mscp->short_packet)
+      break;
+    if (usbGetReceiveStatusI(cfg->usbp, cfg->bulk_out))
+      mscp->stats.overlaps++;
+    if (!failed) {
+      if (blkWrite(cfg->bbdp, lba, msc_buffer(mscp, idx), k))
+        failed = TRUE;
+      else
+        mscp->stats.write_blocks += k;
+    }
+    lba += k;
+    n -= k;
+
+    /* The buffer goes back to the USB side if there is more data to
+       receive.*/
+    chSysLock();
+    if (chunks > 0) {
+      chunks--;
+      mscp->usbcnt++;
+      if (!usbGetReceiveStatusI(cfg->usbp, cfg->bulk_out))
+        msc_start_out(mscp);
+    }
+    chSysUnlock();
+    idx = (idx + 1) % cfg->buffers_num;
+  }
 
-  switch (CBW.CBWCB[0]) {
+  if (mscp->reset)
+    return;
+  if (mscp->short_packet) {
+    /* The host ended the transfer early.*/
+    mscp->csw.bCSWStatus = MSC_CSW_STATUS_PHASE_ERROR;
+    return;
+  }
+  if (failed) {
+    msc_sense(mscp, SCSI_SENSE_MEDIUM_ERROR, SCSI_ASC_WRITE_FAULT);
+    mscp->csw.bCSWStatus = MSC_CSW_STATUS_FAILED;
+  }
+  msc_data_end(mscp, size);
+}
+
+/**
+ * @brief   Executes the received SCSI command.
+ */
+static void msc_decode(MSCDriver *mscp) {
+  const uint8_t *cb = mscp->cbw.CBWCB;
+  uint8_t *rp = mscp->response;
+
+  switch (cb[0]) {
+  case SCSI_TEST_UNIT_READY:
+    if (msc_medium_check(mscp))
+      msc_fail(mscp, mscp->sense_key, mscp->asc);
+    else
+      msc_respond(mscp, NULL, 0);
+    return;
   case SCSI_REQUEST_SENSE:
-    break;
+    memset(rp, 0, 18);
+    rp[0]  = 0x70;                      /* Current errors.                  */
+    rp[2]  = mscp->sense_key;
+    rp[7]  = 18 - 8;                    /* Additional length.               */
+    rp[12] = mscp->asc;
+    msc_sense(mscp, SCSI_SENSE_NO_SENSE, SCSI_ASC_NONE);
+    msc_respond(mscp, rp, cb[4] < 18 ? cb[4] : 18);
+    return;
   case SCSI_INQUIRY:
-    msc_transmit(usbp, (uint8_t *)&scsi_inquiry_data,
-                 sizeof scsi_inquiry_data);
-    CSW.bCSWStatus = MSC_CSW_STATUS_PASSED;
-    break;
+    if (cb[1] & 0x01) {
+      /* Vital product data pages not supported.*/
+      msc_fail(mscp, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_FIELD);
+      return;
+    }
+    msc_respond(mscp, scsi_inquiry_data,
+                cb[4] < sizeof scsi_inquiry_data ? cb[4] :
+                                                   sizeof scsi_inquiry_data);
+    return;
+  case SCSI_MODE_SENSE6:
+    rp[0] = 3;                          /* Mode data length.                */
+    rp[1] = 0;                          /* Medium type.                     */
+    rp[2] = blkIsWriteProtected(mscp->config->bbdp) ? 0x80 : 0x00;
+    rp[3] = 0;                          /* Block descriptor length.         */
+    msc_respond(mscp, rp, cb[4] < 4 ? cb[4] : 4);
+    return;
   case SCSI_READ_FORMAT_CAPACITIES:
-    buf[8]  = scsi_read_format_capacities(&nblocks, &secsize);
-    buf[0]  = buf[1] = buf[2] = 0;
-    buf[3]  = 8;
-    buf[4]  = (uint8_t)(nblocks >> 24);
-    buf[5]  = (uint8_t)(nblocks >> 16);
-    buf[6]  = (uint8_t)(nblocks >> 8);
-    buf[7]  = (uint8_t)(nblocks >> 0);
-    buf[9]  = (uint8_t)(secsize >> 16);
-    buf[10] = (uint8_t)(secsize >> 8);
-    buf[11] = (uint8_t)(secsize >> 0);
-    msc_transmit(usbp, buf, 12);
-    CSW.bCSWStatus = MSC_CSW_STATUS_PASSED;
-    break;
+    memset(rp, 0, 12);
+    rp[3] = 8;                          /* Capacity list length.            */
+    if (msc_medium_check(mscp)) {
+      /* Maximum capacity, no media present.*/
+      store32(&rp[4], 0xFFFFFFFF);
+      store32(&rp[8], (3U << 24) | 512);
+    }
+    else {
+      /* Current capacity, formatted media.*/
+      store32(&rp[4], mscp->blk_num);
+      store32(&rp[8], (2U << 24) | mscp->blk_size);
+    }
+    msc_respond(mscp, rp, 12);
+    return;
+  case SCSI_READ_CAPACITY10:
+    if (msc_medium_check(mscp)) {
+      msc_fail(mscp, mscp->sense_key, mscp->asc);
+      return;
+    }
+    store32(&rp[0], mscp->blk_num - 1);
+    store32(&rp[4], mscp->blk_size);
+    msc_respond(mscp, rp, 8);
+    return;
+  case SCSI_READ10:
+    msc_read(mscp);
+    return;
+  case SCSI_WRITE10:
+    msc_write(mscp);
+    return;
+  case SCSI_SYNCHRONIZE_CACHE10:
+    if (msc_medium_check(mscp) || blkSync(mscp->config->bbdp)) {
+      msc_fail(mscp, SCSI_SENSE_NOT_READY, SCSI_ASC_MEDIUM_NOT_PRESENT);
+      return;
+    }
+    msc_respond(mscp, NULL, 0);
+    return;
+  case SCSI_VERIFY10:
+  case SCSI_START_STOP_UNIT:
+  case SCSI_ALLOW_MEDIUM_REMOVAL:
+    msc_respond(mscp, NULL, 0);
+    return;
   default:
-    return TRUE;
+    msc_fail(mscp, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_COMMAND);
+    return;
   }
-  return FALSE;
+}
+
+/**
+ * @brief   MSC worker thread.
+ */
+static msg_t msc_thread(void *arg) {
+  MSCDriver *mscp = arg;
+  USBDriver *usbp = mscp->config->usbp;
+
+  chRegSetThreadName("usb_msc");
+  while (!chThdShouldTerminate()) {
+    /* Waiting for the USB to be configured, a reset restarts from here.*/
+    chSysLock();
+    mscp->reset = FALSE;
+    if (usbGetDriverStateI(usbp) != USB_ACTIVE) {
+      mscp->state = MSC_STOP;
+      chSemResetI(&mscp->sem, 0);
+      (void)chSemWaitS(&mscp->sem);
+      chSysUnlock();
+      continue;
+    }
+    mscp->state = MSC_IDLE;
+    chSysUnlock();
+
+    if ((msc_receive(mscp, (uint8_t *)&mscp->cbw, sizeof mscp->cbw) !=
+         RDY_OK) || mscp->reset)
+      continue;
+
+    /* Invalid or not meaningful CBW, 6.6.1, both pipes are stalled until a
+       reset recovery.*/
+    if ((mscp->received != MSC_CBW_SIZE) ||
+        (mscp->cbw.dCBWSignature != MSC_CBW_SIGNATURE) ||
+        (mscp->cbw.bCBWLUN != 0) ||
+        (mscp->cbw.bCBWCBLength < 1) || (mscp->cbw.bCBWCBLength > 16)) {
+      chSysLock();
+      mscp->state = MSC_ERROR;
+      usbStallTransmitI(usbp, mscp->config->bulk_in);
+      usbStallReceiveI(usbp, mscp->config->bulk_out);
+      while (!mscp->reset)
+        (void)chSemWaitS(&mscp->sem);
+      chSysUnlock();
+      continue;
+    }
+
+    /* Command execution.*/
+    mscp->state = mscp->cbw.bmCBWFlags & 0x80 ? MSC_DATA_IN : MSC_DATA_OUT;
+    mscp->csw.dCSWSignature   = MSC_CSW_SIGNATURE;
+    mscp->csw.dCSWTag         = mscp->cbw.dCBWTag;
+    mscp->csw.dCSWDataResidue = mscp->cbw.dCBWDataTransferLength;
+    mscp->csw.bCSWStatus      = MSC_CSW_STATUS_PASSED;
+    msc_decode(mscp);
+    if (mscp->reset)
+      continue;
+    mscp->stats.commands++;
+    if (mscp->csw.bCSWStatus != MSC_CSW_STATUS_PASSED)
+      mscp->stats.failures++;
+
+    /* Status phase.*/
+    mscp->state = MSC_SENDING_CSW;
+    (void)msc_transmit(mscp, (uint8_t *)&mscp->csw, MSC_CSW_SIZE);
+  }
+  return 0;
+}
+
+/**
+ * @brief   Abandons the current command.
+ *
+ * @iclass
+ */
+static void msc_reset_i(MSCDriver *mscp) {
+
+  mscp->reset = TRUE;
+  mscp->usbcnt = 0;
+  chSemResetI(&mscp->sem, 0);
 }
 
 /*===========================================================================*/
 /* Driver exported functions.                                                */
 /*===========================================================================*/
 
+/**
+ * @brief   Initializes a MSC driver object.
+ *
+ * @param[out] mscp     pointer to the @p MSCDriver object
+ *
+ * @init
+ */
+void mscObjectInit(MSCDriver *mscp) {
+
+  mscp->state = MSC_STOP;
+  mscp->config = NULL;
+  mscp->next = NULL;
+  mscp->thread = NULL;
+  chSemInit(&mscp->sem, 0);
+  mscp->reset = FALSE;
+  msc_sense(mscp, SCSI_SENSE_NO_SENSE, SCSI_ASC_NONE);
+  memset(&mscp->stats, 0, sizeof(mscp->stats));
+}
+
+/**
+ * @brief   Configures and starts the driver.
+ * @details The worker thread is created, it waits for the USB device to be
+ *          configured.
+ *
+ * @param[in] mscp      pointer to the @p MSCDriver object
+ * @param[in] config    pointer to the @p MSCConfig object
+ *
+ * @api
+ */
+void mscStart(MSCDriver *mscp, const MSCConfig *config) {
+  USBDriver *usbp = config->usbp;
+
+  chDbgCheck((mscp != NULL) && (config != NULL) &&
+             (config->buffers_num > 0), "mscStart");
+  chDbgAssert(mscp->state == MSC_STOP, "mscStart(), #1", "invalid state");
+
+  chSysLock();
+  mscp->config = config;
+  usbp->in_params[config->bulk_in - 1]   = mscp;
+  usbp->out_params[config->bulk_out - 1] = mscp;
+  mscp->next = msc_drivers;
+  msc_drivers = mscp;
+  chSysUnlock();
+
+  mscp->thread = chThdCreateStatic(mscp->wa_thread, sizeof(mscp->wa_thread),
+                                   MSC_THREAD_PRIORITY, msc_thread, mscp);
+}
+
+/**
+ * @brief   Stops the driver.
+ * @details The worker thread is terminated.
+ *
+ * @param[in] mscp      pointer to the @p MSCDriver object
+ *
+ * @api
+ */
+void mscStop(MSCDriver *mscp) {
+  USBDriver *usbp = mscp->config->usbp;
+  MSCDriver **pp;
+
+  chDbgCheck(mscp != NULL, "mscStop");
+  chDbgAssert(mscp->thread != NULL, "mscStop(), #1", "not started");
+
+  chSysLock();
+  chThdTerminate(mscp->thread);
+  msc_reset_i(mscp);
+  chSchRescheduleS();
+  chSysUnlock();
+  chThdWait(mscp->thread);
+
+  chSysLock();
+  usbp->in_params[mscp->config->bulk_in - 1]   = NULL;
+  usbp->out_params[mscp->config->bulk_out - 1] = NULL;
+  for (pp = &msc_drivers; *pp != NULL; pp = &(*pp)->next) {
+    if (*pp == mscp) {
+      *pp = mscp->next;
+      break;
+    }
+  }
+  mscp->thread = NULL;
+  mscp->state = MSC_STOP;
+  chSysUnlock();
+}
+
+/**
+ * @brief   USB device configured handler.
+ * @details Any pending command is abandoned and the driver waits for a
+ *          new CBW.
+ *
+ * @param[in] mscp      pointer to the @p MSCDriver object
+ *
+ * @iclass
+ */
+void mscConfigureHookI(MSCDriver *mscp) {
+
+  msc_reset_i(mscp);
+}
+
+/**
+ * @brief   Returns the transfer statistics.
+ *
+ * @param[in] mscp      pointer to the @p MSCDriver object
+ * @param[out] stp      pointer to a @p MSCStats structure
+ *
+ * @api
+ */
+void mscGetStats(MSCDriver *mscp, MSCStats *stp) {
+
+  chSysLock();
+  *stp = mscp->stats;
+  chSysUnlock();
+}
+
 /**
  * @brief   Default requests hook.
  * @details The application must use this function as callback for the
@@ -183,6 +770,7 @@ static bool_t msc_decode(USBDriver *usbp) {
  * @retval FALSE        Message not handled.
  */
 bool_t mscRequestsHook(USBDriver *usbp) {
+  MSCDriver *mscp;
 
   if ((usbp->setup[0] & (USB_RTYPE_TYPE_MASK | USB_RTYPE_RECIPIENT_MASK)) ==
        (USB_RTYPE_TYPE_CLASS | USB_RTYPE_RECIPIENT_INTERFACE)) {
@@ -191,7 +779,11 @@ bool_t mscRequestsHook(USBDriver *usbp) {
       usbSetupTransfer(usbp, (uint8_t *)zerobuf, 1, NULL);
       return TRUE;
     case MSC_MASS_STORAGE_RESET_COMMAND:
-      msc_reset(usbp);
+      chSysLockFromIsr();
+      for (mscp = msc_drivers; mscp != NULL; mscp = mscp->next)
+        if (mscp->config->usbp == usbp)
+          msc_reset_i(mscp);
+      chSysUnlockFromIsr();
       usbSetupTransfer(usbp, NULL, 0, NULL);
       return TRUE;
     default:
@@ -210,25 +802,21 @@ bool_t mscRequestsHook(USBDriver *usbp) {
  * @param[in] ep        endpoint number
  */
 void mscDataTransmitted(USBDriver *usbp, usbep_t ep) {
+  MSCDriver *mscp = usbp->in_params[ep - 1];
 
-  switch (msc_state) {
-  case MSC_DATA_IN:
-    CSW.dCSWSignature = MSC_CSW_SIGNATURE;
-    CSW.dCSWTag = CBW.dCBWTag;
-    chSysLockFromIsr();
-    usbStartTransmitI(usbp, ep, (uint8_t *)&CSW, sizeof CSW);
-    chSysUnlockFromIsr();
-    msc_state = MSC_SENDING_CSW;
-    break;
-  case MSC_SENDING_CSW:
-    chSysLockFromIsr();
-    usbStartReceiveI(usbp, MSC_DATA_OUT_EP, (uint8_t *)&CBW, sizeof CBW);
-    chSysUnlockFromIsr();
-    msc_state = MSC_IDLE;
-    break;
-  default:
-    ;
+  if (mscp == NULL)
+    return;
+
+  chSysLockFromIsr();
+  if (mscp->usbcnt > 0) {
+    /* A buffer has been sent, the next one is chained immediately.*/
+    mscp->xfer  -= msc_chunk(mscp);
+    mscp->usbidx = (mscp->usbidx + 1) % mscp->config->buffers_num;
+    if (--mscp->usbcnt > 0)
+      msc_start_in(mscp);
   }
+  chSemSignalI(&mscp->sem);
+  chSysUnlockFromIsr();
 }
 
 /**
@@ -240,60 +828,31 @@ void mscDataTransmitted(USBDriver *usbp, usbep_t ep) {
  * @param[in] ep        endpoint number
  */
 void mscDataReceived(USBDriver *usbp, usbep_t ep) {
+  MSCDriver *mscp = usbp->out_params[ep - 1];
   size_t n;
 
-  n = usbGetReceiveTransactionSizeI(usbp, ep);
-  switch (msc_state) {
-  case MSC_IDLE:
-    if ((n != sizeof(msccbw_t)) || (CBW.dCBWSignature != MSC_CBW_SIGNATURE))
-      goto stall_out; /* 6.6.1 */
-
-    /* Decoding SCSI command.*/
-    if (msc_decode(usbp)) {
-      if (CBW.dCBWDataTransferLength == 0) {
-        CSW.bCSWStatus = MSC_CSW_STATUS_FAILED;
-        CSW.dCSWDataResidue = 0;
-        msc_sendstatus(usbp);
-        return;
-      }
-      goto stall_both;
-    }
-
-    /* Commands with zero transfer length, 5.1.*/
-    if (CBW.dCBWDataTransferLength == 0) {
-      msc_sendstatus(usbp);
-      return;
-    }
+  if (mscp == NULL)
+    return;
 
-    /* Transfer direction.*/
-    if (CBW.bmCBWFlags & 0x80) {
-      /* IN, Device to Host.*/
-      msc_state = MSC_DATA_IN;
+  chSysLockFromIsr();
+  n = usbGetReceiveTransactionSizeI(usbp, ep);
+  mscp->received = n;
+  if (mscp->usbcnt > 0) {
+    if (n < msc_chunk(mscp)) {
+      /* Short packet, the host terminated the data phase.*/
+      mscp->short_packet = TRUE;
+      mscp->usbcnt = 0;
     }
     else {
-      /* OUT, Host to Device.*/
-      msc_state = MSC_DATA_OUT;
+      /* A buffer has been filled, the next one is chained immediately.*/
+      mscp->xfer  -= n;
+      mscp->usbidx = (mscp->usbidx + 1) % mscp->config->buffers_num;
+      if (--mscp->usbcnt > 0)
+        msc_start_out(mscp);
     }
-    break;
-  case MSC_DATA_OUT:
-    break;
-  default:
-    ;
   }
-  return;
-stall_out:
-  msc_state = MSC_ERROR;
-  chSysLockFromIsr();
-  usbStallReceiveI(usbp, ep);
-  chSysUnlockFromIsr();
-  return;
-stall_both:
-  msc_state = MSC_ERROR;
-  chSysLockFromIsr();
-  usbStallTransmitI(usbp, ep);
-  usbStallReceiveI(usbp, ep);
+  chSemSignalI(&mscp->sem);
   chSysUnlockFromIsr();
-  return;
 }
 
 /** @} */
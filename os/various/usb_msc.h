@@ -14,7 +14,7 @@
     limitations under the License.
 */
 
-/*-*
+/**
  * @file    usb_msc.h
  * @brief   USB Mass Storage Class header.
  *
@@ -39,6 +39,15 @@
 #define MSC_CSW_STATUS_FAILED           1
 #define MSC_CSW_STATUS_PHASE_ERROR      2
 
+/**
+ * @brief   Size of a CBW on the wire.
+ */
+#define MSC_CBW_SIZE                    31
+
+/**
+ * @brief   Size of a CSW on the wire.
+ */
+#define MSC_CSW_SIZE                    13
 
 #define SCSI_FORMAT_UNIT            0x04
 #define SCSI_INQUIRY                0x12
@@ -69,29 +78,84 @@
 
 #define SCSI_SEND_DIAGNOSTIC        0x1D
 #define SCSI_READ_FORMAT_CAPACITIES 0x23
+#define SCSI_SYNCHRONIZE_CACHE10    0x35
+
+/**
+ * @name    SCSI sense keys
+ * @{
+ */
+#define SCSI_SENSE_NO_SENSE         0x00
+#define SCSI_SENSE_NOT_READY        0x02
+#define SCSI_SENSE_MEDIUM_ERROR     0x03
+#define SCSI_SENSE_ILLEGAL_REQUEST  0x05
+#define SCSI_SENSE_UNIT_ATTENTION   0x06
+#define SCSI_SENSE_DATA_PROTECT     0x07
+/** @} */
+
+/**
+ * @name    SCSI additional sense codes
+ * @{
+ */
+#define SCSI_ASC_NONE               0x00
+#define SCSI_ASC_WRITE_FAULT        0x03
+#define SCSI_ASC_READ_ERROR         0x11
+#define SCSI_ASC_INVALID_COMMAND    0x20
+#define SCSI_ASC_LBA_OUT_OF_RANGE   0x21
+#define SCSI_ASC_INVALID_FIELD      0x24
+#define SCSI_ASC_WRITE_PROTECTED    0x27
+#define SCSI_ASC_MEDIUM_CHANGED     0x28
+#define SCSI_ASC_MEDIUM_NOT_PRESENT 0x3A
+/** @} */
 
 /*===========================================================================*/
 /* Driver pre-compile time settings.                                         */
 /*===========================================================================*/
 
+/**
+ * @name    MSC configuration options
+ * @{
+ */
 /**
  * @brief   Endpoint number for bulk IN.
+ * @note    Only used by the descriptors of the demos, the driver takes the
+ *          endpoints from its configuration structure.
  */
 #if !defined(MSC_DATA_IN_EP) || defined(__DOXYGEN__)
-#define MSC_DATA_IN_EP          1
+#define MSC_DATA_IN_EP              1
 #endif
 
 /**
  * @brief   Endpoint number for bulk OUT.
+ * @note    Only used by the descriptors of the demos, the driver takes the
+ *          endpoints from its configuration structure.
  */
 #if !defined(MSC_DATA_OUT_EP) || defined(__DOXYGEN__)
-#define MSC_DATA_OUT_EP         2
+#define MSC_DATA_OUT_EP             2
 #endif
 
+/**
+ * @brief   Stack size of the MSC worker thread.
+ */
+#if !defined(MSC_THREAD_STACK_SIZE) || defined(__DOXYGEN__)
+#define MSC_THREAD_STACK_SIZE       512
+#endif
+
+/**
+ * @brief   Priority of the MSC worker thread.
+ */
+#if !defined(MSC_THREAD_PRIORITY) || defined(__DOXYGEN__)
+#define MSC_THREAD_PRIORITY         (NORMALPRIO + 1)
+#endif
+/** @} */
+
 /*===========================================================================*/
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
 
+#if !HAL_USE_USB || !CH_USE_SEMAPHORES || !CH_USE_WAITEXIT
+#error "USB MSC requires HAL_USE_USB, CH_USE_SEMAPHORES, CH_USE_WAITEXIT"
+#endif
+
 /*===========================================================================*/
 /* Driver data structures and types.                                         */
 /*===========================================================================*/
@@ -100,15 +164,17 @@
  * @brief   Type of the MSC possible states.
  */
 typedef enum {
-  MSC_IDLE = 0,
-  MSC_DATA_OUT,
-  MSC_DATA_IN,
-  MSC_SENDING_CSW,
-  MSC_ERROR
+  MSC_STOP = 0,                     /**< Stopped or not configured.         */
+  MSC_IDLE,                         /**< Waiting for a CBW.                 */
+  MSC_DATA_OUT,                     /**< Receiving data from the host.      */
+  MSC_DATA_IN,                      /**< Sending data to the host.          */
+  MSC_SENDING_CSW,                  /**< Sending the CSW.                   */
+  MSC_ERROR                         /**< Invalid CBW, waiting for a reset.  */
 } mscstate_t;
 
 /**
  * @brief   CBW structure.
+ * @note    Only the first @p MSC_CBW_SIZE bytes are transferred.
  */
 struct CBW {
   uint32_t          dCBWSignature;
@@ -122,6 +188,7 @@ struct CBW {
 
 /**
  * @brief   CSW structure.
+ * @note    Only the first @p MSC_CSW_SIZE bytes are transferred.
  */
 struct CSW {
   uint32_t          dCSWSignature;
@@ -140,6 +207,145 @@ typedef struct CBW msccbw_t;
  */
 typedef struct CSW msccsw_t;
 
+/**
+ * @brief   MSC driver configuration structure.
+ * @details The buffers area is split in @p buffers_num buffers, during
+ *          READ(10) and WRITE(10) commands the block device operates on
+ *          one buffer while the USB transfers the others. With a single
+ *          buffer the driver works in lock step.
+ */
+typedef struct {
+  /**
+   * @brief   USB driver to use.
+   */
+  USBDriver                 *usbp;
+  /**
+   * @brief   Block device exported to the host.
+   */
+  BaseBlockDevice           *bbdp;
+  /**
+   * @brief   Bulk IN endpoint.
+   */
+  usbep_t                   bulk_in;
+  /**
+   * @brief   Bulk OUT endpoint.
+   */
+  usbep_t                   bulk_out;
+  /**
+   * @brief   Pointer to the buffers area.
+   */
+  uint8_t                   *buffer;
+  /**
+   * @brief   Size of each buffer.
+   * @note    Must be a multiple of the block size and of the endpoints
+   *          maximum packet size.
+   */
+  size_t                    buffer_size;
+  /**
+   * @brief   Number of buffers, at least one.
+   */
+  unsigned                  buffers_num;
+} MSCConfig;
+
+/**
+ * @brief   MSC transfer statistics.
+ */
+typedef struct {
+  uint32_t                  commands;       /**< @brief Executed CBWs.      */
+  uint32_t                  failures;       /**< @brief Failed commands.    */
+  uint64_t                  read_blocks;    /**< @brief Blocks sent.        */
+  uint64_t                  write_blocks;   /**< @brief Blocks received.    */
+  uint32_t                  overlaps;       /**< @brief Block operations
+                                                 started while the USB was
+                                                 still transferring.        */
+} MSCStats;
+
+/**
+ * @brief   Structure representing a MSC driver.
+ */
+typedef struct MSCDriver {
+  /**
+   * @brief   Driver state.
+   */
+  mscstate_t                state;
+  /**
+   * @brief   Current configuration data.
+   */
+  const MSCConfig           *config;
+  /**
+   * @brief   Next started driver, drivers are linked for the requests hook.
+   */
+  struct MSCDriver          *next;
+  /**
+   * @brief   Worker thread.
+   */
+  Thread                    *thread;
+  /**
+   * @brief   Transfers completion semaphore.
+   */
+  Semaphore                 sem;
+  /**
+   * @brief   Set by a reset, pending operations are abandoned.
+   */
+  bool_t                    reset;
+  /**
+   * @brief   The host sent an unexpected short packet.
+   */
+  bool_t                    short_packet;
+  /**
+   * @brief   Block size of the device.
+   */
+  uint32_t                  blk_size;
+  /**
+   * @brief   Number of blocks of the device.
+   */
+  uint32_t                  blk_num;
+  /**
+   * @brief   Bytes still to be transferred in the current data phase.
+   */
+  size_t                    xfer;
+  /**
+   * @brief   Buffers currently owned by the USB side.
+   */
+  unsigned                  usbcnt;
+  /**
+   * @brief   Next buffer to be transferred by the USB side.
+   */
+  unsigned                  usbidx;
+  /**
+   * @brief   Size of the last completed receive transfer.
+   */
+  size_t                    received;
+  /**
+   * @brief   Current sense key.
+   */
+  uint8_t                   sense_key;
+  /**
+   * @brief   Current additional sense code.
+   */
+  uint8_t                   asc;
+  /**
+   * @brief   Received CBW.
+   */
+  msccbw_t                  cbw;
+  /**
+   * @brief   CSW to be transmitted.
+   */
+  msccsw_t                  csw;
+  /**
+   * @brief   Buffer for short commands responses.
+   */
+  uint8_t                   response[36];
+  /**
+   * @brief   Transfer statistics.
+   */
+  MSCStats                  stats;
+  /**
+   * @brief   Worker thread working area.
+   */
+  WORKING_AREA(wa_thread, MSC_THREAD_STACK_SIZE);
+} MSCDriver;
+
 /*===========================================================================*/
 /* Driver macros.                                                            */
 /*===========================================================================*/
@@ -151,6 +357,11 @@ typedef struct CSW msccsw_t;
 #ifdef __cplusplus
 extern "C" {
 #endif
+  void mscObjectInit(MSCDriver *mscp);
+  void mscStart(MSCDriver *mscp, const MSCConfig *config);
+  void mscStop(MSCDriver *mscp);
+  void mscConfigureHookI(MSCDriver *mscp);
+  void mscGetStats(MSCDriver *mscp, MSCStats *stp);
   bool_t mscRequestsHook(USBDriver *usbp);
   void mscDataTransmitted(USBDriver *usbp, usbep_t ep);
   void mscDataReceived(USBDriver *usbp, usbep_t ep);
@@ -0,0 +1,367 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    bench.c
+ * @brief   Benchmarks framework code.
+ * @details Each benchmark is executed for a number of repetitions after a
+ *          warmup, the scores of the repetitions are reported as minimum,
+ *          median and maximum. A further repetition, not scored, measures
+ *          the duration of each iteration using the HAL realtime counter,
+ *          the durations are accumulated in an histogram and the per
+ *          operation latency is reported as minimum, median, 99th
+ *          percentile and maximum, the maximum is omitted when
+ *          @p BENCH_REPORT_LAT_MAX is disabled. The scored repetitions
+ *          are not instrumented.<br>
+ *          The results are also printed as machine readable records,
+ *          prefixed by @p BENCH_RECORD_PREFIX, the host script under
+ *          <tt>./tools/bmkcompare</tt> compares the records of two runs.
+ *
+ * @addtogroup test
+ * @{
+ */
+
+#include "ch.h"
+#include "hal.h"
+
+#include "test.h"
+#include "bench.h"
+
+#if BENCH_USE_LATENCY || defined(__DOXYGEN__)
+/*
+ * Histogram buckets, four linear sub-buckets for each power of two, the
+ * bucket width is within 25% of its values.
+ */
+#define HIST_SIZE               124
+
+static uint32_t hist[HIST_SIZE];
+static uint32_t samples;
+static uint32_t lat_min, lat_max;
+static halrtcnt_t last;
+
+/*
+ * Latency pass state, the pass has its own window timer because
+ * test_timer_done is kept set. The iterations are timed by the thread
+ * that started the repetition, the histogram is not shared with the other
+ * threads of the benchmark.
+ */
+static bool_t sampling;
+static Thread *sampler;
+static volatile bool_t window_over;
+static VirtualTimer vt;
+
+static void tmr(void *p) {
+  (void)p;
+
+  window_over = TRUE;
+}
+
+static unsigned hist_index(uint32_t d) {
+  unsigned e;
+
+  if (d < 4)
+    return d;
+#if defined(__GNUC__)
+  e = 31 - __builtin_clz(d);
+#else
+  e = 2;
+  while (d >> (e + 1))
+    e++;
+#endif
+  return ((e - 1) << 2) + ((d >> (e - 2)) & 3);
+}
+
+static uint32_t hist_bound(unsigned i) {
+  unsigned e;
+
+  if (i < 4)
+    return i;
+  e = (i >> 2) + 1;
+  return ((4 + (i & 3)) << (e - 2)) + ((1U << (e - 2)) - 1);
+}
+
+static void hist_reset(void) {
+  unsigned i;
+
+  for (i = 0; i < HIST_SIZE; i++)
+    hist[i] = 0;
+  samples = 0;
+  lat_min = 0xFFFFFFFF;
+  lat_max = 0;
+}
+
+/*
+ * Returns the upper bound of the bucket containing the specified
+ * percentile, clamped to the measured range.
+ */
+static uint32_t hist_percentile(unsigned pc) {
+  uint32_t target, acc = 0;
+  unsigned i;
+
+  target = (uint32_t)(((uint64_t)samples * pc + 99) / 100);
+  for (i = 0; i < HIST_SIZE; i++) {
+    acc += hist[i];
+    if (acc >= target)
+      break;
+  }
+  if (hist_bound(i) > lat_max)
+    return lat_max;
+  if (hist_bound(i) < lat_min)
+    return lat_min;
+  return hist_bound(i);
+}
+
+/*
+ * Converts an iteration duration in counter ticks to nanoseconds for each
+ * operation.
+ */
+static uint32_t to_ns(uint32_t ticks, uint32_t ops) {
+
+  return (uint32_t)(((uint64_t)ticks * 1000000000U) /
+                    ((uint64_t)halGetCounterFrequency() * ops));
+}
+#endif /* BENCH_USE_LATENCY */
+
+#if BENCH_FORMAT == BENCH_FORMAT_CSV
+static bool_t csv_header;
+#endif
+
+static void print_field(const char *key, uint32_t value) {
+
+#if BENCH_FORMAT == BENCH_FORMAT_JSON
+  test_print(",\"");
+  test_print(key);
+  test_print("\":");
+  test_printn(value);
+#elif BENCH_FORMAT == BENCH_FORMAT_CSV
+  (void)key;
+  test_print(",");
+  test_printn(value);
+#else
+  (void)key;
+  (void)value;
+#endif
+}
+
+/*
+ * Machine readable record, the latency fields are omitted if there are no
+ * samples.
+ */
+static void print_record(const char *name, const char *unit, uint32_t runs,
+                         uint32_t min, uint32_t median, uint32_t max,
+                         const uint32_t *lat) {
+
+#if BENCH_FORMAT == BENCH_FORMAT_JSON
+  test_print(BENCH_RECORD_PREFIX " {\"name\":\"");
+  test_print(name);
+  test_print("\",\"unit\":\"");
+  test_print(unit);
+  test_print("\"");
+#elif BENCH_FORMAT == BENCH_FORMAT_CSV
+  if (!csv_header) {
+    test_println(BENCH_RECORD_PREFIX ",name,unit,runs,min,median,max,"
+                 "lat_min,lat_p50,lat_p99,lat_max");
+    csv_header = TRUE;
+  }
+  test_print(BENCH_RECORD_PREFIX ",");
+  test_print(name);
+  test_print(",");
+  test_print(unit);
+#else
+  (void)name;
+  (void)unit;
+  (void)lat;
+  return;
+#endif
+  print_field("runs", runs);
+  print_field("min", min);
+  print_field("median", median);
+  print_field("max", max);
+  if (lat != NULL) {
+    print_field("lat_min", lat[0]);
+    print_field("lat_p50", lat[1]);
+    print_field("lat_p99", lat[2]);
+#if BENCH_REPORT_LAT_MAX
+    print_field("lat_max", lat[3]);
+#endif
+  }
+#if BENCH_FORMAT == BENCH_FORMAT_JSON
+  test_println("}");
+#else
+  if (lat == NULL)
+    test_print(",,,");
+  if ((lat == NULL) || !BENCH_REPORT_LAT_MAX)
+    test_print(",");
+  test_println("");
+#endif
+}
+
+/**
+ * @brief   Starts a repetition.
+ * @details Synchronizes with the system tick and starts the repetition
+ *          window, @p bench_done() returns @p TRUE when the window is
+ *          over.
+ */
+void bench_start(void) {
+
+  test_wait_tick();
+#if BENCH_USE_LATENCY
+  if (sampling) {
+    sampler = chThdSelf();
+    window_over = FALSE;
+    test_timer_done = TRUE;
+    chVTSet(&vt, MS2ST(BENCH_WINDOW), tmr, NULL);
+    last = halGetCounterValue();
+    return;
+  }
+#endif
+  test_start_timer(BENCH_WINDOW);
+}
+
+/**
+ * @brief   Marks the end of an iteration.
+ * @details Invoked by @p bench_done() when @p test_timer_done is set. In
+ *          the latency pass the duration since the previous iteration, or
+ *          since the repetition start, is recorded in the latency
+ *          histogram. The invocations from threads other than the one
+ *          that started the repetition only return the window state.
+ *
+ * @return              The window state.
+ * @retval TRUE         if the repetition window is over.
+ * @retval FALSE        if the repetition window is not over.
+ */
+bool_t bench_stop(void) {
+#if BENCH_USE_LATENCY
+  halrtcnt_t now;
+  uint32_t d;
+
+  if (!sampling)
+    return TRUE;
+  if (chThdSelf() != sampler)
+    return window_over;
+  now = halGetCounterValue();
+  d = (uint32_t)(now - last);
+  last = now;
+  hist[hist_index(d)]++;
+  samples++;
+  if (d < lat_min)
+    lat_min = d;
+  if (d > lat_max)
+    lat_max = d;
+  return window_over;
+#else
+  return TRUE;
+#endif
+}
+
+/**
+ * @brief   Executes a benchmark and prints the results.
+ *
+ * @param[in] bp        pointer to the benchmark descriptor
+ */
+void bench_execute(const struct benchmark *bp) {
+  uint32_t scores[BENCH_REPETITIONS], median, s;
+  int i, j;
+#if BENCH_USE_LATENCY
+  uint32_t lat[4];
+#endif
+
+  for (i = -BENCH_WARMUP; i < BENCH_REPETITIONS; i++) {
+    s = (uint32_t)(((uint64_t)bp->run() * bp->ops * 1000) / BENCH_WINDOW);
+    if (i < 0)
+      continue;
+    /* Insertion in the sorted scores.*/
+    for (j = i; (j > 0) && (scores[j - 1] > s); j--)
+      scores[j] = scores[j - 1];
+    scores[j] = s;
+  }
+#if BENCH_USE_LATENCY
+  /* Latency pass, the iterations are timed in a separate repetition so the
+     scores do not include the counter reads.*/
+  hist_reset();
+  sampling = TRUE;
+  (void)bp->run();
+  sampling = FALSE;
+#endif
+#if (BENCH_REPETITIONS & 1) == 0
+  median = (scores[BENCH_REPETITIONS / 2 - 1] +
+            scores[BENCH_REPETITIONS / 2]) / 2;
+#else
+  median = scores[BENCH_REPETITIONS / 2];
+#endif
+
+  test_print("--- Score : ");
+  test_printn(median);
+  test_print(" ");
+  test_print(bp->unit);
+  if (bp->ctxsw > 0) {
+    test_print(", ");
+    test_printn(median * bp->ctxsw);
+    test_print(" ctxswc/S");
+  }
+  test_println("");
+  test_print("--- Runs  : ");
+  test_printn(BENCH_REPETITIONS);
+  test_print(", min ");
+  test_printn(scores[0]);
+  test_print(", max ");
+  test_printn(scores[BENCH_REPETITIONS - 1]);
+  test_println("");
+#if BENCH_USE_LATENCY
+  if (samples > 0) {
+    lat[0] = to_ns(lat_min, bp->ops);
+    lat[1] = to_ns(hist_percentile(50), bp->ops);
+    lat[2] = to_ns(hist_percentile(99), bp->ops);
+    lat[3] = to_ns(lat_max, bp->ops);
+    test_print("--- Lat.  : min ");
+    test_printn(lat[0]);
+    test_print(", median ");
+    test_printn(lat[1]);
+    test_print(", p99 ");
+    test_printn(lat[2]);
+#if BENCH_REPORT_LAT_MAX
+    test_print(", max ");
+    test_printn(lat[3]);
+#endif
+    test_println(" nS/op");
+    print_record(bp->name, bp->unit, BENCH_REPETITIONS, scores[0], median,
+                 scores[BENCH_REPETITIONS - 1], lat);
+    return;
+  }
+#endif
+  print_record(bp->name, bp->unit, BENCH_REPETITIONS, scores[0], median,
+               scores[BENCH_REPETITIONS - 1], NULL);
+}
+
+/**
+ * @brief   Prints a size result.
+ *
+ * @param[in] name      identifier in the record
+ * @param[in] label     six characters label in the output log
+ * @param[in] size      size in bytes
+ */
+void bench_size(const char *name, const char *label, size_t size) {
+
+  test_print("--- ");
+  test_print(label);
+  test_print(": ");
+  test_printn((uint32_t)size);
+  test_println(" bytes");
+  print_record(name, "bytes", 1, (uint32_t)size, (uint32_t)size,
+               (uint32_t)size, NULL);
+}
+
+/** @} */
@@ -0,0 +1,144 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    bench.h
+ * @brief   Benchmarks framework header.
+ *
+ * @addtogroup test
+ * @{
+ */
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+/**
+ * @name    Machine readable output formats
+ * @{
+ */
+#define BENCH_FORMAT_NONE       0
+#define BENCH_FORMAT_JSON       1
+#define BENCH_FORMAT_CSV        2
+/** @} */
+
+/**
+ * @brief   Prefix of the machine readable records.
+ * @details The records are interleaved with the test suite output, the
+ *          prefix allows to extract them from the log.
+ */
+#define BENCH_RECORD_PREFIX     "@bmk"
+
+/**
+ * @brief   Measured repetitions of each benchmark.
+ */
+#if !defined(BENCH_REPETITIONS) || defined(__DOXYGEN__)
+#define BENCH_REPETITIONS       5
+#endif
+
+/**
+ * @brief   Discarded repetitions executed before the measured ones.
+ */
+#if !defined(BENCH_WARMUP) || defined(__DOXYGEN__)
+#define BENCH_WARMUP            1
+#endif
+
+/**
+ * @brief   Duration of a repetition in milliseconds.
+ * @details The scores are always normalized to one second.
+ */
+#if !defined(BENCH_WINDOW) || defined(__DOXYGEN__)
+#define BENCH_WINDOW            250
+#endif
+
+/**
+ * @brief   Machine readable output format.
+ */
+#if !defined(BENCH_FORMAT) || defined(__DOXYGEN__)
+#define BENCH_FORMAT            BENCH_FORMAT_JSON
+#endif
+
+/**
+ * @brief   Per operation latency measurement.
+ * @details Each iteration is timestamped using the HAL realtime counter
+ *          and the durations are accumulated in an histogram.
+ */
+#if !defined(BENCH_USE_LATENCY) || defined(__DOXYGEN__)
+#define BENCH_USE_LATENCY       HAL_IMPLEMENTS_COUNTERS
+#endif
+
+/**
+ * @brief   Maximum latency reporting.
+ * @details On the simulators the maximum latency measures the host
+ *          scheduler rather than the kernel, it is not reported.
+ */
+#if !defined(BENCH_REPORT_LAT_MAX) || defined(__DOXYGEN__)
+#if defined(CH_ARCHITECTURE_SIMIA32) || defined(CH_ARCHITECTURE_SIMX64)
+#define BENCH_REPORT_LAT_MAX    FALSE
+#else
+#define BENCH_REPORT_LAT_MAX    TRUE
+#endif
+#endif
+
+#if (BENCH_REPETITIONS < 1) || (BENCH_REPETITIONS > 32)
+#error "invalid BENCH_REPETITIONS value"
+#endif
+
+#if BENCH_WINDOW < 10
+#error "invalid BENCH_WINDOW value"
+#endif
+
+#if BENCH_USE_LATENCY && !HAL_IMPLEMENTS_COUNTERS
+#error "BENCH_USE_LATENCY requires HAL_IMPLEMENTS_COUNTERS"
+#endif
+
+/**
+ * @brief   Benchmark descriptor.
+ */
+struct benchmark {
+  const char *name;             /**< @brief Identifier in the records.      */
+  const char *unit;             /**< @brief Score unit.                     */
+  uint32_t ops;                 /**< @brief Score units for each
+                                            iteration.                      */
+  uint32_t ctxsw;               /**< @brief Context switches for each score
+                                            unit, zero if not relevant.     */
+  uint32_t (*run)(void);        /**< @brief Executes a repetition and returns
+                                            the iterations performed.       */
+};
+
+/**
+ * @brief   Returns @p TRUE when the repetition window is over.
+ * @details In the scored repetitions only @p test_timer_done is tested, as
+ *          in the plain test loops. During the latency pass
+ *          @p test_timer_done is kept set and @p bench_stop() records the
+ *          iteration duration, only if invoked by the thread that started
+ *          the repetition.
+ */
+#define bench_done() (test_timer_done && bench_stop())
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void bench_execute(const struct benchmark *bp);
+  void bench_start(void);
+  bool_t bench_stop(void);
+  void bench_size(const char *name, const char *label, size_t size);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _BENCH_H_ */
+
+/** @} */
@@ -32,10 +32,19 @@
 #include "testmsg.h"
 #include "testmbox.h"
 #include "testevt.h"
+#if CH_USE_MEMCORE_REGIONS
+#include "testcore.h"
+#endif
 #include "testheap.h"
 #include "testpools.h"
+#if CH_USE_ARENAS
+#include "testarena.h"
+#endif
 #include "testdyn.h"
 #include "testqueues.h"
+#if CH_USE_SMP
+#include "testsmp.h"
+#endif
 #include "testbmk.h"
 
 /*
@@ -48,10 +57,19 @@ static ROMCONST struct testcase * ROMCONST *patterns[] = {
   patternmsg,
   patternmbox,
   patternevt,
+#if CH_USE_MEMCORE_REGIONS
+  patterncore,
+#endif
   patternheap,
   patternpools,
+#if CH_USE_ARENAS
+  patternarena,
+#endif
   patterndyn,
   patternqueues,
+#if CH_USE_SMP
+  patternsmp,
+#endif
   patternbmk,
   NULL
 };
@@ -336,6 +354,11 @@ msg_t TestThread(void *p) {
   test_print("*** Port Info:    ");
   test_println(CH_PORT_INFO);
 #endif
+#if CH_USE_SMP
+  test_print("*** Cores:        ");
+  test_printn(PORT_CORES_NUMBER);
+  test_println("");
+#endif
 #ifdef PLATFORM_NAME
   test_print("*** Platform:     ");
   test_println(PLATFORM_NAME);
@@ -46,7 +46,7 @@
 #define THREADS_STACK_SIZE      48
 #elif defined(CH_ARCHITECTURE_STM8)
 #define THREADS_STACK_SIZE      64
-#elif defined(CH_ARCHITECTURE_SIMIA32)
+#elif defined(CH_ARCHITECTURE_SIMIA32) || defined(CH_ARCHITECTURE_SIMX64)
 #define THREADS_STACK_SIZE      512
 #else
 #define THREADS_STACK_SIZE      128
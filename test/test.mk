@@ -1,5 +1,6 @@
 # List of all the ChibiOS/RT test files.
 TESTSRC = ${CHIBIOS}/test/test.c \
+          ${CHIBIOS}/test/bench.c \
           ${CHIBIOS}/test/testthd.c \
           ${CHIBIOS}/test/testsem.c \
           ${CHIBIOS}/test/testmtx.c \
@@ -12,5 +13,14 @@ TESTSRC = ${CHIBIOS}/test/test.c \
           ${CHIBIOS}/test/testqueues.c \
           ${CHIBIOS}/test/testbmk.c
 
+# Test files of the optional kernel features, to be added by the projects
+# enabling the related option in chconf.h.
+# CH_USE_MEMCORE_REGIONS
+TESTSRC_CORE = ${CHIBIOS}/test/testcore.c
+# CH_USE_ARENAS
+TESTSRC_ARENA = ${CHIBIOS}/test/testarena.c
+# CH_USE_SMP
+TESTSRC_SMP = ${CHIBIOS}/test/testsmp.c
+
 # Required include directories
 TESTINC = ${CHIBIOS}/test
@@ -0,0 +1,304 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "ch.h"
+#include "test.h"
+
+/**
+ * @page test_arenas Arenas test
+ *
+ * File: @ref testarena.c
+ *
+ * <h2>Description</h2>
+ * This module implements the test sequence for the @ref arenas subsystem.
+ *
+ * <h2>Objective</h2>
+ * Objective of the test module is to cover 100% of the @ref arenas code.
+ *
+ * <h2>Preconditions</h2>
+ * The module requires the following kernel options:
+ * - @p CH_USE_ARENAS
+ * - @p CH_USE_HEAP
+ * .
+ * In case some of the required options are not enabled then some or all tests
+ * may be skipped.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_arenas_001
+ * - @subpage test_arenas_002
+ * - @subpage test_arenas_003
+ * - @subpage test_arenas_004
+ * .
+ * @file testarena.c
+ * @brief Arenas test source file
+ * @file testarena.h
+ * @brief Arenas test header file
+ */
+
+#if (CH_USE_ARENAS && CH_USE_HEAP && !CH_USE_MALLOC_HEAP) ||                \
+    defined(__DOXYGEN__)
+
+#define CHUNK_SIZE  128
+#define CHUNK_HDR   sizeof (union arena_chunk)
+#define HEAP_SIZE   (CHUNK_SIZE * 8)
+
+/*
+ * The heap is not placed in the test buffer because it overlaps the
+ * working areas of the test threads.
+ */
+static stkalign_t heap_buf[HEAP_SIZE / sizeof (stkalign_t)];
+static MemoryHeap test_heap;
+static Arena arena1;
+
+static void arena_setup(void) {
+
+  chHeapInit(&test_heap, heap_buf, HEAP_SIZE);
+  chArenaInitHeap(&arena1, &test_heap, CHUNK_SIZE);
+}
+
+static void arena_teardown(void) {
+
+  chArenaRelease(&arena1);
+}
+
+/**
+ * @page test_arenas_001 Allocation, chaining and reset
+ *
+ * <h2>Description</h2>
+ * Blocks are allocated from an arena until a second chunk is required,
+ * then a block larger than a chunk is allocated, blocks larger than the
+ * heap or the address space are refused. The arena is reset and the same
+ * allocations are performed again.<br>
+ * The test expects the blocks to be aligned and contiguous inside a
+ * chunk, the large block to be allocated and, after the reset, the same
+ * blocks to be returned without taking more memory from the heap.
+ */
+
+static void arena1_execute(void) {
+  uint8_t *p1, *p2, *p3, *p4;
+  size_t n, sz1, sz2;
+
+  p1 = chArenaAlloc(&arena1, 1);
+  test_assert(1, (p1 != NULL) && MEM_IS_ALIGNED(p1), "allocation failed");
+  p2 = chArenaAlloc(&arena1, 8);
+  test_assert(2, p2 == p1 + MEM_ALIGN_SIZE, "not contiguous");
+
+  /* Second chunk.*/
+  p3 = chArenaAlloc(&arena1, CHUNK_SIZE - CHUNK_HDR);
+  test_assert(3, (p3 != NULL) &&
+                 ((p3 < p1) || (p3 >= p1 + CHUNK_SIZE - CHUNK_HDR)),
+              "not in a new chunk");
+
+  /* Block larger than a chunk.*/
+  p4 = chArenaAlloc(&arena1, CHUNK_SIZE * 2);
+  test_assert(4, p4 != NULL, "large allocation failed");
+  test_assert(5, (chArenaAlloc(&arena1, HEAP_SIZE) == NULL) &&
+                 (chArenaAlloc(&arena1, (size_t)-1) == NULL),
+              "allocation not failed");
+
+  /* Reset and reuse of the same chunks.*/
+  (void)chHeapStatus(&test_heap, &sz1);
+  chArenaReset(&arena1);
+  test_assert(6, chArenaAlloc(&arena1, 1) == p1, "not reset");
+  test_assert(7, chArenaAlloc(&arena1, 8) == p2, "not reused");
+  test_assert(8, chArenaAlloc(&arena1, CHUNK_SIZE - CHUNK_HDR) == p3,
+              "chunk not reused");
+  test_assert(9, chArenaAlloc(&arena1, CHUNK_SIZE * 2) == p4,
+              "large chunk not reused");
+  n = chHeapStatus(&test_heap, &sz2);
+  test_assert(10, (sz2 == sz1) && (n == 1), "heap memory consumed");
+}
+
+ROMCONST struct testcase testarena1 = {
+  "Arenas, allocation, chaining and reset",
+  arena_setup,
+  arena_teardown,
+  arena1_execute
+};
+
+/**
+ * @page test_arenas_002 Mark and rewind
+ *
+ * <h2>Description</h2>
+ * The position of an arena is saved, blocks are allocated across two
+ * chunks then the arena is rewound to the saved position. The same is
+ * done with a position saved before the first allocation.<br>
+ * The test expects the allocations after each rewind to restart from the
+ * saved position.
+ */
+
+static void arena2_execute(void) {
+  ArenaMark mark;
+  uint8_t *p1, *p2, *p3;
+
+  chArenaGetMark(&arena1, &mark);
+  p1 = chArenaAlloc(&arena1, 16);
+  test_assert(1, p1 != NULL, "allocation failed");
+  chArenaRewind(&arena1, &mark);
+  test_assert(2, chArenaAlloc(&arena1, 16) == p1, "not rewound");
+
+  chArenaGetMark(&arena1, &mark);
+  p2 = chArenaAlloc(&arena1, 16);
+  p3 = chArenaAlloc(&arena1, CHUNK_SIZE - CHUNK_HDR);
+  test_assert(3, (p2 == p1 + 16) && (p3 != NULL), "allocation failed");
+  chArenaRewind(&arena1, &mark);
+  test_assert(4, chArenaAlloc(&arena1, 16) == p2, "not rewound");
+  test_assert(5, chArenaAlloc(&arena1, CHUNK_SIZE - CHUNK_HDR) == p3,
+              "chunk not reused");
+}
+
+ROMCONST struct testcase testarena2 = {
+  "Arenas, mark and rewind",
+  arena_setup,
+  arena_teardown,
+  arena2_execute
+};
+
+/**
+ * @page test_arenas_003 Chunks sources and release
+ *
+ * <h2>Description</h2>
+ * Arenas are used with chunks taken from a heap, a memory pool and the
+ * memory core then they are released.<br>
+ * The test expects the heap and the memory pool to be back to the initial
+ * status after the release and the memory core chunks to be retained.
+ */
+
+#if CH_USE_MEMPOOLS || defined(__DOXYGEN__)
+static stkalign_t pool_buf[CHUNK_SIZE * 2 / sizeof (stkalign_t)];
+static MemoryPool mp1;
+#endif
+
+static void arena3_execute(void) {
+  size_t n, sz1, sz2;
+
+  /* Heap source.*/
+  (void)chHeapStatus(&test_heap, &sz1);
+  test_assert(1, chArenaAlloc(&arena1, CHUNK_SIZE) != NULL,
+              "allocation failed");
+  test_assert(2, chArenaAlloc(&arena1, CHUNK_SIZE) != NULL,
+              "allocation failed");
+  chArenaRelease(&arena1);
+  n = chHeapStatus(&test_heap, &sz2);
+  test_assert(3, (sz2 == sz1) && (n == 1), "heap not restored");
+
+#if CH_USE_MEMPOOLS || defined(__DOXYGEN__)
+  {
+    Arena arena2;
+
+    /* Memory pool source, the pool has space for two chunks.*/
+    chPoolInit(&mp1, CHUNK_SIZE, NULL);
+    chPoolLoadArray(&mp1, pool_buf, 2);
+    chArenaInitPool(&arena2, &mp1);
+    test_assert(4, chArenaAlloc(&arena2, CHUNK_SIZE) == NULL,
+                "allocation not failed");
+    test_assert(5, chArenaAlloc(&arena2, CHUNK_SIZE - CHUNK_HDR) != NULL,
+                "allocation failed");
+    test_assert(6, chArenaAlloc(&arena2, CHUNK_SIZE - CHUNK_HDR) != NULL,
+                "allocation failed");
+    test_assert(7, chArenaAlloc(&arena2, 1) == NULL,
+                "allocation not failed");
+    chArenaRelease(&arena2);
+    test_assert(8, chPoolAlloc(&mp1) != NULL, "pool not restored");
+    test_assert(9, chPoolAlloc(&mp1) != NULL, "pool not restored");
+  }
+#endif
+
+#if CH_USE_MEMCORE || defined(__DOXYGEN__)
+  {
+    Arena arena3;
+    void *p;
+
+    /* Memory core source, the chunk is retained on release.*/
+    chArenaInitCore(&arena3, CHUNK_SIZE);
+    sz1 = chCoreStatus();
+    p = chArenaAlloc(&arena3, 1);
+    test_assert(10, p != NULL, "allocation failed");
+    sz2 = chCoreStatus();
+    test_assert(11, sz2 <= sz1 - CHUNK_SIZE, "core memory not used");
+    chArenaRelease(&arena3);
+    test_assert(12, chArenaAlloc(&arena3, 1) == p, "chunk not retained");
+    test_assert(13, chCoreStatus() == sz2, "core memory consumed");
+  }
+#endif
+}
+
+ROMCONST struct testcase testarena3 = {
+  "Arenas, chunks sources and release",
+  arena_setup,
+  arena_teardown,
+  arena3_execute
+};
+
+/**
+ * @page test_arenas_004 Current arena
+ *
+ * <h2>Description</h2>
+ * An arena is made current and blocks are allocated without specifying
+ * the arena, a thread is then created and checks its own current
+ * arena.<br>
+ * The test expects the blocks to be allocated from the current arena,
+ * the new thread to have no current arena and the previous current arena
+ * to be restored.
+ */
+
+static msg_t thread(void *p) {
+
+  if (chArenaGetCurrent() == NULL)
+    test_emit_token(*(char *)p);
+  return 0;
+}
+
+static void arena4_execute(void) {
+  Arena *oap;
+  uint8_t *p1;
+
+  oap = chArenaSetCurrent(&arena1);
+  test_assert(1, chArenaGetCurrent() == &arena1, "not current");
+  p1 = chArenaAlloc(NULL, 16);
+  test_assert(2, chArenaAlloc(&arena1, 16) == p1 + 16, "wrong arena");
+
+  threads[0] = chThdCreateStatic(wa[0], WA_SIZE, chThdGetPriority()-1,
+                                 thread, "A");
+  test_wait_threads();
+  test_assert_sequence(3, "A");
+
+  test_assert(4, chArenaSetCurrent(oap) == &arena1, "wrong previous arena");
+  test_assert(5, chArenaGetCurrent() == oap, "not restored");
+}
+
+ROMCONST struct testcase testarena4 = {
+  "Arenas, current arena",
+  arena_setup,
+  arena_teardown,
+  arena4_execute
+};
+
+#endif /* CH_USE_ARENAS && CH_USE_HEAP && !CH_USE_MALLOC_HEAP */
+
+/**
+ * @brief   Test sequence for arenas.
+ */
+ROMCONST struct testcase * ROMCONST patternarena[] = {
+#if (CH_USE_ARENAS && CH_USE_HEAP && !CH_USE_MALLOC_HEAP) ||                \
+    defined(__DOXYGEN__)
+  &testarena1,
+  &testarena2,
+  &testarena3,
+  &testarena4,
+#endif
+  NULL
+};
@@ -15,7 +15,9 @@
 */
 
 #include "ch.h"
+#include "hal.h"
 #include "test.h"
+#include "bench.h"
 
 /**
  * @page test_benchmarks Kernel Benchmarks
@@ -30,7 +32,13 @@
  * <h2>Objective</h2>
  * Objective of the test module is to provide a performance index for the
  * most critical system subsystems. The performance numbers allow to
- * discover performance regressions between successive ChibiOS/RT releases.
+ * discover performance regressions between successive ChibiOS/RT releases.<br>
+ * The benchmarks are executed by the framework in @ref bench.c, each one is
+ * repeated after a warmup and the scores are normalized to one second, the
+ * median score is printed together with the range of the repetitions and
+ * the per operation latency. The results are also printed as machine
+ * readable records that can be compared with a previous run using the
+ * script under <tt>./tools/bmkcompare</tt>.
  *
  * <h2>Preconditions</h2>
  * None.
@@ -49,9 +57,17 @@
  * - @subpage test_benchmarks_011
  * - @subpage test_benchmarks_012
  * - @subpage test_benchmarks_013
+ * - @subpage test_benchmarks_014
+ * - @subpage test_benchmarks_015
+ * - @subpage test_benchmarks_016
+ * - @subpage test_benchmarks_017
  * .
  * @file testbmk.c Kernel Benchmarks
  * @brief Kernel Benchmarks source file
+ * @file bench.c
+ * @brief Benchmarks framework source file
+ * @file bench.h
+ * @brief Benchmarks framework header file
  * @file testbmk.h
  * @brief Kernel Benchmarks header file
  */
@@ -60,6 +76,12 @@ static Semaphore sem1;
 #if CH_USE_MUTEXES || defined(__DOXYGEN__)
 static Mutex mtx1;
 #endif
+#if CH_USE_CONDVARS || defined(__DOXYGEN__)
+static CondVar cnd1;
+#endif
+#if CH_USE_CEILING_MUTEXES || defined(__DOXYGEN__)
+static CeilingMutex cmtx1;
+#endif
 
 static msg_t thread1(void *p) {
   Thread *tp;
@@ -77,18 +99,17 @@ static msg_t thread1(void *p) {
 #ifdef __GNUC__
 __attribute__((noinline))
 #endif
-static unsigned int msg_loop_test(Thread *tp) {
+static uint32_t msg_loop_test(Thread *tp) {
 
   uint32_t n = 0;
-  test_wait_tick();
-  test_start_timer(1000);
+  bench_start();
   do {
     (void)chMsgSend(tp, 1);
     n++;
 #if defined(SIMULATOR)
     ChkIntSources();
 #endif
-  } while (!test_timer_done);
+  } while (!bench_done());
   (void)chMsgSend(tp, 0);
   return n;
 }
@@ -102,17 +123,22 @@ static unsigned int msg_loop_test(Thread *tp) {
  * printed in the output log.
  */
 
-static void bmk1_execute(void) {
+static uint32_t bmk1_run(void) {
   uint32_t n;
 
   threads[0] = chThdCreateStatic(wa[0], WA_SIZE, chThdGetPriority()-1, thread1, NULL);
   n = msg_loop_test(threads[0]);
   test_wait_threads();
-  test_print("--- Score : ");
-  test_printn(n);
-  test_print(" msgs/S, ");
-  test_printn(n << 1);
-  test_println(" ctxswc/S");
+  return n;
+}
+
+static ROMCONST struct benchmark bench1 = {
+  "msg1", "msgs/S", 1, 2, bmk1_run
+};
+
+static void bmk1_execute(void) {
+
+  bench_execute(&bench1);
 }
 
 ROMCONST struct testcase testbmk1 = {
@@ -131,17 +157,22 @@ ROMCONST struct testcase testbmk1 = {
  * printed in the output log.
  */
 
-static void bmk2_execute(void) {
+static uint32_t bmk2_run(void) {
   uint32_t n;
 
   threads[0] = chThdCreateStatic(wa[0], WA_SIZE, chThdGetPriority()+1, thread1, NULL);
   n = msg_loop_test(threads[0]);
   test_wait_threads();
-  test_print("--- Score : ");
-  test_printn(n);
-  test_print(" msgs/S, ");
-  test_printn(n << 1);
-  test_println(" ctxswc/S");
+  return n;
+}
+
+static ROMCONST struct benchmark bench2 = {
+  "msg2", "msgs/S", 1, 2, bmk2_run
+};
+
+static void bmk2_execute(void) {
+
+  bench_execute(&bench2);
 }
 
 ROMCONST struct testcase testbmk2 = {
@@ -166,7 +197,7 @@ static msg_t thread2(void *p) {
  * printed in the output log.
  */
 
-static void bmk3_execute(void) {
+static uint32_t bmk3_run(void) {
   uint32_t n;
 
   threads[0] = chThdCreateStatic(wa[0], WA_SIZE, chThdGetPriority()+1, thread1, NULL);
@@ -176,11 +207,16 @@ static void bmk3_execute(void) {
   threads[4] = chThdCreateStatic(wa[4], WA_SIZE, chThdGetPriority()-5, thread2, NULL);
   n = msg_loop_test(threads[0]);
   test_wait_threads();
-  test_print("--- Score : ");
-  test_printn(n);
-  test_print(" msgs/S, ");
-  test_printn(n << 1);
-  test_println(" ctxswc/S");
+  return n;
+}
+
+static ROMCONST struct benchmark bench3 = {
+  "msg3", "msgs/S", 1, 2, bmk3_run
+};
+
+static void bmk3_execute(void) {
+
+  bench_execute(&bench3);
 }
 
 ROMCONST struct testcase testbmk3 = {
@@ -197,7 +233,7 @@ ROMCONST struct testcase testbmk3 = {
  * A thread is created that just performs a @p chSchGoSleepS() into a loop,
  * the thread is awakened as fast is possible by the tester thread.<br>
  * The Context Switch performance is calculated by measuring the number of
- * iterations after a second of continuous operations.
+ * iterations in the repetition window.
  */
 
 msg_t thread4(void *p) {
@@ -214,14 +250,13 @@ msg_t thread4(void *p) {
   return 0;
 }
 
-static void bmk4_execute(void) {
+static uint32_t bmk4_run(void) {
   Thread *tp;
   uint32_t n;
 
   tp = threads[0] = chThdCreateStatic(wa[0], WA_SIZE, chThdGetPriority()+1, thread4, NULL);
   n = 0;
-  test_wait_tick();
-  test_start_timer(1000);
+  bench_start();
   do {
     chSysLock();
     chSchWakeupS(tp, RDY_OK);
@@ -229,19 +264,26 @@ static void bmk4_execute(void) {
     chSchWakeupS(tp, RDY_OK);
     chSchWakeupS(tp, RDY_OK);
     chSysUnlock();
-    n += 4;
+    n++;
 #if defined(SIMULATOR)
     ChkIntSources();
 #endif
-  } while (!test_timer_done);
+  } while (!bench_done());
   chSysLock();
   chSchWakeupS(tp, RDY_TIMEOUT);
   chSysUnlock();
 
   test_wait_threads();
-  test_print("--- Score : ");
-  test_printn(n * 2);
-  test_println(" ctxswc/S");
+  return n;
+}
+
+static ROMCONST struct benchmark bench4 = {
+  "ctxsw", "ctxswc/S", 8, 0, bmk4_run
+};
+
+static void bmk4_execute(void) {
+
+  bench_execute(&bench4);
 }
 
 ROMCONST struct testcase testbmk4 = {
@@ -258,27 +300,33 @@ ROMCONST struct testcase testbmk4 = {
  * Threads are continuously created and terminated into a loop. A full
  * @p chThdCreateStatic() / @p chThdExit() / @p chThdWait() cycle is performed
  * in each iteration.<br>
- * The performance is calculated by measuring the number of iterations after
- * a second of continuous operations.
+ * The performance is calculated by measuring the number of iterations in
+ * the repetition window.
  */
 
-static void bmk5_execute(void) {
+static uint32_t bmk5_run(void) {
 
   uint32_t n = 0;
   void *wap = wa[0];
   tprio_t prio = chThdGetPriority() - 1;
-  test_wait_tick();
-  test_start_timer(1000);
+  bench_start();
   do {
     chThdWait(chThdCreateStatic(wap, WA_SIZE, prio, thread2, NULL));
     n++;
 #if defined(SIMULATOR)
     ChkIntSources();
 #endif
-  } while (!test_timer_done);
-  test_print("--- Score : ");
-  test_printn(n);
-  test_println(" threads/S");
+  } while (!bench_done());
+  return n;
+}
+
+static ROMCONST struct benchmark bench5 = {
+  "thd_cycle", "threads/S", 1, 0, bmk5_run
+};
+
+static void bmk5_execute(void) {
+
+  bench_execute(&bench5);
 }
 
 ROMCONST struct testcase testbmk5 = {
@@ -297,27 +345,33 @@ ROMCONST struct testcase testbmk5 = {
  * iteration, the @p chThdWait() is not necessary because the thread is
  * created at an higher priority so there is no need to wait for it to
  * terminate.<br>
- * The performance is calculated by measuring the number of iterations after
- * a second of continuous operations.
+ * The performance is calculated by measuring the number of iterations in
+ * the repetition window.
  */
 
-static void bmk6_execute(void) {
+static uint32_t bmk6_run(void) {
 
   uint32_t n = 0;
   void *wap = wa[0];
   tprio_t prio = chThdGetPriority() + 1;
-  test_wait_tick();
-  test_start_timer(1000);
+  bench_start();
   do {
     chThdCreateStatic(wap, WA_SIZE, prio, thread2, NULL);
     n++;
 #if defined(SIMULATOR)
     ChkIntSources();
 #endif
-  } while (!test_timer_done);
-  test_print("--- Score : ");
-  test_printn(n);
-  test_println(" threads/S");
+  } while (!bench_done());
+  return n;
+}
+
+static ROMCONST struct benchmark bench6 = {
+  "thd_create", "threads/S", 1, 0, bmk6_run
+};
+
+static void bmk6_execute(void) {
+
+  bench_execute(&bench6);
 }
 
 ROMCONST struct testcase testbmk6 = {
@@ -334,8 +388,8 @@ ROMCONST struct testcase testbmk6 = {
  * Five threads are created and atomically rescheduled by resetting the
  * semaphore where they are waiting on. The operation is performed into a
  * continuous loop.<br>
- * The performance is calculated by measuring the number of iterations after
- * a second of continuous operations.
+ * The performance is calculated by measuring the number of iterations in
+ * the repetition window.
  */
 
 static msg_t thread3(void *p) {
@@ -351,7 +405,7 @@ static void bmk7_setup(void) {
   chSemInit(&sem1, 0);
 }
 
-static void bmk7_execute(void) {
+static uint32_t bmk7_run(void) {
   uint32_t n;
 
   threads[0] = chThdCreateStatic(wa[0], WA_SIZE, chThdGetPriority()+5, thread3, NULL);
@@ -361,24 +415,27 @@ static void bmk7_execute(void) {
   threads[4] = chThdCreateStatic(wa[4], WA_SIZE, chThdGetPriority()+1, thread3, NULL);
 
   n = 0;
-  test_wait_tick();
-  test_start_timer(1000);
+  bench_start();
   do {
     chSemReset(&sem1, 0);
     n++;
 #if defined(SIMULATOR)
     ChkIntSources();
 #endif
-  } while (!test_timer_done);
+  } while (!bench_done());
   test_terminate_threads();
   chSemReset(&sem1, 0);
   test_wait_threads();
+  return n;
+}
 
-  test_print("--- Score : ");
-  test_printn(n);
-  test_print(" reschedules/S, ");
-  test_printn(n * 6);
-  test_println(" ctxswc/S");
+static ROMCONST struct benchmark bench7 = {
+  "resched", "reschedules/S", 1, 6, bmk7_run
+};
+
+static void bmk7_execute(void) {
+
+  bench_execute(&bench7);
 }
 
 ROMCONST struct testcase testbmk7 = {
@@ -394,8 +451,8 @@ ROMCONST struct testcase testbmk7 = {
  * <h2>Description</h2>
  * Five threads are created at equal priority, each thread just increases a
  * variable and yields.<br>
- * The performance is calculated by measuring the number of iterations after
- * a second of continuous operations.
+ * The performance is calculated by measuring the number of iterations in
+ * the repetition window.
  */
 
 static msg_t thread8(void *p) {
@@ -413,7 +470,7 @@ static msg_t thread8(void *p) {
   return 0;
 }
 
-static void bmk8_execute(void) {
+static uint32_t bmk8_run(void) {
   uint32_t n;
 
   n = 0;
@@ -425,13 +482,19 @@ static void bmk8_execute(void) {
   threads[3] = chThdCreateStatic(wa[3], WA_SIZE, chThdGetPriority()-1, thread8, (void *)&n);
   threads[4] = chThdCreateStatic(wa[4], WA_SIZE, chThdGetPriority()-1, thread8, (void *)&n);
 
-  chThdSleepSeconds(1);
+  chThdSleepMilliseconds(BENCH_WINDOW);
   test_terminate_threads();
   test_wait_threads();
+  return n;
+}
 
-  test_print("--- Score : ");
-  test_printn(n);
-  test_println(" ctxswc/S");
+static ROMCONST struct benchmark bench8 = {
+  "round_robin", "ctxswc/S", 1, 0, bmk8_run
+};
+
+static void bmk8_execute(void) {
+
+  bench_execute(&bench8);
 }
 
 ROMCONST struct testcase testbmk8 = {
@@ -448,19 +511,18 @@ ROMCONST struct testcase testbmk8 = {
  * <h2>Description</h2>
  * Four bytes are written and then read from an @p InputQueue into a continuous
  * loop.<br>
- * The performance is calculated by measuring the number of iterations after
- * a second of continuous operations.
+ * The performance is calculated by measuring the number of iterations in
+ * the repetition window.
  */
 
-static void bmk9_execute(void) {
+static uint32_t bmk9_run(void) {
   uint32_t n;
   static uint8_t ib[16];
   static InputQueue iq;
 
   chIQInit(&iq, ib, sizeof(ib), NULL, NULL);
   n = 0;
-  test_wait_tick();
-  test_start_timer(1000);
+  bench_start();
   do {
     chSysLock();
     chIQPutI(&iq, 0);
@@ -476,10 +538,17 @@ static void bmk9_execute(void) {
 #if defined(SIMULATOR)
     ChkIntSources();
 #endif
-  } while (!test_timer_done);
-  test_print("--- Score : ");
-  test_printn(n * 4);
-  test_println(" bytes/S");
+  } while (!bench_done());
+  return n;
+}
+
+static ROMCONST struct benchmark bench9 = {
+  "queues", "bytes/S", 4, 0, bmk9_run
+};
+
+static void bmk9_execute(void) {
+
+  bench_execute(&bench9);
 }
 
 ROMCONST struct testcase testbmk9 = {
@@ -495,18 +564,17 @@ ROMCONST struct testcase testbmk9 = {
  *
  * <h2>Description</h2>
  * A virtual timer is set and immediately reset into a continuous loop.<br>
- * The performance is calculated by measuring the number of iterations after
- * a second of continuous operations.
+ * The performance is calculated by measuring the number of iterations in
+ * the repetition window.
  */
 
 static void tmo(void *param) {(void)param;}
 
-static void bmk10_execute(void) {
+static uint32_t bmk10_run(void) {
   static VirtualTimer vt1, vt2;
   uint32_t n = 0;
 
-  test_wait_tick();
-  test_start_timer(1000);
+  bench_start();
   do {
     chSysLock();
     chVTSetI(&vt1, 1, tmo, NULL);
@@ -518,10 +586,17 @@ static void bmk10_execute(void) {
 #if defined(SIMULATOR)
     ChkIntSources();
 #endif
-  } while (!test_timer_done);
-  test_print("--- Score : ");
-  test_printn(n * 2);
-  test_println(" timers/S");
+  } while (!bench_done());
+  return n;
+}
+
+static ROMCONST struct benchmark bench10 = {
+  "vt", "timers/S", 2, 0, bmk10_run
+};
+
+static void bmk10_execute(void) {
+
+  bench_execute(&bench10);
 }
 
 ROMCONST struct testcase testbmk10 = {
@@ -538,8 +613,8 @@ ROMCONST struct testcase testbmk10 = {
  * <h2>Description</h2>
  * A counting semaphore is taken/released into a continuous loop, no Context
  * Switch happens because the counter is always non negative.<br>
- * The performance is calculated by measuring the number of iterations after
- * a second of continuous operations.
+ * The performance is calculated by measuring the number of iterations in
+ * the repetition window.
  */
 
 static void bmk11_setup(void) {
@@ -547,11 +622,10 @@ static void bmk11_setup(void) {
   chSemInit(&sem1, 1);
 }
 
-static void bmk11_execute(void) {
+static uint32_t bmk11_run(void) {
   uint32_t n = 0;
 
-  test_wait_tick();
-  test_start_timer(1000);
+  bench_start();
   do {
     chSemWait(&sem1);
     chSemSignal(&sem1);
@@ -565,10 +639,17 @@ static void bmk11_execute(void) {
 #if defined(SIMULATOR)
     ChkIntSources();
 #endif
-  } while (!test_timer_done);
-  test_print("--- Score : ");
-  test_printn(n * 4);
-  test_println(" wait+signal/S");
+  } while (!bench_done());
+  return n;
+}
+
+static ROMCONST struct benchmark bench11 = {
+  "sem", "wait+signal/S", 4, 0, bmk11_run
+};
+
+static void bmk11_execute(void) {
+
+  bench_execute(&bench11);
 }
 
 ROMCONST struct testcase testbmk11 = {
@@ -586,8 +667,8 @@ ROMCONST struct testcase testbmk11 = {
  * <h2>Description</h2>
  * A mutex is locked/unlocked into a continuous loop, no Context Switch happens
  * because there are no other threads asking for the mutex.<br>
- * The performance is calculated by measuring the number of iterations after
- * a second of continuous operations.
+ * The performance is calculated by measuring the number of iterations in
+ * the repetition window.
  */
 
 static void bmk12_setup(void) {
@@ -595,11 +676,10 @@ static void bmk12_setup(void) {
   chMtxInit(&mtx1);
 }
 
-static void bmk12_execute(void) {
+static uint32_t bmk12_run(void) {
   uint32_t n = 0;
 
-  test_wait_tick();
-  test_start_timer(1000);
+  bench_start();
   do {
     chMtxLock(&mtx1);
     chMtxUnlock();
@@ -613,10 +693,17 @@ static void bmk12_execute(void) {
 #if defined(SIMULATOR)
     ChkIntSources();
 #endif
-  } while (!test_timer_done);
-  test_print("--- Score : ");
-  test_printn(n * 4);
-  test_println(" lock+unlock/S");
+  } while (!bench_done());
+  return n;
+}
+
+static ROMCONST struct benchmark bench12 = {
+  "mtx", "lock+unlock/S", 4, 0, bmk12_run
+};
+
+static void bmk12_execute(void) {
+
+  bench_execute(&bench12);
 }
 
 ROMCONST struct testcase testbmk12 = {
@@ -636,51 +723,35 @@ ROMCONST struct testcase testbmk12 = {
 
 static void bmk13_execute(void) {
 
-  test_print("--- System: ");
-  test_printn(sizeof(ReadyList) + sizeof(VTList) +
-              PORT_IDLE_THREAD_STACK_SIZE +
-              (sizeof(Thread) + sizeof(struct intctx) +
-               sizeof(struct extctx) +
-               PORT_INT_REQUIRED_STACK) * 2);
-  test_println(" bytes");
-  test_print("--- Thread: ");
-  test_printn(sizeof(Thread));
-  test_println(" bytes");
-  test_print("--- Timer : ");
-  test_printn(sizeof(VirtualTimer));
-  test_println(" bytes");
+  bench_size("size_system", "System",
+             sizeof(ReadyList) + sizeof(VTList) +
+             PORT_IDLE_THREAD_STACK_SIZE +
+             (sizeof(Thread) + sizeof(struct intctx) +
+              sizeof(struct extctx) +
+              PORT_INT_REQUIRED_STACK) * 2);
+  bench_size("size_thread", "Thread", sizeof(Thread));
+  bench_size("size_timer", "Timer ", sizeof(VirtualTimer));
 #if CH_USE_SEMAPHORES || defined(__DOXYGEN__)
-  test_print("--- Semaph: ");
-  test_printn(sizeof(Semaphore));
-  test_println(" bytes");
+  bench_size("size_semaphore", "Semaph", sizeof(Semaphore));
 #endif
 #if CH_USE_EVENTS || defined(__DOXYGEN__)
-  test_print("--- EventS: ");
-  test_printn(sizeof(EventSource));
-  test_println(" bytes");
-  test_print("--- EventL: ");
-  test_printn(sizeof(EventListener));
-  test_println(" bytes");
+  bench_size("size_event_source", "EventS", sizeof(EventSource));
+  bench_size("size_event_listener", "EventL", sizeof(EventListener));
 #endif
 #if CH_USE_MUTEXES || defined(__DOXYGEN__)
-  test_print("--- Mutex : ");
-  test_printn(sizeof(Mutex));
-  test_println(" bytes");
+  bench_size("size_mutex", "Mutex ", sizeof(Mutex));
+#endif
+#if CH_USE_CEILING_MUTEXES || defined(__DOXYGEN__)
+  bench_size("size_ceiling_mutex", "CMutex", sizeof(CeilingMutex));
 #endif
 #if CH_USE_CONDVARS || defined(__DOXYGEN__)
-  test_print("--- CondV.: ");
-  test_printn(sizeof(CondVar));
-  test_println(" bytes");
+  bench_size("size_condvar", "CondV.", sizeof(CondVar));
 #endif
 #if CH_USE_QUEUES || defined(__DOXYGEN__)
-  test_print("--- Queue : ");
-  test_printn(sizeof(GenericQueue));
-  test_println(" bytes");
+  bench_size("size_queue", "Queue ", sizeof(GenericQueue));
 #endif
 #if CH_USE_MAILBOXES || defined(__DOXYGEN__)
-  test_print("--- MailB.: ");
-  test_printn(sizeof(Mailbox));
-  test_println(" bytes");
+  bench_size("size_mailbox", "MailB.", sizeof(Mailbox));
 #endif
 }
 
@@ -691,6 +762,426 @@ ROMCONST struct testcase testbmk13 = {
   bmk13_execute
 };
 
+#if CH_USE_SMP || defined(__DOXYGEN__)
+/**
+ * @page test_benchmarks_014 SMP scaling
+ *
+ * <h2>Description</h2>
+ * A counting loop is executed by a single thread then by a thread on each
+ * core, the threads never enter the kernel.<br>
+ * The performance is calculated by measuring the number of iterations after
+ * a second of continuous operations, the speedup of the cores respect to the
+ * single thread is printed too.
+ */
+
+#define BMK14_THREADS (PORT_CORES_NUMBER < MAX_THREADS ?                    \
+                       PORT_CORES_NUMBER : MAX_THREADS)
+
+static msg_t thread14(void *p) {
+  volatile uint32_t *np = p;
+
+  while (!*(volatile bool_t *)&test_timer_done)
+    (*np)++;
+  return 0;
+}
+
+static uint32_t smp_loop_test(unsigned n) {
+  static uint32_t counters[MAX_THREADS];
+  uint32_t total = 0;
+  unsigned i;
+
+  test_wait_tick();
+  test_start_timer(1000);
+  for (i = 0; i < n; i++) {
+    counters[i] = 0;
+    chSysLock();
+    threads[i] = chThdCreateI(wa[i], WA_SIZE, chThdGetPriority() - 1,
+                              thread14, &counters[i]);
+    threads[i]->p_affinity = CH_CORE_MASK(i);
+    chSchWakeupS(threads[i], RDY_OK);
+    chSysUnlock();
+  }
+  test_wait_threads();
+  for (i = 0; i < n; i++)
+    total += counters[i];
+  return total;
+}
+
+static void bmk14_execute(void) {
+  uint32_t n1, n, s;
+
+  n1 = smp_loop_test(1);
+  n = smp_loop_test(BMK14_THREADS);
+  s = (uint32_t)((uint64_t)n * 100 / (n1 ? n1 : 1));
+  test_print("--- Score : ");
+  test_printn(n1);
+  test_println(" loops/S on 1 core");
+  test_print("--- Score : ");
+  test_printn(n);
+  test_print(" loops/S on ");
+  test_printn(BMK14_THREADS);
+  test_println(" cores");
+  test_print("--- Speedup: ");
+  test_printn(s / 100);
+  test_print(".");
+  test_printn((s / 10) % 10);
+  test_printn(s % 10);
+  test_println("");
+}
+
+ROMCONST struct testcase testbmk14 = {
+  "Benchmark, SMP scaling",
+  NULL,
+  NULL,
+  bmk14_execute
+};
+#endif /* CH_USE_SMP */
+
+#if CH_USE_CONDVARS || defined(__DOXYGEN__)
+/**
+ * @page test_benchmarks_015 CondVar broadcast performance
+ *
+ * <h2>Description</h2>
+ * A group of threads waits on a condition variable, the tester thread
+ * broadcasts the condition variable while owning the mutex and then
+ * releases the mutex, each waiting thread acquires the mutex and waits
+ * again. The benchmark is repeated with 1 to 32 waiting threads, limited by
+ * the available working areas.<br>
+ * The performance is calculated by measuring the number of broadcasts in
+ * the repetition window, the latency is the duration of a complete cycle.
+ * The context switches for each broadcast are also printed if the kernel
+ * trace is enabled.
+ */
+
+#if defined(CH_ARCHITECTURE_SIMIA32) || defined(CH_ARCHITECTURE_SIMX64)
+#define BMK15_WAITERS           32
+#else
+#define BMK15_WAITERS           MAX_THREADS
+#endif
+
+#if BMK15_WAITERS > MAX_THREADS
+static stkalign_t bmk15_wa[BMK15_WAITERS][WA_SIZE / sizeof(stkalign_t)];
+#define BMK15_WA(i)             ((void *)bmk15_wa[i])
+#else
+#define BMK15_WA(i)             (wa[i])
+#endif
+
+static Thread *bmk15_threads[BMK15_WAITERS];
+static unsigned bmk15_waiters;
+#if CH_DBG_ENABLE_TRACE || defined(__DOXYGEN__)
+static uint32_t bmk15_switches, bmk15_cycles;
+#endif
+
+static msg_t thread15(void *p) {
+
+  (void)p;
+  chMtxLock(&mtx1);
+  while (!chThdShouldTerminate())
+    chCondWait(&cnd1);
+  chMtxUnlock();
+  return 0;
+}
+
+static uint32_t bmk15_run(void) {
+  uint32_t n = 0;
+  unsigned i;
+#if CH_DBG_ENABLE_TRACE || defined(__DOXYGEN__)
+  uint32_t sw;
+#endif
+
+  for (i = 0; i < bmk15_waiters; i++)
+    bmk15_threads[i] = chThdCreateStatic(BMK15_WA(i), WA_SIZE,
+                                         chThdGetPriority() + 1,
+                                         thread15, NULL);
+  bench_start();
+#if CH_DBG_ENABLE_TRACE || defined(__DOXYGEN__)
+  sw = dbg_trace_buffer.tb_count;
+#endif
+  do {
+    chMtxLock(&mtx1);
+    chCondBroadcast(&cnd1);
+    chMtxUnlock();
+    n++;
+#if defined(SIMULATOR)
+    ChkIntSources();
+#endif
+  } while (!bench_done());
+#if CH_DBG_ENABLE_TRACE || defined(__DOXYGEN__)
+  bmk15_switches += dbg_trace_buffer.tb_count - sw;
+  bmk15_cycles += n;
+#endif
+
+  chMtxLock(&mtx1);
+  for (i = 0; i < bmk15_waiters; i++)
+    chThdTerminate(bmk15_threads[i]);
+  chCondBroadcast(&cnd1);
+  chMtxUnlock();
+  for (i = 0; i < bmk15_waiters; i++)
+    chThdWait(bmk15_threads[i]);
+  return n;
+}
+
+static ROMCONST struct benchmark bench15[] = {
+  {"cond_bcast_1", "broadcasts/S", 1, 0, bmk15_run},
+  {"cond_bcast_2", "broadcasts/S", 1, 0, bmk15_run},
+  {"cond_bcast_4", "broadcasts/S", 1, 0, bmk15_run},
+  {"cond_bcast_8", "broadcasts/S", 1, 0, bmk15_run},
+  {"cond_bcast_16", "broadcasts/S", 1, 0, bmk15_run},
+  {"cond_bcast_32", "broadcasts/S", 1, 0, bmk15_run}
+};
+
+static void bmk15_setup(void) {
+
+  chMtxInit(&mtx1);
+  chCondInit(&cnd1);
+}
+
+static void bmk15_execute(void) {
+  unsigned i;
+
+  for (i = 0; (i < sizeof bench15 / sizeof bench15[0]) &&
+              ((1U << i) <= BMK15_WAITERS); i++) {
+    bmk15_waiters = 1U << i;
+    test_print("--- Waits : ");
+    test_printn(bmk15_waiters);
+    test_println(" threads");
+#if CH_DBG_ENABLE_TRACE || defined(__DOXYGEN__)
+    bmk15_switches = bmk15_cycles = 0;
+#endif
+    bench_execute(&bench15[i]);
+#if CH_DBG_ENABLE_TRACE || defined(__DOXYGEN__)
+    test_print("--- Ctxsw : ");
+    test_printn(bmk15_switches / bmk15_cycles);
+    test_print(".");
+    test_printn((bmk15_switches * 10 / bmk15_cycles) % 10);
+    test_println(" per broadcast");
+#endif
+  }
+}
+
+ROMCONST struct testcase testbmk15 = {
+  "Benchmark, CondVar broadcast",
+  bmk15_setup,
+  NULL,
+  bmk15_execute
+};
+#endif /* CH_USE_CONDVARS */
+
+#if CH_USE_CEILING_MUTEXES || defined(__DOXYGEN__)
+/**
+ * @page test_benchmarks_016 Mutexes handoff, inheritance versus ceiling
+ *
+ * <h2>Description</h2>
+ * The tester thread owns some nested mutexes, locks a mutex and signals a
+ * semaphore awakening a thread with higher priority that takes the same
+ * mutex, then the tester thread unlocks the mutex. The cycle is performed
+ * using priority inheritance mutexes and then ceiling mutexes.<br>
+ * With priority inheritance the awakened thread preempts the tester,
+ * blocks on the mutex boosting the tester priority and receives the mutex
+ * on unlock, the unlock scans the nested mutexes. With a ceiling above the
+ * awakened thread priority the tester is not preempted and the awakened
+ * thread runs only after the unlock, finding the mutex free.<br>
+ * The performance is calculated by measuring the number of cycles in the
+ * repetition window, the latency is the duration of a complete cycle and
+ * its maximum is the worst case of the protocol.
+ */
+
+#define BMK16_NESTED            4
+
+static Mutex bmk16_mtx[BMK16_NESTED];
+static CeilingMutex bmk16_cmtx[BMK16_NESTED];
+
+static msg_t thread16(void *p) {
+
+  (void)p;
+  while (chSemWait(&sem1) == RDY_OK) {
+    chMtxLock(&mtx1);
+    chMtxUnlock();
+  }
+  return 0;
+}
+
+static msg_t thread16c(void *p) {
+
+  (void)p;
+  while (chSemWait(&sem1) == RDY_OK) {
+    chCMtxLock(&cmtx1);
+    chCMtxUnlock();
+  }
+  return 0;
+}
+
+static uint32_t bmk16_run(void) {
+  uint32_t n = 0;
+  unsigned i;
+
+  threads[0] = chThdCreateStatic(wa[0], WA_SIZE, chThdGetPriority()+1,
+                                 thread16, NULL);
+  bench_start();
+  for (i = 0; i < BMK16_NESTED; i++)
+    chMtxLock(&bmk16_mtx[i]);
+  do {
+    chMtxLock(&mtx1);
+    chSemSignal(&sem1);
+    chMtxUnlock();
+    n++;
+#if defined(SIMULATOR)
+    ChkIntSources();
+#endif
+  } while (!bench_done());
+  chMtxUnlockAll();
+  chSemReset(&sem1, 0);
+  test_wait_threads();
+  return n;
+}
+
+static uint32_t bmk16c_run(void) {
+  uint32_t n = 0;
+  unsigned i;
+
+  threads[0] = chThdCreateStatic(wa[0], WA_SIZE, chThdGetPriority()+1,
+                                 thread16c, NULL);
+  /* The nested mutexes are locked after the tick synchronization, a
+     thread must not sleep while owning a ceiling mutex.*/
+  bench_start();
+  for (i = 0; i < BMK16_NESTED; i++)
+    chCMtxLock(&bmk16_cmtx[i]);
+  do {
+    chCMtxLock(&cmtx1);
+    chSemSignal(&sem1);
+    chCMtxUnlock();
+    n++;
+#if defined(SIMULATOR)
+    ChkIntSources();
+#endif
+  } while (!bench_done());
+  for (i = 0; i < BMK16_NESTED; i++)
+    chCMtxUnlock();
+  chSemReset(&sem1, 0);
+  test_wait_threads();
+  return n;
+}
+
+static ROMCONST struct benchmark bench16[] = {
+  {"mtx_handoff", "cycles/S", 1, 4, bmk16_run},
+  {"cmtx_handoff", "cycles/S", 1, 2, bmk16c_run}
+};
+
+static void bmk16_setup(void) {
+  tprio_t prio = chThdGetPriority();
+  unsigned i;
+
+  chSemInit(&sem1, 0);
+  chMtxInit(&mtx1);
+  chCMtxInit(&cmtx1, prio + 2);
+  for (i = 0; i < BMK16_NESTED; i++) {
+    chMtxInit(&bmk16_mtx[i]);
+    chCMtxInit(&bmk16_cmtx[i], prio + 1);
+  }
+}
+
+static void bmk16_execute(void) {
+
+  bench_execute(&bench16[0]);
+  bench_execute(&bench16[1]);
+}
+
+ROMCONST struct testcase testbmk16 = {
+  "Benchmark, mutexes handoff, inheritance vs ceiling",
+  bmk16_setup,
+  NULL,
+  bmk16_execute
+};
+#endif /* CH_USE_CEILING_MUTEXES */
+
+#if (CH_USE_ARENAS && CH_USE_HEAP && !CH_USE_MALLOC_HEAP) ||                \
+    defined(__DOXYGEN__)
+/**
+ * @page test_benchmarks_017 Arena versus heap, request pattern
+ *
+ * <h2>Description</h2>
+ * The handling of a request is simulated by allocating a series of small
+ * temporary blocks of various sizes and by freeing all of them at the end
+ * of the request. The blocks are allocated from a heap and freed one by
+ * one, then allocated from an arena taking its chunks from the same heap
+ * and freed by resetting the arena.<br>
+ * The performance is calculated by measuring the number of requests
+ * handled in the repetition window.
+ */
+
+#define BMK17_CHUNK_SIZE        256
+
+static ROMCONST size_t bmk17_sizes[] = {24, 8, 64, 16, 120, 32, 8, 48};
+
+#define BMK17_BLOCKS            (sizeof bmk17_sizes / sizeof bmk17_sizes[0])
+
+static MemoryHeap bmk17_heap;
+static Arena bmk17_arena;
+
+static uint32_t bmk17_run(void) {
+  void *blocks[BMK17_BLOCKS];
+  uint32_t n = 0;
+  unsigned i;
+
+  bench_start();
+  do {
+    for (i = 0; i < BMK17_BLOCKS; i++)
+      blocks[i] = chHeapAlloc(&bmk17_heap, bmk17_sizes[i]);
+    for (i = 0; i < BMK17_BLOCKS; i++)
+      chHeapFree(blocks[i]);
+    n++;
+#if defined(SIMULATOR)
+    ChkIntSources();
+#endif
+  } while (!bench_done());
+  return n;
+}
+
+static uint32_t bmk17a_run(void) {
+  void *blocks[BMK17_BLOCKS];
+  uint32_t n = 0;
+  unsigned i;
+
+  bench_start();
+  do {
+    for (i = 0; i < BMK17_BLOCKS; i++)
+      blocks[i] = chArenaAlloc(&bmk17_arena, bmk17_sizes[i]);
+    chArenaReset(&bmk17_arena);
+    n++;
+#if defined(SIMULATOR)
+    ChkIntSources();
+#endif
+  } while (!bench_done());
+  (void)blocks;
+  chArenaRelease(&bmk17_arena);
+  return n;
+}
+
+static ROMCONST struct benchmark bench17[] = {
+  {"heap_request", "requests/S", 1, 0, bmk17_run},
+  {"arena_request", "requests/S", 1, 0, bmk17a_run}
+};
+
+static void bmk17_setup(void) {
+
+  chHeapInit(&bmk17_heap, test.buffer, sizeof(union test_buffers));
+  chArenaInitHeap(&bmk17_arena, &bmk17_heap, BMK17_CHUNK_SIZE);
+}
+
+static void bmk17_execute(void) {
+
+  bench_execute(&bench17[0]);
+  bench_execute(&bench17[1]);
+}
+
+ROMCONST struct testcase testbmk17 = {
+  "Benchmark, arena versus heap, request pattern",
+  bmk17_setup,
+  NULL,
+  bmk17_execute
+};
+#endif /* CH_USE_ARENAS && CH_USE_HEAP && !CH_USE_MALLOC_HEAP */
+
 /**
  * @brief   Test sequence for benchmarks.
  */
@@ -715,6 +1206,19 @@ ROMCONST struct testcase * ROMCONST patternbmk[] = {
   &testbmk12,
 #endif
   &testbmk13,
+#if CH_USE_SMP || defined(__DOXYGEN__)
+  &testbmk14,
+#endif
+#if CH_USE_CONDVARS || defined(__DOXYGEN__)
+  &testbmk15,
+#endif
+#if CH_USE_CEILING_MUTEXES || defined(__DOXYGEN__)
+  &testbmk16,
+#endif
+#if (CH_USE_ARENAS && CH_USE_HEAP && !CH_USE_MALLOC_HEAP) ||                \
+    defined(__DOXYGEN__)
+  &testbmk17,
+#endif
 #endif
   NULL
 };
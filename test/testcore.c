@@ -0,0 +1,321 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "ch.h"
+#include "test.h"
+
+/**
+ * @page test_core Memory Core test
+ *
+ * File: @ref testcore.c
+ *
+ * <h2>Description</h2>
+ * This module implements the test sequence for the memory regions of the
+ * @ref memcore subsystem.
+ *
+ * <h2>Objective</h2>
+ * Objective of the test module is to cover 100% of the memory regions
+ * code, including the heaps, memory pools and threads placed in a region.
+ *
+ * <h2>Preconditions</h2>
+ * The module requires the following kernel options:
+ * - @p CH_USE_MEMCORE_REGIONS
+ * .
+ * In case some of the required options are not enabled then some or all tests
+ * may be skipped.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_core_001
+ * - @subpage test_core_002
+ * - @subpage test_core_003
+ * - @subpage test_core_004
+ * .
+ * @file testcore.c
+ * @brief Memory Core test source file
+ * @file testcore.h
+ * @brief Memory Core test header file
+ */
+
+#if CH_USE_MEMCORE_REGIONS || defined(__DOXYGEN__)
+
+/*
+ * Two regions are defined over static buffers, a fast region not reachable
+ * by DMA and a region reachable by DMA with a speed between the main RAM
+ * and the fast region, so the fallback of the placed allocations never
+ * consumes the default region.
+ */
+#define FAST_SIZE   (WA_SIZE * 2)
+#define MID_SIZE    (WA_SIZE * 2)
+#define MID_ATTR    ((MEM_SPEED_NORMAL + 2) | MEM_DMA)
+
+static stkalign_t fast_buf[FAST_SIZE / sizeof (stkalign_t)];
+static stkalign_t mid_buf[MID_SIZE / sizeof (stkalign_t)];
+static MemoryRegion mr_fast, mr_mid;
+
+static void regions_setup(void) {
+
+  chCoreAddRegion(&mr_fast, "test-fast", fast_buf, FAST_SIZE,
+                  MEM_SPEED_FAST);
+  chCoreAddRegion(&mr_mid, "test-mid", mid_buf, MID_SIZE, MID_ATTR);
+}
+
+static void regions_teardown(void) {
+
+  chCoreRemoveRegion(&mr_fast);
+  chCoreRemoveRegion(&mr_mid);
+}
+
+/*
+ * Returns the region containing the specified address.
+ */
+static MemoryRegion *region_of(void *p) {
+  MemoryRegion *mrp;
+
+  mrp = chCoreFirstRegion();
+  while (mrp != NULL) {
+    if (((uint8_t *)p >= mrp->mr_base) && ((uint8_t *)p < mrp->mr_end))
+      return mrp;
+    mrp = chCoreNextRegion(mrp);
+  }
+  return NULL;
+}
+
+/**
+ * @page test_core_001 Regions allocation and statistics
+ *
+ * <h2>Description</h2>
+ * Two regions are added then blocks are allocated from one of them until
+ * it is exhausted, the region is then removed and added again.<br>
+ * The test expects the regions to be listed by decreasing speed, the
+ * allocated blocks to be aligned and the statistics to track the used
+ * memory, the allocations and the failures.
+ */
+
+static void core1_execute(void) {
+  MemoryRegion *mrp;
+  MemoryRegionStats mrs;
+  unsigned n;
+  void *p;
+
+  /* Lookup by name.*/
+  test_assert(1, chCoreFindRegion("test-fast") == &mr_fast, "not found");
+  test_assert(2, chCoreFindRegion("test-mid") == &mr_mid, "not found");
+  test_assert(3, chCoreFindRegion("none") == NULL, "found");
+  mrp = chCoreFindRegion("core");
+  test_assert(4, (mrp != NULL) && (chCoreGetRegionAttr(mrp) & MEM_DMA),
+              "wrong default region");
+
+  /* Regions order, each region listed once.*/
+  n = 0;
+  mrp = chCoreFirstRegion();
+  while (chCoreNextRegion(mrp) != NULL) {
+    test_assert(5, (chCoreGetRegionAttr(mrp) & MEM_SPEED_MASK) >=
+                   (chCoreGetRegionAttr(chCoreNextRegion(mrp)) &
+                    MEM_SPEED_MASK), "wrong order");
+    if ((mrp == &mr_fast) || (mrp == &mr_mid))
+      n++;
+    mrp = chCoreNextRegion(mrp);
+  }
+  test_assert(6, n == 2, "wrong regions list");
+
+  /* Allocation and statistics.*/
+  chCoreGetStats(&mr_fast, &mrs);
+  test_assert(7, (mrs.size == FAST_SIZE) && (mrs.used == 0), "wrong size");
+  p = chCoreAllocFrom(&mr_fast, 1);
+  test_assert(8, (region_of(p) == &mr_fast) && MEM_IS_ALIGNED(p),
+              "wrong block");
+  chCoreGetStats(&mr_fast, &mrs);
+  test_assert(9, (mrs.used == MEM_ALIGN_SIZE) && (mrs.allocs == 1),
+              "wrong statistics");
+
+  /* Exhaustion.*/
+  p = chCoreAllocFrom(&mr_fast, FAST_SIZE);
+  test_assert(10, p == NULL, "allocation not failed");
+  p = chCoreAllocFrom(&mr_fast, FAST_SIZE - MEM_ALIGN_SIZE);
+  test_assert(11, region_of(p) == &mr_fast, "allocation failed");
+  chCoreGetStats(&mr_fast, &mrs);
+  test_assert(12, (mrs.used == FAST_SIZE) && (mrs.allocs == 2) &&
+                  (mrs.fails == 1), "wrong statistics");
+
+  /* Removal, then adding the region again resets it.*/
+  chCoreRemoveRegion(&mr_fast);
+  test_assert(13, chCoreFindRegion("test-fast") == NULL, "not removed");
+  chCoreAddRegion(&mr_fast, "test-fast", fast_buf, FAST_SIZE,
+                  MEM_SPEED_FAST);
+  chCoreGetStats(&mr_fast, &mrs);
+  test_assert(14, (mrs.used == 0) && (mrs.allocs == 0) && (mrs.fails == 0),
+              "not reset");
+}
+
+ROMCONST struct testcase testcore1 = {
+  "Memory Core, regions allocation and statistics",
+  regions_setup,
+  regions_teardown,
+  core1_execute
+};
+
+/**
+ * @page test_core_002 Placed allocations
+ *
+ * <h2>Description</h2>
+ * Blocks are allocated by attributes with various speed preferences and
+ * DMA requirements, the fast region is then exhausted.<br>
+ * The test expects each block to come from a region satisfying the
+ * requirements and the allocations to fall back to a slower region when
+ * the fast one is full.
+ */
+
+static void core2_execute(void) {
+  MemoryRegionStats mrs;
+  void *p;
+
+  p = chCoreAllocPlaced(MEM_ALIGN_SIZE, MEM_SPEED_FAST);
+  test_assert(1, (p != NULL) &&
+                 ((chCoreGetRegionAttr(region_of(p)) & MEM_SPEED_MASK) >=
+                  MEM_SPEED_FAST), "not in fast memory");
+
+  p = chCoreAllocPlaced(MEM_ALIGN_SIZE, MEM_SPEED_NORMAL + 1);
+  test_assert(2, region_of(p) == &mr_mid, "wrong region");
+
+  p = chCoreAllocPlaced(MEM_ALIGN_SIZE, MEM_SPEED_FAST | MEM_DMA);
+  test_assert(3, (p != NULL) && (chCoreGetRegionAttr(region_of(p)) & MEM_DMA),
+              "not in DMA memory");
+
+  /* Fallback on a slower region.*/
+  chCoreGetStats(&mr_fast, &mrs);
+  (void)chCoreAllocFrom(&mr_fast, mrs.size - mrs.used);
+  p = chCoreAllocPlaced(MEM_ALIGN_SIZE, MEM_SPEED_FAST);
+  test_assert(4, (p != NULL) && (region_of(p) != &mr_fast), "no fallback");
+}
+
+ROMCONST struct testcase testcore2 = {
+  "Memory Core, placed allocations",
+  regions_setup,
+  regions_teardown,
+  core2_execute
+};
+
+/**
+ * @page test_core_003 Heaps and pools bound to regions
+ *
+ * <h2>Description</h2>
+ * A heap is bound to the fast region and a memory pool to the other
+ * region, objects are allocated, freed and allocated again.<br>
+ * The test expects the objects to be allocated from the bound regions and
+ * the freed objects to be reused without consuming more region memory.
+ */
+
+#if (CH_USE_HEAP && !CH_USE_MALLOC_HEAP) || defined(__DOXYGEN__)
+static MemoryHeap heap1;
+#endif
+#if CH_USE_MEMPOOLS || defined(__DOXYGEN__)
+static MemoryPool mp1;
+#endif
+
+static void core3_execute(void) {
+  MemoryRegionStats mrs;
+  size_t used;
+  void *p1, *p2;
+
+#if (CH_USE_HEAP && !CH_USE_MALLOC_HEAP) || defined(__DOXYGEN__)
+  chHeapInitRegion(&heap1, &mr_fast);
+  p1 = chHeapAlloc(&heap1, 16);
+  test_assert(1, region_of(p1) == &mr_fast, "wrong region");
+  chHeapFree(p1);
+  chCoreGetStats(&mr_fast, &mrs);
+  used = mrs.used;
+  p2 = chHeapAlloc(&heap1, 16);
+  test_assert(2, p2 == p1, "block not reused");
+  chCoreGetStats(&mr_fast, &mrs);
+  test_assert(3, mrs.used == used, "region memory consumed");
+  chHeapFree(p2);
+  test_assert(4, chHeapAlloc(&heap1, FAST_SIZE) == NULL,
+              "allocation not failed");
+#endif
+
+#if CH_USE_MEMPOOLS || defined(__DOXYGEN__)
+  chPoolInitRegion(&mp1, 32, &mr_mid);
+  p1 = chPoolAlloc(&mp1);
+  test_assert(5, region_of(p1) == &mr_mid, "wrong region");
+  chPoolFree(&mp1, p1);
+  chCoreGetStats(&mr_mid, &mrs);
+  used = mrs.used;
+  p2 = chPoolAlloc(&mp1);
+  test_assert(6, p2 == p1, "object not reused");
+  chCoreGetStats(&mr_mid, &mrs);
+  test_assert(7, mrs.used == used, "region memory consumed");
+#endif
+}
+
+ROMCONST struct testcase testcore3 = {
+  "Memory Core, heaps and pools bound to regions",
+  regions_setup,
+  regions_teardown,
+  core3_execute
+};
+
+/**
+ * @page test_core_004 Threads placement
+ *
+ * <h2>Description</h2>
+ * A thread is created in the fast region then two more threads are
+ * created in the fastest memory available, the fast region has space for
+ * two working areas.<br>
+ * The test expects the first two threads to be in the fast region, the
+ * last one in a slower region and all of them to run.
+ */
+
+static msg_t thread(void *p) {
+
+  test_emit_token(*(char *)p);
+  return 0;
+}
+
+static void core4_execute(void) {
+  tprio_t prio = chThdGetPriority();
+
+  threads[0] = chThdCreateFromRegion(&mr_fast, WA_SIZE, prio-1, thread, "A");
+  threads[1] = chThdCreateFast(WA_SIZE, prio-1, thread, "B");
+  threads[2] = chThdCreateFast(WA_SIZE, prio-1, thread, "C");
+  test_assert(1, region_of(threads[0]) == &mr_fast, "wrong region");
+  test_assert(2, region_of(threads[1]) == &mr_fast, "wrong region");
+  test_assert(3, (threads[2] != NULL) && (region_of(threads[2]) != &mr_fast),
+              "wrong region");
+  test_wait_threads();
+  test_assert_sequence(4, "ABC");
+}
+
+ROMCONST struct testcase testcore4 = {
+  "Memory Core, threads placement",
+  regions_setup,
+  regions_teardown,
+  core4_execute
+};
+
+#endif /* CH_USE_MEMCORE_REGIONS */
+
+/**
+ * @brief   Test sequence for the memory core.
+ */
+ROMCONST struct testcase * ROMCONST patterncore[] = {
+#if CH_USE_MEMCORE_REGIONS || defined(__DOXYGEN__)
+  &testcore1,
+  &testcore2,
+  &testcore3,
+  &testcore4,
+#endif
+  NULL
+};
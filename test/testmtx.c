@@ -23,8 +23,8 @@
  * File: @ref testmtx.c
  *
  * <h2>Description</h2>
- * This module implements the test sequence for the @ref mutexes and
- * @ref condvars subsystems.<br>
+ * This module implements the test sequence for the @ref mutexes,
+ * @ref ceiling_mutexes and @ref condvars subsystems.<br>
  * Tests on those subsystems are particularly critical because the system-wide
  * implications of the Priority Inheritance mechanism.
  *
@@ -35,6 +35,7 @@
  * The module requires the following kernel options:
  * - @p CH_USE_MUTEXES
  * - @p CH_USE_CONDVARS
+ * - @p CH_USE_CEILING_MUTEXES
  * - @p CH_DBG_THREADS_PROFILING
  * .
  * In case some of the required options are not enabled then some or all tests
@@ -49,6 +50,10 @@
  * - @subpage test_mtx_006
  * - @subpage test_mtx_007
  * - @subpage test_mtx_008
+ * - @subpage test_mtx_009
+ * - @subpage test_mtx_010
+ * - @subpage test_mtx_011
+ * - @subpage test_mtx_012
  * .
  * @file testmtx.c
  * @brief Mutexes and CondVars test source file
@@ -70,6 +75,10 @@ static MUTEX_DECL(m2);
 #if CH_USE_CONDVARS || defined(__DOXYGEN__)
 static CONDVAR_DECL(c1);
 #endif
+#if CH_USE_CEILING_MUTEXES || defined(__DOXYGEN__)
+static CEILINGMUTEX_DECL(cm1, HIGHPRIO);
+static CEILINGMUTEX_DECL(cm2, HIGHPRIO);
+#endif
 
 /**
  * @page test_mtx_001 Priority enqueuing test
@@ -610,7 +619,227 @@ ROMCONST struct testcase testmtx8 = {
   NULL,
   mtx8_execute
 };
+
+/**
+ * @page test_mtx_009 Condition Variable wait morphing test
+ *
+ * <h2>Description</h2>
+ * Five threads take a mutex and then enter a conditional variable queue, the
+ * tester thread broadcasts the conditional variable while owning the
+ * mutex.<br>
+ * The test expects the threads moved on the mutex queue without running,
+ * the tester thread boosted to the highest priority and then the threads to
+ * reach their goal in increasing priority order. The threads waiting with a
+ * timeout are expected to not time out while queued on the mutex.
+ */
+
+static void mtx9_setup(void) {
+
+  chCondInit(&c1);
+  chMtxInit(&m1);
+}
+
+static msg_t thread13(void *p) {
+  msg_t msg;
+
+  chMtxLock(&m1);
+#if CH_USE_CONDVARS_TIMEOUT || defined(__DOXYGEN__)
+  msg = chCondWaitTimeout(&c1, MS2ST(50));
+#else
+  msg = chCondWait(&c1);
+#endif
+  if (msg == RDY_RESET)
+    test_emit_token(*(char *)p);
+  chMtxUnlock();
+  return 0;
+}
+
+static void mtx9_execute(void) {
+  bool_t morphed = TRUE;
+  tprio_t bprio;
+  int i;
+
+  tprio_t prio = chThdGetPriority();
+  threads[0] = chThdCreateStatic(wa[0], WA_SIZE, prio+1, thread13, "E");
+  threads[1] = chThdCreateStatic(wa[1], WA_SIZE, prio+2, thread13, "D");
+  threads[2] = chThdCreateStatic(wa[2], WA_SIZE, prio+3, thread13, "C");
+  threads[3] = chThdCreateStatic(wa[3], WA_SIZE, prio+4, thread13, "B");
+  threads[4] = chThdCreateStatic(wa[4], WA_SIZE, prio+5, thread13, "A");
+  chMtxLock(&m1);
+  chCondBroadcast(&c1);
+  bprio = chThdGetPriority();
+  for (i = 0; i < MAX_THREADS; i++)
+    if (threads[i]->p_state != THD_STATE_WTMTX)
+      morphed = FALSE;
+  /* Holding the mutex beyond the threads timeout.*/
+  chThdSleepMilliseconds(100);
+  chMtxUnlock();
+  test_assert(1, morphed, "not moved on the mutex queue");
+  test_assert(2, bprio == prio + 5, "not boosted");
+  test_wait_threads();
+  test_assert_sequence(3, "ABCDE");
+}
+
+ROMCONST struct testcase testmtx9 = {
+  "CondVar, wait morphing test",
+  mtx9_setup,
+  NULL,
+  mtx9_execute
+};
 #endif /* CH_USE_CONDVARS */
+
+#if CH_USE_CEILING_MUTEXES || defined(__DOXYGEN__)
+/**
+ * @page test_mtx_010 Ceiling mutexes, priority raise test
+ *
+ * <h2>Description</h2>
+ * Two ceiling mutexes with different ceilings are locked and unlocked in
+ * both nesting orders, the priority of the tester thread is changed while
+ * owning a ceiling mutex.<br>
+ * The test expects the thread priority to be raised to the highest ceiling
+ * among the owned mutexes and to return to the thread own priority after
+ * the last unlock.
+ */
+
+static void mtx10_execute(void) {
+
+  tprio_t prio = chThdGetPriority();
+  chCMtxInit(&cm1, prio + 2);
+  chCMtxInit(&cm2, prio + 1);
+
+  chCMtxLock(&cm1);
+  test_assert(1, chThdGetPriority() == prio + 2, "not raised");
+  chCMtxLock(&cm2);
+  test_assert(2, chThdGetPriority() == prio + 2, "lowered by nested mutex");
+  test_assert(3, chCMtxUnlock() == &cm2, "wrong unlock order");
+  test_assert(4, chThdGetPriority() == prio + 2, "wrong priority level");
+  test_assert(5, chCMtxUnlock() == &cm1, "wrong unlock order");
+  test_assert(6, chThdGetPriority() == prio, "wrong priority level");
+
+  chCMtxLock(&cm2);
+  test_assert(7, chThdGetPriority() == prio + 1, "not raised");
+  chCMtxLock(&cm1);
+  test_assert(8, chThdGetPriority() == prio + 2, "not raised");
+  test_assert(9, chCMtxUnlock() == &cm1, "wrong unlock order");
+  test_assert(10, chThdGetPriority() == prio + 1, "wrong priority level");
+  test_assert(11, chCMtxUnlock() == &cm2, "wrong unlock order");
+  test_assert(12, chThdGetPriority() == prio, "wrong priority level");
+
+  chCMtxLock(&cm1);
+  chThdSetPriority(prio + 1);
+  test_assert(13, chThdGetPriority() == prio + 2, "lowered below ceiling");
+  chThdSetPriority(prio - 1);
+  test_assert(14, chThdGetPriority() == prio + 2, "lowered below ceiling");
+  chCMtxUnlock();
+  test_assert(15, chThdGetPriority() == prio - 1, "wrong priority level");
+  chThdSetPriority(prio);
+  test_assert(16, cm1.cm_owner == NULL, "still owned");
+}
+
+ROMCONST struct testcase testmtx10 = {
+  "Ceiling mutexes, priority raise test",
+  NULL,
+  NULL,
+  mtx10_execute
+};
+
+/**
+ * @page test_mtx_011 Ceiling mutexes, scheduling test
+ *
+ * <h2>Description</h2>
+ * The tester thread locks a ceiling mutex then creates a thread using the
+ * same mutex, with priority below the ceiling, and a thread with priority
+ * above the ceiling.<br>
+ * The test expects the thread above the ceiling to run immediately and
+ * the other thread to run only after the unlock, finding the mutex free.
+ */
+
+static msg_t thread14(void *p) {
+
+  chCMtxLock(&cm1);
+  test_emit_token(*(char *)p);
+  chCMtxUnlock();
+  return 0;
+}
+
+static msg_t thread15(void *p) {
+
+  test_emit_token(*(char *)p);
+  return 0;
+}
+
+static void mtx11_execute(void) {
+
+  tprio_t prio = chThdGetPriority();
+  chCMtxInit(&cm1, prio + 2);
+  chCMtxLock(&cm1);
+  threads[0] = chThdCreateStatic(wa[0], WA_SIZE, prio+1, thread14, "C");
+  threads[1] = chThdCreateStatic(wa[1], WA_SIZE, prio+3, thread15, "A");
+  test_emit_token('B');
+  chCMtxUnlock();
+  test_wait_threads();
+  test_assert_sequence(1, "ABC");
+  test_assert(2, chThdGetPriority() == prio, "wrong priority level");
+}
+
+ROMCONST struct testcase testmtx11 = {
+  "Ceiling mutexes, scheduling test",
+  NULL,
+  NULL,
+  mtx11_execute
+};
+
+/**
+ * @page test_mtx_012 Ceiling mutexes, priority inheritance interaction test
+ *
+ * <h2>Description</h2>
+ * The tester thread owns a ceiling mutex and a priority inheritance mutex,
+ * a thread with priority above the ceiling is enqueued on the priority
+ * inheritance mutex. The mutexes are released in both orders.<br>
+ * The test expects the inherited priority to be kept until the priority
+ * inheritance mutex is released and the ceiling to be kept until the
+ * ceiling mutex is released.
+ */
+
+static void mtx12_setup(void) {
+
+  chMtxInit(&m1);
+}
+
+static void mtx12_execute(void) {
+
+  tprio_t prio = chThdGetPriority();
+  chCMtxInit(&cm1, prio + 1);
+
+  chMtxLock(&m1);
+  chCMtxLock(&cm1);
+  threads[0] = chThdCreateStatic(wa[0], WA_SIZE, prio+2, thread1, "A");
+  test_assert(1, chThdGetPriority() == prio + 2, "not boosted");
+  chCMtxUnlock();
+  test_assert(2, chThdGetPriority() == prio + 2, "inherited priority lost");
+  chMtxUnlock();
+  test_assert(3, chThdGetPriority() == prio, "wrong priority level");
+  test_wait_threads();
+
+  chCMtxLock(&cm1);
+  chMtxLock(&m1);
+  threads[0] = chThdCreateStatic(wa[0], WA_SIZE, prio+2, thread1, "B");
+  test_assert(4, chThdGetPriority() == prio + 2, "not boosted");
+  chMtxUnlock();
+  test_assert(5, chThdGetPriority() == prio + 1, "ceiling lost");
+  chCMtxUnlock();
+  test_assert(6, chThdGetPriority() == prio, "wrong priority level");
+  test_wait_threads();
+  test_assert_sequence(7, "AB");
+}
+
+ROMCONST struct testcase testmtx12 = {
+  "Ceiling mutexes, priority inheritance interaction test",
+  mtx12_setup,
+  NULL,
+  mtx12_execute
+};
+#endif /* CH_USE_CEILING_MUTEXES */
 #endif /* CH_USE_MUTEXES */
 
 /**
@@ -629,6 +858,12 @@ ROMCONST struct testcase * ROMCONST patternmtx[] = {
   &testmtx6,
   &testmtx7,
   &testmtx8,
+  &testmtx9,
+#endif
+#if CH_USE_CEILING_MUTEXES || defined(__DOXYGEN__)
+  &testmtx10,
+  &testmtx11,
+  &testmtx12,
 #endif
 #endif
   NULL
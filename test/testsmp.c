@@ -0,0 +1,302 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include "ch.h"
+#include "test.h"
+
+/**
+ * @page test_smp SMP test
+ *
+ * File: @ref testsmp.c
+ *
+ * <h2>Description</h2>
+ * This module implements the test sequence for the symmetric
+ * multiprocessing mode of the scheduler.
+ *
+ * <h2>Objective</h2>
+ * Objective of the test module is to verify the threads placement on the
+ * cores, the parallel execution, the wakeup of threads running on other
+ * cores and the work stealing performed by the cores becoming idle.
+ *
+ * <h2>Preconditions</h2>
+ * The module requires the following kernel options:
+ * - @p CH_USE_SMP
+ * - @p CH_USE_SEMAPHORES (and dependent options)
+ * .
+ * The port must export at least two cores, in case some of the required
+ * options are not enabled then some or all tests may be skipped.
+ *
+ * <h2>Test Cases</h2>
+ * - @subpage test_smp_001
+ * - @subpage test_smp_002
+ * - @subpage test_smp_003
+ * - @subpage test_smp_004
+ * .
+ * @file testsmp.c
+ * @brief SMP test source file
+ * @file testsmp.h
+ * @brief SMP test header file
+ */
+
+#if (CH_USE_SMP && (PORT_CORES_NUMBER > 1)) || defined(__DOXYGEN__)
+
+/*
+ * Number of cores used by the tests, the test threads are limited.
+ */
+#define SMP_CORES (PORT_CORES_NUMBER < MAX_THREADS ?                        \
+                   PORT_CORES_NUMBER : MAX_THREADS)
+
+static unsigned cores[MAX_THREADS];
+static volatile unsigned count;
+static volatile bool_t release;
+
+/*
+ * Creates a thread allowed on the specified cores.
+ */
+static Thread *create_on(coremask_t mask, void *wsp, tprio_t prio,
+                         tfunc_t pf, void *arg) {
+  Thread *tp;
+
+  chSysLock();
+  tp = chThdCreateI(wsp, WA_SIZE, prio, pf, arg);
+  tp->p_affinity = mask;
+  chSchWakeupS(tp, RDY_OK);
+  chSysUnlock();
+  return tp;
+}
+
+/**
+ * @page test_smp_001 Threads affinity
+ *
+ * <h2>Description</h2>
+ * A thread is started on each core using the affinity mask, each thread
+ * records the core it runs on. A last thread starts on the core zero,
+ * inheriting the affinity of the creator, and moves itself to the last core
+ * by changing its affinity mask.<br>
+ * The test expects each thread to run on its core.
+ */
+
+static msg_t thread1(void *p) {
+  unsigned i = (unsigned)(uintptr_t)p;
+
+  cores[i] = chSysGetCoreId();
+  return 0;
+}
+
+static msg_t thread2(void *p) {
+  unsigned i = (unsigned)(uintptr_t)p;
+
+  (void)chThdSetAffinity(CH_CORE_MASK(SMP_CORES - 1));
+  cores[i] = chSysGetCoreId();
+  return 0;
+}
+
+static void smp1_execute(void) {
+  unsigned i;
+
+  for (i = 0; i < SMP_CORES; i++)
+    threads[i] = create_on(CH_CORE_MASK(i), wa[i], chThdGetPriority() - 1,
+                           thread1, (void *)(uintptr_t)i);
+  test_wait_threads();
+  for (i = 0; i < SMP_CORES; i++)
+    test_assert(1, cores[i] == i, "wrong core");
+
+  threads[0] = chThdCreateStatic(wa[0], WA_SIZE, chThdGetPriority() - 1,
+                                 thread2, (void *)(uintptr_t)0);
+  test_wait_threads();
+  test_assert(2, cores[0] == SMP_CORES - 1, "not moved");
+  test_assert(3, chSysGetCoreId() == 0, "main thread moved");
+}
+
+ROMCONST struct testcase testsmp1 = {
+  "SMP, threads affinity",
+  NULL,
+  NULL,
+  smp1_execute
+};
+
+/**
+ * @page test_smp_002 Parallel execution
+ *
+ * <h2>Description</h2>
+ * A thread is started on each core but the core zero, each thread
+ * increments a counter then waits, without blocking, for the counter to
+ * reach the number of threads.<br>
+ * The test expects all the threads to see the final counter value, this
+ * is only possible if they are running at the same time.
+ */
+
+static msg_t thread3(void *p) {
+  unsigned i = (unsigned)(uintptr_t)p;
+  systime_t time = chTimeNow();
+
+  chSysLock();
+  count++;
+  chSysUnlock();
+  while ((count < SMP_CORES - 1) &&
+         chTimeIsWithin(time, time + MS2ST(1000)))
+    chThdYield();
+  cores[i] = count;
+  return 0;
+}
+
+static void smp2_setup(void) {
+
+  count = 0;
+}
+
+static void smp2_execute(void) {
+  unsigned i;
+
+  for (i = 1; i < SMP_CORES; i++)
+    threads[i] = create_on(CH_CORE_MASK(i), wa[i], chThdGetPriority() - 1,
+                           thread3, (void *)(uintptr_t)i);
+  test_wait_threads();
+  for (i = 1; i < SMP_CORES; i++)
+    test_assert(1, cores[i] == SMP_CORES - 1, "not parallel");
+}
+
+ROMCONST struct testcase testsmp2 = {
+  "SMP, parallel execution",
+  smp2_setup,
+  NULL,
+  smp2_execute
+};
+
+#if CH_USE_SEMAPHORES || defined(__DOXYGEN__)
+/**
+ * @page test_smp_003 Wakeup on another core
+ *
+ * <h2>Description</h2>
+ * A thread with higher priority than the main thread is started on the
+ * core one and waits on a semaphore, the main thread signals the semaphore
+ * from the core zero.<br>
+ * The test expects the thread to run on the core one while the main thread
+ * stays on the core zero.
+ */
+
+static Semaphore sem1;
+
+static msg_t thread4(void *p) {
+
+  (void)p;
+  chSemWait(&sem1);
+  cores[0] = chSysGetCoreId();
+  return 0;
+}
+
+static void smp3_setup(void) {
+
+  chSemInit(&sem1, 0);
+}
+
+static void smp3_execute(void) {
+
+  threads[0] = create_on(CH_CORE_MASK(1), wa[0], chThdGetPriority() + 1,
+                         thread4, NULL);
+  /* Waiting for the thread to block.*/
+  while (threads[0]->p_state != THD_STATE_WTSEM)
+    chThdYield();
+  cores[0] = PORT_CORES_NUMBER;
+  chSemSignal(&sem1);
+  test_assert(1, chSysGetCoreId() == 0, "main thread moved");
+  test_wait_threads();
+  test_assert(2, cores[0] == 1, "wrong core");
+}
+
+ROMCONST struct testcase testsmp3 = {
+  "SMP, wakeup on another core",
+  smp3_setup,
+  NULL,
+  smp3_execute
+};
+#endif /* CH_USE_SEMAPHORES */
+
+/**
+ * @page test_smp_004 Work stealing
+ *
+ * <h2>Description</h2>
+ * A thread with higher priority than the main thread occupies the core one
+ * then a thread allowed on the cores zero and one is created with lower
+ * priority than the main thread, the thread is queued on the core zero.
+ * The thread on the core one is terminated while the main thread keeps the
+ * core zero busy.<br>
+ * The test expects the core one, becoming idle, to take the queued thread.
+ */
+
+static msg_t thread5(void *p) {
+
+  (void)p;
+  while (!release)
+    chThdYield();
+  return 0;
+}
+
+static msg_t thread6(void *p) {
+
+  (void)p;
+  cores[0] = chSysGetCoreId();
+  count = 1;
+  return 0;
+}
+
+static void smp4_setup(void) {
+
+  count = 0;
+  release = FALSE;
+}
+
+static void smp4_execute(void) {
+  systime_t time;
+
+  threads[1] = create_on(CH_CORE_MASK(1), wa[1], chThdGetPriority() + 1,
+                         thread5, NULL);
+  threads[0] = create_on(CH_CORE_MASK(0) | CH_CORE_MASK(1), wa[0],
+                         chThdGetPriority() - 1, thread6, NULL);
+  test_assert(1, threads[0]->p_state == THD_STATE_READY, "not queued");
+  test_assert(2, threads[0]->p_core == 0, "wrong core");
+
+  /* Releasing the core one while the core zero is kept busy.*/
+  release = TRUE;
+  time = chTimeNow();
+  while ((count == 0) && chTimeIsWithin(time, time + MS2ST(1000)))
+    chThdYield();
+  test_assert(3, count == 1, "not executed");
+  test_assert(4, cores[0] == 1, "not stolen");
+}
+
+ROMCONST struct testcase testsmp4 = {
+  "SMP, work stealing",
+  smp4_setup,
+  NULL,
+  smp4_execute
+};
+#endif /* CH_USE_SMP && (PORT_CORES_NUMBER > 1) */
+
+/**
+ * @brief   Test sequence for SMP.
+ */
+ROMCONST struct testcase * ROMCONST patternsmp[] = {
+#if (CH_USE_SMP && (PORT_CORES_NUMBER > 1)) || defined(__DOXYGEN__)
+  &testsmp1,
+  &testsmp2,
+#if CH_USE_SEMAPHORES || defined(__DOXYGEN__)
+  &testsmp3,
+#endif
+  &testsmp4,
+#endif
+  NULL
+};
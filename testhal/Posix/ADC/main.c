@@ -0,0 +1,352 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <time.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "console.h"
+#include "adc_stream.h"
+
+#define MAX_CHANNELS        4
+#define MAX_DEPTH           512
+#define BENCH_TIME          500000
+
+static BaseSequentialStream *chp = (BaseSequentialStream *)&CD1;
+static bool_t failed;
+
+static adcsample_t buffer[MAX_DEPTH * MAX_CHANNELS];
+static adcsample_t blocks[ADC_STREAM_MAX_BLOCKS * MAX_DEPTH / 2 *
+                          MAX_CHANNELS];
+static ADCStream stream;
+
+/*
+ * One half buffer per interrupt, 10K, 100K and 1M conversions per second.
+ */
+static const ADCConfig cfg_fast = {0};
+static const ADCConfig cfg_10k = {10000};
+static const ADCConfig cfg_100k = {100000};
+static const ADCConfig cfg_1m = {1000000};
+
+/*
+ * A ramp going through all the values and a constant channel.
+ */
+static const ADCSimChannel ramp_channels[2] = {
+  {ADC_SIM_SAWTOOTH, 2048, 2048, 4096},
+  {ADC_SIM_DC, 1000, 0, 0}
+};
+static const ADCConversionGroup ramp_grp = {
+  TRUE, 2, NULL, NULL, ramp_channels
+};
+
+/*
+ * Periodic waveforms with a 64 conversions period and noise.
+ */
+static const ADCSimChannel wave_channels[4] = {
+  {ADC_SIM_SINE, 2048, 2000, 64},
+  {ADC_SIM_SQUARE, 2048, 1000, 64},
+  {ADC_SIM_TRIANGLE, 2048, 1024, 64},
+  {ADC_SIM_NOISE, 2048, 100, 0}
+};
+static const ADCConversionGroup wave_grp = {
+  TRUE, 4, NULL, NULL, wave_channels
+};
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Prints a ratio with two decimals.
+ */
+static void print_ratio(const char *label, uint64_t num, uint64_t den,
+                        const char *unit) {
+  uint64_t r = den ? (num * 100) / den : 0;
+
+  chprintf(chp, "%s%u.%02u%s", label, (unsigned)(r / 100),
+           (unsigned)(r % 100), unit);
+}
+
+static void check(bool_t cond, const char *msg) {
+
+  if (!cond) {
+    chprintf(chp, "--- failed: %s\r\n", msg);
+    failed = TRUE;
+  }
+}
+
+static void set_cfg(ADCStreamConfig *cfgp, const ADCConversionGroup *grpp,
+                    size_t depth, unsigned decimation, adcskernel_t kernel,
+                    size_t nblocks) {
+
+  cfgp->grpp       = grpp;
+  cfgp->buffer     = buffer;
+  cfgp->depth      = depth;
+  cfgp->decimation = decimation;
+  cfgp->kernel     = kernel;
+  cfgp->samples    = blocks;
+  cfgp->nblocks    = nblocks;
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+/*
+ * The ramp must be continuous across blocks, no block is lost when the
+ * consumer keeps up.
+ */
+static void continuity(void) {
+  ADCStreamConfig cfg;
+  ADCStreamBlock *blkp;
+  ADCStreamStats stats;
+  unsigned i, j;
+  bool_t ok = TRUE;
+
+  set_cfg(&cfg, &ramp_grp, 64, 1, ADCS_KERNEL_DECIMATE, 4);
+  adcStart(&ADCD1, &cfg_fast);
+  adcsStart(&stream, &ADCD1, &cfg);
+  for (i = 0; i < 300; i++) {
+    blkp = adcsGetBlock(&stream, MS2ST(100));
+    if (blkp == NULL) {
+      check(FALSE, "block timeout");
+      break;
+    }
+    ok = ok && (blkp->seq == i) && (blkp->n == 32);
+    for (j = 0; j < blkp->n; j++) {
+      ok = ok && (blkp->samples[j * 2] == ((i * 32 + j) & 4095));
+      ok = ok && (blkp->samples[j * 2 + 1] == 1000);
+    }
+    adcsReleaseBlock(&stream, blkp);
+  }
+  adcsStop(&stream);
+  adcsGetStats(&stream, &stats);
+  check(ok, "ramp continuity");
+  check(stats.overruns == 0, "overruns");
+  check(stats.blocks >= 300, "delivered blocks");
+  check(ADCD1.state == ADC_READY, "driver state");
+
+  chprintf(chp, "--- Continuity: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+/*
+ * Decimation and averaging by four of the ramp.
+ */
+static void kernels(void) {
+  static const adcskernel_t kernel[2] = {ADCS_KERNEL_DECIMATE,
+                                         ADCS_KERNEL_AVERAGE};
+  ADCStreamConfig cfg;
+  ADCStreamBlock *blkp;
+  unsigned i, k, j, base;
+  bool_t ok = TRUE;
+
+  for (k = 0; k < 2; k++) {
+    set_cfg(&cfg, &ramp_grp, 64, 4, kernel[k], 4);
+    adcsStart(&stream, &ADCD1, &cfg);
+    for (i = 0; i < 200; i++) {
+      blkp = adcsGetBlock(&stream, MS2ST(100));
+      if (blkp == NULL) {
+        check(FALSE, "block timeout");
+        break;
+      }
+      ok = ok && (blkp->n == 8);
+      base = blkp->seq * 32;
+      for (j = 0; j < blkp->n; j++) {
+        ok = ok && (blkp->samples[j * 2] ==
+                    ((base + j * 4 + (k == 0 ? 0 : 2)) & 4095));
+        ok = ok && (blkp->samples[j * 2 + 1] == 1000);
+      }
+      adcsReleaseBlock(&stream, blkp);
+    }
+    adcsStop(&stream);
+  }
+  check(ok, "reduced samples");
+
+  chprintf(chp, "--- Kernels: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+/*
+ * Waveforms values at known phases.
+ */
+static void waveforms(void) {
+  ADCStreamConfig cfg;
+  ADCStreamBlock *blkp;
+  adcsample_t *p;
+  unsigned j;
+
+  set_cfg(&cfg, &wave_grp, 128, 1, ADCS_KERNEL_DECIMATE, 2);
+  adcsStart(&stream, &ADCD1, &cfg);
+  blkp = adcsGetBlock(&stream, MS2ST(100));
+  check(blkp != NULL, "block");
+  if (blkp != NULL) {
+    p = blkp->samples;
+    check((p[0 * 4] == 2048) && (p[16 * 4] == 4048) &&
+          (p[32 * 4] == 2048) && (p[48 * 4] == 48), "sine");
+    check((p[0 * 4 + 1] == 3048) && (p[32 * 4 + 1] == 1048), "square");
+    check((p[0 * 4 + 2] == 1024) && (p[32 * 4 + 2] == 3072) &&
+          (p[16 * 4 + 2] == 2048), "triangle");
+    for (j = 0; j < blkp->n; j++)
+      check((p[j * 4 + 3] >= 1948) && (p[j * 4 + 3] <= 2148), "noise");
+    adcsReleaseBlock(&stream, blkp);
+  }
+  adcsStop(&stream);
+
+  chprintf(chp, "--- Waveforms: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+/*
+ * The consumer holds all the blocks, the half buffers are dropped and
+ * the sequence numbers skip the dropped blocks.
+ */
+static void overrun(void) {
+  ADCStreamConfig cfg;
+  ADCStreamBlock *held[3], *blkp;
+  ADCStreamStats stats;
+  unsigned i;
+
+  set_cfg(&cfg, &ramp_grp, 64, 1, ADCS_KERNEL_DECIMATE, 3);
+  adcsStart(&stream, &ADCD1, &cfg);
+  for (i = 0; i < 3; i++) {
+    held[i] = adcsGetBlock(&stream, MS2ST(100));
+    check(held[i] != NULL, "held block");
+  }
+  chThdSleepMilliseconds(20);
+  adcsGetStats(&stream, &stats);
+  check(stats.overruns > 0, "overruns counted");
+  check(stats.max_used == 3, "blocks in use");
+  check(adcsGetBlock(&stream, TIME_IMMEDIATE) == NULL, "no block");
+  for (i = 0; i < 3; i++)
+    if (held[i] != NULL)
+      adcsReleaseBlock(&stream, held[i]);
+  blkp = adcsGetBlock(&stream, MS2ST(100));
+  adcsGetStats(&stream, &stats);
+  check((blkp != NULL) && (blkp->seq == 3 + stats.overruns),
+        "sequence gap");
+  check((blkp != NULL) && (blkp->samples[0] == ((blkp->seq * 32) & 4095)),
+        "samples after the gap");
+  if (blkp != NULL)
+    adcsReleaseBlock(&stream, blkp);
+  adcsStop(&stream);
+
+  chprintf(chp, "--- Overrun: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+/*
+ * An ADC error stops the stream, the consumer is released.
+ */
+static void error(void) {
+  ADCStreamConfig cfg;
+  ADCStreamBlock *blkp;
+  unsigned n = 0;
+
+  set_cfg(&cfg, &ramp_grp, 64, 1, ADCS_KERNEL_DECIMATE, 4);
+  adcsStart(&stream, &ADCD1, &cfg);
+  blkp = adcsGetBlock(&stream, MS2ST(100));
+  check(blkp != NULL, "first block");
+  chSysLock();
+  adcSimErrorI(&ADCD1, ADC_ERR_OVERFLOW);
+  chSysUnlock();
+  if (blkp != NULL)
+    adcsReleaseBlock(&stream, blkp);
+  while ((blkp = adcsGetBlock(&stream, MS2ST(100))) != NULL) {
+    adcsReleaseBlock(&stream, blkp);
+    n++;
+  }
+  check(n < 4, "blocks after the error");
+  check(stream.state == ADCS_ERROR, "stream state");
+  check(stream.error == ADC_ERR_OVERFLOW, "error code");
+  check(ADCD1.state == ADC_READY, "driver state");
+  check(adcsGetBlock(&stream, TIME_INFINITE) == NULL, "stopped stream");
+  adcsStop(&stream);
+
+  chprintf(chp, "--- Error: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+/*
+ * Sustained rate, the consumer adds up the samples of each block.
+ */
+static void benchmark(const ADCConfig *config, const char *name,
+                      unsigned decimation, adcskernel_t kernel) {
+  ADCStreamConfig cfg;
+  ADCStreamBlock *blkp;
+  ADCStreamStats stats;
+  uint64_t start, elapsed = 0;
+  uint32_t sum = 0;
+  size_t i;
+
+  adcStart(&ADCD1, config);
+  set_cfg(&cfg, &wave_grp, MAX_DEPTH, decimation, kernel,
+          ADC_STREAM_MAX_BLOCKS);
+  start = now_us();
+  adcsStart(&stream, &ADCD1, &cfg);
+  do {
+    blkp = adcsGetBlock(&stream, MS2ST(100));
+    if (blkp == NULL) {
+      check(FALSE, "block timeout");
+      break;
+    }
+    for (i = 0; i < blkp->n * MAX_CHANNELS; i++)
+      sum += blkp->samples[i];
+    adcsReleaseBlock(&stream, blkp);
+    elapsed = now_us() - start;
+  } while (elapsed < BENCH_TIME);
+  adcsStop(&stream);
+  adcsGetStats(&stream, &stats);
+  (void)sum;
+
+  chprintf(chp, "--- Benchmark %s, decimation %u\r\n", name, decimation);
+  chprintf(chp, "    blocks            : %u\r\n", stats.blocks);
+  chprintf(chp, "    overruns          : %u\r\n", stats.overruns);
+  chprintf(chp, "    max blocks used   : %u\r\n", stats.max_used);
+  print_ratio("    effective rate    : ",
+              (uint64_t)stats.blocks * (MAX_DEPTH / 2) * 1000000, elapsed,
+              " conversions/S\r\n");
+}
+
+/*
+ * Application entry point.
+ */
+int main(void) {
+
+  halInit();
+  chSysInit();
+  conInit();
+  adcsObjectInit(&stream);
+
+  chprintf(chp, "*** ADC streaming, simulated converter\r\n");
+  continuity();
+  kernels();
+  waveforms();
+  overrun();
+  error();
+  benchmark(&cfg_10k, "at 10K conversions/S", 1, ADCS_KERNEL_DECIMATE);
+  benchmark(&cfg_100k, "at 100K conversions/S", 1, ADCS_KERNEL_DECIMATE);
+  benchmark(&cfg_1m, "at 1M conversions/S", 1, ADCS_KERNEL_DECIMATE);
+  benchmark(&cfg_1m, "at 1M conversions/S", 8, ADCS_KERNEL_AVERAGE);
+  benchmark(&cfg_fast, "unlimited rate", 1, ADCS_KERNEL_DECIMATE);
+  adcStop(&ADCD1);
+
+  chprintf(chp, "\r\nFinal result: %s\r\n", failed ? "FAILURE" : "SUCCESS");
+  return failed ? 1 : 0;
+}
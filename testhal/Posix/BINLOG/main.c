@@ -0,0 +1,376 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "binlog.h"
+#include "console.h"
+
+#define ITERATIONS          200000
+#define BURST               1000
+#define CAPTURE_SIZE        (256 * 1024)
+#define CAPTURE_FILE        "binlog.bin"
+
+static BaseSequentialStream *chp = (BaseSequentialStream *)&CD1;
+static bool_t failed;
+
+static BinLog blog;
+static uint32_t ring[65536 / sizeof (uint32_t)];
+
+/*===========================================================================*/
+/* Streams.                                                                  */
+/*===========================================================================*/
+
+/*
+ * Bytes and calls received by the streams.
+ */
+static uint64_t out_bytes;
+static uint32_t out_calls;
+
+static size_t null_write(void *ip, const uint8_t *bp, size_t n) {
+
+  (void)ip;
+  (void)bp;
+  out_bytes += n;
+  out_calls++;
+  return n;
+}
+
+static size_t null_read(void *ip, uint8_t *bp, size_t n) {
+
+  (void)ip;
+  (void)bp;
+  (void)n;
+  return 0;
+}
+
+static msg_t null_put(void *ip, uint8_t b) {
+
+  (void)ip;
+  (void)b;
+  out_bytes++;
+  out_calls++;
+  return RDY_OK;
+}
+
+static msg_t null_get(void *ip) {
+
+  (void)ip;
+  return Q_RESET;
+}
+
+static const struct BaseSequentialStreamVMT null_vmt = {
+  null_write, null_read, null_put, null_get
+};
+
+static BaseSequentialStream null_stream = {&null_vmt};
+
+/*
+ * Capture stream, the output is kept in memory for decoding and also
+ * written to a file for the host tool.
+ */
+static uint8_t capture[CAPTURE_SIZE];
+static size_t capture_n;
+static FILE *capture_file;
+
+static size_t capture_write(void *ip, const uint8_t *bp, size_t n) {
+
+  (void)ip;
+  if (n > CAPTURE_SIZE - capture_n)
+    n = CAPTURE_SIZE - capture_n;
+  memcpy(&capture[capture_n], bp, n);
+  capture_n += n;
+  if (capture_file != NULL)
+    fwrite(bp, 1, n, capture_file);
+  return n;
+}
+
+static msg_t capture_put(void *ip, uint8_t b) {
+
+  return capture_write(ip, &b, 1) == 1 ? RDY_OK : RDY_RESET;
+}
+
+static const struct BaseSequentialStreamVMT capture_vmt = {
+  capture_write, null_read, capture_put, null_get
+};
+
+static BaseSequentialStream capture_stream = {&capture_vmt};
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Prints a ratio with two decimals.
+ */
+static void print_ratio(const char *label, uint64_t num, uint64_t den,
+                        const char *unit) {
+  uint64_t r = den ? (num * 100) / den : 0;
+
+  chprintf(chp, "%s%u.%02u%s", label, (unsigned)(r / 100),
+           (unsigned)(r % 100), unit);
+}
+
+static void check(bool_t cond, const char *msg) {
+
+  if (!cond) {
+    chprintf(chp, "--- failed: %s\r\n", msg);
+    failed = TRUE;
+  }
+}
+
+/*
+ * Decodes the next captured frame, same as the host tool.
+ */
+static size_t capture_pos;
+
+static int next_frame(uint32_t *vp, unsigned max) {
+  uint8_t raw[BINLOG_FRAME_MAX];
+  size_t i = 0, end;
+  unsigned n = 0, shift = 0;
+  uint32_t v = 0;
+
+  if (capture_pos >= capture_n)
+    return -1;
+  for (end = capture_pos; (end < capture_n) && capture[end]; end++)
+    ;
+  while (capture_pos < end) {
+    uint8_t code = capture[capture_pos++];
+
+    while ((--code > 0) && (capture_pos < end) && (i < sizeof raw))
+      raw[i++] = capture[capture_pos++];
+    if ((capture_pos < end) && (i < sizeof raw))
+      raw[i++] = 0;
+  }
+  capture_pos = end + 1;
+
+  for (end = 0; end < i; end++) {
+    v |= (uint32_t)(raw[end] & 0x7F) << shift;
+    shift += 7;
+    if (raw[end] < 0x80) {
+      if (n < max)
+        vp[n++] = v;
+      v = 0;
+      shift = 0;
+    }
+  }
+  return (int)n;
+}
+
+static void start_log(BaseSequentialStream *sp, size_t size, size_t reserve,
+                      systime_t period) {
+  static BinLogConfig config;
+
+  config.stream = sp;
+  config.buffer = ring;
+  config.size = size;
+  config.reserve = reserve;
+  config.period = period;
+  config.prio = NORMALPRIO - 1;
+  blStart(&blog, &config);
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+/*
+ * Records round trip, the capture is decoded and compared.
+ */
+static void roundtrip(void) {
+  BinLogStats stats;
+  uint32_t vals[BINLOG_MAX_ARGS + 2], id = 0, time = 0;
+  unsigned i;
+  int n;
+
+  capture_n = 0;
+  capture_pos = 0;
+  capture_file = fopen(CAPTURE_FILE, "wb");
+  start_log(&capture_stream, 4096, 512, MS2ST(10));
+  chThdSleepMilliseconds(1);
+
+  for (i = 0; i < 100; i++) {
+    blLog(&blog, BINLOG_LEVEL_INFO, "sample %u value %d ratio %1.3k\r\n",
+          i, -(int)i, (int32_t)(i << 14));
+    if ((i % 16) == 15)
+      chThdSleepMilliseconds(1);
+  }
+  blLog(&blog, BINLOG_LEVEL_WARNING, "no arguments\r\n");
+  blLog(&blog, BINLOG_LEVEL_ERROR, "eight %u %u %u %u %u %u %u %.8X\r\n",
+        1, 2, 3, 4, 5, 6, 7, 0xDEADBEEF);
+  blSetLevel(&blog, BINLOG_LEVEL_INFO);
+  blLog(&blog, BINLOG_LEVEL_DEBUG, "filtered %u\r\n", 0);
+  blSetLevel(&blog, BINLOG_LEVEL_DEBUG);
+  blLog(&blog, BINLOG_LEVEL_DEBUG, "debug %c%c\r\n", 'o', 'k');
+  blStop(&blog);
+  blGetStats(&blog, &stats);
+  fclose(capture_file);
+  capture_file = NULL;
+
+  check(stats.records == 103, "records count");
+  check(stats.bytes == capture_n, "bytes count");
+
+  n = next_frame(vals, 4);
+  check((n == 4) && (vals[0] == BINLOG_ID_START) &&
+        (vals[2] == BINLOG_VERSION) &&
+        (vals[3] == BINLOG_TIMESTAMP_FREQUENCY), "start record");
+  for (i = 0; i < 100; i++) {
+    n = next_frame(vals, 8);
+    if (i == 0)
+      id = vals[0];
+    check((n == 5) && (vals[0] == id) && (id >= BINLOG_ID_FIRST) &&
+          (vals[2] == i) && (vals[3] == (uint32_t)-(int)i) &&
+          (vals[4] == (i << 14)), "record contents");
+    time += vals[1];
+  }
+  n = next_frame(vals, 8);
+  check((n == 2) && (vals[0] != id), "record without arguments");
+  n = next_frame(vals, BINLOG_MAX_ARGS + 2);
+  check((n == 10) && (vals[9] == 0xDEADBEEF), "record with 8 arguments");
+  n = next_frame(vals, 8);
+  check((n == 4) && (vals[2] == 'o') && (vals[3] == 'k'), "level filter");
+  check(next_frame(vals, 8) < 0, "stream end");
+  check(time > 0, "timestamps");
+
+  chprintf(chp, "--- Round trip, %u records, %u bytes: %s\r\n",
+           stats.records, stats.bytes, failed ? "FAILED" : "ok");
+  chprintf(chp, "    expand with: tools/binlog/binlog.py %s.blt %s\r\n",
+           "ch", CAPTURE_FILE);
+}
+
+/*
+ * Ring full, the low levels are dropped first and the drops reported.
+ */
+static void drops(void) {
+  BinLogStats stats;
+  uint32_t vals[8];
+  unsigned i, records = 0;
+  int n;
+
+  capture_n = 0;
+  capture_pos = 0;
+  start_log(&capture_stream, 256, 64, TIME_INFINITE);
+  chThdSleepMilliseconds(1);
+
+  /* The drain thread does not run until this thread sleeps.*/
+  for (i = 0; i < 100; i++)
+    blLog(&blog, BINLOG_LEVEL_INFO, "fill %u %u\r\n", i, i);
+  for (i = 0; i < 4; i++)
+    blLog(&blog, BINLOG_LEVEL_WARNING, "warning %u %u\r\n", i, i);
+  blGetStats(&blog, &stats);
+  check(stats.dropped[BINLOG_LEVEL_INFO] == 100 - (256 - 64) / 16,
+        "low level drops");
+  check(stats.dropped[BINLOG_LEVEL_WARNING] == 0, "reserve");
+  check(stats.high_water == 256, "high water");
+  chThdSleepMilliseconds(1);
+  blStop(&blog);
+
+  next_frame(vals, 8);
+  while ((n = next_frame(vals, 8)) >= 0) {
+    if (vals[0] != BINLOG_ID_DROPPED)
+      records++;
+    else
+      check((n == 6) && (vals[2] == 0) &&
+            (vals[3] == stats.dropped[BINLOG_LEVEL_INFO]) &&
+            (vals[4] == 0) && (vals[5] == 0), "drops notice");
+  }
+  check(records == stats.records, "records after drops");
+
+  chprintf(chp, "--- Drops, %u recorded, %u dropped: %s\r\n",
+           stats.records, stats.dropped[BINLOG_LEVEL_INFO],
+           failed ? "FAILED" : "ok");
+}
+
+/*
+ * Per call cost against chprintf().
+ */
+#define RECORD_FMT  "adc ch=%u raw=%5d avg=%-6d flags=%.8X\r\n"
+#define RECORD_ARGS(i)                                                      \
+  (unsigned)((i) & 7), (int)((i) * 37 % 4096) - 2048,                       \
+  (int)((i) % 1000), 0xA5000000U | (i)
+
+static void benchmark(void) {
+  static char buf[128];
+  BinLogStats stats;
+  uint64_t start, t1 = 0, t2, t3, text;
+  uint32_t i, j;
+
+  start_log(&null_stream, sizeof ring, 0, MS2ST(10));
+  out_bytes = 0;
+  for (i = 0; i < ITERATIONS; i += BURST) {
+    start = now_ns();
+    for (j = i; j < i + BURST; j++)
+      blLog(&blog, BINLOG_LEVEL_INFO, RECORD_FMT, RECORD_ARGS(j));
+    t1 += now_ns() - start;
+    /* The drain thread runs while this thread sleeps.*/
+    chThdSleepMilliseconds(1);
+  }
+  blStop(&blog);
+  blGetStats(&blog, &stats);
+
+  out_bytes = 0;
+  start = now_ns();
+  for (i = 0; i < ITERATIONS; i++)
+    chprintf(&null_stream, RECORD_FMT, RECORD_ARGS(i));
+  t2 = now_ns() - start;
+  text = out_bytes;
+
+  start = now_ns();
+  for (i = 0; i < ITERATIONS; i++)
+    (void)chsnprintf(buf, sizeof buf, RECORD_FMT, RECORD_ARGS(i));
+  t3 = now_ns() - start;
+
+  chprintf(chp, "--- Benchmark, %u records of 4 arguments\r\n", ITERATIONS);
+  print_ratio("    blLog()           : ", t1, ITERATIONS, " nS/call");
+  print_ratio(", ", stats.bytes, stats.records, " bytes/record\r\n");
+  print_ratio("    chprintf()        : ", t2, ITERATIONS, " nS/call");
+  print_ratio(", ", text, ITERATIONS, " bytes/record\r\n");
+  print_ratio("    chsnprintf()      : ", t3, ITERATIONS, " nS/call\r\n");
+  print_ratio("    speedup           : ", t2, t1, "\r\n");
+  check((stats.records == ITERATIONS) &&
+        (stats.dropped[BINLOG_LEVEL_INFO] == 0), "benchmark drops");
+}
+
+/*
+ * Application entry point.
+ */
+int main(void) {
+
+  halInit();
+  chSysInit();
+  conInit();
+  blObjectInit(&blog);
+
+  chprintf(chp, "*** Binary log, %u bytes ring\r\n", (unsigned)sizeof ring);
+  roundtrip();
+  drops();
+  benchmark();
+
+  chprintf(chp, "\r\nFinal result: %s\r\n", failed ? "FAILURE" : "SUCCESS");
+  return failed ? 1 : 0;
+}
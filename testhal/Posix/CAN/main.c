@@ -0,0 +1,328 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <string.h>
+#include <time.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "console.h"
+
+#define LOAD_FRAMES         4000
+#define LOAD_BURST          8
+#define LOAD_ID             0x010
+#define GENERATOR_ID        0x7FF
+
+static BaseSequentialStream *chp = (BaseSequentialStream *)&CD1;
+static bool_t failed;
+
+/*
+ * Unlimited bus speed, 125Kb/S and 500Kb/S.
+ */
+static const CANConfig cfg_fast = {0};
+static const CANConfig cfg_125k = {125000};
+static const CANConfig cfg_500k = {500000};
+
+/*
+ * Frames of this test only, the bus load generator frames are discarded by
+ * the filters.
+ */
+static const CANIdFilter test_filters[] = {
+  {0x000, 0x400, CAN_IDE_STD},
+  {0x00000000, 0x1FF00000, CAN_IDE_EXT}
+};
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Prints a ratio with two decimals.
+ */
+static void print_ratio(const char *label, uint64_t num, uint64_t den,
+                        const char *unit) {
+  uint64_t r = den ? (num * 100) / den : 0;
+
+  chprintf(chp, "%s%u.%02u%s", label, (unsigned)(r / 100),
+           (unsigned)(r % 100), unit);
+}
+
+static void check(bool_t cond, const char *msg) {
+
+  if (!cond) {
+    chprintf(chp, "--- failed: %s\r\n", msg);
+    failed = TRUE;
+  }
+}
+
+static void set_std(CANTxFrame *ctfp, uint32_t id, uint8_t tag) {
+
+  memset(ctfp, 0, sizeof (*ctfp));
+  ctfp->IDE = CAN_IDE_STD;
+  ctfp->SID = id;
+  ctfp->DLC = 1;
+  ctfp->data8[0] = tag;
+}
+
+static void set_ext(CANTxFrame *ctfp, uint32_t id, uint8_t tag) {
+
+  memset(ctfp, 0, sizeof (*ctfp));
+  ctfp->IDE = CAN_IDE_EXT;
+  ctfp->EID = id;
+  ctfp->DLC = 1;
+  ctfp->data8[0] = tag;
+}
+
+/*
+ * Receives up to n frames, stops at the first timeout.
+ */
+static size_t receive_all(CANRxFrame *crfp, size_t n) {
+  size_t i = 0, got;
+
+  while (i < n) {
+    got = canReceiveBatch(&CAND2, &crfp[i], n - i, MS2ST(100));
+    if (got == 0)
+      break;
+    i += got;
+  }
+  return i;
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+/*
+ * The queued frames are transmitted in arbitration order, frames with the
+ * same identifier in FIFO order.
+ */
+static void ordering(void) {
+  static const uint8_t expected[] = {6, 5, 2, 4, 3, 1};
+  CANTxFrame ctf[6];
+  CANRxFrame crf[8];
+  size_t i, n;
+
+  canStart(&CAND1, &cfg_125k);
+  set_std(&ctf[0], 0x300, 1);
+  set_std(&ctf[1], 0x100, 2);
+  set_std(&ctf[2], 0x200, 3);
+  set_std(&ctf[3], 0x100, 4);
+  set_ext(&ctf[4], 0x00080000, 5);
+  set_std(&ctf[5], 0x002, 6);
+  ctf[5].RTR = CAN_RTR_REMOTE;
+  check(canTransmitBatch(&CAND1, ctf, 6, TIME_IMMEDIATE) == 6,
+        "batch queued");
+  n = receive_all(crf, 8);
+  check(n == 6, "frames count");
+  for (i = 0; i < n; i++)
+    check(crf[i].data8[0] == expected[i], "arbitration order");
+  canStop(&CAND1);
+
+  chprintf(chp, "--- Arbitration order: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+/*
+ * Identifier filters table.
+ */
+static void filters(void) {
+  static const CANIdFilter table[] = {
+    {0x123, 0x7FF, CAN_IDE_STD},
+    {0x200, 0x700, CAN_IDE_STD},
+    {0x18DAF100, 0x1FFFFF00, CAN_IDE_EXT}
+  };
+  static const struct {
+    bool_t   ext;
+    uint32_t id;
+    int      fmi;
+  } frames[] = {
+    {FALSE, 0x123, 0},
+    {FALSE, 0x124, -1},
+    {FALSE, 0x2AB, 1},
+    {FALSE, 0x3AB, -1},
+    {TRUE,  0x123, -1},
+    {TRUE,  0x18DAF1AA, 2},
+    {TRUE,  0x18DAF2AA, -1},
+    {FALSE, 0x200, 1}
+  };
+  static CANIdFilter overflow[SIM_CAN_MAX_FILTERS + 1];
+  CANTxFrame ctf[8];
+  CANRxFrame crf[8];
+  size_t i, j, k, n;
+
+  check(canSetIdFilters(&CAND2, table, 3) == CH_SUCCESS, "filters set");
+  canStart(&CAND1, &cfg_fast);
+  for (i = 0; i < 8; i++) {
+    if (frames[i].ext)
+      set_ext(&ctf[i], frames[i].id, (uint8_t)i);
+    else
+      set_std(&ctf[i], frames[i].id, (uint8_t)i);
+  }
+  check(canTransmitBatch(&CAND1, ctf, 8, TIME_IMMEDIATE) == 8,
+        "batch queued");
+  n = receive_all(crf, 8);
+  canStop(&CAND1);
+
+  /* Accepted frames are received in arbitration order, the tag is the
+     index in the frames table.*/
+  for (i = 0, j = 0; i < 8; i++) {
+    if (frames[i].fmi >= 0)
+      j++;
+  }
+  for (i = 0; i < n; i++) {
+    k = crf[i].data8[0];
+    check((k < 8) && (frames[k].fmi == (int)crf[i].FMI), "filtered frames");
+  }
+  check(n == j, "filtered frames count");
+  check(canSetIdFilters(&CAND2, overflow, SIM_CAN_MAX_FILTERS + 1) ==
+        CH_FAILED, "filters table overflow");
+  check(canSetIdFilters(&CAND2, test_filters, 2) == CH_SUCCESS,
+        "filters restored");
+
+  chprintf(chp, "--- Filters: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+/*
+ * Sender thread, frames carry a sequence number. All the frames have the
+ * same identifier so they are transmitted in FIFO order.
+ */
+static WORKING_AREA(waSender, 1024);
+static msg_t sender(void *arg) {
+  CANTxFrame ctf[LOAD_BURST];
+  uint32_t seq = 0;
+  unsigned i;
+
+  (void)arg;
+  while (seq < LOAD_FRAMES) {
+    for (i = 0; i < LOAD_BURST; i++, seq++) {
+      set_std(&ctf[i], LOAD_ID, 0);
+      ctf[i].DLC = 8;
+      ctf[i].data32[0] = seq;
+      ctf[i].data32[1] = ~seq;
+    }
+    canTransmitBatch(&CAND1, ctf, LOAD_BURST, TIME_INFINITE);
+  }
+  return 0;
+}
+
+/*
+ * Full speed traffic at 500Kb/S, the receiver thread is late by the
+ * specified time after each batch.
+ */
+static void load(unsigned late) {
+  static CANRxFrame crf[32];
+  EventListener el;
+  Thread *tp;
+  uint64_t start, elapsed;
+  uint32_t next = 0, lost = 0, received = 0, calls = 0;
+  flagsmask_t flags;
+  size_t i, n;
+
+  chEvtRegister(&CAND2.error_event, &el, 0);
+  (void)chEvtGetAndClearFlags(&el);
+  canStart(&CAND1, &cfg_500k);
+  tp = chThdCreateStatic(waSender, sizeof(waSender), NORMALPRIO + 1,
+                         sender, NULL);
+  start = now_us();
+  while (next < LOAD_FRAMES) {
+    n = canReceiveBatch(&CAND2, crf, 32, MS2ST(200));
+    if (n == 0)
+      break;
+    calls++;
+    for (i = 0; i < n; i++) {
+      uint32_t seq = crf[i].data32[0];
+
+      if (seq != next)
+        lost += seq - next;
+      next = seq + 1;
+      received++;
+    }
+    if (late > 0)
+      chThdSleepMilliseconds(late);
+  }
+  elapsed = now_us() - start;
+  lost += LOAD_FRAMES - next;
+  chThdWait(tp);
+  canStop(&CAND1);
+  flags = chEvtGetAndClearFlags(&el);
+  chEvtUnregister(&CAND2.error_event, &el);
+
+  chprintf(chp, "--- Load at 500Kb/S, receiver late %ums per batch\r\n",
+           late);
+  print_ratio("    throughput        : ", (uint64_t)received * 1000000,
+              elapsed, " frames/S\r\n");
+  print_ratio("    frames per call   : ", received, calls, "\r\n");
+  chprintf(chp, "    received, lost    : %u, %u%s\r\n", received, lost,
+           (flags & CAN_OVERFLOW_ERROR) ? " (queue overflow)" : "");
+  check(received + lost == LOAD_FRAMES, "sequence");
+}
+
+/*
+ * Bus load generator, lowest priority frames at full speed.
+ */
+static void generator(void) {
+  static const CANConfig cfg_1m = {1000000};
+  CANTxFrame ctf[LOAD_BURST];
+  uint32_t seq = 0;
+  unsigned i;
+
+  canStart(&CAND1, &cfg_1m);
+  chprintf(chp, "*** CAN bus load generator, 1Mb/S\r\n");
+  while (TRUE) {
+    for (i = 0; i < LOAD_BURST; i++, seq++) {
+      set_std(&ctf[i], GENERATOR_ID, 0);
+      ctf[i].DLC = 8;
+      ctf[i].data32[0] = seq;
+    }
+    canTransmitBatch(&CAND1, ctf, LOAD_BURST, TIME_INFINITE);
+  }
+}
+
+/*
+ * Application entry point.
+ */
+int main(int argc, char *argv[]) {
+
+  halInit();
+  chSysInit();
+  conInit();
+
+  if ((argc > 1) && (strcmp(argv[1], "load") == 0))
+    generator();
+
+  chprintf(chp, "*** CAN driver, %u frames receive queue, "
+           "%u frames transmit queue\r\n",
+           CAN_RX_QUEUE_SIZE, CAN_TX_QUEUE_SIZE);
+  check(canSetIdFilters(&CAND2, test_filters, 2) == CH_SUCCESS,
+        "filters set");
+  canStart(&CAND2, &cfg_fast);
+  ordering();
+  filters();
+  load(0);
+  load(2);
+  load(20);
+  canStop(&CAND2);
+
+  chprintf(chp, "\r\nFinal result: %s\r\n", failed ? "FAILURE" : "SUCCESS");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,527 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "memstreams.h"
+#include "console.h"
+
+#define ITERATIONS          200000
+#define QUEUE_SIZE          128
+
+static BaseSequentialStream *chp = (BaseSequentialStream *)&CD1;
+static bool_t failed;
+
+/*===========================================================================*/
+/* Streams.                                                                  */
+/*===========================================================================*/
+
+/*
+ * Bytes and calls received by the streams.
+ */
+static uint64_t out_bytes;
+static uint32_t out_calls;
+
+/*
+ * Null stream, it only counts the bytes and the calls.
+ */
+static size_t null_write(void *ip, const uint8_t *bp, size_t n) {
+
+  (void)ip;
+  (void)bp;
+  out_bytes += n;
+  out_calls++;
+  return n;
+}
+
+static size_t null_read(void *ip, uint8_t *bp, size_t n) {
+
+  (void)ip;
+  (void)bp;
+  (void)n;
+  return 0;
+}
+
+static msg_t null_put(void *ip, uint8_t b) {
+
+  (void)ip;
+  (void)b;
+  out_bytes++;
+  out_calls++;
+  return RDY_OK;
+}
+
+static msg_t null_get(void *ip) {
+
+  (void)ip;
+  return Q_RESET;
+}
+
+static const struct BaseSequentialStreamVMT null_vmt = {
+  null_write, null_read, null_put, null_get
+};
+
+static BaseSequentialStream null_stream = {&null_vmt};
+
+/*
+ * Queued stream, same path as a serial driver. The notification callback
+ * drains the queue as a transmitter infinitely fast would do.
+ */
+static OutputQueue oq;
+static uint8_t oq_buffer[QUEUE_SIZE];
+
+static void oq_notify(GenericQueue *qp) {
+
+  chOQResetI((OutputQueue *)qp);
+}
+
+static size_t queue_write(void *ip, const uint8_t *bp, size_t n) {
+
+  (void)ip;
+  out_bytes += n;
+  out_calls++;
+  return chOQWriteTimeout(&oq, bp, n, TIME_INFINITE);
+}
+
+static msg_t queue_put(void *ip, uint8_t b) {
+
+  (void)ip;
+  out_bytes++;
+  out_calls++;
+  return chOQPutTimeout(&oq, b, TIME_INFINITE);
+}
+
+static const struct BaseSequentialStreamVMT queue_vmt = {
+  queue_write, null_read, queue_put, null_get
+};
+
+static BaseSequentialStream queue_stream = {&queue_vmt};
+
+/*===========================================================================*/
+/* Reference, the previous per character implementation.                     */
+/*===========================================================================*/
+
+#define MAX_FILLER 11
+
+static char *long_to_string_with_divisor(char *p,
+                                         long num,
+                                         unsigned radix,
+                                         long divisor) {
+  int i;
+  char *q;
+  long l, ll;
+
+  l = num;
+  if (divisor == 0) {
+    ll = num;
+  } else {
+    ll = divisor;
+  }
+
+  q = p + MAX_FILLER;
+  do {
+    i = (int)(l % radix);
+    i += '0';
+    if (i > '9')
+      i += 'A' - '0' - 10;
+    *--q = i;
+    l /= radix;
+  } while ((ll /= radix) != 0);
+
+  i = (int)(p + MAX_FILLER - q);
+  do
+    *p++ = *q++;
+  while (--i);
+
+  return p;
+}
+
+static char *legacy_ltoa(char *p, long num, unsigned radix) {
+
+  return long_to_string_with_divisor(p, num, radix, 0);
+}
+
+static void legacy_chprintf(BaseSequentialStream *chp,
+                            const char *fmt, ...) {
+  va_list ap;
+  char *p, *s, c, filler;
+  int i, precision, width;
+  bool_t is_long, left_align;
+  long l;
+  char tmpbuf[MAX_FILLER + 1];
+
+  va_start(ap, fmt);
+  while (TRUE) {
+    c = *fmt++;
+    if (c == 0) {
+      va_end(ap);
+      return;
+    }
+    if (c != '%') {
+      chSequentialStreamPut(chp, (uint8_t)c);
+      continue;
+    }
+    p = tmpbuf;
+    s = tmpbuf;
+    left_align = FALSE;
+    if (*fmt == '-') {
+      fmt++;
+      left_align = TRUE;
+    }
+    filler = ' ';
+    if ((*fmt == '.') || (*fmt == '0')) {
+      fmt++;
+      filler = '0';
+    }
+    width = 0;
+    while (TRUE) {
+      c = *fmt++;
+      if (c >= '0' && c <= '9')
+        c -= '0';
+      else if (c == '*')
+        c = va_arg(ap, int);
+      else
+        break;
+      width = width * 10 + c;
+    }
+    precision = 0;
+    if (c == '.') {
+      while (TRUE) {
+        c = *fmt++;
+        if (c >= '0' && c <= '9')
+          c -= '0';
+        else if (c == '*')
+          c = va_arg(ap, int);
+        else
+          break;
+        precision *= 10;
+        precision += c;
+      }
+    }
+    /* Long modifier.*/
+    if (c == 'l' || c == 'L') {
+      is_long = TRUE;
+      if (*fmt)
+        c = *fmt++;
+    }
+    else
+      is_long = (c >= 'A') && (c <= 'Z');
+
+    /* Command decoding.*/
+    switch (c) {
+    case 'c':
+      filler = ' ';
+      *p++ = va_arg(ap, int);
+      break;
+    case 's':
+      filler = ' ';
+      if ((s = va_arg(ap, char *)) == 0)
+        s = "(null)";
+      if (precision == 0)
+        precision = 32767;
+      for (p = s; *p && (--precision >= 0); p++)
+        ;
+      break;
+    case 'D':
+    case 'd':
+    case 'I':
+    case 'i':
+      if (is_long)
+        l = va_arg(ap, long);
+      else
+        l = va_arg(ap, int);
+      if (l < 0) {
+        *p++ = '-';
+        l = -l;
+      }
+      p = legacy_ltoa(p, l, 10);
+      break;
+    case 'X':
+    case 'x':
+      c = 16;
+      goto unsigned_common;
+    case 'U':
+    case 'u':
+      c = 10;
+      goto unsigned_common;
+    case 'O':
+    case 'o':
+      c = 8;
+unsigned_common:
+      if (is_long)
+        l = va_arg(ap, unsigned long);
+      else
+        l = va_arg(ap, unsigned int);
+      p = legacy_ltoa(p, l, c);
+      break;
+    default:
+      *p++ = c;
+      break;
+    }
+    i = (int)(p - s);
+    if ((width -= i) < 0)
+      width = 0;
+    if (left_align == FALSE)
+      width = -width;
+    if (width < 0) {
+      if (*s == '-' && filler == '0') {
+        chSequentialStreamPut(chp, (uint8_t)*s++);
+        i--;
+      }
+      do
+        chSequentialStreamPut(chp, (uint8_t)filler);
+      while (++width != 0);
+    }
+    while (--i >= 0)
+      chSequentialStreamPut(chp, (uint8_t)*s++);
+
+    while (width) {
+      chSequentialStreamPut(chp, (uint8_t)filler);
+      width--;
+    }
+  }
+}
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Prints a ratio with two decimals.
+ */
+static void print_ratio(const char *label, uint64_t num, uint64_t den,
+                        const char *unit) {
+  uint64_t r = den ? (num * 100) / den : 0;
+
+  chprintf(chp, "%s%u.%02u%s", label, (unsigned)(r / 100),
+           (unsigned)(r % 100), unit);
+}
+
+static void check(const char *got, const char *expected) {
+
+  if (strcmp(got, expected) != 0) {
+    chprintf(chp, "--- mismatch: \"%s\" expected \"%s\"\r\n", got, expected);
+    failed = TRUE;
+  }
+}
+
+/*===========================================================================*/
+/* Benchmarks.                                                               */
+/*===========================================================================*/
+
+/*
+ * Typical telemetry record.
+ */
+#define RECORD_FMT  "t=%U ch=%d raw=%5d avg=%-6d flags=%.8X st=%s\r\n"
+#define RECORD_ARGS(i)                                                      \
+  1000000UL + (i), (int)((i) & 7), (int)((i) * 37 % 4096) - 2048,           \
+  (int)((i) % 1000), 0xA5000000UL | (i), ((i) & 1) ? "ok" : "busy"
+
+typedef void (*printer_t)(BaseSequentialStream *sp, uint32_t i);
+
+static void rec_legacy(BaseSequentialStream *sp, uint32_t i) {
+
+  legacy_chprintf(sp, RECORD_FMT, RECORD_ARGS(i));
+}
+
+static void rec_new(BaseSequentialStream *sp, uint32_t i) {
+
+  chprintf(sp, RECORD_FMT, RECORD_ARGS(i));
+}
+
+/*
+ * Runs a printer, returns the bytes per second.
+ */
+static uint64_t run(printer_t pp, BaseSequentialStream *sp,
+                    uint32_t *callsp) {
+  uint64_t start, elapsed;
+  uint32_t i;
+
+  out_bytes = 0;
+  out_calls = 0;
+  start = now_us();
+  for (i = 0; i < ITERATIONS; i++)
+    pp(sp, i);
+  elapsed = now_us() - start;
+  *callsp = out_calls;
+  return elapsed ? (out_bytes * 1000000) / elapsed : 0;
+}
+
+static void compare(const char *name, BaseSequentialStream *sp) {
+  uint64_t ref, fast;
+  uint32_t ref_calls, fast_calls;
+
+  ref = run(rec_legacy, sp, &ref_calls);
+  fast = run(rec_new, sp, &fast_calls);
+  chprintf(chp, "--- %s, %u records\r\n", name, ITERATIONS);
+  print_ratio("    per character     : ", ref, 1000000, " MB/S");
+  chprintf(chp, ", %u stream calls\r\n", ref_calls);
+  print_ratio("    buffered          : ", fast, 1000000, " MB/S");
+  chprintf(chp, ", %u stream calls\r\n", fast_calls);
+  print_ratio("    speedup           : ", fast, ref, "\r\n");
+}
+
+/*
+ * Formatting to memory, MemoryStream against chsnprintf().
+ */
+static void memory(void) {
+  static char buf[128];
+  MemoryStream ms;
+  uint64_t start, t1, t2, bytes = 0;
+  uint32_t i;
+
+  start = now_us();
+  for (i = 0; i < ITERATIONS; i++) {
+    msObjectInit(&ms, (uint8_t *)buf, sizeof buf, 0);
+    legacy_chprintf((BaseSequentialStream *)&ms, RECORD_FMT, RECORD_ARGS(i));
+    bytes += ms.eos;
+  }
+  t1 = now_us() - start;
+
+  start = now_us();
+  for (i = 0; i < ITERATIONS; i++)
+    bytes += chsnprintf(buf, sizeof buf, RECORD_FMT, RECORD_ARGS(i));
+  t2 = now_us() - start;
+
+  chprintf(chp, "--- Memory, %u records\r\n", ITERATIONS);
+  print_ratio("    MemoryStream      : ", bytes / 2, t1, " MB/S\r\n");
+  print_ratio("    chsnprintf()      : ", bytes / 2, t2, " MB/S\r\n");
+  print_ratio("    speedup           : ", t1, t2, "\r\n");
+}
+
+/*
+ * Integer conversions alone, large numbers stress the digits loop.
+ */
+static void numbers(void) {
+  static char buf[64];
+  uint64_t start, t1, t2, bytes = 0;
+  MemoryStream ms;
+  uint32_t i, v;
+
+  start = now_us();
+  for (i = 0, v = 1; i < ITERATIONS; i++, v = v * 1664525 + 1013904223) {
+    msObjectInit(&ms, (uint8_t *)buf, sizeof buf, 0);
+    legacy_chprintf((BaseSequentialStream *)&ms, "%U %U %U %U",
+                    v, v >> 7, v >> 14, v >> 21);
+    bytes += ms.eos;
+  }
+  t1 = now_us() - start;
+
+  start = now_us();
+  for (i = 0, v = 1; i < ITERATIONS; i++, v = v * 1664525 + 1013904223)
+    bytes += chsnprintf(buf, sizeof buf, "%U %U %U %U",
+                        v, v >> 7, v >> 14, v >> 21);
+  t2 = now_us() - start;
+
+  chprintf(chp, "--- Decimal conversion, %u x 4 numbers\r\n", ITERATIONS);
+  print_ratio("    per digit         : ", bytes / 2, t1, " MB/S\r\n");
+  print_ratio("    digit pairs       : ", bytes / 2, t2, " MB/S\r\n");
+  print_ratio("    speedup           : ", t1, t2, "\r\n");
+}
+
+/*===========================================================================*/
+/* Conformance.                                                              */
+/*===========================================================================*/
+
+static void conformance(void) {
+  char buf[64], ref[64];
+  uint64_t v = 1;
+  int n;
+  unsigned i;
+
+  /* Compatibility with the previous implementation.*/
+  for (i = 0; i < 1000; i++, v = v * 6364136223846793005ULL + 1) {
+    MemoryStream ms;
+
+    msObjectInit(&ms, (uint8_t *)ref, sizeof ref, 0);
+    legacy_chprintf((BaseSequentialStream *)&ms, RECORD_FMT,
+                    RECORD_ARGS((uint32_t)(v >> 32)));
+    ref[ms.eos] = 0;
+    (void)chsnprintf(buf, sizeof buf, RECORD_FMT,
+                     RECORD_ARGS((uint32_t)(v >> 32)));
+    check(buf, ref);
+  }
+
+  /* 64 bits integers against the host library.*/
+  for (i = 0; i < 1000; i++, v = v * 6364136223846793005ULL + 1) {
+    uint64_t x = v >> (i % 64);
+
+    (void)chsnprintf(buf, sizeof buf, "%llu %lld %llx",
+                     x, (long long)x, x);
+    snprintf(ref, sizeof ref, "%llu %lld %llX",
+             (unsigned long long)x, (long long)x, (unsigned long long)x);
+    check(buf, ref);
+  }
+
+  /* Fixed point.*/
+  (void)chsnprintf(buf, sizeof buf, "%k %1.2k %1.6k %k",
+                   (int32_t)0x18000, (int32_t)-0x18000, (int32_t)1,
+                   (int32_t)0xFFFFF);
+  check(buf, "1.5000 -1.50 0.000015 16.0000");
+
+  /* Floating point, the numbers not fitting the integer conversion are
+     printed with an exponent.*/
+  (void)chsnprintf(buf, sizeof buf, "%f %1.2f %f %1.3f",
+                   2.5, -4294967296.0, 1e300, 9.99996e20);
+  snprintf(ref, sizeof ref, "%.5f %.2f %.5e %.3e",
+           2.5, -4294967296.0, 1e300, 9.99996e20);
+  check(buf, ref);
+  (void)chsnprintf(buf, sizeof buf, "%f %f", 1.0 / 0.0, 0.0 / 0.0);
+  check(buf, "inf nan");
+
+  /* Truncation.*/
+  n = chsnprintf(buf, 8, "%s", "0123456789");
+  check(buf, "0123456");
+  if (n != 10)
+    failed = TRUE;
+
+  chprintf(chp, "--- Conformance: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+/*
+ * Application entry point.
+ */
+int main(void) {
+
+  halInit();
+  chSysInit();
+  conInit();
+  chOQInit(&oq, oq_buffer, sizeof oq_buffer, oq_notify, NULL);
+
+  chprintf(chp, "*** chprintf() throughput, %u bytes output chunk\r\n",
+           CHPRINTF_BUFFER_SIZE);
+  conformance();
+  compare("Null stream", &null_stream);
+  compare("Queued stream", &queue_stream);
+  memory();
+  numbers();
+
+  chprintf(chp, "\r\nFinal result: %s\r\n", failed ? "FAILURE" : "SUCCESS");
+  return failed ? 1 : 0;
+}
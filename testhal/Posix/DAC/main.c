@@ -0,0 +1,354 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "console.h"
+
+#define RATE                48000
+#define BLOCK               480
+#define STALL_EVERY         10
+#define STALL_MS            15
+#define BENCH_TIME          500000
+
+static BaseSequentialStream *chp = (BaseSequentialStream *)&CD1;
+static bool_t failed;
+
+static dacsample_t buffer[96 * 2];
+static dacsample_t ring[4800 * 2];
+static EventListener el;
+
+/*
+ * One half buffer per interrupt and real time at 48KHz.
+ */
+static const DACConfig cfg_fast = {0, "dac_formats.wav"};
+static const DACConfig cfg_48k = {RATE, "dac_48k.wav"};
+
+static const DACConversionGroup mono = {TRUE, 1, NULL, NULL};
+static const DACConversionGroup stereo = {TRUE, 2, NULL, NULL};
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Prints a ratio with two decimals.
+ */
+static void print_ratio(const char *label, uint64_t num, uint64_t den,
+                        const char *unit) {
+  uint64_t r = den ? (num * 100) / den : 0;
+
+  chprintf(chp, "%s%u.%02u%s", label, (unsigned)(r / 100),
+           (unsigned)(r % 100), unit);
+}
+
+static void check(bool_t cond, const char *msg) {
+
+  if (!cond) {
+    chprintf(chp, "--- failed: %s\r\n", msg);
+    failed = TRUE;
+  }
+}
+
+static void set_cfg(DACStreamConfig *cfgp, const DACConversionGroup *grpp,
+                    size_t depth, size_t size, dacsformat_t format,
+                    size_t low_water) {
+
+  cfgp->grpp      = grpp;
+  cfgp->buffer    = buffer;
+  cfgp->depth     = depth;
+  cfgp->ring      = ring;
+  cfgp->size      = size;
+  cfgp->format    = format;
+  cfgp->bits      = 12;
+  cfgp->low_water = low_water;
+  cfgp->idle      = 2048;
+}
+
+/*
+ * Reads back 12 bits samples from a WAV file.
+ */
+static bool_t wav_read(const char *name, uint32_t offset,
+                       dacsample_t *dp, size_t n) {
+  uint8_t pcm[2];
+  FILE *f = fopen(name, "rb");
+  bool_t ok;
+
+  if (f == NULL)
+    return FALSE;
+  ok = fseek(f, 44 + offset, SEEK_SET) == 0;
+  while (ok && (n-- > 0)) {
+    ok = fread(pcm, 1, 2, f) == 2;
+    *dp++ = (dacsample_t)(((pcm[0] | (pcm[1] << 8)) ^ 0x8000) >> 4);
+  }
+  fclose(f);
+  return ok;
+}
+
+/*
+ * Sine sample, Bhaskara I approximation.
+ */
+static int16_t sine(unsigned phase, unsigned period, int32_t amplitude) {
+  int32_t h = period / 2, q = phase % h;
+  int32_t v = (amplitude * 16 * q * (h - q)) / (5 * h * h - 4 * q * (h - q));
+
+  return (int16_t)(phase % period < (unsigned)h ? v : -v);
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+/*
+ * Each format is converted to 12 bits samples, the output is read back
+ * from the WAV file.
+ */
+static void formats(void) {
+  static const char *names[5] = {"native", "u8", "s16", "u16", "s32"};
+  union {
+    dacsample_t native[16];
+    uint8_t u8[16];
+    int16_t s16[16];
+    uint16_t u16[16];
+    int32_t s32[16];
+  } in;
+  dacsample_t expected[16], out[16];
+  DACStreamConfig cfg;
+  uint32_t offset;
+  unsigned f, i;
+
+  dacStart(&DACD1, &cfg_fast);
+  for (f = DAC_FMT_NATIVE; f <= DAC_FMT_S32; f++) {
+    for (i = 0; i < 16; i++) {
+      switch (f) {
+      case DAC_FMT_NATIVE:
+        in.native[i] = (dacsample_t)(i * 273);
+        expected[i] = (dacsample_t)(i * 273);
+        break;
+      case DAC_FMT_U8:
+        in.u8[i] = (uint8_t)(i * 17);
+        expected[i] = (dacsample_t)(i * 17 << 4);
+        break;
+      case DAC_FMT_S16:
+        in.s16[i] = (int16_t)(-32768 + (int32_t)i * 4369);
+        expected[i] = (dacsample_t)((i * 4369) >> 4);
+        break;
+      case DAC_FMT_U16:
+        in.u16[i] = (uint16_t)(i * 4369);
+        expected[i] = (dacsample_t)((i * 4369) >> 4);
+        break;
+      default:
+        in.s32[i] = (int32_t)(INT32_MIN + (int64_t)i * 0x11111111);
+        expected[i] = (dacsample_t)((i * 0x11111111U) >> 20);
+      }
+    }
+    set_cfg(&cfg, &mono, 8, 16, (dacsformat_t)f, 0);
+    offset = DACD1.wavbytes;
+    dacStartStream(&DACD1, &cfg);
+    check(dacWriteStream(&DACD1, &in, 16, TIME_INFINITE) == 16,
+          "written rows");
+    check(dacDrainStream(&DACD1, MS2ST(100)) == RDY_OK, "drain");
+    dacStopStream(&DACD1);
+    if (!wav_read(cfg_fast.wavfile, offset, out, 16) ||
+        (memcmp(out, expected, sizeof out) != 0)) {
+      chprintf(chp, "--- format %s\r\n", names[f]);
+      check(FALSE, "converted samples");
+    }
+  }
+  check(DACD1.state == DAC_READY, "driver state");
+
+  chprintf(chp, "--- Formats: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+/*
+ * The producer stops writing, the half buffers are refilled with idle
+ * rows and the events are broadcast.
+ */
+static void underrun(void) {
+  static dacsample_t data[64];
+  DACStreamConfig cfg;
+  DACStreamStats stats;
+  flagsmask_t flags;
+  unsigned i;
+
+  for (i = 0; i < 64; i++)
+    data[i] = (dacsample_t)(i * 64);
+  set_cfg(&cfg, &mono, 32, 64, DAC_FMT_NATIVE, 16);
+  dacStartStream(&DACD1, &cfg);
+  chEvtRegisterMask(&DACD1.strevent, &el, EVENT_MASK(0));
+  check(dacWriteStream(&DACD1, data, 16, TIME_IMMEDIATE) == 16,
+        "preroll rows");
+  check(!DACD1.strstarted, "conversion started early");
+  check(dacWriteStream(&DACD1, data, 64, TIME_IMMEDIATE) == 64,
+        "full ring");
+  check(DACD1.strstarted, "conversion not started");
+  chThdSleepMilliseconds(10);
+  dacGetStreamStats(&DACD1, &stats);
+  flags = chEvtGetAndClearFlags(&el);
+  check(stats.underruns > 0, "underruns counted");
+  check(stats.idle >= 16, "idle rows");
+  check(stats.min_level == 0, "minimum level");
+  check((flags & DAC_STREAM_UNDERRUN) != 0, "underrun event");
+  check((flags & DAC_STREAM_LOW_WATER) != 0, "low watermark event");
+  check(dacWriteStream(&DACD1, data, 64, MS2ST(100)) == 64, "resumed");
+  check(dacDrainStream(&DACD1, MS2ST(100)) == RDY_OK, "drain");
+  dacStopStream(&DACD1);
+  chEvtUnregister(&DACD1.strevent, &el);
+
+  chprintf(chp, "--- Underrun: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+static WORKING_AREA(waProducer, 1024);
+
+static msg_t producer(void *p) {
+  static dacsample_t data[256];
+
+  (void)p;
+  memset(data, 0, sizeof data);
+  return (msg_t)dacWriteStream(&DACD1, data, 256, TIME_INFINITE);
+}
+
+/*
+ * A conversion error and a stop release a blocked producer.
+ */
+static void error(void) {
+  DACStreamConfig cfg;
+  Thread *tp;
+  msg_t n;
+
+  set_cfg(&cfg, &mono, 8, 16, DAC_FMT_NATIVE, 0);
+  dacStartStream(&DACD1, &cfg);
+  chEvtRegisterMask(&DACD1.strevent, &el, EVENT_MASK(0));
+  tp = chThdCreateStatic(waProducer, sizeof(waProducer), NORMALPRIO + 1,
+                         producer, NULL);
+  chSysLock();
+  dacSimErrorI(&DACD1, DAC_ERR_UNDERRUN);
+  chSysUnlock();
+  n = chThdWait(tp);
+  check((n >= 16) && (n < 256), "rows written before the error");
+  check((chEvtGetAndClearFlags(&el) & DAC_STREAM_ERROR) != 0,
+        "error event");
+  check(dacDrainStream(&DACD1, MS2ST(100)) == RDY_RESET, "drain status");
+  dacStopStream(&DACD1);
+  chEvtUnregister(&DACD1.strevent, &el);
+  check(DACD1.state == DAC_READY, "driver state after error");
+
+  dacStart(&DACD1, &cfg_48k);
+  dacStartStream(&DACD1, &cfg);
+  tp = chThdCreateStatic(waProducer, sizeof(waProducer), NORMALPRIO + 1,
+                         producer, NULL);
+  dacStopStream(&DACD1);
+  n = chThdWait(tp);
+  check((n >= 16) && (n < 256), "rows written before the stop");
+  check(DACD1.state == DAC_READY, "driver state after stop");
+
+  chprintf(chp, "--- Error and stop: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+/*
+ * A producer generating 10mS blocks of a 1KHz tone, stalling for 15mS
+ * every ten blocks, the latency from write to output and the underruns
+ * are measured with different ring sizes. The latency is the number of
+ * rows queued in the ring and in the conversion buffer after each write.
+ */
+static void benchmark(size_t size, bool_t expect_underruns) {
+  static int16_t block[BLOCK * 2];
+  DACStreamConfig cfg;
+  DACStreamStats stats;
+  uint64_t start, lat_sum = 0;
+  uint32_t lat, lat_max = 0, writes = 0, blocks = 0, phase = 0;
+  unsigned i;
+
+  set_cfg(&cfg, &stereo, 96, size, DAC_FMT_S16, size / 4);
+  dacStartStream(&DACD1, &cfg);
+  start = now_us();
+  while (now_us() - start < BENCH_TIME) {
+    for (i = 0; i < BLOCK; i++, phase++) {
+      block[i * 2] = sine(phase, RATE / 1000, 16000);
+      block[i * 2 + 1] = sine(phase, RATE / 500, 8000);
+    }
+    if (dacWriteStream(&DACD1, block, BLOCK, MS2ST(100)) != BLOCK) {
+      check(FALSE, "write timeout");
+      break;
+    }
+    if (DACD1.strstarted) {
+      chSysLock();
+      lat = (uint32_t)(DACD1.strcount + DACD1.depth - DACD1.index);
+      chSysUnlock();
+      lat_sum += lat;
+      if (lat > lat_max)
+        lat_max = lat;
+      writes++;
+    }
+    if (++blocks % STALL_EVERY == 0)
+      chThdSleepMilliseconds(STALL_MS);
+    else
+      chThdSleepMilliseconds(BLOCK * 1000 / RATE - 2);
+  }
+  check(dacDrainStream(&DACD1, MS2ST(200)) == RDY_OK, "drain");
+  dacGetStreamStats(&DACD1, &stats);
+  dacStopStream(&DACD1);
+  if (expect_underruns)
+    check(stats.underruns > 0, "underruns expected");
+  else
+    check(stats.underruns == 0, "no underruns expected");
+
+  chprintf(chp, "--- Benchmark ring %u rows (", (unsigned)size);
+  print_ratio("", (uint64_t)size * 1000, RATE, "mS)\r\n");
+  chprintf(chp, "    underruns         : %u\r\n", stats.underruns);
+  chprintf(chp, "    idle rows         : %u\r\n", stats.idle);
+  chprintf(chp, "    minimum level     : %u rows\r\n",
+           (unsigned)stats.min_level);
+  print_ratio("    average latency   : ", lat_sum * 1000,
+              (uint64_t)writes * RATE, " mS\r\n");
+  print_ratio("    maximum latency   : ", (uint64_t)lat_max * 1000, RATE,
+              " mS\r\n");
+}
+
+/*
+ * Application entry point.
+ */
+int main(void) {
+
+  halInit();
+  chSysInit();
+  conInit();
+
+  chprintf(chp, "*** DAC streaming, simulated converter\r\n");
+  formats();
+  underrun();
+  error();
+  dacStart(&DACD1, &cfg_48k);
+  benchmark(192, TRUE);
+  benchmark(960, FALSE);
+  benchmark(4800, FALSE);
+  dacStop(&DACD1);
+
+  chprintf(chp, "\r\nFinal result: %s\r\n", failed ? "FAILURE" : "SUCCESS");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,145 @@
+/*-----------------------------------------------------------------------*/
+/* Low level disk I/O module for FatFs over the Posix simulated disk     */
+/*-----------------------------------------------------------------------*/
+
+#include "ch.h"
+#include "hal.h"
+#include "ffconf.h"
+#include "diskio.h"
+#include "simdisk.h"
+
+extern SimDiskDriver SDD1;
+
+/*-----------------------------------------------------------------------*/
+/* Correspondence between physical drive number and physical drive.      */
+
+#define SIMDISK     0
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Inidialize a Drive                                                    */
+
+DSTATUS disk_initialize (
+    BYTE drv                /* Physical drive nmuber (0..) */
+)
+{
+  return disk_status(drv);
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Return Disk Status                                                    */
+
+DSTATUS disk_status (
+    BYTE drv        /* Physical drive nmuber (0..) */
+)
+{
+  DSTATUS stat;
+
+  switch (drv) {
+  case SIMDISK:
+    stat = 0;
+    /* It is initialized externally, just reads the status.*/
+    if (blkGetDriverState(&SDD1) != BLK_READY)
+      stat |= STA_NOINIT;
+    if (blkIsWriteProtected(&SDD1))
+      stat |= STA_PROTECT;
+    return stat;
+  }
+  return STA_NODISK;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Read Sector(s)                                                        */
+
+DRESULT disk_read (
+    BYTE drv,        /* Physical drive nmuber (0..) */
+    BYTE *buff,        /* Data buffer to store read data */
+    DWORD sector,    /* Sector address (LBA) */
+    BYTE count        /* Number of sectors to read (1..255) */
+)
+{
+  switch (drv) {
+  case SIMDISK:
+    if (blkGetDriverState(&SDD1) != BLK_READY)
+      return RES_NOTRDY;
+    if (blkRead(&SDD1, sector, buff, count))
+      return RES_ERROR;
+    return RES_OK;
+  }
+  return RES_PARERR;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Write Sector(s)                                                       */
+
+#if _READONLY == 0
+DRESULT disk_write (
+    BYTE drv,            /* Physical drive nmuber (0..) */
+    const BYTE *buff,    /* Data to be written */
+    DWORD sector,        /* Sector address (LBA) */
+    BYTE count            /* Number of sectors to write (1..255) */
+)
+{
+  switch (drv) {
+  case SIMDISK:
+    if (blkGetDriverState(&SDD1) != BLK_READY)
+      return RES_NOTRDY;
+    if (blkIsWriteProtected(&SDD1))
+      return RES_WRPRT;
+    if (blkWrite(&SDD1, sector, buff, count))
+      return RES_ERROR;
+    return RES_OK;
+  }
+  return RES_PARERR;
+}
+#endif /* _READONLY */
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Miscellaneous Functions                                               */
+
+DRESULT disk_ioctl (
+    BYTE drv,        /* Physical drive nmuber (0..) */
+    BYTE ctrl,        /* Control code */
+    void *buff        /* Buffer to send/receive control data */
+)
+{
+  BlockDeviceInfo bdi;
+
+  switch (drv) {
+  case SIMDISK:
+    switch (ctrl) {
+    case CTRL_SYNC:
+      if (blkSync(&SDD1))
+        return RES_ERROR;
+      return RES_OK;
+    case GET_SECTOR_COUNT:
+      if (blkGetInfo(&SDD1, &bdi))
+        return RES_ERROR;
+      *((DWORD *)buff) = bdi.blk_num;
+      return RES_OK;
+    case GET_SECTOR_SIZE:
+      *((WORD *)buff) = SIMDISK_BLOCK_SIZE;
+      return RES_OK;
+    case GET_BLOCK_SIZE:
+      *((DWORD *)buff) = 256; /* 512b blocks in one erase block */
+      return RES_OK;
+    default:
+      return RES_PARERR;
+    }
+  }
+  return RES_PARERR;
+}
+
+DWORD get_fattime(void) {
+
+    return ((uint32_t)0 | (1 << 16)) | (1 << 21); /* wrong but valid time */
+}
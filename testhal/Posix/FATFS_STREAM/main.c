@@ -0,0 +1,280 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "console.h"
+#include "simdisk.h"
+#include "ff.h"
+#include "fatfs_stream.h"
+
+/*
+ * Simulated card, 64MB with a modeled 20MB/S transfer rate and 500uS of
+ * per command overhead.
+ */
+#define DISK_BLOCKS         131072
+#define IMAGE_FILE          "fatfs_stream.img"
+
+#define FILE_SIZE           (16 * 1024 * 1024)
+#define CHUNK_SIZE          (64 * 1024)
+#define SMALL_CHUNK_SIZE    4096
+#define CHECKPOINT          (1024 * 1024)
+
+SimDiskDriver SDD1;
+
+static const SimDiskConfig sdcfg = {
+  DISK_BLOCKS,
+  IMAGE_FILE,
+  500,                      /* Command overhead, uS.                    */
+  25                        /* Block transfer time, uS.                 */
+};
+
+static FATFS fatfs;
+static FIL file;
+static FatFSStream stream;
+static uint8_t buf[CHUNK_SIZE];
+static uint8_t rdbuf[CHUNK_SIZE];
+
+static BaseSequentialStream *chp = (BaseSequentialStream *)&CD1;
+static bool_t failed;
+static uint64_t raw_time;
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void fill(uint8_t *p, uint32_t offset, size_t n) {
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    p[i] = (uint8_t)((offset + i) * 7 + ((offset + i) >> 9));
+}
+
+/*
+ * Prints a ratio with two decimals.
+ */
+static void print_ratio(const char *label, uint64_t num, uint64_t den,
+                        const char *unit) {
+  uint64_t r = den ? (num * 100) / den : 0;
+
+  chprintf(chp, "%s%u.%02u%s", label, (unsigned)(r / 100),
+           (unsigned)(r % 100), unit);
+}
+
+static void report(uint64_t elapsed) {
+  SimDiskStats st;
+
+  simdiskGetStats(&SDD1, &st);
+  print_ratio("    host throughput   : ", FILE_SIZE, elapsed, " MB/S\r\n");
+  print_ratio("    card throughput   : ", FILE_SIZE, st.busy_time, " MB/S\r\n");
+  chprintf(chp, "    card utilization  : %u%%\r\n",
+           (unsigned)(raw_time * 100 / st.busy_time));
+  chprintf(chp, "    write commands    : %u (%u blocks)\r\n",
+           st.writes, (unsigned)st.write_blocks);
+  chprintf(chp, "    read commands     : %u (%u blocks)\r\n",
+           st.reads, (unsigned)st.read_blocks);
+}
+
+/*
+ * Reads back a file and checks its content.
+ */
+static void verify(const char *fname) {
+  uint32_t offset;
+  UINT n;
+
+  if ((f_open(&file, fname, FA_READ) != FR_OK) ||
+      (f_size(&file) != FILE_SIZE)) {
+    chprintf(chp, "    file %s missing or wrong size\r\n", fname);
+    failed = TRUE;
+    return;
+  }
+  for (offset = 0; offset < FILE_SIZE; offset += n) {
+    if ((f_read(&file, rdbuf, CHUNK_SIZE, &n) != FR_OK) || (n == 0))
+      break;
+    fill(buf, offset, n);
+    if (memcmp(buf, rdbuf, n) != 0)
+      break;
+  }
+  (void)f_close(&file);
+  if (offset != FILE_SIZE) {
+    chprintf(chp, "    file %s content mismatch at %u\r\n", fname, offset);
+    failed = TRUE;
+  }
+}
+
+/*===========================================================================*/
+/* Benchmarks.                                                               */
+/*===========================================================================*/
+
+/*
+ * Reference, sequential multi-block writes on the raw device.
+ */
+static void bench_raw(void) {
+  SimDiskStats st;
+  uint32_t blk;
+
+  simdiskResetStats(&SDD1);
+  for (blk = 0; blk < FILE_SIZE / SIMDISK_BLOCK_SIZE;
+       blk += CHUNK_SIZE / SIMDISK_BLOCK_SIZE)
+    (void)blkWrite(&SDD1, blk, buf, CHUNK_SIZE / SIMDISK_BLOCK_SIZE);
+  simdiskGetStats(&SDD1, &st);
+  raw_time = st.busy_time;
+  chprintf(chp, "--- Raw card, %u bytes per command\r\n", CHUNK_SIZE);
+  print_ratio("    card throughput   : ", FILE_SIZE, raw_time, " MB/S\r\n");
+}
+
+static void bench_fwrite(const char *fname, UINT chunk) {
+  uint64_t start;
+  uint32_t offset;
+  UINT n;
+
+  simdiskResetStats(&SDD1);
+  start = now_us();
+  if (f_open(&file, fname, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+    failed = TRUE;
+    return;
+  }
+  for (offset = 0; offset < FILE_SIZE; offset += chunk) {
+    fill(buf, offset, chunk);
+    if ((f_write(&file, buf, chunk, &n) != FR_OK) || (n != chunk)) {
+      failed = TRUE;
+      break;
+    }
+  }
+  (void)f_close(&file);
+  chprintf(chp, "--- f_write(), %u bytes per call\r\n", chunk);
+  report(now_us() - start);
+  verify(fname);
+}
+
+static void bench_stream(const char *fname, UINT chunk) {
+  uint64_t start;
+  uint32_t offset;
+
+  simdiskResetStats(&SDD1);
+  start = now_us();
+  if (fatfsStreamOpen(&stream, fname, FILE_SIZE, CHECKPOINT) != FR_OK) {
+    failed = TRUE;
+    return;
+  }
+  for (offset = 0; offset < FILE_SIZE; offset += chunk) {
+    fill(buf, offset, chunk);
+    if (fatfsStreamWrite(&stream, buf, chunk) != chunk) {
+      failed = TRUE;
+      break;
+    }
+  }
+  if (fatfsStreamClose(&stream) != FR_OK)
+    failed = TRUE;
+  chprintf(chp, "--- Streaming file, %u bytes per call, "
+                "checkpoint every %u bytes\r\n", chunk, CHECKPOINT);
+  report(now_us() - start);
+  verify(fname);
+}
+
+/*
+ * Checks that an unaligned stream is closed with the exact size and
+ * that the data written before a checkpoint survives a remount without
+ * closing the file.
+ */
+static void checks(void) {
+  static const char msg[] = "unaligned tail";
+  FILINFO fno;
+  uint32_t offset;
+
+  /* Unaligned writes.*/
+  if ((fatfsStreamOpen(&stream, "tail.bin", 4096, 0) != FR_OK) ||
+      (fatfsStreamWrite(&stream, msg, sizeof(msg)) != sizeof(msg)) ||
+      (fatfsStreamWrite(&stream, msg, sizeof(msg)) != sizeof(msg)) ||
+      (fatfsStreamClose(&stream) != FR_OK) ||
+      (f_stat("tail.bin", &fno) != FR_OK) ||
+      (fno.fsize != 2 * sizeof(msg))) {
+    chprintf(chp, "--- Unaligned stream failed\r\n");
+    failed = TRUE;
+  }
+  else
+    chprintf(chp, "--- Unaligned stream closed at %u bytes\r\n", fno.fsize);
+
+  /* Checkpoint, the file is abandoned without closing.*/
+  if (fatfsStreamOpen(&stream, "ckpt.bin", 2 * CHECKPOINT,
+                      CHECKPOINT) != FR_OK) {
+    chprintf(chp, "--- Checkpoint stream creation failed\r\n");
+    failed = TRUE;
+    return;
+  }
+  for (offset = 0; offset < CHECKPOINT + CHECKPOINT / 2; offset += CHUNK_SIZE) {
+    fill(buf, offset, CHUNK_SIZE);
+    (void)fatfsStreamWrite(&stream, buf, CHUNK_SIZE);
+  }
+  (void)f_mount(0, NULL);
+  (void)f_mount(0, &fatfs);
+  if ((f_stat("ckpt.bin", &fno) != FR_OK) || (fno.fsize != CHECKPOINT)) {
+    chprintf(chp, "--- Checkpoint not found after remount\r\n");
+    failed = TRUE;
+  }
+  else
+    chprintf(chp, "--- Checkpoint found after remount, %u bytes\r\n",
+             fno.fsize);
+  (void)f_unlink("ckpt.bin");
+}
+
+/*
+ * Application entry point.
+ */
+int main(void) {
+
+  halInit();
+  chSysInit();
+  conInit();
+
+  unlink(IMAGE_FILE);
+  simdiskObjectInit(&SDD1);
+  simdiskStart(&SDD1, &sdcfg);
+  (void)blkConnect(&SDD1);
+
+  chprintf(chp, "*** FatFs streaming over a simulated card, %u MB image\r\n",
+           DISK_BLOCKS / 2048);
+  bench_raw();
+  if ((f_mount(0, &fatfs) != FR_OK) || (f_mkfs(0, 0, 4096) != FR_OK)) {
+    chprintf(chp, "--- unable to format the image\r\n");
+    return 1;
+  }
+
+  bench_fwrite("small.bin", SMALL_CHUNK_SIZE);
+  bench_fwrite("large.bin", CHUNK_SIZE);
+  bench_stream("stream.bin", CHUNK_SIZE);
+  checks();
+
+  (void)f_mount(0, NULL);
+  (void)blkDisconnect(&SDD1);
+  simdiskStop(&SDD1);
+  unlink(IMAGE_FILE);
+
+  chprintf(chp, "\r\nFinal result: %s\r\n", failed ? "FAILURE" : "SUCCESS");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,358 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "console.h"
+#include "simflash.h"
+
+/*
+ * Simulated device geometry, a 1MB serial NOR with 4kB sectors.
+ */
+#define PAGE_SIZE           512
+#define SECTOR_SIZE         4096
+#define SECTORS_NUM         256
+#define RESERVED            16
+#define BLOCKS_NUM          FTL_MAP_SIZE(PAGE_SIZE, SECTOR_SIZE,            \
+                                         SECTORS_NUM, RESERVED)
+
+#define TORTURE_CYCLES      200
+#define IMAGE_FILE          "ftl_test.img"
+
+static SimFlashDriver SF1;
+static FTLDriver FTLD1;
+
+static uint32_t map[BLOCKS_NUM];
+static ftl_sector_t sectors[SECTORS_NUM];
+static uint8_t work[PAGE_SIZE];
+
+static uint8_t shadow[BLOCKS_NUM][PAGE_SIZE];
+static uint8_t buf[8 * PAGE_SIZE];
+
+static const SimFlashConfig sfcfg = {
+  PAGE_SIZE,
+  SECTOR_SIZE,
+  SECTORS_NUM,
+  NULL,
+  300,                      /* Page program time, uS.                   */
+  45000                     /* Sector erase time, uS.                   */
+};
+
+static const SimFlashConfig sfcfg_file = {
+  PAGE_SIZE,
+  SECTOR_SIZE,
+  SECTORS_NUM,
+  IMAGE_FILE,
+  300,
+  45000
+};
+
+static const FTLConfig ftlcfg = {
+  (BaseFlash *)&SF1,
+  RESERVED,
+  map,
+  sectors,
+  work
+};
+
+static BaseSequentialStream *chp = (BaseSequentialStream *)&CD1;
+static bool_t failed;
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void fill(uint8_t *p, uint32_t lba, uint32_t version) {
+  uint32_t i;
+
+  for (i = 0; i < PAGE_SIZE / sizeof(uint32_t); i++)
+    ((uint32_t *)p)[i] = (lba << 16) ^ (version * 2654435761U) ^ i;
+}
+
+/*
+ * Prints a ratio with two decimals.
+ */
+static void print_ratio(const char *label, uint64_t num, uint64_t den,
+                        const char *unit) {
+  uint64_t r = den ? (num * 100) / den : 0;
+
+  chprintf(chp, "%s%u.%02u%s", label, (unsigned)(r / 100),
+           (unsigned)(r % 100), unit);
+}
+
+static void start_ftl(const SimFlashConfig *cfg) {
+
+  simflashObjectInit(&SF1);
+  simflashStart(&SF1, cfg);
+  ftlObjectInit(&FTLD1);
+  ftlStart(&FTLD1, &ftlcfg);
+  if (ftlConnect(&FTLD1)) {
+    chprintf(chp, "--- mount failed\r\n");
+    exit(1);
+  }
+}
+
+static void stop_ftl(void) {
+
+  ftlDisconnect(&FTLD1);
+  ftlStop(&FTLD1);
+  simflashStop(&SF1);
+}
+
+/*
+ * Picks a block, 90% of the writes hit 10% of the blocks.
+ */
+static uint32_t pick_block(void) {
+
+  if ((rand() % 10) != 0)
+    return rand() % (BLOCKS_NUM / 10);
+  return rand() % BLOCKS_NUM;
+}
+
+/*===========================================================================*/
+/* Benchmarks.                                                               */
+/*===========================================================================*/
+
+static void report(const char *name, uint64_t bytes, uint64_t elapsed) {
+  SimFlashStats st;
+
+  simflashGetStats(&SF1, &st);
+  chprintf(chp, "--- %s\r\n", name);
+  print_ratio("    host throughput   : ", bytes, elapsed, " MB/S\r\n");
+  print_ratio("    device throughput : ", bytes, st.busy_time, " MB/S\r\n");
+  print_ratio("    write amplif.     : ", st.program_bytes, bytes, "\r\n");
+  chprintf(chp, "    sector erases     : %u (wear %u..%u)\r\n",
+           st.erases, st.min_erases, st.max_erases);
+  if (st.violations) {
+    chprintf(chp, "    NOR violations    : %u\r\n", st.violations);
+    failed = TRUE;
+  }
+}
+
+static void bench_sequential(void) {
+  uint64_t start, bytes = 0;
+  uint32_t lba, pass;
+
+  start_ftl(&sfcfg);
+  simflashResetStats(&SF1);
+  start = now_us();
+  for (pass = 0; pass < 4; pass++) {
+    for (lba = 0; lba + 8 <= BLOCKS_NUM; lba += 8) {
+      fill(buf, lba, pass);
+      if (ftlWrite(&FTLD1, lba, buf, 8)) {
+        chprintf(chp, "--- write failed\r\n");
+        failed = TRUE;
+        break;
+      }
+      bytes += 8 * PAGE_SIZE;
+    }
+  }
+  report("Sequential append, 8 blocks per write, 4 passes",
+         bytes, now_us() - start);
+  stop_ftl();
+}
+
+static void bench_random(void) {
+  uint64_t start, bytes = 0;
+  uint32_t i, lba;
+
+  start_ftl(&sfcfg);
+  for (lba = 0; lba < BLOCKS_NUM; lba++) {
+    fill(buf, lba, 0);
+    (void)ftlWrite(&FTLD1, lba, buf, 1);
+  }
+  simflashResetStats(&SF1);
+  srand(1);
+  start = now_us();
+  for (i = 0; i < 20 * BLOCKS_NUM; i++) {
+    lba = pick_block();
+    fill(buf, lba, i);
+    if (ftlWrite(&FTLD1, lba, buf, 1)) {
+      chprintf(chp, "--- write failed\r\n");
+      failed = TRUE;
+      break;
+    }
+    bytes += PAGE_SIZE;
+  }
+  report("Random overwrite, full device, 90/10 hot spot",
+         bytes, now_us() - start);
+  stop_ftl();
+}
+
+/*
+ * Reference, blocks updated in place with a sector read-modify-write as
+ * a plain block device over NOR would do.
+ */
+static void bench_in_place(void) {
+  static uint8_t sector[SECTOR_SIZE];
+  BaseFlash *fp = (BaseFlash *)&SF1;
+  uint64_t start, bytes = 0;
+  uint32_t i, lba, s, p;
+
+  simflashObjectInit(&SF1);
+  simflashStart(&SF1, &sfcfg);
+  srand(1);
+  start = now_us();
+  for (i = 0; i < 2 * BLOCKS_NUM; i++) {
+    lba = pick_block();
+    s = lba / (SECTOR_SIZE / PAGE_SIZE);
+    fill(buf, lba, i);
+    flashRead(fp, s * SECTOR_SIZE, sector, SECTOR_SIZE);
+    memcpy(sector + (lba % (SECTOR_SIZE / PAGE_SIZE)) * PAGE_SIZE,
+           buf, PAGE_SIZE);
+    flashErase(fp, s);
+    for (p = 0; p < SECTOR_SIZE; p += PAGE_SIZE)
+      flashProgram(fp, s * SECTOR_SIZE + p, sector + p, PAGE_SIZE);
+    bytes += PAGE_SIZE;
+  }
+  report("In-place read-modify-write reference, 90/10 hot spot",
+         bytes, now_us() - start);
+  simflashStop(&SF1);
+}
+
+/*===========================================================================*/
+/* Torture.                                                                  */
+/*===========================================================================*/
+
+/*
+ * Verifies the whole device against the shadow copy, the blocks of the
+ * interrupted write may contain either the old or the new data.
+ */
+static bool_t verify(uint32_t pending, uint32_t n, uint32_t version) {
+  static uint8_t rd[PAGE_SIZE];
+  uint32_t lba;
+
+  for (lba = 0; lba < BLOCKS_NUM; lba++) {
+    if (ftlRead(&FTLD1, lba, rd, 1))
+      return CH_FAILED;
+    if (memcmp(rd, shadow[lba], PAGE_SIZE) == 0)
+      continue;
+    if ((lba >= pending) && (lba < pending + n)) {
+      fill(buf, lba, version);
+      if (memcmp(rd, buf, PAGE_SIZE) == 0) {
+        memcpy(shadow[lba], rd, PAGE_SIZE);
+        continue;
+      }
+    }
+    chprintf(chp, "--- block %u mismatch\r\n", lba);
+    return CH_FAILED;
+  }
+  return CH_SUCCESS;
+}
+
+static void torture(void) {
+  uint32_t cycle, lba, n, k, version = 0;
+  uint32_t pending = 0, pending_n = 0, pending_version = 0;
+
+  start_ftl(&sfcfg);
+  memset(shadow, FLASH_ERASED_VALUE, sizeof(shadow));
+  srand(2);
+  for (cycle = 0; cycle < TORTURE_CYCLES; cycle++) {
+    simflashInjectFailure(&SF1, 1 + rand() % 3000, cycle);
+    while (TRUE) {
+      n = 1 + rand() % 8;
+      lba = pick_block();
+      if (lba + n > BLOCKS_NUM)
+        lba = BLOCKS_NUM - n;
+      version++;
+      for (k = 0; k < n; k++)
+        fill(buf + k * PAGE_SIZE, lba + k, version);
+      pending = lba;
+      pending_n = n;
+      pending_version = version;
+      if (ftlWrite(&FTLD1, lba, buf, n))
+        break;
+      memcpy(shadow[lba], buf, n * PAGE_SIZE);
+    }
+
+    /* Power loss, the FTL state is rebuilt from the flash content.*/
+    simflashPowerCycle(&SF1);
+    ftlDisconnect(&FTLD1);
+    if (ftlConnect(&FTLD1) ||
+        verify(pending, pending_n, pending_version)) {
+      chprintf(chp, "--- torture failed at cycle %u\r\n", cycle);
+      failed = TRUE;
+      break;
+    }
+  }
+  chprintf(chp, "--- Torture, %u power failures, device %s\r\n",
+           cycle, failed ? "corrupted" : "consistent");
+  stop_ftl();
+}
+
+/*
+ * Checks that a file backed image survives a restart.
+ */
+static void persistence(void) {
+  static uint8_t rd[PAGE_SIZE];
+  uint32_t lba;
+
+  unlink(IMAGE_FILE);
+  start_ftl(&sfcfg_file);
+  for (lba = 0; lba < 64; lba++) {
+    fill(buf, lba, 7);
+    (void)ftlWrite(&FTLD1, lba * 13, buf, 1);
+  }
+  stop_ftl();
+  start_ftl(&sfcfg_file);
+  for (lba = 0; lba < 64; lba++) {
+    fill(buf, lba, 7);
+    if (ftlRead(&FTLD1, lba * 13, rd, 1) ||
+        (memcmp(rd, buf, PAGE_SIZE) != 0)) {
+      failed = TRUE;
+      break;
+    }
+  }
+  chprintf(chp, "--- File backed image %s\r\n",
+           lba == 64 ? "restored" : "corrupted");
+  stop_ftl();
+  unlink(IMAGE_FILE);
+}
+
+/*
+ * Application entry point.
+ */
+int main(void) {
+
+  halInit();
+  chSysInit();
+  conInit();
+
+  chprintf(chp, "*** FTL over simulated NOR, %u sectors of %u bytes, "
+                "%u blocks exported\r\n",
+           SECTORS_NUM, SECTOR_SIZE, BLOCKS_NUM);
+  bench_sequential();
+  bench_random();
+  bench_in_place();
+  torture();
+  persistence();
+
+  chprintf(chp, "\r\nFinal result: %s\r\n", failed ? "FAILURE" : "SUCCESS");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,333 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <string.h>
+#include <time.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "console.h"
+#include "simi2c.h"
+
+#define SENSORS             10
+#define SENSOR_ADDR         0x40
+#define EEPROM_ADDR         0x50
+#define BENCH_ROUNDS        2000
+
+static BaseSequentialStream *chp = (BaseSequentialStream *)&CD1;
+static bool_t failed;
+
+/*
+ * Unlimited bus speed, 100KHz and 400KHz.
+ */
+static const I2CConfig cfg_fast = {0};
+static const I2CConfig cfg_100k = {100000};
+static const I2CConfig cfg_400k = {400000};
+
+/*
+ * Sensors with four configuration registers followed by a 16 bits sample
+ * refreshed at each read, a 256 bytes EEPROM.
+ */
+static void sensor_sample(SimI2CRegsDevice *rdp, uint8_t reg) {
+  uint16_t sample;
+
+  if (reg == 4) {
+    sample = (uint16_t)((rdp->regs[4] << 8) | rdp->regs[5]) + 1;
+    rdp->regs[4] = (uint8_t)(sample >> 8);
+    rdp->regs[5] = (uint8_t)sample;
+  }
+}
+
+static const SimI2CRegsConfig sensor_cfg[SENSORS] = {
+  {SENSOR_ADDR + 0, 8, 4, sensor_sample},
+  {SENSOR_ADDR + 1, 8, 4, sensor_sample},
+  {SENSOR_ADDR + 2, 8, 4, sensor_sample},
+  {SENSOR_ADDR + 3, 8, 4, sensor_sample},
+  {SENSOR_ADDR + 4, 8, 4, sensor_sample},
+  {SENSOR_ADDR + 5, 8, 4, sensor_sample},
+  {SENSOR_ADDR + 6, 8, 4, sensor_sample},
+  {SENSOR_ADDR + 7, 8, 4, sensor_sample},
+  {SENSOR_ADDR + 8, 8, 4, sensor_sample},
+  {SENSOR_ADDR + 9, 8, 4, sensor_sample}
+};
+static const SimI2CRegsConfig eeprom_cfg = {EEPROM_ADDR, 256, 256, NULL};
+static SimI2CRegsDevice sensors[SENSORS];
+static SimI2CRegsDevice eeprom;
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Prints a ratio with two decimals.
+ */
+static void print_ratio(const char *label, uint64_t num, uint64_t den,
+                        const char *unit) {
+  uint64_t r = den ? (num * 100) / den : 0;
+
+  chprintf(chp, "%s%u.%02u%s", label, (unsigned)(r / 100),
+           (unsigned)(r % 100), unit);
+}
+
+static void check(bool_t cond, const char *msg) {
+
+  if (!cond) {
+    chprintf(chp, "--- failed: %s\r\n", msg);
+    failed = TRUE;
+  }
+}
+
+static void set_txn(I2CTransaction *itp, i2caddr_t addr,
+                    const uint8_t *txbuf, size_t txbytes,
+                    uint8_t *rxbuf, size_t rxbytes) {
+
+  memset(itp, 0, sizeof (*itp));
+  itp->addr = addr;
+  itp->txbuf = txbuf;
+  itp->txbytes = txbytes;
+  itp->rxbuf = rxbuf;
+  itp->rxbytes = rxbytes;
+  itp->timeout = TIME_INFINITE;
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+/*
+ * EEPROM write, read back with a repeated start and read only transaction
+ * continuing from the register pointer, executed as a single batch.
+ */
+static void transfers(void) {
+  static const uint8_t wr[9] = {0x10, 1, 2, 3, 4, 5, 6, 7, 8};
+  static const uint8_t ptr = 0x10;
+  uint8_t rd1[4], rd2[4];
+  I2CTransaction txns[3];
+  uint32_t ops = I2CD1.operations;
+
+  set_txn(&txns[0], EEPROM_ADDR, wr, 9, NULL, 0);
+  set_txn(&txns[1], EEPROM_ADDR, &ptr, 1, rd1, 4);
+  set_txn(&txns[2], EEPROM_ADDR, NULL, 0, rd2, 4);
+  check(i2cTransactionBatch(&I2CD1, txns, 3) == RDY_OK, "batch status");
+  check(memcmp(rd1, &wr[1], 4) == 0, "repeated start read");
+  check(memcmp(rd2, &wr[5], 4) == 0, "read only transaction");
+  check(I2CD1.operations == ops + 3, "operations count");
+  check(I2CD1.state == I2C_READY, "driver state");
+
+  chprintf(chp, "--- Transfers: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+/*
+ * A missing device and a write to read only registers are not
+ * acknowledged, the following transactions are executed anyway.
+ */
+static void errors(void) {
+  static const uint8_t ro[2] = {4, 0x55};
+  static const uint8_t ptr = 0;
+  uint8_t rd[2];
+  I2CTransaction txns[3];
+
+  set_txn(&txns[0], 0x33, &ptr, 1, rd, 2);
+  set_txn(&txns[1], SENSOR_ADDR, ro, 2, NULL, 0);
+  set_txn(&txns[2], SENSOR_ADDR, &ptr, 1, rd, 2);
+  check(i2cTransactionBatch(&I2CD1, txns, 3) == RDY_RESET, "batch status");
+  check((txns[0].status == RDY_RESET) &&
+        (txns[0].errors == I2CD_ACK_FAILURE), "missing device");
+  check((txns[1].status == RDY_RESET) &&
+        (txns[1].errors == I2CD_ACK_FAILURE), "read only register");
+  check((txns[2].status == RDY_OK) &&
+        (txns[2].errors == I2CD_NO_ERROR), "following transaction");
+
+  chprintf(chp, "--- Errors: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+/*
+ * Completion order recorded by the callback.
+ */
+static I2CTransaction *completed[4];
+static unsigned ncompleted;
+
+static void txn_end(I2CDriver *i2cp, I2CTransaction *itp) {
+
+  (void)i2cp;
+  if (ncompleted < 4)
+    completed[ncompleted++] = itp;
+}
+
+static I2CTransaction ptxns[4];
+static WORKING_AREA(waClient1, 1024);
+static WORKING_AREA(waClient2, 1024);
+static WORKING_AREA(waClient3, 1024);
+
+static msg_t client(void *p) {
+
+  return i2cTransaction(&I2CD1, (I2CTransaction *)p);
+}
+
+/*
+ * While a long transaction is on the bus the clients queue their own
+ * transactions, the queue is served in priority order.
+ */
+static void priority(void) {
+  static const unsigned expected[4] = {0, 2, 3, 1};
+  static const uint8_t ptr = 4;
+  static uint8_t long_rd[200], rd[3][2];
+  Thread *tp1, *tp2, *tp3;
+  unsigned i;
+
+  i2cStart(&I2CD1, &cfg_100k);
+  ncompleted = 0;
+  set_txn(&ptxns[0], EEPROM_ADDR, &ptr, 1, long_rd, sizeof long_rd);
+  for (i = 1; i < 4; i++)
+    set_txn(&ptxns[i], SENSOR_ADDR + i, &ptr, 1, rd[i - 1], 2);
+  for (i = 0; i < 4; i++)
+    ptxns[i].end_cb = txn_end;
+  i2cStartTransaction(&I2CD1, &ptxns[0]);
+  tp1 = chThdCreateStatic(waClient1, sizeof(waClient1), NORMALPRIO + 1,
+                          client, &ptxns[1]);
+  tp2 = chThdCreateStatic(waClient2, sizeof(waClient2), NORMALPRIO + 3,
+                          client, &ptxns[2]);
+  tp3 = chThdCreateStatic(waClient3, sizeof(waClient3), NORMALPRIO + 2,
+                          client, &ptxns[3]);
+  check(ncompleted == 0, "long transaction");
+  check(chThdWait(tp1) == RDY_OK, "client 1 status");
+  check(chThdWait(tp2) == RDY_OK, "client 2 status");
+  check(chThdWait(tp3) == RDY_OK, "client 3 status");
+  check(ncompleted == 4, "completed transactions");
+  for (i = 0; i < 4; i++)
+    check(completed[i] == &ptxns[expected[i]], "completion order");
+  i2cStart(&I2CD1, &cfg_fast);
+
+  chprintf(chp, "--- Priority order: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+/*
+ * A slave holds the bus, the transaction in progress and the queued one
+ * time out and the driver must be restarted.
+ */
+static void timeout(void) {
+  static const uint8_t ptr = 4;
+  uint8_t rd[2][2];
+  I2CTransaction txns[2];
+  uint64_t start, elapsed;
+
+  i2cSimHoldBus(&I2CD1, TRUE);
+  set_txn(&txns[0], SENSOR_ADDR, &ptr, 1, rd[0], 2);
+  set_txn(&txns[1], SENSOR_ADDR + 1, &ptr, 1, rd[1], 2);
+  txns[0].timeout = MS2ST(20);
+  start = now_us();
+  check(i2cTransactionBatch(&I2CD1, txns, 2) == RDY_TIMEOUT,
+        "batch status");
+  elapsed = now_us() - start;
+  check((txns[0].status == RDY_TIMEOUT) && (txns[1].status == RDY_TIMEOUT),
+        "transactions status");
+  check(elapsed >= 15000, "timeout time");
+  check(I2CD1.state == I2C_LOCKED, "driver locked");
+  i2cSimHoldBus(&I2CD1, FALSE);
+
+  i2cStop(&I2CD1);
+  i2cStart(&I2CD1, &cfg_fast);
+  check(i2cMasterTransmitTimeout(&I2CD1, SENSOR_ADDR, &ptr, 1, rd[0], 2,
+                                 MS2ST(20)) == RDY_OK, "restarted driver");
+
+  chprintf(chp, "--- Timeout: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+/*
+ * Polling all the sensors with the synchronous API under the bus mutex
+ * against a single batch of transactions.
+ */
+static void benchmark(const I2CConfig *config, const char *name) {
+  static const uint8_t ptr = 4;
+  static uint8_t rd[SENSORS][2];
+  static I2CTransaction txns[SENSORS];
+  uint64_t start, single, batched;
+  uint16_t before, after;
+  unsigned i, j;
+
+  i2cStart(&I2CD1, config);
+  for (i = 0; i < SENSORS; i++)
+    set_txn(&txns[i], SENSOR_ADDR + i, &ptr, 1, rd[i], 2);
+
+  start = now_us();
+  for (i = 0; i < BENCH_ROUNDS; i++) {
+    i2cAcquireBus(&I2CD1);
+    for (j = 0; j < SENSORS; j++)
+      i2cMasterTransmitTimeout(&I2CD1, SENSOR_ADDR + j, &ptr, 1, rd[j], 2,
+                               TIME_INFINITE);
+    i2cReleaseBus(&I2CD1);
+  }
+  single = now_us() - start;
+  before = (uint16_t)((rd[SENSORS - 1][0] << 8) | rd[SENSORS - 1][1]);
+
+  start = now_us();
+  for (i = 0; i < BENCH_ROUNDS; i++)
+    check(i2cTransactionBatch(&I2CD1, txns, SENSORS) == RDY_OK,
+          "batch status");
+  batched = now_us() - start;
+  after = (uint16_t)((rd[SENSORS - 1][0] << 8) | rd[SENSORS - 1][1]);
+  check((uint16_t)(after - before) == BENCH_ROUNDS, "sensor samples");
+
+  chprintf(chp, "--- Benchmark %s, %u sensors per round\r\n", name,
+           SENSORS);
+  print_ratio("    synchronous API   : ",
+              (uint64_t)BENCH_ROUNDS * SENSORS * 1000000, single,
+              " reads/S\r\n");
+  print_ratio("    transactions      : ",
+              (uint64_t)BENCH_ROUNDS * SENSORS * 1000000, batched,
+              " reads/S\r\n");
+  print_ratio("    speedup           : ", single, batched, "\r\n");
+}
+
+/*
+ * Application entry point.
+ */
+int main(void) {
+  unsigned i;
+
+  halInit();
+  chSysInit();
+  conInit();
+
+  for (i = 0; i < SENSORS; i++) {
+    simi2cObjectInit(&sensors[i]);
+    simi2cStart(&sensors[i], &sensor_cfg[i], &I2CD1);
+  }
+  simi2cObjectInit(&eeprom);
+  simi2cStart(&eeprom, &eeprom_cfg, &I2CD1);
+
+  chprintf(chp, "*** I2C driver transactions, simulated bus with %u "
+           "devices\r\n", SENSORS + 1);
+  i2cStart(&I2CD1, &cfg_fast);
+  transfers();
+  errors();
+  priority();
+  timeout();
+  benchmark(&cfg_fast, "unlimited speed");
+  benchmark(&cfg_400k, "at 400KHz");
+  i2cStop(&I2CD1);
+
+  chprintf(chp, "\r\nFinal result: %s\r\n", failed ? "FAILURE" : "SUCCESS");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,454 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <string.h>
+#include <time.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "console.h"
+
+#define CLOCK               1000000
+#define TRAIN_CYCLES        64
+#define RING_SIZE           1024
+#define BATCH_SIZE          256
+#define CHECK_EDGES         20000
+#define BENCH_EDGES         200000
+#define REALTIME_MS         200
+
+static BaseSequentialStream *chp = (BaseSequentialStream *)&CD1;
+static bool_t failed;
+
+static uint32_t train[TRAIN_CYCLES * 2];
+static const uint32_t slow[2] = {400, 600};
+static icucnt_t ring[RING_SIZE];
+static icucnt_t edges[RING_SIZE / 2];
+
+static const ICUCaptureConfig capcfg = {ring, RING_SIZE};
+
+/*
+ * Expected values, computed over the whole train.
+ */
+static uint32_t train_period, train_width;
+
+/*
+ * Callbacks mode state.
+ */
+static BinarySemaphore done;
+static uint32_t cb_edges, cb_limit, cb_errors;
+static uint32_t cb_cycles, cb_period, cb_width;
+static size_t cb_cycle;
+
+static void width_cb(ICUDriver *icup);
+static void period_cb(ICUDriver *icup);
+
+static const ICUConfig cfg_fast = {
+  ICU_INPUT_ACTIVE_HIGH, CLOCK, width_cb, period_cb, NULL,
+  train, TRAIN_CYCLES * 2, FALSE
+};
+
+static const ICUConfig cfg_realtime = {
+  ICU_INPUT_ACTIVE_HIGH, CLOCK, width_cb, period_cb, NULL,
+  train, TRAIN_CYCLES * 2, TRUE
+};
+
+static const ICUConfig cfg_slow = {
+  ICU_INPUT_ACTIVE_HIGH, CLOCK, width_cb, period_cb, NULL,
+  slow, 2, TRUE
+};
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void check(bool_t cond, const char *msg) {
+
+  if (!cond) {
+    chprintf(chp, "--- failed: %s\r\n", msg);
+    failed = TRUE;
+  }
+}
+
+/*
+ * Pulse train of a flow meter at about 50KHz with a 1MHz counter, the
+ * period and the duty cycle wander pseudo-randomly.
+ */
+static void record(void) {
+  uint32_t seed = 12345, period, width;
+  unsigned i;
+
+  train_period = 0;
+  train_width  = 0;
+  for (i = 0; i < TRAIN_CYCLES; i++) {
+    seed = seed * 1103515245 + 12345;
+    period = 18 + (seed >> 16) % 5;
+    width  = 6 + (seed >> 24) % 6;
+    train[i * 2]     = width;
+    train[i * 2 + 1] = period - width;
+    train_period += period;
+    train_width  += width;
+  }
+}
+
+/*
+ * Edge durations in the train, from the edge with the given sequence
+ * number to the next one.
+ */
+static uint32_t duration(uint32_t seq) {
+
+  return train[seq % (TRAIN_CYCLES * 2)];
+}
+
+/*
+ * Verifies the timestamps of a batch against the train.
+ */
+static bool_t verify(const ICUBatch *bp) {
+  size_t i;
+
+  for (i = 1; i < bp->n; i++)
+    if ((icucnt_t)(bp->edges[i] - bp->edges[i - 1]) !=
+        (icucnt_t)duration(bp->first + i - 1))
+      return FALSE;
+  return TRUE;
+}
+
+/*===========================================================================*/
+/* Callbacks mode.                                                           */
+/*===========================================================================*/
+
+/*
+ * The callbacks accumulate the same totals as the batch kernels.
+ */
+static void width_cb(ICUDriver *icup) {
+  icucnt_t width = icuGetWidth(icup);
+
+  if (width != train[cb_cycle * 2])
+    cb_errors++;
+  cb_width += width;
+  cb_edges++;
+}
+
+static void period_cb(ICUDriver *icup) {
+  icucnt_t period = icuGetPeriod(icup);
+
+  if (period != train[cb_cycle * 2] + train[cb_cycle * 2 + 1])
+    cb_errors++;
+  cb_period += period;
+  cb_cycles++;
+  if (++cb_cycle >= TRAIN_CYCLES)
+    cb_cycle = 0;
+  if (++cb_edges >= cb_limit) {
+    chSysLockFromIsr();
+    icuDisableI(icup);
+    chBSemSignalI(&done);
+    chSysUnlockFromIsr();
+  }
+}
+
+/*
+ * Runs the callbacks mode for the specified number of edges.
+ */
+static void run_callbacks(const ICUConfig *cfg, uint32_t n) {
+
+  /* The first active edge is not reported.*/
+  cb_edges  = 1;
+  cb_limit  = n;
+  cb_errors = 0;
+  cb_cycles = 0;
+  cb_period = 0;
+  cb_width  = 0;
+  cb_cycle  = 0;
+  icuStart(&ICUD1, cfg);
+  icuEnable(&ICUD1);
+  chBSemWait(&done);
+  icuDisable(&ICUD1);
+}
+
+/*===========================================================================*/
+/* Capture mode.                                                             */
+/*===========================================================================*/
+
+/*
+ * Fetches and measures batches until the specified number of edges has
+ * been seen or the time runs out.
+ */
+static uint32_t run_capture(ICUMeasure *mp, size_t batch, uint32_t n,
+                            systime_t sleep, bool_t *okp) {
+  ICUBatch b;
+  uint32_t seen = 0, lost = 0;
+  msg_t msg;
+
+  b.edges = edges;
+  b.max   = batch;
+  icuMeasureReset(mp);
+  while (seen < n) {
+    msg = icuFetchCapture(&ICUD1, &b, MS2ST(500));
+    if (msg == RDY_RESET)
+      break;
+    if ((msg == RDY_TIMEOUT) && (b.n == 0)) {
+      *okp = FALSE;
+      break;
+    }
+    if ((b.first != seen + b.lost) || !verify(&b))
+      *okp = FALSE;
+    icuMeasureBatch(mp, &b);
+    seen += b.lost + (uint32_t)b.n;
+    lost += b.lost;
+    if (sleep != 0)
+      chThdSleep(sleep);
+  }
+  return lost;
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+/*
+ * Each width and period reported by the callbacks matches the train.
+ */
+static void callbacks(void) {
+
+  run_callbacks(&cfg_fast, CHECK_EDGES);
+  check(cb_errors == 0, "callback values");
+  check(cb_cycles == CHECK_EDGES / 2, "callback cycles");
+
+  chprintf(chp, "--- Callbacks: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+/*
+ * The timestamps fetched in batches match the train, the kernels results
+ * are exact over a whole train, also when split across batches.
+ */
+static void capture(void) {
+  ICUMeasure m, whole, split;
+  ICUCaptureStats stats;
+  ICUBatch b;
+  bool_t ok = TRUE;
+  uint32_t lost;
+
+  icuStart(&ICUD1, &cfg_fast);
+  icuStartCapture(&ICUD1, &capcfg);
+  b.edges = edges;
+  b.max   = BATCH_SIZE;
+  check(icuFetchCapture(&ICUD1, &b, MS2ST(500)) == RDY_OK, "first batch");
+  check((b.first == 0) && (b.lost == 0) && verify(&b), "first timestamps");
+
+  /* One whole train plus the closing active edge.*/
+  icuMeasureReset(&whole);
+  b.n = TRAIN_CYCLES * 2 + 1;
+  icuMeasureBatch(&whole, &b);
+  icuMeasureReset(&split);
+  b.n = 37;
+  icuMeasureBatch(&split, &b);
+  b.edges += 37;
+  b.first  = 37;
+  b.n      = TRAIN_CYCLES * 2 + 1 - 37;
+  icuMeasureBatch(&split, &b);
+  check((whole.cycles == TRAIN_CYCLES) && (whole.period == train_period) &&
+        (whole.width == train_width), "train totals");
+  check((split.cycles == whole.cycles) && (split.period == whole.period) &&
+        (split.width == whole.width), "split train totals");
+  check(icuMeasurePulses(&whole) == TRAIN_CYCLES + 1, "train pulses");
+  check(icuMeasureFrequency(&whole, CLOCK, 1000) ==
+        (uint32_t)(((uint64_t)CLOCK * 1000 * TRAIN_CYCLES +
+                    train_period / 2) / train_period), "frequency");
+  check(icuMeasureDuty(&whole, 10000) ==
+        (train_width * 10000 + train_period / 2) / train_period, "duty");
+
+  /* Restarting the capture restarts the sequence numbers.*/
+  icuStopCapture(&ICUD1);
+  icuStartCapture(&ICUD1, &capcfg);
+  lost = run_capture(&m, BATCH_SIZE, CHECK_EDGES, 0, &ok);
+  icuGetCaptureStats(&ICUD1, &stats);
+  icuStopCapture(&ICUD1);
+  check(ok, "timestamps");
+  check((lost == 0) && (stats.lost == 0), "no lost edges");
+  check(stats.batches > CHECK_EDGES / BATCH_SIZE, "batches");
+  check(icuMeasurePulses(&m) == m.cycles + 1, "pulses");
+
+  chprintf(chp, "--- Capture: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+/*
+ * A reader sleeping while the train is replayed in real time falls behind
+ * and loses edges, the pulses count stays exact and the cycles tracking
+ * restarts after each gap.
+ */
+static void overrun(void) {
+  ICUMeasure m;
+  ICUCaptureStats stats;
+  bool_t ok = TRUE;
+  uint32_t lost, f, expected;
+
+  icuStart(&ICUD1, &cfg_realtime);
+  icuStartCapture(&ICUD1, &capcfg);
+  lost = run_capture(&m, BATCH_SIZE, CHECK_EDGES, MS2ST(20), &ok);
+  icuGetCaptureStats(&ICUD1, &stats);
+  icuStopCapture(&ICUD1);
+  check(ok, "timestamps");
+  check(lost > 0, "lost edges");
+  check(stats.lost == lost, "lost edges statistics");
+  check(stats.high_water > RING_SIZE / 2, "high water mark");
+  check(icuMeasurePulses(&m) == (m.next + 1) / 2, "pulses");
+  f = icuMeasureFrequency(&m, CLOCK, 1);
+  expected = (uint32_t)((uint64_t)CLOCK * TRAIN_CYCLES / train_period);
+  check((f > expected - expected / 50) && (f < expected + expected / 50),
+        "frequency");
+
+  chprintf(chp, "--- Overrun: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+static WORKING_AREA(waReader, 1024);
+
+static msg_t reader(void *p) {
+  static icucnt_t buf[16];
+  ICUBatch b;
+
+  (void)p;
+  b.edges = buf;
+  b.max   = 16;
+  return icuFetchCapture(&ICUD1, &b, TIME_INFINITE);
+}
+
+/*
+ * Partial batches on timeout, a stop releases a waiting reader.
+ */
+static void timeout_stop(void) {
+  ICUBatch b;
+  Thread *tp;
+
+  icuStart(&ICUD1, &cfg_slow);
+  icuStartCapture(&ICUD1, &capcfg);
+  b.edges = edges;
+  b.max   = BATCH_SIZE;
+  check(icuFetchCapture(&ICUD1, &b, TIME_IMMEDIATE) == RDY_TIMEOUT,
+        "immediate timeout");
+  check(b.n == 0, "empty batch");
+  tp = chThdCreateStatic(waReader, sizeof(waReader), NORMALPRIO + 1,
+                         reader, NULL);
+  chThdSleepMilliseconds(5);
+  icuStopCapture(&ICUD1);
+  check(chThdWait(tp) == RDY_RESET, "reader released");
+  check(ICUD1.state == ICU_READY, "driver state");
+  check(icuFetchCapture(&ICUD1, &b, TIME_INFINITE) == RDY_RESET,
+        "fetch after stop");
+
+  chprintf(chp, "--- Timeout and stop: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+/*
+ * The train replayed in real time, the reader must keep up.
+ */
+static void realtime(void) {
+  ICUMeasure m;
+  ICUCaptureStats stats;
+  bool_t ok = TRUE;
+  uint32_t lost, f, expected;
+  uint64_t start;
+
+  icuStart(&ICUD1, &cfg_realtime);
+  icuStartCapture(&ICUD1, &capcfg);
+  start = now_us();
+  lost = run_capture(&m, BATCH_SIZE,
+                     (uint32_t)((uint64_t)CLOCK * REALTIME_MS / 1000 *
+                                TRAIN_CYCLES * 2 / train_period),
+                     0, &ok);
+  start = now_us() - start;
+  icuGetCaptureStats(&ICUD1, &stats);
+  icuStopCapture(&ICUD1);
+  check(ok, "timestamps");
+  check(lost == 0, "no lost edges");
+  f = icuMeasureFrequency(&m, CLOCK, 1);
+  expected = (uint32_t)((uint64_t)CLOCK * TRAIN_CYCLES / train_period);
+  check((f > expected - expected / 100) && (f < expected + expected / 100),
+        "frequency");
+
+  chprintf(chp, "--- Real time: %s\r\n", failed ? "FAILED" : "ok");
+  chprintf(chp, "    frequency         : %u Hz\r\n", f);
+  chprintf(chp, "    duty cycle        : %u%%\r\n", icuMeasureDuty(&m, 100));
+  chprintf(chp, "    pulses            : %u in %u mS\r\n",
+           icuMeasurePulses(&m), (unsigned)(start / 1000));
+  chprintf(chp, "    batches           : %u, high water %u edges\r\n",
+           stats.batches, (unsigned)stats.high_water);
+}
+
+/*
+ * CPU time per edge, callbacks against batches, the train is replayed as
+ * fast as possible.
+ */
+static void benchmark(void) {
+  static const size_t batches[] = {32, 128, 512};
+  ICUMeasure m;
+  bool_t ok = TRUE;
+  uint64_t start, t_cb, t;
+  unsigned i;
+
+  start = now_us();
+  run_callbacks(&cfg_fast, BENCH_EDGES);
+  t_cb = now_us() - start;
+  check(cb_errors == 0, "callback values");
+  chprintf(chp, "--- Callbacks        : %u nS/edge\r\n",
+           (unsigned)(t_cb * 1000 / BENCH_EDGES));
+
+  for (i = 0; i < sizeof batches / sizeof batches[0]; i++) {
+    icuStart(&ICUD1, &cfg_fast);
+    icuStartCapture(&ICUD1, &capcfg);
+    start = now_us();
+    run_capture(&m, batches[i], BENCH_EDGES, 0, &ok);
+    t = now_us() - start;
+    icuStopCapture(&ICUD1);
+    check(ok, "timestamps");
+    check(m.cycles >= BENCH_EDGES / 2 - 1, "cycles");
+    chprintf(chp, "--- Batches of %3u   : %u nS/edge, %u.%02ux\r\n",
+             (unsigned)batches[i], (unsigned)(t * 1000 / BENCH_EDGES),
+             (unsigned)(t_cb / t), (unsigned)(t_cb * 100 / t % 100));
+  }
+}
+
+/*
+ * Application entry point.
+ */
+int main(void) {
+
+  halInit();
+  chSysInit();
+  conInit();
+  chBSemInit(&done, TRUE);
+  record();
+
+  chprintf(chp, "*** ICU capture, simulated timer replaying a pulse train\r\n");
+  callbacks();
+  capture();
+  overrun();
+  timeout_stop();
+  realtime();
+
+  chprintf(chp, "\r\n*** CPU time per edge, %u edges\r\n", BENCH_EDGES);
+  benchmark();
+  icuStop(&ICUD1);
+
+  chprintf(chp, "\r\nFinal result: %s\r\n", failed ? "FAILURE" : "SUCCESS");
+  return failed ? 1 : 0;
+}
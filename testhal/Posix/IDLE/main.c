@@ -0,0 +1,174 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "console.h"
+
+#define IDLE_TIME_MS        2000
+#define IDLE_CPU_LIMIT      10
+#define JITTER_RUNS         1000
+
+static BaseSequentialStream *chp = (BaseSequentialStream *)&CD1;
+static bool_t failed;
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+static void check(bool_t cond, const char *msg) {
+
+  if (!cond) {
+    chprintf(chp, "--- failed: %s\r\n", msg);
+    failed = TRUE;
+  }
+}
+
+static void result(const char *name, bool_t ok) {
+
+  chprintf(chp, "--- %s: %s\r\n", name, ok ? "ok" : "FAILED");
+}
+
+static uint64_t tv_us(const struct timeval *tvp) {
+
+  return (uint64_t)tvp->tv_sec * 1000000 + tvp->tv_usec;
+}
+
+/*
+ * Host CPU time used by the process in microseconds.
+ */
+static uint64_t cpu_us(void) {
+  struct rusage ru;
+
+  getrusage(RUSAGE_SELF, &ru);
+  return tv_us(&ru.ru_utime) + tv_us(&ru.ru_stime);
+}
+
+static uint64_t wall_us(void) {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv_us(&tv);
+}
+
+/*===========================================================================*/
+/* Idle host CPU.                                                            */
+/*===========================================================================*/
+
+/*
+ * All the threads sleep, the simulator must not consume host CPU while
+ * waiting for the system tick and the serial port connections.
+ */
+static void idle_cpu(void) {
+  uint64_t cpu, wall;
+  unsigned permille;
+  bool_t ok;
+
+  cpu = cpu_us();
+  wall = wall_us();
+  chThdSleepMilliseconds(IDLE_TIME_MS);
+  cpu = cpu_us() - cpu;
+  wall = wall_us() - wall;
+  permille = (unsigned)((cpu * 1000) / wall);
+
+  chprintf(chp, "--- Idle for %U ms, host CPU %U us (%u.%u%%)\r\n",
+           (uint32_t)(wall / 1000), (uint32_t)cpu,
+           permille / 10, permille % 10);
+  ok = permille < IDLE_CPU_LIMIT * 10;
+  check(ok, "idle host CPU above the limit");
+  result("Idle CPU", ok);
+}
+
+/*===========================================================================*/
+/* Tick jitter.                                                              */
+/*===========================================================================*/
+
+/*
+ * A thread sleeping one tick at a time is woken by each system tick, the
+ * wakeup intervals are measured with the realtime counter.
+ */
+static void tick_jitter(void) {
+  const halrtcnt_t period = halGetCounterFrequency() / CH_FREQUENCY;
+  halrtcnt_t last, now, dt, min, max;
+  uint64_t sum, wall;
+  systime_t start;
+  unsigned i, late, permille;
+  bool_t ok;
+
+  min = (halrtcnt_t)-1;
+  max = 0;
+  late = 0;
+  sum = 0;
+  chThdSleep(1);
+  last = halGetCounterValue();
+  start = chTimeNow();
+  wall = wall_us();
+  for (i = 0; i < JITTER_RUNS; i++) {
+    chThdSleep(1);
+    now = halGetCounterValue();
+    dt = now - last;
+    last = now;
+    sum += dt;
+    if (dt < min)
+      min = dt;
+    if (dt > max)
+      max = dt;
+    if (dt > period * 2)
+      late++;
+  }
+  wall = wall_us() - wall;
+  permille = (unsigned)(((uint64_t)(chTimeNow() - start) * 1000000000 /
+                         CH_FREQUENCY) / wall);
+
+  chprintf(chp, "--- Tick period %U ns, %U wakeups\r\n",
+           (uint32_t)period, (uint32_t)JITTER_RUNS);
+  chprintf(chp, "--- Interval min %U ns, avg %U ns, max %U ns\r\n",
+           (uint32_t)min, (uint32_t)(sum / JITTER_RUNS), (uint32_t)max);
+  chprintf(chp, "--- Jitter %U ns, late wakeups %U\r\n",
+           (uint32_t)(max - min), (uint32_t)late);
+  chprintf(chp, "--- System time rate %u.%u%% of the host time\r\n",
+           permille / 10, permille % 10);
+
+  /* The late ticks are caught up, the system time must not drift.*/
+  ok = (permille >= 990) && (permille <= 1010);
+  check(ok, "system time drift");
+  result("Tick jitter", ok);
+}
+
+/*===========================================================================*/
+/* Main.                                                                     */
+/*===========================================================================*/
+
+int main(void) {
+
+  halInit();
+  chSysInit();
+  conInit();
+
+  /* The serial port listening socket is an interrupt source.*/
+  sdStart(&SD1, NULL);
+
+  chprintf(chp, "*** Simulator interrupt engine, idle node\r\n");
+  idle_cpu();
+  tick_jitter();
+
+  chprintf(chp, "\r\nFinal result: %s\r\n", failed ? "FAILURE" : "SUCCESS");
+  return failed ? 1 : 0;
+}
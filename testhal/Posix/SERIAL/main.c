@@ -0,0 +1,227 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "console.h"
+
+#define TRANSFER_SIZE       1000000
+#define CHUNK_SIZE          4096
+
+static BaseSequentialStream *chp = (BaseSequentialStream *)&CD1;
+static bool_t failed;
+
+/*
+ * Tested configurations, the transfer size is not a multiple of the
+ * block sizes so the last partial block is flushed by the idle line
+ * detection.
+ */
+static const struct {
+  const char    *name;
+  SerialConfig  config;
+} configs[] = {
+  {"per byte       ", {0, 0}},
+  {"16 bytes block ", {16, 0}},
+  {"64 bytes block ", {64, 0}},
+  {"256 bytes block", {256, 0}},
+  {"256, idle 1mS  ", {256, 1000}}
+};
+
+#define NUM_CONFIGS (sizeof (configs) / sizeof (configs[0]))
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Prints a ratio with two decimals.
+ */
+static void print_ratio(const char *label, uint64_t num, uint64_t den,
+                        const char *unit) {
+  uint64_t r = den ? (num * 100) / den : 0;
+
+  chprintf(chp, "%s%u.%02u%s", label, (unsigned)(r / 100),
+           (unsigned)(r % 100), unit);
+}
+
+static uint8_t pattern(uint32_t i) {
+
+  return (uint8_t)(i ^ (i >> 8) ^ (i >> 16));
+}
+
+/*===========================================================================*/
+/* Peer process.                                                             */
+/*===========================================================================*/
+
+/*
+ * The peer connects to SD2 once for each configuration, sends the test
+ * pattern, receives it back, acknowledges it and waits for the driver to
+ * close the connection.
+ */
+static void peer(void) {
+  static uint8_t buf[CHUNK_SIZE];
+  struct sockaddr_in sad;
+  unsigned cfg;
+  uint32_t i, n;
+  int s, r;
+
+  memset(&sad, 0, sizeof(sad));
+  sad.sin_family = AF_INET;
+  sad.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sad.sin_port = htons(SIM_SD2_PORT);
+  for (cfg = 0; cfg < NUM_CONFIGS; cfg++) {
+    while (TRUE) {
+      s = socket(PF_INET, SOCK_STREAM, 0);
+      if (connect(s, (struct sockaddr *)&sad, sizeof(sad)) == 0)
+        break;
+      close(s);
+      usleep(1000);
+    }
+    for (i = 0; i < TRANSFER_SIZE; i += n) {
+      n = TRANSFER_SIZE - i < CHUNK_SIZE ? TRANSFER_SIZE - i : CHUNK_SIZE;
+      for (r = 0; r < (int)n; r++)
+        buf[r] = pattern(i + r);
+      if (send(s, buf, n, 0) != (int)n)
+        exit(1);
+    }
+    for (i = 0; i < TRANSFER_SIZE; i += r) {
+      r = recv(s, buf, sizeof(buf), 0);
+      if (r <= 0)
+        exit(1);
+      for (n = 0; n < (uint32_t)r; n++)
+        if (buf[n] != pattern(i + n))
+          exit(1);
+    }
+
+    /* Acknowledge and wait for the driver stop.*/
+    buf[0] = 0;
+    if (send(s, buf, 1, 0) != 1)
+      exit(1);
+    while (recv(s, buf, sizeof(buf), 0) > 0)
+      ;
+    close(s);
+  }
+  exit(0);
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+/*
+ * Receives the test pattern and sends it back, the driver is stopped when
+ * the peer acknowledges the data.
+ */
+static void transfer(unsigned cfg) {
+  static uint8_t buf[CHUNK_SIZE];
+  uint64_t start, rxtime, txtime;
+  uint32_t i, j, errors, rxirq;
+  size_t n;
+
+  sdStart(&SD2, &configs[cfg].config);
+
+  /* Receive, the time is measured from the first byte.*/
+  n = sdReadTimeout(&SD2, buf, 1, S2ST(10));
+  start = now_us();
+  errors = 0;
+  i = 0;
+  while (n > 0) {
+    for (j = 0; j < n; j++)
+      if (buf[j] != pattern(i + j))
+        errors++;
+    i += n;
+    if (i >= TRANSFER_SIZE)
+      break;
+    n = TRANSFER_SIZE - i < CHUNK_SIZE ? TRANSFER_SIZE - i : CHUNK_SIZE;
+    n = sdReadTimeout(&SD2, buf, n, MS2ST(500));
+  }
+  rxtime = now_us() - start;
+  rxirq = SD2.rxirq;
+  if ((i != TRANSFER_SIZE) || (errors > 0)) {
+    chprintf(chp, "--- failed: %u bytes received, %u errors\r\n",
+             i, errors);
+    failed = TRUE;
+  }
+
+  /* Transmit, the time is measured until the peer acknowledges.*/
+  start = now_us();
+  for (i = 0; i < TRANSFER_SIZE; i += n) {
+    n = TRANSFER_SIZE - i < CHUNK_SIZE ? TRANSFER_SIZE - i : CHUNK_SIZE;
+    for (j = 0; j < n; j++)
+      buf[j] = pattern(i + j);
+    sdWrite(&SD2, buf, n);
+  }
+  if (sdGetTimeout(&SD2, S2ST(10)) != 0) {
+    chprintf(chp, "--- failed: no acknowledge\r\n");
+    failed = TRUE;
+  }
+  txtime = now_us() - start;
+  sdStop(&SD2);
+
+  chprintf(chp, "--- %s: ", configs[cfg].name);
+  print_ratio("RX ", TRANSFER_SIZE, rxtime, "MB/S ");
+  print_ratio("(", TRANSFER_SIZE, rxirq, " B/irq), ");
+  print_ratio("TX ", TRANSFER_SIZE, txtime, "MB/S ");
+  print_ratio("(", TRANSFER_SIZE, SD2.txirq, " B/irq)\r\n");
+}
+
+/*
+ * Application entry point.
+ */
+int main(void) {
+  pid_t pid;
+  int status;
+  unsigned i;
+
+  pid = fork();
+  if (pid == 0)
+    peer();
+
+  halInit();
+  chSysInit();
+  conInit();
+
+  chprintf(chp, "*** Serial driver block mode, %u bytes transfers\r\n",
+           TRANSFER_SIZE);
+  for (i = 0; i < NUM_CONFIGS; i++)
+    transfer(i);
+
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+    chprintf(chp, "--- failed: peer data check\r\n");
+    failed = TRUE;
+  }
+
+  chprintf(chp, "\r\nFinal result: %s\r\n", failed ? "FAILURE" : "SUCCESS");
+  return failed ? 1 : 0;
+}
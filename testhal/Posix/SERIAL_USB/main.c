@@ -0,0 +1,700 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <string.h>
+#include <time.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "console.h"
+
+/*
+ * Test parameters, a full speed CDC ACM function.
+ */
+#define PACKET_SIZE         64
+#define DATA_REQUEST_EP     1
+#define DATA_AVAILABLE_EP   1
+#define INTERRUPT_EP        2
+#define LOOP_SIZE           (64 * 1024)
+#define BENCH_SIZE          (4 * 1024 * 1024)
+#define BLOCK_SIZE          512
+#define BURST_SIZE          (16 * 1024)
+#define LATENCY_RUNS        1000
+
+static SerialUSBDriver SDU1;
+
+static BaseSequentialStream *chp = (BaseSequentialStream *)&CD1;
+static bool_t failed;
+
+/*===========================================================================*/
+/* USB related stuff.                                                        */
+/*===========================================================================*/
+
+/*
+ * USB Device Descriptor.
+ */
+static const uint8_t vcom_device_descriptor_data[18] = {
+  USB_DESC_DEVICE       (0x0110,        /* bcdUSB (1.1).                    */
+                         0x02,          /* bDeviceClass (CDC).              */
+                         0x00,          /* bDeviceSubClass.                 */
+                         0x00,          /* bDeviceProtocol.                 */
+                         0x40,          /* bMaxPacketSize.                  */
+                         0x0483,        /* idVendor (ST).                   */
+                         0x5740,        /* idProduct.                       */
+                         0x0200,        /* bcdDevice.                       */
+                         0,             /* iManufacturer.                   */
+                         0,             /* iProduct.                        */
+                         0,             /* iSerialNumber.                   */
+                         1)             /* bNumConfigurations.              */
+};
+
+/*
+ * Device Descriptor wrapper.
+ */
+static const USBDescriptor vcom_device_descriptor = {
+  sizeof vcom_device_descriptor_data,
+  vcom_device_descriptor_data
+};
+
+/* Configuration Descriptor tree for a CDC.*/
+static const uint8_t vcom_configuration_descriptor_data[67] = {
+  /* Configuration Descriptor.*/
+  USB_DESC_CONFIGURATION(67,            /* wTotalLength.                    */
+                         0x02,          /* bNumInterfaces.                  */
+                         0x01,          /* bConfigurationValue.             */
+                         0,             /* iConfiguration.                  */
+                         0xC0,          /* bmAttributes (self powered).     */
+                         50),           /* bMaxPower (100mA).               */
+  /* Interface Descriptor.*/
+  USB_DESC_INTERFACE    (0x00,          /* bInterfaceNumber.                */
+                         0x00,          /* bAlternateSetting.               */
+                         0x01,          /* bNumEndpoints.                   */
+                         0x02,          /* bInterfaceClass (Communications
+                                           Interface Class, CDC section
+                                           4.2).                            */
+                         0x02,          /* bInterfaceSubClass (Abstract
+                                         Control Model, CDC section 4.3).   */
+                         0x01,          /* bInterfaceProtocol (AT commands,
+                                           CDC section 4.4).                */
+                         0),            /* iInterface.                      */
+  /* Header Functional Descriptor (CDC section 5.2.3).*/
+  USB_DESC_BYTE         (5),            /* bLength.                         */
+  USB_DESC_BYTE         (0x24),         /* bDescriptorType (CS_INTERFACE).  */
+  USB_DESC_BYTE         (0x00),         /* bDescriptorSubtype (Header
+                                           Functional Descriptor.           */
+  USB_DESC_BCD          (0x0110),       /* bcdCDC.                          */
+  /* Call Management Functional Descriptor. */
+  USB_DESC_BYTE         (5),            /* bFunctionLength.                 */
+  USB_DESC_BYTE         (0x24),         /* bDescriptorType (CS_INTERFACE).  */
+  USB_DESC_BYTE         (0x01),         /* bDescriptorSubtype (Call Management
+                                           Functional Descriptor).          */
+  USB_DESC_BYTE         (0x00),         /* bmCapabilities (D0+D1).          */
+  USB_DESC_BYTE         (0x01),         /* bDataInterface.                  */
+  /* ACM Functional Descriptor.*/
+  USB_DESC_BYTE         (4),            /* bFunctionLength.                 */
+  USB_DESC_BYTE         (0x24),         /* bDescriptorType (CS_INTERFACE).  */
+  USB_DESC_BYTE         (0x02),         /* bDescriptorSubtype (Abstract
+                                           Control Management Descriptor).  */
+  USB_DESC_BYTE         (0x02),         /* bmCapabilities.                  */
+  /* Union Functional Descriptor.*/
+  USB_DESC_BYTE         (5),            /* bFunctionLength.                 */
+  USB_DESC_BYTE         (0x24),         /* bDescriptorType (CS_INTERFACE).  */
+  USB_DESC_BYTE         (0x06),         /* bDescriptorSubtype (Union
+                                           Functional Descriptor).          */
+  USB_DESC_BYTE         (0x00),         /* bMasterInterface (Communication
+                                           Class Interface).                */
+  USB_DESC_BYTE         (0x01),         /* bSlaveInterface0 (Data Class
+                                           Interface).                      */
+  /* Endpoint 2 Descriptor.*/
+  USB_DESC_ENDPOINT     (INTERRUPT_EP|0x80,
+                         0x03,          /* bmAttributes (Interrupt).        */
+                         0x0008,        /* wMaxPacketSize.                  */
+                         0xFF),         /* bInterval.                       */
+  /* Interface Descriptor.*/
+  USB_DESC_INTERFACE    (0x01,          /* bInterfaceNumber.                */
+                         0x00,          /* bAlternateSetting.               */
+                         0x02,          /* bNumEndpoints.                   */
+                         0x0A,          /* bInterfaceClass (Data Class
+                                           Interface, CDC section 4.5).     */
+                         0x00,          /* bInterfaceSubClass (CDC section
+                                           4.6).                            */
+                         0x00,          /* bInterfaceProtocol (CDC section
+                                           4.7).                            */
+                         0x00),         /* iInterface.                      */
+  /* Endpoint 1 Descriptor.*/
+  USB_DESC_ENDPOINT     (DATA_AVAILABLE_EP,     /* bEndpointAddress.        */
+                         0x02,          /* bmAttributes (Bulk).             */
+                         PACKET_SIZE,   /* wMaxPacketSize.                  */
+                         0x00),         /* bInterval.                       */
+  /* Endpoint 1 Descriptor.*/
+  USB_DESC_ENDPOINT     (DATA_REQUEST_EP|0x80,  /* bEndpointAddress.        */
+                         0x02,          /* bmAttributes (Bulk).             */
+                         PACKET_SIZE,   /* wMaxPacketSize.                  */
+                         0x00)          /* bInterval.                       */
+};
+
+/*
+ * Configuration Descriptor wrapper.
+ */
+static const USBDescriptor vcom_configuration_descriptor = {
+  sizeof vcom_configuration_descriptor_data,
+  vcom_configuration_descriptor_data
+};
+
+/*
+ * Handles the GET_DESCRIPTOR callback. All required descriptors must be
+ * handled here.
+ */
+static const USBDescriptor *get_descriptor(USBDriver *usbp,
+                                           uint8_t dtype,
+                                           uint8_t dindex,
+                                           uint16_t lang) {
+
+  (void)usbp;
+  (void)dindex;
+  (void)lang;
+  switch (dtype) {
+  case USB_DESCRIPTOR_DEVICE:
+    return &vcom_device_descriptor;
+  case USB_DESCRIPTOR_CONFIGURATION:
+    return &vcom_configuration_descriptor;
+  }
+  return NULL;
+}
+
+/*
+ * IN EP1 state.
+ */
+static USBInEndpointState ep1instate;
+
+/*
+ * OUT EP1 state.
+ */
+static USBOutEndpointState ep1outstate;
+
+/*
+ * EP1 initialization structure (both IN and OUT).
+ */
+static const USBEndpointConfig ep1config = {
+  USB_EP_MODE_TYPE_BULK,
+  NULL,
+  sduDataTransmitted,
+  sduDataReceived,
+  PACKET_SIZE,
+  PACKET_SIZE,
+  &ep1instate,
+  &ep1outstate
+};
+
+/*
+ * IN EP2 state.
+ */
+static USBInEndpointState ep2instate;
+
+/*
+ * EP2 initialization structure (IN only).
+ */
+static const USBEndpointConfig ep2config = {
+  USB_EP_MODE_TYPE_INTR,
+  NULL,
+  sduInterruptTransmitted,
+  NULL,
+  0x0010,
+  0x0000,
+  &ep2instate,
+  NULL
+};
+
+/*
+ * Handles the USB driver global events.
+ */
+static void usb_event(USBDriver *usbp, usbevent_t event) {
+
+  switch (event) {
+  case USB_EVENT_CONFIGURED:
+    chSysLockFromIsr();
+
+    /* Enables the endpoints specified into the configuration.
+       Note, this callback is invoked from an ISR so I-Class functions
+       must be used.*/
+    usbInitEndpointI(usbp, DATA_REQUEST_EP, &ep1config);
+    usbInitEndpointI(usbp, INTERRUPT_EP, &ep2config);
+
+    /* Resetting the state of the CDC subsystem.*/
+    sduConfigureHookI(&SDU1);
+
+    chSysUnlockFromIsr();
+    return;
+  default:
+    return;
+  }
+}
+
+/*
+ * USB driver configuration.
+ */
+static const USBConfig usbcfg = {
+  usb_event,
+  get_descriptor,
+  sduRequestsHook,
+  NULL
+};
+
+/*
+ * Serial over USB driver configuration.
+ */
+static const SerialUSBConfig serusbcfg = {
+  &USBD1,
+  DATA_REQUEST_EP,
+  DATA_AVAILABLE_EP,
+  INTERRUPT_EP
+};
+
+/*===========================================================================*/
+/* Simulated host.                                                           */
+/*===========================================================================*/
+
+static uint8_t pkt[PACKET_SIZE];
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Prints a ratio with two decimals.
+ */
+static void print_ratio(const char *label, uint64_t num, uint64_t den,
+                        const char *unit) {
+  uint64_t r = den ? (num * 100) / den : 0;
+
+  chprintf(chp, "%s%u.%02u%s", label, (unsigned)(r / 100),
+           (unsigned)(r % 100), unit);
+}
+
+/*
+ * Test pattern.
+ */
+static uint8_t pattern(uint32_t i) {
+
+  return (uint8_t)((i * 7) ^ (i >> 8));
+}
+
+/*
+ * Control transfer on EP0.
+ */
+static msg_t host_control(uint8_t type, uint8_t req, uint16_t value,
+                          uint16_t index, uint8_t *p, uint16_t n) {
+
+  return usbSimControl(&USBD1, type, req, value, index, p, n);
+}
+
+static void check(bool_t ok, const char *what) {
+
+  chprintf(chp, "--- %s: %s\r\n", what, ok ? "ok" : "FAILED");
+  if (!ok)
+    failed = TRUE;
+}
+
+/*
+ * Returns TRUE if the device had no space left for an OUT packet, a NAK
+ * in any other condition is a throughput loss.
+ */
+static bool_t out_full(void) {
+  bool_t full;
+
+  chSysLock();
+#if SERIAL_USB_USE_HIGH_THROUGHPUT
+  full = (SDU1.rxfull >= 2) && (chIQGetEmptyI(&SDU1.iqueue) == 0);
+#else
+  full = chIQGetEmptyI(&SDU1.iqueue) < PACKET_SIZE;
+#endif
+  chSysUnlock();
+  return full;
+}
+
+/*===========================================================================*/
+/* Device side threads.                                                      */
+/*===========================================================================*/
+
+static WORKING_AREA(waDevice, 2048);
+static uint8_t dbuf[BLOCK_SIZE];
+
+/*
+ * Echoes back everything received.
+ */
+static msg_t echo_thread(void *arg) {
+  uint32_t size = *(const uint32_t *)arg, total = 0;
+  size_t n;
+
+  chRegSetThreadName("echo");
+  while (total < size) {
+    /* Waits for the first byte then takes whatever is already queued.*/
+    n = chnReadTimeout(&SDU1, dbuf, 1, TIME_INFINITE);
+    n += chnReadTimeout(&SDU1, dbuf + n, BLOCK_SIZE - n, TIME_IMMEDIATE);
+    total += chnWriteTimeout(&SDU1, dbuf, n, TIME_INFINITE);
+  }
+  return 0;
+}
+
+/*
+ * Consumes and verifies the received data.
+ */
+static msg_t sink_thread(void *arg) {
+  uint32_t size = *(const uint32_t *)arg, total = 0;
+  size_t i, n;
+
+  chRegSetThreadName("sink");
+  while (total < size) {
+    n = chnReadTimeout(&SDU1, dbuf, BLOCK_SIZE, TIME_INFINITE);
+    for (i = 0; i < n; i++)
+      if (dbuf[i] != pattern(total + i))
+        return 1;
+    total += n;
+  }
+  return 0;
+}
+
+/*
+ * Produces the test pattern.
+ */
+static msg_t source_thread(void *arg) {
+  uint32_t size = *(const uint32_t *)arg, total = 0;
+  size_t i;
+
+  chRegSetThreadName("source");
+  while (total < size) {
+    for (i = 0; i < BLOCK_SIZE; i++)
+      dbuf[i] = pattern(total + i);
+    total += chnWriteTimeout(&SDU1, dbuf, BLOCK_SIZE, TIME_INFINITE);
+  }
+  return 0;
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+static void enumerate(void) {
+  static const uint8_t coding[7] = {0x00, 0x10, 0x0E, 0x00, 0, 0, 8};
+  uint8_t desc[67];
+
+  check((usbSimEnumerate(&USBD1, 3, 1, desc, sizeof desc) == 67) &&
+        (desc[5] == 0x01) && (usbGetDriverStateI(&USBD1) == USB_ACTIVE) &&
+        (USBD1.address == 3),
+        "Enumeration");
+  memcpy(desc, coding, sizeof coding);
+  check((host_control(USB_RTYPE_TYPE_CLASS | USB_RTYPE_RECIPIENT_INTERFACE,
+                      CDC_SET_LINE_CODING, 0, 0, desc, 7) == 7) &&
+        (host_control(USB_RTYPE_DIR_DEV2HOST | USB_RTYPE_TYPE_CLASS |
+                      USB_RTYPE_RECIPIENT_INTERFACE, CDC_GET_LINE_CODING,
+                      0, 0, desc, 7) == 7) &&
+        (memcmp(desc, coding, sizeof coding) == 0),
+        "SET_LINE_CODING/GET_LINE_CODING");
+  check(host_control(USB_RTYPE_TYPE_CLASS | USB_RTYPE_RECIPIENT_INTERFACE,
+                     CDC_SET_CONTROL_LINE_STATE, 3, 0, NULL, 0) == 0,
+        "SET_CONTROL_LINE_STATE");
+}
+
+/*
+ * Standard requests handled by the USB driver.
+ */
+static void requests(void) {
+  uint8_t buf[64];
+
+  check((host_control(USB_RTYPE_DIR_DEV2HOST, USB_REQ_GET_CONFIGURATION,
+                      0, 0, buf, 1) == 1) && (buf[0] == 1),
+        "GET_CONFIGURATION");
+  check((host_control(USB_RTYPE_RECIPIENT_DEVICE, USB_REQ_SET_FEATURE,
+                      USB_FEATURE_DEVICE_REMOTE_WAKEUP, 0, NULL, 0) == 0) &&
+        (host_control(USB_RTYPE_DIR_DEV2HOST, USB_REQ_GET_STATUS,
+                      0, 0, buf, 2) == 2) && (buf[0] == 2) &&
+        (host_control(USB_RTYPE_RECIPIENT_DEVICE, USB_REQ_CLEAR_FEATURE,
+                      USB_FEATURE_DEVICE_REMOTE_WAKEUP, 0, NULL, 0) == 0) &&
+        (host_control(USB_RTYPE_DIR_DEV2HOST, USB_REQ_GET_STATUS,
+                      0, 0, buf, 2) == 2) && (buf[0] == 0),
+        "SET_FEATURE/CLEAR_FEATURE(DEVICE_REMOTE_WAKEUP)");
+  check((host_control(USB_RTYPE_RECIPIENT_ENDPOINT, USB_REQ_SET_FEATURE,
+                      USB_FEATURE_ENDPOINT_HALT, DATA_REQUEST_EP | 0x80,
+                      NULL, 0) == 0) &&
+        (usbSimIn(&USBD1, DATA_REQUEST_EP, pkt) == USB_SIM_STALL) &&
+        (host_control(USB_RTYPE_DIR_DEV2HOST | USB_RTYPE_RECIPIENT_ENDPOINT,
+                      USB_REQ_GET_STATUS, 0, DATA_REQUEST_EP | 0x80,
+                      buf, 2) == 2) && (buf[0] == 1) &&
+        (host_control(USB_RTYPE_RECIPIENT_ENDPOINT, USB_REQ_CLEAR_FEATURE,
+                      USB_FEATURE_ENDPOINT_HALT, DATA_REQUEST_EP | 0x80,
+                      NULL, 0) == 0) &&
+        (usbSimIn(&USBD1, DATA_REQUEST_EP, pkt) == USB_SIM_NAK),
+        "SET_FEATURE/CLEAR_FEATURE(ENDPOINT_HALT)");
+  check((host_control(USB_RTYPE_DIR_DEV2HOST, USB_REQ_GET_DESCRIPTOR,
+                      USB_DESCRIPTOR_CONFIGURATION << 8, 0, buf, 64) == 64) &&
+        (host_control(USB_RTYPE_DIR_DEV2HOST, USB_REQ_GET_DESCRIPTOR,
+                      USB_DESCRIPTOR_DEVICE << 8, 0, buf, 64) == 18),
+        "GET_DESCRIPTOR, full and short data stages");
+  check((host_control(USB_RTYPE_DIR_DEV2HOST, USB_REQ_GET_DESCRIPTOR,
+                      USB_DESCRIPTOR_STRING << 8, 0, buf, 64) ==
+         USB_SIM_STALL) &&
+        (host_control(USB_RTYPE_RECIPIENT_INTERFACE, USB_REQ_SET_INTERFACE,
+                      0, 0, NULL, 0) == USB_SIM_STALL) &&
+        (host_control(USB_RTYPE_DIR_DEV2HOST, USB_REQ_GET_CONFIGURATION,
+                      0, 0, buf, 1) == 1),
+        "Unsupported requests stalled, recovery on SETUP");
+}
+
+/*
+ * A transfer ending with a full packet must be terminated by a zero sized
+ * packet and only in that case, the first byte is sent alone so that the
+ * rest is queued while the endpoint is busy.
+ */
+static bool_t zlp(size_t n) {
+  static uint8_t buf[SERIAL_USB_BUFFERS_SIZE];
+  size_t i, cnt = 0;
+  msg_t msg;
+
+  for (i = 0; i <= n; i++)
+    buf[i] = pattern(i);
+  chnWriteTimeout(&SDU1, buf, 1, TIME_INFINITE);
+  chnWriteTimeout(&SDU1, buf + 1, n, TIME_INFINITE);
+  if (usbSimIn(&USBD1, DATA_REQUEST_EP, pkt) != 1)
+    return FALSE;
+  do {
+    msg = usbSimIn(&USBD1, DATA_REQUEST_EP, pkt);
+    if ((msg < 0) || (memcmp(pkt, buf + 1 + cnt, msg) != 0))
+      return FALSE;
+    cnt += msg;
+  } while (msg == PACKET_SIZE);
+  return (cnt == n) && ((msg == 0) == ((n % PACKET_SIZE) == 0)) &&
+         (usbSimIn(&USBD1, DATA_REQUEST_EP, pkt) == USB_SIM_NAK);
+}
+
+/*
+ * Host sending and receiving at the same time through an echo thread.
+ */
+static void loopback(void) {
+  static const uint32_t size = LOOP_SIZE;
+  uint32_t tx = 0, rx = 0, i;
+  bool_t ok = TRUE;
+  Thread *tp;
+  size_t k;
+  msg_t msg;
+
+  tp = chThdCreateStatic(waDevice, sizeof(waDevice), NORMALPRIO + 1,
+                         echo_thread, (void *)&size);
+  while (ok && (rx < LOOP_SIZE)) {
+    bool_t idle = TRUE;
+
+    if (tx < LOOP_SIZE) {
+      k = (LOOP_SIZE - tx) < 37 ? LOOP_SIZE - tx : 37;
+      for (i = 0; i < k; i++)
+        pkt[i] = pattern(tx + i);
+      if (usbSimOut(&USBD1, DATA_AVAILABLE_EP, pkt, k) == USB_SIM_ACK) {
+        tx += k;
+        idle = FALSE;
+      }
+    }
+    msg = usbSimIn(&USBD1, DATA_REQUEST_EP, pkt);
+    if (msg > 0) {
+      for (i = 0; i < (uint32_t)msg; i++)
+        ok = ok && (pkt[i] == pattern(rx + i));
+      rx += msg;
+      idle = FALSE;
+    }
+    if (idle)
+      chThdSleep(1);
+  }
+  check(ok && (chThdWait(tp) == 0), "Loopback");
+}
+
+/*
+ * Host sending as fast as possible, a NAK is retried immediately.
+ */
+static void bench_out(void) {
+  static const uint32_t size = BENCH_SIZE;
+  uint32_t cnt = 0, naks = 0, early = 0, i;
+  uint64_t start;
+  Thread *tp;
+
+  tp = chThdCreateStatic(waDevice, sizeof(waDevice), NORMALPRIO + 1,
+                         sink_thread, (void *)&size);
+  start = now_us();
+  while (cnt < BENCH_SIZE) {
+    for (i = 0; i < PACKET_SIZE; i++)
+      pkt[i] = pattern(cnt + i);
+    if (usbSimOut(&USBD1, DATA_AVAILABLE_EP, pkt, PACKET_SIZE) ==
+        USB_SIM_ACK)
+      cnt += PACKET_SIZE;
+    else {
+      naks++;
+      if (!out_full())
+        early++;
+      chThdYield();
+    }
+  }
+  check(chThdWait(tp) == 0, "OUT data");
+  print_ratio("    OUT throughput    : ", BENCH_SIZE, now_us() - start,
+              " MB/S\r\n");
+  chprintf(chp, "    NAKs              : %u (%u with free space)\r\n",
+           naks, early);
+  check(early == 0, "OUT never NAKed with free space");
+}
+
+/*
+ * Host fetching as fast as possible.
+ */
+static void bench_in(void) {
+  static const uint32_t size = BENCH_SIZE;
+  uint32_t cnt = 0, i;
+  uint64_t start;
+  bool_t ok = TRUE;
+  Thread *tp;
+  msg_t msg;
+
+  tp = chThdCreateStatic(waDevice, sizeof(waDevice), NORMALPRIO + 1,
+                         source_thread, (void *)&size);
+  start = now_us();
+  while (cnt < BENCH_SIZE) {
+    msg = usbSimIn(&USBD1, DATA_REQUEST_EP, pkt);
+    if (msg <= 0) {
+      chThdYield();
+      continue;
+    }
+    for (i = 0; i < (uint32_t)msg; i++)
+      ok = ok && (pkt[i] == pattern(cnt + i));
+    cnt += msg;
+  }
+  print_ratio("    IN throughput     : ", BENCH_SIZE, now_us() - start,
+              " MB/S\r\n");
+
+  /* The last transfer could be terminated by a zero sized packet.*/
+  (void)usbSimIn(&USBD1, DATA_REQUEST_EP, pkt);
+  check(ok && (chThdWait(tp) == 0), "IN data");
+}
+
+/*
+ * A slow consumer, with priority lower than the host, only drains the
+ * queue while the host is waiting after a NAK.
+ */
+static void burst(void) {
+  static const uint32_t size = BURST_SIZE;
+  static uint8_t buf[BURST_SIZE];
+  USBSimStats st;
+  Thread *tp;
+  uint32_t i;
+
+  for (i = 0; i < BURST_SIZE; i++)
+    buf[i] = pattern(i);
+  tp = chThdCreateStatic(waDevice, sizeof(waDevice), NORMALPRIO - 1,
+                         sink_thread, (void *)&size);
+  usbSimResetStats(&USBD1);
+  check((usbSimTransferOut(&USBD1, DATA_AVAILABLE_EP, buf, BURST_SIZE,
+                           TIME_INFINITE) == BURST_SIZE) &&
+        (chThdWait(tp) == 0), "Slow consumer data");
+  usbSimGetStats(&USBD1, &st);
+  chprintf(chp, "    NAKs              : %u for %u bytes\r\n",
+           st.naks_out, BURST_SIZE);
+}
+
+/*
+ * Round trip time of messages echoed by a thread with priority higher
+ * than the host.
+ */
+static void latency(size_t n) {
+  static uint32_t size;
+  uint64_t start, t, min = (uint64_t)-1, max = 0, sum = 0;
+  uint8_t buf[PACKET_SIZE * 2];
+  size_t cnt;
+  bool_t ok = TRUE;
+  Thread *tp;
+  msg_t msg;
+  unsigned i;
+
+  size = LATENCY_RUNS * n;
+  tp = chThdCreateStatic(waDevice, sizeof(waDevice), NORMALPRIO + 1,
+                         echo_thread, (void *)&size);
+  for (i = 0; ok && (i < LATENCY_RUNS); i++) {
+    memset(buf, i, n);
+    start = now_us();
+    ok = usbSimTransferOut(&USBD1, DATA_AVAILABLE_EP, buf, n,
+                           TIME_INFINITE) == (msg_t)n;
+
+    /* The reply can be split in several transfers.*/
+    for (cnt = 0; ok && (cnt < n); cnt += msg) {
+      msg = usbSimTransferIn(&USBD1, DATA_REQUEST_EP, buf + cnt, n - cnt,
+                             TIME_INFINITE);
+      ok = msg > 0;
+    }
+    t = now_us() - start;
+    sum += t;
+    if (t < min)
+      min = t;
+    if (t > max)
+      max = t;
+    while (ok && (cnt > 0))
+      ok = buf[--cnt] == (uint8_t)i;
+  }
+  check(ok && (chThdWait(tp) == 0), "Echo data");
+  chprintf(chp, "    %3u bytes         : min %uuS, avg %uuS, max %uuS\r\n",
+           n, (unsigned)min, (unsigned)(sum / LATENCY_RUNS), (unsigned)max);
+}
+
+/*
+ * Application entry point.
+ */
+int main(void) {
+
+  halInit();
+  chSysInit();
+  conInit();
+
+  sduObjectInit(&SDU1);
+  sduStart(&SDU1, &serusbcfg);
+  usbStart(&USBD1, &usbcfg);
+  usbConnectBus(&USBD1);
+
+  chprintf(chp, "*** Serial over USB over a simulated device controller, "
+                "%s mode\r\n",
+           SERIAL_USB_USE_HIGH_THROUGHPUT ? "high throughput" : "normal");
+  enumerate();
+  requests();
+  check(zlp(PACKET_SIZE * 2), "Transfer terminated by a ZLP");
+  check(zlp(SERIAL_USB_BUFFERS_SIZE - 1), "Short last packet, no ZLP");
+  check(zlp(SERIAL_USB_BUFFERS_SIZE - PACKET_SIZE),
+        "Multiple transfers, single ZLP");
+  loopback();
+
+  chprintf(chp, "\r\n*** Throughput, %u bytes in %u bytes blocks\r\n",
+           BENCH_SIZE, BLOCK_SIZE);
+  bench_out();
+  bench_in();
+
+  chprintf(chp, "\r\n*** Slow consumer\r\n");
+  burst();
+
+  chprintf(chp, "\r\n*** Echo latency, %u round trips\r\n", LATENCY_RUNS);
+  latency(1);
+  latency(PACKET_SIZE - 1);
+  latency(PACKET_SIZE);
+  latency(PACKET_SIZE * 2);
+
+  sduStop(&SDU1);
+  usbStop(&USBD1);
+
+  chprintf(chp, "\r\nFinal result: %s\r\n", failed ? "FAILURE" : "SUCCESS");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,268 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <string.h>
+#include <time.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "console.h"
+
+#define BENCH_TRANSFERS     20000
+#define BENCH_BATCH         10
+#define BENCH_SIZE          4
+
+static BaseSequentialStream *chp = (BaseSequentialStream *)&CD1;
+static bool_t failed;
+
+/*
+ * Two devices on the bus, unlimited bus speed.
+ */
+static const SPIConfig cfg_dev1 = {NULL, 0, 1};
+static const SPIConfig cfg_dev2 = {NULL, 0, 2};
+
+/*
+ * Unlimited bus speed and 8Mb/S for the benchmark.
+ */
+static const SPIConfig cfg_fast = {NULL, 0, 1};
+static const SPIConfig cfg_8m = {NULL, 8000000, 1};
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Prints a ratio with two decimals.
+ */
+static void print_ratio(const char *label, uint64_t num, uint64_t den,
+                        const char *unit) {
+  uint64_t r = den ? (num * 100) / den : 0;
+
+  chprintf(chp, "%s%u.%02u%s", label, (unsigned)(r / 100),
+           (unsigned)(r % 100), unit);
+}
+
+static void check(bool_t cond, const char *msg) {
+
+  if (!cond) {
+    chprintf(chp, "--- failed: %s\r\n", msg);
+    failed = TRUE;
+  }
+}
+
+static void set_segment(SPISegment *ssp, spisegop_t op, size_t n,
+                        const void *txbuf, void *rxbuf) {
+
+  ssp->op = op;
+  ssp->n = n;
+  ssp->txbuf = txbuf;
+  ssp->rxbuf = rxbuf;
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+/*
+ * All the segment types in a single transaction.
+ */
+static void loopback(void) {
+  static const uint8_t cmd[16] = {0x03, 0x00, 0x10, 0x00, 0x55, 0xAA,
+                                  0x01, 0x02, 0x04, 0x08, 0x10, 0x20,
+                                  0x40, 0x80, 0xFE, 0xEF};
+  static uint8_t echo[16], data[8];
+  static const SPISegment segments[] = {
+    SPI_SEGMENT_SELECT(),
+    SPI_SEGMENT_EXCHANGE(16, cmd, echo),
+    SPI_SEGMENT_IGNORE(2),
+    SPI_SEGMENT_SEND(4, cmd),
+    SPI_SEGMENT_DELAY(0),
+    SPI_SEGMENT_RECEIVE(8, data),
+    SPI_SEGMENT_UNSELECT()
+  };
+  static SPI_TRANSACTION_DECL(txn, &cfg_dev2, segments, 7, NULL);
+  uint32_t selects = SPID1.selects;
+  uint32_t frames = SPID1.frames;
+  unsigned i;
+
+  spiStart(&SPID1, &cfg_dev1);
+  check(spiTransaction(&SPID1, &txn) == RDY_OK, "transaction status");
+  check(memcmp(cmd, echo, sizeof cmd) == 0, "exchanged data");
+  for (i = 0; i < sizeof data; i++)
+    check(data[i] == 0xFF, "received data");
+  check(SPID1.selects == selects + 1, "select count");
+  check(SPID1.frames == frames + 16 + 2 + 4 + 8, "frames count");
+  check(SPID1.selected == 0, "unselected");
+  check(SPID1.config == &cfg_dev2, "transaction configuration");
+  check(SPID1.state == SPI_READY, "driver state");
+  spiStop(&SPID1);
+
+  chprintf(chp, "--- Loopback: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+/*
+ * Completion order and configurations, recorded by the callback.
+ */
+static SPITransaction *completed[4];
+static unsigned sslines[4];
+static unsigned ncompleted;
+
+static void txn_end(SPIDriver *spip, SPITransaction *stp) {
+
+  if (ncompleted < 4) {
+    completed[ncompleted] = stp;
+    sslines[ncompleted++] = spip->config->ssline;
+  }
+}
+
+static uint8_t txbuf[BENCH_BATCH][BENCH_SIZE], rxbuf[BENCH_BATCH][BENCH_SIZE];
+static const SPISegment blocking[] = {
+  SPI_SEGMENT_SELECT(),
+  SPI_SEGMENT_DELAY(MS2ST(50)),
+  SPI_SEGMENT_UNSELECT()
+};
+static const SPISegment transfer[] = {
+  SPI_SEGMENT_SELECT(),
+  SPI_SEGMENT_EXCHANGE(BENCH_SIZE, txbuf[0], rxbuf[0]),
+  SPI_SEGMENT_UNSELECT()
+};
+static SPITransaction txns[4] = {
+  _SPI_TRANSACTION_DATA(&cfg_dev1, blocking, 3, txn_end),
+  _SPI_TRANSACTION_DATA(NULL, transfer, 3, txn_end),
+  _SPI_TRANSACTION_DATA(&cfg_dev2, transfer, 3, txn_end),
+  _SPI_TRANSACTION_DATA(&cfg_dev1, transfer, 3, txn_end)
+};
+static WORKING_AREA(waClient1, 1024);
+static WORKING_AREA(waClient2, 1024);
+static WORKING_AREA(waClient3, 1024);
+
+static msg_t client(void *p) {
+
+  return spiTransaction(&SPID1, (SPITransaction *)p);
+}
+
+/*
+ * While a transaction is delaying the clients queue their own transactions,
+ * the queue is served in priority order.
+ */
+static void priority(void) {
+  static const unsigned expected[4] = {0, 2, 3, 1};
+  static const unsigned expected_sslines[4] = {1, 2, 1, 1};
+  Thread *tp1, *tp2, *tp3;
+  unsigned i;
+
+  spiStart(&SPID1, &cfg_dev1);
+  ncompleted = 0;
+  spiStartTransaction(&SPID1, &txns[0]);
+  tp1 = chThdCreateStatic(waClient1, sizeof(waClient1), NORMALPRIO + 1,
+                          client, &txns[1]);
+  tp2 = chThdCreateStatic(waClient2, sizeof(waClient2), NORMALPRIO + 3,
+                          client, &txns[2]);
+  tp3 = chThdCreateStatic(waClient3, sizeof(waClient3), NORMALPRIO + 2,
+                          client, &txns[3]);
+  check(ncompleted == 0, "delayed transaction");
+  check(chThdWait(tp1) == RDY_OK, "client 1 status");
+  check(chThdWait(tp2) == RDY_OK, "client 2 status");
+  check(chThdWait(tp3) == RDY_OK, "client 3 status");
+  check(ncompleted == 4, "completed transactions");
+  for (i = 0; i < 4; i++) {
+    check(completed[i] == &txns[expected[i]], "completion order");
+    check(sslines[i] == expected_sslines[i], "configuration switch");
+  }
+  spiStop(&SPID1);
+
+  chprintf(chp, "--- Priority order: %s\r\n", failed ? "FAILED" : "ok");
+}
+
+/*
+ * Single operations against transactions of BENCH_BATCH transfers, each
+ * transfer selects the device, exchanges BENCH_SIZE bytes and unselects.
+ */
+static void benchmark(const SPIConfig *config, const char *name) {
+  static SPISegment segments[BENCH_BATCH * 3];
+  static SPITransaction txn;
+  uint64_t start, single, batched;
+  unsigned i, j;
+
+  for (i = 0; i < BENCH_BATCH; i++) {
+    for (j = 0; j < BENCH_SIZE; j++)
+      txbuf[i][j] = (uint8_t)(i * BENCH_SIZE + j);
+    set_segment(&segments[i * 3], SPI_SEG_SELECT, 0, NULL, NULL);
+    set_segment(&segments[i * 3 + 1], SPI_SEG_EXCHANGE, BENCH_SIZE,
+                txbuf[i], rxbuf[i]);
+    set_segment(&segments[i * 3 + 2], SPI_SEG_UNSELECT, 0, NULL, NULL);
+  }
+  txn.config = NULL;
+  txn.segments = segments;
+  txn.n = BENCH_BATCH * 3;
+  txn.end_cb = NULL;
+  txn.pending = FALSE;
+
+  spiStart(&SPID1, config);
+  start = now_us();
+  for (i = 0; i < BENCH_TRANSFERS; i++) {
+    spiSelect(&SPID1);
+    spiExchange(&SPID1, BENCH_SIZE, txbuf[i % BENCH_BATCH],
+                rxbuf[i % BENCH_BATCH]);
+    spiUnselect(&SPID1);
+  }
+  single = now_us() - start;
+
+  memset(rxbuf, 0, sizeof rxbuf);
+  start = now_us();
+  for (i = 0; i < BENCH_TRANSFERS / BENCH_BATCH; i++)
+    spiTransaction(&SPID1, &txn);
+  batched = now_us() - start;
+  spiStop(&SPID1);
+  check(memcmp(txbuf, rxbuf, sizeof txbuf) == 0, "batched data");
+
+  chprintf(chp, "--- Benchmark %s, %u bytes transfers\r\n", name,
+           BENCH_SIZE);
+  print_ratio("    single operations : ",
+              (uint64_t)BENCH_TRANSFERS * 1000000, single,
+              " transfers/S\r\n");
+  print_ratio("    transactions      : ",
+              (uint64_t)BENCH_TRANSFERS * 1000000, batched,
+              " transfers/S\r\n");
+  print_ratio("    speedup           : ", single, batched, "\r\n");
+}
+
+/*
+ * Application entry point.
+ */
+int main(void) {
+
+  halInit();
+  chSysInit();
+  conInit();
+
+  chprintf(chp, "*** SPI driver transactions, loopback bus\r\n");
+  loopback();
+  priority();
+  benchmark(&cfg_fast, "unlimited speed");
+  benchmark(&cfg_8m, "at 8Mb/S");
+
+  chprintf(chp, "\r\nFinal result: %s\r\n", failed ? "FAILURE" : "SUCCESS");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,330 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "memstreams.h"
+#include "console.h"
+#include "tmshell.h"
+
+#define NULL_RUNS           1000
+#define WORKERS             6
+#define BENCH_RUNS          1000
+
+static BaseSequentialStream *chp = (BaseSequentialStream *)&CD1;
+static bool_t failed;
+
+static TimeProfile null_point, record_point, thread_point;
+static TimeProfile sleep_point, sem_point, printf_point;
+
+static char out[2048];
+static MemoryStream ms;
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+static void check(bool_t cond, const char *msg) {
+
+  if (!cond) {
+    chprintf(chp, "--- failed: %s\r\n", msg);
+    failed = TRUE;
+  }
+}
+
+static void result(const char *name, bool_t ok) {
+
+  chprintf(chp, "--- %s: %s\r\n", name, ok ? "ok" : "FAILED");
+}
+
+/*
+ * Runs the shell command into the memory buffer.
+ */
+static const char *shell(int argc, char *argv[]) {
+
+  msObjectInit(&ms, (uint8_t *)out, sizeof out - 1, 0);
+  tmShellCmd((BaseSequentialStream *)&ms, argc, argv);
+  out[ms.eos] = 0;
+  return out;
+}
+
+/*===========================================================================*/
+/* Calibration.                                                              */
+/*===========================================================================*/
+
+/*
+ * A null interval is entirely measurement overhead, after the calibration
+ * the shortest null interval must be zero. One tick is tolerated, the
+ * counter is the host clock and the overhead measured by the calibration
+ * can exceed the shortest null interval by one nanosecond.
+ */
+static void calibration(void) {
+  TimeProfileStats stats;
+  TimeMeasurement tm;
+  halrtcnt_t best = (halrtcnt_t)-1;
+  bool_t ok;
+  unsigned i;
+
+  for (i = 0; i < NULL_RUNS; i++) {
+    halrtcnt_t start = tmProfileBegin();
+    tmProfileEnd(&null_point, start);
+  }
+  tmObjectInit(&tm);
+  for (i = 0; i < NULL_RUNS; i++) {
+    tmStartMeasurement(&tm);
+    tmStopMeasurement(&tm);
+    if (tm.last < best)
+      best = tm.last;
+  }
+  tmProfileGetStats(&null_point, &stats);
+  ok = (stats.count == NULL_RUNS) && (stats.min <= 1) && (best <= 1) &&
+       (stats.hist[0] + stats.hist[1] > 0);
+  chprintf(chp, "calibration %lu ticks, null interval mean %lu ticks\r\n",
+           (uint32_t)tmProfileGetOffset(),
+           (uint32_t)(stats.sum / stats.count));
+  check(stats.count == NULL_RUNS, "null intervals count");
+  check(stats.min <= 1, "null profile interval above one tick");
+  check(best <= 1, "null measurement above one tick");
+  result("Calibration", ok);
+}
+
+/*===========================================================================*/
+/* Statistics and histogram.                                                 */
+/*===========================================================================*/
+
+/*
+ * Known intervals recorded directly, bucket n counts from 2^(n-1) to
+ * 2^n-1, the last bucket collects the overflow.
+ */
+static void statistics(void) {
+  static const halrtcnt_t intervals[] = {
+    0, 1, 2, 3, 4, 7, 8, 1000, 0xFFFFFFFF
+  };
+  static const unsigned buckets[] = {
+    0, 1, 2, 2, 3, 3, 4, 10, TM_PROFILE_BUCKETS - 1
+  };
+  TimeProfileStats stats;
+  uint32_t hist[TM_PROFILE_BUCKETS];
+  uint64_t sum = 0;
+  bool_t ok = TRUE;
+  unsigned i;
+
+  memset(hist, 0, sizeof hist);
+  chSysLock();
+  for (i = 0; i < sizeof intervals / sizeof intervals[0]; i++) {
+    tmProfileRecordI(&record_point, intervals[i], NULL);
+    hist[buckets[i]]++;
+    sum += intervals[i];
+  }
+  chSysUnlock();
+
+  tmProfileGetStats(&record_point, &stats);
+  ok = ok && (stats.count == sizeof intervals / sizeof intervals[0]);
+  ok = ok && (stats.min == 0) && (stats.max == 0xFFFFFFFF);
+  ok = ok && (stats.sum == sum);
+  ok = ok && (memcmp(stats.hist, hist, sizeof hist) == 0);
+  ok = ok && (stats.threads[0].thread == NULL);
+  ok = ok && (stats.threads[0].count == stats.count);
+  ok = ok && (stats.threads[1].count == 0) && (stats.others.count == 0);
+  check(ok, "statistics mismatch");
+  result("Statistics", ok);
+}
+
+/*===========================================================================*/
+/* Threads attribution.                                                      */
+/*===========================================================================*/
+
+static WORKING_AREA(waWorkers[WORKERS], 1024);
+static const char *names[WORKERS] = {
+  "worker0", "worker1", "worker2", "worker3", "worker4", "worker5"
+};
+
+/*
+ * Each worker records one interval more than the previous one.
+ */
+static msg_t worker(void *arg) {
+  unsigned i, n = (const char **)arg - names;
+
+  chRegSetThreadName(names[n]);
+  for (i = 0; i <= n; i++) {
+    halrtcnt_t start = tmProfileBegin();
+    tmProfileEnd(&thread_point, start);
+  }
+  return 0;
+}
+
+static void threads(void) {
+  TimeProfileStats stats;
+  Thread *tps[WORKERS];
+  bool_t ok = TRUE;
+  unsigned i;
+
+  /* The workers run to completion one after the other, the slots are
+     assigned in order.*/
+  for (i = 0; i < WORKERS; i++) {
+    tps[i] = chThdCreateStatic(waWorkers[i], sizeof waWorkers[i],
+                               NORMALPRIO + 1, worker, (void *)&names[i]);
+  }
+  tmProfileGetStats(&thread_point, &stats);
+  for (i = 0; i < TM_PROFILE_THREADS; i++)
+    ok = ok && (stats.threads[i].thread == tps[i]) &&
+               (stats.threads[i].count == i + 1);
+  ok = ok && (stats.others.count == 5 + 6);
+  ok = ok && (stats.count == 1 + 2 + 3 + 4 + 5 + 6);
+  check(ok, "attribution mismatch");
+
+  /* The slots still refer to the threads, the names are printed while
+     the threads exist.*/
+  {
+    char *argv[] = {"thread"};
+    const char *s = shell(1, argv);
+    ok = ok && (strstr(s, "worker0") != NULL) &&
+               (strstr(s, "worker3") != NULL) &&
+               (strstr(s, "worker4") == NULL) &&
+               (strstr(s, "(others)") != NULL);
+    check(ok, "attribution not printed");
+  }
+  for (i = 0; i < WORKERS; i++)
+    chThdWait(tps[i]);
+  result("Threads", ok);
+}
+
+/*===========================================================================*/
+/* Shell command and reset.                                                  */
+/*===========================================================================*/
+
+static void command(void) {
+  char *reset[] = {"reset"};
+  char *unknown[] = {"unknown"};
+  char *record[] = {"record"};
+  TimeProfileStats stats;
+  const char *s;
+  bool_t ok = TRUE;
+
+  s = shell(0, NULL);
+  ok = ok && (strstr(s, "null") != NULL) && (strstr(s, "record") != NULL);
+  check(ok, "points not listed");
+  s = shell(1, record);
+  ok = ok && (strstr(s, "            512       1023          1") != NULL);
+  check(ok, "histogram not printed");
+  s = shell(1, unknown);
+  ok = ok && (strcmp(s, "unknown?\r\n") == 0);
+  check(ok, "unknown point accepted");
+
+  shell(1, reset);
+  tmProfileGetStats(&record_point, &stats);
+  ok = ok && (stats.count == 0) && (stats.sum == 0) &&
+             (stats.min == (halrtcnt_t)-1) && (stats.max == 0) &&
+             (stats.hist[10] == 0) && (stats.threads[0].count == 0);
+  tmProfileGetStats(&thread_point, &stats);
+  ok = ok && (stats.count == 0) && (stats.others.count == 0);
+  check(ok, "reset failed");
+
+  /* Points without recorded intervals are not listed.*/
+  s = shell(0, NULL);
+  ok = ok && (strstr(s, "null") == NULL) && (strstr(s, "record") == NULL);
+  check(ok, "empty points listed");
+  result("Command", ok);
+}
+
+/*===========================================================================*/
+/* Instrumented benchmarks.                                                  */
+/*===========================================================================*/
+
+static Semaphore ping, pong;
+static WORKING_AREA(waPong, 1024);
+
+static msg_t ponger(void *arg) {
+
+  (void)arg;
+  chRegSetThreadName("ponger");
+  while (!chThdShouldTerminate()) {
+    chSemWait(&ping);
+    chSemSignal(&pong);
+  }
+  return 0;
+}
+
+static void benchmarks(void) {
+  char *argv[] = {"sem"};
+  Thread *tp;
+  unsigned i;
+
+  tmProfileResetAll();
+  for (i = 0; i < BENCH_RUNS / 10; i++) {
+    halrtcnt_t start = tmProfileBegin();
+    chThdSleep(1);
+    tmProfileEnd(&sleep_point, start);
+  }
+
+  chSemInit(&ping, 0);
+  chSemInit(&pong, 0);
+  tp = chThdCreateStatic(waPong, sizeof waPong, NORMALPRIO + 1,
+                         ponger, NULL);
+  for (i = 0; i < BENCH_RUNS; i++) {
+    halrtcnt_t start = tmProfileBegin();
+    chSemSignal(&ping);
+    chSemWait(&pong);
+    tmProfileEnd(&sem_point, start);
+  }
+  chThdTerminate(tp);
+  chSemSignal(&ping);
+  chThdWait(tp);
+
+  for (i = 0; i < BENCH_RUNS; i++) {
+    halrtcnt_t start = tmProfileBegin();
+    msObjectInit(&ms, (uint8_t *)out, sizeof out, 0);
+    chprintf((BaseSequentialStream *)&ms, "%s %d %x", "bench", i, i);
+    tmProfileEnd(&printf_point, start);
+  }
+
+  tmShellCmd(chp, 0, NULL);
+  chprintf(chp, "\r\n");
+  tmShellCmd(chp, 1, argv);
+}
+
+/*===========================================================================*/
+/* Main.                                                                     */
+/*===========================================================================*/
+
+int main(void) {
+
+  halInit();
+  chSysInit();
+  conInit();
+
+  tmProfileObjectInit(&null_point, "null");
+  tmProfileObjectInit(&record_point, "record");
+  tmProfileObjectInit(&thread_point, "thread");
+  tmProfileObjectInit(&sleep_point, "sleep");
+  tmProfileObjectInit(&sem_point, "sem");
+  tmProfileObjectInit(&printf_point, "chprintf");
+
+  chprintf(chp, "*** TM profiling, host monotonic clock counter\r\n");
+  calibration();
+  statistics();
+  threads();
+  command();
+
+  chprintf(chp, "\r\n*** Instrumented benchmarks\r\n");
+  benchmarks();
+
+  chprintf(chp, "\r\nFinal result: %s\r\n", failed ? "FAILURE" : "SUCCESS");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,573 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "console.h"
+#include "simdisk.h"
+#include "usb_msc.h"
+
+/*
+ * Test parameters, a 4MB RAM disk exported over a high speed link.
+ */
+#define DISK_BLOCKS         8192
+#define PACKET_SIZE         512
+#define BUFFER_SIZE         4096
+#define BUFFERS_MAX         4
+#define XFER_BLOCKS         128
+#define RAW_SIZE            (DISK_BLOCKS * SIMDISK_BLOCK_SIZE)
+#define MODELED_SIZE        (1024 * 1024)
+#define LATENCY_RUNS        1000
+
+/*
+ * Modeled bus bandwidth in bytes per second, the host sleeps for the
+ * time its packets would take on the wire.
+ */
+#define BUS_RATE            5000000
+
+static SimDiskDriver SDD1;
+static MSCDriver MSCD1;
+
+static uint8_t msc_buffers[BUFFERS_MAX * BUFFER_SIZE];
+static uint8_t wbuf[XFER_BLOCKS * SIMDISK_BLOCK_SIZE];
+static uint8_t rbuf[XFER_BLOCKS * SIMDISK_BLOCK_SIZE];
+
+static const SimDiskConfig sdcfg = {
+  DISK_BLOCKS,
+  NULL,
+  300,                      /* Command overhead, uS.                    */
+  100                       /* Block transfer time, uS.                 */
+};
+
+static const MSCConfig msccfg[] = {
+  {&USBD1, (BaseBlockDevice *)&SDD1, MSC_DATA_IN_EP, MSC_DATA_OUT_EP,
+   msc_buffers, BUFFER_SIZE, 1},
+  {&USBD1, (BaseBlockDevice *)&SDD1, MSC_DATA_IN_EP, MSC_DATA_OUT_EP,
+   msc_buffers, BUFFER_SIZE, 2},
+  {&USBD1, (BaseBlockDevice *)&SDD1, MSC_DATA_IN_EP, MSC_DATA_OUT_EP,
+   msc_buffers, BUFFER_SIZE, 4}
+};
+
+static BaseSequentialStream *chp = (BaseSequentialStream *)&CD1;
+static bool_t failed;
+
+/*===========================================================================*/
+/* USB related stuff.                                                        */
+/*===========================================================================*/
+
+/*
+ * USB Device Descriptor.
+ */
+static const uint8_t msc_device_descriptor_data[18] = {
+  USB_DESC_DEVICE       (0x0200,        /* bcdUSB (2.0).                    */
+                         0x00,          /* bDeviceClass (in interface).     */
+                         0x00,          /* bDeviceSubClass.                 */
+                         0x00,          /* bDeviceProtocol.                 */
+                         0x40,          /* bMaxPacketSize.                  */
+                         0x0483,        /* idVendor (ST).                   */
+                         0x2004,        /* idProduct.                       */
+                         0x0200,        /* bcdDevice.                       */
+                         0,             /* iManufacturer.                   */
+                         0,             /* iProduct.                        */
+                         0,             /* iSerialNumber.                   */
+                         1)             /* bNumConfigurations.              */
+};
+
+/*
+ * Device Descriptor wrapper.
+ */
+static const USBDescriptor msc_device_descriptor = {
+  sizeof msc_device_descriptor_data,
+  msc_device_descriptor_data
+};
+
+/* Configuration Descriptor tree for a MSC.*/
+static const uint8_t msc_configuration_descriptor_data[32] = {
+  /* Configuration Descriptor.*/
+  USB_DESC_CONFIGURATION(32,            /* wTotalLength.                    */
+                         0x01,          /* bNumInterfaces.                  */
+                         0x01,          /* bConfigurationValue.             */
+                         0,             /* iConfiguration.                  */
+                         0xC0,          /* bmAttributes (self powered).     */
+                         50),           /* bMaxPower (100mA).               */
+  /* Interface Descriptor.*/
+  USB_DESC_INTERFACE    (0x00,          /* bInterfaceNumber.                */
+                         0x00,          /* bAlternateSetting.               */
+                         0x02,          /* bNumEndpoints.                   */
+                         0x08,          /* bInterfaceClass (Mass Storage).  */
+                         0x06,          /* bInterfaceSubClass (SCSI
+                                           transparent command set).        */
+                         0x50,          /* bInterfaceProtocol (Bulk-Only).  */
+                         0),            /* iInterface.                      */
+  /* Endpoint 1 Descriptor.*/
+  USB_DESC_ENDPOINT     (MSC_DATA_IN_EP|0x80,   /* bEndpointAddress.        */
+                         0x02,          /* bmAttributes (Bulk).             */
+                         PACKET_SIZE,   /* wMaxPacketSize.                  */
+                         0x00),         /* bInterval (ignored for bulk).    */
+  /* Endpoint 2 Descriptor.*/
+  USB_DESC_ENDPOINT     (MSC_DATA_OUT_EP,       /* bEndpointAddress.        */
+                         0x02,          /* bmAttributes (Bulk).             */
+                         PACKET_SIZE,   /* wMaxPacketSize.                  */
+                         0x00),         /* bInterval (ignored for bulk).    */
+};
+
+/*
+ * Configuration Descriptor wrapper.
+ */
+static const USBDescriptor msc_configuration_descriptor = {
+  sizeof msc_configuration_descriptor_data,
+  msc_configuration_descriptor_data
+};
+
+/*
+ * Handles the GET_DESCRIPTOR callback. All required descriptors must be
+ * handled here.
+ */
+static const USBDescriptor *get_descriptor(USBDriver *usbp,
+                                           uint8_t dtype,
+                                           uint8_t dindex,
+                                           uint16_t lang) {
+
+  (void)usbp;
+  (void)dindex;
+  (void)lang;
+  switch (dtype) {
+  case USB_DESCRIPTOR_DEVICE:
+    return &msc_device_descriptor;
+  case USB_DESCRIPTOR_CONFIGURATION:
+    return &msc_configuration_descriptor;
+  }
+  return NULL;
+}
+
+/*
+ * IN EP1 state.
+ */
+static USBInEndpointState ep1state;
+
+/*
+ * OUT EP2 state.
+ */
+static USBOutEndpointState ep2state;
+
+/*
+ * EP1 initialization structure (IN only).
+ */
+static const USBEndpointConfig ep1config = {
+  USB_EP_MODE_TYPE_BULK,
+  NULL,
+  mscDataTransmitted,
+  NULL,
+  PACKET_SIZE,
+  0x0000,
+  &ep1state,
+  NULL
+};
+
+/*
+ * EP2 initialization structure (OUT only).
+ */
+static const USBEndpointConfig ep2config = {
+  USB_EP_MODE_TYPE_BULK,
+  NULL,
+  NULL,
+  mscDataReceived,
+  0x0000,
+  PACKET_SIZE,
+  NULL,
+  &ep2state
+};
+
+/*
+ * Handles the USB driver global events.
+ */
+static void usb_event(USBDriver *usbp, usbevent_t event) {
+
+  switch (event) {
+  case USB_EVENT_CONFIGURED:
+    /* Enables the endpoints specified into the configuration.
+       Note, this callback is invoked from an ISR so I-Class functions
+       must be used.*/
+    chSysLockFromIsr();
+    usbInitEndpointI(usbp, MSC_DATA_IN_EP, &ep1config);
+    usbInitEndpointI(usbp, MSC_DATA_OUT_EP, &ep2config);
+    mscConfigureHookI(&MSCD1);
+    chSysUnlockFromIsr();
+    return;
+  default:
+    return;
+  }
+}
+
+/*
+ * USB driver configuration.
+ */
+static const USBConfig usbcfg = {
+  usb_event,
+  get_descriptor,
+  mscRequestsHook,
+  NULL
+};
+
+/*===========================================================================*/
+/* Simulated host.                                                           */
+/*===========================================================================*/
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Prints a ratio with two decimals.
+ */
+static void print_ratio(const char *label, uint64_t num, uint64_t den,
+                        const char *unit) {
+  uint64_t r = den ? (num * 100) / den : 0;
+
+  chprintf(chp, "%s%u.%02u%s", label, (unsigned)(r / 100),
+           (unsigned)(r % 100), unit);
+}
+
+/*
+ * Host side transfers, the simulated device controller retries the NAKed
+ * tokens and paces the packets when a bus rate is set.
+ */
+static msg_t host_in(usbep_t ep, uint8_t *p, size_t n) {
+
+  return usbSimTransferIn(&USBD1, ep, p, n, TIME_INFINITE);
+}
+
+static msg_t host_out(usbep_t ep, const uint8_t *p, size_t n) {
+
+  return usbSimTransferOut(&USBD1, ep, p, n, TIME_INFINITE);
+}
+
+static msg_t host_control(uint8_t type, uint8_t req, uint16_t value,
+                          uint16_t index, uint8_t *p, uint16_t n) {
+
+  return usbSimControl(&USBD1, type, req, value, index, p, n);
+}
+
+static msg_t host_clear_halt(uint8_t ep) {
+
+  return host_control(USB_RTYPE_RECIPIENT_ENDPOINT, USB_REQ_CLEAR_FEATURE,
+                      USB_FEATURE_ENDPOINT_HALT, ep, NULL, 0);
+}
+
+/*
+ * Executes a SCSI command, returns the CSW status or -1 on a transport
+ * failure.
+ */
+static int scsi(const uint8_t *cb, uint8_t len, bool_t in,
+                uint8_t *p, uint32_t n, uint32_t *residuep) {
+  static uint32_t tag;
+  msccbw_t cbw;
+  msccsw_t csw;
+  msg_t msg;
+
+  memset(&cbw, 0, sizeof cbw);
+  cbw.dCBWSignature = MSC_CBW_SIGNATURE;
+  cbw.dCBWTag = ++tag;
+  cbw.dCBWDataTransferLength = n;
+  cbw.bmCBWFlags = in ? 0x80 : 0x00;
+  cbw.bCBWCBLength = len;
+  memcpy(cbw.CBWCB, cb, len);
+  if (host_out(MSC_DATA_OUT_EP, (uint8_t *)&cbw, MSC_CBW_SIZE) < 0)
+    return -1;
+
+  /* Data phase, a stalled pipe is cleared before reading the CSW.*/
+  if (n > 0) {
+    if (in)
+      msg = host_in(MSC_DATA_IN_EP, p, n);
+    else
+      msg = host_out(MSC_DATA_OUT_EP, p, n);
+    if (msg == USB_SIM_STALL)
+      host_clear_halt(in ? MSC_DATA_IN_EP | 0x80 : MSC_DATA_OUT_EP);
+    else if (msg < 0)
+      return -1;
+  }
+
+  /* Status phase.*/
+  msg = host_in(MSC_DATA_IN_EP, (uint8_t *)&csw, MSC_CSW_SIZE);
+  if (msg == USB_SIM_STALL) {
+    host_clear_halt(MSC_DATA_IN_EP | 0x80);
+    msg = host_in(MSC_DATA_IN_EP, (uint8_t *)&csw, MSC_CSW_SIZE);
+  }
+  if ((msg != MSC_CSW_SIZE) || (csw.dCSWSignature != MSC_CSW_SIGNATURE) ||
+      (csw.dCSWTag != tag))
+    return -1;
+  if (residuep != NULL)
+    *residuep = csw.dCSWDataResidue;
+  return csw.bCSWStatus;
+}
+
+static int scsi_rw(uint8_t op, uint32_t lba, uint16_t blocks, uint8_t *p) {
+  uint8_t cb[10] = {op, 0, lba >> 24, lba >> 16, lba >> 8, lba,
+                    0, blocks >> 8, blocks, 0};
+
+  return scsi(cb, 10, op == SCSI_READ10, p,
+              (uint32_t)blocks * SIMDISK_BLOCK_SIZE, NULL);
+}
+
+static int scsi_sense(uint8_t *key, uint8_t *asc) {
+  static const uint8_t cb[6] = {SCSI_REQUEST_SENSE, 0, 0, 0, 18, 0};
+  uint8_t sense[18];
+  int status;
+
+  status = scsi(cb, 6, TRUE, sense, 18, NULL);
+  *key = sense[2];
+  *asc = sense[12];
+  return status;
+}
+
+static void check(bool_t ok, const char *what) {
+
+  chprintf(chp, "--- %s: %s\r\n", what, ok ? "ok" : "FAILED");
+  if (!ok)
+    failed = TRUE;
+}
+
+/*===========================================================================*/
+/* Tests.                                                                    */
+/*===========================================================================*/
+
+static void enumerate(void) {
+  uint8_t desc[32];
+  uint8_t lun = 0xFF;
+
+  usbSimBusReset(&USBD1);
+  check((host_control(USB_RTYPE_DIR_DEV2HOST, USB_REQ_GET_DESCRIPTOR,
+                      USB_DESCRIPTOR_DEVICE << 8, 0, desc, 18) == 18) &&
+        (desc[1] == USB_DESCRIPTOR_DEVICE),
+        "GET_DESCRIPTOR(DEVICE)");
+  check(host_control(0, USB_REQ_SET_ADDRESS, 5, 0, NULL, 0) == 0,
+        "SET_ADDRESS");
+  check((host_control(USB_RTYPE_DIR_DEV2HOST, USB_REQ_GET_DESCRIPTOR,
+                      USB_DESCRIPTOR_CONFIGURATION << 8, 0, desc, 32) == 32) &&
+        (desc[14] == 0x08) && (desc[16] == 0x50),
+        "GET_DESCRIPTOR(CONFIGURATION)");
+  check((host_control(0, USB_REQ_SET_CONFIGURATION, 1, 0, NULL, 0) == 0) &&
+        (usbGetDriverStateI(&USBD1) == USB_ACTIVE),
+        "SET_CONFIGURATION");
+  check((host_control(USB_RTYPE_DIR_DEV2HOST | USB_RTYPE_TYPE_CLASS |
+                      USB_RTYPE_RECIPIENT_INTERFACE, MSC_GET_MAX_LUN_COMMAND,
+                      0, 0, &lun, 1) == 1) && (lun == 0),
+        "GET_MAX_LUN");
+}
+
+static void commands(void) {
+  static const uint8_t inquiry[6] = {SCSI_INQUIRY, 0, 0, 0, 36, 0};
+  static const uint8_t tur[6] = {SCSI_TEST_UNIT_READY, 0, 0, 0, 0, 0};
+  static const uint8_t capacity[10] = {SCSI_READ_CAPACITY10};
+  static const uint8_t invalid[6] = {0xFF};
+  uint8_t data[36], key, asc;
+  uint32_t residue;
+  msccbw_t cbw;
+
+  check((scsi(inquiry, 6, TRUE, data, 36, NULL) == MSC_CSW_STATUS_PASSED) &&
+        (memcmp(&data[8], "ChibiOS ", 8) == 0),
+        "INQUIRY");
+  check(scsi(tur, 6, FALSE, NULL, 0, NULL) == MSC_CSW_STATUS_PASSED,
+        "TEST UNIT READY");
+  check((scsi(capacity, 10, TRUE, data, 8, NULL) == MSC_CSW_STATUS_PASSED) &&
+        (data[2] == ((DISK_BLOCKS - 1) >> 8)) &&
+        (data[3] == ((DISK_BLOCKS - 1) & 0xFF)) &&
+        (data[6] == (SIMDISK_BLOCK_SIZE >> 8)),
+        "READ CAPACITY(10)");
+
+  /* The host expects more data than the device has, the residue must
+     account for it.*/
+  check((scsi(inquiry, 6, TRUE, data, 36 + 64, &residue) ==
+         MSC_CSW_STATUS_PASSED) && (residue == 64),
+        "INQUIRY with residue");
+
+  /* Out of range access, the data phase is stalled and the sense data
+     describes the error.*/
+  check((scsi_rw(SCSI_READ10, DISK_BLOCKS, 1, rbuf) ==
+         MSC_CSW_STATUS_FAILED) &&
+        (scsi_sense(&key, &asc) == MSC_CSW_STATUS_PASSED) &&
+        (key == SCSI_SENSE_ILLEGAL_REQUEST) &&
+        (asc == SCSI_ASC_LBA_OUT_OF_RANGE),
+        "READ(10) out of range");
+  check((scsi(invalid, 6, FALSE, NULL, 0, NULL) == MSC_CSW_STATUS_FAILED) &&
+        (scsi_sense(&key, &asc) == MSC_CSW_STATUS_PASSED) &&
+        (key == SCSI_SENSE_ILLEGAL_REQUEST) &&
+        (asc == SCSI_ASC_INVALID_COMMAND),
+        "Invalid command");
+
+  /* Write protected media.*/
+  simdiskSetProtection(&SDD1, TRUE);
+  check((scsi_rw(SCSI_WRITE10, 0, 1, wbuf) == MSC_CSW_STATUS_FAILED) &&
+        (scsi_sense(&key, &asc) == MSC_CSW_STATUS_PASSED) &&
+        (key == SCSI_SENSE_DATA_PROTECT),
+        "WRITE(10) protected");
+  simdiskSetProtection(&SDD1, FALSE);
+
+  /* Invalid CBW, both pipes stay stalled until a reset recovery.*/
+  memset(&cbw, 0, sizeof cbw);
+  (void)host_out(MSC_DATA_OUT_EP, (uint8_t *)&cbw, MSC_CBW_SIZE);
+  check((usbSimIn(&USBD1, MSC_DATA_IN_EP, data) == USB_SIM_STALL) &&
+        (usbSimOut(&USBD1, MSC_DATA_OUT_EP, data, 1) == USB_SIM_STALL),
+        "Invalid CBW");
+  (void)host_control(USB_RTYPE_TYPE_CLASS | USB_RTYPE_RECIPIENT_INTERFACE,
+                     MSC_MASS_STORAGE_RESET_COMMAND, 0, 0, NULL, 0);
+  host_clear_halt(MSC_DATA_IN_EP | 0x80);
+  host_clear_halt(MSC_DATA_OUT_EP);
+  check(scsi(tur, 6, FALSE, NULL, 0, NULL) == MSC_CSW_STATUS_PASSED,
+        "Reset recovery");
+}
+
+/*
+ * Round trip time of a command, no device or bus timing.
+ */
+static void latency(const char *label, uint8_t op) {
+  static const uint8_t tur[6] = {SCSI_TEST_UNIT_READY, 0, 0, 0, 0, 0};
+  uint64_t start, t, min = (uint64_t)-1, max = 0, sum = 0;
+  unsigned i;
+
+  for (i = 0; i < LATENCY_RUNS; i++) {
+    start = now_us();
+    if (((op == SCSI_TEST_UNIT_READY) ?
+         scsi(tur, 6, FALSE, NULL, 0, NULL) :
+         scsi_rw(op, i, 1, rbuf)) != MSC_CSW_STATUS_PASSED) {
+      chprintf(chp, "--- %s failed\r\n", label);
+      failed = TRUE;
+      return;
+    }
+    t = now_us() - start;
+    sum += t;
+    if (t < min)
+      min = t;
+    if (t > max)
+      max = t;
+  }
+  chprintf(chp, "    %s: min %uuS, avg %uuS, max %uuS\r\n", label,
+           (unsigned)min, (unsigned)(sum / LATENCY_RUNS), (unsigned)max);
+}
+
+static void fill(uint8_t *p, uint32_t lba, uint32_t n, uint32_t seed) {
+  uint32_t i;
+
+  for (i = 0; i < n * SIMDISK_BLOCK_SIZE / sizeof(uint32_t); i++)
+    ((uint32_t *)p)[i] = ((lba + i / (SIMDISK_BLOCK_SIZE / 4)) << 16) ^
+                         (seed * 2654435761U) ^ i;
+}
+
+/*
+ * Writes then reads back size bytes with the specified number of buffers.
+ */
+static void bench(const MSCConfig *cfg, uint32_t size, uint32_t seed) {
+  uint64_t start, wtime, rtime;
+  uint32_t lba;
+  MSCStats st;
+
+  mscStop(&MSCD1);
+  mscObjectInit(&MSCD1);
+  mscStart(&MSCD1, cfg);
+
+  start = now_us();
+  for (lba = 0; lba < size / SIMDISK_BLOCK_SIZE; lba += XFER_BLOCKS) {
+    fill(wbuf, lba, XFER_BLOCKS, seed);
+    if (scsi_rw(SCSI_WRITE10, lba, XFER_BLOCKS, wbuf) !=
+        MSC_CSW_STATUS_PASSED) {
+      chprintf(chp, "--- WRITE(10) failed at %u\r\n", lba);
+      failed = TRUE;
+      return;
+    }
+  }
+  wtime = now_us() - start;
+
+  start = now_us();
+  for (lba = 0; lba < size / SIMDISK_BLOCK_SIZE; lba += XFER_BLOCKS) {
+    if (scsi_rw(SCSI_READ10, lba, XFER_BLOCKS, rbuf) !=
+        MSC_CSW_STATUS_PASSED) {
+      chprintf(chp, "--- READ(10) failed at %u\r\n", lba);
+      failed = TRUE;
+      return;
+    }
+    fill(wbuf, lba, XFER_BLOCKS, seed);
+    if (memcmp(rbuf, wbuf, sizeof rbuf) != 0) {
+      chprintf(chp, "--- data mismatch at %u\r\n", lba);
+      failed = TRUE;
+      return;
+    }
+  }
+  rtime = now_us() - start;
+
+  mscGetStats(&MSCD1, &st);
+  chprintf(chp, "--- %u buffer(s) of %u bytes\r\n",
+           cfg->buffers_num, BUFFER_SIZE);
+  print_ratio("    WRITE(10)         : ", size, wtime, " MB/S\r\n");
+  print_ratio("    READ(10)          : ", size, rtime, " MB/S\r\n");
+  chprintf(chp, "    overlapped ops    : %u\r\n", st.overlaps);
+}
+
+/*
+ * Application entry point.
+ */
+int main(void) {
+  unsigned i;
+
+  halInit();
+  chSysInit();
+  conInit();
+
+  simdiskObjectInit(&SDD1);
+  simdiskStart(&SDD1, &sdcfg);
+  blkConnect(&SDD1);
+  mscObjectInit(&MSCD1);
+  mscStart(&MSCD1, &msccfg[1]);
+  usbStart(&USBD1, &usbcfg);
+  usbConnectBus(&USBD1);
+
+  chprintf(chp, "*** USB MSC over a simulated device controller, "
+                "%u blocks RAM disk\r\n", DISK_BLOCKS);
+  enumerate();
+  commands();
+
+  chprintf(chp, "\r\n*** Commands latency, no device or bus timing\r\n");
+  latency("TEST UNIT READY   ", SCSI_TEST_UNIT_READY);
+  latency("READ(10) 1 block  ", SCSI_READ10);
+  latency("WRITE(10) 1 block ", SCSI_WRITE10);
+
+  chprintf(chp, "\r\n*** Raw throughput, no device or bus timing\r\n");
+  for (i = 0; i < sizeof msccfg / sizeof msccfg[0]; i++)
+    bench(&msccfg[i], RAW_SIZE, i);
+
+  chprintf(chp, "\r\n*** Modeled throughput, card %u+%uuS/block, "
+                "bus %u.%uMB/S\r\n",
+           sdcfg.command_time, sdcfg.block_time,
+           BUS_RATE / 1000000, (BUS_RATE / 100000) % 10);
+  simdiskSetRealtime(&SDD1, TRUE);
+  usbSimSetBusRate(&USBD1, BUS_RATE);
+  for (i = 0; i < sizeof msccfg / sizeof msccfg[0]; i++)
+    bench(&msccfg[i], MODELED_SIZE, i + 10);
+
+  mscStop(&MSCD1);
+  usbStop(&USBD1);
+  simdiskStop(&SDD1);
+
+  chprintf(chp, "\r\nFinal result: %s\r\n", failed ? "FAILURE" : "SUCCESS");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,216 @@
+/*
+    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#include <sys/time.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+#include "console.h"
+
+#define TIMEOUT_S           30
+#define TIMEOUT_RUNS        2880
+#define HOST_LIMIT_MS       10000
+#define TRAFFIC_BYTES       256
+#define TRAFFIC_GAP_US      100000
+
+static BaseSequentialStream *chp = (BaseSequentialStream *)&CD1;
+static bool_t failed;
+
+/*===========================================================================*/
+/* Helpers.                                                                  */
+/*===========================================================================*/
+
+static void check(bool_t cond, const char *msg) {
+
+  if (!cond) {
+    chprintf(chp, "--- failed: %s\r\n", msg);
+    failed = TRUE;
+  }
+}
+
+static void result(const char *name, bool_t ok) {
+
+  chprintf(chp, "--- %s: %s\r\n", name, ok ? "ok" : "FAILED");
+}
+
+static uint32_t host_ms(void) {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (uint32_t)(tv.tv_sec * 1000 + tv.tv_usec / 1000);
+}
+
+/*===========================================================================*/
+/* Long timeouts.                                                            */
+/*===========================================================================*/
+
+/*
+ * A day of protocol timeouts, a thread waits on a semaphore that is never
+ * signaled, the simulated time jumps from a timeout to the next.
+ */
+static void timeouts(void) {
+  BinarySemaphore sem;
+  systime_t start;
+  uint32_t t;
+  unsigned i, n;
+  bool_t ok;
+
+  chBSemInit(&sem, TRUE);
+  t = host_ms();
+  start = chTimeNow();
+  n = 0;
+  for (i = 0; i < TIMEOUT_RUNS; i++) {
+    if (chBSemWaitTimeout(&sem, S2ST(TIMEOUT_S)) == RDY_TIMEOUT)
+      n++;
+  }
+  t = host_ms() - t;
+
+  chprintf(chp, "--- %u timeouts, %U s simulated in %U ms\r\n",
+           n, (uint32_t)((chTimeNow() - start) / CH_FREQUENCY), t);
+  ok = TRUE;
+  if (n != TIMEOUT_RUNS) {
+    check(FALSE, "timeouts count");
+    ok = FALSE;
+  }
+  if (chTimeNow() - start != (systime_t)TIMEOUT_RUNS * S2ST(TIMEOUT_S)) {
+    check(FALSE, "simulated time");
+    ok = FALSE;
+  }
+  if (t > HOST_LIMIT_MS) {
+    check(FALSE, "host time");
+    ok = FALSE;
+  }
+  result("Timeouts", ok);
+}
+
+/*===========================================================================*/
+/* Injected traffic.                                                         */
+/*===========================================================================*/
+
+static SimEvent traffic_event;
+static unsigned traffic_left;
+
+/*
+ * Injects a random byte in SD1 and schedules the next one after a random
+ * gap.
+ */
+static void traffic_cb(void *par) {
+  uint8_t b = (uint8_t)simRandom();
+
+  (void)par;
+  sdSimInjectI(&SD1, &b, 1);
+  if (--traffic_left > 0)
+    simEventSetI(&traffic_event,
+                 hal_lld_get_time_us() + simRandom() % TRAFFIC_GAP_US,
+                 traffic_cb, NULL);
+}
+
+/*
+ * Receives the injected traffic, the reception times and the data are
+ * hashed together.
+ */
+static uint32_t traffic(uint32_t seed) {
+  uint32_t h = 2166136261U;
+  systime_t start;
+  unsigned i;
+  msg_t c;
+
+  /* Starting on a tick boundary.*/
+  chThdSleep(1);
+  start = chTimeNow();
+  simSetSeed(seed);
+  chSysLock();
+  traffic_left = TRAFFIC_BYTES;
+  simEventSetI(&traffic_event, hal_lld_get_time_us() + TRAFFIC_GAP_US,
+               traffic_cb, NULL);
+  chSysUnlock();
+
+  for (i = 0; i < TRAFFIC_BYTES; i++) {
+    c = chnGetTimeout(&SD1, S2ST(1));
+    if (c < 0)
+      return 0;
+    h = (h ^ (uint32_t)c) * 16777619U;
+    h = (h ^ (uint32_t)(chTimeNow() - start)) * 16777619U;
+  }
+  return h;
+}
+
+/*
+ * The same seed must produce the same reception trace, the reception
+ * times are relative to the start of the traffic.
+ */
+static void determinism(void) {
+  uint32_t h1, h2, h3;
+  bool_t ok;
+
+  h1 = traffic(12345);
+  h2 = traffic(12345);
+  h3 = traffic(54321);
+
+  chprintf(chp, "--- Trace hashes %08x %08x %08x\r\n", h1, h2, h3);
+  ok = (h1 != 0) && (h1 == h2) && (h1 != h3);
+  check(h1 != 0, "injected data lost");
+  check(h1 == h2, "same seed, different trace");
+  check(h1 != h3, "different seed, same trace");
+  result("Injection", ok);
+}
+
+/*===========================================================================*/
+/* Busy wait.                                                                */
+/*===========================================================================*/
+
+/*
+ * A busy loop polling the interrupt sources advances the virtual time.
+ */
+static void busy_wait(void) {
+  systime_t start = chTimeNow();
+  halrtcnt_t cnt = halGetCounterValue();
+  unsigned n = 0;
+  bool_t ok;
+
+  while (chTimeNow() - start < MS2ST(10)) {
+    ChkIntSources();
+    n++;
+  }
+  cnt = halGetCounterValue() - cnt;
+
+  chprintf(chp, "--- %u passes, %U ns\r\n", n, (uint32_t)cnt);
+  /* The loop starts between two ticks.*/
+  ok = (cnt > (MS2ST(10) - 1) * (1000000000 / CH_FREQUENCY)) &&
+       (cnt <= MS2ST(10) * (1000000000 / CH_FREQUENCY));
+  check(ok, "virtual time of the passes");
+  result("Busy wait", ok);
+}
+
+/*===========================================================================*/
+/* Main.                                                                     */
+/*===========================================================================*/
+
+int main(void) {
+
+  halInit();
+  chSysInit();
+  conInit();
+
+  chprintf(chp, "*** Simulator virtual time\r\n");
+  timeouts();
+  determinism();
+  busy_wait();
+
+  chprintf(chp, "\r\nFinal result: %s\r\n", failed ? "FAILURE" : "SUCCESS");
+  return failed ? 1 : 0;
+}
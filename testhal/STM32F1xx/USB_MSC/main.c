@@ -20,10 +20,53 @@
 
 #include "usb_msc.h"
 
+/*===========================================================================*/
+/* Card related stuff.                                                       */
+/*===========================================================================*/
+
+/*
+ * MMC driver instance.
+ */
+MMCDriver MMCD1;
+
+/* Maximum speed SPI configuration (18MHz, CPHA=0, CPOL=0, MSb first).*/
+static SPIConfig hs_spicfg = {NULL, IOPORT2, GPIOB_SPI2NSS, 0};
+
+/* Low speed SPI configuration (281.250kHz, CPHA=0, CPOL=0, MSb first).*/
+static SPIConfig ls_spicfg = {NULL, IOPORT2, GPIOB_SPI2NSS,
+                              SPI_CR1_BR_2 | SPI_CR1_BR_1};
+
+/* MMC/SD over SPI driver configuration.*/
+static MMCConfig mmccfg = {&SPID2, &ls_spicfg, &hs_spicfg};
+
 /*===========================================================================*/
 /* USB related stuff.                                                        */
 /*===========================================================================*/
 
+/*
+ * Mass storage driver instance.
+ */
+static MSCDriver MSCD1;
+
+/*
+ * Mass storage buffers, two buffers of eight blocks so that the card
+ * accesses overlap the USB transfers.
+ */
+static uint8_t msc_buffers[2 * 8 * MMCSD_BLOCK_SIZE];
+
+/*
+ * Mass storage driver configuration.
+ */
+static const MSCConfig msccfg = {
+  &USBD1,
+  (BaseBlockDevice *)&MMCD1,
+  MSC_DATA_IN_EP,
+  MSC_DATA_OUT_EP,
+  msc_buffers,
+  8 * MMCSD_BLOCK_SIZE,
+  2
+};
+
 /*
  * USB Device Descriptor.
  */
@@ -189,7 +232,8 @@ USBOutEndpointState ep2state;
  * EP1 initialization structure (IN only).
  */
 static const USBEndpointConfig ep1config = {
-  USB_EP_MODE_TYPE_BULK | USB_EP_MODE_TRANSACTION,
+  USB_EP_MODE_TYPE_BULK,
+  NULL,
   mscDataTransmitted,
   NULL,
   0x0040,
@@ -202,7 +246,8 @@ static const USBEndpointConfig ep1config = {
  * EP2 initialization structure (OUT only).
  */
 static const USBEndpointConfig ep2config = {
-  USB_EP_MODE_TYPE_BULK | USB_EP_MODE_TRANSACTION,
+  USB_EP_MODE_TYPE_BULK,
+  NULL,
   NULL,
   mscDataReceived,
   0x0000,
@@ -228,6 +273,7 @@ static void usb_event(USBDriver *usbp, usbevent_t event) {
     chSysLockFromIsr();
     usbInitEndpointI(usbp, MSC_DATA_IN_EP, &ep1config);
     usbInitEndpointI(usbp, MSC_DATA_OUT_EP, &ep2config);
+    mscConfigureHookI(&MSCD1);
     chSysUnlockFromIsr();
     return;
   case USB_EVENT_SUSPEND:
@@ -241,7 +287,7 @@ static void usb_event(USBDriver *usbp, usbevent_t event) {
 }
 
 /*
- * Serial over USB driver configuration.
+ * USB driver configuration.
  */
 static const USBConfig usbcfg = {
   usb_event,
@@ -286,8 +332,21 @@ int main(void) {
   chSysInit();
 
   /*
-   * Activates the USB driver and then the USB bus pull-up on D+.
+   * Initializes the MMC driver to work with SPI2, the card is expected
+   * to be already inserted.
+   */
+  palSetPadMode(IOPORT2, GPIOB_SPI2NSS, PAL_MODE_OUTPUT_PUSHPULL);
+  palSetPad(IOPORT2, GPIOB_SPI2NSS);
+  mmcObjectInit(&MMCD1);
+  mmcStart(&MMCD1, &mmccfg);
+  (void)mmcConnect(&MMCD1);
+
+  /*
+   * Activates the mass storage driver, the USB driver and then the USB bus
+   * pull-up on D+.
    */
+  mscObjectInit(&MSCD1);
+  mscStart(&MSCD1, &msccfg);
   usbStart(&USBD1, &usbcfg);
   palClearPad(GPIOC, GPIOC_USB_DISC);
 
@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+#
+#    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+#
+#    Licensed under the Apache License, Version 2.0 (the "License");
+#    you may not use this file except in compliance with the License.
+#    You may obtain a copy of the License at
+#
+#        http://www.apache.org/licenses/LICENSE-2.0
+#
+#    Unless required by applicable law or agreed to in writing, software
+#    distributed under the License is distributed on an "AS IS" BASIS,
+#    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#    See the License for the specific language governing permissions and
+#    limitations under the License.
+#
+# Binary log expander.
+#
+# Usage:
+#   binlog.py <string table> <log file or serial device> [baud rate]
+#
+# The string table is the "blstrings" section of the executable, it can be
+# extracted at build time with:
+#   objcopy -O binary --only-section=blstrings ch.elf ch.blt
+#
+import re
+import sys
+
+ID_START = 0
+ID_DROPPED = 1
+ID_FIRST = 16
+FIXED_BITS = 16
+LEVELS = ['DEBUG', 'INFO', 'WARN', 'ERROR']
+
+SPEC = re.compile(r'%(-?)([.0]?)(\d*|\*)(?:\.(\d*|\*))?(ll|l|L)?(.)')
+
+#=========================================================
+def load_table(path):
+    """Returns the log points as a dictionary id -> (level, format)."""
+    data = open(path, 'rb').read()
+    points = {}
+    for offset in range(0, len(data), 4):
+        # A log point is a level byte followed by a C string, aligned to
+        # a word boundary. Unused words are padding.
+        level = data[offset]
+        if level >= len(LEVELS):
+            continue
+        end = data.find(b'\0', offset + 1)
+        if end < 0:
+            break
+        points[(offset >> 2) + ID_FIRST] = (level,
+                                            data[offset + 1:end].decode())
+    return points
+
+#=========================================================
+def fixed(v, digits):
+    """Fixed point conversion, same rounding as chprintf()."""
+    ip = v >> FIXED_BITS
+    frac = ((v & ((1 << FIXED_BITS) - 1)) * 10 ** digits +
+            (1 << (FIXED_BITS - 1))) >> FIXED_BITS
+    if frac >= 10 ** digits:
+        frac -= 10 ** digits
+        ip += 1
+    if digits == 0:
+        return str(ip)
+    return '%d.%0*d' % (ip, digits, frac)
+
+def expand(fmt, args):
+    """Formats the arguments using the chprintf() syntax."""
+    args = list(args)
+    def next_arg():
+        return args.pop(0) if args else 0
+    def convert(m):
+        left, filler, width, precision, _, conv = m.groups()
+        if width == '*':
+            width = next_arg()
+        width = int(width) if width else 0
+        if precision == '*':
+            precision = next_arg()
+        precision = int(precision) if precision else 0
+        filler = '0' if filler else ' '
+        v = None
+        if conv in 'dDiI':
+            v = next_arg()
+            s = str(v - (1 << 32) if v & 0x80000000 else v)
+        elif conv in 'uU':
+            s = str(next_arg())
+        elif conv in 'xX':
+            s = '%X' % next_arg()
+        elif conv in 'oO':
+            s = '%o' % next_arg()
+        elif conv in 'kK':
+            v = next_arg()
+            if v & 0x80000000:
+                s = '-' + fixed((1 << 32) - v, precision or 4)
+            else:
+                s = fixed(v, precision or 4)
+        elif conv == 'c':
+            filler = ' '
+            s = chr(next_arg() & 0xFF)
+        elif conv == 's':
+            filler = ' '
+            s = '<0x%08X>' % next_arg()
+        else:
+            filler = ' '
+            s = conv
+        pad = max(width - len(s), 0)
+        if left:
+            return s + ' ' * pad if filler == ' ' else s + '0' * pad
+        if filler == '0' and s.startswith('-'):
+            return '-' + '0' * pad + s[1:]
+        return filler * pad + s
+    return SPEC.sub(convert, fmt)
+
+#=========================================================
+def varints(data):
+    """Decodes a sequence of LEB128 integers."""
+    values = []
+    v = shift = 0
+    for b in data:
+        v |= (b & 0x7F) << shift
+        shift += 7
+        if b < 0x80:
+            values.append(v & 0xFFFFFFFF)
+            v = shift = 0
+    return values
+
+def cobs_decode(frame):
+    out = bytearray()
+    i = 0
+    while i < len(frame):
+        code = frame[i]
+        if code == 0 or i + code > len(frame) + 1:
+            return None
+        out += frame[i + 1:i + code]
+        i += code
+        if i < len(frame):
+            out.append(0)
+    return bytes(out)
+
+def frames(stream):
+    """Yields the decoded frames, corrupted frames are skipped."""
+    buf = bytearray()
+    while True:
+        chunk = stream.read(256)
+        if not chunk:
+            return
+        buf += chunk
+        while True:
+            end = buf.find(b'\0')
+            if end < 0:
+                break
+            frame = cobs_decode(bytes(buf[:end]))
+            del buf[:end + 1]
+            if frame:
+                yield varints(frame)
+
+#=========================================================
+def main():
+    if len(sys.argv) < 3:
+        sys.stderr.write('usage: binlog.py <string table> '
+                         '<log file or serial device> [baud rate]\n')
+        sys.exit(1)
+    points = load_table(sys.argv[1])
+    if len(sys.argv) > 3:
+        import serial
+        stream = serial.Serial(sys.argv[2], int(sys.argv[3]))
+    else:
+        stream = open(sys.argv[2], 'rb')
+
+    time = 0
+    frequency = 1
+    for record in frames(stream):
+        if len(record) < 2:
+            continue
+        rid, delta, args = record[0], record[1], record[2:]
+        time = (time + delta) & 0xFFFFFFFF
+        stamp = '%10.6f' % (float(time) / frequency)
+        if rid == ID_START:
+            time = delta
+            frequency = args[1] if len(args) > 1 and args[1] else 1
+            stamp = '%10.6f' % (float(time) / frequency)
+            print('%s  ----- log start, version %d, %d Hz' %
+                  (stamp, args[0] if args else 0, frequency))
+        elif rid == ID_DROPPED:
+            print('%s  ----- dropped %s' %
+                  (stamp, ', '.join('%s %d' % (LEVELS[i], n)
+                                    for i, n in enumerate(args) if n)))
+        elif rid in points:
+            level, fmt = points[rid]
+            print('%s  %-5s %s' % (stamp, LEVELS[level],
+                                   expand(fmt, args).rstrip('\r\n')))
+        else:
+            print('%s  ----- unknown log point %d %s' % (stamp, rid, args))
+        sys.stdout.flush()
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+#
+#    ChibiOS/RT - Copyright (C) 2006-2013 Giovanni Di Sirio
+#
+#    Licensed under the Apache License, Version 2.0 (the "License");
+#    you may not use this file except in compliance with the License.
+#    You may obtain a copy of the License at
+#
+#        http://www.apache.org/licenses/LICENSE-2.0
+#
+#    Unless required by applicable law or agreed to in writing, software
+#    distributed under the License is distributed on an "AS IS" BASIS,
+#    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#    See the License for the specific language governing permissions and
+#    limitations under the License.
+#
+# Benchmark results comparator.
+#
+# Usage:
+#   bmkcompare.py [options] <reference log> <new log>
+#
+# The logs are the test suite outputs, the benchmark records are extracted
+# from the lines prefixed by "@bmk", both the JSON and the CSV formats are
+# accepted. The exit status is 1 if a regression is found.
+#
+import argparse
+import json
+import sys
+
+PREFIX = '@bmk'
+FIELDS = ['runs', 'min', 'median', 'max',
+          'lat_min', 'lat_p50', 'lat_p99', 'lat_max']
+
+#=========================================================
+def load(path):
+    """Returns the records of a log as a dictionary name -> record."""
+    records = {}
+    header = None
+    for line in open(path, errors='replace'):
+        line = line.strip()
+        if not line.startswith(PREFIX):
+            continue
+        body = line[len(PREFIX):]
+        if body.startswith(' {'):
+            rec = json.loads(body)
+        elif body.startswith(','):
+            cols = body[1:].split(',')
+            if cols[0] == 'name':
+                header = cols
+                continue
+            if header is None:
+                header = ['name', 'unit'] + FIELDS
+            rec = {}
+            for key, value in zip(header, cols):
+                if value == '':
+                    continue
+                rec[key] = value if key in ('name', 'unit') else int(value)
+        else:
+            continue
+        records[rec['name']] = rec
+    return records
+
+def change(ref, new):
+    """Relative change in percent."""
+    if ref == 0:
+        return 0.0 if new == 0 else float('inf')
+    return (new - ref) * 100.0 / ref
+
+#=========================================================
+def compare(ref, new, args):
+    """Prints the comparison table and returns the regressions count."""
+    regressions = 0
+    print('%-20s %14s %14s %8s  %s' % ('benchmark', 'reference', 'new',
+                                       'change', 'status'))
+    for name in sorted(set(ref) | set(new)):
+        if name not in ref or name not in new:
+            print('%-20s %s' % (name, 'only in the %s log' %
+                                ('reference' if name in ref else 'new')))
+            continue
+        r, n = ref[name], new[name]
+        status = []
+        delta = change(r['median'], n['median'])
+        if r['unit'] == 'bytes':
+            # Sizes are exact, any growth over the threshold is reported.
+            if n['median'] > r['median'] + args.size:
+                status.append('SIZE')
+        elif delta < -args.score:
+            # Throughput, the regression must also be outside the range of
+            # the reference repetitions.
+            if n['max'] < r['min']:
+                status.append('SCORE')
+        for key in ('lat_p50', 'lat_p99'):
+            if key in r and key in n and \
+               change(r[key], n[key]) > args.latency:
+                status.append(key.upper())
+        regressions += 1 if status else 0
+        print('%-20s %14d %14d %+7.1f%%  %s' % (name, r['median'], n['median'],
+                                               delta,
+                                               ','.join(status) or 'ok'))
+        if args.verbose and 'lat_p50' in r and 'lat_p50' in n:
+            print('%-20s %14s %14s' % ('  latency p50/p99',
+                                       '%d/%d' % (r['lat_p50'], r['lat_p99']),
+                                       '%d/%d' % (n['lat_p50'], n['lat_p99'])))
+    return regressions
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Compares the benchmark records of two test suite logs.')
+    parser.add_argument('reference', help='reference log')
+    parser.add_argument('new', help='new log')
+    parser.add_argument('-s', '--score', type=float, default=5.0,
+                        help='allowed score decrease in percent (5)')
+    parser.add_argument('-l', '--latency', type=float, default=25.0,
+                        help='allowed latency increase in percent (25)')
+    parser.add_argument('-z', '--size', type=int, default=0,
+                        help='allowed size increase in bytes (0)')
+    parser.add_argument('-v', '--verbose', action='store_true',
+                        help='also prints the latencies')
+    args = parser.parse_args()
+
+    ref = load(args.reference)
+    new = load(args.new)
+    if not ref or not new:
+        sys.exit('no benchmark records found')
+    regressions = compare(ref, new, args)
+    print('%d regression(s)' % regressions)
+    sys.exit(1 if regressions else 0)
+
+if __name__ == '__main__':
+    main()